@@ -0,0 +1,169 @@
+#!/usr/bin/env bash
+set -euo pipefail
+
+cd "$(dirname "$0")/.."
+
+# Checks VP8X + ALPH alpha decoding (src/m11_alpha/webp_alpha.h) on stills built
+# from simple lossy WebPs plus a generated alpha plane, stored with each of the
+# four ALPH filters:
+# - -png is an RGBA PNG (color type 6) and -pam a PAM whose RGB equals
+#   `decoder -ppm` of the source still and whose alpha equals the plane;
+# - -yuvf is unchanged by the extended layout;
+# - the library (build/webpdec_apidump) matches -pam, and its premultiplied
+#   output follows libwebp's rgbA rounding;
+# - -anim_rgba blends alpha frames like libwebp's WebPAnimDecoder;
+# - VP8L-compressed and truncated ALPH chunks are rejected.
+
+DECODER=./decoder
+APIDUMP=./build/webpdec_apidump
+MUX=./build/webp_animmux
+
+for bin in "$DECODER" "$APIDUMP" "$MUX"; do
+  if [[ ! -x "$bin" ]]; then
+    echo "error: $bin not found; run 'make', 'make webpdec_apidump' and 'make webp_animmux' first" >&2
+    exit 2
+  fi
+done
+
+decoders=("$DECODER")
+if [[ -x ./decoder_nolibc ]]; then decoders+=(./decoder_nolibc); fi
+
+PYTHONPATH=scripts DECODERS="$(printf '%s\n' "${decoders[@]}")" APIDUMP="$APIDUMP" MUX="$MUX" python3 - <<'PY'
+import os
+import subprocess
+import sys
+import tempfile
+
+from check_helpers import env_list, extended, filter_alpha, png_rgba, pnm, read, run, vp8_payload, write
+
+decoders = env_list("DECODERS")
+dec = decoders[0]
+apidump = os.environ["APIDUMP"]
+mux = os.environ["MUX"]
+
+def interleave(rgb, alpha):
+  out = bytearray(len(alpha) * 4)
+  out[0::4], out[1::4], out[2::4], out[3::4] = rgb[0::3], rgb[1::3], rgb[2::3], alpha
+  return bytes(out)
+
+def premultiply(rgba):
+  out = bytearray(rgba)
+  for i in range(0, len(out), 4):
+    a = out[i + 3]
+    if a != 255:
+      m = a * 32897
+      for c in range(3):
+        out[i + c] = (out[i + c] * m) >> 23
+  return bytes(out)
+
+def plane(w, h, seed):
+  # Mix of flat, opaque, transparent and gradient areas.
+  p = bytearray(w * h)
+  for y in range(h):
+    for x in range(w):
+      if x < w // 4:
+        v = 255
+      elif y < h // 4:
+        v = 0
+      else:
+        v = (x * 7 + y * 3 + seed * 29 + ((x * y) >> 3)) & 255
+      p[y * w + x] = v
+  return bytes(p)
+
+T = "images/testimages/webp"
+G = "images/generated/webp"
+sources = [f"{T}/center_square.webp", f"{T}/firework.webp", f"{G}/gen_checker_17x17_q50.webp",
+           f"{G}/gen_checker_127x127_q90.webp", f"{G}/gen_checker_33x33_q10.webp"]
+
+checked = 0
+with tempfile.TemporaryDirectory() as tmp:
+  stills = {}
+  for si, src in enumerate(sources):
+    vp8, w, h = vp8_payload(src)
+    run([dec, "-ppm", src, f"{tmp}/ref.ppm"])
+    run([dec, "-yuvf", src, f"{tmp}/ref.i420"])
+    rgb, yuv = pnm(f"{tmp}/ref.ppm")[3], read(f"{tmp}/ref.i420")
+    alpha = plane(w, h, si)
+    expect = interleave(rgb, alpha)
+
+    for method in range(4):
+      path = f"{tmp}/a{si}_{method}.webp"
+      write(path, extended(vp8, w, h, bytes([method << 2]) + filter_alpha(alpha, w, h, method)))
+      stills[(si, method)] = (path, w, h, expect)
+
+      info = run([dec, "-info", path]).stdout.decode()
+      if "Chunk ALPH" not in info:
+        sys.exit(f"FAIL: -info {path} does not report the ALPH chunk:\n{info}")
+      run([dec, "-yuvf", path, f"{tmp}/out.i420"])
+      if read(f"{tmp}/out.i420") != yuv:
+        sys.exit(f"FAIL: -yuvf {src} (filter {method}) differs from the simple layout")
+      for d in decoders:
+        run([d, "-png", path, f"{tmp}/out.png"])
+        if png_rgba(f"{tmp}/out.png") != (w, h, expect):
+          sys.exit(f"FAIL: {d} -png {src} (filter {method}) != -ppm + alpha plane")
+        run([d, "-pam", path, f"{tmp}/out.pam"])
+        if pnm(f"{tmp}/out.pam") != (w, h, 4, expect):
+          sys.exit(f"FAIL: {d} -pam {src} (filter {method}) != -ppm + alpha plane")
+        checked += 1
+
+      run([apidump, path, "rgba", f"{tmp}/api.pam"])
+      if read(f"{tmp}/api.pam") != read(f"{tmp}/out.pam"):
+        sys.exit(f"FAIL: library rgba {src} (filter {method}) != -pam")
+      run([apidump, path, "rgbA", f"{tmp}/api.pam"])
+      if pnm(f"{tmp}/api.pam")[3] != premultiply(expect):
+        sys.exit(f"FAIL: library rgbA {src} (filter {method}) is not premultiplied like libwebp")
+
+  # Frames with alpha over an opaque first frame, blended like libwebp's
+  # BlendPixelNonPremult (frames here fit inside the canvas without disposal).
+  def blend(dst, src):
+    sa = src[3]
+    if sa == 255:
+      return src
+    if sa == 0:
+      return dst
+    dfa = (dst[3] * (256 - sa)) >> 8
+    ba = sa + dfa
+    scale = (1 << 24) // ba
+    return bytes([((src[c] * sa + dst[c] * dfa) * scale) >> 24 for c in range(3)] + [ba])
+
+  run([dec, "-ppm", f"{T}/radial_400x400.webp", f"{tmp}/bg.ppm"])
+  bg_rgb = pnm(f"{tmp}/bg.ppm")[3]
+  canvas = bytearray(interleave(bg_rgb, b"\xff" * (400 * 400)))
+  layers = [((0, 1), 8, 16, 1), ((3, 3), 200, 100, 1), ((2, 2), 64, 300, 0), ((4, 0), 10, 20, 1)]
+  args = [mux, f"{tmp}/anim.webp", "400", "400", "0", "0", f"{T}/radial_400x400.webp", "0", "0", "10", "0", "0"]
+  expect = [bytes(canvas)]
+  for key, x, y, do_blend in layers:
+    path, w, h, rgba = stills[key]
+    args += [path, str(x), str(y), "10", str(do_blend), "0"]
+    for r in range(h):
+      for c in range(w):
+        o = ((y + r) * 400 + x + c) * 4
+        s = rgba[(r * w + c) * 4:(r * w + c) * 4 + 4]
+        canvas[o:o + 4] = blend(bytes(canvas[o:o + 4]), s) if do_blend else s
+    expect.append(bytes(canvas))
+  run(args)
+  for d in decoders:
+    for threads in ("1", "4"):
+      run([d, "-threads", threads, "-anim_rgba", f"{tmp}/anim.webp", f"{tmp}/anim.rgba"])
+      if read(f"{tmp}/anim.rgba") != b"".join(expect):
+        sys.exit(f"FAIL: {d} -threads {threads} -anim_rgba alpha blending differs from reference")
+
+  # VP8L-compressed alpha is reported as unsupported; truncated planes as corrupt.
+  vp8, w, h = vp8_payload(sources[0])
+  bad = {
+    "lossless": (extended(vp8, w, h, b"\x01" + bytes(16)), "VP8L-compressed alpha"),
+    "short": (extended(vp8, w, h, b"\x00" + bytes(w * h - 1)), "invalid ALPH"),
+    "reserved": (extended(vp8, w, h, b"\xc0" + bytes(w * h)), "invalid ALPH"),
+  }
+  for name, (data, msg) in bad.items():
+    write(f"{tmp}/bad.webp", data)
+    for d in decoders:
+      for cmd, ext in (("-png", "png"), ("-pam", "pam")):
+        p = subprocess.run([d, cmd, f"{tmp}/bad.webp", f"{tmp}/bad.{ext}"], capture_output=True)
+        if p.returncode == 0 or msg not in p.stderr.decode():
+          sys.exit(f"FAIL: {d} {cmd} {name} ALPH: rc={p.returncode} stderr={p.stderr.decode().strip()!r}")
+    if subprocess.run([apidump, f"{tmp}/bad.webp", "rgba", f"{tmp}/bad.pam"], capture_output=True).returncode == 0:
+      sys.exit(f"FAIL: library accepted {name} ALPH")
+
+print(f"OK: VP8X+ALPH alpha checked on {checked} decodes ({', '.join(decoders)})")
+PY
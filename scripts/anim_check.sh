@@ -0,0 +1,139 @@
+#!/usr/bin/env bash
+set -euo pipefail
+
+cd "$(dirname "$0")/.."
+
+# Checks the animated WebP commands (-anim_info/-anim_png/-anim_yuv/-anim_rgba,
+# src/m10_anim/webp_anim.h) on animations muxed from still lossy WebPs with
+# build/webp_animmux:
+# - every -anim_yuv frame equals `decoder -yuvf` of its source still;
+# - -anim_png frames and the -anim_rgba stream match a reference compositor fed
+#   with `decoder -ppm` of the stills (libwebp WebPAnimDecoder rules);
+# - outputs are byte-identical for -threads 1/2/8 (and decoder_nolibc, which
+#   decodes sequentially);
+# - a frame that does not fit the canvas is rejected.
+
+DECODER=./decoder
+MUX=./build/webp_animmux
+
+for bin in "$DECODER" "$MUX"; do
+  if [[ ! -x "$bin" ]]; then
+    echo "error: $bin not found; run 'make' and 'make webp_animmux' first" >&2
+    exit 2
+  fi
+done
+
+decoders=("$DECODER")
+if [[ -x ./decoder_nolibc ]]; then decoders+=(./decoder_nolibc); fi
+
+PYTHONPATH=scripts DECODERS="$(printf '%s\n' "${decoders[@]}")" MUX="$MUX" python3 - <<'PY'
+import glob
+import os
+import subprocess
+import sys
+import tempfile
+
+from check_helpers import env_list, png_rgba, pnm, read, run
+
+decoders = env_list("DECODERS")
+dec = decoders[0]
+mux = os.environ["MUX"]
+
+# Reference compositor: transparent canvas; dispose clears the previous frame's
+# rectangle; frames are opaque, so "blend" and "no blend" both copy.
+def composite(cw, ch, frames, stills):
+  canvas = bytearray(cw * ch * 4)
+  out = []
+  prev = None
+  for (path, x, y, dur, blend, dispose), (w, h, rgb) in zip(frames, stills):
+    if prev and prev[5]:
+      px, py, (pw, ph, _) = prev[1], prev[2], prev[6]
+      for r in range(ph):
+        o = ((py + r) * cw + px) * 4
+        canvas[o:o + pw * 4] = bytes(pw * 4)
+    for r in range(h):
+      o = ((y + r) * cw + x) * 4
+      src = rgb[r * w * 3:(r + 1) * w * 3]
+      row = bytearray(w * 4)
+      row[0::4], row[1::4], row[2::4] = src[0::3], src[1::3], src[2::3]
+      row[3::4] = b"\xff" * w
+      canvas[o:o + w * 4] = row
+    out.append(bytes(canvas))
+    prev = (path, x, y, dur, blend, dispose, (w, h, rgb))
+  return out
+
+T = "images/testimages/webp"
+small = sorted(glob.glob("images/webp/blockcheck2_16x16_*.webp"))[:24]
+cases = [
+  ("mixed", 500, 500, 0, [
+    (f"{T}/radial_400x400.webp", 0, 0, 100, 0, 0),
+    (f"{T}/center_square.webp", 20, 30, 50, 1, 1),
+    (f"{T}/w3c_home.webp", 100, 200, 70, 1, 0),
+    (f"{T}/circle_400x416.webp", 100, 84, 40, 0, 1),
+    (f"{T}/center_square.webp", 436, 436, 10, 1, 0),
+  ]),
+  ("tiles", 64, 48, 3, [(p, (i * 16) % 64, (i // 4) * 16 % 48, 20, i % 2, (i // 3) % 2) for i, p in enumerate(small)]),
+]
+
+checked = 0
+with tempfile.TemporaryDirectory() as tmp:
+  for name, cw, ch, loop, frames in cases:
+    anim = os.path.join(tmp, name + ".webp")
+    args = [mux, anim, str(cw), str(ch), str(loop), "0xffffffff"]
+    for f in frames:
+      args += [f[0]] + [str(v) for v in f[1:]]
+    run(args)
+
+    info = run([dec, "-anim_info", anim]).stdout.decode()
+    if f"Canvas: {cw}x{ch}" not in info or f"Frames: {len(frames)}" not in info:
+      sys.exit(f"FAIL: -anim_info {name}:\n{info}")
+    if subprocess.run([dec, "-info", anim], capture_output=True).returncode == 0:
+      sys.exit(f"FAIL: -info accepted animated {name}")
+
+    stills = []
+    for i, f in enumerate(frames):
+      ppm = os.path.join(tmp, f"still{i}.ppm")
+      run([dec, "-ppm", f[0], ppm])
+      w, h, _, rgb = pnm(ppm)
+      stills.append((w, h, rgb))
+    expect = composite(cw, ch, frames, stills)
+
+    outputs = {}
+    for d in decoders:
+      for threads in ("1", "2", "8"):
+        key = f"{d} -threads {threads}"
+        prefix = os.path.join(tmp, "out")
+        run([d, "-threads", threads, "-anim_png", anim, prefix])
+        run([d, "-threads", threads, "-anim_yuv", anim, prefix])
+        run([d, "-threads", threads, "-anim_rgba", anim, prefix + ".rgba"])
+        pngs = [read(f"{prefix}_{i:04d}.png") for i in range(len(frames))]
+        yuvs = [read(f"{prefix}_{i:04d}.i420") for i in range(len(frames))]
+        outputs[key] = (pngs, yuvs, read(prefix + ".rgba"))
+
+        for i, f in enumerate(frames):
+          ref = os.path.join(tmp, "ref.i420")
+          run([dec, "-yuvf", f[0], ref])
+          if yuvs[i] != read(ref):
+            sys.exit(f"FAIL: {key} -anim_yuv {name} frame {i} != -yuvf {f[0]}")
+          w, h, rgba = png_rgba(f"{prefix}_{i:04d}.png")
+          if (w, h) != (cw, ch) or rgba != expect[i]:
+            sys.exit(f"FAIL: {key} -anim_png {name} frame {i} differs from reference compositor")
+        if outputs[key][2] != b"".join(expect):
+          sys.exit(f"FAIL: {key} -anim_rgba {name} differs from reference compositor")
+        checked += 1
+
+    first = next(iter(outputs.values()))
+    for key, out in outputs.items():
+      if out != first:
+        sys.exit(f"FAIL: {name}: outputs of '{key}' differ from '{next(iter(outputs))}'")
+
+  # Frame 1 (400x416 at 100,84) overflows a 480x480 canvas.
+  bad = os.path.join(tmp, "bad.webp")
+  run([mux, bad, "480", "480", "0", "0", f"{T}/center_square.webp", "0", "0", "10", "0", "0",
+       f"{T}/circle_400x416.webp", "100", "84", "10", "0", "0"])
+  for d in decoders:
+    if subprocess.run([d, "-anim_rgba", bad, os.path.join(tmp, "bad.rgba")], capture_output=True).returncode == 0:
+      sys.exit(f"FAIL: {d} accepted a frame outside the canvas")
+
+print(f"OK: animated WebP checked on {checked} decodes ({', '.join(decoders)})")
+PY
@@ -0,0 +1,73 @@
+#!/usr/bin/env bash
+set -euo pipefail
+
+cd "$(dirname "$0")/.."
+
+# Smoke test for the in-process benchmark (`make bench`, tools/webpdec_bench.c):
+# a short run must produce a CSV and a JSON file with one row per stage for every
+# decodable file and one row per kernel/CPU level. Timings are not checked.
+
+BENCH=./build/webpdec_bench
+
+if [[ ! -x "$BENCH" ]]; then
+  echo "error: $BENCH not found; run 'make bench_bin' first" >&2
+  exit 2
+fi
+
+shopt -s nullglob
+files=(images/webp/*.webp)
+files=("${files[@]:0:4}")
+
+if (( ${#files[@]} == 0 )); then
+  echo "error: no .webp files found under images/webp" >&2
+  exit 2
+fi
+
+tmp=$(mktemp -d)
+trap 'rm -rf "$tmp"' EXIT
+
+"$BENCH" -n 3 -k 3 -csv "$tmp/bench.csv" -json "$tmp/bench.json" "${files[@]}" >/dev/null
+# -perf adds cache-miss rows where hardware counters exist (and only warns otherwise).
+"$BENCH" -n 2 -files -perf -csv "$tmp/perf.csv" "${files[0]}" >/dev/null 2>"$tmp/perf.err"
+
+FILES="$(printf '%s\n' "${files[@]}")" CSV="$tmp/bench.csv" JSON="$tmp/bench.json" PERF_CSV="$tmp/perf.csv" python3 - <<'PY'
+import csv
+import json
+import os
+import sys
+
+STAGES = ["file_map", "container", "header", "modes", "tokens", "recon", "loopfilter", "color", "compress", "write", "total"]
+KERNELS = ["inv_dct4x4", "subblock_predict", "pred16", "lf_mb_v_edge", "upsample_rgb_line_pair", "crc32_update", "adler32_update", "bool_decode"]
+
+files = [f for f in os.environ["FILES"].splitlines() if f]
+with open(os.environ["CSV"], newline="") as f:
+  rows = list(csv.DictReader(f))
+with open(os.environ["JSON"]) as f:
+  results = json.load(f)["results"]
+
+if len(rows) != len(results):
+  sys.exit(f"FAIL: CSV has {len(rows)} rows, JSON has {len(results)}")
+
+for path in files:
+  got = [r["metric"] for r in rows if r["kind"] == "png" and r["subject"] == path]
+  if got != STAGES:
+    sys.exit(f"FAIL: stage rows for {path}: {got}")
+
+for k in KERNELS:
+  if not any(r["kind"] == "kernel" and r["subject"] == k for r in rows):
+    sys.exit(f"FAIL: no kernel row for {k}")
+
+for r in rows:
+  if not (float(r["min_ns"]) <= float(r["median_ns"]) <= float(r["p95_ns"])):
+    sys.exit(f"FAIL: min/median/p95 out of order: {r}")
+
+with open(os.environ["PERF_CSV"], newline="") as f:
+  perf_rows = list(csv.DictReader(f))
+if [r["metric"] for r in perf_rows if r["kind"] == "png"] != STAGES:
+  sys.exit("FAIL: -perf changed the stage rows")
+for r in perf_rows:
+  if r["kind"] == "perf" and (r["metric"] not in ("cache_misses", "l1d_read_misses") or r["unit"] != "per_mb"):
+    sys.exit(f"FAIL: unexpected -perf row: {r}")
+
+print(f"OK: webpdec_bench wrote {len(rows)} rows for {len(files)} files + {len(KERNELS)} kernels")
+PY
@@ -9,6 +9,9 @@ cd "$(dirname "$0")/.."
 echo "== build: all ==" >&2
 make -s all
 
+echo "== build: portable ==" >&2
+make -s portable
+
 echo "== build: nolibc ==" >&2
 make -s nolibc
 
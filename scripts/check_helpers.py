@@ -0,0 +1,147 @@
+"""Shared helpers for the Python bodies of the decoder check scripts.
+
+Imported by anim_check.sh, alpha_check.sh, crop_check.sh, preview_check.sh and
+stdio_check.sh, which run from the repo root with PYTHONPATH=scripts. Failures
+exit with a "FAIL: ..." message like the scripts' own checks.
+
+Readers cover what the decoders write (binary PPM, PAM and 8-bit unfiltered
+PNG); builders wrap the VP8 chunk of a simple lossy WebP into VP8X + ALPH
+stills.
+"""
+
+from __future__ import annotations
+
+import os
+import struct
+import subprocess
+import sys
+import zlib
+
+
+def env_list(name: str) -> list[str]:
+    """Non-empty lines of environment variable `name` (e.g. DECODERS)."""
+    return [v for v in os.environ.get(name, "").splitlines() if v]
+
+
+def run(args: list[str], stdin=None, data: bytes | None = None) -> subprocess.CompletedProcess:
+    p = subprocess.run(args, stdin=stdin, input=data, capture_output=True)
+    if p.returncode != 0:
+        sys.exit(f"FAIL: {' '.join(args)}: rc={p.returncode} {p.stderr.decode().strip()}")
+    return p
+
+
+def read(path: str) -> bytes:
+    with open(path, "rb") as f:
+        return f.read()
+
+
+def write(path: str, data: bytes) -> None:
+    with open(path, "wb") as f:
+        f.write(data)
+
+
+def pnm(path: str) -> tuple[int, int, int, bytes]:
+    """(width, height, channels, pixels) of a P6 or P7 file."""
+    d = read(path)
+    if d.startswith(b"P6"):
+        parts = d.split(b"\n", 3)
+        w, h = map(int, parts[1].split())
+        return w, h, 3, parts[3]
+    end = d.index(b"ENDHDR\n") + 7
+    fields = dict(l.split(b" ", 1) for l in d[3:end - 7].splitlines())
+    return int(fields[b"WIDTH"]), int(fields[b"HEIGHT"]), int(fields[b"DEPTH"]), d[end:]
+
+
+def png(path: str) -> tuple[int, int, int, bytes]:
+    """(width, height, channels, pixels) of an 8-bit RGB or RGBA PNG."""
+    d = read(path)
+    pos = 8
+    idat = b""
+    w = h = c = 0
+    while pos < len(d):
+        n, = struct.unpack(">I", d[pos:pos + 4])
+        kind = d[pos + 4:pos + 8]
+        body = d[pos + 8:pos + 8 + n]
+        if kind == b"IHDR":
+            w, h, depth, ctype = struct.unpack(">IIBB", body[:10])
+            if depth != 8 or ctype not in (2, 6):
+                sys.exit(f"FAIL: {path}: expected 8-bit RGB/RGBA PNG, got depth {depth} color type {ctype}")
+            c = 4 if ctype == 6 else 3
+        elif kind == b"IDAT":
+            idat += body
+        pos += 12 + n
+    raw = zlib.decompress(idat)
+    rows = []
+    for y in range(h):
+        row = raw[y * (w * c + 1):(y + 1) * (w * c + 1)]
+        if row[0] != 0:
+            sys.exit(f"FAIL: {path}: unexpected filter type {row[0]}")
+        rows.append(row[1:])
+    return w, h, c, b"".join(rows)
+
+
+def png_rgba(path: str) -> tuple[int, int, bytes]:
+    """(width, height, pixels) of a PNG that must be RGBA (color type 6)."""
+    w, h, c, px = png(path)
+    if c != 4:
+        sys.exit(f"FAIL: {path}: expected an RGBA PNG")
+    return w, h, px
+
+
+def size_of(path: str) -> tuple[int, int]:
+    """Frame size from the VP8 keyframe header of a lossy WebP."""
+    d = read(path)
+    w, h = struct.unpack("<HH", d[d.index(b"\x9d\x01\x2a") + 3:][:4])
+    return w & 0x3FFF, h & 0x3FFF
+
+
+def chunk(fourcc: bytes, payload: bytes) -> bytes:
+    return fourcc + struct.pack("<I", len(payload)) + payload + (b"\0" if len(payload) & 1 else b"")
+
+
+def vp8_payload(path: str) -> tuple[bytes, int, int]:
+    """(VP8 chunk payload, width, height) of a simple lossy WebP."""
+    d = read(path)
+    if d[12:16] != b"VP8 ":
+        sys.exit(f"FAIL: {path}: expected a simple lossy WebP")
+    n, = struct.unpack("<I", d[16:20])
+    w, h = size_of(path)
+    return d[20:20 + n], w, h
+
+
+def extended(vp8: bytes, w: int, h: int, alph_payload: bytes, flags: int = 0x10) -> bytes:
+    """RIFF/WEBP file: VP8X (alpha flag by default), ALPH, then the VP8 chunk."""
+    vp8x = struct.pack("<I", flags) + struct.pack("<I", w - 1)[:3] + struct.pack("<I", h - 1)[:3]
+    body = b"WEBP" + chunk(b"VP8X", vp8x) + chunk(b"ALPH", alph_payload) + chunk(b"VP8 ", vp8)
+    return b"RIFF" + struct.pack("<I", len(body)) + body
+
+
+def filter_alpha(p: bytes, w: int, h: int, method: int) -> bytes:
+    """Forward ALPH filter (libwebp filters.c): row 0 predicts from the left
+    (its first pixel from 0); later rows start from the pixel above."""
+    out = bytearray(w * h)
+    for y in range(h):
+        for x in range(w):
+            if y == 0:
+                pred = p[x - 1] if x else 0
+            elif x == 0:
+                pred = p[(y - 1) * w]
+            elif method == 1:
+                pred = p[y * w + x - 1]
+            elif method == 2:
+                pred = p[(y - 1) * w + x]
+            else:
+                g = p[y * w + x - 1] + p[(y - 1) * w + x] - p[(y - 1) * w + x - 1]
+                pred = min(max(g, 0), 255)
+            if method == 0:
+                pred = 0
+            out[y * w + x] = (p[y * w + x] - pred) & 255
+    return bytes(out)
+
+
+def alpha_still(src: str, path: str) -> bytes:
+    """Writes `src` with a gradient-filtered ALPH plane to `path`; returns the plane."""
+    vp8, w, h = vp8_payload(src)
+    plane = bytes((x * 5 + y * 11) & 255 for y in range(h) for x in range(w))
+    write(path, extended(vp8, w, h, bytes([3 << 2]) + filter_alpha(plane, w, h, 3)))
+    return plane
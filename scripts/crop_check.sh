@@ -0,0 +1,135 @@
+#!/usr/bin/env bash
+set -euo pipefail
+
+cd "$(dirname "$0")/.."
+
+# Checks the -crop x,y,w,h region-of-interest decode (and the library's
+# webp_decode_crop_* functions) against cropping the full decode:
+# - -ppm/-png/-pam/-yuv/-yuvf with crops at the edges, odd offsets, inside a
+#   single macroblock and covering the whole frame;
+# - an alpha still (VP8X+ALPH) for the RGBA outputs;
+# - a crop of the top rows token-decodes fewer tokens (-timings);
+# - crops outside the image, odd I420 offsets and unsupported commands are rejected.
+
+DECODER=./decoder
+APIDUMP=./build/webpdec_apidump
+
+for bin in "$DECODER" "$APIDUMP"; do
+  if [[ ! -x "$bin" ]]; then
+    echo "error: $bin not found; run 'make' and 'make webpdec_apidump' first" >&2
+    exit 2
+  fi
+done
+
+decoders=("$DECODER")
+if [[ -x ./decoder_nolibc ]]; then decoders+=(./decoder_nolibc); fi
+
+PYTHONPATH=scripts DECODERS="$(printf '%s\n' "${decoders[@]}")" APIDUMP="$APIDUMP" python3 - <<'PY'
+import json
+import os
+import subprocess
+import sys
+import tempfile
+
+from check_helpers import alpha_still, env_list, png, pnm, read, run, size_of
+
+decoders = env_list("DECODERS")
+dec = decoders[0]
+apidump = os.environ["APIDUMP"]
+
+def crop_px(img, x, y, cw, ch):
+  w, h, c, px = img
+  return cw, ch, c, b"".join(px[((y + r) * w + x) * c:((y + r) * w + x + cw) * c] for r in range(ch))
+
+def crop_i420(data, w, h, x, y, cw, ch):
+  uw, uh = (w + 1) // 2, (h + 1) // 2
+  ys, us, vs = data[:w * h], data[w * h:w * h + uw * uh], data[w * h + uw * uh:]
+  def plane(p, pw, px, py, qw, qh):
+    return b"".join(p[(py + r) * pw + px:(py + r) * pw + px + qw] for r in range(qh))
+  cx, cy, cuw, cuh = x // 2, y // 2, (cw + 1) // 2, (ch + 1) // 2
+  return plane(ys, w, x, y, cw, ch) + plane(us, uw, cx, cy, cuw, cuh) + plane(vs, uw, cx, cy, cuw, cuh)
+
+def crops(w, h):
+  out = {(0, 0, w, h), (0, 0, 1, 1), (w - 1, h - 1, 1, 1), (0, 0, w, 1), (0, h - 1, w, 1), (w // 2, 0, w - w // 2, h)}
+  for x, y in ((1, 1), (3, 5), (16, 16), (17, 31), (w // 3, h // 3), (w - 19, h - 7)):
+    if 0 <= x < w and 0 <= y < h:
+      out.add((x, y, min(w - x, 21), min(h - y, 13)))
+      out.add((x, y, w - x, h - y))
+  return sorted(out)
+
+T = "images/testimages/webp"
+G = "images/generated/webp"
+files = [f"{T}/firework.webp", f"{T}/center_square.webp", f"{G}/gen_checker_17x17_q50.webp",
+         f"{G}/gen_checker_33x33_q10.webp", f"{G}/gen_checker_129x129_q90.webp"]
+
+checked = 0
+with tempfile.TemporaryDirectory() as tmp:
+  files.append(os.path.join(tmp, "alpha.webp"))
+  alpha_still(files[1], files[-1])
+  for path in files:
+    w, h = size_of(path)
+    full = {}
+    for cmd in ("-ppm", "-pam", "-png", "-yuv", "-yuvf"):
+      out = os.path.join(tmp, "full" + cmd)
+      run([dec, cmd, path, out])
+      full[cmd] = {"-ppm": pnm, "-pam": pnm, "-png": png}.get(cmd, read)(out)
+
+    for x, y, cw, ch in crops(w, h):
+      spec = f"{x},{y},{cw},{ch}"
+      for cmd in ("-ppm", "-pam", "-png"):
+        expect = crop_px(full[cmd], x, y, cw, ch)
+        for d in decoders:
+          out = os.path.join(tmp, "crop" + cmd)
+          run([d, "-crop", spec, cmd, path, out])
+          if (png if cmd == "-png" else pnm)(out) != expect:
+            sys.exit(f"FAIL: {d} -crop {spec} {cmd} {path} != crop of the full decode")
+          checked += 1
+      for fmt, cmd in (("rgb", "-ppm"), ("rgba", "-pam")):
+        out = os.path.join(tmp, "api." + fmt)
+        run([apidump, path, fmt, out, spec])
+        if pnm(out) != crop_px(full[cmd], x, y, cw, ch):
+          sys.exit(f"FAIL: library {fmt} crop {spec} {path} != crop of {cmd}")
+      if (x | y) & 1:
+        continue
+      for cmd in ("-yuv", "-yuvf"):
+        expect = crop_i420(full[cmd], w, h, x, y, cw, ch)
+        for d in decoders:
+          out = os.path.join(tmp, "crop.i420")
+          run([d, "-crop", spec, cmd, path, out])
+          if read(out) != expect:
+            sys.exit(f"FAIL: {d} -crop {spec} {cmd} {path} != crop of the full decode")
+          checked += 1
+      out = os.path.join(tmp, "api.i420")
+      run([apidump, path, "i420", out, spec])
+      if read(out) != crop_i420(full["-yuvf"], w, h, x, y, cw, ch):
+        sys.exit(f"FAIL: library i420 crop {spec} {path} != crop of -yuvf")
+
+  # Rows below the crop are not token-decoded.
+  def tokens(args):
+    p = run([dec, "-timings"] + args + [os.path.join(tmp, "t.out")])
+    return json.loads(p.stderr.decode().strip().splitlines()[-1])["counts"]["tokens"]
+  top, all_rows = tokens(["-crop", "0,0,960,32", "-ppm", files[0]]), tokens(["-ppm", files[0]])
+  if not 0 < top < all_rows // 4:
+    sys.exit(f"FAIL: -crop of the top rows decoded {top} tokens (full decode: {all_rows})")
+
+  bad = [
+    (["-crop", "0,0,961,1", "-ppm"], "outside the image"),
+    (["-crop", "960,0,1,1", "-png"], "outside the image"),
+    (["-crop", "0,0,0,5", "-ppm"], "expects x,y,w,h"),
+    (["-crop", "1,2,3", "-ppm"], "expects x,y,w,h"),
+    (["-crop", "1,2,3,4,5", "-ppm"], "expects x,y,w,h"),
+    (["-crop", "1,2,8,8", "-yuvf"], "must be even"),
+    (["-crop", "0,0,8,8", "-info"], "only applies"),
+  ]
+  for d in decoders:
+    for args, msg in bad:
+      paths = [files[0]] if args[-1] == "-info" else [files[0], os.path.join(tmp, "bad.out")]
+      p = subprocess.run([d] + args + paths, capture_output=True)
+      if p.returncode == 0 or msg not in p.stderr.decode():
+        sys.exit(f"FAIL: {d} {' '.join(args)}: rc={p.returncode} stderr={p.stderr.decode().strip()!r}")
+  for fmt, spec in (("rgb", "0,0,961,1"), ("i420", "1,0,2,2")):
+    if subprocess.run([apidump, files[0], fmt, os.path.join(tmp, "bad.out"), spec], capture_output=True).returncode == 0:
+      sys.exit(f"FAIL: library accepted {fmt} crop {spec}")
+
+print(f"OK: -crop matches cropped full decodes in {checked} decodes ({', '.join(decoders)})")
+PY
@@ -0,0 +1,67 @@
+#!/usr/bin/env bash
+set -euo pipefail
+
+cd "$(dirname "$0")/.."
+
+# Checks the runtime CPU dispatch (src/common/dsp.h, src/common/enc_dsp.h):
+# - build/dsp_selftest compares every available SIMD level against scalar;
+# - the decoders produce identical PNG/PPM output with WEBPDEC_CPU=scalar and
+#   at the detected level (decoder_nolibc exercises the nolibc getenv path);
+# - so does ./encoder (if built) on the PNG corpora.
+
+SELFTEST=./build/dsp_selftest
+
+if [[ ! -x "$SELFTEST" || ! -x ./decoder ]]; then
+  echo "error: $SELFTEST or ./decoder not found; run 'make' and 'make dsp_selftest' first" >&2
+  exit 2
+fi
+
+"$SELFTEST"
+
+decoders=(./decoder)
+for b in ./decoder_portable ./decoder_nolibc; do
+  if [[ -x "$b" ]]; then decoders+=("$b"); fi
+done
+
+shopt -s nullglob
+files=(images/webp/*.webp images/testimages/webp/*.webp)
+
+if (( ${#files[@]} == 0 )); then
+  echo "error: no .webp files found under images/webp or images/testimages/webp" >&2
+  exit 2
+fi
+
+tmp=$(mktemp -d)
+trap 'rm -rf "$tmp"' EXIT
+
+for dec in "${decoders[@]}"; do
+  for f in "${files[@]}"; do
+    for fmt in png ppm; do
+      if ! WEBPDEC_CPU=scalar "$dec" "-$fmt" "$f" "$tmp/scalar.$fmt" >/dev/null 2>&1; then
+        continue
+      fi
+      "$dec" "-$fmt" "$f" "$tmp/simd.$fmt" >/dev/null
+      if ! cmp -s "$tmp/scalar.$fmt" "$tmp/simd.$fmt"; then
+        echo "FAIL: $dec -$fmt differs between WEBPDEC_CPU=scalar and the detected level: $f" >&2
+        exit 1
+      fi
+    done
+  done
+done
+
+echo "OK: ${decoders[*]} match WEBPDEC_CPU=scalar on ${#files[@]} files"
+
+if [[ -x ./encoder ]]; then
+  pngs=(images/png-in/*.png images/testimages/png/*.png)
+  for f in "${pngs[@]}"; do
+    if ! WEBPDEC_CPU=scalar ./encoder "$f" "$tmp/scalar.webp" >/dev/null 2>&1; then
+      continue
+    fi
+    ./encoder "$f" "$tmp/simd.webp" >/dev/null
+    if ! cmp -s "$tmp/scalar.webp" "$tmp/simd.webp"; then
+      echo "FAIL: ./encoder output differs between WEBPDEC_CPU=scalar and the detected level: $f" >&2
+      exit 1
+    fi
+  done
+  echo "OK: ./encoder matches WEBPDEC_CPU=scalar on ${#pngs[@]} files"
+fi
@@ -0,0 +1,55 @@
+#!/usr/bin/env bash
+set -euo pipefail
+
+ROOT_DIR=$(CDPATH= cd -- "$(dirname -- "$0")/.." && pwd)
+. "$ROOT_DIR/scripts/common.sh"
+
+tmpdir=$(mk_artifact_tmpdir)
+cleanup() { rm -rf "$tmpdir"; }
+trap cleanup EXIT
+
+enc="$ROOT_DIR/encoder"
+dec="$ROOT_DIR/decoder"
+
+if [[ ! -x "$enc" || ! -x "$dec" ]]; then
+	die "missing encoder/decoder (run 'make' first)"
+fi
+
+( cd "$ROOT_DIR" && make -s enc_png2ppm enc_quality_metrics >/dev/null )
+
+# Multi-macroblock photographic and synthetic inputs. The 16x16 luma paths
+# carry each block's DC through the WHT, so an encoder reconstruction that
+# drifts from the decoder's shows up as a collapse in round-trip PSNR here
+# (tiny single-macroblock images hide it).
+images=(
+	images/testimages/png/radial_400x400.png
+	images/testimages/png/reverend.png
+	images/testimages/png/firework.png
+)
+modes=(i16 dc)
+qualities=(30 75)
+
+# Healthy encodes land at 31..46 dB; a broken reconstruction gives 4..15 dB.
+min_psnr=28
+
+count=0
+for png in "${images[@]}"; do
+	ref_ppm="$tmpdir/ref.ppm"
+	"$ROOT_DIR/build/enc_png2ppm" "$ROOT_DIR/$png" "$ref_ppm" >/dev/null
+	for mode in "${modes[@]}"; do
+		for q in "${qualities[@]}"; do
+			count=$((count + 1))
+			webp="$tmpdir/out.webp"
+			ppm="$tmpdir/out.ppm"
+			"$enc" --q "$q" --mode "$mode" "$ROOT_DIR/$png" "$webp" >/dev/null
+			"$dec" -ppm "$webp" "$ppm"
+			metrics=$("$ROOT_DIR/build/enc_quality_metrics" "$ref_ppm" "$ppm")
+			psnr=$(printf '%s\n' "$metrics" | sed -n 's/.*psnr_rgb=\([^ ]*\).*/\1/p')
+			if ! awk -v p="$psnr" -v m="$min_psnr" 'BEGIN { exit !(p == "inf" || p + 0 >= m) }'; then
+				die "$png --mode $mode --q $q: psnr_rgb=$psnr below ${min_psnr} dB"
+			fi
+		done
+	done
+done
+
+note "OK: i16/dc round-trip PSNR >= ${min_psnr} dB for $count encodes"
@@ -0,0 +1,65 @@
+#!/usr/bin/env bash
+set -euo pipefail
+
+ROOT_DIR=$(CDPATH= cd -- "$(dirname -- "$0")/.." && pwd)
+. "$ROOT_DIR/scripts/common.sh"
+
+# Splitting the DCT tokens into 2, 4 or 8 partitions only changes how they are
+# laid out: every file must report the requested partition count and decode
+# (with our decoder) to the same I420 as the single-partition encode. The
+# 64x64 images have fewer macroblock rows than 8 partitions, so some are
+# empty. Files are also run through webpinfo when it is available.
+
+tmpdir=$(mk_artifact_tmpdir)
+cleanup() { rm -rf "$tmpdir"; }
+trap cleanup EXIT
+
+enc="$ROOT_DIR/encoder"
+dec="$ROOT_DIR/decoder"
+for bin in "$enc" "$dec"; do
+	if [[ ! -x "$bin" ]]; then
+		die "missing $bin (run 'make' first)"
+	fi
+done
+
+resolve_libwebp_tools
+webpinfo="${WEBPINFO:-}"
+
+images=(
+	images/testimages/png/checker_64x64.png
+	images/testimages/png/hgrad_64x64.png
+	images/testimages/png/circle_400x416.png
+	images/testimages/png/color_bars_416x384.png
+)
+
+count=0
+for png in "${images[@]}"; do
+	for mode in bpred-rdo i16 dc; do
+		"$enc" --mode "$mode" "$ROOT_DIR/$png" "$tmpdir/p1.webp" >/dev/null
+		"$dec" -yuv "$tmpdir/p1.webp" "$tmpdir/p1.i420"
+		for parts in 2 4 8; do
+			out="$tmpdir/p$parts.webp"
+			"$enc" --partitions "$parts" --mode "$mode" "$ROOT_DIR/$png" "$out" >/dev/null
+			got=$("$dec" -info "$out" | awk -F: '/Total partitions/ { gsub(/ /, "", $2); print $2 }')
+			if [[ "$got" != "$parts" ]]; then
+				note "FAIL: $png --mode $mode --partitions $parts: decoder -info reports '$got' partitions"
+				exit 1
+			fi
+			"$dec" -yuv "$out" "$tmpdir/p$parts.i420"
+			if ! cmp -s "$tmpdir/p1.i420" "$tmpdir/p$parts.i420"; then
+				note "FAIL: $png --mode $mode --partitions $parts decodes differently from --partitions 1"
+				exit 1
+			fi
+			if [[ -n "$webpinfo" ]] && ! "$webpinfo" "$out" >/dev/null 2>&1; then
+				note "FAIL: webpinfo rejects $png --mode $mode --partitions $parts"
+				exit 1
+			fi
+		done
+		count=$((count + 1))
+	done
+done
+
+if [[ -z "$webpinfo" ]]; then
+	note "SKIP: webpinfo not found; set LIBWEBP_BIN_DIR to also validate with libwebp"
+fi
+note "OK: 2/4/8 token partitions decode like 1 ($count image/mode pairs)"
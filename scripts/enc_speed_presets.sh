@@ -0,0 +1,58 @@
+#!/usr/bin/env bash
+set -euo pipefail
+
+cd "$(dirname "$0")/.."
+
+# Speed vs quality of the encoder --speed presets: build/enc_speed_bench encodes
+# each corpus with every preset in-process, decodes through libwebpdec and
+# prints a Markdown table (the ones in encoder.md). PSNR comes from the SSE
+# summed over the corpus. Fails if a preset does not round-trip or its luma
+# PSNR drops below MIN_PSNR_Y; timings are printed, not checked.
+#
+# Corpora: images/png-in (small synthetic block patterns) and
+# images/testimages/png (multi-macroblock photos and gradients, 1 run each to
+# keep the gate short).
+#
+# Extra arguments go to the tool, e.g. --runs 5 or --q 50.
+
+TOOL=./build/enc_speed_bench
+MIN_PSNR_Y=38
+
+if [[ ! -x "$TOOL" ]]; then
+  echo "note: building $TOOL" >&2
+  make enc_speed_bench >/dev/null
+fi
+
+shopt -s nullglob
+
+# run_corpus <dir> [tool args...]
+run_corpus() {
+  local dir=$1
+  shift
+  local files=("$dir"/*.png)
+  if (( ${#files[@]} == 0 )); then
+    echo "error: no .png files found under $dir" >&2
+    exit 2
+  fi
+
+  echo "$dir:"
+  local table
+  table="$("$TOOL" "$@" "${files[@]}")"
+  echo "$table"
+  echo
+
+  # Rows: | speed | strategy | encode ms | vs speed 0 | bytes | PSNR Y | PSNR YUV |
+  if ! awk -F'|' -v min="$MIN_PSNR_Y" '
+    $2 ~ /^ [0-9]+ $/ { rows++; if ($7 + 0 < min) { printf "error: speed%s PSNR Y%s < %s\n", $2, $7, min > "/dev/stderr"; bad = 1 } }
+    END { exit (bad || rows != 7) }' <<<"$table"; then
+    echo "FAIL: encoder speed presets ($dir)" >&2
+    exit 1
+  fi
+  nfiles=$((nfiles + ${#files[@]}))
+}
+
+nfiles=0
+run_corpus images/png-in "$@"
+run_corpus images/testimages/png --runs 1 "$@"
+
+echo "OK: encoder speed presets round-trip ($nfiles files)" >&2
@@ -0,0 +1,61 @@
+#!/usr/bin/env bash
+set -euo pipefail
+
+ROOT_DIR=$(CDPATH= cd -- "$(dirname -- "$0")/.." && pwd)
+. "$ROOT_DIR/scripts/common.sh"
+
+# The wavefront macroblock analysis must not change the bitstream: every mode
+# is encoded with --threads 1 and with 2, 3 and 8 threads, and the files must
+# be byte-identical. The images have enough macroblock columns for several
+# rows to be in flight (the analysis caps threads at (mb_cols + 1) / 2).
+#
+# The last variant runs the bpred-rdo stats pre-pass under --mb-skip: the main
+# pass must overwrite everything the pre-pass wrote (a stale I16 Y2 left on a
+# B_PRED macroblock makes the writer reject the frame; radial_400x400 at q30
+# has such macroblocks).
+
+tmpdir=$(mk_artifact_tmpdir)
+cleanup() { rm -rf "$tmpdir"; }
+trap cleanup EXIT
+
+enc="$ROOT_DIR/encoder"
+if [[ ! -x "$enc" ]]; then
+	die "missing $enc (run 'make' first)"
+fi
+
+images=(
+	images/testimages/png/checker_64x64.png
+	images/testimages/png/diag_line_64x64.png
+	images/testimages/png/hgrad_64x64.png
+	images/testimages/png/circle_400x416.png
+	images/testimages/png/color_bars_416x384.png
+	images/testimages/png/radial_400x400.png
+)
+
+variants=(
+	"--mode bpred-rdo"
+	"--mode bpred"
+	"--mode i16"
+	"--mode dc"
+	"--mode bpred-rdo --q 30 --mb-skip --bpred-rdo-stats-sample 1"
+)
+
+count=0
+for png in "${images[@]}"; do
+	for variant in "${variants[@]}"; do
+		read -r -a flags <<<"$variant"
+		ref="$tmpdir/ref.webp"
+		"$enc" --threads 1 "${flags[@]}" "$ROOT_DIR/$png" "$ref" >/dev/null || die "$png $variant --threads 1: encode failed"
+		for threads in 2 3 8; do
+			out="$tmpdir/t$threads.webp"
+			"$enc" --threads "$threads" "${flags[@]}" "$ROOT_DIR/$png" "$out" >/dev/null || die "$png $variant --threads $threads: encode failed"
+			if ! cmp -s "$ref" "$out"; then
+				note "mismatch: $png $variant --threads $threads differs from --threads 1"
+				exit 1
+			fi
+		done
+		count=$((count + 1))
+	done
+done
+
+note "OK: encoder output is identical for 1/2/3/8 analysis threads ($count image/variant pairs)"
@@ -0,0 +1,30 @@
+#!/usr/bin/env bash
+set -euo pipefail
+
+cd "$(dirname "$0")/.."
+
+# Token cost tables (enc_vp8_token_costs_*) vs the dry-run bool-encoder bitcount
+# they replace in bpred-rdo: build/enc_token_costs_check encodes each PNG and
+# fails if any macroblock's table cost leaves the window it documents, for the
+# default and the adaptive probabilities. Timings are printed, not checked.
+
+TOOL=./build/enc_token_costs_check
+
+if [[ ! -x "$TOOL" ]]; then
+  echo "note: building $TOOL" >&2
+  make enc_token_costs_check >/dev/null
+fi
+
+shopt -s nullglob
+files=(images/png-in/*.png images/testimages/png/*.png)
+
+if (( ${#files[@]} == 0 )); then
+  echo "error: no .png files found under images/png-in or images/testimages/png" >&2
+  exit 2
+fi
+
+for q in 10 50 90; do
+  "$TOOL" --q "$q" "${files[@]}" >/dev/null
+done
+
+echo "OK: token cost tables agree with the dry-run bitcount (${#files[@]} files, q 10/50/90)" >&2
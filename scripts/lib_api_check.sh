@@ -0,0 +1,64 @@
+#!/usr/bin/env bash
+set -euo pipefail
+
+cd "$(dirname "$0")/.."
+
+# Checks that the webpdec.h library API (via build/webpdec_apidump, which decodes
+# into padded-stride buffers) produces exactly the same pixels as the CLI.
+
+DECODER=./decoder
+APIDUMP=./build/webpdec_apidump
+
+for b in "$DECODER" "$APIDUMP"; do
+  if [[ ! -x "$b" ]]; then
+    echo "error: $b not found; run 'make' and 'make webpdec_apidump' first" >&2
+    exit 2
+  fi
+done
+
+shopt -s nullglob
+files=(images/webp/*.webp images/testimages/webp/*.webp images/generated/webp/*.webp)
+
+if (( ${#files[@]} == 0 )); then
+  echo "error: no .webp files found under images/webp, images/testimages/webp, or images/generated/webp" >&2
+  exit 2
+fi
+
+tmp=$(mktemp -d)
+trap 'rm -rf "$tmp"' EXIT
+
+for f in "${files[@]}"; do
+  if ! "$DECODER" -ppm "$f" "$tmp/cli.ppm" >/dev/null 2>&1; then
+    # Inputs the CLI rejects must be rejected by the library too.
+    if "$APIDUMP" "$f" rgb "$tmp/api.ppm" >/dev/null 2>&1; then
+      echo "FAIL: library accepted input rejected by decoder: $f" >&2
+      exit 1
+    fi
+    continue
+  fi
+  "$DECODER" -pam "$f" "$tmp/cli.pam" >/dev/null
+  "$DECODER" -yuvf "$f" "$tmp/cli.i420" >/dev/null
+
+  for mode in rgb rgba; do
+    ext=$([[ $mode == rgb ]] && echo ppm || echo pam)
+    if ! "$APIDUMP" "$f" "$mode" "$tmp/api.$ext"; then
+      echo "FAIL: webpdec_apidump $mode failed: $f" >&2
+      exit 1
+    fi
+    if ! cmp -s "$tmp/cli.$ext" "$tmp/api.$ext"; then
+      echo "FAIL: $mode output differs from decoder -$ext: $f" >&2
+      exit 1
+    fi
+  done
+
+  if ! "$APIDUMP" "$f" i420 "$tmp/api.i420"; then
+    echo "FAIL: webpdec_apidump i420 failed: $f" >&2
+    exit 1
+  fi
+  if ! cmp -s "$tmp/cli.i420" "$tmp/api.i420"; then
+    echo "FAIL: i420 output differs from decoder -yuvf: $f" >&2
+    exit 1
+  fi
+done
+
+echo "OK: library API output matches decoder -ppm/-pam/-yuvf for ${#files[@]} files"
@@ -0,0 +1,119 @@
+#!/usr/bin/env bash
+set -euo pipefail
+
+cd "$(dirname "$0")/.."
+
+# Checks the -preview DC-only decode (one pixel per 4x4 block, no IDCT, no loop filter):
+# - output is ceil(w/4) x ceil(h/4) and -ppm/-png/-pam agree on RGB;
+# - on images whose blocks carry only DC (flat, checker, gradients), -preview -yuv
+#   equals the unfiltered -yuv decode sampled at every 4th pixel;
+# - the loop filter is skipped (-timings);
+# - an alpha still's alpha is the plane sampled at (4x, 4y);
+# - -preview with other commands or with -crop is rejected.
+
+DECODER=./decoder
+
+if [[ ! -x "$DECODER" ]]; then
+  echo "error: $DECODER not found; run 'make' first" >&2
+  exit 2
+fi
+
+decoders=("$DECODER")
+if [[ -x ./decoder_nolibc ]]; then decoders+=(./decoder_nolibc); fi
+
+PYTHONPATH=scripts DECODERS="$(printf '%s\n' "${decoders[@]}")" python3 - <<'PY'
+import json
+import os
+import subprocess
+import sys
+import tempfile
+
+from check_helpers import alpha_still, env_list, png, pnm, read, run, size_of
+
+decoders = env_list("DECODERS")
+dec = decoders[0]
+
+def rgb_of(img):
+  w, h, c, px = img
+  if c == 3:
+    return w, h, px
+  return w, h, b"".join(px[i:i + 3] for i in range(0, len(px), 4))
+
+def sample_i420(data, w, h):
+  # Every 4th pixel of each plane of a w x h I420 frame, laid out as the
+  # ceil(w/4) x ceil(h/4) preview.
+  pw, ph = (w + 3) // 4, (h + 3) // 4
+  uw, uh = (w + 1) // 2, (h + 1) // 2
+  ys, us, vs = data[:w * h], data[w * h:w * h + uw * uh], data[w * h + uw * uh:]
+  def plane(p, stride, qw, qh):
+    return bytes(p[4 * y * stride + 4 * x] for y in range(qh) for x in range(qw))
+  cw, ch = (pw + 1) // 2, (ph + 1) // 2
+  return plane(ys, w, pw, ph) + plane(us, uw, cw, ch) + plane(vs, uw, cw, ch)
+
+T = "images/testimages/webp"
+G = "images/generated/webp"
+files = [f"{T}/firework.webp", f"{T}/whale.webp", f"{T}/w3c_home.webp", f"{T}/center_square.webp",
+         f"{G}/gen_checker_17x17_q50.webp", f"{G}/gen_rgbgrad_129x129_q10.webp"]
+dc_only = [f"{T}/checker_432x384.webp", f"{T}/xygrad_448x400.webp",
+           f"{T}/box_border_400x448.webp", f"{G}/gen_checker_33x33_q90.webp", f"{G}/gen_checker_65x65_q10.webp",
+           f"{G}/gen_rgbgrad_416x384_q50.webp", f"{G}/gen_rgbgrad_63x63_q10.webp", f"{G}/gen_solid_17x17_q50.webp"]
+
+checked = 0
+with tempfile.TemporaryDirectory() as tmp:
+  alpha_path = os.path.join(tmp, "alpha.webp")
+  alpha_plane = alpha_still(files[3], alpha_path)
+  for path in files + dc_only + [alpha_path]:
+    w, h = size_of(path)
+    pw, ph = (w + 3) // 4, (h + 3) // 4
+    outs = {}
+    for d in decoders:
+      for cmd in ("-ppm", "-pam", "-png", "-yuv"):
+        out = os.path.join(tmp, "p" + cmd)
+        run([d, "-preview", cmd, path, out])
+        data = read(out) if cmd == "-yuv" else {"-png": png}.get(cmd, pnm)(out)
+        if d != dec and data != outs[cmd]:
+          sys.exit(f"FAIL: {d} -preview {cmd} {path} differs from {dec}")
+        outs[cmd] = data
+        checked += 1
+    rgb = {cmd: rgb_of(outs[cmd]) for cmd in ("-ppm", "-pam", "-png")}
+    if rgb["-ppm"][:2] != (pw, ph):
+      sys.exit(f"FAIL: -preview {path} is {rgb['-ppm'][0]}x{rgb['-ppm'][1]}, expected {pw}x{ph}")
+    if rgb["-pam"] != rgb["-ppm"] or rgb["-png"] != rgb["-ppm"]:
+      sys.exit(f"FAIL: -preview {path}: -ppm/-pam/-png RGB differ")
+    if len(outs["-yuv"]) != pw * ph + 2 * ((pw + 1) // 2) * ((ph + 1) // 2):
+      sys.exit(f"FAIL: -preview -yuv {path} has {len(outs['-yuv'])} bytes")
+
+    if path in dc_only:
+      run([dec, "-yuv", path, os.path.join(tmp, "full.i420")])
+      if outs["-yuv"] != sample_i420(read(os.path.join(tmp, "full.i420")), w, h):
+        sys.exit(f"FAIL: -preview -yuv {path} != -yuv sampled at every 4th pixel")
+    if path == alpha_path:
+      expect = bytes(alpha_plane[4 * y * w + 4 * x] for y in range(ph) for x in range(pw))
+      for cmd in ("-pam", "-png"):
+        if outs[cmd][2] != 4 or outs[cmd][3][3::4] != expect:
+          sys.exit(f"FAIL: -preview {cmd} alpha != the ALPH plane sampled at (4x, 4y)")
+
+  # Same token decode, no loop filter, less reconstruction.
+  def timings(args):
+    p = run([dec, "-timings"] + args + [os.path.join(tmp, "t.out")])
+    return json.loads(p.stderr.decode().strip().splitlines()[-1])
+  full, prev = timings(["-ppm", files[0]]), timings(["-preview", "-ppm", files[0]])
+  if prev["ns"]["loopfilter"] != 0 or full["ns"]["loopfilter"] == 0:
+    sys.exit(f"FAIL: -preview ran the loop filter ({prev['ns']['loopfilter']} ns)")
+  if prev["counts"]["tokens"] != full["counts"]["tokens"]:
+    sys.exit(f"FAIL: -preview decoded {prev['counts']['tokens']} tokens, full decode {full['counts']['tokens']}")
+
+  bad = [
+    (["-preview", "-yuvf"], "only applies"),
+    (["-preview", "-info"], "only applies"),
+    (["-preview", "-crop", "0,0,8,8", "-ppm"], "only applies"),
+  ]
+  for d in decoders:
+    for args, msg in bad:
+      paths = [files[0]] if args[-1] == "-info" else [files[0], os.path.join(tmp, "bad.out")]
+      p = subprocess.run([d] + args + paths, capture_output=True)
+      if p.returncode == 0 or msg not in p.stderr.decode():
+        sys.exit(f"FAIL: {d} {' '.join(args)}: rc={p.returncode} stderr={p.stderr.decode().strip()!r}")
+
+print(f"OK: -preview checked on {checked} decodes ({', '.join(decoders)})")
+PY
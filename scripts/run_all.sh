@@ -61,7 +61,16 @@ run_gates_parallel "Decoder gates" \
 	./scripts/m6_compare_yuv_with_dwebp.sh \
 	./scripts/m7_compare_yuv_filtered_with_oracle.sh \
 	./scripts/m8_compare_ppm_with_dwebp.sh \
-	./scripts/m8_compare_png_with_ppm.sh
+	./scripts/m8_compare_png_with_ppm.sh \
+	./scripts/lib_api_check.sh \
+	./scripts/dsp_dispatch_check.sh \
+	./scripts/timings_check.sh \
+	./scripts/bench_check.sh \
+	./scripts/anim_check.sh \
+	./scripts/alpha_check.sh \
+	./scripts/crop_check.sh \
+	./scripts/preview_check.sh \
+	./scripts/stdio_check.sh
 
 echo
 
@@ -77,7 +86,12 @@ run_gates_parallel "Encoder gates" \
 	./scripts/enc_m08_tokens_check.sh \
 	./scripts/enc_m09_dcenc_check.sh \
 	./scripts/enc_m09_modeenc_check.sh \
+	./scripts/enc_i16_roundtrip_check.sh \
 	./scripts/enc_m09_bpredenc_check.sh \
+	./scripts/enc_token_costs_check.sh \
+	./scripts/enc_speed_presets.sh \
+	./scripts/enc_threads_check.sh \
+	./scripts/enc_partitions_check.sh \
 	./scripts/enc_m10_loopfilter_check.sh \
 	./scripts/enc_ultra_parity_check.sh \
 	./scripts/enc_quality_check.sh
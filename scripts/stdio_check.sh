@@ -0,0 +1,98 @@
+#!/usr/bin/env bash
+set -euo pipefail
+
+cd "$(dirname "$0")/.."
+
+# Checks "-" as stdin/stdout:
+# - every decoder command (and decoder_nolibc / decoder_nolibc_ultra if built) gives
+#   the same bytes with "-" in either position as with files, for piped input (small
+#   and >64 KiB, which grows the stream buffer) and for stdin redirected from a file;
+# - -info reads stdin; -anim_png/-anim_yuv reject "-" as an output prefix;
+# - the encoder (and encoder_nolibc_ultra if built) reads a piped PNG and writes
+#   the same WebP to stdout as file to file.
+
+DECODER=./decoder
+ENCODER=./encoder
+
+for b in "$DECODER" "$ENCODER"; do
+  if [[ ! -x "$b" ]]; then
+    echo "error: $b not found; run 'make' first" >&2
+    exit 2
+  fi
+done
+
+decoders=("$DECODER")
+if [[ -x ./decoder_nolibc ]]; then decoders+=(./decoder_nolibc); fi
+encoders=("$ENCODER")
+if [[ -x ./encoder_nolibc_ultra ]]; then encoders+=(./encoder_nolibc_ultra); fi
+ULTRA=""
+if [[ -x ./decoder_nolibc_ultra ]]; then ULTRA=./decoder_nolibc_ultra; fi
+
+PYTHONPATH=scripts DECODERS="$(printf '%s\n' "${decoders[@]}")" ENCODERS="$(printf '%s\n' "${encoders[@]}")" ULTRA="$ULTRA" python3 - <<'PY'
+import os
+import subprocess
+import sys
+import tempfile
+
+from check_helpers import env_list, read, run
+
+decoders = env_list("DECODERS")
+encoders = env_list("ENCODERS")
+ultra = os.environ["ULTRA"]
+
+files = ["images/testimages/webp/firework.webp", "images/generated/webp/gen_checker_17x17_q50.webp",
+         "images/commons/penguin-q20.webp"]
+if os.path.getsize(files[-1]) <= 64 << 10:
+  sys.exit(f"FAIL: {files[-1]} no longer exceeds the 64 KiB read buffer")
+
+checked = 0
+with tempfile.TemporaryDirectory() as tmp:
+  out = os.path.join(tmp, "out")
+  for path in files:
+    data = read(path)
+    for d in decoders:
+      for cmd in ("-ppm", "-pam", "-png", "-yuv", "-yuvf"):
+        run([d, cmd, path, out])
+        expect = read(out)
+        if run([d, cmd, "-", "-"], data=data).stdout != expect:
+          sys.exit(f"FAIL: {d} {cmd} - - (pipe) differs from {cmd} {path} <file>")
+        with open(path, "rb") as f:
+          if run([d, cmd, "-", "-"], stdin=f).stdout != expect:
+            sys.exit(f"FAIL: {d} {cmd} - - (redirected file) differs for {path}")
+        if run([d, cmd, path, "-"]).stdout != expect:
+          sys.exit(f"FAIL: {d} {cmd} {path} - differs from the file output")
+        run([d, cmd, "-", out], data=data)
+        if read(out) != expect:
+          sys.exit(f"FAIL: {d} {cmd} - <file> differs for {path}")
+        checked += 4
+      # Same report apart from the "File:" line.
+      info = run([d, "-info", path]).stdout.split(b"\n", 1)[1]
+      if run([d, "-info", "-"], data=data).stdout.split(b"\n", 1)[1] != info:
+        sys.exit(f"FAIL: {d} -info - differs from -info {path}")
+    if ultra:
+      run([ultra, path, out])
+      if run([ultra, "-", "-"], data=data).stdout != read(out):
+        sys.exit(f"FAIL: {ultra} - - differs for {path}")
+      checked += 1
+
+  for d in decoders:
+    for cmd in ("-anim_png", "-anim_yuv"):
+      p = subprocess.run([d, cmd, files[0], "-"], capture_output=True)
+      if p.returncode == 0 or b"cannot write to stdout" not in p.stderr:
+        sys.exit(f"FAIL: {d} {cmd} {files[0]} - was not rejected: {p.stderr.decode().strip()!r}")
+    p = subprocess.run([d, "-ppm", "-", out], input=b"", capture_output=True)
+    if p.returncode == 0:
+      sys.exit(f"FAIL: {d} accepted an empty stdin")
+
+  for png in ("images/png-in/blockcheck2_16x16_000_000_000_255_255_255.png", "images/testimages/png/whale.png"):
+    data = read(png)
+    for e in encoders:
+      args = [e] if e.endswith("ultra") else [e, "--q", "60"]
+      run(args + [png, out])
+      expect = read(out)
+      if run(args + ["-", "-"], data=data).stdout != expect:
+        sys.exit(f"FAIL: {e} - - differs from file output for {png}")
+      checked += 1
+
+print(f"OK: - as stdin/stdout checked on {checked} runs ({', '.join(decoders + encoders + ([ultra] if ultra else []))})")
+PY
@@ -0,0 +1,91 @@
+#!/usr/bin/env bash
+set -euo pipefail
+
+cd "$(dirname "$0")/.."
+
+# Checks `decoder -timings` (src/common/timing.h):
+# - output files are byte-identical with and without -timings;
+# - stderr carries exactly one JSON line with every stage and count, the stages
+#   sum to no more than the total, and bytes_written matches the output size;
+# - the line survives an input path longer than any fixed buffer.
+
+DECODER=./decoder
+
+if [[ ! -x "$DECODER" ]]; then
+  echo "error: $DECODER not found; run 'make' first" >&2
+  exit 2
+fi
+
+shopt -s nullglob
+files=(images/webp/*.webp images/testimages/webp/*.webp)
+
+if (( ${#files[@]} == 0 )); then
+  echo "error: no .webp files found under images/webp or images/testimages/webp" >&2
+  exit 2
+fi
+
+decoders=("$DECODER")
+if [[ -x ./decoder_nolibc ]]; then decoders+=(./decoder_nolibc); fi
+
+FILES="$(printf '%s\n' "${files[@]}")" DECODERS="$(printf '%s\n' "${decoders[@]}")" python3 - <<'PY'
+import json
+import os
+import subprocess
+import sys
+import tempfile
+
+STAGES = ["file_map", "container", "header", "modes", "tokens", "recon", "loopfilter", "color", "compress", "write"]
+COUNTS = ["bool_decodes", "tokens", "nonzero_blocks", "bytes_written"]
+
+files = [f for f in os.environ["FILES"].splitlines() if f]
+decoders = [d for d in os.environ["DECODERS"].splitlines() if d]
+checked = 0
+
+with tempfile.TemporaryDirectory() as tmp:
+  plain = os.path.join(tmp, "plain")
+  timed = os.path.join(tmp, "timed")
+  for dec in decoders:
+    for f in files:
+      for cmd in ("yuv", "yuvf", "ppm", "png"):
+        if subprocess.run([dec, "-" + cmd, f, plain], capture_output=True).returncode != 0:
+          continue
+        p = subprocess.run([dec, "-timings", "-" + cmd, f, timed], capture_output=True)
+        if p.returncode != 0:
+          sys.exit(f"FAIL: {dec} -timings -{cmd} failed: {f}")
+        with open(plain, "rb") as a, open(timed, "rb") as b:
+          if a.read() != b.read():
+            sys.exit(f"FAIL: {dec} -{cmd} output differs with -timings: {f}")
+        lines = p.stderr.decode().splitlines()
+        if len(lines) != 1:
+          sys.exit(f"FAIL: {dec} -timings -{cmd} wrote {len(lines)} stderr lines: {f}")
+        j = json.loads(lines[0])
+        if j["cmd"] != cmd or j["file"] != f or j["width"] <= 0 or j["height"] <= 0:
+          sys.exit(f"FAIL: {dec} -timings -{cmd} bad header fields: {f}: {lines[0]}")
+        ns = j["ns"]
+        missing = [k for k in STAGES + ["total"] if k not in ns] + [k for k in COUNTS if k not in j["counts"]]
+        if missing:
+          sys.exit(f"FAIL: {dec} -timings -{cmd} missing {missing}: {f}")
+        if sum(ns[k] for k in STAGES) > ns["total"]:
+          sys.exit(f"FAIL: {dec} -timings -{cmd} stages exceed total: {f}: {lines[0]}")
+        if j["counts"]["bytes_written"] != os.path.getsize(timed):
+          sys.exit(f"FAIL: {dec} -timings -{cmd} bytes_written != output size: {f}")
+        if j["counts"]["bool_decodes"] == 0:
+          sys.exit(f"FAIL: {dec} -timings -{cmd} counted no bool decodes: {f}")
+        checked += 1
+
+  # The JSON line has no length limit: a file name far past any fixed buffer
+  # must still come back whole.
+  deep = os.path.join(tmp, *(["d" * 200] * 4))
+  os.makedirs(deep)
+  longf = os.path.join(deep, "in.webp")
+  with open(files[0], "rb") as a, open(longf, "wb") as b:
+    b.write(a.read())
+  for dec in decoders:
+    p = subprocess.run([dec, "-timings", "-yuv", longf, timed], capture_output=True)
+    lines = p.stderr.decode().splitlines()
+    if p.returncode != 0 or len(lines) != 1 or json.loads(lines[0])["file"] != longf:
+      sys.exit(f"FAIL: {dec} -timings with a {len(longf)}-byte path: rc={p.returncode} stderr={p.stderr[:200]!r}")
+    checked += 1
+
+print(f"OK: -timings checked on {checked} decodes ({', '.join(decoders)})")
+PY
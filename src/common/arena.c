@@ -0,0 +1,107 @@
+// MAP_ANONYMOUS and madvise() are not C11/POSIX.
+#ifndef _DEFAULT_SOURCE
+#define _DEFAULT_SOURCE
+#endif
+
+#include "arena.h"
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+
+static int align_up(size_t n, size_t* out) {
+	if (n > SIZE_MAX - (ARENA_ALIGN - 1u)) return -1;
+	*out = (n + (ARENA_ALIGN - 1u)) & ~(size_t)(ARENA_ALIGN - 1u);
+	return 0;
+}
+
+int arena_reserve(size_t* io_total, size_t nmemb, size_t size) {
+	size_t bytes = 0;
+	if (nmemb != 0 && size > SIZE_MAX / nmemb) {
+		errno = ENOMEM;
+		return -1;
+	}
+	if (align_up(nmemb * size, &bytes) != 0 || bytes > SIZE_MAX - *io_total) {
+		errno = ENOMEM;
+		return -1;
+	}
+	*io_total += bytes;
+	return 0;
+}
+
+#if defined(MAP_ANONYMOUS)
+// Anonymous pages come zeroed and page-aligned. Advising huge pages before the
+// first touch lets a 4K frame's planes fault in as a few 2 MiB pages (a hint;
+// older kernels ignore it). The pages are not prefaulted: a -crop decode
+// touches only the macroblock rows it needs of an arena sized for the frame.
+static int arena_map(Arena* a, size_t size) {
+	void* p = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (p == MAP_FAILED) return -1;
+#ifdef MADV_HUGEPAGE
+	(void)madvise(p, size, MADV_HUGEPAGE);
+#endif
+	a->raw = p;
+	a->raw_size = size;
+	a->base = (uint8_t*)p;
+	a->mapped = 1;
+	return 0;
+}
+#endif
+
+int arena_init(Arena* a, size_t size) {
+	if (!a) {
+		errno = EINVAL;
+		return -1;
+	}
+	memset(a, 0, sizeof(*a));
+	if (size == 0) size = ARENA_ALIGN;
+	if (align_up(size, &size) != 0) {
+		errno = ENOMEM;
+		return -1;
+	}
+#if defined(MAP_ANONYMOUS)
+	if (size >= ARENA_MMAP_MIN && arena_map(a, size) == 0) {
+		a->size = size;
+		return 0;
+	}
+#endif
+	if (size > SIZE_MAX - ARENA_ALIGN) {
+		errno = ENOMEM;
+		return -1;
+	}
+	a->raw = calloc(1, size + ARENA_ALIGN);
+	if (!a->raw) {
+		errno = ENOMEM;
+		return -1;
+	}
+	a->raw_size = size + ARENA_ALIGN;
+	a->base = (uint8_t*)(((uintptr_t)a->raw + (ARENA_ALIGN - 1u)) & ~(uintptr_t)(ARENA_ALIGN - 1u));
+	a->size = size;
+	return 0;
+}
+
+void* arena_alloc(Arena* a, size_t nmemb, size_t size) {
+	size_t bytes = 0;
+	if (!a || !a->base || arena_reserve(&bytes, nmemb, size) != 0 || bytes > a->size - a->used) {
+		errno = ENOMEM;
+		return NULL;
+	}
+	void* p = a->base + a->used;
+	a->used += bytes;
+	return p;
+}
+
+void arena_free(Arena* a) {
+	if (!a) return;
+#if defined(MAP_ANONYMOUS)
+	if (a->mapped) {
+		(void)munmap(a->raw, a->raw_size);
+	} else {
+		free(a->raw);
+	}
+#else
+	free(a->raw);
+#endif
+	memset(a, 0, sizeof(*a));
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Bump allocator for per-frame decoder state. The caller adds up every buffer
+// it needs with arena_reserve(), makes one allocation with arena_init() and
+// carves the buffers out with arena_alloc(); arena_free() releases them all at
+// once. Memory is zeroed and every buffer is ARENA_ALIGN-byte aligned.
+//
+// Arenas of at least ARENA_MMAP_MIN bytes are mapped directly (advised for
+// transparent huge pages where available) instead of going through malloc.
+
+enum {
+	ARENA_ALIGN = 64,
+	ARENA_MMAP_MIN = 2 << 20,
+};
+
+typedef struct {
+	uint8_t* base; // ARENA_ALIGN-aligned start
+	size_t size;
+	size_t used;
+	void* raw; // what malloc/mmap returned
+	size_t raw_size;
+	uint8_t mapped;
+} Arena;
+
+// Adds nmemb * size bytes (rounded up to ARENA_ALIGN) to *io_total.
+// Returns 0, or -1 with errno ENOMEM on overflow.
+int arena_reserve(size_t* io_total, size_t nmemb, size_t size);
+
+// Allocates `size` zeroed bytes. Returns 0, or -1 with errno.
+int arena_init(Arena* a, size_t size);
+
+// Returns the next nmemb * size bytes, or NULL with errno ENOMEM when they do
+// not fit (the request was not covered by arena_reserve()).
+void* arena_alloc(Arena* a, size_t nmemb, size_t size);
+
+void arena_free(Arena* a);
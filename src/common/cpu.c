@@ -0,0 +1,89 @@
+#include "cpu.h"
+
+#include <stdlib.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <cpuid.h>
+#define CPU_X86 1
+#else
+#define CPU_X86 0
+#endif
+
+static const char* const k_level_names[] = {"scalar", "sse2", "ssse3", "sse4.1", "avx2"};
+
+const char* cpu_level_name(CpuLevel level) {
+	if ((unsigned)level > (unsigned)CPU_LEVEL_AVX2) return "?";
+	return k_level_names[level];
+}
+
+#if CPU_X86
+static uint64_t xgetbv0(void) {
+	uint32_t lo, hi;
+	__asm__ volatile("xgetbv" : "=a"(lo), "=d"(hi) : "c"(0));
+	return ((uint64_t)hi << 32) | lo;
+}
+#endif
+
+CpuLevel cpu_detect_level(void) {
+#if CPU_X86
+	unsigned eax, ebx, ecx, edx;
+	if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx)) return CPU_LEVEL_SCALAR;
+	if (!(edx & bit_SSE2)) return CPU_LEVEL_SCALAR;
+	if (!(ecx & bit_SSSE3)) return CPU_LEVEL_SSE2;
+	if (!(ecx & bit_SSE4_1)) return CPU_LEVEL_SSSE3;
+
+	// AVX2 needs the instruction bit and the OS saving YMM state (XCR0 bits 1+2).
+	const int osxsave_avx = (ecx & bit_OSXSAVE) && (ecx & bit_AVX);
+	if (!osxsave_avx || (xgetbv0() & 6u) != 6u) return CPU_LEVEL_SSE41;
+	if (!__get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx)) return CPU_LEVEL_SSE41;
+	if (!(ebx & bit_AVX2)) return CPU_LEVEL_SSE41;
+	return CPU_LEVEL_AVX2;
+#else
+	return CPU_LEVEL_SCALAR;
+#endif
+}
+
+static int str_eq(const char* a, const char* b) {
+	while (*a && *a == *b) {
+		a++;
+		b++;
+	}
+	return *a == *b;
+}
+
+CpuLevel cpu_level(void) {
+	// Threads racing here compute the same value, so a relaxed store suffices.
+	static atomic_int cached = -1;
+	const int seen = atomic_load_explicit(&cached, memory_order_relaxed);
+	if (seen >= 0) return (CpuLevel)seen;
+
+	CpuLevel level = cpu_detect_level();
+	const char* force = getenv("WEBPDEC_CPU");
+	if (force && *force) {
+		for (int i = 0; i <= (int)CPU_LEVEL_AVX2; i++) {
+			if (str_eq(force, k_level_names[i])) {
+				if ((CpuLevel)i < level) level = (CpuLevel)i;
+				break;
+			}
+		}
+	}
+	atomic_store_explicit(&cached, (int)level, memory_order_relaxed);
+	return level;
+}
+
+// CpuOnce.state: 0 not started, 1 init() running, 2 done.
+void cpu_once_slow(CpuOnce* once, void (*init)(void)) {
+	int expected = 0;
+	if (atomic_compare_exchange_strong_explicit(&once->state, &expected, 1, memory_order_acquire,
+	                                            memory_order_acquire)) {
+		init();
+		atomic_store_explicit(&once->state, 2, memory_order_release);
+		return;
+	}
+	// Another thread is filling the table; that takes microseconds.
+	while (atomic_load_explicit(&once->state, memory_order_acquire) != 2) {
+#if CPU_X86
+		__builtin_ia32_pause();
+#endif
+	}
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <stdatomic.h>
+#include <stdint.h>
+
+// x86 SIMD feature levels, ordered: each level implies all lower ones.
+typedef enum {
+	CPU_LEVEL_SCALAR = 0,
+	CPU_LEVEL_SSE2 = 1,
+	CPU_LEVEL_SSSE3 = 2,
+	CPU_LEVEL_SSE41 = 3,
+	CPU_LEVEL_AVX2 = 4,
+} CpuLevel;
+
+// Highest level supported by this CPU (cpuid + OS XSAVE state for AVX2).
+// Always CPU_LEVEL_SCALAR on non-x86 targets.
+CpuLevel cpu_detect_level(void);
+
+// Level used by the DSP dispatch: cpu_detect_level(), optionally lowered via the
+// WEBPDEC_CPU environment variable (scalar|sse2|ssse3|sse4.1|avx2). Requests above
+// the detected level are clamped. Computed once.
+CpuLevel cpu_level(void);
+
+const char* cpu_level_name(CpuLevel level);
+
+// One-time initialization of a lazily built table (the DSP dispatch tables).
+// A zeroed CpuOnce (static storage) runs `init` exactly once; every caller
+// returns only after it has finished, so the table can then be read from any
+// thread. The check after that is one acquire load.
+typedef struct {
+	atomic_int state;
+} CpuOnce;
+
+void cpu_once_slow(CpuOnce* once, void (*init)(void));
+
+static inline void cpu_once(CpuOnce* once, void (*init)(void)) {
+	if (atomic_load_explicit(&once->state, memory_order_acquire) != 2) cpu_once_slow(once, init);
+}
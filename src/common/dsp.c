@@ -0,0 +1,41 @@
+#include "dsp.h"
+
+// The ultra build stays scalar-only: no SIMD objects, no cpuid, smallest code.
+#if !defined(DECODER_ULTRA) && (defined(__x86_64__) || defined(__i386__))
+#define DSP_HAVE_X86 1
+#else
+#define DSP_HAVE_X86 0
+#endif
+
+void vp8_dsp_init_level(Vp8Dsp* out, CpuLevel level) {
+#if DSP_HAVE_X86
+	CpuLevel max = cpu_detect_level();
+	if (level > max) level = max;
+#else
+	level = CPU_LEVEL_SCALAR;
+#endif
+	vp8_dsp_init_scalar(out);
+#if DSP_HAVE_X86
+	if (level >= CPU_LEVEL_SSE2) vp8_dsp_init_sse2(out);
+	if (level >= CPU_LEVEL_SSSE3) vp8_dsp_init_ssse3(out);
+	// No SSE4.1-specific kernels: that level runs the SSSE3 table.
+	if (level >= CPU_LEVEL_AVX2) vp8_dsp_init_avx2(out);
+#endif
+	out->level = level;
+}
+
+static Vp8Dsp g_dsp;
+static CpuOnce g_dsp_once;
+
+static void dsp_init_once(void) {
+#if DSP_HAVE_X86
+	vp8_dsp_init_level(&g_dsp, cpu_level());
+#else
+	vp8_dsp_init_level(&g_dsp, CPU_LEVEL_SCALAR);
+#endif
+}
+
+const Vp8Dsp* vp8_dsp(void) {
+	cpu_once(&g_dsp_once, dsp_init_once);
+	return &g_dsp;
+}
@@ -0,0 +1,82 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "cpu.h"
+
+// Hot decoder kernels, dispatched at runtime on the CPU level (see cpu.h).
+// Every variant is bit-exact with the scalar reference in dsp_scalar.c.
+
+// Loop filter edge: q0 points at the first pixel after the edge; step 1 walks
+// across a vertical edge, `stride` across a horizontal one. size_blocks is
+// 2 for a 16-pixel luma edge and 1 for an 8-pixel chroma edge.
+typedef void (*Vp8LfNormalFn)(uint8_t* q0, int stride, int edge_limit, int interior_limit, int hev_threshold,
+                              int size_blocks);
+typedef void (*Vp8LfSimpleFn)(uint8_t* q0, int stride, int filter_limit);
+
+// Whole-block intra predictor: A points at the row above the block (A[-1] is
+// the above-left pixel), L at the column to its left, both already holding the
+// RFC 6386 12.2 out-of-frame values (127 above, 129 left).
+typedef void (*Vp8PredFn)(uint8_t* dst, uint32_t stride, const uint8_t* A, const uint8_t* L);
+
+// Vp8Dsp.pred16/pred8 index: the RFC's DC/V/H/TM numbering, then DC_PRED for a
+// block on the top edge, the left edge or both (the missing edge is left out of
+// the average instead of using its fill values).
+enum {
+	VP8_PRED_DC,
+	VP8_PRED_V,
+	VP8_PRED_H,
+	VP8_PRED_TM,
+	VP8_PRED_DC_NO_TOP,
+	VP8_PRED_DC_NO_LEFT,
+	VP8_PRED_DC_NO_TOP_LEFT,
+	VP8_PRED_COUNT
+};
+
+typedef struct {
+	CpuLevel level;
+
+	// m06: RFC 6386 14.3/14.4 inverse transforms on flat 4x4 arrays.
+	void (*inv_wht4x4)(const int16_t* in, int16_t* out);
+	void (*inv_dct4x4)(const int16_t* in, int16_t* out);
+
+	// m06: RFC 6386 12.2/12.3 intra predictors. subblock_predict is one B_PRED
+	// 4x4 block: A[-1..7] above (A[4..7] above-right), L[0..3] to the left.
+	Vp8PredFn pred16[VP8_PRED_COUNT];
+	Vp8PredFn pred8[VP8_PRED_COUNT];
+	void (*subblock_predict)(uint8_t B[4][4], const uint8_t* A, const uint8_t* L, uint8_t mode);
+
+	// m07: RFC 6386 15.x edge filters.
+	Vp8LfNormalFn lf_mb_v_edge;
+	Vp8LfNormalFn lf_mb_h_edge;
+	Vp8LfNormalFn lf_subblock_v_edge;
+	Vp8LfNormalFn lf_subblock_h_edge;
+	Vp8LfSimpleFn lf_simple_v_edge;
+	Vp8LfSimpleFn lf_simple_h_edge;
+
+	// m08/m09: libwebp-compatible fancy upsampler + YUV->RGB for a row pair.
+	// step is the output bytes per pixel (3 or 4; only RGB bytes are written).
+	// bottom_y/bottom_dst may be NULL.
+	void (*upsample_rgb_line_pair)(const uint8_t* top_y, const uint8_t* bottom_y, const uint8_t* top_u,
+	                               const uint8_t* top_v, const uint8_t* cur_u, const uint8_t* cur_v, uint8_t* top_dst,
+	                               uint8_t* bottom_dst, uint32_t len, uint32_t step);
+
+	// m09: PNG chunk CRC (crc32 of a continued stream; start with 0) and zlib Adler-32
+	// (a/b running sums, start with a=1, b=0).
+	uint32_t (*crc32_update)(uint32_t crc, const uint8_t* buf, size_t len);
+	void (*adler32_update)(uint32_t* a, uint32_t* b, const uint8_t* buf, size_t len);
+} Vp8Dsp;
+
+// Kernel table for cpu_level(); initialized on first use, from any thread.
+const Vp8Dsp* vp8_dsp(void);
+
+// Fills `out` for an explicit level (clamped to cpu_detect_level()); used by
+// tools/dsp_selftest.c to compare every available variant against scalar.
+void vp8_dsp_init_level(Vp8Dsp* out, CpuLevel level);
+
+// Per-level setters (dsp_scalar.c / dsp_x86.c). Each overrides the entries it implements.
+void vp8_dsp_init_scalar(Vp8Dsp* dsp);
+void vp8_dsp_init_sse2(Vp8Dsp* dsp);
+void vp8_dsp_init_ssse3(Vp8Dsp* dsp);
+void vp8_dsp_init_avx2(Vp8Dsp* dsp);
@@ -0,0 +1,564 @@
+// Scalar reference kernels for the dispatch table in dsp.h.
+// SIMD variants (dsp_x86.c) must match these bit for bit.
+
+#include "dsp.h"
+#include "dsp_yuv.h"
+
+// --- m06: inverse transforms from RFC 6386 ---
+
+static void inv_wht4x4(const int16_t* in, int16_t* out) {
+	// vp8_short_inv_walsh4x4_c (RFC 6386 14.3)
+	int16_t tmp[16];
+	for (int i = 0; i < 4; i++) {
+		int a1 = in[0 + i] + in[12 + i];
+		int b1 = in[4 + i] + in[8 + i];
+		int c1 = in[4 + i] - in[8 + i];
+		int d1 = in[0 + i] - in[12 + i];
+
+		tmp[0 + i] = (int16_t)(a1 + b1);
+		tmp[4 + i] = (int16_t)(c1 + d1);
+		tmp[8 + i] = (int16_t)(a1 - b1);
+		tmp[12 + i] = (int16_t)(d1 - c1);
+	}
+	for (int i = 0; i < 4; i++) {
+		int a1 = tmp[4 * i + 0] + tmp[4 * i + 3];
+		int b1 = tmp[4 * i + 1] + tmp[4 * i + 2];
+		int c1 = tmp[4 * i + 1] - tmp[4 * i + 2];
+		int d1 = tmp[4 * i + 0] - tmp[4 * i + 3];
+
+		out[4 * i + 0] = (int16_t)((a1 + b1 + 3) >> 3);
+		out[4 * i + 1] = (int16_t)((c1 + d1 + 3) >> 3);
+		out[4 * i + 2] = (int16_t)((a1 - b1 + 3) >> 3);
+		out[4 * i + 3] = (int16_t)((d1 - c1 + 3) >> 3);
+	}
+}
+
+static void inv_dct4x4(const int16_t* input, int16_t* output) {
+	// short_idct4x4llm_c (RFC 6386 14.4), but for flat 4x4 arrays.
+	static const int cospi8sqrt2minus1 = 20091;
+	static const int sinpi8sqrt2 = 35468;
+
+	int16_t tmp[16];
+	for (int i = 0; i < 4; i++) {
+		int32_t a1 = (int32_t)input[i + 0] + (int32_t)input[i + 8];
+		int32_t b1 = (int32_t)input[i + 0] - (int32_t)input[i + 8];
+
+		int32_t temp1 = ((int32_t)input[i + 4] * sinpi8sqrt2) >> 16;
+		int32_t temp2 = (int32_t)input[i + 12] + (((int32_t)input[i + 12] * cospi8sqrt2minus1) >> 16);
+		int32_t c1 = temp1 - temp2;
+
+		temp1 = (int32_t)input[i + 4] + (((int32_t)input[i + 4] * cospi8sqrt2minus1) >> 16);
+		temp2 = ((int32_t)input[i + 12] * sinpi8sqrt2) >> 16;
+		int32_t d1 = temp1 + temp2;
+
+		tmp[0 * 4 + i] = (int16_t)(a1 + d1);
+		tmp[3 * 4 + i] = (int16_t)(a1 - d1);
+		tmp[1 * 4 + i] = (int16_t)(b1 + c1);
+		tmp[2 * 4 + i] = (int16_t)(b1 - c1);
+	}
+
+	for (int i = 0; i < 4; i++) {
+		int32_t a1 = (int32_t)tmp[i * 4 + 0] + (int32_t)tmp[i * 4 + 2];
+		int32_t b1 = (int32_t)tmp[i * 4 + 0] - (int32_t)tmp[i * 4 + 2];
+
+		int32_t temp1 = ((int32_t)tmp[i * 4 + 1] * sinpi8sqrt2) >> 16;
+		int32_t temp2 = (int32_t)tmp[i * 4 + 3] + (((int32_t)tmp[i * 4 + 3] * cospi8sqrt2minus1) >> 16);
+		int32_t c1 = temp1 - temp2;
+
+		temp1 = (int32_t)tmp[i * 4 + 1] + (((int32_t)tmp[i * 4 + 1] * cospi8sqrt2minus1) >> 16);
+		temp2 = ((int32_t)tmp[i * 4 + 3] * sinpi8sqrt2) >> 16;
+		int32_t d1 = temp1 + temp2;
+
+		output[i * 4 + 0] = (int16_t)((a1 + d1 + 4) >> 3);
+		output[i * 4 + 3] = (int16_t)((a1 - d1 + 4) >> 3);
+		output[i * 4 + 1] = (int16_t)((b1 + c1 + 4) >> 3);
+		output[i * 4 + 2] = (int16_t)((b1 - c1 + 4) >> 3);
+	}
+}
+
+// --- m07: loop filter edges (RFC 6386 15) ---
+
+static inline int iabs_i32(int v) { return (v < 0) ? -v : v; }
+
+static inline int clamp_i8(int v) {
+	if (v < -128) return -128;
+	if (v > 127) return 127;
+	return v;
+}
+
+static inline uint8_t clamp_u8(int v) {
+	if (v < 0) return 0;
+	if (v > 255) return 255;
+	return (uint8_t)v;
+}
+
+static inline int p_at(const uint8_t* q0, int step, int k) {
+	return (int)q0[k * step];
+}
+
+static int high_edge_variance(const uint8_t* q0, int step, int hev_threshold) {
+	int p1 = p_at(q0, step, -2);
+	int p0 = p_at(q0, step, -1);
+	int q0v = p_at(q0, step, 0);
+	int q1 = p_at(q0, step, 1);
+	return iabs_i32(p1 - p0) > hev_threshold || iabs_i32(q1 - q0v) > hev_threshold;
+}
+
+static int simple_threshold(const uint8_t* q0, int step, int filter_limit) {
+	int p1 = p_at(q0, step, -2);
+	int p0 = p_at(q0, step, -1);
+	int q0v = p_at(q0, step, 0);
+	int q1 = p_at(q0, step, 1);
+	return (iabs_i32(p0 - q0v) * 2 + (iabs_i32(p1 - q1) >> 1)) <= filter_limit;
+}
+
+static int normal_threshold(const uint8_t* q0, int step, int edge_limit, int interior_limit) {
+	int I = interior_limit;
+	int E = edge_limit;
+	if (!simple_threshold(q0, step, 2 * E + I)) return 0;
+
+	int p3 = p_at(q0, step, -4);
+	int p2 = p_at(q0, step, -3);
+	int p1 = p_at(q0, step, -2);
+	int p0 = p_at(q0, step, -1);
+	int q0v = p_at(q0, step, 0);
+	int q1 = p_at(q0, step, 1);
+	int q2 = p_at(q0, step, 2);
+	int q3 = p_at(q0, step, 3);
+
+	return iabs_i32(p3 - p2) <= I && iabs_i32(p2 - p1) <= I && iabs_i32(p1 - p0) <= I && iabs_i32(q3 - q2) <= I &&
+	       iabs_i32(q2 - q1) <= I && iabs_i32(q1 - q0v) <= I;
+}
+
+static void filter_common(uint8_t* q0, int step, int use_outer_taps) {
+	int p1 = p_at(q0, step, -2);
+	int p0 = p_at(q0, step, -1);
+	int q0v = p_at(q0, step, 0);
+	int q1 = p_at(q0, step, 1);
+
+	int a = 3 * (q0v - p0);
+	if (use_outer_taps) a += clamp_i8(p1 - q1);
+	a = clamp_i8(a);
+
+	int f1 = clamp_i8(a + 4) >> 3;
+	int f2 = clamp_i8(a + 3) >> 3;
+
+	q0[0] = clamp_u8(q0v - f1);
+	q0[-step] = clamp_u8(p0 + f2);
+
+	if (!use_outer_taps) {
+		int a2 = (f1 + 1) >> 1;
+		q0[step] = clamp_u8(q1 - a2);
+		q0[-2 * step] = clamp_u8(p1 + a2);
+	}
+}
+
+static void filter_mb_edge(uint8_t* q0, int step) {
+	int p2 = p_at(q0, step, -3);
+	int p1 = p_at(q0, step, -2);
+	int p0 = p_at(q0, step, -1);
+	int q0v = p_at(q0, step, 0);
+	int q1 = p_at(q0, step, 1);
+	int q2 = p_at(q0, step, 2);
+	int q3 = p_at(q0, step, 3);
+
+	(void)q3;
+	int w = clamp_i8(clamp_i8(p1 - q1) + 3 * (q0v - p0));
+
+	int a = (27 * w + 63) >> 7;
+	q0[-step] = clamp_u8(p0 + a);
+	q0[0] = clamp_u8(q0v - a);
+
+	a = (18 * w + 63) >> 7;
+	q0[-2 * step] = clamp_u8(p1 + a);
+	q0[step] = clamp_u8(q1 - a);
+
+	a = (9 * w + 63) >> 7;
+	q0[-3 * step] = clamp_u8(p2 + a);
+	q0[2 * step] = clamp_u8(q2 - a);
+}
+
+static void filter_mb_v_edge(uint8_t* src_q0, int stride, int edge_limit, int interior_limit, int hev_threshold,
+                            int size_blocks) {
+	for (int i = 0; i < 8 * size_blocks; i++) {
+		if (normal_threshold(src_q0, 1, edge_limit, interior_limit)) {
+			if (high_edge_variance(src_q0, 1, hev_threshold))
+				filter_common(src_q0, 1, 1);
+			else
+				filter_mb_edge(src_q0, 1);
+		}
+		src_q0 += stride;
+	}
+}
+
+static void filter_subblock_v_edge(uint8_t* src_q0, int stride, int edge_limit, int interior_limit, int hev_threshold,
+                                  int size_blocks) {
+	for (int i = 0; i < 8 * size_blocks; i++) {
+		if (normal_threshold(src_q0, 1, edge_limit, interior_limit)) {
+			filter_common(src_q0, 1, high_edge_variance(src_q0, 1, hev_threshold));
+		}
+		src_q0 += stride;
+	}
+}
+
+static void filter_mb_h_edge(uint8_t* src_q0, int stride, int edge_limit, int interior_limit, int hev_threshold,
+                            int size_blocks) {
+	for (int i = 0; i < 8 * size_blocks; i++) {
+		if (normal_threshold(src_q0, stride, edge_limit, interior_limit)) {
+			if (high_edge_variance(src_q0, stride, hev_threshold))
+				filter_common(src_q0, stride, 1);
+			else
+				filter_mb_edge(src_q0, stride);
+		}
+		src_q0 += 1;
+	}
+}
+
+static void filter_subblock_h_edge(uint8_t* src_q0, int stride, int edge_limit, int interior_limit, int hev_threshold,
+                                  int size_blocks) {
+	for (int i = 0; i < 8 * size_blocks; i++) {
+		if (normal_threshold(src_q0, stride, edge_limit, interior_limit)) {
+			filter_common(src_q0, stride, high_edge_variance(src_q0, stride, hev_threshold));
+		}
+		src_q0 += 1;
+	}
+}
+
+static void filter_v_edge_simple(uint8_t* src_q0, int stride, int filter_limit) {
+	for (int i = 0; i < 16; i++) {
+		if (simple_threshold(src_q0, 1, filter_limit)) filter_common(src_q0, 1, 1);
+		src_q0 += stride;
+	}
+}
+
+static void filter_h_edge_simple(uint8_t* src_q0, int stride, int filter_limit) {
+	for (int i = 0; i < 16; i++) {
+		if (simple_threshold(src_q0, stride, filter_limit)) filter_common(src_q0, stride, 1);
+		src_q0 += 1;
+	}
+}
+
+// --- m06: intra predictors ---
+
+static void pred_fill(uint8_t* dst, uint32_t stride, uint32_t n, uint8_t v) {
+	for (uint32_t r = 0; r < n; r++)
+		for (uint32_t c = 0; c < n; c++) dst[r * stride + c] = v;
+}
+
+// shift is log2 of the number of edge pixels summed.
+static void pred_dc(uint8_t* dst, uint32_t stride, const uint8_t* A, const uint8_t* L, uint32_t n, int use_above,
+                    int use_left, int shift) {
+	int sum = 0;
+	for (uint32_t i = 0; i < n; i++) sum += (use_above ? (int)A[i] : 0) + (use_left ? (int)L[i] : 0);
+	pred_fill(dst, stride, n, (uint8_t)((sum + (1 << (shift - 1))) >> shift));
+}
+
+static void pred_v(uint8_t* dst, uint32_t stride, const uint8_t* A, uint32_t n) {
+	for (uint32_t r = 0; r < n; r++)
+		for (uint32_t c = 0; c < n; c++) dst[r * stride + c] = A[c];
+}
+
+static void pred_h(uint8_t* dst, uint32_t stride, const uint8_t* L, uint32_t n) {
+	for (uint32_t r = 0; r < n; r++)
+		for (uint32_t c = 0; c < n; c++) dst[r * stride + c] = L[r];
+}
+
+static void pred_tm(uint8_t* dst, uint32_t stride, const uint8_t* A, const uint8_t* L, uint32_t n) {
+	for (uint32_t r = 0; r < n; r++)
+		for (uint32_t c = 0; c < n; c++) dst[r * stride + c] = clamp_u8((int)L[r] + (int)A[c] - (int)A[-1]);
+}
+
+static void pred16_dc(uint8_t* d, uint32_t s, const uint8_t* A, const uint8_t* L) {
+	pred_dc(d, s, A, L, 16, 1, 1, 5);
+}
+
+static void pred16_v(uint8_t* d, uint32_t s, const uint8_t* A, const uint8_t* L) {
+	(void)L;
+	pred_v(d, s, A, 16);
+}
+
+static void pred16_h(uint8_t* d, uint32_t s, const uint8_t* A, const uint8_t* L) {
+	(void)A;
+	pred_h(d, s, L, 16);
+}
+
+static void pred16_tm(uint8_t* d, uint32_t s, const uint8_t* A, const uint8_t* L) {
+	pred_tm(d, s, A, L, 16);
+}
+
+static void pred16_dc_no_top(uint8_t* d, uint32_t s, const uint8_t* A, const uint8_t* L) {
+	pred_dc(d, s, A, L, 16, 0, 1, 4);
+}
+
+static void pred16_dc_no_left(uint8_t* d, uint32_t s, const uint8_t* A, const uint8_t* L) {
+	pred_dc(d, s, A, L, 16, 1, 0, 4);
+}
+
+static void pred16_dc_no_top_left(uint8_t* d, uint32_t s, const uint8_t* A, const uint8_t* L) {
+	(void)A;
+	(void)L;
+	pred_fill(d, s, 16, 128);
+}
+
+static void pred8_dc(uint8_t* d, uint32_t s, const uint8_t* A, const uint8_t* L) {
+	pred_dc(d, s, A, L, 8, 1, 1, 4);
+}
+
+static void pred8_v(uint8_t* d, uint32_t s, const uint8_t* A, const uint8_t* L) {
+	(void)L;
+	pred_v(d, s, A, 8);
+}
+
+static void pred8_h(uint8_t* d, uint32_t s, const uint8_t* A, const uint8_t* L) {
+	(void)A;
+	pred_h(d, s, L, 8);
+}
+
+static void pred8_tm(uint8_t* d, uint32_t s, const uint8_t* A, const uint8_t* L) {
+	pred_tm(d, s, A, L, 8);
+}
+
+static void pred8_dc_no_top(uint8_t* d, uint32_t s, const uint8_t* A, const uint8_t* L) {
+	pred_dc(d, s, A, L, 8, 0, 1, 3);
+}
+
+static void pred8_dc_no_left(uint8_t* d, uint32_t s, const uint8_t* A, const uint8_t* L) {
+	pred_dc(d, s, A, L, 8, 1, 0, 3);
+}
+
+static void pred8_dc_no_top_left(uint8_t* d, uint32_t s, const uint8_t* A, const uint8_t* L) {
+	(void)A;
+	(void)L;
+	pred_fill(d, s, 8, 128);
+}
+
+static inline uint8_t avg3(uint8_t x, uint8_t y, uint8_t z) { return (uint8_t)((x + y + y + z + 2) >> 2); }
+static inline uint8_t avg2(uint8_t x, uint8_t y) { return (uint8_t)((x + y + 1) >> 1); }
+
+// B_PRED subblock modes, following the RFC 6386 12.3 reference code.
+static void subblock_predict(uint8_t B[4][4], const uint8_t* A, const uint8_t* L, uint8_t mode) {
+	uint8_t E[9];
+	E[0] = L[3];
+	E[1] = L[2];
+	E[2] = L[1];
+	E[3] = L[0];
+	E[4] = A[-1];
+	E[5] = A[0];
+	E[6] = A[1];
+	E[7] = A[2];
+	E[8] = A[3];
+
+	switch (mode) {
+		case 0: { // B_DC_PRED
+			int v = 4;
+			for (int i = 0; i < 4; i++) v += (int)A[i] + (int)L[i];
+			v >>= 3;
+			for (int r = 0; r < 4; r++)
+				for (int c = 0; c < 4; c++) B[r][c] = (uint8_t)v;
+			break;
+		}
+		case 1: { // B_TM_PRED
+			for (int r = 0; r < 4; r++)
+				for (int c = 0; c < 4; c++) B[r][c] = clamp_u8((int)L[r] + (int)A[c] - (int)A[-1]);
+			break;
+		}
+		case 2: { // B_VE_PRED
+			for (int c = 0; c < 4; c++) {
+				uint8_t v = avg3(A[c - 1], A[c], A[c + 1]);
+				B[0][c] = B[1][c] = B[2][c] = B[3][c] = v;
+			}
+			break;
+		}
+		case 3: { // B_HE_PRED
+			// Bottom row is exceptional because L[4] does not exist.
+			uint8_t v = avg3(L[2], L[3], L[3]);
+			B[3][0] = B[3][1] = B[3][2] = B[3][3] = v;
+
+			// Upper 3 rows use avg3p(L + r), where L[-1] == P (== A[-1]).
+			v = avg3(L[1], L[2], L[3]);
+			B[2][0] = B[2][1] = B[2][2] = B[2][3] = v;
+			v = avg3(L[0], L[1], L[2]);
+			B[1][0] = B[1][1] = B[1][2] = B[1][3] = v;
+			v = avg3(A[-1], L[0], L[1]);
+			B[0][0] = B[0][1] = B[0][2] = B[0][3] = v;
+			break;
+		}
+		case 4: { // B_LD_PRED
+			B[0][0] = avg3(A[0], A[1], A[2]);
+			B[0][1] = B[1][0] = avg3(A[1], A[2], A[3]);
+			B[0][2] = B[1][1] = B[2][0] = avg3(A[2], A[3], A[4]);
+			B[0][3] = B[1][2] = B[2][1] = B[3][0] = avg3(A[3], A[4], A[5]);
+			B[1][3] = B[2][2] = B[3][1] = avg3(A[4], A[5], A[6]);
+			B[2][3] = B[3][2] = avg3(A[5], A[6], A[7]);
+			B[3][3] = avg3(A[6], A[7], A[7]);
+			break;
+		}
+		case 5: { // B_RD_PRED
+			B[3][0] = avg3(E[0], E[1], E[2]);
+			B[3][1] = B[2][0] = avg3(E[1], E[2], E[3]);
+			B[3][2] = B[2][1] = B[1][0] = avg3(E[2], E[3], E[4]);
+			B[3][3] = B[2][2] = B[1][1] = B[0][0] = avg3(E[3], E[4], E[5]);
+			B[2][3] = B[1][2] = B[0][1] = avg3(E[4], E[5], E[6]);
+			B[1][3] = B[0][2] = avg3(E[5], E[6], E[7]);
+			B[0][3] = avg3(E[6], E[7], E[8]);
+			break;
+		}
+		case 6: { // B_VR_PRED
+			// RFC 6386 reference code.
+			uint8_t avg3p_2 = avg3(E[1], E[2], E[3]);
+			uint8_t avg3p_3 = avg3(E[2], E[3], E[4]);
+			uint8_t avg3p_4 = avg3(E[3], E[4], E[5]);
+			uint8_t avg3p_5 = avg3(E[4], E[5], E[6]);
+			uint8_t avg3p_6 = avg3(E[5], E[6], E[7]);
+			uint8_t avg3p_7 = avg3(E[6], E[7], E[8]);
+			uint8_t avg2p_4 = avg2(E[4], E[5]);
+			uint8_t avg2p_5 = avg2(E[5], E[6]);
+			uint8_t avg2p_6 = avg2(E[6], E[7]);
+			uint8_t avg2p_7 = avg2(E[7], E[8]);
+
+			B[3][0] = avg3p_2;
+			B[2][0] = avg3p_3;
+			B[3][1] = B[1][0] = avg3p_4;
+			B[2][1] = B[0][0] = avg2p_4;
+			B[3][2] = B[1][1] = avg3p_5;
+			B[2][2] = B[0][1] = avg2p_5;
+			B[3][3] = B[1][2] = avg3p_6;
+			B[2][3] = B[0][2] = avg2p_6;
+			B[1][3] = avg3p_7;
+			B[0][3] = avg2p_7;
+			break;
+		}
+		case 7: { // B_VL_PRED
+			// RFC 6386 reference code.
+			B[0][0] = avg2(A[0], A[1]);
+			B[1][0] = avg3(A[0], A[1], A[2]);
+			B[2][0] = B[0][1] = avg2(A[1], A[2]);
+			B[1][1] = B[3][0] = avg3(A[1], A[2], A[3]);
+			B[2][1] = B[0][2] = avg2(A[2], A[3]);
+			B[3][1] = B[1][2] = avg3(A[2], A[3], A[4]);
+			B[2][2] = B[0][3] = avg2(A[3], A[4]);
+			B[3][2] = B[1][3] = avg3(A[3], A[4], A[5]);
+			B[2][3] = avg3(A[4], A[5], A[6]);
+			B[3][3] = avg3(A[5], A[6], A[7]);
+			break;
+		}
+		case 8: { // B_HD_PRED
+			// RFC 6386 reference code.
+			B[3][0] = avg2(E[0], E[1]);
+			B[3][1] = avg3(E[0], E[1], E[2]);
+			B[2][0] = B[3][2] = avg2(E[1], E[2]);
+			B[2][1] = B[3][3] = avg3(E[1], E[2], E[3]);
+			B[2][2] = B[1][0] = avg2(E[2], E[3]);
+			B[2][3] = B[1][1] = avg3(E[2], E[3], E[4]);
+			B[1][2] = B[0][0] = avg2(E[3], E[4]);
+			B[1][3] = B[0][1] = avg3(E[3], E[4], E[5]);
+			B[0][2] = avg3(E[4], E[5], E[6]);
+			B[0][3] = avg3(E[5], E[6], E[7]);
+			break;
+		}
+		case 9: { // B_HU_PRED
+			B[0][0] = avg2(L[0], L[1]);
+			B[0][1] = avg3(L[0], L[1], L[2]);
+			B[0][2] = B[1][0] = avg2(L[1], L[2]);
+			B[0][3] = B[1][1] = avg3(L[1], L[2], L[3]);
+			B[1][2] = B[2][0] = avg2(L[2], L[3]);
+			B[1][3] = B[2][1] = avg3(L[2], L[3], L[3]);
+			for (int r = 2; r < 4; r++) {
+				for (int c = 2; c < 4; c++) B[r][c] = L[3];
+			}
+			B[3][0] = L[3];
+			B[3][1] = L[3];
+			break;
+		}
+		default: {
+			for (int r = 0; r < 4; r++)
+				for (int c = 0; c < 4; c++) B[r][c] = 128;
+			break;
+		}
+	}
+}
+
+// --- m08/m09: YUV->RGB ---
+
+static void upsample_rgb_line_pair_scalar(const uint8_t* top_y, const uint8_t* bottom_y, const uint8_t* top_u,
+                                          const uint8_t* top_v, const uint8_t* cur_u, const uint8_t* cur_v,
+                                          uint8_t* top_dst, uint8_t* bottom_dst, uint32_t len, uint32_t step) {
+	if (len == 0) return;
+
+	const uint32_t last_pixel_pair = (len - 1u) >> 1;
+	upsample_edge_pixel(top_y, bottom_y, top_u[0], top_v[0], cur_u[0], cur_v[0], 0, top_dst, bottom_dst, step);
+	upsample_pixel_pairs(top_y, bottom_y, top_u, top_v, cur_u, cur_v, top_dst, bottom_dst, 1u, last_pixel_pair, step);
+	if ((len & 1u) == 0u) {
+		upsample_edge_pixel(top_y, bottom_y, top_u[last_pixel_pair], top_v[last_pixel_pair], cur_u[last_pixel_pair],
+		                    cur_v[last_pixel_pair], len - 1u, top_dst, bottom_dst, step);
+	}
+}
+
+// --- m09: checksums ---
+
+static uint32_t g_crc_table[256];
+
+static void crc32_init_table(void) {
+	for (uint32_t n = 0; n < 256u; n++) {
+		uint32_t c = n;
+		for (int k = 0; k < 8; k++) c = (c & 1u) ? (0xEDB88320u ^ (c >> 1)) : (c >> 1);
+		g_crc_table[n] = c;
+	}
+}
+
+static uint32_t crc32_update_scalar(uint32_t crc, const uint8_t* buf, size_t len) {
+	crc ^= 0xFFFFFFFFu;
+	for (size_t i = 0; i < len; i++) crc = g_crc_table[(crc ^ buf[i]) & 0xFFu] ^ (crc >> 8);
+	return crc ^ 0xFFFFFFFFu;
+}
+
+static void adler32_update_scalar(uint32_t* a, uint32_t* b, const uint8_t* buf, size_t len) {
+	// Adler-32 modulo. 5552 is the largest n with 255*n*(n+1)/2 + (n+1)*(MOD-1) < 2^32,
+	// so the modulo can be deferred to once per 5552 bytes (as in zlib).
+	const uint32_t MOD = 65521u;
+	uint32_t aa = *a;
+	uint32_t bb = *b;
+	while (len > 0) {
+		size_t n = (len < 5552u) ? len : 5552u;
+		len -= n;
+		while (n--) {
+			aa += *buf++;
+			bb += aa;
+		}
+		aa %= MOD;
+		bb %= MOD;
+	}
+	*a = aa;
+	*b = bb;
+}
+
+void vp8_dsp_init_scalar(Vp8Dsp* dsp) {
+	dsp->level = CPU_LEVEL_SCALAR;
+	dsp->inv_wht4x4 = inv_wht4x4;
+	dsp->inv_dct4x4 = inv_dct4x4;
+	dsp->pred16[VP8_PRED_DC] = pred16_dc;
+	dsp->pred16[VP8_PRED_V] = pred16_v;
+	dsp->pred16[VP8_PRED_H] = pred16_h;
+	dsp->pred16[VP8_PRED_TM] = pred16_tm;
+	dsp->pred16[VP8_PRED_DC_NO_TOP] = pred16_dc_no_top;
+	dsp->pred16[VP8_PRED_DC_NO_LEFT] = pred16_dc_no_left;
+	dsp->pred16[VP8_PRED_DC_NO_TOP_LEFT] = pred16_dc_no_top_left;
+	dsp->pred8[VP8_PRED_DC] = pred8_dc;
+	dsp->pred8[VP8_PRED_V] = pred8_v;
+	dsp->pred8[VP8_PRED_H] = pred8_h;
+	dsp->pred8[VP8_PRED_TM] = pred8_tm;
+	dsp->pred8[VP8_PRED_DC_NO_TOP] = pred8_dc_no_top;
+	dsp->pred8[VP8_PRED_DC_NO_LEFT] = pred8_dc_no_left;
+	dsp->pred8[VP8_PRED_DC_NO_TOP_LEFT] = pred8_dc_no_top_left;
+	dsp->subblock_predict = subblock_predict;
+	dsp->lf_mb_v_edge = filter_mb_v_edge;
+	dsp->lf_mb_h_edge = filter_mb_h_edge;
+	dsp->lf_subblock_v_edge = filter_subblock_v_edge;
+	dsp->lf_subblock_h_edge = filter_subblock_h_edge;
+	dsp->lf_simple_v_edge = filter_v_edge_simple;
+	dsp->lf_simple_h_edge = filter_h_edge_simple;
+	dsp->upsample_rgb_line_pair = upsample_rgb_line_pair_scalar;
+	if (g_crc_table[1] == 0) crc32_init_table();
+	dsp->crc32_update = crc32_update_scalar;
+	dsp->adler32_update = adler32_update_scalar;
+}
@@ -0,0 +1,892 @@
+// x86 SIMD variants for the dispatch table in dsp.h.
+//
+// Every kernel is compiled with a per-function target attribute, so this file
+// builds with the baseline -march and only runs the instructions cpu_level()
+// found. Each variant is bit-exact with dsp_scalar.c (tools/dsp_selftest.c).
+//
+// Coverage: SSE2 inverse DCT, intra predictors, fancy upsampler and loop-filter
+// edges; SSSE3 Adler-32; AVX2 16-pixel horizontal loop-filter edges.
+
+#include "dsp.h"
+
+#if !defined(DECODER_ULTRA) && (defined(__x86_64__) || defined(__i386__))
+
+#include <immintrin.h>
+
+#include "dsp_yuv.h"
+
+#define TARGET_SSE2 __attribute__((target("sse2")))
+#define TARGET_SSSE3 __attribute__((target("ssse3")))
+#define TARGET_AVX2 __attribute__((target("avx2")))
+
+// --- m06: inverse DCT ---
+
+// x * 35468 >> 16 and x + (x * 20091 >> 16) (RFC 6386 14.3 constants) on
+// 16-bit lanes. 35468 does not fit an int16 multiplier: mulhi by 35468-65536
+// yields (x*35468 >> 16) - x, so adding x back is exact.
+TARGET_SSE2 static inline __m128i mul_sinpi8sqrt2(__m128i x) {
+	return _mm_add_epi16(_mm_mulhi_epi16(x, _mm_set1_epi16((int16_t)(35468 - 65536))), x);
+}
+
+TARGET_SSE2 static inline __m128i mul_cospi8sqrt2(__m128i x) {
+	return _mm_add_epi16(x, _mm_mulhi_epi16(x, _mm_set1_epi16(20091)));
+}
+
+TARGET_SSE2 static inline __m128i widen_i16(__m128i x) {
+	return _mm_srai_epi32(_mm_unpacklo_epi16(x, x), 16);
+}
+
+TARGET_SSE2 static inline __m128i mul_cospi8sqrt2_32(__m128i x) {
+	return _mm_add_epi32(widen_i16(x), widen_i16(_mm_mulhi_epi16(x, _mm_set1_epi16(20091))));
+}
+
+TARGET_SSE2 static void inv_dct4x4_sse2(const int16_t* input, int16_t* output) {
+	// Lane i of r<k> is input[4k + i]: the first pass runs the four columns in
+	// parallel. The scalar pass stores int16 intermediates, so wrapping 16-bit
+	// arithmetic here is exact.
+	const __m128i r0 = _mm_loadl_epi64((const __m128i*)(input + 0));
+	const __m128i r1 = _mm_loadl_epi64((const __m128i*)(input + 4));
+	const __m128i r2 = _mm_loadl_epi64((const __m128i*)(input + 8));
+	const __m128i r3 = _mm_loadl_epi64((const __m128i*)(input + 12));
+
+	const __m128i a1 = _mm_add_epi16(r0, r2);
+	const __m128i b1 = _mm_sub_epi16(r0, r2);
+	const __m128i c1 = _mm_sub_epi16(mul_sinpi8sqrt2(r1), mul_cospi8sqrt2(r3));
+	const __m128i d1 = _mm_add_epi16(mul_cospi8sqrt2(r1), mul_sinpi8sqrt2(r3));
+
+	const __m128i t0 = _mm_add_epi16(a1, d1);
+	const __m128i t1 = _mm_add_epi16(b1, c1);
+	const __m128i t2 = _mm_sub_epi16(b1, c1);
+	const __m128i t3 = _mm_sub_epi16(a1, d1);
+
+	// Transpose so lane i of c<k> is tmp[4i + k] (second pass runs the rows).
+	const __m128i t01 = _mm_unpacklo_epi16(t0, t1);
+	const __m128i t23 = _mm_unpacklo_epi16(t2, t3);
+	const __m128i lo = _mm_unpacklo_epi32(t01, t23);
+	const __m128i hi = _mm_unpackhi_epi32(t01, t23);
+	const __m128i c0 = lo;
+	const __m128i c1v = _mm_unpackhi_epi64(lo, lo);
+	const __m128i c2 = hi;
+	const __m128i c3 = _mm_unpackhi_epi64(hi, hi);
+
+	// Second pass in 32-bit: x*35468 >> 16 always fits 16 bits, x + (x*20091 >> 16)
+	// and the sums may not.
+	const __m128i a2 = _mm_add_epi32(widen_i16(c0), widen_i16(c2));
+	const __m128i b2 = _mm_sub_epi32(widen_i16(c0), widen_i16(c2));
+	const __m128i c2v = _mm_sub_epi32(widen_i16(mul_sinpi8sqrt2(c1v)), mul_cospi8sqrt2_32(c3));
+	const __m128i d2 = _mm_add_epi32(mul_cospi8sqrt2_32(c1v), widen_i16(mul_sinpi8sqrt2(c3)));
+
+	const __m128i round = _mm_set1_epi32(4);
+	const __m128i o0 = _mm_srai_epi32(_mm_add_epi32(_mm_add_epi32(a2, d2), round), 3);
+	const __m128i o1 = _mm_srai_epi32(_mm_add_epi32(_mm_add_epi32(b2, c2v), round), 3);
+	const __m128i o2 = _mm_srai_epi32(_mm_sub_epi32(_mm_add_epi32(b2, round), c2v), 3);
+	const __m128i o3 = _mm_srai_epi32(_mm_sub_epi32(_mm_add_epi32(a2, round), d2), 3);
+
+	// |result| < 2^14, so the saturating pack never clamps. Transpose back.
+	const __m128i v01 = _mm_packs_epi32(o0, o1);
+	const __m128i v23 = _mm_packs_epi32(o2, o3);
+	const __m128i x = _mm_unpacklo_epi16(v01, v23);
+	const __m128i y = _mm_unpackhi_epi16(v01, v23);
+	_mm_storeu_si128((__m128i*)(output + 0), _mm_unpacklo_epi16(x, y));
+	_mm_storeu_si128((__m128i*)(output + 8), _mm_unpackhi_epi16(x, y));
+}
+
+// --- m06: intra predictors ---
+
+// One predictor row of n = 16 or 8 pixels.
+TARGET_SSE2 static inline void pred_store_row(uint8_t* dst, uint32_t n, __m128i v) {
+	if (n == 16) {
+		_mm_storeu_si128((__m128i*)dst, v);
+	} else {
+		_mm_storel_epi64((__m128i*)dst, v);
+	}
+}
+
+TARGET_SSE2 static inline void pred_fill_sse2(uint8_t* dst, uint32_t stride, uint32_t n, __m128i row) {
+	for (uint32_t r = 0; r < n; r++) pred_store_row(dst + r * stride, n, row);
+}
+
+TARGET_SSE2 static inline __m128i pred_load_row(const uint8_t* p, uint32_t n) {
+	return n == 16 ? _mm_loadu_si128((const __m128i*)p) : _mm_loadl_epi64((const __m128i*)p);
+}
+
+// Sum of the n edge pixels at p.
+TARGET_SSE2 static inline int pred_sum(const uint8_t* p, uint32_t n) {
+	const __m128i s = _mm_sad_epu8(pred_load_row(p, n), _mm_setzero_si128());
+	return _mm_cvtsi128_si32(_mm_add_epi32(s, _mm_unpackhi_epi64(s, s)));
+}
+
+TARGET_SSE2 static inline void pred_dc_sse2(uint8_t* dst, uint32_t stride, const uint8_t* A, const uint8_t* L,
+                                            uint32_t n, int use_above, int use_left, int shift) {
+	const int sum = (use_above ? pred_sum(A, n) : 0) + (use_left ? pred_sum(L, n) : 0);
+	pred_fill_sse2(dst, stride, n, _mm_set1_epi8((char)((sum + (1 << (shift - 1))) >> shift)));
+}
+
+TARGET_SSE2 static inline void pred_h_sse2(uint8_t* dst, uint32_t stride, const uint8_t* L, uint32_t n) {
+	for (uint32_t r = 0; r < n; r++) pred_store_row(dst + r * stride, n, _mm_set1_epi8((char)L[r]));
+}
+
+// L[r] + A[c] - A[-1] on int16 lanes; the unsigned pack is the clamp.
+TARGET_SSE2 static inline void pred_tm_sse2(uint8_t* dst, uint32_t stride, const uint8_t* A, const uint8_t* L,
+                                            uint32_t n) {
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i a = pred_load_row(A, n);
+	const __m128i p = _mm_set1_epi16(A[-1]);
+	const __m128i lo = _mm_sub_epi16(_mm_unpacklo_epi8(a, zero), p);
+	const __m128i hi = _mm_sub_epi16(_mm_unpackhi_epi8(a, zero), p);
+	for (uint32_t r = 0; r < n; r++) {
+		const __m128i l = _mm_set1_epi16(L[r]);
+		pred_store_row(dst + r * stride, n, _mm_packus_epi16(_mm_add_epi16(lo, l), _mm_add_epi16(hi, l)));
+	}
+}
+
+TARGET_SSE2 static void pred16_dc_sse2(uint8_t* d, uint32_t s, const uint8_t* A, const uint8_t* L) {
+	pred_dc_sse2(d, s, A, L, 16, 1, 1, 5);
+}
+
+TARGET_SSE2 static void pred16_v_sse2(uint8_t* d, uint32_t s, const uint8_t* A, const uint8_t* L) {
+	(void)L;
+	pred_fill_sse2(d, s, 16, pred_load_row(A, 16));
+}
+
+TARGET_SSE2 static void pred16_h_sse2(uint8_t* d, uint32_t s, const uint8_t* A, const uint8_t* L) {
+	(void)A;
+	pred_h_sse2(d, s, L, 16);
+}
+
+TARGET_SSE2 static void pred16_tm_sse2(uint8_t* d, uint32_t s, const uint8_t* A, const uint8_t* L) {
+	pred_tm_sse2(d, s, A, L, 16);
+}
+
+TARGET_SSE2 static void pred16_dc_no_top_sse2(uint8_t* d, uint32_t s, const uint8_t* A, const uint8_t* L) {
+	pred_dc_sse2(d, s, A, L, 16, 0, 1, 4);
+}
+
+TARGET_SSE2 static void pred16_dc_no_left_sse2(uint8_t* d, uint32_t s, const uint8_t* A, const uint8_t* L) {
+	pred_dc_sse2(d, s, A, L, 16, 1, 0, 4);
+}
+
+TARGET_SSE2 static void pred16_dc_no_top_left_sse2(uint8_t* d, uint32_t s, const uint8_t* A, const uint8_t* L) {
+	(void)A;
+	(void)L;
+	pred_fill_sse2(d, s, 16, _mm_set1_epi8((char)0x80));
+}
+
+TARGET_SSE2 static void pred8_dc_sse2(uint8_t* d, uint32_t s, const uint8_t* A, const uint8_t* L) {
+	pred_dc_sse2(d, s, A, L, 8, 1, 1, 4);
+}
+
+TARGET_SSE2 static void pred8_v_sse2(uint8_t* d, uint32_t s, const uint8_t* A, const uint8_t* L) {
+	(void)L;
+	pred_fill_sse2(d, s, 8, pred_load_row(A, 8));
+}
+
+TARGET_SSE2 static void pred8_h_sse2(uint8_t* d, uint32_t s, const uint8_t* A, const uint8_t* L) {
+	(void)A;
+	pred_h_sse2(d, s, L, 8);
+}
+
+TARGET_SSE2 static void pred8_tm_sse2(uint8_t* d, uint32_t s, const uint8_t* A, const uint8_t* L) {
+	pred_tm_sse2(d, s, A, L, 8);
+}
+
+TARGET_SSE2 static void pred8_dc_no_top_sse2(uint8_t* d, uint32_t s, const uint8_t* A, const uint8_t* L) {
+	pred_dc_sse2(d, s, A, L, 8, 0, 1, 3);
+}
+
+TARGET_SSE2 static void pred8_dc_no_left_sse2(uint8_t* d, uint32_t s, const uint8_t* A, const uint8_t* L) {
+	pred_dc_sse2(d, s, A, L, 8, 1, 0, 3);
+}
+
+TARGET_SSE2 static void pred8_dc_no_top_left_sse2(uint8_t* d, uint32_t s, const uint8_t* A, const uint8_t* L) {
+	(void)A;
+	(void)L;
+	pred_fill_sse2(d, s, 8, _mm_set1_epi8((char)0x80));
+}
+
+// (a + 2b + c + 2) >> 2 as pavg(floor((a + c) / 2), b), which is exact;
+// pavgb rounds up, and the low bit of a ^ c is what that added.
+TARGET_SSE2 static inline __m128i avg3_u8(__m128i a, __m128i b, __m128i c) {
+	const __m128i ac = _mm_sub_epi8(_mm_avg_epu8(a, c), _mm_and_si128(_mm_xor_si128(a, c), _mm_set1_epi8(1)));
+	return _mm_avg_epu8(ac, b);
+}
+
+// Bytes k..k+3 of v as one little-endian 4x4 row.
+#define PRED4_ROW(v, k) ((uint32_t)_mm_cvtsi128_si32(_mm_srli_si128((v), (k))))
+
+// B_PRED: the diagonal modes are 3-tap (d) and 2-tap (g) averages along the
+// edge e = L[3..0], A[-1..7], A[7]..., so each row is four consecutive bytes
+// of d or g (libwebp's approach), with a byte patched in for VR/VL/HD.
+TARGET_SSE2 static void subblock_predict_sse2(uint8_t B[4][4], const uint8_t* A, const uint8_t* L, uint8_t mode) {
+	const uint32_t left = (uint32_t)L[3] | (uint32_t)L[2] << 8 | (uint32_t)L[1] << 16 | (uint32_t)L[0] << 24;
+	const __m128i e = _mm_or_si128(_mm_or_si128(_mm_cvtsi32_si128((int)left),
+	                                            _mm_slli_si128(_mm_loadl_epi64((const __m128i*)(A - 1)), 4)),
+	                               _mm_slli_si128(_mm_set1_epi8((char)A[7]), 12));
+	const __m128i e1 = _mm_srli_si128(e, 1);
+	uint32_t r0, r1, r2, r3;
+	switch (mode) {
+		case 0: { // B_DC_PRED: L[0..3] are bytes 0..3 of e, A[0..3] bytes 5..8.
+			const __m128i m = _mm_setr_epi8(-1, -1, -1, -1, 0, -1, -1, -1, -1, 0, 0, 0, 0, 0, 0, 0);
+			const __m128i sad = _mm_sad_epu8(_mm_and_si128(e, m), _mm_setzero_si128());
+			const int sum = _mm_cvtsi128_si32(_mm_add_epi32(sad, _mm_unpackhi_epi64(sad, sad)));
+			r0 = r1 = r2 = r3 = (uint32_t)((sum + 4) >> 3) * 0x01010101u;
+			break;
+		}
+		case 1: { // B_TM_PRED
+			const __m128i zero = _mm_setzero_si128();
+			const __m128i a = _mm_sub_epi16(_mm_unpacklo_epi8(_mm_srli_si128(e, 5), zero), _mm_set1_epi16(A[-1]));
+			const __m128i a2 = _mm_unpacklo_epi64(a, a);
+			const __m128i l01 = _mm_unpacklo_epi64(_mm_set1_epi16(L[0]), _mm_set1_epi16(L[1]));
+			const __m128i l23 = _mm_unpacklo_epi64(_mm_set1_epi16(L[2]), _mm_set1_epi16(L[3]));
+			_mm_storeu_si128((__m128i*)&B[0][0], _mm_packus_epi16(_mm_add_epi16(a2, l01), _mm_add_epi16(a2, l23)));
+			return;
+		}
+		case 2: { // B_VE_PRED
+			r0 = r1 = r2 = r3 = PRED4_ROW(avg3_u8(e, e1, _mm_srli_si128(e, 2)), 4);
+			break;
+		}
+		case 3: { // B_HE_PRED: rows avg3(A[-1], L0, L1) .. avg3(L2, L3, L3).
+			const uint32_t d = PRED4_ROW(avg3_u8(e, e1, _mm_srli_si128(e, 2)), 0);
+			r0 = ((d >> 16) & 0xFFu) * 0x01010101u;
+			r1 = ((d >> 8) & 0xFFu) * 0x01010101u;
+			r2 = (d & 0xFFu) * 0x01010101u;
+			r3 = (uint32_t)((L[2] + 3 * L[3] + 2) >> 2) * 0x01010101u;
+			break;
+		}
+		case 4: { // B_LD_PRED
+			const __m128i d = avg3_u8(e, e1, _mm_srli_si128(e, 2));
+			r0 = PRED4_ROW(d, 5);
+			r1 = PRED4_ROW(d, 6);
+			r2 = PRED4_ROW(d, 7);
+			r3 = PRED4_ROW(d, 8);
+			break;
+		}
+		case 5: { // B_RD_PRED
+			const __m128i d = avg3_u8(e, e1, _mm_srli_si128(e, 2));
+			r0 = PRED4_ROW(d, 3);
+			r1 = PRED4_ROW(d, 2);
+			r2 = PRED4_ROW(d, 1);
+			r3 = PRED4_ROW(d, 0);
+			break;
+		}
+		case 6: { // B_VR_PRED
+			const __m128i d = avg3_u8(e, e1, _mm_srli_si128(e, 2));
+			const __m128i g = _mm_avg_epu8(e, e1);
+			r0 = PRED4_ROW(g, 4);
+			r1 = PRED4_ROW(d, 3);
+			r2 = (PRED4_ROW(g, 3) & ~0xFFu) | (PRED4_ROW(d, 2) & 0xFFu);
+			r3 = (PRED4_ROW(d, 2) & ~0xFFu) | (PRED4_ROW(d, 1) & 0xFFu);
+			break;
+		}
+		case 7: { // B_VL_PRED
+			const __m128i d = avg3_u8(e, e1, _mm_srli_si128(e, 2));
+			const __m128i g = _mm_avg_epu8(e, e1);
+			r0 = PRED4_ROW(g, 5);
+			r1 = PRED4_ROW(d, 5);
+			r2 = (PRED4_ROW(g, 6) & 0x00FFFFFFu) | (PRED4_ROW(d, 6) & 0xFF000000u);
+			r3 = (PRED4_ROW(d, 6) & 0x00FFFFFFu) | (PRED4_ROW(d, 7) & 0xFF000000u);
+			break;
+		}
+		case 8: { // B_HD_PRED: rows interleave g and d.
+			const __m128i d = avg3_u8(e, e1, _mm_srli_si128(e, 2));
+			const __m128i gd = _mm_unpacklo_epi8(_mm_avg_epu8(e, e1), d);
+			r0 = (PRED4_ROW(gd, 6) & 0xFFFFu) | (PRED4_ROW(d, 4) << 16);
+			r1 = PRED4_ROW(gd, 4);
+			r2 = PRED4_ROW(gd, 2);
+			r3 = PRED4_ROW(gd, 0);
+			break;
+		}
+		case 9: { // B_HU_PRED: the same interleave along L[0..3], L[3]...
+			const uint32_t l = (uint32_t)L[0] | (uint32_t)L[1] << 8 | (uint32_t)L[2] << 16 | (uint32_t)L[3] << 24;
+			const __m128i h = _mm_or_si128(_mm_cvtsi32_si128((int)l), _mm_slli_si128(_mm_set1_epi8((char)L[3]), 4));
+			const __m128i h1 = _mm_srli_si128(h, 1);
+			const __m128i gd = _mm_unpacklo_epi8(_mm_avg_epu8(h, h1), avg3_u8(h, h1, _mm_srli_si128(h, 2)));
+			r0 = PRED4_ROW(gd, 0);
+			r1 = PRED4_ROW(gd, 2);
+			r2 = PRED4_ROW(gd, 4);
+			r3 = PRED4_ROW(gd, 6);
+			break;
+		}
+		default:
+			r0 = r1 = r2 = r3 = 0x80808080u;
+			break;
+	}
+	_mm_storeu_si128((__m128i*)&B[0][0], _mm_setr_epi32((int)r0, (int)r1, (int)r2, (int)r3));
+}
+
+#undef PRED4_ROW
+
+// --- m07: loop-filter edges ---
+//
+// Eight pixels per __m128i as int16 lanes; masks replace the per-pixel
+// branches of dsp_scalar.c and the final unsigned pack is its clamp_u8.
+// Vertical edges run the same code on an 8x8 transpose of eight rows.
+
+typedef struct {
+	__m128i p3, p2, p1, p0, q0, q1, q2, q3;
+} LfRows8;
+
+TARGET_SSE2 static inline __m128i lf_load8(const uint8_t* p) {
+	return _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i*)p), _mm_setzero_si128());
+}
+
+TARGET_SSE2 static inline void lf_store8(uint8_t* p, __m128i v) {
+	_mm_storel_epi64((__m128i*)p, _mm_packus_epi16(v, v));
+}
+
+TARGET_SSE2 static inline __m128i abs_diff8(__m128i a, __m128i b) {
+	return _mm_max_epi16(_mm_sub_epi16(a, b), _mm_sub_epi16(b, a));
+}
+
+TARGET_SSE2 static inline __m128i clamp_i8_8(__m128i v) {
+	return _mm_min_epi16(_mm_max_epi16(v, _mm_set1_epi16(-128)), _mm_set1_epi16(127));
+}
+
+TARGET_SSE2 static inline __m128i select8(__m128i mask, __m128i a, __m128i b) {
+	return _mm_or_si128(_mm_and_si128(mask, a), _mm_andnot_si128(mask, b));
+}
+
+// All-ones where v <= limit.
+TARGET_SSE2 static inline __m128i le8(__m128i v, int limit) {
+	return _mm_cmplt_epi16(v, _mm_set1_epi16((int16_t)(limit + 1)));
+}
+
+TARGET_SSE2 static inline void lf_load_rows8(LfRows8* r, const uint8_t* q0, int stride, int normal) {
+	if (normal) {
+		r->p3 = lf_load8(q0 - 4 * stride);
+		r->p2 = lf_load8(q0 - 3 * stride);
+		r->q2 = lf_load8(q0 + 2 * stride);
+		r->q3 = lf_load8(q0 + 3 * stride);
+	} else {
+		r->p3 = r->p2 = r->q2 = r->q3 = _mm_setzero_si128();
+	}
+	r->p1 = lf_load8(q0 - 2 * stride);
+	r->p0 = lf_load8(q0 - stride);
+	r->q0 = lf_load8(q0);
+	r->q1 = lf_load8(q0 + stride);
+}
+
+TARGET_SSE2 static inline __m128i simple_mask8(const LfRows8* r, int filter_limit) {
+	const __m128i d = _mm_add_epi16(_mm_slli_epi16(abs_diff8(r->p0, r->q0), 1),
+	                                _mm_srli_epi16(abs_diff8(r->p1, r->q1), 1));
+	return le8(d, filter_limit);
+}
+
+TARGET_SSE2 static inline __m128i normal_mask8(const LfRows8* r, int edge_limit, int interior_limit) {
+	__m128i m = abs_diff8(r->p3, r->p2);
+	m = _mm_max_epi16(m, abs_diff8(r->p2, r->p1));
+	m = _mm_max_epi16(m, abs_diff8(r->p1, r->p0));
+	m = _mm_max_epi16(m, abs_diff8(r->q3, r->q2));
+	m = _mm_max_epi16(m, abs_diff8(r->q2, r->q1));
+	m = _mm_max_epi16(m, abs_diff8(r->q1, r->q0));
+	return _mm_and_si128(le8(m, interior_limit), simple_mask8(r, 2 * edge_limit + interior_limit));
+}
+
+TARGET_SSE2 static inline __m128i hev_mask8(const LfRows8* r, int hev_threshold) {
+	const __m128i m = _mm_max_epi16(abs_diff8(r->p1, r->p0), abs_diff8(r->q1, r->q0));
+	return _mm_cmpgt_epi16(m, _mm_set1_epi16((int16_t)hev_threshold));
+}
+
+// filter_common: a = clamp(3*(q0-p0) [+ clamp(p1-q1)]), returns f1 and
+// updates p0/q0 in `r` (unmasked).
+TARGET_SSE2 static inline __m128i lf_common8(LfRows8* r, __m128i a) {
+	const __m128i f1 = _mm_srai_epi16(clamp_i8_8(_mm_add_epi16(a, _mm_set1_epi16(4))), 3);
+	const __m128i f2 = _mm_srai_epi16(clamp_i8_8(_mm_add_epi16(a, _mm_set1_epi16(3))), 3);
+	r->q0 = _mm_sub_epi16(r->q0, f1);
+	r->p0 = _mm_add_epi16(r->p0, f2);
+	return f1;
+}
+
+TARGET_SSE2 static inline __m128i lf_base8(const LfRows8* r) {
+	const __m128i d = _mm_sub_epi16(r->q0, r->p0);
+	return _mm_add_epi16(_mm_add_epi16(d, d), d);
+}
+
+TARGET_SSE2 static inline __m128i lf_tap8(__m128i w, int k) {
+	return _mm_srai_epi16(_mm_add_epi16(_mm_mullo_epi16(w, _mm_set1_epi16((int16_t)k)), _mm_set1_epi16(63)), 7);
+}
+
+// Writes back rows p<n-1>..q<n-1> (n = 3 for the macroblock filter, 2 for the
+// subblock one, 1 for the simple one).
+TARGET_SSE2 static inline void lf_store_rows8(uint8_t* q0, int stride, const LfRows8* r, int n) {
+	if (n > 2) lf_store8(q0 - 3 * stride, r->p2);
+	if (n > 1) lf_store8(q0 - 2 * stride, r->p1);
+	lf_store8(q0 - stride, r->p0);
+	lf_store8(q0, r->q0);
+	if (n > 1) lf_store8(q0 + stride, r->q1);
+	if (n > 2) lf_store8(q0 + 2 * stride, r->q2);
+}
+
+// 8x8 byte transpose; in[k] holds rows 2k and 2k+1 (low, high half), out[k]
+// columns 2k and 2k+1.
+TARGET_SSE2 static inline void transpose8x8(const __m128i in[4], __m128i out[4]) {
+	const __m128i t0 = _mm_unpacklo_epi8(in[0], in[1]);
+	const __m128i t1 = _mm_unpackhi_epi8(in[0], in[1]);
+	const __m128i t2 = _mm_unpacklo_epi8(in[2], in[3]);
+	const __m128i t3 = _mm_unpackhi_epi8(in[2], in[3]);
+	const __m128i u0 = _mm_unpacklo_epi8(t0, t1);
+	const __m128i u1 = _mm_unpackhi_epi8(t0, t1);
+	const __m128i u2 = _mm_unpacklo_epi8(t2, t3);
+	const __m128i u3 = _mm_unpackhi_epi8(t2, t3);
+	out[0] = _mm_unpacklo_epi32(u0, u2);
+	out[1] = _mm_unpackhi_epi32(u0, u2);
+	out[2] = _mm_unpacklo_epi32(u1, u3);
+	out[3] = _mm_unpackhi_epi32(u1, u3);
+}
+
+// Vertical edge: the eight rows q0-4 .. q0+3 at q0, q0+stride, ... become the
+// columns p3..q3 of an LfRows8, so the horizontal-edge arithmetic applies.
+TARGET_SSE2 static inline void lf_load_cols8(LfRows8* r, const uint8_t* q0, int stride) {
+	__m128i rows[4], cols[4];
+	for (int k = 0; k < 4; k++) {
+		const uint8_t* p = q0 - 4 + 2 * k * stride;
+		rows[k] = _mm_unpacklo_epi64(_mm_loadl_epi64((const __m128i*)p), _mm_loadl_epi64((const __m128i*)(p + stride)));
+	}
+	transpose8x8(rows, cols);
+	const __m128i zero = _mm_setzero_si128();
+	r->p3 = _mm_unpacklo_epi8(cols[0], zero);
+	r->p2 = _mm_unpackhi_epi8(cols[0], zero);
+	r->p1 = _mm_unpacklo_epi8(cols[1], zero);
+	r->p0 = _mm_unpackhi_epi8(cols[1], zero);
+	r->q0 = _mm_unpacklo_epi8(cols[2], zero);
+	r->q1 = _mm_unpackhi_epi8(cols[2], zero);
+	r->q2 = _mm_unpacklo_epi8(cols[3], zero);
+	r->q3 = _mm_unpackhi_epi8(cols[3], zero);
+}
+
+// Transposes back and rewrites all eight pixels of each row (p3/q3 unchanged).
+TARGET_SSE2 static inline void lf_store_cols8(uint8_t* q0, int stride, const LfRows8* r) {
+	const __m128i cols[4] = {_mm_packus_epi16(r->p3, r->p2), _mm_packus_epi16(r->p1, r->p0),
+	                         _mm_packus_epi16(r->q0, r->q1), _mm_packus_epi16(r->q2, r->q3)};
+	__m128i rows[4];
+	transpose8x8(cols, rows);
+	for (int k = 0; k < 4; k++) {
+		uint8_t* p = q0 - 4 + 2 * k * stride;
+		_mm_storel_epi64((__m128i*)p, rows[k]);
+		_mm_storel_epi64((__m128i*)(p + stride), _mm_unpackhi_epi64(rows[k], rows[k]));
+	}
+}
+
+// The three filters on eight edges held in r (updated in place); each returns
+// 0, leaving r alone, when no edge passes its mask.
+TARGET_SSE2 static inline int lf_mb8(LfRows8* r, int edge_limit, int interior_limit, int hev_threshold) {
+	const __m128i mask = normal_mask8(r, edge_limit, interior_limit);
+	if (_mm_movemask_epi8(mask) == 0) return 0;
+	const __m128i hev = hev_mask8(r, hev_threshold);
+	const __m128i w = clamp_i8_8(_mm_add_epi16(clamp_i8_8(_mm_sub_epi16(r->p1, r->q1)), lf_base8(r)));
+
+	// hev: filter_common with outer taps (p0/q0 only).
+	LfRows8 c = *r;
+	(void)lf_common8(&c, w);
+
+	// !hev: filter_mb_edge.
+	const __m128i a27 = lf_tap8(w, 27);
+	const __m128i a18 = lf_tap8(w, 18);
+	const __m128i a9 = lf_tap8(w, 9);
+	const __m128i mb = _mm_andnot_si128(hev, mask);
+	const __m128i p0 = select8(hev, c.p0, _mm_add_epi16(r->p0, a27));
+	const __m128i q0v = select8(hev, c.q0, _mm_sub_epi16(r->q0, a27));
+
+	r->p2 = select8(mb, _mm_add_epi16(r->p2, a9), r->p2);
+	r->p1 = select8(mb, _mm_add_epi16(r->p1, a18), r->p1);
+	r->p0 = select8(mask, p0, r->p0);
+	r->q0 = select8(mask, q0v, r->q0);
+	r->q1 = select8(mb, _mm_sub_epi16(r->q1, a18), r->q1);
+	r->q2 = select8(mb, _mm_sub_epi16(r->q2, a9), r->q2);
+	return 1;
+}
+
+TARGET_SSE2 static inline int lf_subblock8(LfRows8* r, int edge_limit, int interior_limit, int hev_threshold) {
+	const __m128i mask = normal_mask8(r, edge_limit, interior_limit);
+	if (_mm_movemask_epi8(mask) == 0) return 0;
+	const __m128i hev = hev_mask8(r, hev_threshold);
+	const __m128i base = lf_base8(r);
+	const __m128i outer = _mm_and_si128(hev, _mm_sub_epi16(r->p1, r->q1));
+	const __m128i a = clamp_i8_8(_mm_add_epi16(base, clamp_i8_8(outer)));
+
+	LfRows8 c = *r;
+	const __m128i f1 = lf_common8(&c, a);
+	const __m128i a2 = _mm_srai_epi16(_mm_add_epi16(f1, _mm_set1_epi16(1)), 1);
+	const __m128i inner = _mm_andnot_si128(hev, mask);
+
+	r->p1 = select8(inner, _mm_add_epi16(r->p1, a2), r->p1);
+	r->p0 = select8(mask, c.p0, r->p0);
+	r->q0 = select8(mask, c.q0, r->q0);
+	r->q1 = select8(inner, _mm_sub_epi16(r->q1, a2), r->q1);
+	return 1;
+}
+
+TARGET_SSE2 static inline int lf_simple8(LfRows8* r, int filter_limit) {
+	const __m128i mask = simple_mask8(r, filter_limit);
+	if (_mm_movemask_epi8(mask) == 0) return 0;
+	const __m128i a = clamp_i8_8(_mm_add_epi16(lf_base8(r), clamp_i8_8(_mm_sub_epi16(r->p1, r->q1))));
+	LfRows8 c = *r;
+	(void)lf_common8(&c, a);
+	r->p0 = select8(mask, c.p0, r->p0);
+	r->q0 = select8(mask, c.q0, r->q0);
+	return 1;
+}
+
+TARGET_SSE2 static void filter_mb_h_edge_sse2(uint8_t* q0, int stride, int edge_limit, int interior_limit,
+                                             int hev_threshold, int size_blocks) {
+	for (int i = 0; i < size_blocks; i++) {
+		LfRows8 r;
+		lf_load_rows8(&r, q0 + 8 * i, stride, 1);
+		if (lf_mb8(&r, edge_limit, interior_limit, hev_threshold)) lf_store_rows8(q0 + 8 * i, stride, &r, 3);
+	}
+}
+
+TARGET_SSE2 static void filter_subblock_h_edge_sse2(uint8_t* q0, int stride, int edge_limit, int interior_limit,
+                                                   int hev_threshold, int size_blocks) {
+	for (int i = 0; i < size_blocks; i++) {
+		LfRows8 r;
+		lf_load_rows8(&r, q0 + 8 * i, stride, 1);
+		if (lf_subblock8(&r, edge_limit, interior_limit, hev_threshold)) lf_store_rows8(q0 + 8 * i, stride, &r, 2);
+	}
+}
+
+TARGET_SSE2 static void filter_h_edge_simple_sse2(uint8_t* q0, int stride, int filter_limit) {
+	for (int i = 0; i < 2; i++) {
+		LfRows8 r;
+		lf_load_rows8(&r, q0 + 8 * i, stride, 0);
+		if (lf_simple8(&r, filter_limit)) lf_store_rows8(q0 + 8 * i, stride, &r, 1);
+	}
+}
+
+TARGET_SSE2 static void filter_mb_v_edge_sse2(uint8_t* q0, int stride, int edge_limit, int interior_limit,
+                                             int hev_threshold, int size_blocks) {
+	for (int i = 0; i < size_blocks; i++) {
+		uint8_t* q = q0 + 8 * i * stride;
+		LfRows8 r;
+		lf_load_cols8(&r, q, stride);
+		if (lf_mb8(&r, edge_limit, interior_limit, hev_threshold)) lf_store_cols8(q, stride, &r);
+	}
+}
+
+TARGET_SSE2 static void filter_subblock_v_edge_sse2(uint8_t* q0, int stride, int edge_limit, int interior_limit,
+                                                   int hev_threshold, int size_blocks) {
+	for (int i = 0; i < size_blocks; i++) {
+		uint8_t* q = q0 + 8 * i * stride;
+		LfRows8 r;
+		lf_load_cols8(&r, q, stride);
+		if (lf_subblock8(&r, edge_limit, interior_limit, hev_threshold)) lf_store_cols8(q, stride, &r);
+	}
+}
+
+TARGET_SSE2 static void filter_v_edge_simple_sse2(uint8_t* q0, int stride, int filter_limit) {
+	for (int i = 0; i < 2; i++) {
+		uint8_t* q = q0 + 8 * i * stride;
+		LfRows8 r;
+		lf_load_cols8(&r, q, stride);
+		if (lf_simple8(&r, filter_limit)) lf_store_cols8(q, stride, &r);
+	}
+}
+
+// AVX2: the same arithmetic on 16 lanes, i.e. a whole luma edge per vector.
+
+typedef struct {
+	__m256i p3, p2, p1, p0, q0, q1, q2, q3;
+} LfRows16;
+
+TARGET_AVX2 static inline __m256i lf_load16(const uint8_t* p) {
+	return _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i*)p));
+}
+
+TARGET_AVX2 static inline void lf_store16(uint8_t* p, __m256i v) {
+	// packus works per 128-bit lane; gather the two low quadwords.
+	const __m256i packed = _mm256_permute4x64_epi64(_mm256_packus_epi16(v, v), 0xD8);
+	_mm_storeu_si128((__m128i*)p, _mm256_castsi256_si128(packed));
+}
+
+TARGET_AVX2 static inline __m256i abs_diff16(__m256i a, __m256i b) {
+	return _mm256_abs_epi16(_mm256_sub_epi16(a, b));
+}
+
+TARGET_AVX2 static inline __m256i clamp_i8_16(__m256i v) {
+	return _mm256_min_epi16(_mm256_max_epi16(v, _mm256_set1_epi16(-128)), _mm256_set1_epi16(127));
+}
+
+TARGET_AVX2 static inline __m256i select16(__m256i mask, __m256i a, __m256i b) {
+	return _mm256_blendv_epi8(b, a, mask);
+}
+
+TARGET_AVX2 static inline __m256i le16(__m256i v, int limit) {
+	return _mm256_cmpgt_epi16(_mm256_set1_epi16((int16_t)(limit + 1)), v);
+}
+
+TARGET_AVX2 static inline void lf_load_rows16(LfRows16* r, const uint8_t* q0, int stride) {
+	r->p3 = lf_load16(q0 - 4 * stride);
+	r->p2 = lf_load16(q0 - 3 * stride);
+	r->p1 = lf_load16(q0 - 2 * stride);
+	r->p0 = lf_load16(q0 - stride);
+	r->q0 = lf_load16(q0);
+	r->q1 = lf_load16(q0 + stride);
+	r->q2 = lf_load16(q0 + 2 * stride);
+	r->q3 = lf_load16(q0 + 3 * stride);
+}
+
+TARGET_AVX2 static inline __m256i normal_mask16(const LfRows16* r, int edge_limit, int interior_limit) {
+	__m256i m = abs_diff16(r->p3, r->p2);
+	m = _mm256_max_epi16(m, abs_diff16(r->p2, r->p1));
+	m = _mm256_max_epi16(m, abs_diff16(r->p1, r->p0));
+	m = _mm256_max_epi16(m, abs_diff16(r->q3, r->q2));
+	m = _mm256_max_epi16(m, abs_diff16(r->q2, r->q1));
+	m = _mm256_max_epi16(m, abs_diff16(r->q1, r->q0));
+	const __m256i d = _mm256_add_epi16(_mm256_slli_epi16(abs_diff16(r->p0, r->q0), 1),
+	                                   _mm256_srli_epi16(abs_diff16(r->p1, r->q1), 1));
+	return _mm256_and_si256(le16(m, interior_limit), le16(d, 2 * edge_limit + interior_limit));
+}
+
+TARGET_AVX2 static inline __m256i hev_mask16(const LfRows16* r, int hev_threshold) {
+	const __m256i m = _mm256_max_epi16(abs_diff16(r->p1, r->p0), abs_diff16(r->q1, r->q0));
+	return _mm256_cmpgt_epi16(m, _mm256_set1_epi16((int16_t)hev_threshold));
+}
+
+TARGET_AVX2 static inline __m256i lf_base16(const LfRows16* r) {
+	const __m256i d = _mm256_sub_epi16(r->q0, r->p0);
+	return _mm256_add_epi16(_mm256_add_epi16(d, d), d);
+}
+
+TARGET_AVX2 static inline __m256i lf_tap16(__m256i w, int k) {
+	return _mm256_srai_epi16(
+	    _mm256_add_epi16(_mm256_mullo_epi16(w, _mm256_set1_epi16((int16_t)k)), _mm256_set1_epi16(63)), 7);
+}
+
+TARGET_AVX2 static void filter_mb_h_edge_avx2(uint8_t* q0, int stride, int edge_limit, int interior_limit,
+                                             int hev_threshold, int size_blocks) {
+	if (size_blocks != 2) {
+		filter_mb_h_edge_sse2(q0, stride, edge_limit, interior_limit, hev_threshold, size_blocks);
+		return;
+	}
+	LfRows16 r;
+	lf_load_rows16(&r, q0, stride);
+	const __m256i mask = normal_mask16(&r, edge_limit, interior_limit);
+	if (_mm256_testz_si256(mask, mask)) return;
+	const __m256i hev = hev_mask16(&r, hev_threshold);
+	const __m256i w = clamp_i8_16(_mm256_add_epi16(clamp_i8_16(_mm256_sub_epi16(r.p1, r.q1)), lf_base16(&r)));
+
+	const __m256i f1 = _mm256_srai_epi16(clamp_i8_16(_mm256_add_epi16(w, _mm256_set1_epi16(4))), 3);
+	const __m256i f2 = _mm256_srai_epi16(clamp_i8_16(_mm256_add_epi16(w, _mm256_set1_epi16(3))), 3);
+	const __m256i a27 = lf_tap16(w, 27);
+	const __m256i a18 = lf_tap16(w, 18);
+	const __m256i a9 = lf_tap16(w, 9);
+	const __m256i mb = _mm256_andnot_si256(hev, mask);
+	const __m256i p0 = select16(hev, _mm256_add_epi16(r.p0, f2), _mm256_add_epi16(r.p0, a27));
+	const __m256i q0v = select16(hev, _mm256_sub_epi16(r.q0, f1), _mm256_sub_epi16(r.q0, a27));
+
+	lf_store16(q0 - 3 * stride, select16(mb, _mm256_add_epi16(r.p2, a9), r.p2));
+	lf_store16(q0 - 2 * stride, select16(mb, _mm256_add_epi16(r.p1, a18), r.p1));
+	lf_store16(q0 - stride, select16(mask, p0, r.p0));
+	lf_store16(q0, select16(mask, q0v, r.q0));
+	lf_store16(q0 + stride, select16(mb, _mm256_sub_epi16(r.q1, a18), r.q1));
+	lf_store16(q0 + 2 * stride, select16(mb, _mm256_sub_epi16(r.q2, a9), r.q2));
+}
+
+TARGET_AVX2 static void filter_subblock_h_edge_avx2(uint8_t* q0, int stride, int edge_limit, int interior_limit,
+                                                   int hev_threshold, int size_blocks) {
+	if (size_blocks != 2) {
+		filter_subblock_h_edge_sse2(q0, stride, edge_limit, interior_limit, hev_threshold, size_blocks);
+		return;
+	}
+	LfRows16 r;
+	lf_load_rows16(&r, q0, stride);
+	const __m256i mask = normal_mask16(&r, edge_limit, interior_limit);
+	if (_mm256_testz_si256(mask, mask)) return;
+	const __m256i hev = hev_mask16(&r, hev_threshold);
+	const __m256i outer = _mm256_and_si256(hev, _mm256_sub_epi16(r.p1, r.q1));
+	const __m256i a = clamp_i8_16(_mm256_add_epi16(lf_base16(&r), clamp_i8_16(outer)));
+
+	const __m256i f1 = _mm256_srai_epi16(clamp_i8_16(_mm256_add_epi16(a, _mm256_set1_epi16(4))), 3);
+	const __m256i f2 = _mm256_srai_epi16(clamp_i8_16(_mm256_add_epi16(a, _mm256_set1_epi16(3))), 3);
+	const __m256i a2 = _mm256_srai_epi16(_mm256_add_epi16(f1, _mm256_set1_epi16(1)), 1);
+	const __m256i inner = _mm256_andnot_si256(hev, mask);
+
+	lf_store16(q0 - 2 * stride, select16(inner, _mm256_add_epi16(r.p1, a2), r.p1));
+	lf_store16(q0 - stride, select16(mask, _mm256_add_epi16(r.p0, f2), r.p0));
+	lf_store16(q0, select16(mask, _mm256_sub_epi16(r.q0, f1), r.q0));
+	lf_store16(q0 + stride, select16(inner, _mm256_sub_epi16(r.q1, a2), r.q1));
+}
+
+// --- m08/m09: fancy upsampler + YUV->RGB ---
+
+// libwebp's VP8YuvToRgb on 8 pixels held as (value << 8) in 16-bit lanes.
+TARGET_SSE2 static inline void yuv_to_rgb8(__m128i y, __m128i u, __m128i v, __m128i* r, __m128i* g, __m128i* b) {
+	const __m128i y1 = _mm_mulhi_epu16(y, _mm_set1_epi16(19077));
+	const __m128i r0 = _mm_mulhi_epu16(v, _mm_set1_epi16(26149));
+	const __m128i g0 = _mm_mulhi_epu16(u, _mm_set1_epi16(6419));
+	const __m128i g1 = _mm_mulhi_epu16(v, _mm_set1_epi16(13320));
+	const __m128i b0 = _mm_mulhi_epu16(u, _mm_set1_epi16((int16_t)33050));
+	const __m128i r1 = _mm_add_epi16(_mm_sub_epi16(y1, _mm_set1_epi16(14234)), r0);
+	const __m128i g2 = _mm_sub_epi16(_mm_add_epi16(y1, _mm_set1_epi16(8708)), _mm_add_epi16(g0, g1));
+	// b can exceed int16: saturate in unsigned arithmetic instead.
+	const __m128i b1 = _mm_subs_epu16(_mm_adds_epu16(b0, y1), _mm_set1_epi16(17685));
+	*r = _mm_srai_epi16(r1, YUV_FIX2);
+	*g = _mm_srai_epi16(g2, YUV_FIX2);
+	*b = _mm_srli_epi16(b1, YUV_FIX2);
+}
+
+// Interpolated chroma for 16 output pixels 2x-1 .. 2x+14 from 9 source
+// columns x-1 .. x+7 of one plane; returned as (value << 8), top and bottom.
+TARGET_SSE2 static inline void upsample_chroma16(const uint8_t* top, const uint8_t* cur, __m128i out_top[2],
+                                                 __m128i out_bottom[2]) {
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i tl = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i*)(top - 1)), zero);
+	const __m128i t = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i*)top), zero);
+	const __m128i l = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i*)(cur - 1)), zero);
+	const __m128i c = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i*)cur), zero);
+
+	const __m128i avg = _mm_add_epi16(_mm_add_epi16(_mm_add_epi16(tl, t), _mm_add_epi16(l, c)), _mm_set1_epi16(8));
+	const __m128i tl_c = _mm_add_epi16(tl, c);
+	const __m128i t_l = _mm_add_epi16(t, l);
+	const __m128i diag_12 = _mm_srli_epi16(_mm_add_epi16(avg, _mm_add_epi16(t_l, t_l)), 3);
+	const __m128i diag_03 = _mm_srli_epi16(_mm_add_epi16(avg, _mm_add_epi16(tl_c, tl_c)), 3);
+
+	const __m128i top0 = _mm_srli_epi16(_mm_add_epi16(diag_12, tl), 1);
+	const __m128i top1 = _mm_srli_epi16(_mm_add_epi16(diag_03, t), 1);
+	const __m128i bot0 = _mm_srli_epi16(_mm_add_epi16(diag_03, l), 1);
+	const __m128i bot1 = _mm_srli_epi16(_mm_add_epi16(diag_12, c), 1);
+
+	out_top[0] = _mm_slli_epi16(_mm_unpacklo_epi16(top0, top1), 8);
+	out_top[1] = _mm_slli_epi16(_mm_unpackhi_epi16(top0, top1), 8);
+	out_bottom[0] = _mm_slli_epi16(_mm_unpacklo_epi16(bot0, bot1), 8);
+	out_bottom[1] = _mm_slli_epi16(_mm_unpackhi_epi16(bot0, bot1), 8);
+}
+
+TARGET_SSE2 static inline void convert_row16(const uint8_t* y, const __m128i u[2], const __m128i v[2], uint8_t* dst,
+                                             uint32_t step) {
+	const __m128i yy = _mm_loadu_si128((const __m128i*)y);
+	const __m128i y_lo = _mm_unpacklo_epi8(_mm_setzero_si128(), yy);
+	const __m128i y_hi = _mm_unpackhi_epi8(_mm_setzero_si128(), yy);
+	__m128i r_lo, g_lo, b_lo, r_hi, g_hi, b_hi;
+	yuv_to_rgb8(y_lo, u[0], v[0], &r_lo, &g_lo, &b_lo);
+	yuv_to_rgb8(y_hi, u[1], v[1], &r_hi, &g_hi, &b_hi);
+
+	uint8_t rr[16], gg[16], bb[16];
+	_mm_storeu_si128((__m128i*)rr, _mm_packus_epi16(r_lo, r_hi));
+	_mm_storeu_si128((__m128i*)gg, _mm_packus_epi16(g_lo, g_hi));
+	_mm_storeu_si128((__m128i*)bb, _mm_packus_epi16(b_lo, b_hi));
+	for (uint32_t i = 0; i < 16u; i++) {
+		dst[i * step + 0] = rr[i];
+		dst[i * step + 1] = gg[i];
+		dst[i * step + 2] = bb[i];
+	}
+}
+
+TARGET_SSE2 static void upsample_rgb_line_pair_sse2(const uint8_t* top_y, const uint8_t* bottom_y,
+                                                    const uint8_t* top_u, const uint8_t* top_v, const uint8_t* cur_u,
+                                                    const uint8_t* cur_v, uint8_t* top_dst, uint8_t* bottom_dst,
+                                                    uint32_t len, uint32_t step) {
+	if (len == 0) return;
+
+	const uint32_t last_pixel_pair = (len - 1u) >> 1;
+	upsample_edge_pixel(top_y, bottom_y, top_u[0], top_v[0], cur_u[0], cur_v[0], 0, top_dst, bottom_dst, step);
+
+	// Blocks of 8 chroma columns x..x+7 (16 pixels). Loads touch chroma up to
+	// x+7 and luma up to 2x+14, both inside the row for x+7 <= last_pixel_pair.
+	uint32_t x = 1;
+	for (; x + 7u <= last_pixel_pair; x += 8u) {
+		__m128i u_top[2], u_bot[2], v_top[2], v_bot[2];
+		upsample_chroma16(top_u + x, cur_u + x, u_top, u_bot);
+		upsample_chroma16(top_v + x, cur_v + x, v_top, v_bot);
+		const uint32_t px = 2u * x - 1u;
+		convert_row16(top_y + px, u_top, v_top, top_dst + px * step, step);
+		if (bottom_y != NULL) convert_row16(bottom_y + px, u_bot, v_bot, bottom_dst + px * step, step);
+	}
+	upsample_pixel_pairs(top_y, bottom_y, top_u, top_v, cur_u, cur_v, top_dst, bottom_dst, x, last_pixel_pair, step);
+
+	if ((len & 1u) == 0u) {
+		upsample_edge_pixel(top_y, bottom_y, top_u[last_pixel_pair], top_v[last_pixel_pair], cur_u[last_pixel_pair],
+		                    cur_v[last_pixel_pair], len - 1u, top_dst, bottom_dst, step);
+	}
+}
+
+// --- m09: Adler-32 ---
+
+TARGET_SSSE3 static inline uint32_t hsum_epi32(__m128i v) {
+	v = _mm_add_epi32(v, _mm_shuffle_epi32(v, _MM_SHUFFLE(1, 0, 3, 2)));
+	v = _mm_add_epi32(v, _mm_shuffle_epi32(v, _MM_SHUFFLE(2, 3, 0, 1)));
+	return (uint32_t)_mm_cvtsi128_si32(v);
+}
+
+TARGET_SSSE3 static void adler32_update_ssse3(uint32_t* a, uint32_t* b, const uint8_t* buf, size_t len) {
+	// Same deferred-modulo bound as the scalar version (5552 bytes); chunks
+	// are rounded down to whole 16-byte blocks. Per block:
+	//   a += sum(x[i]),  b += 16*a_before + sum((16 - i) * x[i]).
+	const uint32_t MOD = 65521u;
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i ones = _mm_set1_epi16(1);
+	const __m128i weights = _mm_setr_epi8(16, 15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1);
+	uint32_t aa = *a;
+	uint32_t bb = *b;
+	while (len >= 16u) {
+		size_t n = (len < 5552u) ? (len & ~(size_t)15) : 5536u;
+		len -= n;
+		bb += aa * (uint32_t)n;
+		__m128i vs1 = zero;
+		__m128i vs1_prefix = zero;
+		__m128i vs2 = zero;
+		for (; n > 0; n -= 16u) {
+			const __m128i v = _mm_loadu_si128((const __m128i*)buf);
+			buf += 16;
+			vs1_prefix = _mm_add_epi32(vs1_prefix, vs1);
+			vs1 = _mm_add_epi32(vs1, _mm_sad_epu8(v, zero));
+			vs2 = _mm_add_epi32(vs2, _mm_madd_epi16(_mm_maddubs_epi16(v, weights), ones));
+		}
+		vs2 = _mm_add_epi32(vs2, _mm_slli_epi32(vs1_prefix, 4));
+		aa += hsum_epi32(vs1);
+		bb += hsum_epi32(vs2);
+		aa %= MOD;
+		bb %= MOD;
+	}
+	while (len--) {
+		aa += *buf++;
+		bb += aa;
+	}
+	*a = aa % MOD;
+	*b = bb % MOD;
+}
+
+void vp8_dsp_init_sse2(Vp8Dsp* dsp) {
+	dsp->level = CPU_LEVEL_SSE2;
+	dsp->inv_dct4x4 = inv_dct4x4_sse2;
+	dsp->pred16[VP8_PRED_DC] = pred16_dc_sse2;
+	dsp->pred16[VP8_PRED_V] = pred16_v_sse2;
+	dsp->pred16[VP8_PRED_H] = pred16_h_sse2;
+	dsp->pred16[VP8_PRED_TM] = pred16_tm_sse2;
+	dsp->pred16[VP8_PRED_DC_NO_TOP] = pred16_dc_no_top_sse2;
+	dsp->pred16[VP8_PRED_DC_NO_LEFT] = pred16_dc_no_left_sse2;
+	dsp->pred16[VP8_PRED_DC_NO_TOP_LEFT] = pred16_dc_no_top_left_sse2;
+	dsp->pred8[VP8_PRED_DC] = pred8_dc_sse2;
+	dsp->pred8[VP8_PRED_V] = pred8_v_sse2;
+	dsp->pred8[VP8_PRED_H] = pred8_h_sse2;
+	dsp->pred8[VP8_PRED_TM] = pred8_tm_sse2;
+	dsp->pred8[VP8_PRED_DC_NO_TOP] = pred8_dc_no_top_sse2;
+	dsp->pred8[VP8_PRED_DC_NO_LEFT] = pred8_dc_no_left_sse2;
+	dsp->pred8[VP8_PRED_DC_NO_TOP_LEFT] = pred8_dc_no_top_left_sse2;
+	dsp->subblock_predict = subblock_predict_sse2;
+	dsp->lf_mb_v_edge = filter_mb_v_edge_sse2;
+	dsp->lf_mb_h_edge = filter_mb_h_edge_sse2;
+	dsp->lf_subblock_v_edge = filter_subblock_v_edge_sse2;
+	dsp->lf_subblock_h_edge = filter_subblock_h_edge_sse2;
+	dsp->lf_simple_v_edge = filter_v_edge_simple_sse2;
+	dsp->lf_simple_h_edge = filter_h_edge_simple_sse2;
+	dsp->upsample_rgb_line_pair = upsample_rgb_line_pair_sse2;
+}
+
+void vp8_dsp_init_ssse3(Vp8Dsp* dsp) {
+	dsp->level = CPU_LEVEL_SSSE3;
+	dsp->adler32_update = adler32_update_ssse3;
+}
+
+void vp8_dsp_init_avx2(Vp8Dsp* dsp) {
+	dsp->level = CPU_LEVEL_AVX2;
+	dsp->lf_mb_h_edge = filter_mb_h_edge_avx2;
+	dsp->lf_subblock_h_edge = filter_subblock_h_edge_avx2;
+}
+
+#else
+
+// Non-x86 and ultra builds: scalar kernels only (dsp.c never calls the setters).
+typedef int dsp_x86_unused;
+
+#endif
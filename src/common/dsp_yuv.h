@@ -0,0 +1,104 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Scalar YUV->RGB building blocks shared by the reference upsampler
+// (dsp_scalar.c) and the SIMD variants (dsp_x86.c), which use them for the
+// edge pixels and tails their vector loops do not cover.
+
+// Bit-exact VP8/WebP YUV->RGB conversion (matches libwebp's VP8YuvToRgb).
+enum {
+	YUV_FIX2 = 6,
+	YUV_MASK2 = (256 << YUV_FIX2) - 1
+};
+
+static inline int mult_hi(int v, int coeff) {
+	// _mm_mulhi_epu16 emulation used by libwebp.
+	return (v * coeff) >> 8;
+}
+
+static inline uint8_t vp8_clip8(int v) {
+	// The (v & ~YUV_MASK2) fast-path is safe: it checks whether v is in [0, 255<<6].
+	if ((v & ~YUV_MASK2) == 0) return (uint8_t)(v >> YUV_FIX2);
+	return (v < 0) ? 0u : 255u;
+}
+
+static inline void vp8_yuv_to_rgb(uint8_t y, uint8_t u, uint8_t v, uint8_t* dst3) {
+	// These coefficients bake in the (Y-16), (U-128), (V-128) offsets.
+	const int Y = (int)y;
+	const int U = (int)u;
+	const int V = (int)v;
+	const int r = mult_hi(Y, 19077) + mult_hi(V, 26149) - 14234;
+	const int g = mult_hi(Y, 19077) - mult_hi(U, 6419) - mult_hi(V, 13320) + 8708;
+	const int b = mult_hi(Y, 19077) + mult_hi(U, 33050) - 17685;
+	dst3[0] = vp8_clip8(r);
+	dst3[1] = vp8_clip8(g);
+	dst3[2] = vp8_clip8(b);
+}
+
+// First/last pixel of a row pair: only one chroma column contributes.
+// tl_* is the chroma sample above, l_* the one on the current row.
+static inline void upsample_edge_pixel(const uint8_t* top_y, const uint8_t* bottom_y, uint32_t tl_u, uint32_t tl_v,
+                                       uint32_t l_u, uint32_t l_v, uint32_t idx, uint8_t* top_dst,
+                                       uint8_t* bottom_dst, uint32_t step) {
+	{
+		const uint8_t u0 = (uint8_t)((3u * tl_u + l_u + 2u) >> 2);
+		const uint8_t v0 = (uint8_t)((3u * tl_v + l_v + 2u) >> 2);
+		vp8_yuv_to_rgb(top_y[idx], u0, v0, top_dst + idx * step);
+	}
+	if (bottom_y != NULL) {
+		const uint8_t u0 = (uint8_t)((3u * l_u + tl_u + 2u) >> 2);
+		const uint8_t v0 = (uint8_t)((3u * l_v + tl_v + 2u) >> 2);
+		vp8_yuv_to_rgb(bottom_y[idx], u0, v0, bottom_dst + idx * step);
+	}
+}
+
+// Fancy 4:2:0 upsampler (matches libwebp's DSP path):
+// Given chroma samples laid out as:
+//   [a b]
+//   [c d]
+// it interpolates the 2x2 luma chroma values as:
+//   top:    ([9a+3b+3c+1d, 3a+9b+3c+1d] + 8) / 16
+//   bottom: ([3a+1b+9c+3d, 1a+3b+3c+9d] + 8) / 16
+//
+// Emits the interior pixel pairs (2x-1, 2x) for chroma columns x in [x_begin, x_end].
+static inline void upsample_pixel_pairs(const uint8_t* top_y, const uint8_t* bottom_y, const uint8_t* top_u,
+                                        const uint8_t* top_v, const uint8_t* cur_u, const uint8_t* cur_v,
+                                        uint8_t* top_dst, uint8_t* bottom_dst, uint32_t x_begin, uint32_t x_end,
+                                        uint32_t step) {
+	for (uint32_t x = x_begin; x <= x_end; ++x) {
+		const uint32_t tl_u = top_u[x - 1u];
+		const uint32_t tl_v = top_v[x - 1u];
+		const uint32_t l_u = cur_u[x - 1u];
+		const uint32_t l_v = cur_v[x - 1u];
+		const uint32_t t_u = top_u[x];
+		const uint32_t t_v = top_v[x];
+		const uint32_t u = cur_u[x];
+		const uint32_t v = cur_v[x];
+
+		const uint32_t avg_u = tl_u + t_u + l_u + u + 8u;
+		const uint32_t avg_v = tl_v + t_v + l_v + v + 8u;
+		const uint32_t diag_12_u = (avg_u + 2u * (t_u + l_u)) >> 3;
+		const uint32_t diag_12_v = (avg_v + 2u * (t_v + l_v)) >> 3;
+		const uint32_t diag_03_u = (avg_u + 2u * (tl_u + u)) >> 3;
+		const uint32_t diag_03_v = (avg_v + 2u * (tl_v + v)) >> 3;
+
+		{
+			const uint8_t u0 = (uint8_t)((diag_12_u + tl_u) >> 1);
+			const uint8_t v0 = (uint8_t)((diag_12_v + tl_v) >> 1);
+			const uint8_t u1 = (uint8_t)((diag_03_u + t_u) >> 1);
+			const uint8_t v1 = (uint8_t)((diag_03_v + t_v) >> 1);
+			vp8_yuv_to_rgb(top_y[2u * x - 1u], u0, v0, top_dst + (2u * x - 1u) * step);
+			vp8_yuv_to_rgb(top_y[2u * x + 0u], u1, v1, top_dst + (2u * x + 0u) * step);
+		}
+		if (bottom_y != NULL) {
+			const uint8_t u0 = (uint8_t)((diag_03_u + l_u) >> 1);
+			const uint8_t v0 = (uint8_t)((diag_03_v + l_v) >> 1);
+			const uint8_t u1 = (uint8_t)((diag_12_u + u) >> 1);
+			const uint8_t v1 = (uint8_t)((diag_12_v + v) >> 1);
+			vp8_yuv_to_rgb(bottom_y[2u * x - 1u], u0, v0, bottom_dst + (2u * x - 1u) * step);
+			vp8_yuv_to_rgb(bottom_y[2u * x + 0u], u1, v1, bottom_dst + (2u * x + 0u) * step);
+		}
+	}
+}
@@ -0,0 +1,40 @@
+#include "enc_dsp.h"
+
+// Like dsp.c: the ultra build stays scalar-only.
+#if !defined(ENCODER_ULTRA) && (defined(__x86_64__) || defined(__i386__))
+#define ENC_DSP_HAVE_X86 1
+#else
+#define ENC_DSP_HAVE_X86 0
+#endif
+
+void enc_dsp_init_level(EncDsp* out, CpuLevel level) {
+#if ENC_DSP_HAVE_X86
+	CpuLevel max = cpu_detect_level();
+	if (level > max) level = max;
+#else
+	level = CPU_LEVEL_SCALAR;
+#endif
+	enc_dsp_init_scalar(out);
+#if ENC_DSP_HAVE_X86
+	if (level >= CPU_LEVEL_SSE2) enc_dsp_init_sse2(out);
+	if (level >= CPU_LEVEL_SSSE3) enc_dsp_init_ssse3(out);
+	if (level >= CPU_LEVEL_AVX2) enc_dsp_init_avx2(out);
+#endif
+	out->level = level;
+}
+
+static EncDsp g_enc_dsp;
+static CpuOnce g_enc_dsp_once;
+
+static void enc_dsp_init_once(void) {
+#if ENC_DSP_HAVE_X86
+	enc_dsp_init_level(&g_enc_dsp, cpu_level());
+#else
+	enc_dsp_init_level(&g_enc_dsp, CPU_LEVEL_SCALAR);
+#endif
+}
+
+const EncDsp* enc_dsp(void) {
+	cpu_once(&g_enc_dsp_once, enc_dsp_init_once);
+	return &g_enc_dsp;
+}
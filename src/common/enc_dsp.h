@@ -0,0 +1,73 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "cpu.h"
+
+// A 4x4 quantizer with the division by the step replaced by a reciprocal
+// multiply, filled by enc_dsp_quant_init(). Entries are per coefficient in
+// natural order (0 is DC), like libwebp's VP8Matrix.
+typedef struct {
+	uint32_t iq[16];      // floor(2^31 / step) + 1; 0 when step <= 0
+	uint32_t bias[16];    // step >> 1 (round to nearest)
+	uint32_t zthresh[16]; // |c| < zthresh quantizes to 0
+} EncDspQuant;
+
+// Hot encoder kernels, dispatched at runtime on the CPU level like the
+// decoder's (dsp.h). Every variant is bit-exact with the scalar reference in
+// enc_dsp_scalar.c.
+
+typedef struct {
+	CpuLevel level;
+
+	// enc-m04: libwebp-compatible RGB -> limited-range Y for one row. step is
+	// the input bytes per pixel (3 or 4; alpha is ignored).
+	void (*rgb_to_y_row)(const uint8_t* rgb, uint8_t* y, uint32_t width, uint32_t step);
+
+	// enc-m04: one row of U and V from a row pair, averaging each 2x2 quad in
+	// linear light (libwebp's gamma-corrected chroma). `width` is the luma
+	// width; an odd last column is replicated. row1 == row0 for the last row of
+	// an odd-height image.
+	void (*rgb_to_uv_row)(const uint8_t* row0, const uint8_t* row1, uint8_t* u, uint8_t* v, uint32_t width,
+	                      uint32_t step);
+
+	// enc-m08 mode decision. 4x4 blocks are 16 contiguous bytes (row-major).
+	uint32_t (*sad4x4)(const uint8_t a[16], const uint8_t b[16]);
+	// SSE of src against the reconstruction clamp255(pred + res).
+	uint32_t (*sse4x4_recon)(const uint8_t src[16], const uint8_t pred[16], const int16_t res[16]);
+	// Sum of |4x4 Hadamard(src - pred)|, halved and rounded up (ranking only).
+	uint32_t (*satd4x4)(const uint8_t src[16], const uint8_t pred[16]);
+	// src is a block inside a plane with stride src_stride; pred is contiguous.
+	uint32_t (*sse16x16)(const uint8_t* src, size_t src_stride, const uint8_t pred[16 * 16]);
+	uint32_t (*sad8x8)(const uint8_t* src, size_t src_stride, const uint8_t pred[8 * 8]);
+	uint32_t (*sse8x8)(const uint8_t* src, size_t src_stride, const uint8_t pred[8 * 8]);
+
+	// enc-m05/m06 (enc_vp8_ftransform4x4, enc_vp8_ftransform_wht,
+	// enc_vp8_quantize4x4_inplace). ftransform4x4x2 transforms the two blocks
+	// src[k] - ref[k] at once; they need not be adjacent.
+	void (*ftransform4x4)(const uint8_t* src, int src_stride, const uint8_t* ref, int ref_stride, int16_t out[16]);
+	void (*ftransform4x4x2)(const uint8_t* const src[2], int src_stride, const uint8_t* const ref[2], int ref_stride,
+	                        int16_t out[2][16]);
+	void (*ftransform_wht)(const int16_t* in, int16_t out[16]);
+	void (*quantize4x4)(int16_t coeffs[16], const EncDspQuant* q);
+} EncDsp;
+
+// Quantizer for enc_vp8_quantize4x4_inplace(coeffs, dc_step, ac_step) with
+// steps up to 32767, for which the reciprocal is exact. ac_zero_pct > 0 also
+// zeroes AC coefficients with |c| * 100 < ac_step * ac_zero_pct (bpred-rdo's
+// AC deadzone).
+void enc_dsp_quant_init(EncDspQuant* q, int dc_step, int ac_step, uint32_t ac_zero_pct);
+
+// Kernel table for cpu_level(); initialized on first use, from any thread.
+const EncDsp* enc_dsp(void);
+
+// Fills `out` for an explicit level (clamped to cpu_detect_level()); used by
+// tools/dsp_selftest.c to compare every available variant against scalar.
+void enc_dsp_init_level(EncDsp* out, CpuLevel level);
+
+// Per-level setters (enc_dsp_scalar.c / enc_dsp_x86.c). Each overrides the entries it implements.
+void enc_dsp_init_scalar(EncDsp* dsp);
+void enc_dsp_init_sse2(EncDsp* dsp);
+void enc_dsp_init_ssse3(EncDsp* dsp);
+void enc_dsp_init_avx2(EncDsp* dsp);
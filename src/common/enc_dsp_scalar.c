@@ -0,0 +1,235 @@
+// Scalar reference kernels for the encoder dispatch table (enc_dsp.h).
+
+#include "enc_dsp.h"
+#include "enc_dsp_yuv.h"
+
+#include "../enc-m04_yuv/enc_gamma_tables.h"
+
+uint32_t enc_dsp_gamma_to_linear32[256];
+uint16_t enc_dsp_sum_to_gamma[ENC_GAMMA_SUM_MAX + 2];
+
+// libwebp's LinearToGamma(base_value, 0): interpolates enc_linear_to_gamma_tab.
+static int linear_to_gamma(uint32_t base_value) {
+	const int scale = 1 << (ENC_GAMMA_TAB_FIX + 2);
+	const int v = (int)base_value;
+	const int tab_pos = v >> (ENC_GAMMA_TAB_FIX + 2);
+	const int x = v & (scale - 1);
+	int y;
+	if (tab_pos >= ENC_GAMMA_TAB_SIZE) {
+		y = enc_linear_to_gamma_tab[ENC_GAMMA_TAB_SIZE] * scale;
+	} else {
+		const int v0 = enc_linear_to_gamma_tab[tab_pos];
+		const int v1 = enc_linear_to_gamma_tab[tab_pos + 1];
+		y = v1 * x + v0 * (scale - x);
+	}
+	return (y + (1 << (ENC_GAMMA_TAB_FIX - 1))) >> ENC_GAMMA_TAB_FIX;
+}
+
+static void fill_gamma_tables(void) {
+	for (int i = 0; i < 256; i++) enc_dsp_gamma_to_linear32[i] = enc_gamma_to_linear_tab[i];
+	for (uint32_t s = 0; s <= ENC_GAMMA_SUM_MAX; s++) enc_dsp_sum_to_gamma[s] = (uint16_t)linear_to_gamma(s);
+	enc_dsp_sum_to_gamma[ENC_GAMMA_SUM_MAX + 1] = 0;
+}
+
+static void rgb_to_y_row_c(const uint8_t* rgb, uint8_t* y, uint32_t width, uint32_t step) {
+	for (uint32_t x = 0; x < width; x++) {
+		const uint8_t* p = rgb + (size_t)x * step;
+		y[x] = enc_rgb_to_y(p[0], p[1], p[2]);
+	}
+}
+
+static void rgb_to_uv_row_c(const uint8_t* row0, const uint8_t* row1, uint8_t* u, uint8_t* v, uint32_t width,
+                            uint32_t step) {
+	enc_rgb_to_uv_tail(row0, row1, u, v, width, step, 0);
+}
+
+static uint32_t sad4x4_c(const uint8_t a[16], const uint8_t b[16]) {
+	uint32_t sad = 0;
+	for (int i = 0; i < 16; i++) {
+		const int d = (int)a[i] - (int)b[i];
+		sad += (uint32_t)(d < 0 ? -d : d);
+	}
+	return sad;
+}
+
+static uint32_t sse4x4_recon_c(const uint8_t src[16], const uint8_t pred[16], const int16_t res[16]) {
+	uint32_t sse = 0;
+	for (int i = 0; i < 16; i++) {
+		int32_t r = (int32_t)pred[i] + (int32_t)res[i];
+		if (r < 0) r = 0;
+		if (r > 255) r = 255;
+		const int d = (int)src[i] - (int)r;
+		sse += (uint32_t)(d * d);
+	}
+	return sse;
+}
+
+static uint32_t satd4x4_c(const uint8_t src[16], const uint8_t pred[16]) {
+	int32_t tmp[16];
+	for (int y = 0; y < 4; y++) {
+		const int o = y * 4;
+		const int32_t r0 = (int32_t)src[o + 0] - (int32_t)pred[o + 0];
+		const int32_t r1 = (int32_t)src[o + 1] - (int32_t)pred[o + 1];
+		const int32_t r2 = (int32_t)src[o + 2] - (int32_t)pred[o + 2];
+		const int32_t r3 = (int32_t)src[o + 3] - (int32_t)pred[o + 3];
+		const int32_t a0 = r0 + r3;
+		const int32_t a1 = r1 + r2;
+		const int32_t a2 = r1 - r2;
+		const int32_t a3 = r0 - r3;
+		tmp[o + 0] = a0 + a1;
+		tmp[o + 1] = a3 + a2;
+		tmp[o + 2] = a0 - a1;
+		tmp[o + 3] = a3 - a2;
+	}
+	uint32_t sum = 0;
+	for (int x = 0; x < 4; x++) {
+		const int32_t b0 = tmp[0 * 4 + x] + tmp[3 * 4 + x];
+		const int32_t b1 = tmp[1 * 4 + x] + tmp[2 * 4 + x];
+		const int32_t b2 = tmp[1 * 4 + x] - tmp[2 * 4 + x];
+		const int32_t b3 = tmp[0 * 4 + x] - tmp[3 * 4 + x];
+		const int32_t v[4] = {b0 + b1, b3 + b2, b0 - b1, b3 - b2};
+		for (int k = 0; k < 4; k++) sum += (uint32_t)(v[k] < 0 ? -v[k] : v[k]);
+	}
+	return (sum + 1u) >> 1;
+}
+
+static uint32_t sse_block_c(const uint8_t* src, size_t src_stride, const uint8_t* pred, int size) {
+	uint32_t sse = 0;
+	for (int y = 0; y < size; y++) {
+		for (int x = 0; x < size; x++) {
+			const int d = (int)src[(size_t)y * src_stride + (size_t)x] - (int)pred[y * size + x];
+			sse += (uint32_t)(d * d);
+		}
+	}
+	return sse;
+}
+
+static uint32_t sse16x16_c(const uint8_t* src, size_t src_stride, const uint8_t pred[16 * 16]) {
+	return sse_block_c(src, src_stride, pred, 16);
+}
+
+static uint32_t sse8x8_c(const uint8_t* src, size_t src_stride, const uint8_t pred[8 * 8]) {
+	return sse_block_c(src, src_stride, pred, 8);
+}
+
+static uint32_t sad8x8_c(const uint8_t* src, size_t src_stride, const uint8_t pred[8 * 8]) {
+	uint32_t sad = 0;
+	for (int y = 0; y < 8; y++) {
+		for (int x = 0; x < 8; x++) {
+			const int d = (int)src[(size_t)y * src_stride + (size_t)x] - (int)pred[y * 8 + x];
+			sad += (uint32_t)(d < 0 ? -d : d);
+		}
+	}
+	return sad;
+}
+
+// libwebp's FTransform_C, as enc_vp8_ftransform4x4().
+static void ftransform4x4_c(const uint8_t* src, int src_stride, const uint8_t* ref, int ref_stride, int16_t out[16]) {
+	int tmp[16];
+	for (int i = 0; i < 4; ++i) {
+		const uint8_t* s = src + (ptrdiff_t)i * src_stride;
+		const uint8_t* r = ref + (ptrdiff_t)i * ref_stride;
+		const int d0 = (int)s[0] - (int)r[0];
+		const int d1 = (int)s[1] - (int)r[1];
+		const int d2 = (int)s[2] - (int)r[2];
+		const int d3 = (int)s[3] - (int)r[3];
+		const int a0 = d0 + d3;
+		const int a1 = d1 + d2;
+		const int a2 = d1 - d2;
+		const int a3 = d0 - d3;
+		tmp[0 + i * 4] = (a0 + a1) * 8;
+		tmp[1 + i * 4] = (a2 * 2217 + a3 * 5352 + 1812) >> 9;
+		tmp[2 + i * 4] = (a0 - a1) * 8;
+		tmp[3 + i * 4] = (a3 * 2217 - a2 * 5352 + 937) >> 9;
+	}
+	for (int i = 0; i < 4; ++i) {
+		const int a0 = tmp[0 + i] + tmp[12 + i];
+		const int a1 = tmp[4 + i] + tmp[8 + i];
+		const int a2 = tmp[4 + i] - tmp[8 + i];
+		const int a3 = tmp[0 + i] - tmp[12 + i];
+		out[0 + i] = (int16_t)((a0 + a1 + 7) >> 4);
+		out[4 + i] = (int16_t)(((a2 * 2217 + a3 * 5352 + 12000) >> 16) + (a3 != 0));
+		out[8 + i] = (int16_t)((a0 - a1 + 7) >> 4);
+		out[12 + i] = (int16_t)((a3 * 2217 - a2 * 5352 + 51000) >> 16);
+	}
+}
+
+static void ftransform4x4x2_c(const uint8_t* const src[2], int src_stride, const uint8_t* const ref[2], int ref_stride,
+                              int16_t out[2][16]) {
+	ftransform4x4_c(src[0], src_stride, ref[0], ref_stride, out[0]);
+	ftransform4x4_c(src[1], src_stride, ref[1], ref_stride, out[1]);
+}
+
+// libwebp's FTransformWHT_C, as enc_vp8_ftransform_wht(): the 16 DCs are in[k * 16].
+static void ftransform_wht_c(const int16_t* in, int16_t out[16]) {
+	int32_t tmp[16];
+	for (int i = 0; i < 4; ++i, in += 64) {
+		const int a0 = (int)in[0 * 16] + (int)in[2 * 16];
+		const int a1 = (int)in[1 * 16] + (int)in[3 * 16];
+		const int a2 = (int)in[1 * 16] - (int)in[3 * 16];
+		const int a3 = (int)in[0 * 16] - (int)in[2 * 16];
+		tmp[0 + i * 4] = a0 + a1;
+		tmp[1 + i * 4] = a3 + a2;
+		tmp[2 + i * 4] = a3 - a2;
+		tmp[3 + i * 4] = a0 - a1;
+	}
+	for (int i = 0; i < 4; ++i) {
+		const int a0 = (int)(tmp[0 + i] + tmp[8 + i]);
+		const int a1 = (int)(tmp[4 + i] + tmp[12 + i]);
+		const int a2 = (int)(tmp[4 + i] - tmp[12 + i]);
+		const int a3 = (int)(tmp[0 + i] - tmp[8 + i]);
+		out[0 + i] = (int16_t)((a0 + a1) >> 1);
+		out[4 + i] = (int16_t)((a3 + a2) >> 1);
+		out[8 + i] = (int16_t)((a3 - a2) >> 1);
+		out[12 + i] = (int16_t)((a0 - a1) >> 1);
+	}
+}
+
+// With n = |c| + bias <= 32768 + step / 2 and step <= 32767, n * step < 2^31,
+// so (n * iq) >> 31 is exactly n / step.
+void enc_dsp_quant_init(EncDspQuant* q, int dc_step, int ac_step, uint32_t ac_zero_pct) {
+	for (int i = 0; i < 16; i++) {
+		const int step = i == 0 ? dc_step : ac_step;
+		if (step <= 0) {
+			q->iq[i] = 0;
+			q->bias[i] = 0;
+			q->zthresh[i] = 0;
+			continue;
+		}
+		q->iq[i] = (uint32_t)((1u << 31) / (uint32_t)step) + 1u;
+		q->bias[i] = (uint32_t)step >> 1;
+		// |c| * 100 < step * pct  <=>  |c| < ceil(step * pct / 100).
+		q->zthresh[i] = (i > 0 && ac_zero_pct > 0) ? (uint32_t)(((uint64_t)step * ac_zero_pct + 99u) / 100u) : 0;
+	}
+}
+
+static void quantize4x4_c(int16_t coeffs[16], const EncDspQuant* q) {
+	for (int i = 0; i < 16; i++) {
+		const int c = coeffs[i];
+		const uint32_t v = (uint32_t)(c < 0 ? -c : c);
+		if (v < q->zthresh[i]) {
+			coeffs[i] = 0;
+			continue;
+		}
+		const int level = (int)(((uint64_t)(v + q->bias[i]) * q->iq[i]) >> 31);
+		coeffs[i] = (int16_t)(c < 0 ? -level : level);
+	}
+}
+
+void enc_dsp_init_scalar(EncDsp* dsp) {
+	static CpuOnce gamma_once;
+	cpu_once(&gamma_once, fill_gamma_tables);
+	dsp->level = CPU_LEVEL_SCALAR;
+	dsp->rgb_to_y_row = rgb_to_y_row_c;
+	dsp->rgb_to_uv_row = rgb_to_uv_row_c;
+	dsp->sad4x4 = sad4x4_c;
+	dsp->sse4x4_recon = sse4x4_recon_c;
+	dsp->satd4x4 = satd4x4_c;
+	dsp->sse16x16 = sse16x16_c;
+	dsp->sad8x8 = sad8x8_c;
+	dsp->sse8x8 = sse8x8_c;
+	dsp->ftransform4x4 = ftransform4x4_c;
+	dsp->ftransform4x4x2 = ftransform4x4x2_c;
+	dsp->ftransform_wht = ftransform_wht_c;
+	dsp->quantize4x4 = quantize4x4_c;
+}
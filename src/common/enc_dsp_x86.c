@@ -0,0 +1,529 @@
+// x86 SIMD variants for the encoder dispatch table in enc_dsp.h.
+//
+// Built like dsp_x86.c: per-function target attributes, so the file compiles
+// with the baseline -march and only runs what cpu_level() found. Each variant is
+// bit-exact with enc_dsp_scalar.c (tools/dsp_selftest.c).
+//
+// Coverage: SSE2 RGBA->Y; SSSE3 RGB->Y; AVX2 RGB/RGBA->Y and U/V (the chroma
+// gamma tables are read with gathers, so below AVX2 U/V stays scalar). The
+// enc-m08 distortion kernels and the forward DCT/WHT are SSE2: a 4x4 block is
+// one register, and ftransform4x4x2 transforms two blocks side by side. The
+// reciprocal quantizer has SSE2 and AVX2 versions (4 and 8 coefficients per
+// vector).
+
+#include "enc_dsp.h"
+
+#if !defined(ENCODER_ULTRA) && (defined(__x86_64__) || defined(__i386__))
+
+#include <immintrin.h>
+#include <string.h>
+
+#include "enc_dsp_yuv.h"
+
+#define TARGET_SSE2 __attribute__((target("sse2")))
+#define TARGET_SSSE3 __attribute__((target("ssse3")))
+#define TARGET_AVX2 __attribute__((target("avx2")))
+
+// --- enc-m04: RGB -> Y ---
+
+// Y of four pixels given as 16-bit pairs: rb = (r, b) and gx = (g, unused) per
+// pixel. 33059 does not fit an int16 multiplier; g * (33059 - 65536) + (g << 16)
+// is exact (gx's unused half is multiplied by 0 and shifted out).
+TARGET_SSE2 static inline __m128i y_from_pairs_sse2(__m128i rb, __m128i gx) {
+	const __m128i k_rb = _mm_set1_epi32((6420 << 16) | 16839);
+	const __m128i k_g = _mm_set1_epi32((int32_t)(uint16_t)(33059 - 65536));
+	__m128i y = _mm_add_epi32(_mm_madd_epi16(rb, k_rb), _mm_madd_epi16(gx, k_g));
+	y = _mm_add_epi32(y, _mm_slli_epi32(gx, 16));
+	y = _mm_add_epi32(y, _mm_set1_epi32(ENC_YUV_HALF + (16 << ENC_YUV_FIX)));
+	return _mm_srli_epi32(y, ENC_YUV_FIX);
+}
+
+TARGET_SSE2 static inline void store_y8_sse2(uint8_t* dst, __m128i y0, __m128i y1) {
+	const __m128i p = _mm_packs_epi32(y0, y1);
+	_mm_storel_epi64((__m128i*)dst, _mm_packus_epi16(p, p));
+}
+
+TARGET_SSE2 static inline __m128i y_from_rgba_sse2(const uint8_t* p) {
+	const __m128i px = _mm_loadu_si128((const __m128i*)p);
+	return y_from_pairs_sse2(_mm_and_si128(px, _mm_set1_epi16(0x00FF)), _mm_srli_epi16(px, 8));
+}
+
+TARGET_SSE2 static void rgb_to_y_row_sse2(const uint8_t* rgb, uint8_t* y, uint32_t width, uint32_t step) {
+	uint32_t x = 0;
+	if (step == 4) {
+		for (; x + 8u <= width; x += 8u) {
+			const uint8_t* p = rgb + (size_t)x * 4u;
+			store_y8_sse2(y + x, y_from_rgba_sse2(p), y_from_rgba_sse2(p + 16));
+		}
+	}
+	for (; x < width; x++) {
+		const uint8_t* p = rgb + (size_t)x * step;
+		y[x] = enc_rgb_to_y(p[0], p[1], p[2]);
+	}
+}
+
+// Four RGB24 pixels (12 of the 16 loaded bytes) as the (r, b) / (g, 0) pairs.
+TARGET_SSSE3 static inline __m128i y_from_rgb24_ssse3(const uint8_t* p) {
+	const __m128i px = _mm_loadu_si128((const __m128i*)p);
+	const __m128i rb = _mm_shuffle_epi8(px, _mm_setr_epi8(0, -1, 2, -1, 3, -1, 5, -1, 6, -1, 8, -1, 9, -1, 11, -1));
+	const __m128i gx = _mm_shuffle_epi8(px, _mm_setr_epi8(1, -1, -1, -1, 4, -1, -1, -1, 7, -1, -1, -1, 10, -1, -1, -1));
+	return y_from_pairs_sse2(rb, gx);
+}
+
+TARGET_SSSE3 static void rgb_to_y_row_ssse3(const uint8_t* rgb, uint8_t* y, uint32_t width, uint32_t step) {
+	if (step != 3) {
+		rgb_to_y_row_sse2(rgb, y, width, step);
+		return;
+	}
+	uint32_t x = 0;
+	// The second load ends 28 bytes past pixel x: keep it inside the row.
+	for (; x + 10u <= width; x += 8u) {
+		const uint8_t* p = rgb + (size_t)x * 3u;
+		store_y8_sse2(y + x, y_from_rgb24_ssse3(p), y_from_rgb24_ssse3(p + 12));
+	}
+	for (; x < width; x++) {
+		const uint8_t* p = rgb + (size_t)x * 3u;
+		y[x] = enc_rgb_to_y(p[0], p[1], p[2]);
+	}
+}
+
+TARGET_AVX2 static inline __m256i y_from_pairs_avx2(__m256i rb, __m256i gx) {
+	const __m256i k_rb = _mm256_set1_epi32((6420 << 16) | 16839);
+	const __m256i k_g = _mm256_set1_epi32((int32_t)(uint16_t)(33059 - 65536));
+	__m256i y = _mm256_add_epi32(_mm256_madd_epi16(rb, k_rb), _mm256_madd_epi16(gx, k_g));
+	y = _mm256_add_epi32(y, _mm256_slli_epi32(gx, 16));
+	y = _mm256_add_epi32(y, _mm256_set1_epi32(ENC_YUV_HALF + (16 << ENC_YUV_FIX)));
+	return _mm256_srli_epi32(y, ENC_YUV_FIX);
+}
+
+// Eight pixels as 32-bit lanes r | g << 8 | b << 16 (| a << 24 for RGBA).
+TARGET_AVX2 static inline __m256i load_px8_avx2(const uint8_t* p, uint32_t step) {
+	if (step == 4) return _mm256_loadu_si256((const __m256i*)p);
+	const __m256i px = _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_loadu_si128((const __m128i*)p)),
+	                                           _mm_loadu_si128((const __m128i*)(p + 12)), 1);
+	return _mm256_shuffle_epi8(px, _mm256_setr_epi8(0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1, 0, 1, 2,
+	                                                -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1));
+}
+
+TARGET_AVX2 static inline __m256i y_from_px8_avx2(__m256i px) {
+	return y_from_pairs_avx2(_mm256_and_si256(px, _mm256_set1_epi16(0x00FF)), _mm256_srli_epi16(px, 8));
+}
+
+TARGET_AVX2 static void rgb_to_y_row_avx2(const uint8_t* rgb, uint8_t* y, uint32_t width, uint32_t step) {
+	uint32_t x = 0;
+	// RGB24 loads end 52 bytes past pixel x: keep them inside the row.
+	const uint32_t span = (step == 3) ? 18u : 16u;
+	for (; x + span <= width; x += 16u) {
+		const uint8_t* p = rgb + (size_t)x * step;
+		const __m256i ya = y_from_px8_avx2(load_px8_avx2(p, step));
+		const __m256i yb = y_from_px8_avx2(load_px8_avx2(p + 8u * step, step));
+		// packs/packus work per 128-bit lane: gather the four 4-byte groups back in order.
+		const __m256i w = _mm256_packs_epi32(ya, yb);
+		const __m256i b = _mm256_permutevar8x32_epi32(_mm256_packus_epi16(w, w), _mm256_setr_epi32(0, 4, 1, 5, 0, 0, 0, 0));
+		_mm_storeu_si128((__m128i*)(y + x), _mm256_castsi256_si128(b));
+	}
+	for (; x < width; x++) {
+		const uint8_t* p = rgb + (size_t)x * step;
+		y[x] = enc_rgb_to_y(p[0], p[1], p[2]);
+	}
+}
+
+// --- enc-m04: RGB -> U/V ---
+
+// Linear-light values of channel `shift / 8` of eight pixels.
+TARGET_AVX2 static inline __m256i to_linear8_avx2(__m256i px, int shift) {
+	const __m256i idx = _mm256_and_si256(_mm256_srlv_epi32(px, _mm256_set1_epi32(shift)), _mm256_set1_epi32(0xFF));
+	return _mm256_i32gather_epi32((const int*)enc_dsp_gamma_to_linear32, idx, 4);
+}
+
+TARGET_AVX2 static inline __m256i uv_from_sums_avx2(__m256i r, __m256i g, __m256i b, int kr, int kg, int kb) {
+	__m256i t = _mm256_add_epi32(_mm256_mullo_epi32(r, _mm256_set1_epi32(kr)), _mm256_mullo_epi32(g, _mm256_set1_epi32(kg)));
+	t = _mm256_add_epi32(t, _mm256_mullo_epi32(b, _mm256_set1_epi32(kb)));
+	t = _mm256_add_epi32(t, _mm256_set1_epi32((ENC_YUV_HALF << 2) + (128 << (ENC_YUV_FIX + 2))));
+	// Chroma lanes come out of hadd as 0,1,4,5 | 2,3,6,7.
+	return _mm256_permute4x64_epi64(_mm256_srai_epi32(t, ENC_YUV_FIX + 2), _MM_SHUFFLE(3, 1, 2, 0));
+}
+
+TARGET_AVX2 static void rgb_to_uv_row_avx2(const uint8_t* row0, const uint8_t* row1, uint8_t* u, uint8_t* v,
+                                           uint32_t width, uint32_t step) {
+	uint32_t ux = 0;
+	const uint32_t span = (step == 3) ? 18u : 16u;
+	for (; 2u * ux + span <= width; ux += 8u) {
+		const size_t off = (size_t)(2u * ux) * step;
+		const __m256i a0 = load_px8_avx2(row0 + off, step);
+		const __m256i a1 = load_px8_avx2(row1 + off, step);
+		const __m256i b0 = load_px8_avx2(row0 + off + 8u * step, step);
+		const __m256i b1 = load_px8_avx2(row1 + off + 8u * step, step);
+		__m256i sum[3];
+		for (int c = 0; c < 3; c++) {
+			const __m256i la = _mm256_add_epi32(to_linear8_avx2(a0, 8 * c), to_linear8_avx2(a1, 8 * c));
+			const __m256i lb = _mm256_add_epi32(to_linear8_avx2(b0, 8 * c), to_linear8_avx2(b1, 8 * c));
+			// Sum horizontal pairs: one 2x2 quad per lane (<= ENC_GAMMA_SUM_MAX).
+			const __m256i quad = _mm256_hadd_epi32(la, lb);
+			const __m256i g = _mm256_i32gather_epi32((const int*)enc_dsp_sum_to_gamma, quad, 2);
+			sum[c] = _mm256_and_si256(g, _mm256_set1_epi32(0xFFFF));
+		}
+		const __m256i uu = uv_from_sums_avx2(sum[0], sum[1], sum[2], -9719, -19081, 28800);
+		const __m256i vv = uv_from_sums_avx2(sum[0], sum[1], sum[2], 28800, -24116, -4684);
+		// Saturating packs clip to 0..255 like enc_clip_u8().
+		const __m256i w = _mm256_packs_epi32(uu, vv);
+		const __m256i bytes = _mm256_permutevar8x32_epi32(_mm256_packus_epi16(w, w), _mm256_setr_epi32(0, 4, 1, 5, 0, 0, 0, 0));
+		const __m128i uv = _mm256_castsi256_si128(bytes);
+		_mm_storel_epi64((__m128i*)(u + ux), uv);
+		_mm_storel_epi64((__m128i*)(v + ux), _mm_srli_si128(uv, 8));
+	}
+	enc_rgb_to_uv_tail(row0, row1, u, v, width, step, ux);
+}
+
+// --- enc-m08: distortion ---
+
+// Adds the four int32 lanes.
+TARGET_SSE2 static inline uint32_t hsum_epi32_sse2(__m128i v) {
+	v = _mm_add_epi32(v, _mm_shuffle_epi32(v, _MM_SHUFFLE(1, 0, 3, 2)));
+	v = _mm_add_epi32(v, _mm_shuffle_epi32(v, _MM_SHUFFLE(2, 3, 0, 1)));
+	return (uint32_t)_mm_cvtsi128_si32(v);
+}
+
+// Sum of squares of the 16-bit differences a - b (|a - b| <= 255).
+TARGET_SSE2 static inline __m128i sq_diff_epi16_sse2(__m128i a, __m128i b) {
+	const __m128i d = _mm_sub_epi16(a, b);
+	return _mm_madd_epi16(d, d);
+}
+
+TARGET_SSE2 static uint32_t sad4x4_sse2(const uint8_t a[16], const uint8_t b[16]) {
+	const __m128i sad = _mm_sad_epu8(_mm_loadu_si128((const __m128i*)a), _mm_loadu_si128((const __m128i*)b));
+	return (uint32_t)_mm_cvtsi128_si32(_mm_add_epi32(sad, _mm_srli_si128(sad, 8)));
+}
+
+TARGET_SSE2 static uint32_t sse4x4_recon_sse2(const uint8_t src[16], const uint8_t pred[16], const int16_t res[16]) {
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i p = _mm_loadu_si128((const __m128i*)pred);
+	const __m128i s = _mm_loadu_si128((const __m128i*)src);
+	// pred + res saturates to int16 before packus clamps it, which is still
+	// the clamp of the exact sum (pred is 0..255).
+	const __m128i lo = _mm_adds_epi16(_mm_unpacklo_epi8(p, zero), _mm_loadu_si128((const __m128i*)res));
+	const __m128i hi = _mm_adds_epi16(_mm_unpackhi_epi8(p, zero), _mm_loadu_si128((const __m128i*)(res + 8)));
+	const __m128i r = _mm_packus_epi16(lo, hi);
+	const __m128i sse = _mm_add_epi32(sq_diff_epi16_sse2(_mm_unpacklo_epi8(s, zero), _mm_unpacklo_epi8(r, zero)),
+	                                  sq_diff_epi16_sse2(_mm_unpackhi_epi8(s, zero), _mm_unpackhi_epi8(r, zero)));
+	return hsum_epi32_sse2(sse);
+}
+
+// Transposes the 4x4 int16 block held as rows (0, 1) in a and rows (2, 3) in
+// b into columns (0, 1) in *c01 and columns (2, 3) in *c23.
+TARGET_SSE2 static inline void transpose4x4_epi16_sse2(__m128i a, __m128i b, __m128i* c01, __m128i* c23) {
+	const __m128i t0 = _mm_unpacklo_epi16(a, b);
+	const __m128i t1 = _mm_unpackhi_epi16(a, b);
+	*c01 = _mm_unpacklo_epi16(t0, t1);
+	*c23 = _mm_unpackhi_epi16(t0, t1);
+}
+
+// One 4-point Hadamard pass over four vectors (low four lanes), packed back
+// as out01 = (o0, o1) and out23 = (o2, o3).
+TARGET_SSE2 static inline void hadamard4_sse2(__m128i v0, __m128i v1, __m128i v2, __m128i v3, __m128i* out01,
+                                              __m128i* out23) {
+	const __m128i a0 = _mm_add_epi16(v0, v3);
+	const __m128i a1 = _mm_add_epi16(v1, v2);
+	const __m128i a2 = _mm_sub_epi16(v1, v2);
+	const __m128i a3 = _mm_sub_epi16(v0, v3);
+	*out01 = _mm_unpacklo_epi64(_mm_add_epi16(a0, a1), _mm_add_epi16(a3, a2));
+	*out23 = _mm_unpacklo_epi64(_mm_sub_epi16(a0, a1), _mm_sub_epi16(a3, a2));
+}
+
+// Residuals are within +-255, so both passes stay within +-4080: 16-bit lanes
+// are exact.
+TARGET_SSE2 static uint32_t satd4x4_sse2(const uint8_t src[16], const uint8_t pred[16]) {
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i s = _mm_loadu_si128((const __m128i*)src);
+	const __m128i p = _mm_loadu_si128((const __m128i*)pred);
+	const __m128i r01 = _mm_sub_epi16(_mm_unpacklo_epi8(s, zero), _mm_unpacklo_epi8(p, zero));
+	const __m128i r23 = _mm_sub_epi16(_mm_unpackhi_epi8(s, zero), _mm_unpackhi_epi8(p, zero));
+
+	// Rows: transpose so that each vector holds one column, then combine them.
+	__m128i c01, c23, h01, h23;
+	transpose4x4_epi16_sse2(r01, r23, &c01, &c23);
+	hadamard4_sse2(c01, _mm_srli_si128(c01, 8), c23, _mm_srli_si128(c23, 8), &h01, &h23);
+	// h01/h23 hold output columns (0, 1) / (2, 3) with one lane per row.
+	__m128i y01, y23, v01, v23;
+	transpose4x4_epi16_sse2(h01, h23, &y01, &y23);
+	hadamard4_sse2(y01, _mm_srli_si128(y01, 8), y23, _mm_srli_si128(y23, 8), &v01, &v23);
+
+	const __m128i abs01 = _mm_max_epi16(v01, _mm_sub_epi16(zero, v01));
+	const __m128i abs23 = _mm_max_epi16(v23, _mm_sub_epi16(zero, v23));
+	const __m128i sum = _mm_madd_epi16(_mm_add_epi16(abs01, abs23), _mm_set1_epi16(1));
+	return (hsum_epi32_sse2(sum) + 1u) >> 1;
+}
+
+TARGET_SSE2 static uint32_t sse16x16_sse2(const uint8_t* src, size_t src_stride, const uint8_t pred[16 * 16]) {
+	const __m128i zero = _mm_setzero_si128();
+	__m128i acc = zero;
+	for (int y = 0; y < 16; y++) {
+		const __m128i s = _mm_loadu_si128((const __m128i*)(src + (size_t)y * src_stride));
+		const __m128i p = _mm_loadu_si128((const __m128i*)(pred + y * 16));
+		acc = _mm_add_epi32(acc, sq_diff_epi16_sse2(_mm_unpacklo_epi8(s, zero), _mm_unpacklo_epi8(p, zero)));
+		acc = _mm_add_epi32(acc, sq_diff_epi16_sse2(_mm_unpackhi_epi8(s, zero), _mm_unpackhi_epi8(p, zero)));
+	}
+	return hsum_epi32_sse2(acc);
+}
+
+TARGET_SSE2 static uint32_t sse8x8_sse2(const uint8_t* src, size_t src_stride, const uint8_t pred[8 * 8]) {
+	const __m128i zero = _mm_setzero_si128();
+	__m128i acc = zero;
+	for (int y = 0; y < 8; y++) {
+		const __m128i s = _mm_loadl_epi64((const __m128i*)(src + (size_t)y * src_stride));
+		const __m128i p = _mm_loadl_epi64((const __m128i*)(pred + y * 8));
+		acc = _mm_add_epi32(acc, sq_diff_epi16_sse2(_mm_unpacklo_epi8(s, zero), _mm_unpacklo_epi8(p, zero)));
+	}
+	return hsum_epi32_sse2(acc);
+}
+
+TARGET_SSE2 static uint32_t sad8x8_sse2(const uint8_t* src, size_t src_stride, const uint8_t pred[8 * 8]) {
+	__m128i acc = _mm_setzero_si128();
+	for (int y = 0; y < 8; y += 2) {
+		const __m128i s = _mm_unpacklo_epi64(_mm_loadl_epi64((const __m128i*)(src + (size_t)y * src_stride)),
+		                                     _mm_loadl_epi64((const __m128i*)(src + (size_t)(y + 1) * src_stride)));
+		acc = _mm_add_epi64(acc, _mm_sad_epu8(s, _mm_loadu_si128((const __m128i*)(pred + y * 8))));
+	}
+	return (uint32_t)_mm_cvtsi128_si32(_mm_add_epi64(acc, _mm_srli_si128(acc, 8)));
+}
+
+// --- enc-m05/m06: forward transforms and quantization ---
+
+TARGET_SSE2 static inline __m128i load4_sse2(const uint8_t* p) {
+	int32_t v;
+	memcpy(&v, p, sizeof(v));
+	return _mm_cvtsi32_si128(v);
+}
+
+// Row i of the residuals src[k] - ref[k] as 16-bit [block 0 | block 1].
+TARGET_SSE2 static inline __m128i residual_row2_sse2(const uint8_t* s0, const uint8_t* s1, const uint8_t* r0,
+                                                     const uint8_t* r1) {
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i s = _mm_unpacklo_epi32(load4_sse2(s0), load4_sse2(s1));
+	const __m128i r = _mm_unpacklo_epi32(load4_sse2(r0), load4_sse2(r1));
+	return _mm_sub_epi16(_mm_unpacklo_epi8(s, zero), _mm_unpacklo_epi8(r, zero));
+}
+
+// Transposes the two 4x4 int16 blocks held as v[row] = [block 0 | block 1].
+TARGET_SSE2 static inline void transpose2_4x4_epi16_sse2(__m128i v[4]) {
+	const __m128i t0 = _mm_unpacklo_epi16(v[0], v[1]);
+	const __m128i t1 = _mm_unpacklo_epi16(v[2], v[3]);
+	const __m128i t2 = _mm_unpackhi_epi16(v[0], v[1]);
+	const __m128i t3 = _mm_unpackhi_epi16(v[2], v[3]);
+	const __m128i u0 = _mm_unpacklo_epi32(t0, t1);
+	const __m128i u1 = _mm_unpackhi_epi32(t0, t1);
+	const __m128i u2 = _mm_unpacklo_epi32(t2, t3);
+	const __m128i u3 = _mm_unpackhi_epi32(t2, t3);
+	v[0] = _mm_unpacklo_epi64(u0, u2);
+	v[1] = _mm_unpackhi_epi64(u0, u2);
+	v[2] = _mm_unpacklo_epi64(u1, u3);
+	v[3] = _mm_unpackhi_epi64(u1, u3);
+}
+
+// (a * k0 + b * k1 + round) >> shift per lane, in 32 bits, packed back to 16.
+TARGET_SSE2 static inline __m128i mul_add_shift_sse2(__m128i a, __m128i b, __m128i k, __m128i round, int shift) {
+	const __m128i lo = _mm_srai_epi32(_mm_add_epi32(_mm_madd_epi16(_mm_unpacklo_epi16(a, b), k), round), shift);
+	const __m128i hi = _mm_srai_epi32(_mm_add_epi32(_mm_madd_epi16(_mm_unpackhi_epi16(a, b), k), round), shift);
+	return _mm_packs_epi32(lo, hi);
+}
+
+// libwebp's FTransform on two blocks: v[row] = [block 0 | block 1] residual
+// rows in, output rows out. Residuals are within +-255, so the first pass
+// stays within +-8160 and the sums of the second within +-32640: the 16-bit
+// lanes are exact, and the products go through madd.
+TARGET_SSE2 static inline void ftransform2_sse2(__m128i v[4]) {
+	const __m128i k_2217_5352 = _mm_setr_epi16(2217, 5352, 2217, 5352, 2217, 5352, 2217, 5352);
+	const __m128i k_m5352_2217 = _mm_setr_epi16(-5352, 2217, -5352, 2217, -5352, 2217, -5352, 2217);
+
+	// Rows: columns into lanes, one lane per row.
+	transpose2_4x4_epi16_sse2(v);
+	{
+		const __m128i a0 = _mm_add_epi16(v[0], v[3]);
+		const __m128i a1 = _mm_add_epi16(v[1], v[2]);
+		const __m128i a2 = _mm_sub_epi16(v[1], v[2]);
+		const __m128i a3 = _mm_sub_epi16(v[0], v[3]);
+		v[0] = _mm_slli_epi16(_mm_add_epi16(a0, a1), 3);
+		v[1] = mul_add_shift_sse2(a2, a3, k_2217_5352, _mm_set1_epi32(1812), 9);
+		v[2] = _mm_slli_epi16(_mm_sub_epi16(a0, a1), 3);
+		v[3] = mul_add_shift_sse2(a2, a3, k_m5352_2217, _mm_set1_epi32(937), 9);
+	}
+	// Columns: back to one vector per row, one lane per column.
+	transpose2_4x4_epi16_sse2(v);
+	{
+		const __m128i a0 = _mm_add_epi16(v[0], v[3]);
+		const __m128i a1 = _mm_add_epi16(v[1], v[2]);
+		const __m128i a2 = _mm_sub_epi16(v[1], v[2]);
+		const __m128i a3 = _mm_sub_epi16(v[0], v[3]);
+		const __m128i seven = _mm_set1_epi16(7);
+		const __m128i a3_zero = _mm_cmpeq_epi16(a3, _mm_setzero_si128());
+		const __m128i o1 = mul_add_shift_sse2(a2, a3, k_2217_5352, _mm_set1_epi32(12000), 16);
+		v[0] = _mm_srai_epi16(_mm_add_epi16(_mm_add_epi16(a0, a1), seven), 4);
+		v[1] = _mm_add_epi16(_mm_add_epi16(o1, _mm_set1_epi16(1)), a3_zero); // + (a3 != 0)
+		v[2] = _mm_srai_epi16(_mm_add_epi16(_mm_sub_epi16(a0, a1), seven), 4);
+		v[3] = mul_add_shift_sse2(a2, a3, k_m5352_2217, _mm_set1_epi32(51000), 16);
+	}
+}
+
+TARGET_SSE2 static void ftransform4x4x2_sse2(const uint8_t* const src[2], int src_stride, const uint8_t* const ref[2],
+                                             int ref_stride, int16_t out[2][16]) {
+	__m128i v[4];
+	for (int i = 0; i < 4; i++) {
+		const ptrdiff_t so = (ptrdiff_t)i * src_stride;
+		const ptrdiff_t ro = (ptrdiff_t)i * ref_stride;
+		v[i] = residual_row2_sse2(src[0] + so, src[1] + so, ref[0] + ro, ref[1] + ro);
+	}
+	ftransform2_sse2(v);
+	_mm_storeu_si128((__m128i*)&out[0][0], _mm_unpacklo_epi64(v[0], v[1]));
+	_mm_storeu_si128((__m128i*)&out[0][8], _mm_unpacklo_epi64(v[2], v[3]));
+	_mm_storeu_si128((__m128i*)&out[1][0], _mm_unpackhi_epi64(v[0], v[1]));
+	_mm_storeu_si128((__m128i*)&out[1][8], _mm_unpackhi_epi64(v[2], v[3]));
+}
+
+// A single block runs in the low half; the high half transforms zeros.
+TARGET_SSE2 static void ftransform4x4_sse2(const uint8_t* src, int src_stride, const uint8_t* ref, int ref_stride,
+                                           int16_t out[16]) {
+	__m128i v[4];
+	for (int i = 0; i < 4; i++) {
+		v[i] = residual_row2_sse2(src + (ptrdiff_t)i * src_stride, src, ref + (ptrdiff_t)i * ref_stride, src);
+	}
+	ftransform2_sse2(v);
+	_mm_storeu_si128((__m128i*)&out[0], _mm_unpacklo_epi64(v[0], v[1]));
+	_mm_storeu_si128((__m128i*)&out[8], _mm_unpacklo_epi64(v[2], v[3]));
+}
+
+// Transposes the 4x4 int32 matrix v[row].
+TARGET_SSE2 static inline void transpose4x4_epi32_sse2(__m128i v[4]) {
+	const __m128i t0 = _mm_unpacklo_epi32(v[0], v[1]);
+	const __m128i t1 = _mm_unpacklo_epi32(v[2], v[3]);
+	const __m128i t2 = _mm_unpackhi_epi32(v[0], v[1]);
+	const __m128i t3 = _mm_unpackhi_epi32(v[2], v[3]);
+	v[0] = _mm_unpacklo_epi64(t0, t1);
+	v[1] = _mm_unpackhi_epi64(t0, t1);
+	v[2] = _mm_unpacklo_epi64(t2, t3);
+	v[3] = _mm_unpackhi_epi64(t2, t3);
+}
+
+// Truncates int32 lanes to int16 like the scalar (int16_t) cast, then packs.
+TARGET_SSE2 static inline __m128i pack_wrap_epi32_sse2(__m128i lo, __m128i hi) {
+	lo = _mm_srai_epi32(_mm_slli_epi32(lo, 16), 16);
+	hi = _mm_srai_epi32(_mm_slli_epi32(hi, 16), 16);
+	return _mm_packs_epi32(lo, hi);
+}
+
+// 32-bit lanes, so any int16 input matches the scalar code.
+TARGET_SSE2 static void ftransform_wht_sse2(const int16_t* in, int16_t out[16]) {
+	__m128i v[4];
+	for (int j = 0; j < 4; j++) {
+		const int16_t* p = in + j * 16;
+		v[j] = _mm_setr_epi32(p[0], p[64], p[128], p[192]);
+	}
+	// v[j] holds input column j, one lane per row.
+	{
+		const __m128i a0 = _mm_add_epi32(v[0], v[2]);
+		const __m128i a1 = _mm_add_epi32(v[1], v[3]);
+		const __m128i a2 = _mm_sub_epi32(v[1], v[3]);
+		const __m128i a3 = _mm_sub_epi32(v[0], v[2]);
+		v[0] = _mm_add_epi32(a0, a1);
+		v[1] = _mm_add_epi32(a3, a2);
+		v[2] = _mm_sub_epi32(a3, a2);
+		v[3] = _mm_sub_epi32(a0, a1);
+	}
+	transpose4x4_epi32_sse2(v);
+	{
+		const __m128i a0 = _mm_add_epi32(v[0], v[2]);
+		const __m128i a1 = _mm_add_epi32(v[1], v[3]);
+		const __m128i a2 = _mm_sub_epi32(v[1], v[3]);
+		const __m128i a3 = _mm_sub_epi32(v[0], v[2]);
+		const __m128i o0 = _mm_srai_epi32(_mm_add_epi32(a0, a1), 1);
+		const __m128i o1 = _mm_srai_epi32(_mm_add_epi32(a3, a2), 1);
+		const __m128i o2 = _mm_srai_epi32(_mm_sub_epi32(a3, a2), 1);
+		const __m128i o3 = _mm_srai_epi32(_mm_sub_epi32(a0, a1), 1);
+		_mm_storeu_si128((__m128i*)&out[0], pack_wrap_epi32_sse2(o0, o1));
+		_mm_storeu_si128((__m128i*)&out[8], pack_wrap_epi32_sse2(o2, o3));
+	}
+}
+
+// (n * iq) >> 31 per uint32 lane (the products fit 47 bits).
+TARGET_SSE2 static inline __m128i mul_iq_shift31_sse2(__m128i n, __m128i iq) {
+	const __m128i even = _mm_srli_epi64(_mm_mul_epu32(n, iq), 31);
+	const __m128i odd = _mm_srli_epi64(_mm_mul_epu32(_mm_srli_epi64(n, 32), _mm_srli_epi64(iq, 32)), 31);
+	return _mm_or_si128(even, _mm_slli_epi64(odd, 32));
+}
+
+// Four coefficients: |c| and its sign as int32 lanes in, signed levels out.
+TARGET_SSE2 static inline __m128i quantize4_sse2(__m128i v, __m128i sign, const EncDspQuant* q, int i) {
+	const __m128i iq = _mm_loadu_si128((const __m128i*)&q->iq[i]);
+	const __m128i bias = _mm_loadu_si128((const __m128i*)&q->bias[i]);
+	const __m128i zthresh = _mm_loadu_si128((const __m128i*)&q->zthresh[i]);
+	__m128i level = mul_iq_shift31_sse2(_mm_add_epi32(v, bias), iq);
+	level = _mm_andnot_si128(_mm_cmpgt_epi32(zthresh, v), level);
+	return _mm_sub_epi32(_mm_xor_si128(level, sign), sign);
+}
+
+// Levels are within [-32768, 32767], so the saturating pack is exact.
+TARGET_SSE2 static void quantize4x4_sse2(int16_t coeffs[16], const EncDspQuant* q) {
+	const __m128i zero = _mm_setzero_si128();
+	for (int i = 0; i < 16; i += 8) {
+		const __m128i c = _mm_loadu_si128((const __m128i*)&coeffs[i]);
+		const __m128i sign = _mm_srai_epi16(c, 15);
+		// |c| as unsigned 16-bit (0x8000 for -32768), zero-extended below.
+		const __m128i v = _mm_sub_epi16(_mm_xor_si128(c, sign), sign);
+		const __m128i lo = quantize4_sse2(_mm_unpacklo_epi16(v, zero), _mm_unpacklo_epi16(sign, sign), q, i);
+		const __m128i hi = quantize4_sse2(_mm_unpackhi_epi16(v, zero), _mm_unpackhi_epi16(sign, sign), q, i + 4);
+		_mm_storeu_si128((__m128i*)&coeffs[i], _mm_packs_epi32(lo, hi));
+	}
+}
+
+// Eight coefficients per vector; same arithmetic as quantize4x4_sse2.
+TARGET_AVX2 static inline __m256i quantize8_avx2(__m128i c16, const EncDspQuant* q, int i) {
+	const __m256i c = _mm256_cvtepi16_epi32(c16);
+	const __m256i v = _mm256_abs_epi32(c);
+	const __m256i sign = _mm256_srai_epi32(c, 31);
+	const __m256i iq = _mm256_loadu_si256((const __m256i*)&q->iq[i]);
+	const __m256i n = _mm256_add_epi32(v, _mm256_loadu_si256((const __m256i*)&q->bias[i]));
+	const __m256i even = _mm256_srli_epi64(_mm256_mul_epu32(n, iq), 31);
+	const __m256i odd =
+		_mm256_srli_epi64(_mm256_mul_epu32(_mm256_srli_epi64(n, 32), _mm256_srli_epi64(iq, 32)), 31);
+	__m256i level = _mm256_or_si256(even, _mm256_slli_epi64(odd, 32));
+	level = _mm256_andnot_si256(_mm256_cmpgt_epi32(_mm256_loadu_si256((const __m256i*)&q->zthresh[i]), v), level);
+	return _mm256_sub_epi32(_mm256_xor_si256(level, sign), sign);
+}
+
+TARGET_AVX2 static void quantize4x4_avx2(int16_t coeffs[16], const EncDspQuant* q) {
+	const __m256i lo = quantize8_avx2(_mm_loadu_si128((const __m128i*)&coeffs[0]), q, 0);
+	const __m256i hi = quantize8_avx2(_mm_loadu_si128((const __m128i*)&coeffs[8]), q, 8);
+	// packs works per 128-bit lane: restore the coefficient order.
+	const __m256i packed = _mm256_permute4x64_epi64(_mm256_packs_epi32(lo, hi), _MM_SHUFFLE(3, 1, 2, 0));
+	_mm256_storeu_si256((__m256i*)coeffs, packed);
+}
+
+void enc_dsp_init_sse2(EncDsp* dsp) {
+	dsp->rgb_to_y_row = rgb_to_y_row_sse2;
+	dsp->sad4x4 = sad4x4_sse2;
+	dsp->sse4x4_recon = sse4x4_recon_sse2;
+	dsp->satd4x4 = satd4x4_sse2;
+	dsp->sse16x16 = sse16x16_sse2;
+	dsp->sad8x8 = sad8x8_sse2;
+	dsp->sse8x8 = sse8x8_sse2;
+	dsp->ftransform4x4 = ftransform4x4_sse2;
+	dsp->ftransform4x4x2 = ftransform4x4x2_sse2;
+	dsp->ftransform_wht = ftransform_wht_sse2;
+	dsp->quantize4x4 = quantize4x4_sse2;
+}
+
+void enc_dsp_init_ssse3(EncDsp* dsp) {
+	dsp->rgb_to_y_row = rgb_to_y_row_ssse3;
+}
+
+void enc_dsp_init_avx2(EncDsp* dsp) {
+	dsp->rgb_to_y_row = rgb_to_y_row_avx2;
+	dsp->rgb_to_uv_row = rgb_to_uv_row_avx2;
+	dsp->quantize4x4 = quantize4x4_avx2;
+}
+
+#else
+
+// Non-x86 and ultra builds: scalar kernels only (enc_dsp.c never calls the setters).
+typedef int enc_dsp_x86_unused;
+
+#endif
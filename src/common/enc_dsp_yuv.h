@@ -0,0 +1,65 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Scalar RGB->YUV building blocks shared by the reference kernels
+// (enc_dsp_scalar.c) and the SIMD variants (enc_dsp_x86.c), which use them for
+// the tails their vector loops do not cover. Constants follow libwebp's
+// VP8RGBToY/U/V.
+
+enum {
+	ENC_YUV_FIX = 16,
+	ENC_YUV_HALF = 1 << (ENC_YUV_FIX - 1),
+	// A 2x2 quad's linear-light sum: four enc_gamma_to_linear_tab[] values (<= 4095).
+	ENC_GAMMA_SUM_MAX = 4 * 4095,
+};
+
+// enc_gamma_to_linear_tab widened to 32 bits (AVX2 gathers 32-bit elements).
+extern uint32_t enc_dsp_gamma_to_linear32[256];
+
+// linear_to_gamma() of every possible quad sum, precomputed by
+// enc_dsp_init_scalar(). One spare entry lets a 32-bit gather read the last one.
+extern uint16_t enc_dsp_sum_to_gamma[ENC_GAMMA_SUM_MAX + 2];
+
+static inline int enc_clip_u8(int v) {
+	return (v < 0) ? 0 : (v > 255) ? 255 : v;
+}
+
+static inline uint8_t enc_rgb_to_y(int r, int g, int b) {
+	const int luma = 16839 * r + 33059 * g + 6420 * b;
+	return (uint8_t)((luma + ENC_YUV_HALF + (16 << ENC_YUV_FIX)) >> ENC_YUV_FIX);
+}
+
+// r/g/b are gamma-space sums of a 2x2 quad (4x the range of one pixel).
+static inline uint8_t enc_rgb_to_u(int r, int g, int b) {
+	const int u = -9719 * r - 19081 * g + 28800 * b;
+	return (uint8_t)enc_clip_u8((u + (ENC_YUV_HALF << 2) + (128 << (ENC_YUV_FIX + 2))) >> (ENC_YUV_FIX + 2));
+}
+
+static inline uint8_t enc_rgb_to_v(int r, int g, int b) {
+	const int v = 28800 * r - 24116 * g - 4684 * b;
+	return (uint8_t)enc_clip_u8((v + (ENC_YUV_HALF << 2) + (128 << (ENC_YUV_FIX + 2))) >> (ENC_YUV_FIX + 2));
+}
+
+// U/V of chroma columns [ux, uv_width) of a row pair.
+static inline void enc_rgb_to_uv_tail(const uint8_t* row0, const uint8_t* row1, uint8_t* u, uint8_t* v,
+                                      uint32_t width, uint32_t step, uint32_t ux) {
+	const uint32_t uv_width = (width + 1u) >> 1;
+	for (; ux < uv_width; ux++) {
+		const uint32_t x0 = 2u * ux;
+		const uint32_t x1 = (x0 + 1u < width) ? (x0 + 1u) : x0;
+		const uint8_t* p00 = row0 + (size_t)x0 * step;
+		const uint8_t* p01 = row0 + (size_t)x1 * step;
+		const uint8_t* p10 = row1 + (size_t)x0 * step;
+		const uint8_t* p11 = row1 + (size_t)x1 * step;
+		int sum[3];
+		for (int c = 0; c < 3; c++) {
+			const uint32_t lin = enc_dsp_gamma_to_linear32[p00[c]] + enc_dsp_gamma_to_linear32[p01[c]] +
+			                     enc_dsp_gamma_to_linear32[p10[c]] + enc_dsp_gamma_to_linear32[p11[c]];
+			sum[c] = enc_dsp_sum_to_gamma[lin];
+		}
+		u[ux] = enc_rgb_to_u(sum[0], sum[1], sum[2]);
+		v[ux] = enc_rgb_to_v(sum[0], sum[1], sum[2]);
+	}
+}
@@ -2,6 +2,23 @@
 
 #include "os.h"
 
+// stdout is buffered (the -info/-probe/-dump_mb dumps are many tiny writes);
+// everything else goes straight to the fd after draining stdout, so output
+// interleaves the same way as before.
+static uint8_t g_stdout_buf[4096];
+static OsWriter g_stdout = {.fd = 1, .buf = g_stdout_buf, .cap = sizeof(g_stdout_buf)};
+
+static void fmt_out(int fd, const void* p, size_t n) {
+	if (fd == 1) {
+		(void)os_writer_write(&g_stdout, p, n);
+		return;
+	}
+	fmt_flush();
+	os_write_all(fd, p, n);
+}
+
+int fmt_flush(void) { return os_writer_flush(&g_stdout); }
+
 static size_t cstr_len(const char* s) {
 	size_t n = 0;
 	while (s && s[n]) n++;
@@ -10,27 +27,30 @@ static size_t cstr_len(const char* s) {
 
 void fmt_write_str(int fd, const char* s) {
 	if (!s) return;
-	os_write_all(fd, s, cstr_len(s));
+	fmt_out(fd, s, cstr_len(s));
 }
 
-static void write_uint_dec(int fd, uint64_t v) {
-	char buf[32];
+size_t fmt_format_u64(char out[FMT_U64_MAX], uint64_t v) {
 	size_t i = 0;
 	if (v == 0) {
-		buf[i++] = '0';
-		os_write_all(fd, buf, i);
-		return;
+		out[i++] = '0';
+		return i;
 	}
-	while (v > 0 && i < sizeof(buf)) {
-		buf[i++] = (char)('0' + (v % 10));
+	while (v > 0 && i < FMT_U64_MAX) {
+		out[i++] = (char)('0' + (v % 10));
 		v /= 10;
 	}
 	for (size_t j = 0; j < i / 2; j++) {
-		char tmp = buf[j];
-		buf[j] = buf[i - 1 - j];
-		buf[i - 1 - j] = tmp;
+		char tmp = out[j];
+		out[j] = out[i - 1 - j];
+		out[i - 1 - j] = tmp;
 	}
-	os_write_all(fd, buf, i);
+	return i;
+}
+
+static void write_uint_dec(int fd, uint64_t v) {
+	char buf[FMT_U64_MAX];
+	fmt_out(fd, buf, fmt_format_u64(buf, v));
 }
 
 void fmt_write_u32(int fd, uint32_t v) { write_uint_dec(fd, v); }
@@ -39,7 +59,7 @@ void fmt_write_size(int fd, size_t v) { write_uint_dec(fd, (uint64_t)v); }
 
 void fmt_write_i32(int fd, int32_t v) {
 	if (v < 0) {
-		os_write_all(fd, "-", 1);
+		fmt_out(fd, "-", 1);
 		// Cast via int64_t to avoid UB on INT32_MIN.
 		uint64_t mag = (uint64_t)(-(int64_t)v);
 		write_uint_dec(fd, mag);
@@ -54,7 +74,7 @@ void fmt_write_fourcc(int fd, uint32_t fourcc_le) {
 	s[1] = (char)((fourcc_le >> 8) & 0xFFu);
 	s[2] = (char)((fourcc_le >> 16) & 0xFFu);
 	s[3] = (char)((fourcc_le >> 24) & 0xFFu);
-	os_write_all(fd, s, sizeof(s));
+	fmt_out(fd, s, sizeof(s));
 }
 
-void fmt_write_nl(int fd) { os_write_all(fd, "\n", 1); }
+void fmt_write_nl(int fd) { fmt_out(fd, "\n", 1); }
@@ -4,6 +4,17 @@
 #include <stdint.h>
 
 // Minimal formatting helpers that avoid stdio.
+//
+// Writes to fd 1 are buffered; call fmt_flush() before exiting. Writes to any
+// other fd flush fd 1 first.
+
+enum { FMT_U64_MAX = 20 };
+
+// Formats v in decimal into out (not NUL-terminated). Returns the length.
+size_t fmt_format_u64(char out[FMT_U64_MAX], uint64_t v);
+
+// Flushes buffered fd 1 output. Returns 0 on success.
+int fmt_flush(void);
 
 void fmt_write_str(int fd, const char* s);
 void fmt_write_u32(int fd, uint32_t v);
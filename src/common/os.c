@@ -1,49 +1,168 @@
+// MAP_POPULATE and madvise() are not C11/POSIX.
+#ifndef _DEFAULT_SOURCE
+#define _DEFAULT_SOURCE
+#endif
+
 #include "os.h"
 
 #include <errno.h>
+#include <stdlib.h>
+#include <string.h>
 #include <sys/mman.h>
 #include <sys/stat.h>
 #include <fcntl.h>
 #include <unistd.h>
 
-int os_map_file_readonly(const char* path, ByteSpan* out_span) {
-	if (!out_span) return -1;
-	out_span->data = NULL;
-	out_span->size = 0;
+// Small-file buffer of os_map_file_readonly_ex().
+static uint8_t g_small_file[OS_MAP_READ_MAX];
+static uint8_t g_small_file_busy;
 
-	int fd = open(path, O_RDONLY);
-	if (fd < 0) return -1;
+static int read_small_file(int fd, size_t size, ByteSpan* out_span) {
+	size_t off = 0;
+	while (off < size) {
+		ssize_t n = pread(fd, g_small_file + off, size - off, (off_t)off);
+		if (n < 0) {
+			if (errno == EINTR) continue;
+			return -1;
+		}
+		if (n == 0) {
+			errno = EINVAL;
+			return -1;
+		}
+		off += (size_t)n;
+	}
+	g_small_file_busy = 1;
+	out_span->data = g_small_file;
+	out_span->size = size;
+	return 0;
+}
 
-	struct stat st;
-	if (fstat(fd, &st) != 0) {
-		close(fd);
+// Heap buffer of a stream read by read_stream().
+static uint8_t* g_stream_buf;
+
+// Reads a pipe (or another non-regular file) to EOF: into the small-file buffer
+// while it fits, then into a heap buffer that doubles as it fills. One stream
+// at a time.
+static int read_stream(int fd, ByteSpan* out_span) {
+	if (g_stream_buf) {
+		errno = EBUSY;
 		return -1;
 	}
-	if (st.st_size < 0) {
-		close(fd);
-		errno = EINVAL;
-		return -1;
+	uint8_t* buf = g_small_file_busy ? NULL : g_small_file;
+	size_t cap = buf ? sizeof(g_small_file) : 0;
+	size_t len = 0;
+	for (;;) {
+		if (len == cap) {
+			const size_t ncap = cap ? cap * 2u : OS_MAP_READ_MAX;
+			if (ncap < cap) {
+				errno = ENOMEM;
+				return -1;
+			}
+			uint8_t* nbuf = (uint8_t*)realloc(buf == g_small_file ? NULL : buf, ncap);
+			if (!nbuf) {
+				if (buf != g_small_file) free(buf);
+				errno = ENOMEM;
+				return -1;
+			}
+			if (buf == g_small_file) memcpy(nbuf, g_small_file, len);
+			buf = nbuf;
+			cap = ncap;
+		}
+		ssize_t n = read(fd, buf + len, cap - len);
+		if (n < 0) {
+			if (errno == EINTR) continue;
+			if (buf != g_small_file) free(buf);
+			return -1;
+		}
+		if (n == 0) break;
+		len += (size_t)n;
 	}
-	if (st.st_size == 0) {
-		close(fd);
+	if (len == 0) {
+		if (buf != g_small_file) free(buf);
 		errno = EINVAL;
 		return -1;
 	}
+	if (buf == g_small_file) {
+		g_small_file_busy = 1;
+	} else {
+		g_stream_buf = buf;
+	}
+	out_span->data = buf;
+	out_span->size = len;
+	return 0;
+}
 
-	size_t size = (size_t)st.st_size;
-	void* p = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
-	int saved_errno = errno;
-	close(fd);
-	errno = saved_errno;
+static int map_file(int fd, size_t size, uint32_t flags, ByteSpan* out_span) {
+	int map_flags = MAP_PRIVATE;
+#ifdef MAP_POPULATE
+	if (flags & OS_MAP_POPULATE) map_flags |= MAP_POPULATE;
+#endif
+	void* p = mmap(NULL, size, PROT_READ, map_flags, fd, 0);
 	if (p == MAP_FAILED) return -1;
-
+#if defined(MADV_SEQUENTIAL) && defined(MADV_WILLNEED)
+	// Hints only: the bool decoder streams through the file once.
+	if (flags & OS_MAP_ADVISE) {
+		(void)madvise(p, size, MADV_SEQUENTIAL);
+		(void)madvise(p, size, MADV_WILLNEED);
+	}
+#endif
 	out_span->data = (const uint8_t*)p;
 	out_span->size = size;
 	return 0;
 }
 
+int os_map_file_readonly(const char* path, ByteSpan* out_span) {
+	const OsMapOptions opts = {OS_MAP_POPULATE, OS_MAP_READ_MAX};
+	return os_map_file_readonly_ex(path, &opts, out_span);
+}
+
+int os_map_file_readonly_ex(const char* path, const OsMapOptions* opts, ByteSpan* out_span) {
+	if (!out_span || !opts) {
+		errno = EINVAL;
+		return -1;
+	}
+	out_span->data = NULL;
+	out_span->size = 0;
+
+	const int use_stdin = os_path_is_stdio(path);
+	int fd = use_stdin ? 0 : open(path, O_RDONLY);
+	if (fd < 0) return -1;
+
+	struct stat st;
+	int rc = fstat(fd, &st);
+	if (rc == 0 && !S_ISREG(st.st_mode)) {
+		rc = read_stream(fd, out_span);
+	} else if (rc == 0 && st.st_size <= 0) {
+		errno = EINVAL;
+		rc = -1;
+	} else if (rc == 0) {
+		const size_t size = (size_t)st.st_size;
+		const uint32_t read_below = (opts->read_below < OS_MAP_READ_MAX) ? opts->read_below : OS_MAP_READ_MAX;
+		if (size < read_below && !g_small_file_busy) {
+			rc = read_small_file(fd, size, out_span);
+		} else {
+			rc = map_file(fd, size, opts->flags, out_span);
+		}
+	}
+	if (!use_stdin) {
+		int saved_errno = errno;
+		close(fd);
+		errno = saved_errno;
+	}
+	return rc;
+}
+
 void os_unmap_file(ByteSpan span) {
 	if (!span.data || span.size == 0) return;
+	if (span.data == g_small_file) {
+		g_small_file_busy = 0;
+		return;
+	}
+	if (span.data == g_stream_buf) {
+		free(g_stream_buf);
+		g_stream_buf = NULL;
+		return;
+	}
 	munmap((void*)span.data, span.size);
 }
 
@@ -8,9 +8,94 @@ typedef struct {
 	size_t size;
 } ByteSpan;
 
-// Maps a file read-only. Returns 0 on success.
+// os_map_file_readonly_ex() flags.
+enum {
+	OS_MAP_POPULATE = 1u << 0, // MAP_POPULATE: fault the whole file in at mmap time
+	OS_MAP_ADVISE = 1u << 1,   // madvise(MADV_SEQUENTIAL) and madvise(MADV_WILLNEED)
+};
+
+enum {
+	OS_MAP_READ_MAX = 64 << 10, // size of the small-file buffer
+};
+
+typedef struct {
+	uint32_t flags;      // OS_MAP_*
+	uint32_t read_below; // files smaller than this are read instead of mapped (capped at OS_MAP_READ_MAX; 0 = always map)
+} OsMapOptions;
+
+// "-" names stdin (input) or stdout (output) on the command line.
+static inline int os_path_is_stdio(const char* path) { return path && path[0] == '-' && path[1] == '\0'; }
+
+// Maps a file read-only with {OS_MAP_POPULATE, OS_MAP_READ_MAX}. Returns 0 on success.
 int os_map_file_readonly(const char* path, ByteSpan* out_span);
+
+// Maps a file read-only. A file below opts->read_below bytes is pread() into a
+// static buffer instead, which is cheaper than setting up and tearing down a
+// mapping for a thumbnail. The buffer holds one file at a time (while it is in
+// use, other small files are mapped) and is not thread-safe.
+// Path "-" is stdin. Stdin redirected from a regular file is mapped like any
+// other file; a pipe (or any non-regular file) is read to EOF into the small
+// buffer or, past OS_MAP_READ_MAX, a growing heap buffer (one stream at a time).
+// Release every kind with os_unmap_file(). Returns 0 on success.
+int os_map_file_readonly_ex(const char* path, const OsMapOptions* opts, ByteSpan* out_span);
 void os_unmap_file(ByteSpan span);
 
 // Writes all bytes to fd. Returns 0 on success.
 int os_write_all(int fd, const void* buf, size_t len);
+
+// --- Buffered output (os_writer.c) ---
+//
+// Small writes are coalesced into one buffer; writes that do not fit are sent
+// together with the pending bytes in a single writev(). Optionally, output to a
+// regular file goes through ftruncate + a shared mapping instead (see
+// os_writer_reserve()). Errors are sticky: once a write fails, every later call
+// fails too, so callers may check only the result of os_writer_close().
+
+enum {
+	OS_WRITER_MIN_BUF = 256 << 10,
+	OS_WRITER_DEFAULT_BUF = 1 << 20,
+	OS_WRITER_MAX_BUF = 4 << 20,
+};
+
+// os_writer_init() flags.
+enum {
+	OS_WRITER_MMAP = 1u << 0, // allow ftruncate + mmap for regular files (fd must be O_RDWR)
+};
+
+typedef struct {
+	int fd;
+	uint32_t flags;
+	uint8_t* buf; // pending bytes (allocated on first buffered write unless caller-provided)
+	size_t cap;
+	size_t len;
+	uint8_t owns_buf;
+	uint8_t failed;
+	uint8_t* map; // non-NULL while writing into a mapped regular file
+	size_t map_size;
+	uint64_t pos; // total bytes accepted so far
+} OsWriter;
+
+// Initializes a heap-buffered writer. buf_size==0 selects OS_WRITER_DEFAULT_BUF;
+// other values are clamped to [OS_WRITER_MIN_BUF, OS_WRITER_MAX_BUF].
+void os_writer_init(OsWriter* w, int fd, size_t buf_size, uint32_t flags);
+
+// Initializes a writer over caller-owned storage (no allocation, never mapped).
+void os_writer_init_static(OsWriter* w, int fd, uint8_t* buf, size_t cap);
+
+// Announces the exact total output size before the first write. With
+// OS_WRITER_MMAP and a regular, empty output file, this switches the writer to
+// ftruncate + mmap. Otherwise it is a no-op. Returns 0 unless the writer already failed.
+int os_writer_reserve(OsWriter* w, uint64_t total_size);
+
+// Appends bytes. Returns 0 on success.
+int os_writer_write(OsWriter* w, const void* data, size_t len);
+
+// Appends several segments; pending bytes and all segments go out in one writev()
+// where possible. Segments are not copied. Returns 0 on success.
+int os_writer_write_segments(OsWriter* w, const ByteSpan* segs, uint32_t count);
+
+// Writes out pending bytes. Returns 0 on success.
+int os_writer_flush(OsWriter* w);
+
+// Flushes, unmaps/frees internal storage. Does not close the fd. Returns 0 on success.
+int os_writer_close(OsWriter* w);
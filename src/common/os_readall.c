@@ -11,49 +11,65 @@ int os_map_file_readonly(const char* path, ByteSpan* out_span) {
 	out_span->data = NULL;
 	out_span->size = 0;
 
-	int fd = open(path, O_RDONLY);
+	const int use_stdin = os_path_is_stdio(path);
+	int fd = use_stdin ? 0 : open(path, O_RDONLY);
 	if (fd < 0) return -1;
 
 	struct stat st;
 	if (fstat(fd, &st) != 0) {
-		close(fd);
+		if (!use_stdin) close(fd);
 		return -1;
 	}
-	if (st.st_size <= 0) {
-		close(fd);
+	// A pipe has no size: read it to EOF, doubling the buffer as it fills.
+	const int stream = !S_ISREG(st.st_mode);
+	if (!stream && st.st_size <= 0) {
+		if (!use_stdin) close(fd);
 		errno = EINVAL;
 		return -1;
 	}
 
-	size_t size = (size_t)st.st_size;
+	size_t size = stream ? (size_t)OS_MAP_READ_MAX : (size_t)st.st_size;
 	uint8_t* buf = (uint8_t*)malloc(size);
 	if (!buf) {
-		close(fd);
+		if (!use_stdin) close(fd);
 		errno = ENOMEM;
 		return -1;
 	}
 
 	size_t off = 0;
-	while (off < size) {
+	for (;;) {
+		if (off == size) {
+			if (!stream) break;
+			uint8_t* nbuf = (uint8_t*)realloc(buf, size * 2u);
+			if (!nbuf) {
+				free(buf);
+				if (!use_stdin) close(fd);
+				errno = ENOMEM;
+				return -1;
+			}
+			buf = nbuf;
+			size *= 2u;
+		}
 		ssize_t n = read(fd, buf + off, size - off);
 		if (n < 0) {
 			if (errno == EINTR) continue;
 			free(buf);
-			close(fd);
+			if (!use_stdin) close(fd);
 			return -1;
 		}
 		if (n == 0) {
+			if (stream && off > 0) break;
 			free(buf);
-			close(fd);
+			if (!use_stdin) close(fd);
 			errno = EINVAL;
 			return -1;
 		}
 		off += (size_t)n;
 	}
 
-	close(fd);
+	if (!use_stdin) close(fd);
 	out_span->data = buf;
-	out_span->size = size;
+	out_span->size = off;
 	return 0;
 }
 
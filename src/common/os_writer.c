@@ -0,0 +1,211 @@
+// ftruncate() is POSIX, not C11.
+#define _POSIX_C_SOURCE 200809L
+
+#include "os.h"
+#include "timing.h"
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+enum { OS_WRITER_MAX_IOV = 8 };
+
+static int writev_all(int fd, struct iovec* iov, int count) {
+	while (count > 0) {
+		ssize_t n = writev(fd, iov, count);
+		if (n < 0) {
+			if (errno == EINTR) continue;
+			return -1;
+		}
+		if (n == 0) return -1;
+		size_t done = (size_t)n;
+		while (count > 0 && done >= iov->iov_len) {
+			done -= iov->iov_len;
+			iov++;
+			count--;
+		}
+		if (count > 0) {
+			iov->iov_base = (uint8_t*)iov->iov_base + done;
+			iov->iov_len -= done;
+		}
+	}
+	return 0;
+}
+
+static int writer_fail(OsWriter* w) {
+	w->failed = 1;
+	return -1;
+}
+
+void os_writer_init(OsWriter* w, int fd, size_t buf_size, uint32_t flags) {
+	if (!w) return;
+	memset(w, 0, sizeof(*w));
+	if (buf_size == 0) buf_size = OS_WRITER_DEFAULT_BUF;
+	if (buf_size < OS_WRITER_MIN_BUF) buf_size = OS_WRITER_MIN_BUF;
+	if (buf_size > OS_WRITER_MAX_BUF) buf_size = OS_WRITER_MAX_BUF;
+	w->fd = fd;
+	w->flags = flags;
+	w->cap = buf_size;
+	w->owns_buf = 1;
+}
+
+void os_writer_init_static(OsWriter* w, int fd, uint8_t* buf, size_t cap) {
+	if (!w) return;
+	memset(w, 0, sizeof(*w));
+	w->fd = fd;
+	w->buf = buf;
+	w->cap = cap;
+}
+
+static int writer_reserve(OsWriter* w, uint64_t total_size) {
+	if (!w) return -1;
+	if (w->failed) return -1;
+	if (!(w->flags & OS_WRITER_MMAP)) return 0;
+	if (w->map || w->pos != 0 || total_size == 0 || total_size > (uint64_t)SIZE_MAX) return 0;
+
+	// Only map fresh regular files; pipes/terminals/appends stay on the write path.
+	struct stat st;
+	if (fstat(w->fd, &st) != 0 || !S_ISREG(st.st_mode) || st.st_size != 0) return 0;
+	if (ftruncate(w->fd, (off_t)total_size) != 0) return 0;
+
+	void* p = mmap(NULL, (size_t)total_size, PROT_READ | PROT_WRITE, MAP_SHARED, w->fd, 0);
+	if (p == MAP_FAILED) {
+		(void)ftruncate(w->fd, 0);
+		return 0;
+	}
+	w->map = (uint8_t*)p;
+	w->map_size = (size_t)total_size;
+	return 0;
+}
+
+static int writer_flush(OsWriter* w) {
+	if (!w) return -1;
+	if (w->failed) return -1;
+	if (w->len == 0) return 0;
+	if (os_write_all(w->fd, w->buf, w->len) != 0) return writer_fail(w);
+	w->len = 0;
+	return 0;
+}
+
+static int writer_write_segments(OsWriter* w, const ByteSpan* segs, uint32_t count) {
+	if (!w || (count && !segs)) return -1;
+	if (w->failed) return -1;
+
+	if (w->map) {
+		for (uint32_t i = 0; i < count; i++) {
+			if (segs[i].size > w->map_size - (size_t)w->pos) {
+				errno = EFBIG;
+				return writer_fail(w);
+			}
+			memcpy(w->map + w->pos, segs[i].data, segs[i].size);
+			w->pos += segs[i].size;
+		}
+		return 0;
+	}
+
+	while (count > 0) {
+		struct iovec iov[OS_WRITER_MAX_IOV];
+		int n = 0;
+		if (w->len) {
+			iov[n].iov_base = w->buf;
+			iov[n].iov_len = w->len;
+			n++;
+		}
+		while (count > 0 && n < OS_WRITER_MAX_IOV) {
+			if (segs->size) {
+				iov[n].iov_base = (void*)segs->data;
+				iov[n].iov_len = segs->size;
+				n++;
+				w->pos += segs->size;
+			}
+			segs++;
+			count--;
+		}
+		if (n && writev_all(w->fd, iov, n) != 0) return writer_fail(w);
+		w->len = 0;
+	}
+	return 0;
+}
+
+static int writer_write(OsWriter* w, const void* data, size_t len) {
+	if (!w || (len && !data)) return -1;
+	if (w->failed) return -1;
+	if (len == 0) return 0;
+
+	if (w->map || len >= w->cap / 2) {
+		// Large write: send it straight from the caller's memory (after any pending bytes).
+		ByteSpan seg = {(const uint8_t*)data, len};
+		return writer_write_segments(w, &seg, 1);
+	}
+
+	if (!w->buf) {
+		w->buf = (uint8_t*)malloc(w->cap);
+		if (!w->buf) return writer_fail(w);
+	}
+	if (len > w->cap - w->len) {
+		if (writer_flush(w) != 0) return -1;
+	}
+	memcpy(w->buf + w->len, data, len);
+	w->len += len;
+	w->pos += len;
+	return 0;
+}
+
+static int writer_close(OsWriter* w) {
+	if (!w) return -1;
+	int rc = writer_flush(w);
+	if (w->map) {
+		if (munmap(w->map, w->map_size) != 0) rc = -1;
+		// Short output (e.g. an error mid-way): drop the unwritten tail.
+		if ((size_t)w->pos != w->map_size && ftruncate(w->fd, (off_t)w->pos) != 0) rc = -1;
+		w->map = NULL;
+		w->map_size = 0;
+	}
+	if (w->owns_buf) free(w->buf);
+	w->buf = NULL;
+	w->cap = 0;
+	w->len = 0;
+	if (w->failed) rc = -1;
+	return rc;
+}
+
+// Public entry points: everything the writer does is charged to the write stage.
+
+int os_writer_reserve(OsWriter* w, uint64_t total_size) {
+	const DecStage prev = dec_timing_switch(DEC_STAGE_WRITE);
+	const int rc = writer_reserve(w, total_size);
+	(void)dec_timing_switch(prev);
+	return rc;
+}
+
+int os_writer_flush(OsWriter* w) {
+	const DecStage prev = dec_timing_switch(DEC_STAGE_WRITE);
+	const int rc = writer_flush(w);
+	(void)dec_timing_switch(prev);
+	return rc;
+}
+
+int os_writer_write_segments(OsWriter* w, const ByteSpan* segs, uint32_t count) {
+	const DecStage prev = dec_timing_switch(DEC_STAGE_WRITE);
+	const int rc = writer_write_segments(w, segs, count);
+	(void)dec_timing_switch(prev);
+	return rc;
+}
+
+int os_writer_write(OsWriter* w, const void* data, size_t len) {
+	const DecStage prev = dec_timing_switch(DEC_STAGE_WRITE);
+	const int rc = writer_write(w, data, len);
+	(void)dec_timing_switch(prev);
+	return rc;
+}
+
+int os_writer_close(OsWriter* w) {
+	const DecStage prev = dec_timing_switch(DEC_STAGE_WRITE);
+	const int rc = writer_close(w);
+	(void)dec_timing_switch(prev);
+	return rc;
+}
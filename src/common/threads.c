@@ -0,0 +1,81 @@
+// sysconf(_SC_NPROCESSORS_ONLN) is POSIX, not C11.
+#define _POSIX_C_SOURCE 200809L
+
+#include "threads.h"
+
+#include <errno.h>
+#include <unistd.h>
+
+#if OS_HAVE_THREADS
+
+uint32_t os_cpu_count(void) {
+	const long n = sysconf(_SC_NPROCESSORS_ONLN);
+	return (n > 0) ? (uint32_t)n : 1u;
+}
+
+int os_thread_start(OsThread* t, void* (*fn)(void*), void* arg) {
+	const int rc = pthread_create(&t->handle, NULL, fn, arg);
+	if (rc != 0) {
+		errno = rc;
+		return -1;
+	}
+	return 0;
+}
+
+int os_thread_join(OsThread* t) {
+	const int rc = pthread_join(t->handle, NULL);
+	if (rc != 0) {
+		errno = rc;
+		return -1;
+	}
+	return 0;
+}
+
+int os_mutex_init(OsMutex* m) { return pthread_mutex_init(&m->m, NULL) == 0 ? 0 : -1; }
+void os_mutex_destroy(OsMutex* m) { (void)pthread_mutex_destroy(&m->m); }
+void os_mutex_lock(OsMutex* m) { (void)pthread_mutex_lock(&m->m); }
+void os_mutex_unlock(OsMutex* m) { (void)pthread_mutex_unlock(&m->m); }
+
+int os_cond_init(OsCond* c) { return pthread_cond_init(&c->c, NULL) == 0 ? 0 : -1; }
+void os_cond_destroy(OsCond* c) { (void)pthread_cond_destroy(&c->c); }
+void os_cond_wait(OsCond* c, OsMutex* m) { (void)pthread_cond_wait(&c->c, &m->m); }
+void os_cond_broadcast(OsCond* c) { (void)pthread_cond_broadcast(&c->c); }
+
+#else
+
+uint32_t os_cpu_count(void) { return 1u; }
+
+int os_thread_start(OsThread* t, void* (*fn)(void*), void* arg) {
+	(void)t;
+	(void)fn;
+	(void)arg;
+	errno = ENOSYS;
+	return -1;
+}
+
+int os_thread_join(OsThread* t) {
+	(void)t;
+	errno = ENOSYS;
+	return -1;
+}
+
+int os_mutex_init(OsMutex* m) {
+	(void)m;
+	return 0;
+}
+void os_mutex_destroy(OsMutex* m) { (void)m; }
+void os_mutex_lock(OsMutex* m) { (void)m; }
+void os_mutex_unlock(OsMutex* m) { (void)m; }
+
+int os_cond_init(OsCond* c) {
+	(void)c;
+	return 0;
+}
+void os_cond_destroy(OsCond* c) { (void)c; }
+void os_cond_wait(OsCond* c, OsMutex* m) {
+	(void)c;
+	(void)m;
+}
+void os_cond_broadcast(OsCond* c) { (void)c; }
+
+#endif
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <stdint.h>
+
+// Minimal threading layer (pthreads). The nolibc builds have no threads:
+// os_thread_start() fails there with ENOSYS and callers run the work inline,
+// and the mutex/condition calls are no-ops.
+
+#if defined(NO_LIBC)
+#define OS_HAVE_THREADS 0
+#else
+#define OS_HAVE_THREADS 1
+#endif
+
+#if OS_HAVE_THREADS
+#include <pthread.h>
+
+typedef struct {
+	pthread_t handle;
+} OsThread;
+
+typedef struct {
+	pthread_mutex_t m;
+} OsMutex;
+
+typedef struct {
+	pthread_cond_t c;
+} OsCond;
+#else
+typedef struct {
+	int unused;
+} OsThread;
+
+typedef struct {
+	int unused;
+} OsMutex;
+
+typedef struct {
+	int unused;
+} OsCond;
+#endif
+
+// Online CPU count (at least 1).
+uint32_t os_cpu_count(void);
+
+// Starts fn(arg) on a new thread. Returns 0 on success, -1 with errno set.
+int os_thread_start(OsThread* t, void* (*fn)(void*), void* arg);
+int os_thread_join(OsThread* t);
+
+int os_mutex_init(OsMutex* m);
+void os_mutex_destroy(OsMutex* m);
+void os_mutex_lock(OsMutex* m);
+void os_mutex_unlock(OsMutex* m);
+
+int os_cond_init(OsCond* c);
+void os_cond_destroy(OsCond* c);
+void os_cond_wait(OsCond* c, OsMutex* m);
+void os_cond_broadcast(OsCond* c);
@@ -0,0 +1,145 @@
+// clock_gettime() is POSIX, not C11.
+#define _POSIX_C_SOURCE 200809L
+
+#include "timing.h"
+
+#include "os.h"
+
+#include <string.h>
+#include <time.h>
+
+uint64_t dec_timing_now_ns(void) {
+	struct timespec ts;
+	if (clock_gettime(CLOCK_MONOTONIC, &ts) != 0) return 0;
+	return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+#if DECODER_TIMINGS
+DecTimings* g_dec_timings;
+
+DecStage dec_timing_switch_active(DecStage stage) {
+	DecTimings* t = g_dec_timings;
+	const DecStage prev = t->current;
+	if (stage == prev) return prev;
+	const uint64_t now = dec_timing_now_ns();
+	if (prev != DEC_STAGE_NONE) t->ns[prev] += now - t->last_ns;
+	t->last_ns = now;
+	t->current = stage;
+	return prev;
+}
+#endif
+
+void dec_timing_begin(DecTimings* t) {
+	if (!t) return;
+	memset(t, 0, sizeof(*t));
+	t->current = DEC_STAGE_NONE;
+	t->start_ns = dec_timing_now_ns();
+	t->last_ns = t->start_ns;
+#if DECODER_TIMINGS
+	g_dec_timings = t;
+#endif
+}
+
+void dec_timing_end(DecTimings* t) {
+	if (!t) return;
+#if DECODER_TIMINGS
+	if (g_dec_timings == t) {
+		(void)dec_timing_switch_active(DEC_STAGE_NONE);
+		g_dec_timings = NULL;
+	}
+#endif
+	t->total_ns = dec_timing_now_ns() - t->start_ns;
+}
+
+// --- JSON ---
+
+// Output goes through a small buffer that is written to fd whenever it fills,
+// so the line has no length limit (the file name can be any length).
+typedef struct {
+	int fd;
+	char buf[256];
+	size_t len;
+	int failed;
+} JsonBuf;
+
+static void jb_flush(JsonBuf* b) {
+	if (!b->failed && b->len && os_write_all(b->fd, b->buf, b->len) != 0) b->failed = 1;
+	b->len = 0;
+}
+
+static void jb_put(JsonBuf* b, const char* s, size_t n) {
+	while (n) {
+		if (b->len == sizeof(b->buf)) jb_flush(b);
+		size_t k = sizeof(b->buf) - b->len;
+		if (k > n) k = n;
+		memcpy(b->buf + b->len, s, k);
+		b->len += k;
+		s += k;
+		n -= k;
+	}
+}
+
+static void jb_str(JsonBuf* b, const char* s) { jb_put(b, s, strlen(s)); }
+
+static void jb_u64(JsonBuf* b, uint64_t v) {
+	char tmp[20];
+	size_t n = 0;
+	do {
+		tmp[sizeof(tmp) - 1u - n] = (char)('0' + (v % 10u));
+		v /= 10u;
+		n++;
+	} while (v != 0);
+	jb_put(b, tmp + sizeof(tmp) - n, n);
+}
+
+static void jb_quoted(JsonBuf* b, const char* s) {
+	static const char hex[] = "0123456789abcdef";
+	jb_put(b, "\"", 1);
+	for (; s && *s; s++) {
+		const unsigned char c = (unsigned char)*s;
+		if (c == '"' || c == '\\') {
+			const char esc[2] = {'\\', (char)c};
+			jb_put(b, esc, 2);
+		} else if (c < 0x20u) {
+			const char esc[6] = {'\\', 'u', '0', '0', hex[c >> 4], hex[c & 15u]};
+			jb_put(b, esc, 6);
+		} else {
+			jb_put(b, (const char*)&c, 1);
+		}
+	}
+	jb_put(b, "\"", 1);
+}
+
+static void jb_field(JsonBuf* b, const char* key, uint64_t v, int first) {
+	if (!first) jb_put(b, ",", 1);
+	jb_quoted(b, key);
+	jb_put(b, ":", 1);
+	jb_u64(b, v);
+}
+
+static const char* const k_stage_names[DEC_STAGE_COUNT] = {
+	"file_map", "container", "header", "modes", "tokens", "recon", "loopfilter", "color", "compress", "write",
+};
+
+int dec_timings_write_json(int fd, const DecTimings* t, const char* cmd, const char* path) {
+	if (!t) return -1;
+	JsonBuf b = {.fd = fd, .len = 0, .failed = 0};
+	jb_str(&b, "{\"cmd\":");
+	jb_quoted(&b, cmd);
+	jb_str(&b, ",\"file\":");
+	jb_quoted(&b, path);
+	jb_put(&b, ",", 1);
+	jb_field(&b, "width", t->width, 1);
+	jb_field(&b, "height", t->height, 0);
+	jb_str(&b, ",\"ns\":{");
+	for (int i = 0; i < DEC_STAGE_COUNT; i++) jb_field(&b, k_stage_names[i], t->ns[i], i == 0);
+	jb_field(&b, "total", t->total_ns, 0);
+	jb_str(&b, "},\"counts\":{");
+	jb_field(&b, "bool_decodes", t->bool_decodes, 1);
+	jb_field(&b, "tokens", t->tokens, 0);
+	jb_field(&b, "nonzero_blocks", t->nonzero_blocks, 0);
+	jb_field(&b, "bytes_written", t->bytes_written, 0);
+	jb_str(&b, "}}\n");
+	jb_flush(&b);
+	return b.failed ? -1 : 0;
+}
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Per-stage decode timing (`decoder -timings`).
+//
+// Stages are exclusive: dec_timing_switch() charges the time since the last
+// switch to the current stage and makes another stage current. The pipeline
+// switches forward (map -> container -> ... -> write); code that can run inside
+// any stage (the output writer, PNG scanline conversion) switches back to the
+// stage it interrupted.
+//
+// Compiled in by default; the ultra builds opt in with -DDECODER_TIMINGS=1
+// (e.g. `make nolibc_ultra ULTRA_EXTRA_CFLAGS=-DDECODER_TIMINGS=1`).
+
+#ifndef DECODER_TIMINGS
+#ifdef DECODER_ULTRA
+#define DECODER_TIMINGS 0
+#else
+#define DECODER_TIMINGS 1
+#endif
+#endif
+
+typedef enum {
+	DEC_STAGE_NONE = -1,
+	DEC_STAGE_FILE_MAP = 0,
+	DEC_STAGE_CONTAINER,
+	DEC_STAGE_HEADER,     // frame header (uncompressed + partition 0 header fields)
+	DEC_STAGE_MODES,      // partition 0 per-macroblock modes
+	DEC_STAGE_TOKENS,     // coefficient tokens
+	DEC_STAGE_RECON,      // prediction + inverse transforms (+ crop)
+	DEC_STAGE_LOOPFILTER,
+	DEC_STAGE_COLOR,      // YUV -> RGB
+	DEC_STAGE_COMPRESS,   // PNG zlib framing + CRC/Adler-32
+	DEC_STAGE_WRITE,      // output writer (buffering, write/writev, mmap copies)
+	DEC_STAGE_COUNT
+} DecStage;
+
+typedef struct {
+	uint64_t ns[DEC_STAGE_COUNT];
+	uint64_t total_ns;
+
+	// Counts, filled in by the caller (mostly from Vp8CoeffStats).
+	uint32_t width;
+	uint32_t height;
+	uint64_t bool_decodes;
+	uint64_t tokens;
+	uint64_t nonzero_blocks;
+	uint64_t bytes_written;
+
+	// Bookkeeping for dec_timing_switch().
+	DecStage current;
+	uint64_t start_ns;
+	uint64_t last_ns;
+} DecTimings;
+
+// Monotonic clock in nanoseconds.
+uint64_t dec_timing_now_ns(void);
+
+#if DECODER_TIMINGS
+// The active sink, or NULL when timing is off (the default).
+extern DecTimings* g_dec_timings;
+
+DecStage dec_timing_switch_active(DecStage stage);
+
+// Makes `stage` current; returns the previous stage (restore it with another switch).
+static inline DecStage dec_timing_switch(DecStage stage) {
+	return g_dec_timings ? dec_timing_switch_active(stage) : DEC_STAGE_NONE;
+}
+#else
+// A macro rather than an inline function: the ultra builds use -fno-inline.
+#define dec_timing_switch(stage) ((void)(stage), DEC_STAGE_NONE)
+#endif
+
+// Zeroes `t`, makes it the active sink and starts the clock (no stage current).
+void dec_timing_begin(DecTimings* t);
+
+// Charges the current stage, sets total_ns and deactivates the sink.
+void dec_timing_end(DecTimings* t);
+
+// Writes `t` as a single-line JSON object (with a trailing newline) to fd.
+// `cmd` and `path` are included as strings of any length. Returns 0, or -1 if
+// a write failed.
+int dec_timings_write_json(int fd, const DecTimings* t, const char* cmd, const char* path);
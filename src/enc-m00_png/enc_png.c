@@ -12,48 +12,66 @@ static uint32_t be32(const uint8_t* p) {
 	return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | (uint32_t)p[3];
 }
 
+// Reads all of `path` ("-" is stdin). A pipe has no size up front, so it is
+// read to EOF into a buffer that doubles as it fills.
 static int read_entire_file(const char* path, uint8_t** out_buf, size_t* out_size) {
 	*out_buf = NULL;
 	*out_size = 0;
 
-	int fd = open(path, O_RDONLY);
+	const int use_stdin = path[0] == '-' && path[1] == '\0';
+	int fd = use_stdin ? 0 : open(path, O_RDONLY);
 	if (fd < 0) return -1;
 
+	int stream = 0;
+	size_t want = 0;
 	off_t end = lseek(fd, 0, SEEK_END);
-	if (end < 0) {
-		(void)close(fd);
-		return -1;
-	}
-	if (lseek(fd, 0, SEEK_SET) < 0) {
-		(void)close(fd);
-		return -1;
-	}
-
-	if (end == 0) {
-		(void)close(fd);
-		errno = EINVAL;
-		return -1;
-	}
-	if ((uint64_t)end > (uint64_t)SIZE_MAX) {
-		(void)close(fd);
-		errno = EOVERFLOW;
-		return -1;
+	if (end < 0 && errno == ESPIPE) {
+		stream = 1;
+		want = (size_t)64u << 10;
+	} else {
+		if (end < 0 || lseek(fd, 0, SEEK_SET) < 0) {
+			if (!use_stdin) (void)close(fd);
+			return -1;
+		}
+		if (end == 0) {
+			if (!use_stdin) (void)close(fd);
+			errno = EINVAL;
+			return -1;
+		}
+		if ((uint64_t)end > (uint64_t)SIZE_MAX) {
+			if (!use_stdin) (void)close(fd);
+			errno = EOVERFLOW;
+			return -1;
+		}
+		want = (size_t)end;
 	}
 
-	uint8_t* buf = (uint8_t*)malloc((size_t)end);
+	uint8_t* buf = (uint8_t*)malloc(want);
 	if (!buf) {
-		(void)close(fd);
+		if (!use_stdin) (void)close(fd);
 		errno = ENOMEM;
 		return -1;
 	}
 
-	size_t want = (size_t)end;
 	size_t got = 0;
-	while (got < want) {
+	for (;;) {
+		if (got == want) {
+			if (!stream) break;
+			uint8_t* nbuf = (want <= SIZE_MAX / 2u) ? (uint8_t*)realloc(buf, want * 2u) : NULL;
+			if (!nbuf) {
+				if (!use_stdin) (void)close(fd);
+				free(buf);
+				errno = ENOMEM;
+				return -1;
+			}
+			buf = nbuf;
+			want *= 2u;
+		}
 		ssize_t n = read(fd, buf + got, want - got);
 		if (n < 0) {
+			if (errno == EINTR) continue;
 			int saved = errno;
-			(void)close(fd);
+			if (!use_stdin) (void)close(fd);
 			free(buf);
 			errno = saved;
 			return -1;
@@ -61,10 +79,10 @@ static int read_entire_file(const char* path, uint8_t** out_buf, size_t* out_siz
 		if (n == 0) break;
 		got += (size_t)n;
 	}
-	(void)close(fd);
-	if (got != want) {
+	if (!use_stdin) (void)close(fd);
+	if (stream ? got == 0 : got != want) {
 		free(buf);
-		errno = EIO;
+		errno = stream ? EINVAL : EIO;
 		return -1;
 	}
 
@@ -75,12 +93,20 @@ static int read_entire_file(const char* path, uint8_t** out_buf, size_t* out_siz
 
 // --- adler32 (zlib) ---
 
-static uint32_t adler32(const uint8_t* data, size_t n) {
-	uint32_t a = 1;
-	uint32_t b = 0;
-	for (size_t i = 0; i < n; i++) {
-		a = (a + data[i]) % 65521u;
-		b = (b + a) % 65521u;
+// Continues a running checksum; start from 1.
+static uint32_t adler32_update(uint32_t adler, const uint8_t* data, size_t n) {
+	// 5552 is the most bytes b can sum before it may overflow 32 bits (as in zlib).
+	uint32_t a = adler & 0xFFFFu;
+	uint32_t b = adler >> 16;
+	while (n > 0) {
+		size_t chunk = (n < 5552u) ? n : 5552u;
+		n -= chunk;
+		while (chunk--) {
+			a += *data++;
+			b += a;
+		}
+		a %= 65521u;
+		b %= 65521u;
 	}
 	return (b << 16) | a;
 }
@@ -94,13 +120,22 @@ typedef struct BitReader {
 	int bitcount;
 } BitReader;
 
-static int br_fill(BitReader* br, int need) {
-	while (br->bitcount < need) {
-		if (br->p >= br->end) return -1;
+// Tops the bit buffer up to at least 56 bits, or to whatever input is left.
+static void br_refill(BitReader* br) {
+	if (br->end - br->p >= 8) {
+		const uint8_t* p = br->p;
+		uint64_t v = (uint64_t)p[0] | ((uint64_t)p[1] << 8) | ((uint64_t)p[2] << 16) | ((uint64_t)p[3] << 24) |
+		             ((uint64_t)p[4] << 32) | ((uint64_t)p[5] << 40) | ((uint64_t)p[6] << 48) |
+		             ((uint64_t)p[7] << 56);
+		br->bitbuf |= v << br->bitcount;
+		br->p += (63 - br->bitcount) >> 3;
+		br->bitcount |= 56;
+		return;
+	}
+	while (br->bitcount <= 56 && br->p < br->end) {
 		br->bitbuf |= (uint64_t)(*br->p++) << br->bitcount;
 		br->bitcount += 8;
 	}
-	return 0;
 }
 
 static int br_read_bits(BitReader* br, int n, uint32_t* out) {
@@ -108,81 +143,125 @@ static int br_read_bits(BitReader* br, int n, uint32_t* out) {
 		*out = 0;
 		return 0;
 	}
-	if (br_fill(br, n) != 0) return -1;
+	if (br->bitcount < n) {
+		br_refill(br);
+		if (br->bitcount < n) return -1;
+	}
 	*out = (uint32_t)(br->bitbuf & ((1ull << n) - 1ull));
 	br->bitbuf >>= n;
 	br->bitcount -= n;
 	return 0;
 }
 
-static int br_align_byte(BitReader* br) {
-	int drop = br->bitcount & 7;
-	if (drop) {
-		br->bitbuf >>= drop;
-		br->bitcount -= drop;
-	}
-	return 0;
+// Drops the bits up to the next byte boundary and hands the whole bytes still
+// buffered back to `p`, so stored blocks can be copied straight from the input.
+static void br_align_byte(BitReader* br) {
+	br->p -= br->bitcount >> 3;
+	br->bitbuf = 0;
+	br->bitcount = 0;
 }
 
+// Two-level decode table. The low HUFF_ROOT_BITS bits of the (LSB-first) input
+// index the primary table; codes longer than that continue in a subtable
+// indexed by the next `sub` bits.
+enum {
+	HUFF_ROOT_BITS = 9,
+	HUFF_MAX_BITS = 15,
+	HUFF_MAX_ENTRIES = 2048,
+};
+
+typedef struct HuffEntry {
+	uint16_t sym; // symbol, or subtable offset when sub != 0
+	uint8_t len;  // total code length; 0 marks an unused code
+	uint8_t sub;  // subtable index bits (primary entries only)
+} HuffEntry;
+
 typedef struct Huff {
-	// Canonical Huffman decode: small linear decode is OK for now.
-	// code -> symbol via (code,len) matching.
-	uint16_t sym[288];
-	uint8_t len[288];
-	int count;
+	HuffEntry table[HUFF_MAX_ENTRIES];
 } Huff;
 
+static uint32_t reverse_bits(uint32_t code, int n) {
+	uint32_t rev = 0;
+	for (int i = 0; i < n; i++) {
+		rev = (rev << 1) | (code & 1u);
+		code >>= 1;
+	}
+	return rev;
+}
+
+// Builds the table for canonical code lengths (0 = symbol absent). Incomplete
+// codes are allowed (a lone distance code is legal); over-subscribed ones are
+// rejected.
 static int huff_build(Huff* h, const uint8_t* lengths, int count) {
-	// Build canonical codes; store per-symbol lengths; decoding does bit-by-bit match.
-	h->count = count;
+	uint16_t bl_count[HUFF_MAX_BITS + 1] = {0};
 	for (int i = 0; i < count; i++) {
-		h->sym[i] = (uint16_t)i;
-		h->len[i] = lengths[i];
+		if (lengths[i] > HUFF_MAX_BITS) return -1;
+		bl_count[lengths[i]]++;
+	}
+	int left = 1;
+	for (int bits = 1; bits <= HUFF_MAX_BITS; bits++) {
+		left = (left << 1) - (int)bl_count[bits];
+		if (left < 0) return -1;
+	}
+
+	uint16_t next_code[HUFF_MAX_BITS + 1] = {0};
+	uint32_t c = 0;
+	for (int bits = 1; bits <= HUFF_MAX_BITS; bits++) {
+		c = (c + bl_count[bits - 1]) << 1;
+		next_code[bits] = (uint16_t)c;
+	}
+
+	// Subtable size per primary slot: the longest code sharing that prefix.
+	uint8_t sub_bits[1u << HUFF_ROOT_BITS] = {0};
+	uint16_t codes[288];
+	if (count > 288) return -1;
+	for (int sym = 0; sym < count; sym++) {
+		const int l = lengths[sym];
+		if (l == 0) continue;
+		codes[sym] = next_code[l]++;
+		if (l <= HUFF_ROOT_BITS) continue;
+		const uint32_t prefix = reverse_bits(codes[sym], l) & ((1u << HUFF_ROOT_BITS) - 1u);
+		if (sub_bits[prefix] < l - HUFF_ROOT_BITS) sub_bits[prefix] = (uint8_t)(l - HUFF_ROOT_BITS);
+	}
+
+	memset(h->table, 0, sizeof(h->table));
+	uint32_t used = 1u << HUFF_ROOT_BITS;
+	for (uint32_t prefix = 0; prefix < (1u << HUFF_ROOT_BITS); prefix++) {
+		if (!sub_bits[prefix]) continue;
+		if (used + (1u << sub_bits[prefix]) > HUFF_MAX_ENTRIES) return -1;
+		h->table[prefix].sym = (uint16_t)used;
+		h->table[prefix].sub = sub_bits[prefix];
+		used += 1u << sub_bits[prefix];
+	}
+
+	for (int sym = 0; sym < count; sym++) {
+		const int l = lengths[sym];
+		if (l == 0) continue;
+		const uint32_t rev = reverse_bits(codes[sym], l);
+		const HuffEntry e = {.sym = (uint16_t)sym, .len = (uint8_t)l, .sub = 0};
+		if (l <= HUFF_ROOT_BITS) {
+			for (uint32_t i = rev; i < (1u << HUFF_ROOT_BITS); i += 1u << l) h->table[i] = e;
+			continue;
+		}
+		const HuffEntry* root = &h->table[rev & ((1u << HUFF_ROOT_BITS) - 1u)];
+		HuffEntry* sub = &h->table[root->sym];
+		const int sl = l - HUFF_ROOT_BITS;
+		for (uint32_t i = rev >> HUFF_ROOT_BITS; i < (1u << root->sub); i += 1u << sl) sub[i] = e;
 	}
 	return 0;
 }
 
 static int huff_decode(BitReader* br, const Huff* h, int* out_sym) {
-	// Slow but simple: read up to 15 bits, try all symbols with matching length.
-	// For Milestone 0 correctness > speed.
-	uint32_t code = 0;
-	for (int n = 1; n <= 15; n++) {
-		uint32_t bit;
-		if (br_read_bits(br, 1, &bit) != 0) return -1;
-		code |= bit << (n - 1);
-
-		// Canonical Huffman is defined MSB-first, but DEFLATE transmits LSB-first.
-		// We are accumulating LSB-first codes; to match canonical ordering we'd need a table.
-		// Instead, we build decoding using DEFLATE's bit-reversed codes on the fly.
-		// We'll compute the bit-reversed value for n bits and match it against canonical codes.
-		uint32_t rev = 0;
-		for (int i = 0; i < n; i++) rev = (rev << 1) | ((code >> i) & 1u);
-
-		// Build canonical code ranges each call is expensive; keep it simple but correct:
-		// Generate canonical codes from lengths and compare.
-		uint16_t bl_count[16] = {0};
-		for (int i = 0; i < h->count; i++) {
-			uint8_t l = h->len[i];
-			// Length 0 means "symbol absent" and must not participate in canonical code generation.
-			if (l >= 1 && l <= 15) bl_count[l]++;
-		}
-		uint16_t next_code[16] = {0};
-		uint16_t c = 0;
-		for (int bits = 1; bits <= 15; bits++) {
-			c = (uint16_t)((c + bl_count[bits - 1]) << 1);
-			next_code[bits] = c;
-		}
-		for (int sym = 0; sym < h->count; sym++) {
-			uint8_t l = h->len[sym];
-			if (l != (uint8_t)n) continue;
-			uint16_t canon = next_code[n]++;
-			if (canon == (uint16_t)rev) {
-				*out_sym = sym;
-				return 0;
-			}
-		}
-	}
-	return -1;
+	if (br->bitcount < HUFF_MAX_BITS) br_refill(br);
+	HuffEntry e = h->table[br->bitbuf & ((1u << HUFF_ROOT_BITS) - 1u)];
+	if (e.sub) {
+		e = h->table[e.sym + ((br->bitbuf >> HUFF_ROOT_BITS) & ((1u << e.sub) - 1u))];
+	}
+	if (e.len == 0 || e.len > br->bitcount) return -1;
+	br->bitbuf >>= e.len;
+	br->bitcount -= e.len;
+	*out_sym = e.sym;
+	return 0;
 }
 
 static void build_fixed_huffman(Huff* litlen, Huff* dist) {
@@ -214,7 +293,61 @@ static const int DIST_EXTRA[30] = {
 	13, 13,
 };
 
-static int inflate_zlib(const uint8_t* in, size_t in_len, uint8_t* out, size_t out_len) {
+// Inflated scanlines are handed out as soon as a window compaction or the end
+// of the stream completes them; only the 32 KiB history DEFLATE may refer back
+// to (plus the unfinished scanline) is kept.
+enum { INFLATE_HISTORY = 32768, INFLATE_MAX_MATCH = 258 };
+
+typedef int (*InflateScanlineFn)(void* user, const uint8_t* scanline);
+
+typedef struct Inflater {
+	uint8_t* win;
+	size_t cap;
+	size_t pos;       // write position in win
+	size_t row_start; // first byte of win not yet handed out
+	size_t scan;      // bytes per scanline (filter byte included)
+	uint32_t rows_left;
+	uint32_t adler;
+	InflateScanlineFn fn;
+	void* user;
+	int sink_errno; // errno of a failed `fn` call, else 0
+} Inflater;
+
+// Window size for `scan`-byte scanlines: compaction keeps at most
+// INFLATE_HISTORY + scan bytes, so each one frees room for several rows.
+static size_t inflater_window_size(size_t scan) {
+	if (scan > (SIZE_MAX / 4u) - INFLATE_HISTORY) return 0;
+	return 4u * (INFLATE_HISTORY + scan);
+}
+
+static int inflater_flush(Inflater* z) {
+	while (z->pos - z->row_start >= z->scan) {
+		if (z->rows_left == 0) return -1; // more data than the image holds
+		const uint8_t* line = z->win + z->row_start;
+		z->adler = adler32_update(z->adler, line, z->scan);
+		if (z->fn(z->user, line) != 0) {
+			z->sink_errno = errno ? errno : EINVAL;
+			return -1;
+		}
+		z->row_start += z->scan;
+		z->rows_left--;
+	}
+	return 0;
+}
+
+// Makes room for `need` more bytes after handing out complete scanlines.
+static int inflater_reserve(Inflater* z, size_t need) {
+	if (z->cap - z->pos >= need) return 0;
+	if (inflater_flush(z) != 0) return -1;
+	size_t keep_from = (z->pos > INFLATE_HISTORY) ? z->pos - INFLATE_HISTORY : 0;
+	if (keep_from > z->row_start) keep_from = z->row_start;
+	memmove(z->win, z->win + keep_from, z->pos - keep_from);
+	z->pos -= keep_from;
+	z->row_start -= keep_from;
+	return (z->cap - z->pos >= need) ? 0 : -1;
+}
+
+static int inflate_zlib(const uint8_t* in, size_t in_len, Inflater* z) {
 	if (in_len < 6) return -1;
 	uint8_t cmf = in[0];
 	uint8_t flg = in[1];
@@ -223,7 +356,7 @@ static int inflate_zlib(const uint8_t* in, size_t in_len, uint8_t* out, size_t o
 	if (flg & 0x20) return -1; // no preset dictionary
 
 	BitReader br = {.p = in + 2, .end = in + in_len - 4, .bitbuf = 0, .bitcount = 0};
-	size_t out_pos = 0;
+	uint8_t* out = z->win;
 
 	int final_block = 0;
 	while (!final_block) {
@@ -239,12 +372,18 @@ static int inflate_zlib(const uint8_t* in, size_t in_len, uint8_t* out, size_t o
 			uint16_t len = (uint16_t)(br.p[0] | (br.p[1] << 8));
 			uint16_t nlen = (uint16_t)(br.p[2] | (br.p[3] << 8));
 			br.p += 4;
-			if ((uint16_t)(len ^ 0xFFFFu) != nlen) return -1;
+			if ((uint32_t)len + nlen != 0xFFFFu) return -1; // nlen == ~len
 			if ((size_t)(br.end - br.p) < len) return -1;
-			if (out_pos + len > out_len) return -1;
-			memcpy(out + out_pos, br.p, len);
-			br.p += len;
-			out_pos += len;
+			size_t left = len;
+			while (left > 0) {
+				if (inflater_reserve(z, 1) != 0) return -1;
+				size_t n = z->cap - z->pos;
+				if (n > left) n = left;
+				memcpy(out + z->pos, br.p, n);
+				br.p += n;
+				z->pos += n;
+				left -= n;
+			}
 			continue;
 		}
 
@@ -271,7 +410,7 @@ static int inflate_zlib(const uint8_t* in, size_t in_len, uint8_t* out, size_t o
 				cl_len[CL_ORDER[i]] = (uint8_t)v;
 			}
 			Huff cl_h;
-			(void)huff_build(&cl_h, cl_len, 19);
+			if (huff_build(&cl_h, cl_len, 19) != 0) return -1;
 
 			uint32_t idx = 0;
 			uint8_t prev = 0;
@@ -320,18 +459,18 @@ static int inflate_zlib(const uint8_t* in, size_t in_len, uint8_t* out, size_t o
 				}
 			}
 
-			(void)huff_build(&litlen, ll_len, (int)HLIT);
-			(void)huff_build(&dist, d_len, (int)HDIST);
+			if (huff_build(&litlen, ll_len, (int)HLIT) != 0) return -1;
+			if (huff_build(&dist, d_len, (int)HDIST) != 0) return -1;
 		} else {
 			return -1;
 		}
 
 		for (;;) {
+			if (inflater_reserve(z, INFLATE_MAX_MATCH) != 0) return -1;
 			int sym;
 			if (huff_decode(&br, &litlen, &sym) != 0) return -1;
 			if (sym < 256) {
-				if (out_pos >= out_len) return -1;
-				out[out_pos++] = (uint8_t)sym;
+				out[z->pos++] = (uint8_t)sym;
 				continue;
 			}
 			if (sym == 256) break;
@@ -348,20 +487,26 @@ static int inflate_zlib(const uint8_t* in, size_t in_len, uint8_t* out, size_t o
 			if (br_read_bits(&br, DIST_EXTRA[dist_sym], &de) != 0) return -1;
 			int distance = DIST_BASE[dist_sym] + (int)de;
 			if (distance <= 0) return -1;
-			if ((size_t)distance > out_pos) return -1;
-			if (out_pos + (size_t)length > out_len) return -1;
-
-			size_t from = out_pos - (size_t)distance;
-			for (int i = 0; i < length; i++) {
-				out[out_pos++] = out[from++];
+			// Once anything was dropped, win still holds the last INFLATE_HISTORY bytes.
+			if ((size_t)distance > z->pos) return -1;
+
+			uint8_t* dst = out + z->pos;
+			const uint8_t* src = dst - distance;
+			z->pos += (size_t)length;
+			if (distance >= length) {
+				memcpy(dst, src, (size_t)length);
+			} else if (distance == 1) {
+				memset(dst, *src, (size_t)length);
+			} else {
+				// Overlapping: the match repeats the last `distance` bytes.
+				for (int i = 0; i < length; i++) dst[i] = src[i];
 			}
 		}
 	}
 
-	uint32_t want = be32(in + in_len - 4);
-	uint32_t got = adler32(out, out_pos);
-	if (want != got) return -1;
-	return (out_pos == out_len) ? 0 : -1;
+	if (inflater_flush(z) != 0) return -1;
+	if (z->rows_left != 0 || z->pos != z->row_start) return -1;
+	return (be32(in + in_len - 4) == z->adler) ? 0 : -1;
 }
 
 static inline int iabs_i32(int v) {
@@ -378,124 +523,141 @@ static uint8_t paeth(uint8_t a, uint8_t b, uint8_t c) {
 	return c;
 }
 
-static int unfilter(uint8_t* out, const uint8_t* in, uint32_t w, uint32_t h, int bpp) {
-	size_t stride = (size_t)w * (size_t)bpp;
-	const uint8_t* prev = NULL;
-	for (uint32_t y = 0; y < h; y++) {
-		uint8_t ft = *in++;
-		uint8_t* row = out + (size_t)y * stride;
-		switch (ft) {
-			case 0: // None
-				memcpy(row, in, stride);
-				break;
-			case 1: // Sub
-				for (size_t i = 0; i < stride; i++) {
-					uint8_t left = (i >= (size_t)bpp) ? row[i - (size_t)bpp] : 0;
-					row[i] = (uint8_t)(in[i] + left);
-				}
-				break;
-			case 2: // Up
-				for (size_t i = 0; i < stride; i++) {
-					uint8_t up = prev ? prev[i] : 0;
-					row[i] = (uint8_t)(in[i] + up);
-				}
-				break;
-			case 3: // Average
-				for (size_t i = 0; i < stride; i++) {
-					uint8_t left = (i >= (size_t)bpp) ? row[i - (size_t)bpp] : 0;
-					uint8_t up = prev ? prev[i] : 0;
-					row[i] = (uint8_t)(in[i] + ((uint8_t)(((int)left + (int)up) / 2)));
-				}
-				break;
-			case 4: // Paeth
-				for (size_t i = 0; i < stride; i++) {
-					uint8_t left = (i >= (size_t)bpp) ? row[i - (size_t)bpp] : 0;
-					uint8_t up = prev ? prev[i] : 0;
-					uint8_t up_left = (prev && i >= (size_t)bpp) ? prev[i - (size_t)bpp] : 0;
-					row[i] = (uint8_t)(in[i] + paeth(left, up, up_left));
-				}
-				break;
-			default:
-				return -1;
-		}
-		in += stride;
-		prev = row;
+// Unfilters one scanline (`in` starts at the filter type byte) into `row`.
+// `prev` is the previous unfiltered row, or NULL for the first.
+static int unfilter_row(uint8_t* row, const uint8_t* in, const uint8_t* prev, size_t stride, int bpp) {
+	uint8_t ft = *in++;
+	switch (ft) {
+		case 0: // None
+			memcpy(row, in, stride);
+			break;
+		case 1: // Sub
+			for (size_t i = 0; i < stride; i++) {
+				uint8_t left = (i >= (size_t)bpp) ? row[i - (size_t)bpp] : 0;
+				row[i] = (uint8_t)(in[i] + left);
+			}
+			break;
+		case 2: // Up
+			for (size_t i = 0; i < stride; i++) {
+				uint8_t up = prev ? prev[i] : 0;
+				row[i] = (uint8_t)(in[i] + up);
+			}
+			break;
+		case 3: // Average
+			for (size_t i = 0; i < stride; i++) {
+				uint8_t left = (i >= (size_t)bpp) ? row[i - (size_t)bpp] : 0;
+				uint8_t up = prev ? prev[i] : 0;
+				row[i] = (uint8_t)(in[i] + ((uint8_t)(((int)left + (int)up) / 2)));
+			}
+			break;
+		case 4: // Paeth
+			for (size_t i = 0; i < stride; i++) {
+				uint8_t left = (i >= (size_t)bpp) ? row[i - (size_t)bpp] : 0;
+				uint8_t up = prev ? prev[i] : 0;
+				uint8_t up_left = (prev && i >= (size_t)bpp) ? prev[i - (size_t)bpp] : 0;
+				row[i] = (uint8_t)(in[i] + paeth(left, up, up_left));
+			}
+			break;
+		default:
+			return -1;
 	}
 	return 0;
 }
 
-int enc_png_read_file(const char* path, EncPngImage* out_img) {
-	if (!out_img) return -1;
-	memset(out_img, 0, sizeof(*out_img));
-
-	uint8_t* file = NULL;
-	size_t file_size = 0;
-	if (read_entire_file(path, &file, &file_size) != 0) return -1;
-
-	static const uint8_t SIG[8] = {137, 80, 78, 71, 13, 10, 26, 10};
-	if (file_size < 8 || memcmp(file, SIG, 8) != 0) {
-		free(file);
+// Per-image state between the inflater and the caller's row sink.
+typedef struct PngRows {
+	const EncPngRowSink* sink;
+	uint32_t width;
+	uint32_t y;
+	size_t src_stride;
+	int bpp;            // bytes per pixel, for the filters
+	int src_channels;   // 1 gray, 2 gray+alpha, 3 RGB, 4 RGBA
+	int wide;           // 16-bit samples
+	uint8_t* rows[2];   // unfiltered rows, alternating
+	uint8_t* out[2];    // expanded rows, alternating (NULL when rows[] already are RGB(A))
+} PngRows;
+
+static int png_scanline(void* user, const uint8_t* scanline) {
+	PngRows* r = (PngRows*)user;
+	const uint32_t y = r->y++;
+	uint8_t* row = r->rows[y & 1u];
+	const uint8_t* prev = y ? r->rows[(y - 1u) & 1u] : NULL;
+	if (unfilter_row(row, scanline, prev, r->src_stride, r->bpp) != 0) {
 		errno = EINVAL;
 		return -1;
 	}
+	if (!r->out[0]) return r->sink->row(r->sink->user, y, row);
+
+	// Keep the MSB of 16-bit (big-endian) samples and expand gray to RGB(A) so
+	// sinks only see 8-bit RGB/RGBA.
+	const size_t step = r->wide ? 2u : 1u;
+	uint8_t* dst = r->out[y & 1u];
+	const uint32_t w = r->width;
+	if (r->src_channels == 3 || r->src_channels == 4) {
+		const size_t n = (size_t)w * (size_t)r->src_channels;
+		for (size_t i = 0; i < n; ++i) dst[i] = row[i * step];
+	} else if (r->src_channels == 1) {
+		for (uint32_t x = 0; x < w; ++x) {
+			uint8_t g = row[(size_t)x * step];
+			dst[x * 3u + 0u] = g;
+			dst[x * 3u + 1u] = g;
+			dst[x * 3u + 2u] = g;
+		}
+	} else {
+		for (uint32_t x = 0; x < w; ++x) {
+			uint8_t g = row[(size_t)x * 2u * step];
+			uint8_t a = row[((size_t)x * 2u + 1u) * step];
+			dst[x * 4u + 0u] = g;
+			dst[x * 4u + 1u] = g;
+			dst[x * 4u + 2u] = g;
+			dst[x * 4u + 3u] = a;
+		}
+	}
+	return r->sink->row(r->sink->user, y, dst);
+}
+
+// Moves every IDAT payload to the front of `file`, in order, so the zlib stream
+// is contiguous without a second buffer. Fills in the IHDR fields.
+typedef struct PngHeader {
+	uint32_t width, height;
+	uint8_t bit_depth, color_type, comp, filt, interlace;
+} PngHeader;
+
+static int png_gather_idat(uint8_t* file, size_t file_size, PngHeader* hdr, size_t* out_idat_size) {
+	static const uint8_t SIG[8] = {137, 80, 78, 71, 13, 10, 26, 10};
+	if (file_size < 8 || memcmp(file, SIG, 8) != 0) return -1;
 
 	size_t off = 8;
-	uint32_t width = 0, height = 0;
-	uint8_t bit_depth = 0, color_type = 0, comp = 0, filt = 0, interlace = 0;
-	uint8_t* idat = NULL;
 	size_t idat_size = 0;
-
 	int saw_ihdr = 0;
 	int saw_iend = 0;
 	while (off + 12 <= file_size) {
 		uint32_t len = be32(file + off);
 		uint32_t typ = be32(file + off + 4);
 		off += 8;
-		if (off + len + 4 > file_size) {
-			free(idat);
-			free(file);
-			errno = EINVAL;
-			return -1;
-		}
+		if (off + len + 4 > file_size) return -1;
 		const uint8_t* data = file + off;
 		off += len;
 		// skip CRC
 		off += 4;
 
 		if (typ == 0x49484452u) { // IHDR
-			if (len != 13 || saw_ihdr) {
-				free(idat);
-				free(file);
-				errno = EINVAL;
-				return -1;
-			}
-			width = be32(data);
-			height = be32(data + 4);
-			bit_depth = data[8];
-			color_type = data[9];
-			comp = data[10];
-			filt = data[11];
-			interlace = data[12];
+			if (len != 13 || saw_ihdr) return -1;
+			hdr->width = be32(data);
+			hdr->height = be32(data + 4);
+			hdr->bit_depth = data[8];
+			hdr->color_type = data[9];
+			hdr->comp = data[10];
+			hdr->filt = data[11];
+			hdr->interlace = data[12];
 			saw_ihdr = 1;
 			continue;
 		}
-		if (!saw_ihdr) {
-			free(idat);
-			free(file);
-			errno = EINVAL;
-			return -1;
-		}
+		if (!saw_ihdr) return -1;
 
 		if (typ == 0x49444154u) { // IDAT
-			uint8_t* grown = (uint8_t*)realloc(idat, idat_size + len);
-			if (!grown) {
-				free(idat);
-				free(file);
-				errno = ENOMEM;
-				return -1;
-			}
-			idat = grown;
-			memcpy(idat + idat_size, data, len);
+			// The destination never passes `data`: it skips at least the signature and headers.
+			memmove(file + idat_size, data, len);
 			idat_size += len;
 			continue;
 		}
@@ -505,151 +667,151 @@ int enc_png_read_file(const char* path, EncPngImage* out_img) {
 		}
 		// ignore other chunks for now
 	}
+	if (!saw_ihdr || !saw_iend || idat_size == 0) return -1;
+	*out_idat_size = idat_size;
+	return 0;
+}
 
-	free(file);
-
-	if (!saw_ihdr || !saw_iend || idat_size == 0) {
-		free(idat);
+int enc_png_read_rows(const char* path, const EncPngRowSink* sink) {
+	if (!path || !sink || !sink->begin || !sink->row) {
 		errno = EINVAL;
 		return -1;
 	}
-	if (width == 0 || height == 0) {
-		free(idat);
+
+	uint8_t* file = NULL;
+	size_t file_size = 0;
+	if (read_entire_file(path, &file, &file_size) != 0) return -1;
+
+	PngHeader hdr;
+	memset(&hdr, 0, sizeof(hdr));
+	size_t idat_size = 0;
+	if (png_gather_idat(file, file_size, &hdr, &idat_size) != 0) {
+		free(file);
 		errno = EINVAL;
 		return -1;
 	}
-	if (!(bit_depth == 8 || bit_depth == 16)) {
-		free(idat);
-		errno = ENOTSUP;
-		return -1;
-	}
-	// Some converters (notably macOS `sips`) emit grayscale PNGs for
-	// monochrome sources. Accept grayscale/grayscale+alpha too.
-	if (!(color_type == 0 || color_type == 2 || color_type == 4 || color_type == 6)) {
-		free(idat);
-		errno = ENOTSUP;
-		return -1;
-	}
-	if (comp != 0 || filt != 0 || interlace != 0) {
-		free(idat);
-		errno = ENOTSUP;
+
+	const uint32_t width = hdr.width;
+	const uint32_t height = hdr.height;
+	int err = 0;
+	if (width == 0 || height == 0) {
+		err = EINVAL;
+	} else if (!(hdr.bit_depth == 8 || hdr.bit_depth == 16)) {
+		err = ENOTSUP;
+	} else if (!(hdr.color_type == 0 || hdr.color_type == 2 || hdr.color_type == 4 || hdr.color_type == 6)) {
+		// Some converters (notably macOS `sips`) emit grayscale PNGs for
+		// monochrome sources. Accept grayscale/grayscale+alpha too.
+		err = ENOTSUP;
+	} else if (hdr.comp != 0 || hdr.filt != 0 || hdr.interlace != 0) {
+		err = ENOTSUP;
+	}
+	if (err) {
+		free(file);
+		errno = err;
 		return -1;
 	}
 
-	const int bytes_per_sample = (bit_depth == 16) ? 2 : 1;
+	const int bytes_per_sample = (hdr.bit_depth == 16) ? 2 : 1;
 	int src_channels = 0;
-	switch (color_type) {
+	switch (hdr.color_type) {
 		case 0: src_channels = 1; break; // gray
 		case 2: src_channels = 3; break; // rgb
 		case 4: src_channels = 2; break; // gray+alpha
 		case 6: src_channels = 4; break; // rgba
 		default: src_channels = 0; break;
 	}
-	if (src_channels == 0) {
-		free(idat);
-		errno = ENOTSUP;
-		return -1;
-	}
-
-	size_t src_stride = (size_t)width * (size_t)src_channels * (size_t)bytes_per_sample;
-	size_t scan = 1 + src_stride;
-	if (height > (SIZE_MAX / scan)) {
-		free(idat);
+	const int dst_channels = (src_channels == 2 || src_channels == 4) ? 4 : 3;
+
+	PngRows rows;
+	memset(&rows, 0, sizeof(rows));
+	rows.sink = sink;
+	rows.width = width;
+	rows.bpp = src_channels * bytes_per_sample;
+	rows.src_channels = src_channels;
+	rows.wide = (bytes_per_sample == 2);
+	rows.src_stride = (size_t)width * (size_t)rows.bpp;
+	const size_t dst_stride = (size_t)width * (size_t)dst_channels;
+	const int expand = (bytes_per_sample != 1 || src_channels != dst_channels);
+
+	// One allocation: the inflate window, two unfiltered rows and, when the
+	// pixels need converting, two RGB(A) rows.
+	Inflater z;
+	memset(&z, 0, sizeof(z));
+	z.scan = 1u + rows.src_stride;
+	z.cap = (rows.src_stride / (size_t)rows.bpp == width) ? inflater_window_size(z.scan) : 0;
+	size_t total = z.cap;
+	const size_t row_bytes = 2u * rows.src_stride + (expand ? 2u * dst_stride : 0u);
+	if (z.cap == 0 || dst_stride / (size_t)dst_channels != width || row_bytes > SIZE_MAX - total) {
+		free(file);
+		errno = EOVERFLOW;
 		return -1;
 	}
-	size_t inflated_size = (size_t)height * scan;
-
-	uint8_t* inflated = (uint8_t*)malloc(inflated_size);
-	if (!inflated) {
-		free(idat);
+	total += row_bytes;
+	uint8_t* mem = (uint8_t*)malloc(total);
+	if (!mem) {
+		free(file);
 		errno = ENOMEM;
 		return -1;
 	}
+	z.win = mem;
+	rows.rows[0] = mem + z.cap;
+	rows.rows[1] = rows.rows[0] + rows.src_stride;
+	if (expand) {
+		rows.out[0] = rows.rows[1] + rows.src_stride;
+		rows.out[1] = rows.out[0] + dst_stride;
+	}
+	z.rows_left = height;
+	z.adler = 1;
+	z.fn = png_scanline;
+	z.user = &rows;
 
-	if (inflate_zlib(idat, idat_size, inflated, inflated_size) != 0) {
-		free(inflated);
-		free(idat);
-		errno = EINVAL;
-		return -1;
+	int rc = sink->begin(sink->user, width, height, (uint8_t)dst_channels);
+	if (rc == 0 && inflate_zlib(file, idat_size, &z) != 0) {
+		errno = z.sink_errno ? z.sink_errno : EINVAL;
+		rc = -1;
 	}
-	free(idat);
+	free(mem);
+	free(file);
+	return rc;
+}
 
-	uint8_t* raw = (uint8_t*)malloc((size_t)height * src_stride);
-	if (!raw) {
-		free(inflated);
-		errno = ENOMEM;
+// enc_png_read_file(): a sink that stores every row.
+static int image_begin(void* user, uint32_t width, uint32_t height, uint8_t channels) {
+	EncPngImage* img = (EncPngImage*)user;
+	const size_t stride = (size_t)width * channels;
+	if (stride / channels != width || height > SIZE_MAX / stride) {
+		errno = EOVERFLOW;
 		return -1;
 	}
-	if (unfilter(raw, inflated, width, height, src_channels * bytes_per_sample) != 0) {
-		free(raw);
-		free(inflated);
-		errno = EINVAL;
+	img->data = (uint8_t*)malloc(stride * height);
+	if (!img->data) {
+		errno = ENOMEM;
 		return -1;
 	}
-	free(inflated);
+	img->width = width;
+	img->height = height;
+	img->channels = channels;
+	return 0;
+}
 
-	// Convert to 8-bit samples if needed.
-	uint8_t* src8 = NULL;
-	if (bytes_per_sample == 1) {
-		src8 = raw;
-	} else {
-		size_t src8_size = (size_t)height * (size_t)width * (size_t)src_channels;
-		uint8_t* tmp = (uint8_t*)malloc(src8_size);
-		if (!tmp) {
-			free(raw);
-			errno = ENOMEM;
-			return -1;
-		}
-		// PNG stores 16-bit samples big-endian; keep the MSB.
-		for (size_t i = 0; i < src8_size; ++i) tmp[i] = raw[i * 2u];
-		free(raw);
-		src8 = tmp;
-	}
-
-	// Expand to RGB/RGBA so downstream stays unchanged.
-	int dst_channels = (src_channels == 2 || src_channels == 4) ? 4 : 3;
-	size_t dst_stride = (size_t)width * (size_t)dst_channels;
-	uint8_t* pix = (uint8_t*)malloc((size_t)height * dst_stride);
-	if (!pix) {
-		free(src8);
-		errno = ENOMEM;
+static int image_row(void* user, uint32_t y, const uint8_t* row) {
+	EncPngImage* img = (EncPngImage*)user;
+	const size_t stride = (size_t)img->width * img->channels;
+	memcpy(img->data + (size_t)y * stride, row, stride);
+	return 0;
+}
+
+int enc_png_read_file(const char* path, EncPngImage* out_img) {
+	if (!out_img) return -1;
+	memset(out_img, 0, sizeof(*out_img));
+
+	const EncPngRowSink sink = {.begin = image_begin, .row = image_row, .user = out_img};
+	if (enc_png_read_rows(path, &sink) != 0) {
+		const int saved = errno;
+		enc_png_free(out_img);
+		errno = saved;
 		return -1;
 	}
-	if (src_channels == 3 || src_channels == 4) {
-		memcpy(pix, src8, (size_t)height * dst_stride);
-		free(src8);
-	} else if (src_channels == 1) {
-		for (uint32_t y = 0; y < height; ++y) {
-			const uint8_t* srow = src8 + (size_t)y * (size_t)width;
-			uint8_t* drow = pix + (size_t)y * dst_stride;
-			for (uint32_t x = 0; x < width; ++x) {
-				uint8_t g = srow[x];
-				drow[x * 3u + 0u] = g;
-				drow[x * 3u + 1u] = g;
-				drow[x * 3u + 2u] = g;
-			}
-		}
-		free(src8);
-	} else {
-		for (uint32_t y = 0; y < height; ++y) {
-			const uint8_t* srow = src8 + (size_t)y * (size_t)width * 2u;
-			uint8_t* drow = pix + (size_t)y * dst_stride;
-			for (uint32_t x = 0; x < width; ++x) {
-				uint8_t g = srow[x * 2u + 0u];
-				uint8_t a = srow[x * 2u + 1u];
-				drow[x * 4u + 0u] = g;
-				drow[x * 4u + 1u] = g;
-				drow[x * 4u + 2u] = g;
-				drow[x * 4u + 3u] = a;
-			}
-		}
-		free(src8);
-	}
-
-	out_img->width = width;
-	out_img->height = height;
-	out_img->channels = (uint8_t)dst_channels;
-	out_img->data = pix;
 	return 0;
 }
 
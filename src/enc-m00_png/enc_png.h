@@ -23,10 +23,32 @@ Supported subset (for Milestone 0):
 - non-interlaced
 - standard DEFLATE/zlib-compressed IDAT
 
+A path of "-" reads stdin (a pipe is read to EOF).
+
 Returns 0 on success, -1 on failure.
 */
 int enc_png_read_file(const char* path, EncPngImage* out_img);
 
+/*
+Row-streaming variant of enc_png_read_file(): the image is inflated and
+unfiltered one scanline at a time and never held in full.
+
+begin() is called once with the image size and output channels (3 = RGB,
+4 = RGBA); row() is then called for y = 0..height-1 with the row expanded to
+8-bit RGB/RGBA. A row pointer stays valid until the row() call after next, so a
+sink can pair rows y and y+1 without copying. A non-zero return from either
+callback stops decoding (its errno is kept).
+
+Returns 0 on success, -1 on failure (errno set).
+*/
+typedef struct EncPngRowSink {
+	int (*begin)(void* user, uint32_t width, uint32_t height, uint8_t channels);
+	int (*row)(void* user, uint32_t y, const uint8_t* row);
+	void* user;
+} EncPngRowSink;
+
+int enc_png_read_rows(const char* path, const EncPngRowSink* sink);
+
 void enc_png_free(EncPngImage* img);
 
 #ifdef __cplusplus
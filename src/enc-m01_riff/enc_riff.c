@@ -2,6 +2,7 @@
 
 #include <errno.h>
 #include <fcntl.h>
+#include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
 
@@ -16,7 +17,10 @@ static int write_all(int fd, const void* data, size_t n) {
 	const uint8_t* p = (const uint8_t*)data;
 	while (n) {
 		ssize_t w = write(fd, p, n);
-		if (w < 0) return -1;
+		if (w < 0) {
+			if (errno == EINTR) continue;
+			return -1;
+		}
 		if (w == 0) {
 			errno = EIO;
 			return -1;
@@ -27,38 +31,65 @@ static int write_all(int fd, const void* data, size_t n) {
 	return 0;
 }
 
-int enc_webp_write_vp8_file(const char* out_path, const uint8_t* vp8_payload, size_t vp8_size) {
-	if (!out_path) return -1;
-	if (vp8_size && !vp8_payload) return -1;
-
-	int fd = open(out_path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
-	if (fd < 0) return -1;
-
-	uint8_t hdr[12];
-	memcpy(hdr + 0, "RIFF", 4);
+// RIFF header + VP8 chunk header for a payload of vp8_size bytes.
+static int build_header(uint8_t hdr[20], size_t vp8_size) {
 	// RIFF size field is file_size - 8
 	const uint32_t pad = (uint32_t)(vp8_size & 1u);
 	const uint64_t file_size = 12ull + 8ull + (uint64_t)vp8_size + (uint64_t)pad;
 	if (file_size > 0xFFFFFFFFull) {
-		(void)close(fd);
 		errno = EOVERFLOW;
 		return -1;
 	}
+	memcpy(hdr + 0, "RIFF", 4);
 	le32_store(hdr + 4, (uint32_t)(file_size - 8ull));
 	memcpy(hdr + 8, "WEBP", 4);
+	memcpy(hdr + 12, "VP8 ", 4);
+	le32_store(hdr + 16, (uint32_t)vp8_size);
+	return 0;
+}
+
+int enc_webp_wrap_vp8(const uint8_t* vp8_payload, size_t vp8_size, uint8_t** out, size_t* out_size) {
+	if (!out || !out_size || (vp8_size && !vp8_payload)) {
+		errno = EINVAL;
+		return -1;
+	}
+	uint8_t hdr[20];
+	if (build_header(hdr, vp8_size) != 0) return -1;
+	const size_t total = sizeof(hdr) + vp8_size + (vp8_size & 1u);
+	uint8_t* buf = (uint8_t*)malloc(total);
+	if (!buf) {
+		errno = ENOMEM;
+		return -1;
+	}
+	memcpy(buf, hdr, sizeof(hdr));
+	if (vp8_size) memcpy(buf + sizeof(hdr), vp8_payload, vp8_size);
+	if (vp8_size & 1u) buf[total - 1] = 0;
+	*out = buf;
+	*out_size = total;
+	return 0;
+}
 
-	uint8_t chdr[8];
-	memcpy(chdr + 0, "VP8 ", 4);
-	le32_store(chdr + 4, (uint32_t)vp8_size);
+int enc_webp_write_vp8_file(const char* out_path, const uint8_t* vp8_payload, size_t vp8_size) {
+	if (!out_path) return -1;
+	if (vp8_size && !vp8_payload) return -1;
+
+	// RIFF header + VP8 chunk header, written together.
+	uint8_t hdr[20];
+	if (build_header(hdr, vp8_size) != 0) return -1;
+	const uint32_t pad = (uint32_t)(vp8_size & 1u);
+
+	// "-" is stdout (left open).
+	const int use_stdout = out_path[0] == '-' && out_path[1] == '\0';
+	int fd = use_stdout ? 1 : open(out_path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if (fd < 0) return -1;
 
 	int ok = 0;
 	if (write_all(fd, hdr, sizeof(hdr)) != 0) ok = -1;
-	if (ok == 0 && write_all(fd, chdr, sizeof(chdr)) != 0) ok = -1;
 	if (ok == 0 && vp8_size && write_all(fd, vp8_payload, vp8_size) != 0) ok = -1;
 	if (ok == 0 && pad) {
 		uint8_t z = 0;
 		if (write_all(fd, &z, 1) != 0) ok = -1;
 	}
-	if (close(fd) != 0) ok = -1;
+	if (!use_stdout && close(fd) != 0) ok = -1;
 	return ok;
 }
@@ -17,10 +17,19 @@ Layout:
 - VP8 payload
 - 0 pad byte if payload size is odd
 
+An out_path of "-" writes to stdout.
+
 Returns 0 on success, -1 on failure.
 */
 int enc_webp_write_vp8_file(const char* out_path, const uint8_t* vp8_payload, size_t vp8_size);
 
+/*
+Same container in memory: *out (malloc'd, caller frees) receives the file bytes.
+
+Returns 0 on success, -1 on failure (errno set).
+*/
+int enc_webp_wrap_vp8(const uint8_t* vp8_payload, size_t vp8_size, uint8_t** out, size_t* out_size);
+
 #ifdef __cplusplus
 }
 #endif
@@ -5,56 +5,9 @@
 #include <stdlib.h>
 #include <string.h>
 
-#include "enc_gamma_tables.h"
-
-enum {
-	YUV_FIX = 16,
-	YUV_HALF = 1 << (YUV_FIX - 1),
-};
-
-static inline uint32_t gamma_to_linear(uint8_t v) {
-	return enc_gamma_to_linear_tab[v];
-}
-
-static inline int interpolate(int v) {
-	const int scale = 1 << (ENC_GAMMA_TAB_FIX + 2);
-	const int tab_pos = v >> (ENC_GAMMA_TAB_FIX + 2);
-	const int x = v & (scale - 1);
-	if (tab_pos < 0) return 0;
-	if (tab_pos >= ENC_GAMMA_TAB_SIZE) return enc_linear_to_gamma_tab[ENC_GAMMA_TAB_SIZE] * scale;
-	const int v0 = enc_linear_to_gamma_tab[tab_pos];
-	const int v1 = enc_linear_to_gamma_tab[tab_pos + 1];
-	return v1 * x + v0 * (scale - x);
-}
-
-static inline int linear_to_gamma(uint32_t base_value, int shift) {
-	const int y = interpolate((int)(base_value << shift));
-	return (y + (1 << (ENC_GAMMA_TAB_FIX - 1))) >> ENC_GAMMA_TAB_FIX;
-}
-
-static inline int clip_u8(int v) {
-	return (v < 0) ? 0 : (v > 255) ? 255 : v;
-}
-
-static inline int vp8_clip_uv(int uv, int rounding) {
-	uv = (uv + rounding + (128 << (YUV_FIX + 2))) >> (YUV_FIX + 2);
-	return clip_u8(uv);
-}
-
-static inline int vp8_rgb_to_y(int r, int g, int b, int rounding) {
-	const int luma = 16839 * r + 33059 * g + 6420 * b;
-	return (luma + rounding + (16 << YUV_FIX)) >> YUV_FIX;
-}
-
-static inline int vp8_rgb_to_u(int r, int g, int b, int rounding) {
-	const int u = -9719 * r - 19081 * g + 28800 * b;
-	return vp8_clip_uv(u, rounding);
-}
-
-static inline int vp8_rgb_to_v(int r, int g, int b, int rounding) {
-	const int v = 28800 * r - 24116 * g - 4684 * b;
-	return vp8_clip_uv(v, rounding);
-}
+#include "../common/enc_dsp.h"
+#include "../common/threads.h"
+#include "../enc-m00_png/enc_png.h"
 
 static int alloc_planes(uint32_t width, uint32_t height, EncYuv420Image* out) {
 	const uint32_t uv_width = (width + 1u) >> 1;
@@ -96,6 +49,72 @@ static int alloc_planes(uint32_t width, uint32_t height, EncYuv420Image* out) {
 	return 0;
 }
 
+void enc_yuv420_convert_rows(EncYuv420Image* img,
+                             uint32_t y,
+                             const uint8_t* row0,
+                             const uint8_t* row1,
+                             uint32_t rgb_step) {
+	const EncDsp* dsp = enc_dsp();
+	const uint32_t width = img->width;
+	dsp->rgb_to_y_row(row0, img->y + (size_t)y * img->y_stride, width, rgb_step);
+	if (row1) dsp->rgb_to_y_row(row1, img->y + (size_t)(y + 1u) * img->y_stride, width, rgb_step);
+
+	// U/V row (4:2:0); an odd last row is replicated.
+	const size_t uv_off = (size_t)(y >> 1) * img->uv_stride;
+	dsp->rgb_to_uv_row(row0, row1 ? row1 : row0, img->u + uv_off, img->v + uv_off, width, rgb_step);
+}
+
+// Whole-image conversion of large images is split into bands of row pairs,
+// one per thread. Each band writes disjoint Y/U/V rows.
+enum {
+	YUV_MAX_THREADS = 8,
+	YUV_MIN_BAND_PIXELS = 1u << 19,
+};
+
+typedef struct {
+	EncYuv420Image* out;
+	const uint8_t* rgb;
+	uint32_t rgb_stride;
+	uint32_t rgb_step;
+	uint32_t y0; // even
+	uint32_t y1;
+} YuvBand;
+
+static void* convert_band(void* arg) {
+	const YuvBand* b = (const YuvBand*)arg;
+	for (uint32_t y = b->y0; y < b->y1; y += 2u) {
+		const uint8_t* row0 = b->rgb + (size_t)y * b->rgb_stride;
+		const uint8_t* row1 = (y + 1u < b->out->height) ? row0 + b->rgb_stride : NULL;
+		enc_yuv420_convert_rows(b->out, y, row0, row1, b->rgb_step);
+	}
+	return NULL;
+}
+
+static void convert_image(EncYuv420Image* out, const uint8_t* rgb, uint32_t rgb_stride, uint32_t rgb_step) {
+	const uint32_t pairs = (out->height + 1u) >> 1;
+	const uint64_t pixels = (uint64_t)out->width * out->height;
+	uint32_t bands = os_cpu_count();
+	if (bands > YUV_MAX_THREADS) bands = YUV_MAX_THREADS;
+	if ((uint64_t)bands * YUV_MIN_BAND_PIXELS > pixels) bands = (uint32_t)(pixels / YUV_MIN_BAND_PIXELS);
+	if (bands > pairs) bands = pairs;
+	if (bands < 1u) bands = 1u;
+
+	YuvBand band[YUV_MAX_THREADS];
+	for (uint32_t i = 0; i < bands; i++) {
+		band[i] = (YuvBand){out, rgb, rgb_stride, rgb_step, 2u * (uint32_t)((uint64_t)pairs * i / bands),
+		                    2u * (uint32_t)((uint64_t)pairs * (i + 1u) / bands)};
+	}
+	band[bands - 1u].y1 = out->height;
+
+	OsThread workers[YUV_MAX_THREADS];
+	uint32_t started = 0;
+	while (started + 1u < bands && os_thread_start(&workers[started], convert_band, &band[started + 1u]) == 0) started++;
+	// Bands whose thread did not start (none on nolibc) run here.
+	convert_band(&band[0]);
+	for (uint32_t i = started + 1u; i < bands; i++) convert_band(&band[i]);
+	for (uint32_t t = 0; t < started; t++) (void)os_thread_join(&workers[t]);
+}
+
 int enc_yuv420_from_rgb_libwebp(const uint8_t* rgb,
                                uint32_t width,
                                uint32_t height,
@@ -123,53 +142,51 @@ int enc_yuv420_from_rgb_libwebp(const uint8_t* rgb,
 
 	if (alloc_planes(width, height, out) != 0) return -1;
 
-	// Y plane.
-	for (uint32_t y = 0; y < height; y++) {
-		const uint8_t* row = rgb + (size_t)y * (size_t)rgb_stride;
-		uint8_t* dst_y = out->y + (size_t)y * (size_t)out->y_stride;
-		for (uint32_t x = 0; x < width; x++) {
-			const uint8_t* p = row + (size_t)x * (size_t)rgb_step;
-			dst_y[x] = (uint8_t)vp8_rgb_to_y((int)p[0], (int)p[1], (int)p[2], YUV_HALF);
-		}
+	convert_image(out, rgb, rgb_stride, rgb_step);
+	return 0;
+}
+
+// enc_yuv420_from_png_file(): converts each row pair as soon as the PNG reader
+// has produced its second row. Rows arrive one at a time, so this stays on the
+// calling thread.
+typedef struct PngYuvSink {
+	EncYuv420Image* out;
+	uint32_t step;
+	const uint8_t* pending; // even row waiting for its partner
+} PngYuvSink;
+
+static int png_yuv_begin(void* user, uint32_t width, uint32_t height, uint8_t channels) {
+	PngYuvSink* s = (PngYuvSink*)user;
+	s->step = channels;
+	return alloc_planes(width, height, s->out);
+}
+
+static int png_yuv_row(void* user, uint32_t y, const uint8_t* row) {
+	PngYuvSink* s = (PngYuvSink*)user;
+	if ((y & 1u) == 0) {
+		s->pending = row;
+		if (y + 1u == s->out->height) enc_yuv420_convert_rows(s->out, y, row, NULL, s->step);
+		return 0;
 	}
+	enc_yuv420_convert_rows(s->out, y - 1u, s->pending, row, s->step);
+	return 0;
+}
 
-	// U/V planes (4:2:0), with edge replication for odd sizes.
-	const uint32_t uv_width = out->uv_stride;
-	const uint32_t uv_height = (height + 1u) >> 1;
-	for (uint32_t uy = 0; uy < uv_height; uy++) {
-		const uint32_t y0 = 2u * uy;
-		const uint32_t y1 = (y0 + 1u < height) ? (y0 + 1u) : y0;
-		const uint8_t* row0 = rgb + (size_t)y0 * (size_t)rgb_stride;
-		const uint8_t* row1 = rgb + (size_t)y1 * (size_t)rgb_stride;
-
-		uint8_t* dst_u = out->u + (size_t)uy * (size_t)out->uv_stride;
-		uint8_t* dst_v = out->v + (size_t)uy * (size_t)out->uv_stride;
-
-		for (uint32_t ux = 0; ux < uv_width; ux++) {
-			const uint32_t x0 = 2u * ux;
-			const uint32_t x1 = (x0 + 1u < width) ? (x0 + 1u) : x0;
-
-			const uint8_t* p00 = row0 + (size_t)x0 * (size_t)rgb_step;
-			const uint8_t* p01 = row0 + (size_t)x1 * (size_t)rgb_step;
-			const uint8_t* p10 = row1 + (size_t)x0 * (size_t)rgb_step;
-			const uint8_t* p11 = row1 + (size_t)x1 * (size_t)rgb_step;
-
-			const uint32_t r_lin = gamma_to_linear(p00[0]) + gamma_to_linear(p01[0]) +
-			                   gamma_to_linear(p10[0]) + gamma_to_linear(p11[0]);
-			const uint32_t g_lin = gamma_to_linear(p00[1]) + gamma_to_linear(p01[1]) +
-			                   gamma_to_linear(p10[1]) + gamma_to_linear(p11[1]);
-			const uint32_t b_lin = gamma_to_linear(p00[2]) + gamma_to_linear(p01[2]) +
-			                   gamma_to_linear(p10[2]) + gamma_to_linear(p11[2]);
-
-			const int r_sum = linear_to_gamma(r_lin, 0);
-			const int g_sum = linear_to_gamma(g_lin, 0);
-			const int b_sum = linear_to_gamma(b_lin, 0);
-
-			dst_u[ux] = (uint8_t)vp8_rgb_to_u(r_sum, g_sum, b_sum, YUV_HALF << 2);
-			dst_v[ux] = (uint8_t)vp8_rgb_to_v(r_sum, g_sum, b_sum, YUV_HALF << 2);
-		}
+int enc_yuv420_from_png_file(const char* path, EncYuv420Image* out) {
+	if (!out) {
+		errno = EINVAL;
+		return -1;
 	}
+	memset(out, 0, sizeof(*out));
 
+	PngYuvSink s = {.out = out, .step = 0, .pending = NULL};
+	const EncPngRowSink sink = {.begin = png_yuv_begin, .row = png_yuv_row, .user = &s};
+	if (enc_png_read_rows(path, &sink) != 0) {
+		const int saved = errno;
+		enc_yuv420_free(out);
+		errno = saved;
+		return -1;
+	}
 	return 0;
 }
 
@@ -40,6 +40,27 @@ int enc_yuv420_from_rgb_libwebp(const uint8_t* rgb,
                                uint32_t rgb_step,
                                EncYuv420Image* out);
 
+/*
+Converts one row pair into an image laid out by enc_yuv420_from_rgb_libwebp():
+RGB(A) rows `y` (even) and `y + 1` become two Y rows and U/V row y / 2. Pass
+row1 = NULL for the last row of an odd-height image (it is replicated for
+chroma). Output is identical to converting the whole image at once.
+*/
+void enc_yuv420_convert_rows(EncYuv420Image* img,
+                             uint32_t y,
+                             const uint8_t* row0,
+                             const uint8_t* row1,
+                             uint32_t rgb_step);
+
+/*
+Decodes a PNG file (see enc_png_read_rows(); "-" is stdin) straight into
+YUV420: each row pair is converted as soon as it is unfiltered, so no full
+RGB(A) copy of the image is ever made.
+
+Returns 0 on success, -1 on failure (errno set).
+*/
+int enc_yuv420_from_png_file(const char* path, EncYuv420Image* out);
+
 void enc_yuv420_free(EncYuv420Image* img);
 
 #ifdef __cplusplus
@@ -1,5 +1,6 @@
 #include "enc_vp8_tokens.h"
 
+#include "../common/threads.h"
 #include "../enc-m02_vp8_bitwriter/enc_bool.h"
 #include "../enc-m04_yuv/enc_pad.h"
 
@@ -704,6 +705,158 @@ uint32_t enc_vp8_dry_run_keyframe_mb_token_bits_q8_probs(int ymode,
 	return bits_q8;
 }
 
+// --- Token cost tables (Q8 bits) ---
+
+// round(-log2(p / 256) * 256) for p = 1..255 (entry 0 is never used).
+static const uint16_t entropy_cost_q8[256] = {
+	2304, 2048, 1792, 1642, 1536, 1454, 1386, 1329, 1280, 1236, 1198, 1162, 1130, 1101, 1073, 1048,
+	1024, 1002,  980,  961,  942,  924,  906,  890,  874,  859,  845,  831,  817,  804,  792,  780,
+	 768,  757,  746,  735,  724,  714,  705,  695,  686,  676,  668,  659,  650,  642,  634,  626,
+	 618,  611,  603,  596,  589,  582,  575,  568,  561,  555,  548,  542,  536,  530,  524,  518,
+	 512,  506,  501,  495,  490,  484,  479,  474,  468,  463,  458,  453,  449,  444,  439,  434,
+	 430,  425,  420,  416,  412,  407,  403,  399,  394,  390,  386,  382,  378,  374,  370,  366,
+	 362,  358,  355,  351,  347,  343,  340,  336,  333,  329,  326,  322,  319,  315,  312,  309,
+	 305,  302,  299,  296,  292,  289,  286,  283,  280,  277,  274,  271,  268,  265,  262,  259,
+	 256,  253,  250,  247,  245,  242,  239,  236,  234,  231,  228,  226,  223,  220,  218,  215,
+	 212,  210,  207,  205,  202,  200,  197,  195,  193,  190,  188,  185,  183,  181,  178,  176,
+	 174,  171,  169,  167,  164,  162,  160,  158,  156,  153,  151,  149,  147,  145,  143,  140,
+	 138,  136,  134,  132,  130,  128,  126,  124,  122,  120,  118,  116,  114,  112,  110,  108,
+	 106,  104,  102,  101,   99,   97,   95,   93,   91,   89,   87,   86,   84,   82,   80,   78,
+	  77,   75,   73,   71,   70,   68,   66,   64,   63,   61,   59,   58,   56,   54,   53,   51,
+	  49,   48,   46,   44,   43,   41,   40,   38,   36,   35,   33,   32,   30,   28,   27,   25,
+	  24,   22,   21,   19,   18,   16,   15,   13,   12,   10,    9,    7,    6,    4,    3,    1,
+};
+
+static inline uint32_t bit_cost_q8(uint8_t prob, int bit) {
+	return entropy_cost_q8[bit ? (256u - prob) : prob];
+}
+
+static uint32_t exact_treed_cost_q8(const int8_t* tree, const uint8_t* probs, int start_node, int symbol) {
+	uint32_t cost = 0;
+	int node = start_node;
+	for (;;) {
+		const int8_t left = tree[node + 0];
+		const int go_right = (left <= 0) ? (-left != symbol) : !cost_tree_contains_symbol(tree, (int)left, symbol);
+		cost += bit_cost_q8(probs[(unsigned)node >> 1], go_right);
+		const int next = go_right ? (int)tree[node + 1] : (int)left;
+		if (next <= 0) return cost;
+		node = next;
+	}
+}
+
+static uint32_t exact_extra_cost_q8(const uint8_t* probs, uint32_t extra) {
+	uint32_t cost = 0;
+	int bits = 0;
+	for (const uint8_t* p = probs; *p; ++p) bits++;
+	for (int i = 0; i < bits; i++) cost += bit_cost_q8(probs[i], (int)((extra >> (uint32_t)(bits - 1 - i)) & 1u));
+	return cost;
+}
+
+void enc_vp8_token_costs_init(EncVp8TokenCosts* costs, const uint8_t coeff_probs[4][8][3][11]) {
+	const uint8_t (*tab)[8][3][num_dct_tokens - 1] = coeff_probs ? coeff_probs : default_coeff_probs;
+	// Extra bits use fixed probabilities: cost them once per level, then walk
+	// the tree once per token and context rather than once per level.
+	dct_token level_tok[ENC_VP8_COST_MAX_LEVEL + 1];
+	uint32_t level_extra[ENC_VP8_COST_MAX_LEVEL + 1];
+	for (int v = 0; v <= ENC_VP8_COST_MAX_LEVEL; v++) {
+		uint32_t extra = 0;
+		const uint8_t* extra_probs = NULL;
+		level_tok[v] = token_for_abs(v, &extra, &extra_probs);
+		// cat6 extra bits vary with the level: the walk adds them.
+		level_extra[v] = (level_tok[v] >= dct_cat1 && level_tok[v] <= dct_cat5) ? exact_extra_cost_q8(extra_probs, extra) : 0;
+		if (v != 0) level_extra[v] += 256u;
+	}
+	for (int plane = 0; plane < 4; plane++) {
+		for (int band = 0; band < 8; band++) {
+			for (int ctx = 0; ctx < 3; ctx++) {
+				const uint8_t* probs = tab[plane][band][ctx];
+				costs->eob[plane][band][ctx] = (uint16_t)bit_cost_q8(probs[0], 0);
+				costs->more[plane][band][ctx] = (uint16_t)bit_cost_q8(probs[0], 1);
+				uint32_t tok_cost[dct_eob];
+				for (int tok = DCT_0; tok < dct_eob; tok++) tok_cost[tok] = exact_treed_cost_q8(coeff_tree, probs, /*start_node=*/2, tok);
+				for (int v = 0; v <= ENC_VP8_COST_MAX_LEVEL; v++)
+					costs->level[plane][band][ctx][v] = (uint16_t)(tok_cost[level_tok[v]] + level_extra[v]);
+			}
+		}
+	}
+}
+
+static uint32_t table_block_cost_q8(const EncVp8TokenCosts* costs,
+				    int plane,
+				    int first_coeff,
+				    int ctx3,
+				    const int16_t block[16],
+				    uint8_t* out_has_coeffs) {
+	int last_nz = -1;
+	for (int i = 15; i >= first_coeff; i--) {
+		if (block[zigzag[i]] != 0) {
+			last_nz = i;
+			break;
+		}
+	}
+	if (out_has_coeffs) *out_has_coeffs = (uint8_t)(last_nz >= 0);
+	if (last_nz < 0) return costs->eob[plane][coeff_bands[first_coeff]][ctx3];
+
+	uint32_t cost = 0;
+	int prev_token_was_zero = 0;
+	for (int i = first_coeff; i <= last_nz; i++) {
+		const int band = (int)coeff_bands[i];
+		const int v = (int)block[zigzag[i]];
+		const int abs_value = (v < 0) ? -v : v;
+		if (!prev_token_was_zero) cost += costs->more[plane][band][ctx3];
+		if (abs_value < ENC_VP8_COST_MAX_LEVEL) {
+			cost += costs->level[plane][band][ctx3][abs_value];
+		} else {
+			uint32_t extra = 0;
+			const uint8_t* extra_probs = NULL;
+			(void)token_for_abs(abs_value, &extra, &extra_probs);
+			cost += costs->level[plane][band][ctx3][ENC_VP8_COST_MAX_LEVEL] + exact_extra_cost_q8(extra_probs, extra);
+		}
+		ctx3 = (abs_value > 2) ? 2 : abs_value;
+		prev_token_was_zero = (abs_value == 0);
+	}
+	if (last_nz < 15) cost += costs->eob[plane][coeff_bands[last_nz + 1]][ctx3];
+	return cost;
+}
+
+uint32_t enc_vp8_token_costs_block_q8(const EncVp8TokenCosts* costs,
+				      int coeff_plane,
+				      int first_coeff,
+				      uint8_t left_has,
+				      uint8_t above_has,
+				      const int16_t block[16],
+				      uint8_t* out_has_coeffs) {
+	if (coeff_plane < 0) coeff_plane = 0;
+	if (coeff_plane > 3) coeff_plane = 3;
+	if (first_coeff < 0) first_coeff = 0;
+	if (first_coeff > 15) first_coeff = 15;
+	return table_block_cost_q8(costs, coeff_plane, first_coeff, (int)left_has + (int)above_has, block, out_has_coeffs);
+}
+
+// Blocks of a w x w grid in raster order, contexts from inside the grid only.
+static uint32_t table_grid_cost_q8(const EncVp8TokenCosts* costs, int plane, int first_coeff, int w, const int16_t* blocks) {
+	uint8_t has[4][4] = {{0}};
+	uint32_t cost = 0;
+	for (int rr = 0; rr < w; rr++) {
+		for (int cc = 0; cc < w; cc++) {
+			const int ctx3 = (cc ? has[rr][cc - 1] : 0) + (rr ? has[rr - 1][cc] : 0);
+			cost += table_block_cost_q8(costs, plane, first_coeff, ctx3, blocks + (rr * w + cc) * 16, &has[rr][cc]);
+		}
+	}
+	return cost;
+}
+
+uint32_t enc_vp8_token_costs_mb_q8(const EncVp8TokenCosts* costs, int ymode, const int16_t* mb_coeffs) {
+	if (!mb_coeffs) return 0;
+	const int has_y2 = (ymode != (int)VP8_B_PRED);
+	uint32_t cost = 0;
+	if (has_y2) cost += table_block_cost_q8(costs, 1, 0, 0, mb_coeffs, NULL);
+	cost += table_grid_cost_q8(costs, has_y2 ? 0 : 3, has_y2 ? 1 : 0, 4, mb_coeffs + 16);
+	cost += table_grid_cost_q8(costs, 2, 0, 2, mb_coeffs + 16 + 16 * 16);
+	cost += table_grid_cost_q8(costs, 2, 0, 2, mb_coeffs + 16 + 16 * 16 + 4 * 16);
+	return cost;
+}
+
 // --- Coefficient probability adaptation (keyframes only) ---
 
 static void count_treed_path(uint32_t node_counts[num_dct_tokens - 1][2], const int8_t* tree, int start_node, int symbol) {
@@ -800,6 +953,7 @@ static void enc_part0_for_grid(EncBoolEncoder* e,
 							  const uint8_t* uv_modes,
 							  const uint8_t* b_modes,
 							  const EncVp8LoopFilterParams* lf,
+							  uint8_t log2_partitions,
 							  const uint8_t coeff_probs_override[4][8][3][num_dct_tokens - 1]) {
 	// Match decoder parse order in src/m05_tokens/vp8_tokens.c.
 	enc_bool_put(e, 128, 0);        // color_space
@@ -820,7 +974,7 @@ static void enc_part0_for_grid(EncBoolEncoder* e,
 		enc_bool_put(e, 128, 0); // update = 0
 	}
 
-	enc_bool_put_literal(e, 0, 2);  // log2_partitions = 0 => 1 token partition
+	enc_bool_put_literal(e, log2_partitions & 3u, 2);  // 1 << log2_partitions token partitions
 
 	enc_bool_put_literal(e, (uint32_t)(q_index & 127u), 7);  // q_index
 	enc_write_q_delta(e, y1_dc_delta_q);
@@ -912,7 +1066,30 @@ static void enc_part0_for_grid(EncBoolEncoder* e,
 	free(above_bmodes);
 }
 
-static void enc_tokens_for_grid(EncBoolEncoder* e,
+// enc_block()'s return value without writing anything: whether the block has
+// a non-zero coefficient, i.e. the context it leaves for its neighbours.
+static int block_has_coeffs(int first_coeff, const int16_t block[16]) {
+	for (int i = first_coeff; i < 16; i++) {
+		if (block[zigzag[i]] != 0) return 1;
+	}
+	return 0;
+}
+
+static int code_block(EncBoolEncoder* e,
+                      const uint8_t coeff_probs_plane[8][3][num_dct_tokens - 1],
+                      int first_coeff,
+                      uint8_t left_has,
+                      uint8_t above_has,
+                      const int16_t block[16]) {
+	if (!e) return block_has_coeffs(first_coeff, block);
+	return enc_block(e, coeff_probs_plane, first_coeff, left_has, above_has, block);
+}
+
+// Writes macroblock row r into parts[r % num_parts] (num_parts is 1, 2, 4 or
+// 8). Rows whose partition is NULL are only walked for their non-zero
+// contexts, which carry across partitions.
+static void enc_tokens_for_grid(EncBoolEncoder* const parts[],
+							uint32_t num_parts,
 							uint32_t mb_cols,
 							uint32_t mb_rows,
 							const uint8_t* y_modes,
@@ -934,13 +1111,16 @@ static void enc_tokens_for_grid(EncBoolEncoder* e,
 		free(above_u);
 		free(above_v);
 		free(above_y2);
-		e->error = 1;
+		for (uint32_t p = 0; p < num_parts; p++) {
+			if (parts[p]) parts[p]->error = 1;
+		}
 		return;
 	}
 
 	const size_t coeffs_per_mb = 16 + (16 * 16) + (4 * 16) + (4 * 16);
 
 	for (uint32_t mb_r = 0; mb_r < mb_rows; mb_r++) {
+		EncBoolEncoder* e = parts[mb_r & (num_parts - 1u)];
 		left_y[0] = left_y[1] = left_y[2] = left_y[3] = 0;
 		left_u[0] = left_u[1] = 0;
 		left_v[0] = left_v[1] = 0;
@@ -973,7 +1153,7 @@ static void enc_tokens_for_grid(EncBoolEncoder* e,
 			if (has_y2) {
 				uint8_t left_has = left_y2_flag;
 				uint8_t above_has = above_y2[mb_c];
-				int has = enc_block(e, coeff_probs[1], 0, left_has, above_has, mb);
+				int has = code_block(e, coeff_probs[1], 0, left_has, above_has, mb);
 				above_y2[mb_c] = (uint8_t)has;
 				left_y2_flag = (uint8_t)has;
 			} else {
@@ -994,7 +1174,7 @@ static void enc_tokens_for_grid(EncBoolEncoder* e,
 				for (int cc = 0; cc < 4; cc++) {
 					uint8_t left_has = (cc == 0) ? left_y[rr] : y_has[rr][cc - 1];
 					uint8_t above_has = (rr == 0) ? above_y[mb_c * 4u + (uint32_t)cc] : y_has[rr - 1][cc];
-					int has = enc_block(e, coeff_probs[y_plane], first_coeff, left_has, above_has, y + (rr * 4 + cc) * 16);
+					int has = code_block(e, coeff_probs[y_plane], first_coeff, left_has, above_has, y + (rr * 4 + cc) * 16);
 					y_has[rr][cc] = (uint8_t)has;
 				}
 			}
@@ -1008,7 +1188,7 @@ static void enc_tokens_for_grid(EncBoolEncoder* e,
 				for (int cc = 0; cc < 2; cc++) {
 					uint8_t left_has = (cc == 0) ? left_u[rr] : u_has[rr][cc - 1];
 					uint8_t above_has = (rr == 0) ? above_u[mb_c * 2u + (uint32_t)cc] : u_has[rr - 1][cc];
-					int has = enc_block(e, coeff_probs[2], 0, left_has, above_has, u + (rr * 2 + cc) * 16);
+					int has = code_block(e, coeff_probs[2], 0, left_has, above_has, u + (rr * 2 + cc) * 16);
 					u_has[rr][cc] = (uint8_t)has;
 				}
 			}
@@ -1022,7 +1202,7 @@ static void enc_tokens_for_grid(EncBoolEncoder* e,
 				for (int cc = 0; cc < 2; cc++) {
 					uint8_t left_has = (cc == 0) ? left_v[rr] : v_has[rr][cc - 1];
 					uint8_t above_has = (rr == 0) ? above_v[mb_c * 2u + (uint32_t)cc] : v_has[rr - 1][cc];
-					int has = enc_block(e, coeff_probs[2], 0, left_has, above_has, v + (rr * 2 + cc) * 16);
+					int has = code_block(e, coeff_probs[2], 0, left_has, above_has, v + (rr * 2 + cc) * 16);
 					v_has[rr][cc] = (uint8_t)has;
 				}
 			}
@@ -1037,36 +1217,43 @@ static void enc_tokens_for_grid(EncBoolEncoder* e,
 	free(above_y2);
 }
 
-void enc_vp8_compute_adaptive_coeff_probs(uint8_t out_probs[4][8][3][num_dct_tokens - 1],
-							  uint32_t mb_cols,
-							  uint32_t mb_rows,
-							  const uint8_t* y_modes,
-							  const int16_t* coeffs) {
-	memcpy(out_probs, default_coeff_probs, sizeof(default_coeff_probs));
+int enc_vp8_coeff_counts_init(EncVp8CoeffCounts* c, uint32_t mb_cols) {
+	memset(c, 0, sizeof(*c));
+	c->above = (uint8_t*)calloc((size_t)mb_cols * 9u, 1);
+	if (!c->above) {
+		errno = ENOMEM;
+		return -1;
+	}
+	c->mb_cols = mb_cols;
+	return 0;
+}
 
-	uint32_t counts[4][8][3][num_dct_tokens - 1][2];
-	memset(counts, 0, sizeof(counts));
+void enc_vp8_coeff_counts_free(EncVp8CoeffCounts* c) {
+	free(c->above);
+	c->above = NULL;
+}
 
-	uint8_t* above_y = (uint8_t*)calloc((size_t)mb_cols * 4u, 1);
-	uint8_t* above_u = (uint8_t*)calloc((size_t)mb_cols * 2u, 1);
-	uint8_t* above_v = (uint8_t*)calloc((size_t)mb_cols * 2u, 1);
-	uint8_t* above_y2 = (uint8_t*)calloc((size_t)mb_cols, 1);
+void enc_vp8_coeff_counts_add_rows(EncVp8CoeffCounts* c,
+                                   uint32_t row_begin,
+                                   uint32_t row_end,
+                                   const uint8_t* y_modes,
+                                   const int16_t* coeffs) {
+	const uint32_t mb_cols = c->mb_cols;
+	// The contexts of the row above are only known when it was the last one added.
+	if (row_begin != c->next_row) memset(c->above, 0, (size_t)mb_cols * 9u);
+	c->next_row = row_end;
+	uint8_t* above_y = c->above;
+	uint8_t* above_u = above_y + (size_t)mb_cols * 4u;
+	uint8_t* above_v = above_u + (size_t)mb_cols * 2u;
+	uint8_t* above_y2 = above_v + (size_t)mb_cols * 2u;
 	uint8_t left_y[4] = {0, 0, 0, 0};
 	uint8_t left_u[2] = {0, 0};
 	uint8_t left_v[2] = {0, 0};
 	uint8_t left_y2_flag = 0;
 
-	if (!above_y || !above_u || !above_v || !above_y2) {
-		free(above_y);
-		free(above_u);
-		free(above_v);
-		free(above_y2);
-		return;
-	}
-
 	const size_t coeffs_per_mb = 16 + (16 * 16) + (4 * 16) + (4 * 16);
 
-	for (uint32_t mb_r = 0; mb_r < mb_rows; mb_r++) {
+	for (uint32_t mb_r = row_begin; mb_r < row_end; mb_r++) {
 		left_y[0] = left_y[1] = left_y[2] = left_y[3] = 0;
 		left_u[0] = left_u[1] = 0;
 		left_v[0] = left_v[1] = 0;
@@ -1083,7 +1270,7 @@ void enc_vp8_compute_adaptive_coeff_probs(uint8_t out_probs[4][8][3][num_dct_tok
 			if (has_y2) {
 				uint8_t left_has = left_y2_flag;
 				uint8_t above_has = above_y2[mb_c];
-				int has = count_block_coeff_prob_branches(counts, 1, 0, left_has, above_has, mb);
+				int has = count_block_coeff_prob_branches(c->counts, 1, 0, left_has, above_has, mb);
 				above_y2[mb_c] = (uint8_t)has;
 				left_y2_flag = (uint8_t)has;
 			} else {
@@ -1103,7 +1290,7 @@ void enc_vp8_compute_adaptive_coeff_probs(uint8_t out_probs[4][8][3][num_dct_tok
 					uint8_t left_has = (cc == 0) ? left_y[rr] : y_has[rr][cc - 1];
 					uint8_t above_has = (rr == 0) ? above_y[mb_c * 4u + (uint32_t)cc] : y_has[rr - 1][cc];
 					int has = count_block_coeff_prob_branches(
-					    counts, y_plane, first_coeff, left_has, above_has, y + (rr * 4 + cc) * 16);
+					    c->counts, y_plane, first_coeff, left_has, above_has, y + (rr * 4 + cc) * 16);
 					y_has[rr][cc] = (uint8_t)has;
 				}
 			}
@@ -1117,7 +1304,7 @@ void enc_vp8_compute_adaptive_coeff_probs(uint8_t out_probs[4][8][3][num_dct_tok
 				for (int cc = 0; cc < 2; cc++) {
 					uint8_t left_has = (cc == 0) ? left_u[rr] : u_has[rr][cc - 1];
 					uint8_t above_has = (rr == 0) ? above_u[mb_c * 2u + (uint32_t)cc] : u_has[rr - 1][cc];
-					int has = count_block_coeff_prob_branches(counts, 2, 0, left_has, above_has, u + (rr * 2 + cc) * 16);
+					int has = count_block_coeff_prob_branches(c->counts, 2, 0, left_has, above_has, u + (rr * 2 + cc) * 16);
 					u_has[rr][cc] = (uint8_t)has;
 				}
 			}
@@ -1131,7 +1318,7 @@ void enc_vp8_compute_adaptive_coeff_probs(uint8_t out_probs[4][8][3][num_dct_tok
 				for (int cc = 0; cc < 2; cc++) {
 					uint8_t left_has = (cc == 0) ? left_v[rr] : v_has[rr][cc - 1];
 					uint8_t above_has = (rr == 0) ? above_v[mb_c * 2u + (uint32_t)cc] : v_has[rr - 1][cc];
-					int has = count_block_coeff_prob_branches(counts, 2, 0, left_has, above_has, v + (rr * 2 + cc) * 16);
+					int has = count_block_coeff_prob_branches(c->counts, 2, 0, left_has, above_has, v + (rr * 2 + cc) * 16);
 					v_has[rr][cc] = (uint8_t)has;
 				}
 			}
@@ -1139,12 +1326,30 @@ void enc_vp8_compute_adaptive_coeff_probs(uint8_t out_probs[4][8][3][num_dct_tok
 			for (int rr = 0; rr < 2; rr++) left_v[rr] = v_has[rr][1];
 		}
 	}
+}
 
-	free(above_y);
-	free(above_u);
-	free(above_v);
-	free(above_y2);
+static uint32_t adaptive2_prior_strength(int coeff_plane, int band, int ctx3) {
+	// Deterministic, simple prior schedule:
+	// - higher prior for higher bands (sparser statistics)
+	// - slightly higher prior for chroma/Y2 planes
+	// - slightly higher prior for larger contexts
+	uint32_t base = 16;
+	if (band >= 6) base = 96;
+	else if (band >= 3) base = 48;
+	base += (uint32_t)ctx3 * 16u;
+	if (coeff_plane == 2) base += 16u; // chroma
+	if (coeff_plane == 1) base += 16u; // Y2
+	return base;
+}
 
+static uint32_t adaptive2_min_total(int band) {
+	if (band >= 6) return 32;
+	if (band >= 3) return 16;
+	return 8;
+}
+
+static void adaptive_probs_from_counts(uint8_t out_probs[4][8][3][num_dct_tokens - 1],
+                                       const uint32_t counts[4][8][3][num_dct_tokens - 1][2]) {
 	// Decide updates per probability (net savings vs update signaling cost).
 	// No hard minimum sample count: rely on the signaling-overhead cost check
 	// (plus smoothing prior) to decide if an update is worth it.
@@ -1207,134 +1412,8 @@ void enc_vp8_compute_adaptive_coeff_probs(uint8_t out_probs[4][8][3][num_dct_tok
 	}
 }
 
-static uint32_t adaptive2_prior_strength(int coeff_plane, int band, int ctx3) {
-	// Deterministic, simple prior schedule:
-	// - higher prior for higher bands (sparser statistics)
-	// - slightly higher prior for chroma/Y2 planes
-	// - slightly higher prior for larger contexts
-	uint32_t base = 16;
-	if (band >= 6) base = 96;
-	else if (band >= 3) base = 48;
-	base += (uint32_t)ctx3 * 16u;
-	if (coeff_plane == 2) base += 16u; // chroma
-	if (coeff_plane == 1) base += 16u; // Y2
-	return base;
-}
-
-static uint32_t adaptive2_min_total(int band) {
-	if (band >= 6) return 32;
-	if (band >= 3) return 16;
-	return 8;
-}
-
-void enc_vp8_compute_adaptive_coeff_probs2(uint8_t out_probs[4][8][3][num_dct_tokens - 1],
-							   uint32_t mb_cols,
-							   uint32_t mb_rows,
-							   const uint8_t* y_modes,
-							   const int16_t* coeffs) {
-	memcpy(out_probs, default_coeff_probs, sizeof(default_coeff_probs));
-
-	uint32_t counts[4][8][3][num_dct_tokens - 1][2];
-	memset(counts, 0, sizeof(counts));
-
-	uint8_t* above_y = (uint8_t*)calloc((size_t)mb_cols * 4u, 1);
-	uint8_t* above_u = (uint8_t*)calloc((size_t)mb_cols * 2u, 1);
-	uint8_t* above_v = (uint8_t*)calloc((size_t)mb_cols * 2u, 1);
-	uint8_t* above_y2 = (uint8_t*)calloc((size_t)mb_cols, 1);
-	uint8_t left_y[4] = {0, 0, 0, 0};
-	uint8_t left_u[2] = {0, 0};
-	uint8_t left_v[2] = {0, 0};
-	uint8_t left_y2_flag = 0;
-
-	if (!above_y || !above_u || !above_v || !above_y2) {
-		free(above_y);
-		free(above_u);
-		free(above_v);
-		free(above_y2);
-		return;
-	}
-
-	const size_t coeffs_per_mb = 16 + (16 * 16) + (4 * 16) + (4 * 16);
-
-	for (uint32_t mb_r = 0; mb_r < mb_rows; mb_r++) {
-		left_y[0] = left_y[1] = left_y[2] = left_y[3] = 0;
-		left_u[0] = left_u[1] = 0;
-		left_v[0] = left_v[1] = 0;
-		left_y2_flag = 0;
-
-		for (uint32_t mb_c = 0; mb_c < mb_cols; mb_c++) {
-			const size_t mb_index = (size_t)mb_r * (size_t)mb_cols + (size_t)mb_c;
-			const int16_t* mb = coeffs + mb_index * coeffs_per_mb;
-
-			int ymode = y_modes ? (int)y_modes[mb_index] : 0;
-			int has_y2 = (ymode != (int)VP8_B_PRED);
-
-			// Y2
-			if (has_y2) {
-				uint8_t left_has = left_y2_flag;
-				uint8_t above_has = above_y2[mb_c];
-				int has = count_block_coeff_prob_branches(counts, 1, 0, left_has, above_has, mb);
-				above_y2[mb_c] = (uint8_t)has;
-				left_y2_flag = (uint8_t)has;
-			} else {
-				// No Y2 coded (B_PRED): keep Y2 contexts unchanged.
-			}
-
-			// Y blocks.
-			uint8_t y_has[4][4];
-			for (int rr = 0; rr < 4; rr++) for (int cc = 0; cc < 4; cc++) y_has[rr][cc] = 0;
-
-			const int y_plane = has_y2 ? 0 : 3;
-			const int first_coeff = has_y2 ? 1 : 0;
-
-			const int16_t* y = mb + 16;
-			for (int rr = 0; rr < 4; rr++) {
-				for (int cc = 0; cc < 4; cc++) {
-					uint8_t left_has = (cc == 0) ? left_y[rr] : y_has[rr][cc - 1];
-					uint8_t above_has = (rr == 0) ? above_y[mb_c * 4u + (uint32_t)cc] : y_has[rr - 1][cc];
-					int has = count_block_coeff_prob_branches(
-					    counts, y_plane, first_coeff, left_has, above_has, y + (rr * 4 + cc) * 16);
-					y_has[rr][cc] = (uint8_t)has;
-				}
-			}
-			for (int cc = 0; cc < 4; cc++) above_y[mb_c * 4u + (uint32_t)cc] = y_has[3][cc];
-			for (int rr = 0; rr < 4; rr++) left_y[rr] = y_has[rr][3];
-
-			// U blocks (2x2)
-			uint8_t u_has[2][2] = {{0, 0}, {0, 0}};
-			const int16_t* u = y + (16 * 16);
-			for (int rr = 0; rr < 2; rr++) {
-				for (int cc = 0; cc < 2; cc++) {
-					uint8_t left_has = (cc == 0) ? left_u[rr] : u_has[rr][cc - 1];
-					uint8_t above_has = (rr == 0) ? above_u[mb_c * 2u + (uint32_t)cc] : u_has[rr - 1][cc];
-					int has = count_block_coeff_prob_branches(counts, 2, 0, left_has, above_has, u + (rr * 2 + cc) * 16);
-					u_has[rr][cc] = (uint8_t)has;
-				}
-			}
-			for (int cc = 0; cc < 2; cc++) above_u[mb_c * 2u + (uint32_t)cc] = u_has[1][cc];
-			for (int rr = 0; rr < 2; rr++) left_u[rr] = u_has[rr][1];
-
-			// V blocks (2x2)
-			uint8_t v_has[2][2] = {{0, 0}, {0, 0}};
-			const int16_t* v = u + (4 * 16);
-			for (int rr = 0; rr < 2; rr++) {
-				for (int cc = 0; cc < 2; cc++) {
-					uint8_t left_has = (cc == 0) ? left_v[rr] : v_has[rr][cc - 1];
-					uint8_t above_has = (rr == 0) ? above_v[mb_c * 2u + (uint32_t)cc] : v_has[rr - 1][cc];
-					int has = count_block_coeff_prob_branches(counts, 2, 0, left_has, above_has, v + (rr * 2 + cc) * 16);
-					v_has[rr][cc] = (uint8_t)has;
-				}
-			}
-			for (int cc = 0; cc < 2; cc++) above_v[mb_c * 2u + (uint32_t)cc] = v_has[1][cc];
-			for (int rr = 0; rr < 2; rr++) left_v[rr] = v_has[rr][1];
-		}
-	}
-
-	free(above_y);
-	free(above_u);
-	free(above_v);
-	free(above_y2);
-
+static void adaptive2_probs_from_counts(uint8_t out_probs[4][8][3][num_dct_tokens - 1],
+                                        const uint32_t counts[4][8][3][num_dct_tokens - 1][2]) {
 	for (int i = 0; i < 4; i++) {
 		for (int j = 0; j < 8; j++) {
 			for (int k = 0; k < 3; k++) {
@@ -1374,6 +1453,193 @@ void enc_vp8_compute_adaptive_coeff_probs2(uint8_t out_probs[4][8][3][num_dct_to
 	}
 }
 
+void enc_vp8_coeff_probs_from_counts(uint8_t out_probs[4][8][3][num_dct_tokens - 1],
+                                     const EncVp8CoeffCounts* c,
+                                     EncVp8TokenProbsMode mode) {
+	memcpy(out_probs, default_coeff_probs, sizeof(default_coeff_probs));
+	// C11 does not convert uint32_t(*)[..] to const uint32_t(*)[..] implicitly.
+	const uint32_t(*counts)[8][3][num_dct_tokens - 1][2] = (const uint32_t(*)[8][3][num_dct_tokens - 1][2])c->counts;
+	if (mode == ENC_VP8_TOKEN_PROBS_ADAPTIVE) adaptive_probs_from_counts(out_probs, counts);
+	if (mode == ENC_VP8_TOKEN_PROBS_ADAPTIVE2) adaptive2_probs_from_counts(out_probs, counts);
+}
+
+// Whole-grid walks; on allocation failure the defaults are returned.
+static void compute_adaptive_coeff_probs_mode(uint8_t out_probs[4][8][3][num_dct_tokens - 1],
+                                              uint32_t mb_cols,
+                                              uint32_t mb_rows,
+                                              const uint8_t* y_modes,
+                                              const int16_t* coeffs,
+                                              EncVp8TokenProbsMode mode) {
+	EncVp8CoeffCounts c;
+	if (enc_vp8_coeff_counts_init(&c, mb_cols) != 0) {
+		memcpy(out_probs, default_coeff_probs, sizeof(default_coeff_probs));
+		return;
+	}
+	enc_vp8_coeff_counts_add_rows(&c, 0, mb_rows, y_modes, coeffs);
+	enc_vp8_coeff_probs_from_counts(out_probs, &c, mode);
+	enc_vp8_coeff_counts_free(&c);
+}
+
+void enc_vp8_compute_adaptive_coeff_probs(uint8_t out_probs[4][8][3][num_dct_tokens - 1],
+							  uint32_t mb_cols,
+							  uint32_t mb_rows,
+							  const uint8_t* y_modes,
+							  const int16_t* coeffs) {
+	compute_adaptive_coeff_probs_mode(out_probs, mb_cols, mb_rows, y_modes, coeffs, ENC_VP8_TOKEN_PROBS_ADAPTIVE);
+}
+
+void enc_vp8_compute_adaptive_coeff_probs2(uint8_t out_probs[4][8][3][num_dct_tokens - 1],
+							   uint32_t mb_cols,
+							   uint32_t mb_rows,
+							   const uint8_t* y_modes,
+							   const int16_t* coeffs) {
+	compute_adaptive_coeff_probs_mode(out_probs, mb_cols, mb_rows, y_modes, coeffs, ENC_VP8_TOKEN_PROBS_ADAPTIVE2);
+}
+
+// --- Token partitions and frame assembly ---
+
+// log2 of a token partition count of 1, 2, 4 or 8 (RFC 6386 9.5); -1 with
+// errno=EINVAL for any other count.
+static int log2_token_partitions(uint32_t count) {
+	int log2 = 0;
+	while (log2 < 3 && (1u << log2) < count) log2++;
+	if ((1u << log2) != count) {
+		errno = EINVAL;
+		return -1;
+	}
+	return log2;
+}
+
+// One token partition writer: walks the whole grid, codes the rows of
+// partition `index` into `part` and finishes it.
+typedef struct {
+	EncBoolEncoder* part;
+	uint32_t index;
+	uint32_t count;
+	uint32_t mb_cols;
+	uint32_t mb_rows;
+	const uint8_t* y_modes;
+	const int16_t* coeffs;
+	const uint8_t (*coeff_probs)[8][3][num_dct_tokens - 1];
+	const uint8_t* mb_skip_coeff;
+} EncTokenPartitionJob;
+
+static void* token_partition_worker(void* arg) {
+	const EncTokenPartitionJob* job = (const EncTokenPartitionJob*)arg;
+	EncBoolEncoder* parts[8] = {NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL};
+	parts[job->index] = job->part;
+	enc_tokens_for_grid(parts,
+	                    job->count,
+	                    job->mb_cols,
+	                    job->mb_rows,
+	                    job->y_modes,
+	                    job->coeffs,
+	                    job->coeff_probs,
+	                    job->mb_skip_coeff);
+	enc_bool_finish(job->part);
+	return NULL;
+}
+
+// B_PRED macroblocks have no Y2 block, so the writers never code one; a
+// non-zero Y2 there is stale caller data, and it would still keep the
+// macroblock from being skipped under --mb-skip.
+static int bpred_y2_is_zero(const uint8_t* y_modes, const int16_t* coeffs, uint32_t mb_total, size_t coeffs_per_mb) {
+	if (!y_modes) return 1;
+	for (uint32_t mb_i = 0; mb_i < mb_total; mb_i++) {
+		if (y_modes[mb_i] != 4) continue;
+		const int16_t* y2 = coeffs + (size_t)mb_i * coeffs_per_mb;
+		for (int i = 0; i < 16; i++) {
+			if (y2[i] != 0) return 0;
+		}
+	}
+	return 1;
+}
+
+// Writes the frame tag and key frame header, partition 0, the partition size
+// table (3-byte little-endian sizes of all but the last token partition) and
+// the token partitions. Once modes and coefficients are known the partitions
+// are independent, so each extra one is written on its own thread; without
+// threads they are written inline.
+static int enc_assemble_keyframe(uint32_t width,
+                                 uint32_t height,
+                                 const EncBoolEncoder* p0,
+                                 uint8_t log2_partitions,
+                                 uint32_t mb_cols,
+                                 uint32_t mb_rows,
+                                 const uint8_t* y_modes,
+                                 const int16_t* coeffs,
+                                 const uint8_t coeff_probs_override[4][8][3][num_dct_tokens - 1],
+                                 const uint8_t* mb_skip_coeff,
+                                 uint8_t** out_payload,
+                                 size_t* out_size) {
+	const uint32_t count = 1u << log2_partitions;
+	EncBoolEncoder parts[8];
+	EncTokenPartitionJob jobs[8];
+	OsThread threads[8];
+	int started[8] = {0, 0, 0, 0, 0, 0, 0, 0};
+	for (uint32_t p = 0; p < count; p++) {
+		enc_bool_init(&parts[p]);
+		jobs[p] = (EncTokenPartitionJob){
+		    .part = &parts[p],
+		    .index = p,
+		    .count = count,
+		    .mb_cols = mb_cols,
+		    .mb_rows = mb_rows,
+		    .y_modes = y_modes,
+		    .coeffs = coeffs,
+		    .coeff_probs = coeff_probs_override,
+		    .mb_skip_coeff = mb_skip_coeff,
+		};
+	}
+	for (uint32_t p = 1; p < count; p++) started[p] = os_thread_start(&threads[p], token_partition_worker, &jobs[p]) == 0;
+	for (uint32_t p = 0; p < count; p++) {
+		if (!started[p]) (void)token_partition_worker(&jobs[p]);
+	}
+	for (uint32_t p = 1; p < count; p++) {
+		if (started[p]) (void)os_thread_join(&threads[p]);
+	}
+
+	const size_t uncompressed = 10;
+	const size_t p0_size = enc_bool_size(p0);
+	size_t total = uncompressed + p0_size + (size_t)(count - 1u) * 3u;
+	int rc = 0;
+	for (uint32_t p = 0; p < count; p++) {
+		if (enc_bool_error(&parts[p]) || (p + 1u < count && enc_bool_size(&parts[p]) > 0xFFFFFFu)) {
+			errno = EINVAL;
+			rc = -1;
+		}
+		total += enc_bool_size(&parts[p]);
+	}
+	uint8_t* buf = NULL;
+	if (rc == 0) {
+		buf = (uint8_t*)malloc(total);
+		if (!buf) {
+			errno = ENOMEM;
+			rc = -1;
+		}
+	}
+	if (rc == 0) {
+		write_vp8_frame_tag(&buf[0], (uint32_t)p0_size);
+		write_keyframe_start_code_and_dims(&buf[3], (uint16_t)width, (uint16_t)height);
+		memcpy(&buf[uncompressed], enc_bool_data(p0), p0_size);
+		size_t off = uncompressed + p0_size;
+		for (uint32_t p = 0; p + 1u < count; p++) {
+			const size_t size = enc_bool_size(&parts[p]);
+			buf[off++] = (uint8_t)size;
+			buf[off++] = (uint8_t)(size >> 8);
+			buf[off++] = (uint8_t)(size >> 16);
+		}
+		for (uint32_t p = 0; p < count; p++) {
+			memcpy(&buf[off], enc_bool_data(&parts[p]), enc_bool_size(&parts[p]));
+			off += enc_bool_size(&parts[p]);
+		}
+		*out_payload = buf;
+		*out_size = total;
+	}
+	for (uint32_t p = 0; p < count; p++) enc_bool_free(&parts[p]);
+	return rc;
+}
+
 int enc_vp8_build_keyframe_dc_coeffs(uint32_t width,
 								uint32_t height,
 								uint8_t q_index,
@@ -1395,6 +1661,7 @@ int enc_vp8_build_keyframe_dc_coeffs(uint32_t width,
 											uv_dc_delta_q,
 											uv_ac_delta_q,
 											/*lf=*/NULL,
+											/*token_partitions=*/1,
 											coeffs,
 											coeffs_count,
 											out_payload,
@@ -1410,6 +1677,7 @@ int enc_vp8_build_keyframe_dc_coeffs_ex(uint32_t width,
 								   int8_t uv_dc_delta_q,
 								   int8_t uv_ac_delta_q,
 								   const EncVp8LoopFilterParams* lf,
+								   uint32_t token_partitions,
 								   const int16_t* coeffs,
 								   size_t coeffs_count,
 								   uint8_t** out_payload,
@@ -1425,6 +1693,7 @@ int enc_vp8_build_keyframe_dc_coeffs_ex(uint32_t width,
 											/*y_modes=*/NULL,
 											/*uv_modes=*/NULL,
 											lf,
+											token_partitions,
 											coeffs,
 											coeffs_count,
 											out_payload,
@@ -1456,6 +1725,7 @@ int enc_vp8_build_keyframe_i16_coeffs(uint32_t width,
 											y_modes,
 											uv_modes,
 											/*lf=*/NULL,
+											/*token_partitions=*/1,
 											coeffs,
 											coeffs_count,
 											out_payload,
@@ -1473,6 +1743,7 @@ int enc_vp8_build_keyframe_i16_coeffs_ex(uint32_t width,
 									const uint8_t* y_modes,
 									const uint8_t* uv_modes,
 									const EncVp8LoopFilterParams* lf,
+									uint32_t token_partitions,
 									const int16_t* coeffs,
 									size_t coeffs_count,
 									uint8_t** out_payload,
@@ -1490,6 +1761,7 @@ int enc_vp8_build_keyframe_i16_coeffs_ex(uint32_t width,
 												uv_modes,
 												/*b_modes=*/NULL,
 												lf,
+												token_partitions,
 												coeffs,
 												coeffs_count,
 												out_payload,
@@ -1524,6 +1796,7 @@ int enc_vp8_build_keyframe_intra_coeffs(uint32_t width,
 											uv_modes,
 											b_modes,
 											/*lf=*/NULL,
+											/*token_partitions=*/1,
 											coeffs,
 											coeffs_count,
 											out_payload,
@@ -1543,6 +1816,7 @@ int enc_vp8_build_keyframe_intra_coeffs_ex(uint32_t width,
 									  const uint8_t* uv_modes,
 									  const uint8_t* b_modes,
 									  const EncVp8LoopFilterParams* lf,
+									  uint32_t token_partitions,
 									  const int16_t* coeffs,
 									  size_t coeffs_count,
 									  uint8_t** out_payload,
@@ -1557,6 +1831,9 @@ int enc_vp8_build_keyframe_intra_coeffs_ex(uint32_t width,
 		errno = EINVAL;
 		return -1;
 	}
+	const int log2 = log2_token_partitions(token_partitions);
+	if (log2 < 0) return -1;
+	const uint8_t log2_partitions = (uint8_t)log2;
 
 	uint32_t mb_cols = 0, mb_rows = 0;
 	if (enc_vp8_mb_grid(width, height, &mb_cols, &mb_rows) != 0) return -1;
@@ -1568,7 +1845,7 @@ int enc_vp8_build_keyframe_intra_coeffs_ex(uint32_t width,
 	uint32_t mb_total = (uint32_t)mb_total64;
 
 	const size_t coeffs_per_mb = 16 + (16 * 16) + (4 * 16) + (4 * 16);
-	if (coeffs_count != (size_t)mb_total * coeffs_per_mb) {
+	if (coeffs_count != (size_t)mb_total * coeffs_per_mb || !bpred_y2_is_zero(y_modes, coeffs, mb_total, coeffs_per_mb)) {
 		errno = EINVAL;
 		return -1;
 	}
@@ -1619,6 +1896,7 @@ int enc_vp8_build_keyframe_intra_coeffs_ex(uint32_t width,
 							uv_modes,
 							b_modes,
 							lf,
+							log2_partitions,
 							/*coeff_probs_override=*/NULL);
 	enc_bool_finish(&p0);
 	if (enc_bool_error(&p0)) {
@@ -1627,49 +1905,28 @@ int enc_vp8_build_keyframe_intra_coeffs_ex(uint32_t width,
 		errno = EINVAL;
 		return -1;
 	}
-	const size_t p0_size = enc_bool_size(&p0);
-	if (p0_size > 0x7FFFFu) {
-		enc_bool_free(&p0);
-		errno = EINVAL;
-		return -1;
-	}
-
-	EncBoolEncoder tok;
-	enc_bool_init(&tok);
-	enc_tokens_for_grid(&tok, mb_cols, mb_rows, y_modes, coeffs, /*coeff_probs_override=*/NULL, mb_skip_coeff);
-	enc_bool_finish(&tok);
-	if (enc_bool_error(&tok)) {
-		enc_bool_free(&tok);
+	if (enc_bool_size(&p0) > 0x7FFFFu) {
 		enc_bool_free(&p0);
 		free(mb_skip_coeff);
 		errno = EINVAL;
 		return -1;
 	}
-	const size_t tok_size = enc_bool_size(&tok);
 
-	const size_t uncompressed = 10;
-	size_t total = uncompressed + p0_size + tok_size;
-	uint8_t* buf = (uint8_t*)malloc(total);
-	if (!buf) {
-		enc_bool_free(&tok);
-		enc_bool_free(&p0);
-		free(mb_skip_coeff);
-		errno = ENOMEM;
-		return -1;
-	}
-
-	write_vp8_frame_tag(&buf[0], (uint32_t)p0_size);
-	write_keyframe_start_code_and_dims(&buf[3], (uint16_t)width, (uint16_t)height);
-	memcpy(&buf[uncompressed], enc_bool_data(&p0), p0_size);
-	memcpy(&buf[uncompressed + p0_size], enc_bool_data(&tok), tok_size);
-
-	enc_bool_free(&tok);
+	const int rc = enc_assemble_keyframe(width,
+	                                     height,
+	                                     &p0,
+	                                     log2_partitions,
+	                                     mb_cols,
+	                                     mb_rows,
+	                                     y_modes,
+	                                     coeffs,
+	                                     /*coeff_probs_override=*/NULL,
+	                                     mb_skip_coeff,
+	                                     out_payload,
+	                                     out_size);
 	enc_bool_free(&p0);
 	free(mb_skip_coeff);
-
-	*out_payload = buf;
-	*out_size = total;
-	return 0;
+	return rc;
 }
 
 int enc_vp8_build_keyframe_intra_coeffs_ex_probs(uint32_t width,
@@ -1685,6 +1942,7 @@ int enc_vp8_build_keyframe_intra_coeffs_ex_probs(uint32_t width,
 										  const uint8_t* uv_modes,
 										  const uint8_t* b_modes,
 										  const EncVp8LoopFilterParams* lf,
+										  uint32_t token_partitions,
 										  EncVp8TokenProbsMode probs_mode,
 										  const int16_t* coeffs,
 										  size_t coeffs_count,
@@ -1704,6 +1962,7 @@ int enc_vp8_build_keyframe_intra_coeffs_ex_probs(uint32_t width,
 		                                            uv_modes,
 		                                            b_modes,
 		                                            lf,
+		                                            token_partitions,
 		                                            coeffs,
 		                                            coeffs_count,
 		                                            out_payload,
@@ -1720,6 +1979,9 @@ int enc_vp8_build_keyframe_intra_coeffs_ex_probs(uint32_t width,
 		errno = EINVAL;
 		return -1;
 	}
+	const int log2 = log2_token_partitions(token_partitions);
+	if (log2 < 0) return -1;
+	const uint8_t log2_partitions = (uint8_t)log2;
 
 	uint32_t mb_cols = 0, mb_rows = 0;
 	if (enc_vp8_mb_grid(width, height, &mb_cols, &mb_rows) != 0) return -1;
@@ -1731,7 +1993,7 @@ int enc_vp8_build_keyframe_intra_coeffs_ex_probs(uint32_t width,
 	uint32_t mb_total = (uint32_t)mb_total64;
 
 	const size_t coeffs_per_mb = 16 + (16 * 16) + (4 * 16) + (4 * 16);
-	if (coeffs_count != (size_t)mb_total * coeffs_per_mb) {
+	if (coeffs_count != (size_t)mb_total * coeffs_per_mb || !bpred_y2_is_zero(y_modes, coeffs, mb_total, coeffs_per_mb)) {
 		errno = EINVAL;
 		return -1;
 	}
@@ -1771,6 +2033,8 @@ int enc_vp8_build_keyframe_intra_coeffs_ex_probs(uint32_t width,
 	} else {
 		enc_vp8_compute_adaptive_coeff_probs(coeff_probs, mb_cols, mb_rows, y_modes, coeffs);
 	}
+	// C11 does not convert uint8_t(*)[..] to const uint8_t(*)[..] implicitly.
+	const uint8_t(*probs)[8][3][num_dct_tokens - 1] = (const uint8_t(*)[8][3][num_dct_tokens - 1])coeff_probs;
 
 	EncBoolEncoder p0;
 	enc_bool_init(&p0);
@@ -1789,7 +2053,8 @@ int enc_vp8_build_keyframe_intra_coeffs_ex_probs(uint32_t width,
 	                   uv_modes,
 	                   b_modes,
 	                   lf,
-	                   coeff_probs);
+	                   log2_partitions,
+	                   probs);
 	enc_bool_finish(&p0);
 	if (enc_bool_error(&p0)) {
 		enc_bool_free(&p0);
@@ -1797,47 +2062,26 @@ int enc_vp8_build_keyframe_intra_coeffs_ex_probs(uint32_t width,
 		errno = EINVAL;
 		return -1;
 	}
-	const size_t p0_size = enc_bool_size(&p0);
-	if (p0_size > 0x7FFFFu) {
-		enc_bool_free(&p0);
-		errno = EINVAL;
-		return -1;
-	}
-
-	EncBoolEncoder tok;
-	enc_bool_init(&tok);
-	enc_tokens_for_grid(&tok, mb_cols, mb_rows, y_modes, coeffs, coeff_probs, mb_skip_coeff);
-	enc_bool_finish(&tok);
-	if (enc_bool_error(&tok)) {
-		enc_bool_free(&tok);
+	if (enc_bool_size(&p0) > 0x7FFFFu) {
 		enc_bool_free(&p0);
 		free(mb_skip_coeff);
 		errno = EINVAL;
 		return -1;
 	}
-	const size_t tok_size = enc_bool_size(&tok);
 
-	const size_t uncompressed = 10;
-	size_t total = uncompressed + p0_size + tok_size;
-	uint8_t* buf = (uint8_t*)malloc(total);
-	if (!buf) {
-		enc_bool_free(&tok);
-		enc_bool_free(&p0);
-		free(mb_skip_coeff);
-		errno = ENOMEM;
-		return -1;
-	}
-
-	write_vp8_frame_tag(&buf[0], (uint32_t)p0_size);
-	write_keyframe_start_code_and_dims(&buf[3], (uint16_t)width, (uint16_t)height);
-	memcpy(&buf[uncompressed], enc_bool_data(&p0), p0_size);
-	memcpy(&buf[uncompressed + p0_size], enc_bool_data(&tok), tok_size);
-
-	enc_bool_free(&tok);
+	const int rc = enc_assemble_keyframe(width,
+	                                     height,
+	                                     &p0,
+	                                     log2_partitions,
+	                                     mb_cols,
+	                                     mb_rows,
+	                                     y_modes,
+	                                     coeffs,
+	                                     probs,
+	                                     mb_skip_coeff,
+	                                     out_payload,
+	                                     out_size);
 	enc_bool_free(&p0);
 	free(mb_skip_coeff);
-
-	*out_payload = buf;
-	*out_size = total;
-	return 0;
+	return rc;
 }
@@ -44,6 +44,11 @@ int enc_vp8_build_keyframe_dc_coeffs(uint32_t width,
 
 // Like enc_vp8_build_keyframe_dc_coeffs(), but allows setting loopfilter params.
 // If lf is NULL, defaults to {use_simple=0, level=0, sharpness=0, use_lf_delta=0}.
+//
+// token_partitions is the number of DCT token partitions (1, 2, 4 or 8; the
+// functions without it write 1): macroblock row r goes to partition r % count,
+// and the partitions are written concurrently. Other counts fail with
+// errno=EINVAL. The same holds for the other *_ex() builders below.
 int enc_vp8_build_keyframe_dc_coeffs_ex(uint32_t width,
                                        uint32_t height,
                                        uint8_t q_index,
@@ -53,6 +58,7 @@ int enc_vp8_build_keyframe_dc_coeffs_ex(uint32_t width,
                                        int8_t uv_dc_delta_q,
                                        int8_t uv_ac_delta_q,
                                        const EncVp8LoopFilterParams* lf,
+                                       uint32_t token_partitions,
                                        const int16_t* coeffs,
                                        size_t coeffs_count,
                                        uint8_t** out_payload,
@@ -92,6 +98,7 @@ int enc_vp8_build_keyframe_i16_coeffs_ex(uint32_t width,
                                         const uint8_t* y_modes,
                                         const uint8_t* uv_modes,
                                         const EncVp8LoopFilterParams* lf,
+                                        uint32_t token_partitions,
                                         const int16_t* coeffs,
                                         size_t coeffs_count,
                                         uint8_t** out_payload,
@@ -140,6 +147,7 @@ int enc_vp8_build_keyframe_intra_coeffs_ex(uint32_t width,
                                           const uint8_t* uv_modes,
                                           const uint8_t* b_modes,
                                           const EncVp8LoopFilterParams* lf,
+                                          uint32_t token_partitions,
                                           const int16_t* coeffs,
                                           size_t coeffs_count,
                                           uint8_t** out_payload,
@@ -163,6 +171,7 @@ int enc_vp8_build_keyframe_intra_coeffs_ex_probs(uint32_t width,
                                                  const uint8_t* uv_modes,
                                                  const uint8_t* b_modes,
                                                  const EncVp8LoopFilterParams* lf,
+                                                 uint32_t token_partitions,
                                                  EncVp8TokenProbsMode probs_mode,
                                                  const int16_t* coeffs,
                                                  size_t coeffs_count,
@@ -223,6 +232,36 @@ void enc_vp8_compute_adaptive_coeff_probs2(uint8_t out_probs[4][8][3][11],
                                           const uint8_t* y_modes,
                                           const int16_t* coeffs);
 
+// The branch counts behind the two functions above, gathered a macroblock row
+// range at a time, so an encoder can refine its rate probabilities while it
+// analyses the frame instead of walking it again afterwards.
+typedef struct {
+	uint32_t counts[4][8][3][11][2];
+	uint32_t mb_cols;
+	uint32_t next_row; // row after the last range added
+	uint8_t* above;    // non-zero contexts of that row: Y (4 per MB), U, V (2 each), Y2
+} EncVp8CoeffCounts;
+
+// Returns 0, or -1 with errno=ENOMEM.
+int enc_vp8_coeff_counts_init(EncVp8CoeffCounts* c, uint32_t mb_cols);
+void enc_vp8_coeff_counts_free(EncVp8CoeffCounts* c);
+
+// Adds rows [row_begin, row_end) of a grid (y_modes/coeffs index whole-grid
+// macroblocks). A range that does not continue the previous one starts from
+// all-zero above contexts.
+void enc_vp8_coeff_counts_add_rows(EncVp8CoeffCounts* c,
+                                   uint32_t row_begin,
+                                   uint32_t row_end,
+                                   const uint8_t* y_modes,
+                                   const int16_t* coeffs);
+
+// The table enc_vp8_compute_adaptive_coeff_probs() (ADAPTIVE) or
+// enc_vp8_compute_adaptive_coeff_probs2() (ADAPTIVE2) derives from these
+// counts; DEFAULT gives the default table.
+void enc_vp8_coeff_probs_from_counts(uint8_t out_probs[4][8][3][11],
+                                     const EncVp8CoeffCounts* c,
+                                     EncVp8TokenProbsMode mode);
+
 // Estimate the macroblock token cost (coeffs only) for keyframes, assuming
 // external contexts are 0. Uses the standard VP8 per-block context propagation
 // within the macroblock.
@@ -252,6 +291,40 @@ uint32_t enc_vp8_dry_run_keyframe_mb_token_bits_q8_probs(int ymode,
                                                         const int16_t* mb_coeffs,
                                                         const uint8_t coeff_probs_override[4][8][3][11]);
 
+// Precomputed coefficient token costs for one probability table.
+//
+// Rate estimation by table lookup: enc_vp8_token_costs_init() derives, for every
+// (plane, band, ctx), the cost of each coefficient level and of the EOB branch
+// once; the block/macroblock walks below then only add table entries. Costs are
+// exact -log2(p) entropies in Q8 bits (1 bit == 256), so they track the real
+// bool-encoder size without its byte granularity (see enc_vp8_dry_run_...()).
+enum { ENC_VP8_COST_MAX_LEVEL = 67 };
+
+typedef struct EncVp8TokenCosts {
+	// Cost of |coeff| == level from the DCT_0 node on, including extra bits and
+	// sign. Entry ENC_VP8_COST_MAX_LEVEL is the cat6 token without its extra bits.
+	uint16_t level[4][8][3][ENC_VP8_COST_MAX_LEVEL + 1];
+	// The first tree branch: EOB, or "more coefficients" (skipped after DCT_0).
+	uint16_t eob[4][8][3];
+	uint16_t more[4][8][3];
+} EncVp8TokenCosts;
+
+// Fills `costs` for coeff_probs (NULL: the default tables). Recompute whenever
+// the probability table changes.
+void enc_vp8_token_costs_init(EncVp8TokenCosts* costs, const uint8_t coeff_probs[4][8][3][11]);
+
+// Same contract as enc_vp8_estimate_keyframe_block_token_bits_q8().
+uint32_t enc_vp8_token_costs_block_q8(const EncVp8TokenCosts* costs,
+                                      int coeff_plane,
+                                      int first_coeff,
+                                      uint8_t left_has,
+                                      uint8_t above_has,
+                                      const int16_t block[16],
+                                      uint8_t* out_has_coeffs);
+
+// Same contract as enc_vp8_dry_run_keyframe_mb_token_bits_q8_probs().
+uint32_t enc_vp8_token_costs_mb_q8(const EncVp8TokenCosts* costs, int ymode, const int16_t* mb_coeffs);
+
 #ifdef __cplusplus
 }
 #endif
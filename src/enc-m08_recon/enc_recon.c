@@ -1,6 +1,7 @@
 #include "enc_recon.h"
 
-#include "../enc-m05_intra/enc_transform.h"
+#include "../common/enc_dsp.h"
+#include "../common/threads.h"
 #include "../enc-m06_quant/enc_quant.h"
 #include "../enc-m07_tokens/enc_vp8_tokens.h"
 
@@ -24,6 +25,15 @@ static int rdo_scale_step_pct(int step, uint32_t pct) {
 
 static uint8_t dc_value(const uint8_t* left, const uint8_t* top, int size, int round, int shift);
 static uint8_t load_clamped(const uint8_t* plane, uint32_t stride, uint32_t w, uint32_t h, uint32_t x, uint32_t y);
+static const uint8_t* block_in_plane(const uint8_t* plane,
+                                     uint32_t stride,
+                                     uint32_t w,
+                                     uint32_t h,
+                                     uint32_t x0,
+                                     uint32_t y0,
+                                     uint32_t size,
+                                     uint8_t* tmp,
+                                     size_t* block_stride);
 
 typedef enum {
 	VP8_I16_DC_PRED = 0,
@@ -48,54 +58,6 @@ typedef enum {
 static inline uint8_t avg3_u8(uint8_t x, uint8_t y, uint8_t z) { return (uint8_t)((x + y + y + z + 2u) >> 2); }
 static inline uint8_t avg2_u8(uint8_t x, uint8_t y) { return (uint8_t)((x + y + 1u) >> 1); }
 
-static inline int16_t rdo_quant_one(int16_t c, int step) {
-	// Match enc_vp8_quantize4x4_inplace() rounding.
-	if (step <= 0) return 0;
-	int v = (int)c;
-	int sign = 1;
-	if (v < 0) {
-		sign = -1;
-		v = -v;
-	}
-	const int q = (v + (step >> 1)) / step;
-	const int r = sign * q;
-	if (r < -32768) return (int16_t)-32768;
-	if (r > 32767) return (int16_t)32767;
-	return (int16_t)r;
-}
-
-static inline int16_t rdo_quant_one_ac_deadzone_pct(int16_t c, int step, uint32_t deadzone_pct) {
-	// Experimental AC quant: enlarge the zero bin to (deadzone_pct/100)*step.
-	// This is intentionally used only in bpred-rdo (tuning knob) to avoid
-	// perturbing baseline encoders and tests.
-	if (step <= 0) return 0;
-	if (deadzone_pct == 0) deadzone_pct = 60;
-	if (deadzone_pct > 99) deadzone_pct = 99;
-	int v = (int)c;
-	int sign = 1;
-	if (v < 0) {
-		sign = -1;
-		v = -v;
-	}
-	// If |v| < deadzone_pct% of step => quantize to 0.
-	if ((int64_t)v * 100 < (int64_t)step * (int64_t)deadzone_pct) return 0;
-	const int q = (v + (step >> 1)) / step;
-	const int r = sign * q;
-	if (r < -32768) return (int16_t)-32768;
-	if (r > 32767) return (int16_t)32767;
-	return (int16_t)r;
-}
-
-static inline void rdo_quantize4x4_inplace(int16_t coeffs[16], int dc_step, int ac_step, int quant_mode, uint32_t ac_deadzone_pct) {
-	if (!coeffs) return;
-	coeffs[0] = rdo_quant_one(coeffs[0], dc_step);
-	if (quant_mode == 1) {
-		for (int i = 1; i < 16; ++i) coeffs[i] = rdo_quant_one_ac_deadzone_pct(coeffs[i], ac_step, ac_deadzone_pct);
-	} else {
-		for (int i = 1; i < 16; ++i) coeffs[i] = rdo_quant_one(coeffs[i], ac_step);
-	}
-}
-
 static inline uint32_t rdo_coeff_mag_cost(int16_t c) {
 	// Very cheap magnitude proxy: 1 + floor(log2(|c|)) for |c|>0, capped.
 	// This tends to correlate better with actual token cost than nnz alone.
@@ -128,6 +90,15 @@ static inline uint32_t rdo_rate_from_token_bits_q8(uint32_t bits_q8) {
 	return (bits_q8 >> 11);
 }
 
+// Whole-macroblock token bits for rate modes 2 (dry-run) and 3 (cost tables).
+static uint32_t rdo_mb_token_bits_q8(const EncVp8TokenCosts* token_costs,
+				     int ymode,
+				     const int16_t* mb_coeffs,
+				     const uint8_t coeff_probs_override[4][8][3][11]) {
+	if (token_costs) return enc_vp8_token_costs_mb_q8(token_costs, ymode, mb_coeffs);
+	return enc_vp8_dry_run_keyframe_mb_token_bits_q8_probs(ymode, mb_coeffs, coeff_probs_override);
+}
+
 static inline uint32_t rdo_rate_from_mode_bits_q8(uint32_t bits_q8) {
 	// Mode signaling costs are only a handful of bits. If we downscale them the same
 	// way as coefficient token bits, they frequently quantize to zero and effectively
@@ -416,16 +387,10 @@ static uint32_t sse16x16_src_vs_pred(const EncYuv420Image* yuv,
 	                                uint32_t x0,
 	                                uint32_t y0,
 	                                const uint8_t pred[16 * 16]) {
-	uint32_t sse = 0;
-	for (uint32_t dy = 0; dy < 16; dy++) {
-		for (uint32_t dx = 0; dx < 16; dx++) {
-			uint8_t s = load_clamped(yuv->y, yuv->y_stride, w, h, x0 + dx, y0 + dy);
-			uint8_t p = pred[(dy * 16u) + dx];
-			int d = (int)s - (int)p;
-			sse += (uint32_t)(d * d);
-		}
-	}
-	return sse;
+	uint8_t tmp[16 * 16];
+	size_t stride = 0;
+	const uint8_t* src = block_in_plane(yuv->y, yuv->y_stride, w, h, x0, y0, 16, tmp, &stride);
+	return enc_dsp()->sse16x16(src, stride, pred);
 }
 
 static void pred16_fill4x4(uint8_t out4x4[16], const uint8_t pred16[16 * 16], uint32_t bx, uint32_t by) {
@@ -526,16 +491,10 @@ static uint32_t sse8x8_plane_src_vs_pred(const uint8_t* src,
 	                                   uint32_t x0,
 	                                   uint32_t y0,
 	                                   const uint8_t pred[8 * 8]) {
-	uint32_t sse = 0;
-	for (uint32_t dy = 0; dy < 8; dy++) {
-		for (uint32_t dx = 0; dx < 8; dx++) {
-			uint8_t s = load_clamped(src, src_stride, w, h, x0 + dx, y0 + dy);
-			uint8_t p = pred[(dy * 8u) + dx];
-			int d = (int)s - (int)p;
-			sse += (uint32_t)(d * d);
-		}
-	}
-	return sse;
+	uint8_t tmp[8 * 8];
+	size_t stride = 0;
+	const uint8_t* block = block_in_plane(src, src_stride, w, h, x0, y0, 8, tmp, &stride);
+	return enc_dsp()->sse8x8(block, stride, pred);
 }
 
 static uint8_t dc_value(const uint8_t* left, const uint8_t* top, int size, int round, int shift) {
@@ -567,6 +526,54 @@ static uint8_t load_clamped(const uint8_t* plane, uint32_t stride, uint32_t w, u
 	return plane[(size_t)y * (size_t)stride + (size_t)x];
 }
 
+// Points at the size x size block at (x0, y0) when it lies inside the plane;
+// otherwise copies it edge-clamped into tmp (stride size).
+static const uint8_t* block_in_plane(const uint8_t* plane,
+                                     uint32_t stride,
+                                     uint32_t w,
+                                     uint32_t h,
+                                     uint32_t x0,
+                                     uint32_t y0,
+                                     uint32_t size,
+                                     uint8_t* tmp,
+                                     size_t* block_stride) {
+	if (x0 + size <= w && y0 + size <= h) {
+		*block_stride = stride;
+		return plane + (size_t)y0 * stride + x0;
+	}
+	for (uint32_t dy = 0; dy < size; dy++) {
+		for (uint32_t dx = 0; dx < size; dx++) tmp[dy * size + dx] = load_clamped(plane, stride, w, h, x0 + dx, y0 + dy);
+	}
+	*block_stride = size;
+	return tmp;
+}
+
+// Forward transforms of the residual between the size x size source block at
+// (x0, y0) (edge-clamped) and pred (contiguous) into its 4x4 blocks in raster
+// order, two blocks per call.
+static void ftransform_blocks(const EncDsp* dsp,
+                              const uint8_t* plane,
+                              uint32_t stride,
+                              uint32_t w,
+                              uint32_t h,
+                              uint32_t x0,
+                              uint32_t y0,
+                              const uint8_t* pred,
+                              uint32_t size,
+                              int16_t (*out)[16]) {
+	uint8_t tmp[16 * 16];
+	size_t src_stride = 0;
+	const uint8_t* src = block_in_plane(plane, stride, w, h, x0, y0, size, tmp, &src_stride);
+	const uint32_t per_row = size / 4u;
+	for (uint32_t n = 0; n < per_row * per_row; n += 2) {
+		const uint32_t bx = (n % per_row) * 4u;
+		const uint32_t by = (n / per_row) * 4u;
+		const uint8_t* const s[2] = {src + by * src_stride + bx, src + by * src_stride + bx + 4u};
+		const uint8_t* const p[2] = {pred + by * size + bx, pred + by * size + bx + 4u};
+		dsp->ftransform4x4x2(s, (int)src_stride, p, (int)size, &out[n]);
+	}
+}
+
 static void fill4x4_clamped(uint8_t out4x4[16],
                            const uint8_t* plane,
                            uint32_t stride,
@@ -590,23 +597,11 @@ static void inv_wht4x4(const int16_t* input, int16_t* output);
 static void inv_dct4x4(const int16_t* input, int16_t* output);
 
 static uint32_t sad4x4_u8(const uint8_t a[16], const uint8_t b[16]) {
-	uint32_t sad = 0;
-	for (int i = 0; i < 16; i++) {
-		int d = (int)a[i] - (int)b[i];
-		sad += (uint32_t)(d < 0 ? -d : d);
-	}
-	return sad;
+	return enc_dsp()->sad4x4(a, b);
 }
 
 static uint32_t sse4x4_src_vs_recon(const uint8_t src4[16], const uint8_t pred4[16], const int16_t res[16]) {
-	uint32_t sse = 0;
-	for (int i = 0; i < 16; i++) {
-		int32_t v = (int32_t)pred4[i] + (int32_t)res[i];
-		uint8_t r = clamp255_i32(v);
-		int d = (int)src4[i] - (int)r;
-		sse += (uint32_t)(d * d);
-	}
-	return sse;
+	return enc_dsp()->sse4x4_recon(src4, pred4, res);
 }
 
 static uint32_t sse4x4_boundary_src_vs_recon(const uint8_t src4[16], const uint8_t pred4[16], const int16_t res[16]) {
@@ -629,42 +624,7 @@ static uint32_t sse4x4_boundary_src_vs_recon(const uint8_t src4[16], const uint8
 
 static uint32_t satd4x4_src_vs_pred(const uint8_t src4[16], const uint8_t pred4[16]) {
 	// 4x4 Hadamard SATD on the residual (src - pred). Used only for candidate ranking.
-	int16_t r[16];
-	for (int i = 0; i < 16; i++) r[i] = (int16_t)((int)src4[i] - (int)pred4[i]);
-
-	int32_t tmp[16];
-	for (int y = 0; y < 4; y++) {
-		const int o = y * 4;
-		const int32_t a0 = (int32_t)r[o + 0] + (int32_t)r[o + 3];
-		const int32_t a1 = (int32_t)r[o + 1] + (int32_t)r[o + 2];
-		const int32_t a2 = (int32_t)r[o + 1] - (int32_t)r[o + 2];
-		const int32_t a3 = (int32_t)r[o + 0] - (int32_t)r[o + 3];
-		tmp[o + 0] = a0 + a1;
-		tmp[o + 1] = a3 + a2;
-		tmp[o + 2] = a0 - a1;
-		tmp[o + 3] = a3 - a2;
-	}
-
-	uint32_t sum = 0;
-	for (int x = 0; x < 4; x++) {
-		const int32_t b0 = tmp[0 * 4 + x] + tmp[3 * 4 + x];
-		const int32_t b1 = tmp[1 * 4 + x] + tmp[2 * 4 + x];
-		const int32_t b2 = tmp[1 * 4 + x] - tmp[2 * 4 + x];
-		const int32_t b3 = tmp[0 * 4 + x] - tmp[3 * 4 + x];
-		const int32_t t0 = b0 + b1;
-		const int32_t t1 = b3 + b2;
-		const int32_t t2 = b0 - b1;
-		const int32_t t3 = b3 - b2;
-		const int32_t v[4] = {t0, t1, t2, t3};
-		for (int k = 0; k < 4; k++) {
-			int32_t a = v[k];
-			if (a < 0) a = -a;
-			sum += (uint32_t)a;
-		}
-	}
-
-	// Scaling isn't important for ranking; keep it small-ish.
-	return (sum + 1u) >> 1;
+	return enc_dsp()->satd4x4(src4, pred4);
 }
 
 // Small trellis: tweak quantized DC by a couple of steps to reduce SSE.
@@ -708,16 +668,10 @@ static uint32_t sad8x8_plane_src_vs_pred(const uint8_t* src,
 	                                     uint32_t x0,
 	                                     uint32_t y0,
 	                                     const uint8_t pred[8 * 8]) {
-	uint32_t sad = 0;
-	for (uint32_t dy = 0; dy < 8; dy++) {
-		for (uint32_t dx = 0; dx < 8; dx++) {
-			uint8_t s = load_clamped(src, src_stride, w, h, x0 + dx, y0 + dy);
-			uint8_t p = pred[(dy * 8u) + dx];
-			int d = (int)s - (int)p;
-			sad += (uint32_t)(d < 0 ? -d : d);
-		}
-	}
-	return sad;
+	uint8_t tmp[8 * 8];
+	size_t stride = 0;
+	const uint8_t* block = block_in_plane(src, src_stride, w, h, x0, y0, 8, tmp, &stride);
+	return enc_dsp()->sad8x8(block, stride, pred);
 }
 
 static void inv_wht4x4(const int16_t* input, int16_t* output) {
@@ -852,8 +806,418 @@ static void dequant4x4_inplace(int16_t coeffs[16], int dc_step, int ac_step) {
 	}
 }
 
+// --- Wavefront macroblock analysis ---
+//
+// Every analysis loop predicts from reconstructed neighbours: macroblock
+// (mbx, mby) reads row mby up to mbx - 1 and row mby - 1 up to mbx + 1 (the
+// B_PRED above-right pixels). Rows therefore run concurrently as a wavefront:
+// each thread takes the next row and publishes how many of its macroblocks are
+// done, and a row only analyses mbx once the row above has finished mbx + 1.
+// A macroblock writes only its own recon pixels and output slots, and all
+// scratch buffers are locals of the per-macroblock function, so the result
+// does not depend on the thread count or the schedule.
+
+enum {
+	ENC_MAX_THREADS = 16,
+};
+
+// bpred-rdo settings resolved from EncBpredRdoTuning once per pass.
+typedef struct {
+	uint32_t lambda_mul;
+	uint32_t lambda_div;
+	int use_entropy_rate;
+	int use_mb_rate;
+	int use_entropy_signal;
+	uint32_t satd_prune_k;
+	uint32_t ymode_min_bits_q8;
+	uint32_t uv_mode_min_bits_q8;
+} EncBpredRdoParams;
+
+// qf as reciprocal quantizers (enc_dsp.h), built once per pass.
+typedef struct {
+	EncDspQuant y1;
+	EncDspQuant y2;
+	EncDspQuant uv;
+} EncMbQuant;
+
+// ac_zero_pct > 0 is bpred-rdo's AC deadzone for the Y and UV blocks; Y2 never uses it.
+static void mb_quant_init(EncMbQuant* q, const EncVp8QuantFactors* qf, uint32_t ac_zero_pct) {
+	enc_dsp_quant_init(&q->y1, qf->y1_dc, qf->y1_ac, ac_zero_pct);
+	enc_dsp_quant_init(&q->y2, qf->y2_dc, qf->y2_ac, 0);
+	enc_dsp_quant_init(&q->uv, qf->uv_dc, qf->uv_ac, ac_zero_pct);
+}
+
+// Read-only inputs and the shared outputs of one analysis pass.
+typedef struct {
+	const EncYuv420Image* yuv;
+	EncVp8ReconPlanes recon;
+	EncVp8QuantFactors qf;
+	EncMbQuant quant;
+	uint32_t mb_cols;
+	uint32_t mb_rows;
+	uint32_t threads; // 0: one per CPU
+	int16_t* out;
+	uint8_t* y_modes;
+	uint8_t* uv_modes;
+	uint8_t* b_modes;
+	// bpred-rdo only.
+	const uint8_t (*coeff_probs_override)[8][3][11];
+	const EncVp8TokenCosts* token_costs;
+	EncBpredRdoParams rdo;
+	// bpred-rdo with refine_rows: row mby rates with slot (mby / refine_rows) & 1
+	// instead of the two fields above (see bpred_uv_rdo_refining()).
+	uint32_t refine_rows;
+	const uint8_t (*band_probs[2])[8][3][11];
+	const EncVp8TokenCosts* band_costs[2];
+} EncMbAnalysis;
+
+typedef void (*EncMbFn)(const EncMbAnalysis* a, uint32_t mbx, uint32_t mby);
+
+// Called once per band of band_rows rows (band 0 starts at row_begin), in band
+// order, before any of its rows starts. When it runs for band b, every row
+// before band b - 1 is finished.
+typedef void (*EncBandFn)(void* ctx, uint32_t band);
+
+typedef struct {
+	const EncMbAnalysis* a;
+	EncMbFn fn;
+	OsMutex lock;
+	OsCond progress;
+	uint32_t row_begin;
+	uint32_t row_end;
+	uint32_t next_row;
+	uint32_t* done; // per row from row_begin: macroblocks finished
+	// Optional bands (band_rows > 0).
+	uint32_t band_rows;
+	EncBandFn prepare_band;
+	void* band_ctx;
+	uint32_t bands_ready;
+} EncWavefront;
+
+// Waits until band b of the row at index i (from row_begin) may start; the
+// thread that takes the band's first row prepares it. Called with wf->lock held.
+static void wavefront_enter_band(EncWavefront* wf, uint32_t i) {
+	const uint32_t cols = wf->a->mb_cols;
+	const uint32_t band = i / wf->band_rows;
+	if (i % wf->band_rows != 0) {
+		while (wf->bands_ready <= band) os_cond_wait(&wf->progress, &wf->lock);
+		return;
+	}
+	// Bands are prepared in order, each once the rows before the previous
+	// band are finished (rows finish in order, so checking the last one is enough).
+	const uint32_t last = (band >= 2u) ? (band - 1u) * wf->band_rows - 1u : 0;
+	while (wf->bands_ready < band || (band >= 2u && wf->done[last] < cols)) os_cond_wait(&wf->progress, &wf->lock);
+	os_mutex_unlock(&wf->lock);
+	wf->prepare_band(wf->band_ctx, band);
+	os_mutex_lock(&wf->lock);
+	wf->bands_ready = band + 1u;
+	os_cond_broadcast(&wf->progress);
+}
+
+static void* wavefront_worker(void* arg) {
+	EncWavefront* wf = (EncWavefront*)arg;
+	const uint32_t cols = wf->a->mb_cols;
+	for (;;) {
+		os_mutex_lock(&wf->lock);
+		const uint32_t mby = wf->next_row++;
+		if (mby < wf->row_end && wf->band_rows) wavefront_enter_band(wf, mby - wf->row_begin);
+		os_mutex_unlock(&wf->lock);
+		if (mby >= wf->row_end) return NULL;
+
+		const uint32_t i = mby - wf->row_begin;
+		uint32_t above = (i == 0) ? cols : 0; // last seen progress of row mby - 1
+		for (uint32_t mbx = 0; mbx < cols; mbx++) {
+			const uint32_t need = (mbx + 2u < cols) ? mbx + 2u : cols;
+			if (above < need) {
+				os_mutex_lock(&wf->lock);
+				while (wf->done[i - 1u] < need) os_cond_wait(&wf->progress, &wf->lock);
+				above = wf->done[i - 1u];
+				os_mutex_unlock(&wf->lock);
+			}
+			wf->fn(wf->a, mbx, mby);
+			os_mutex_lock(&wf->lock);
+			wf->done[i] = mbx + 1u;
+			os_cond_broadcast(&wf->progress);
+			os_mutex_unlock(&wf->lock);
+		}
+	}
+}
+
+// Runs wf->fn over every macroblock of rows [wf->row_begin, wf->row_end).
+static int wavefront_run(EncWavefront* wf) {
+	const EncMbAnalysis* a = wf->a;
+	const uint32_t row_begin = wf->row_begin;
+	const uint32_t row_end = wf->row_end;
+	const uint32_t rows = row_end - row_begin;
+	uint32_t threads = a->threads ? a->threads : os_cpu_count();
+	if (threads > ENC_MAX_THREADS) threads = ENC_MAX_THREADS;
+	// Each row trails the one above by two macroblocks; more rows in flight
+	// than that would only wait.
+	if (threads > (a->mb_cols + 1u) / 2u) threads = (a->mb_cols + 1u) / 2u;
+	if (threads > rows) threads = rows;
+	if (threads <= 1u) {
+		for (uint32_t mby = row_begin; mby < row_end; ++mby) {
+			if (wf->band_rows && (mby - row_begin) % wf->band_rows == 0) {
+				wf->prepare_band(wf->band_ctx, (mby - row_begin) / wf->band_rows);
+			}
+			for (uint32_t mbx = 0; mbx < a->mb_cols; ++mbx) wf->fn(a, mbx, mby);
+		}
+		return 0;
+	}
+
+	wf->done = (uint32_t*)calloc(rows, sizeof(uint32_t));
+	if (!wf->done) {
+		errno = ENOMEM;
+		return -1;
+	}
+	if (os_mutex_init(&wf->lock) != 0) {
+		free(wf->done);
+		return -1;
+	}
+	if (os_cond_init(&wf->progress) != 0) {
+		os_mutex_destroy(&wf->lock);
+		free(wf->done);
+		return -1;
+	}
+
+	OsThread workers[ENC_MAX_THREADS];
+	uint32_t started = 0;
+	while (started + 1u < threads && os_thread_start(&workers[started], wavefront_worker, wf) == 0) started++;
+	// Rows nobody else takes (all of them when no thread started) run here.
+	(void)wavefront_worker(wf);
+	for (uint32_t t = 0; t < started; t++) (void)os_thread_join(&workers[t]);
+
+	os_cond_destroy(&wf->progress);
+	os_mutex_destroy(&wf->lock);
+	free(wf->done);
+	return 0;
+}
+
+// Runs fn over every macroblock of rows [row_begin, row_end) of a; the rows
+// above row_begin must be finished. Returns 0, or -1 with errno set.
+static int enc_mb_wavefront_rows(const EncMbAnalysis* a, EncMbFn fn, uint32_t row_begin, uint32_t row_end) {
+	EncWavefront wf = {.a = a, .fn = fn, .row_begin = row_begin, .row_end = row_end, .next_row = row_begin};
+	return wavefront_run(&wf);
+}
+
+// enc_mb_wavefront() with prepare_band(ctx, b) run before band b of band_rows
+// rows (see EncBandFn). Band b can use everything rows before band b - 1
+// produced without stopping the wavefront at band boundaries; at most two
+// bands are in flight.
+static int enc_mb_wavefront_banded(const EncMbAnalysis* a,
+                                   EncMbFn fn,
+                                   uint32_t band_rows,
+                                   EncBandFn prepare_band,
+                                   void* ctx) {
+	EncWavefront wf = {.a = a,
+	                   .fn = fn,
+	                   .row_begin = 0,
+	                   .row_end = a->mb_rows,
+	                   .next_row = 0,
+	                   .band_rows = band_rows,
+	                   .prepare_band = prepare_band,
+	                   .band_ctx = ctx};
+	return wavefront_run(&wf);
+}
+
+// Runs fn over every macroblock of a.
+static int enc_mb_wavefront(const EncMbAnalysis* a, EncMbFn fn) {
+	return enc_mb_wavefront_rows(a, fn, 0, a->mb_rows);
+}
+
+// One macroblock of enc_vp8_encode_dc_pred_inloop().
+static void dc_pred_mb(const EncMbAnalysis* a, uint32_t mbx, uint32_t mby) {
+	const EncDsp* dsp = enc_dsp();
+	const EncYuv420Image* yuv = a->yuv;
+	const EncVp8ReconPlanes recon = a->recon;
+	const EncVp8QuantFactors qf = a->qf;
+	const uint32_t w = yuv->width;
+	const uint32_t h = yuv->height;
+	const uint32_t uv_w = (w + 1u) >> 1;
+	const uint32_t uv_h = (h + 1u) >> 1;
+	const uint32_t mb_cols = a->mb_cols;
+	const size_t coeffs_per_mb = 16 + (16 * 16) + (4 * 16) + (4 * 16);
+	int16_t* out = a->out;
+
+	uint8_t src4[16];
+	uint8_t ref4[16];
+	int16_t tmp[16][16];
+	int16_t y2[16];
+	int16_t y2_deq[16];
+	int16_t y_dc16[16];
+
+	const uint32_t x0 = mbx * 16u;
+	const uint32_t y0 = mby * 16u;
+	const uint32_t ux0 = mbx * 8u;
+	const uint32_t uy0 = mby * 8u;
+
+	// Predictor DC for Y from reconstructed neighbors.
+	uint8_t top16[16];
+	uint8_t left16[16];
+	const uint8_t* top_ptr = NULL;
+	const uint8_t* left_ptr = NULL;
+	if (mby > 0) {
+		for (uint32_t i = 0; i < 16; i++) {
+			top16[i] = recon.y[(size_t)(y0 - 1) * recon.y_stride + (size_t)(x0 + i)];
+		}
+		top_ptr = top16;
+	}
+	if (mbx > 0) {
+		for (uint32_t i = 0; i < 16; i++) {
+			left16[i] = recon.y[(size_t)(y0 + i) * recon.y_stride + (size_t)(x0 - 1)];
+		}
+		left_ptr = left16;
+	}
+	const uint8_t dc_y = dc_value(left_ptr, top_ptr, 16, 16, 5);
+
+	// Predictor DC for U/V from reconstructed neighbors.
+	uint8_t top8_u[8], left8_u[8], top8_v[8], left8_v[8];
+	const uint8_t* top_u = NULL;
+	const uint8_t* left_u = NULL;
+	const uint8_t* top_v = NULL;
+	const uint8_t* left_v = NULL;
+	if (mby > 0) {
+		for (uint32_t i = 0; i < 8; i++) {
+			top8_u[i] = recon.u[(size_t)(uy0 - 1) * recon.uv_stride + (size_t)(ux0 + i)];
+			top8_v[i] = recon.v[(size_t)(uy0 - 1) * recon.uv_stride + (size_t)(ux0 + i)];
+		}
+		top_u = top8_u;
+		top_v = top8_v;
+	}
+	if (mbx > 0) {
+		for (uint32_t i = 0; i < 8; i++) {
+			left8_u[i] = recon.u[(size_t)(uy0 + i) * recon.uv_stride + (size_t)(ux0 - 1)];
+			left8_v[i] = recon.v[(size_t)(uy0 + i) * recon.uv_stride + (size_t)(ux0 - 1)];
+		}
+		left_u = left8_u;
+		left_v = left8_v;
+	}
+	const uint8_t dc_u = dc_value(left_u, top_u, 8, 8, 4);
+	const uint8_t dc_v = dc_value(left_v, top_v, 8, 8, 4);
+
+	// Y forward transform, extract DCs into Y2.
+	fill4x4_const(ref4, dc_y);
+	for (uint32_t n = 0; n < 16; ++n) {
+		const uint32_t bx = (n & 3u) * 4u;
+		const uint32_t by = (n >> 2) * 4u;
+		fill4x4_clamped(src4, yuv->y, yuv->y_stride, w, h, x0 + bx, y0 + by);
+		dsp->ftransform4x4(src4, 4, ref4, 4, tmp[n]);
+	}
+	dsp->ftransform_wht(&tmp[0][0], y2);
+	for (int n = 0; n < 16; ++n) tmp[n][0] = 0;
+
+	// Quantize Y2 and Y blocks.
+	{
+		int16_t y2q[16];
+		for (int i = 0; i < 16; ++i) y2q[i] = y2[i];
+		dsp->quantize4x4(y2q, &a->quant.y2);
+		for (int i = 0; i < 16; ++i) y2[i] = y2q[i];
+	}
+	for (int n = 0; n < 16; ++n) {
+		dsp->quantize4x4(tmp[n], &a->quant.y1);
+	}
+
+	// U/V forward transforms + quant.
+	int16_t ublk[4][16];
+	int16_t vblk[4][16];
+	fill4x4_const(ref4, dc_u);
+	for (uint32_t n = 0; n < 4; ++n) {
+		const uint32_t bx = (n & 1u) * 4u;
+		const uint32_t by = (n >> 1) * 4u;
+		fill4x4_clamped(src4, yuv->u, yuv->uv_stride, uv_w, uv_h, ux0 + bx, uy0 + by);
+		dsp->ftransform4x4(src4, 4, ref4, 4, ublk[n]);
+		dsp->quantize4x4(ublk[n], &a->quant.uv);
+	}
+	fill4x4_const(ref4, dc_v);
+	for (uint32_t n = 0; n < 4; ++n) {
+		const uint32_t bx = (n & 1u) * 4u;
+		const uint32_t by = (n >> 1) * 4u;
+		fill4x4_clamped(src4, yuv->v, yuv->uv_stride, uv_w, uv_h, ux0 + bx, uy0 + by);
+		dsp->ftransform4x4(src4, 4, ref4, 4, vblk[n]);
+		dsp->quantize4x4(vblk[n], &a->quant.uv);
+	}
+
+	// Store coeffs for this macroblock.
+	const size_t mb_index = (size_t)mby * (size_t)mb_cols + (size_t)mbx;
+	int16_t* dst = out + mb_index * coeffs_per_mb;
+	for (int i = 0; i < 16; ++i) dst[i] = y2[i];
+	dst += 16;
+	for (int n = 0; n < 16; ++n) {
+		for (int i = 0; i < 16; ++i) dst[i] = tmp[n][i];
+		dst += 16;
+	}
+	for (int n = 0; n < 4; ++n) {
+		for (int i = 0; i < 16; ++i) dst[i] = ublk[n][i];
+		dst += 16;
+	}
+	for (int n = 0; n < 4; ++n) {
+		for (int i = 0; i < 16; ++i) dst[i] = vblk[n][i];
+		dst += 16;
+	}
+
+	// Reconstruct Y.
+	for (int i = 0; i < 16; ++i) y2_deq[i] = y2[i];
+	dequant4x4_inplace(y2_deq, qf.y2_dc, qf.y2_ac);
+	inv_wht4x4(y2_deq, y_dc16);
+	for (int n = 0; n < 16; ++n) {
+		int16_t block_coeffs[16];
+		for (int i = 0; i < 16; ++i) block_coeffs[i] = tmp[n][i];
+		dequant4x4_inplace(block_coeffs, qf.y1_dc, qf.y1_ac);
+		// The DC comes from the (already dequantized) inverse WHT.
+		block_coeffs[0] = y_dc16[n];
+		int16_t res[16];
+		inv_dct4x4(block_coeffs, res);
+		const uint32_t bx = (uint32_t)(n & 3) * 4u;
+		const uint32_t by = (uint32_t)(n >> 2) * 4u;
+		for (uint32_t dy = 0; dy < 4; ++dy) {
+			uint8_t* row = recon.y + (size_t)(y0 + by + dy) * recon.y_stride + (size_t)(x0 + bx);
+			for (uint32_t dx = 0; dx < 4; ++dx) {
+				int32_t v = (int32_t)dc_y + (int32_t)res[dy * 4 + dx];
+				row[dx] = clamp255_i32(v);
+			}
+		}
+	}
+
+	// Reconstruct U.
+	for (int n = 0; n < 4; ++n) {
+		int16_t block_coeffs[16];
+		for (int i = 0; i < 16; ++i) block_coeffs[i] = ublk[n][i];
+		dequant4x4_inplace(block_coeffs, qf.uv_dc, qf.uv_ac);
+		int16_t res[16];
+		inv_dct4x4(block_coeffs, res);
+		const uint32_t bx = (uint32_t)(n & 1) * 4u;
+		const uint32_t by = (uint32_t)(n >> 1) * 4u;
+		for (uint32_t dy = 0; dy < 4; ++dy) {
+			uint8_t* row = recon.u + (size_t)(uy0 + by + dy) * recon.uv_stride + (size_t)(ux0 + bx);
+			for (uint32_t dx = 0; dx < 4; ++dx) {
+				int32_t v = (int32_t)dc_u + (int32_t)res[dy * 4 + dx];
+				row[dx] = clamp255_i32(v);
+			}
+		}
+	}
+
+	// Reconstruct V.
+	for (int n = 0; n < 4; ++n) {
+		int16_t block_coeffs[16];
+		for (int i = 0; i < 16; ++i) block_coeffs[i] = vblk[n][i];
+		dequant4x4_inplace(block_coeffs, qf.uv_dc, qf.uv_ac);
+		int16_t res[16];
+		inv_dct4x4(block_coeffs, res);
+		const uint32_t bx = (uint32_t)(n & 1) * 4u;
+		const uint32_t by = (uint32_t)(n >> 1) * 4u;
+		for (uint32_t dy = 0; dy < 4; ++dy) {
+			uint8_t* row = recon.v + (size_t)(uy0 + by + dy) * recon.uv_stride + (size_t)(ux0 + bx);
+			for (uint32_t dx = 0; dx < 4; ++dx) {
+				int32_t v = (int32_t)dc_v + (int32_t)res[dy * 4 + dx];
+				row[dx] = clamp255_i32(v);
+			}
+		}
+	}
+}
+
 int enc_vp8_encode_dc_pred_inloop(const EncYuv420Image* yuv,
                                  int quality,
+                                 uint32_t threads,
                                  int16_t** coeffs_out,
                                  size_t* coeffs_count_out,
                                  uint8_t* qindex_out) {
@@ -897,188 +1261,15 @@ int enc_vp8_encode_dc_pred_inloop(const EncYuv420Image* yuv,
 	enc_vp8_quant_factors_from_qindex(qindex, 0, 0, 0, 0, 0, &qf);
 	*qindex_out = (uint8_t)qf.qindex;
 
-	const uint32_t uv_w = (w + 1u) >> 1;
-	const uint32_t uv_h = (h + 1u) >> 1;
-
-	uint8_t src4[16];
-	uint8_t ref4[16];
-	int16_t tmp[16][16];
-	int16_t y2[16];
-	int16_t y2_deq[16];
-	int16_t y_dc16[16];
-
-	for (uint32_t mby = 0; mby < mb_rows; ++mby) {
-		for (uint32_t mbx = 0; mbx < mb_cols; ++mbx) {
-			const uint32_t x0 = mbx * 16u;
-			const uint32_t y0 = mby * 16u;
-			const uint32_t ux0 = mbx * 8u;
-			const uint32_t uy0 = mby * 8u;
-
-			// Predictor DC for Y from reconstructed neighbors.
-			uint8_t top16[16];
-			uint8_t left16[16];
-			const uint8_t* top_ptr = NULL;
-			const uint8_t* left_ptr = NULL;
-			if (mby > 0) {
-				for (uint32_t i = 0; i < 16; i++) {
-					top16[i] = recon.y[(size_t)(y0 - 1) * recon.y_stride + (size_t)(x0 + i)];
-				}
-				top_ptr = top16;
-			}
-			if (mbx > 0) {
-				for (uint32_t i = 0; i < 16; i++) {
-					left16[i] = recon.y[(size_t)(y0 + i) * recon.y_stride + (size_t)(x0 - 1)];
-				}
-				left_ptr = left16;
-			}
-			const uint8_t dc_y = dc_value(left_ptr, top_ptr, 16, 16, 5);
-
-			// Predictor DC for U/V from reconstructed neighbors.
-			uint8_t top8_u[8], left8_u[8], top8_v[8], left8_v[8];
-			const uint8_t* top_u = NULL;
-			const uint8_t* left_u = NULL;
-			const uint8_t* top_v = NULL;
-			const uint8_t* left_v = NULL;
-			if (mby > 0) {
-				for (uint32_t i = 0; i < 8; i++) {
-					top8_u[i] = recon.u[(size_t)(uy0 - 1) * recon.uv_stride + (size_t)(ux0 + i)];
-					top8_v[i] = recon.v[(size_t)(uy0 - 1) * recon.uv_stride + (size_t)(ux0 + i)];
-				}
-				top_u = top8_u;
-				top_v = top8_v;
-			}
-			if (mbx > 0) {
-				for (uint32_t i = 0; i < 8; i++) {
-					left8_u[i] = recon.u[(size_t)(uy0 + i) * recon.uv_stride + (size_t)(ux0 - 1)];
-					left8_v[i] = recon.v[(size_t)(uy0 + i) * recon.uv_stride + (size_t)(ux0 - 1)];
-				}
-				left_u = left8_u;
-				left_v = left8_v;
-			}
-			const uint8_t dc_u = dc_value(left_u, top_u, 8, 8, 4);
-			const uint8_t dc_v = dc_value(left_v, top_v, 8, 8, 4);
-
-			// Y forward transform, extract DCs into Y2.
-			fill4x4_const(ref4, dc_y);
-			for (uint32_t n = 0; n < 16; ++n) {
-				const uint32_t bx = (n & 3u) * 4u;
-				const uint32_t by = (n >> 2) * 4u;
-				fill4x4_clamped(src4, yuv->y, yuv->y_stride, w, h, x0 + bx, y0 + by);
-				enc_vp8_ftransform4x4(src4, 4, ref4, 4, tmp[n]);
-			}
-			enc_vp8_ftransform_wht(&tmp[0][0], y2);
-			for (int n = 0; n < 16; ++n) tmp[n][0] = 0;
-
-			// Quantize Y2 and Y blocks.
-			{
-				int16_t y2q[16];
-				for (int i = 0; i < 16; ++i) y2q[i] = y2[i];
-				enc_vp8_quantize4x4_inplace(y2q, qf.y2_dc, qf.y2_ac);
-				for (int i = 0; i < 16; ++i) y2[i] = y2q[i];
-			}
-			for (int n = 0; n < 16; ++n) {
-				enc_vp8_quantize4x4_inplace(tmp[n], qf.y1_dc, qf.y1_ac);
-			}
-
-			// U/V forward transforms + quant.
-			int16_t ublk[4][16];
-			int16_t vblk[4][16];
-			fill4x4_const(ref4, dc_u);
-			for (uint32_t n = 0; n < 4; ++n) {
-				const uint32_t bx = (n & 1u) * 4u;
-				const uint32_t by = (n >> 1) * 4u;
-				fill4x4_clamped(src4, yuv->u, yuv->uv_stride, uv_w, uv_h, ux0 + bx, uy0 + by);
-				enc_vp8_ftransform4x4(src4, 4, ref4, 4, ublk[n]);
-				enc_vp8_quantize4x4_inplace(ublk[n], qf.uv_dc, qf.uv_ac);
-			}
-			fill4x4_const(ref4, dc_v);
-			for (uint32_t n = 0; n < 4; ++n) {
-				const uint32_t bx = (n & 1u) * 4u;
-				const uint32_t by = (n >> 1) * 4u;
-				fill4x4_clamped(src4, yuv->v, yuv->uv_stride, uv_w, uv_h, ux0 + bx, uy0 + by);
-				enc_vp8_ftransform4x4(src4, 4, ref4, 4, vblk[n]);
-				enc_vp8_quantize4x4_inplace(vblk[n], qf.uv_dc, qf.uv_ac);
-			}
-
-			// Store coeffs for this macroblock.
-			const size_t mb_index = (size_t)mby * (size_t)mb_cols + (size_t)mbx;
-			int16_t* dst = out + mb_index * coeffs_per_mb;
-			for (int i = 0; i < 16; ++i) dst[i] = y2[i];
-			dst += 16;
-			for (int n = 0; n < 16; ++n) {
-				for (int i = 0; i < 16; ++i) dst[i] = tmp[n][i];
-				dst += 16;
-			}
-			for (int n = 0; n < 4; ++n) {
-				for (int i = 0; i < 16; ++i) dst[i] = ublk[n][i];
-				dst += 16;
-			}
-			for (int n = 0; n < 4; ++n) {
-				for (int i = 0; i < 16; ++i) dst[i] = vblk[n][i];
-				dst += 16;
-			}
-
-			// Reconstruct Y.
-			for (int i = 0; i < 16; ++i) y2_deq[i] = y2[i];
-			dequant4x4_inplace(y2_deq, qf.y2_dc, qf.y2_ac);
-			inv_wht4x4(y2_deq, y_dc16);
-			for (int n = 0; n < 16; ++n) {
-				int16_t block_coeffs[16];
-				for (int i = 0; i < 16; ++i) block_coeffs[i] = tmp[n][i];
-				block_coeffs[0] = y_dc16[n];
-				dequant4x4_inplace(block_coeffs, qf.y1_dc, qf.y1_ac);
-				int16_t res[16];
-				inv_dct4x4(block_coeffs, res);
-				const uint32_t bx = (uint32_t)(n & 3) * 4u;
-				const uint32_t by = (uint32_t)(n >> 2) * 4u;
-				for (uint32_t dy = 0; dy < 4; ++dy) {
-					uint8_t* row = recon.y + (size_t)(y0 + by + dy) * recon.y_stride + (size_t)(x0 + bx);
-					for (uint32_t dx = 0; dx < 4; ++dx) {
-						int32_t v = (int32_t)dc_y + (int32_t)res[dy * 4 + dx];
-						row[dx] = clamp255_i32(v);
-					}
-				}
-			}
-
-			// Reconstruct U.
-			for (int n = 0; n < 4; ++n) {
-				int16_t block_coeffs[16];
-				for (int i = 0; i < 16; ++i) block_coeffs[i] = ublk[n][i];
-				dequant4x4_inplace(block_coeffs, qf.uv_dc, qf.uv_ac);
-				int16_t res[16];
-				inv_dct4x4(block_coeffs, res);
-				const uint32_t bx = (uint32_t)(n & 1) * 4u;
-				const uint32_t by = (uint32_t)(n >> 1) * 4u;
-				for (uint32_t dy = 0; dy < 4; ++dy) {
-					uint8_t* row = recon.u + (size_t)(uy0 + by + dy) * recon.uv_stride + (size_t)(ux0 + bx);
-					for (uint32_t dx = 0; dx < 4; ++dx) {
-						int32_t v = (int32_t)dc_u + (int32_t)res[dy * 4 + dx];
-						row[dx] = clamp255_i32(v);
-					}
-				}
-			}
-
-			// Reconstruct V.
-			for (int n = 0; n < 4; ++n) {
-				int16_t block_coeffs[16];
-				for (int i = 0; i < 16; ++i) block_coeffs[i] = vblk[n][i];
-				dequant4x4_inplace(block_coeffs, qf.uv_dc, qf.uv_ac);
-				int16_t res[16];
-				inv_dct4x4(block_coeffs, res);
-				const uint32_t bx = (uint32_t)(n & 1) * 4u;
-				const uint32_t by = (uint32_t)(n >> 1) * 4u;
-				for (uint32_t dy = 0; dy < 4; ++dy) {
-					uint8_t* row = recon.v + (size_t)(uy0 + by + dy) * recon.uv_stride + (size_t)(ux0 + bx);
-					for (uint32_t dx = 0; dx < 4; ++dx) {
-						int32_t v = (int32_t)dc_v + (int32_t)res[dy * 4 + dx];
-						row[dx] = clamp255_i32(v);
-					}
-				}
-			}
-		}
-	}
-
+	EncMbAnalysis a = {
+		.yuv = yuv, .recon = recon, .qf = qf, .mb_cols = mb_cols, .mb_rows = mb_rows, .threads = threads, .out = out};
+	mb_quant_init(&a.quant, &qf, 0);
+	const int rc = enc_mb_wavefront(&a, dc_pred_mb);
 	enc_vp8_recon_free(&recon);
+	if (rc != 0) {
+		free(out);
+		return -1;
+	}
 	*coeffs_out = out;
 	*coeffs_count_out = coeffs_total;
 	return 0;
@@ -1087,6 +1278,7 @@ int enc_vp8_encode_dc_pred_inloop(const EncYuv420Image* yuv,
 static int enc_vp8_encode_bpred_uv_rdo_inloop_pass(const EncYuv420Image* yuv,
 								  int quality,
 								  const uint8_t coeff_probs_override[4][8][3][11],
+								  EncVp8TokenProbsMode refine_mode,
 								  uint8_t** y_modes_out,
 								  size_t* y_modes_count_out,
 								  uint8_t** b_modes_out,
@@ -1112,8 +1304,33 @@ int enc_vp8_encode_bpred_uv_rdo_inloop(const EncYuv420Image* yuv,
 					 uint8_t* qindex_out,
 					 const EncBpredRdoTuning* tuning) {
 	int rate_mode = 0;
-	if (tuning) rate_mode = (int)tuning->rate_mode;
+	int single_pass = 0;
+	int refine = 0;
+	if (tuning) {
+		rate_mode = (int)tuning->rate_mode;
+		single_pass = (tuning->single_pass != 0);
+		refine = single_pass && (tuning->refine_rows != 0 || tuning->stats_sample_rows != 0);
+	}
 	const int use_rate_estimation = (rate_mode != 0);
+	const int adaptive = (token_probs_mode != ENC_VP8_TOKEN_PROBS_DEFAULT);
+
+	// One pass that refines its rate probabilities as it goes.
+	if (use_rate_estimation && adaptive && refine) {
+		return enc_vp8_encode_bpred_uv_rdo_inloop_pass(yuv,
+		                                             quality,
+		                                             /*coeff_probs_override=*/NULL,
+		                                             token_probs_mode,
+		                                             y_modes_out,
+		                                             y_modes_count_out,
+		                                             b_modes_out,
+		                                             b_modes_count_out,
+		                                             uv_modes_out,
+		                                             uv_modes_count_out,
+		                                             coeffs_out,
+		                                             coeffs_count_out,
+		                                             qindex_out,
+		                                             tuning);
+	}
 
 	// Pass 1: always run with default probability tables for entropy-rate estimation.
 	uint8_t* y1 = NULL;
@@ -1129,6 +1346,7 @@ int enc_vp8_encode_bpred_uv_rdo_inloop(const EncYuv420Image* yuv,
 	int rc = enc_vp8_encode_bpred_uv_rdo_inloop_pass(yuv,
 	                                               quality,
 	                                               /*coeff_probs_override=*/NULL,
+	                                               ENC_VP8_TOKEN_PROBS_DEFAULT,
 	                                               &y1,
 	                                               &y1n,
 	                                               &b1,
@@ -1142,7 +1360,7 @@ int enc_vp8_encode_bpred_uv_rdo_inloop(const EncYuv420Image* yuv,
 	if (rc != 0) return rc;
 
 	// Only refine when a rate estimator is enabled AND token probs are adaptive.
-	if (!use_rate_estimation || token_probs_mode == ENC_VP8_TOKEN_PROBS_DEFAULT) {
+	if (!use_rate_estimation || single_pass || !adaptive) {
 		*y_modes_out = y1;
 		*y_modes_count_out = y1n;
 		*b_modes_out = b1;
@@ -1172,7 +1390,8 @@ int enc_vp8_encode_bpred_uv_rdo_inloop(const EncYuv420Image* yuv,
 
 	return enc_vp8_encode_bpred_uv_rdo_inloop_pass(yuv,
 	                                             quality,
-	                                             probs1,
+	                                             (const uint8_t(*)[8][3][11])probs1,
+	                                             ENC_VP8_TOKEN_PROBS_DEFAULT,
 	                                             y_modes_out,
 	                                             y_modes_count_out,
 	                                             b_modes_out,
@@ -1185,9 +1404,237 @@ int enc_vp8_encode_bpred_uv_rdo_inloop(const EncYuv420Image* yuv,
 	                                             tuning);
 }
 
+// Rows are speeds 0..6. Search effort drops in steps: dry-run -> table rate,
+// SATD pruning of the 4x4 candidates, a single pass, then SAD-only decisions.
+static const EncSpeedPreset k_speed_presets[ENC_SPEED_MAX + 1] = {
+	{ENC_SPEED_INTRA_BPRED_RDO, 2, 0, 0, 0},
+	{ENC_SPEED_INTRA_BPRED_RDO, 3, 0, 1, 4},
+	{ENC_SPEED_INTRA_BPRED_RDO, 3, 6, 1, 4},
+	{ENC_SPEED_INTRA_BPRED_RDO, 3, 4, 1, 0},
+	{ENC_SPEED_INTRA_BPRED_RDO, 0, 3, 1, 0},
+	{ENC_SPEED_INTRA_BPRED, 0, 0, 1, 0},
+	{ENC_SPEED_INTRA_I16, 0, 0, 1, 0},
+};
+
+const EncSpeedPreset* enc_speed_preset(int speed) {
+	if (speed < ENC_SPEED_MIN || speed > ENC_SPEED_MAX) {
+		errno = EINVAL;
+		return NULL;
+	}
+	return &k_speed_presets[speed];
+}
+
+// One macroblock of enc_vp8_encode_i16x16_uv_sad_inloop().
+static void i16_uv_sad_mb(const EncMbAnalysis* a, uint32_t mbx, uint32_t mby) {
+	const EncDsp* dsp = enc_dsp();
+	const EncYuv420Image* yuv = a->yuv;
+	const EncVp8ReconPlanes recon = a->recon;
+	const EncVp8QuantFactors qf = a->qf;
+	const uint32_t w = yuv->width;
+	const uint32_t h = yuv->height;
+	const uint32_t uv_w = (w + 1u) >> 1;
+	const uint32_t uv_h = (h + 1u) >> 1;
+	const uint32_t mb_cols = a->mb_cols;
+	const size_t coeffs_per_mb = 16 + (16 * 16) + (4 * 16) + (4 * 16);
+	int16_t* out = a->out;
+	uint8_t* y_modes = a->y_modes;
+	uint8_t* uv_modes = a->uv_modes;
+
+	int16_t tmp[16][16];
+	int16_t y2[16];
+	int16_t y2_deq[16];
+	int16_t y_dc16[16];
+	uint8_t pred_y16[16 * 16];
+	uint8_t pred_tmp[16 * 16];
+	uint8_t pred_u8[8 * 8];
+	uint8_t pred_v8[8 * 8];
+	uint8_t pred_u_tmp[8 * 8];
+	uint8_t pred_v_tmp[8 * 8];
+
+	const uint32_t x0 = mbx * 16u;
+	const uint32_t y0 = mby * 16u;
+	const uint32_t ux0 = mbx * 8u;
+	const uint32_t uy0 = mby * 8u;
+
+	// Build A/L neighbor vectors from reconstructed luma.
+	uint8_t A16[16];
+	uint8_t L16[16];
+	int have_above = (mby > 0);
+	int have_left = (mbx > 0);
+	for (uint32_t i = 0; i < 16; i++) {
+		A16[i] = have_above ? recon.y[(size_t)(y0 - 1) * recon.y_stride + (size_t)(x0 + i)] : 127;
+		L16[i] = have_left ? recon.y[(size_t)(y0 + i) * recon.y_stride + (size_t)(x0 - 1)] : 129;
+	}
+	uint8_t above_left = 127;
+	if (have_above && have_left) {
+		above_left = recon.y[(size_t)(y0 - 1) * recon.y_stride + (size_t)(x0 - 1)];
+	} else {
+		above_left = have_above ? 129 : 127;
+	}
+
+	// Choose I16 mode by SSE (distortion).
+	uint32_t best_sse = 0xFFFFFFFFu;
+	Vp8I16Mode best_mode = VP8_I16_DC_PRED;
+	for (Vp8I16Mode mode = VP8_I16_DC_PRED; mode <= VP8_I16_TM_PRED; mode++) {
+		pred16x16_build(pred_tmp, mode, A16, L16, have_above, have_left, 127, 129, above_left);
+		uint32_t sse = sse16x16_src_vs_pred(yuv, w, h, x0, y0, pred_tmp);
+		if (sse < best_sse) {
+			best_sse = sse;
+			best_mode = mode;
+		}
+	}
+	pred16x16_build(pred_y16, best_mode, A16, L16, have_above, have_left, 127, 129, above_left);
+	const size_t mb_index = (size_t)mby * (size_t)mb_cols + (size_t)mbx;
+	y_modes[mb_index] = (uint8_t)best_mode;
+
+	// Choose UV (8x8) mode by SSE against U+V.
+	int have_above_c = (mby > 0);
+	int have_left_c = (mbx > 0);
+	uint8_t A8u[8];
+	uint8_t L8u[8];
+	uint8_t A8v[8];
+	uint8_t L8v[8];
+	for (uint32_t i = 0; i < 8; i++) {
+		A8u[i] = have_above_c ? recon.u[(size_t)(uy0 - 1) * recon.uv_stride + (size_t)(ux0 + i)] : 127;
+		A8v[i] = have_above_c ? recon.v[(size_t)(uy0 - 1) * recon.uv_stride + (size_t)(ux0 + i)] : 127;
+		L8u[i] = have_left_c ? recon.u[(size_t)(uy0 + i) * recon.uv_stride + (size_t)(ux0 - 1)] : 129;
+		L8v[i] = have_left_c ? recon.v[(size_t)(uy0 + i) * recon.uv_stride + (size_t)(ux0 - 1)] : 129;
+	}
+	uint8_t above_left_u = 127;
+	uint8_t above_left_v = 127;
+	if (have_above_c && have_left_c) {
+		above_left_u = recon.u[(size_t)(uy0 - 1) * recon.uv_stride + (size_t)(ux0 - 1)];
+		above_left_v = recon.v[(size_t)(uy0 - 1) * recon.uv_stride + (size_t)(ux0 - 1)];
+	} else {
+		uint8_t al = have_above_c ? 129 : 127;
+		above_left_u = al;
+		above_left_v = al;
+	}
+
+	uint32_t best_uv_sse = 0xFFFFFFFFu;
+	Vp8I16Mode best_uv_mode = VP8_I16_DC_PRED;
+	for (Vp8I16Mode mode = VP8_I16_DC_PRED; mode <= VP8_I16_TM_PRED; mode++) {
+		pred8x8_build(pred_u_tmp, mode, A8u, L8u, have_above_c, have_left_c, 127, 129, above_left_u);
+		pred8x8_build(pred_v_tmp, mode, A8v, L8v, have_above_c, have_left_c, 127, 129, above_left_v);
+		uint32_t sse_u = sse8x8_plane_src_vs_pred(yuv->u, yuv->uv_stride, uv_w, uv_h, ux0, uy0, pred_u_tmp);
+		uint32_t sse_v = sse8x8_plane_src_vs_pred(yuv->v, yuv->uv_stride, uv_w, uv_h, ux0, uy0, pred_v_tmp);
+		uint32_t sse = sse_u + sse_v;
+		if (sse < best_uv_sse) {
+			best_uv_sse = sse;
+			best_uv_mode = mode;
+		}
+	}
+	pred8x8_build(pred_u8, best_uv_mode, A8u, L8u, have_above_c, have_left_c, 127, 129, above_left_u);
+	pred8x8_build(pred_v8, best_uv_mode, A8v, L8v, have_above_c, have_left_c, 127, 129, above_left_v);
+	uv_modes[mb_index] = (uint8_t)best_uv_mode;
+
+	// Y forward transform (mode-aware predictor), extract DCs into Y2.
+	ftransform_blocks(dsp, yuv->y, yuv->y_stride, w, h, x0, y0, pred_y16, 16, tmp);
+	dsp->ftransform_wht(&tmp[0][0], y2);
+	for (int n = 0; n < 16; ++n) tmp[n][0] = 0;
+
+	// Quantize Y2 and Y blocks.
+	{
+		int16_t y2q[16];
+		for (int i = 0; i < 16; ++i) y2q[i] = y2[i];
+		dsp->quantize4x4(y2q, &a->quant.y2);
+		for (int i = 0; i < 16; ++i) y2[i] = y2q[i];
+	}
+	for (int n = 0; n < 16; ++n) {
+		dsp->quantize4x4(tmp[n], &a->quant.y1);
+	}
+
+	// U/V forward transforms + quant (mode-aware predictors).
+	int16_t ublk[4][16];
+	int16_t vblk[4][16];
+	ftransform_blocks(dsp, yuv->u, yuv->uv_stride, uv_w, uv_h, ux0, uy0, pred_u8, 8, ublk);
+	for (uint32_t n = 0; n < 4; ++n) dsp->quantize4x4(ublk[n], &a->quant.uv);
+	ftransform_blocks(dsp, yuv->v, yuv->uv_stride, uv_w, uv_h, ux0, uy0, pred_v8, 8, vblk);
+	for (uint32_t n = 0; n < 4; ++n) dsp->quantize4x4(vblk[n], &a->quant.uv);
+
+	// Store coeffs for this macroblock.
+	int16_t* dst = out + mb_index * coeffs_per_mb;
+	for (int i = 0; i < 16; ++i) dst[i] = y2[i];
+	dst += 16;
+	for (int n = 0; n < 16; ++n) {
+		for (int i = 0; i < 16; ++i) dst[i] = tmp[n][i];
+		dst += 16;
+	}
+	for (int n = 0; n < 4; ++n) {
+		for (int i = 0; i < 16; ++i) dst[i] = ublk[n][i];
+		dst += 16;
+	}
+	for (int n = 0; n < 4; ++n) {
+		for (int i = 0; i < 16; ++i) dst[i] = vblk[n][i];
+		dst += 16;
+	}
+
+	// Reconstruct Y (mode-aware predictor).
+	for (int i = 0; i < 16; ++i) y2_deq[i] = y2[i];
+	dequant4x4_inplace(y2_deq, qf.y2_dc, qf.y2_ac);
+	inv_wht4x4(y2_deq, y_dc16);
+	for (int n = 0; n < 16; ++n) {
+		int16_t block_coeffs[16];
+		for (int i = 0; i < 16; ++i) block_coeffs[i] = tmp[n][i];
+		dequant4x4_inplace(block_coeffs, qf.y1_dc, qf.y1_ac);
+		// The DC comes from the (already dequantized) inverse WHT.
+		block_coeffs[0] = y_dc16[n];
+		int16_t res[16];
+		inv_dct4x4(block_coeffs, res);
+		const uint32_t bx = (uint32_t)(n & 3) * 4u;
+		const uint32_t by = (uint32_t)(n >> 2) * 4u;
+		for (uint32_t dy = 0; dy < 4; ++dy) {
+			uint8_t* row = recon.y + (size_t)(y0 + by + dy) * recon.y_stride + (size_t)(x0 + bx);
+			for (uint32_t dx = 0; dx < 4; ++dx) {
+				uint8_t p = pred_y16[(by + dy) * 16u + (bx + dx)];
+				int32_t v = (int32_t)p + (int32_t)res[dy * 4 + dx];
+				row[dx] = clamp255_i32(v);
+			}
+		}
+	}
+
+	// Reconstruct U.
+	for (int n = 0; n < 4; ++n) {
+		int16_t block_coeffs[16];
+		for (int i = 0; i < 16; ++i) block_coeffs[i] = ublk[n][i];
+		dequant4x4_inplace(block_coeffs, qf.uv_dc, qf.uv_ac);
+		int16_t res[16];
+		inv_dct4x4(block_coeffs, res);
+		const uint32_t bx = (uint32_t)(n & 1) * 4u;
+		const uint32_t by = (uint32_t)(n >> 1) * 4u;
+		for (uint32_t dy = 0; dy < 4; ++dy) {
+			uint8_t* row = recon.u + (size_t)(uy0 + by + dy) * recon.uv_stride + (size_t)(ux0 + bx);
+			for (uint32_t dx = 0; dx < 4; ++dx) {
+				uint8_t p = pred_u8[(by + dy) * 8u + (bx + dx)];
+				int32_t v = (int32_t)p + (int32_t)res[dy * 4 + dx];
+				row[dx] = clamp255_i32(v);
+			}
+		}
+	}
+
+	// Reconstruct V.
+	for (int n = 0; n < 4; ++n) {
+		int16_t block_coeffs[16];
+		for (int i = 0; i < 16; ++i) block_coeffs[i] = vblk[n][i];
+		dequant4x4_inplace(block_coeffs, qf.uv_dc, qf.uv_ac);
+		int16_t res[16];
+		inv_dct4x4(block_coeffs, res);
+		const uint32_t bx = (uint32_t)(n & 1) * 4u;
+		const uint32_t by = (uint32_t)(n >> 1) * 4u;
+		for (uint32_t dy = 0; dy < 4; ++dy) {
+			uint8_t* row = recon.v + (size_t)(uy0 + by + dy) * recon.uv_stride + (size_t)(ux0 + bx);
+			for (uint32_t dx = 0; dx < 4; ++dx) {
+				uint8_t p = pred_v8[(by + dy) * 8u + (bx + dx)];
+				int32_t v = (int32_t)p + (int32_t)res[dy * 4 + dx];
+				row[dx] = clamp255_i32(v);
+			}
+		}
+	}
+}
 
 int enc_vp8_encode_i16x16_uv_sad_inloop(const EncYuv420Image* yuv,
 	                                    int quality,
+	                                    uint32_t threads,
 	                                    uint8_t** y_modes_out,
 	                                    size_t* y_modes_count_out,
 	                                    uint8_t** uv_modes_out,
@@ -1254,258 +1701,296 @@ int enc_vp8_encode_i16x16_uv_sad_inloop(const EncYuv420Image* yuv,
 	enc_vp8_quant_factors_from_qindex(qindex, 0, 0, 0, 0, 0, &qf);
 	*qindex_out = (uint8_t)qf.qindex;
 
+	EncMbAnalysis a = {.yuv = yuv,
+	                   .recon = recon,
+	                   .qf = qf,
+	                   .mb_cols = mb_cols,
+	                   .mb_rows = mb_rows,
+	                   .threads = threads,
+	                   .out = out,
+	                   .y_modes = y_modes,
+	                   .uv_modes = uv_modes};
+	mb_quant_init(&a.quant, &qf, 0);
+	const int rc = enc_mb_wavefront(&a, i16_uv_sad_mb);
+	enc_vp8_recon_free(&recon);
+	if (rc != 0) {
+		free(out);
+		free(y_modes);
+		free(uv_modes);
+		return -1;
+	}
+	*y_modes_out = y_modes;
+	*y_modes_count_out = (size_t)mb_total;
+	*uv_modes_out = uv_modes;
+	*uv_modes_count_out = (size_t)mb_total;
+	*coeffs_out = out;
+	*coeffs_count_out = coeffs_total;
+	return 0;
+}
+
+int enc_vp8_encode_i16x16_sad_inloop(const EncYuv420Image* yuv,
+	                                int quality,
+	                                uint32_t threads,
+	                                uint8_t** y_modes_out,
+	                                size_t* y_modes_count_out,
+	                                int16_t** coeffs_out,
+	                                size_t* coeffs_count_out,
+	                                uint8_t* qindex_out) {
+	uint8_t* uv_modes = NULL;
+	size_t uv_modes_count = 0;
+	int rc = enc_vp8_encode_i16x16_uv_sad_inloop(yuv,
+	                                           quality,
+	                                           threads,
+	                                           y_modes_out,
+	                                           y_modes_count_out,
+	                                           &uv_modes,
+	                                           &uv_modes_count,
+	                                           coeffs_out,
+	                                           coeffs_count_out,
+	                                           qindex_out);
+	free(uv_modes);
+	return rc;
+}
+
+// One macroblock of enc_vp8_encode_bpred_uv_sad_inloop().
+static void bpred_uv_sad_mb(const EncMbAnalysis* a, uint32_t mbx, uint32_t mby) {
+	const EncDsp* dsp = enc_dsp();
+	const EncYuv420Image* yuv = a->yuv;
+	const EncVp8ReconPlanes recon = a->recon;
+	const EncVp8QuantFactors qf = a->qf;
+	const uint32_t w = yuv->width;
+	const uint32_t h = yuv->height;
 	const uint32_t uv_w = (w + 1u) >> 1;
 	const uint32_t uv_h = (h + 1u) >> 1;
+	const uint32_t mb_cols = a->mb_cols;
+	const size_t coeffs_per_mb = 16 + (16 * 16) + (4 * 16) + (4 * 16);
+	int16_t* out = a->out;
+	uint8_t* y_modes = a->y_modes;
+	uint8_t* uv_modes = a->uv_modes;
+	uint8_t* b_modes = a->b_modes;
 
 	uint8_t src4[16];
-	uint8_t ref4[16];
-	int16_t tmp[16][16];
-	int16_t y2[16];
-	int16_t y2_deq[16];
-	int16_t y_dc16[16];
-
-	uint8_t pred_y16[16 * 16];
-	uint8_t pred_tmp[16 * 16];
+	uint8_t pred4[16];
 	uint8_t pred_u8[8 * 8];
 	uint8_t pred_v8[8 * 8];
 	uint8_t pred_u_tmp[8 * 8];
 	uint8_t pred_v_tmp[8 * 8];
 
-	for (uint32_t mby = 0; mby < mb_rows; ++mby) {
-		for (uint32_t mbx = 0; mbx < mb_cols; ++mbx) {
-			const uint32_t x0 = mbx * 16u;
-			const uint32_t y0 = mby * 16u;
-			const uint32_t ux0 = mbx * 8u;
-			const uint32_t uy0 = mby * 8u;
-
-			// Build A/L neighbor vectors from reconstructed luma.
-			uint8_t A16[16];
-			uint8_t L16[16];
-			int have_above = (mby > 0);
-			int have_left = (mbx > 0);
-			for (uint32_t i = 0; i < 16; i++) {
-				A16[i] = have_above ? recon.y[(size_t)(y0 - 1) * recon.y_stride + (size_t)(x0 + i)] : 127;
-				L16[i] = have_left ? recon.y[(size_t)(y0 + i) * recon.y_stride + (size_t)(x0 - 1)] : 129;
-			}
-			uint8_t above_left = 127;
-			if (have_above && have_left) {
-				above_left = recon.y[(size_t)(y0 - 1) * recon.y_stride + (size_t)(x0 - 1)];
-			} else {
-				above_left = have_above ? 129 : 127;
-			}
+	const uint32_t x0 = mbx * 16u;
+	const uint32_t y0 = mby * 16u;
+	const uint32_t ux0 = mbx * 8u;
+	const uint32_t uy0 = mby * 8u;
+	const size_t mb_index = (size_t)mby * (size_t)mb_cols + (size_t)mbx;
+	y_modes[mb_index] = 4; // default to B_PRED; may be overridden by I16 below
+
+	// Choose UV (8x8) mode by SAD against U+V (uses reconstructed chroma neighbors).
+	int have_above_c = (mby > 0);
+	int have_left_c = (mbx > 0);
+	uint8_t A8u[8];
+	uint8_t L8u[8];
+	uint8_t A8v[8];
+	uint8_t L8v[8];
+	for (uint32_t i = 0; i < 8; i++) {
+		A8u[i] = have_above_c ? recon.u[(size_t)(uy0 - 1) * recon.uv_stride + (size_t)(ux0 + i)] : 127;
+		A8v[i] = have_above_c ? recon.v[(size_t)(uy0 - 1) * recon.uv_stride + (size_t)(ux0 + i)] : 127;
+		L8u[i] = have_left_c ? recon.u[(size_t)(uy0 + i) * recon.uv_stride + (size_t)(ux0 - 1)] : 129;
+		L8v[i] = have_left_c ? recon.v[(size_t)(uy0 + i) * recon.uv_stride + (size_t)(ux0 - 1)] : 129;
+	}
+	uint8_t above_left_u = 127;
+	uint8_t above_left_v = 127;
+	if (have_above_c && have_left_c) {
+		above_left_u = recon.u[(size_t)(uy0 - 1) * recon.uv_stride + (size_t)(ux0 - 1)];
+		above_left_v = recon.v[(size_t)(uy0 - 1) * recon.uv_stride + (size_t)(ux0 - 1)];
+	} else {
+		uint8_t al = have_above_c ? 129 : 127;
+		above_left_u = al;
+		above_left_v = al;
+	}
+	uint32_t best_uv_sad = 0xFFFFFFFFu;
+	Vp8I16Mode best_uv_mode = VP8_I16_DC_PRED;
+	for (Vp8I16Mode mode = VP8_I16_DC_PRED; mode <= VP8_I16_TM_PRED; mode++) {
+		pred8x8_build(pred_u_tmp, mode, A8u, L8u, have_above_c, have_left_c, 127, 129, above_left_u);
+		pred8x8_build(pred_v_tmp, mode, A8v, L8v, have_above_c, have_left_c, 127, 129, above_left_v);
+		uint32_t sad_u = sad8x8_plane_src_vs_pred(yuv->u, yuv->uv_stride, uv_w, uv_h, ux0, uy0, pred_u_tmp);
+		uint32_t sad_v = sad8x8_plane_src_vs_pred(yuv->v, yuv->uv_stride, uv_w, uv_h, ux0, uy0, pred_v_tmp);
+		uint32_t sad = sad_u + sad_v;
+		if (sad < best_uv_sad) {
+			best_uv_sad = sad;
+			best_uv_mode = mode;
+		}
+	}
+	pred8x8_build(pred_u8, best_uv_mode, A8u, L8u, have_above_c, have_left_c, 127, 129, above_left_u);
+	pred8x8_build(pred_v8, best_uv_mode, A8v, L8v, have_above_c, have_left_c, 127, 129, above_left_v);
+	uv_modes[mb_index] = (uint8_t)best_uv_mode;
 
-			// Choose I16 mode by SSE (distortion).
-			uint32_t best_sse = 0xFFFFFFFFu;
-			Vp8I16Mode best_mode = VP8_I16_DC_PRED;
-			for (Vp8I16Mode mode = VP8_I16_DC_PRED; mode <= VP8_I16_TM_PRED; mode++) {
-				pred16x16_build(pred_tmp, mode, A16, L16, have_above, have_left, 127, 129, above_left);
-				uint32_t sse = sse16x16_src_vs_pred(yuv, w, h, x0, y0, pred_tmp);
-				if (sse < best_sse) {
-					best_sse = sse;
-					best_mode = mode;
-				}
-			}
-			pred16x16_build(pred_y16, best_mode, A16, L16, have_above, have_left, 127, 129, above_left);
-			const size_t mb_index = (size_t)mby * (size_t)mb_cols + (size_t)mbx;
-			y_modes[mb_index] = (uint8_t)best_mode;
-
-			// Choose UV (8x8) mode by SSE against U+V.
-			int have_above_c = (mby > 0);
-			int have_left_c = (mbx > 0);
-			uint8_t A8u[8];
-			uint8_t L8u[8];
-			uint8_t A8v[8];
-			uint8_t L8v[8];
-			for (uint32_t i = 0; i < 8; i++) {
-				A8u[i] = have_above_c ? recon.u[(size_t)(uy0 - 1) * recon.uv_stride + (size_t)(ux0 + i)] : 127;
-				A8v[i] = have_above_c ? recon.v[(size_t)(uy0 - 1) * recon.uv_stride + (size_t)(ux0 + i)] : 127;
-				L8u[i] = have_left_c ? recon.u[(size_t)(uy0 + i) * recon.uv_stride + (size_t)(ux0 - 1)] : 129;
-				L8v[i] = have_left_c ? recon.v[(size_t)(uy0 + i) * recon.uv_stride + (size_t)(ux0 - 1)] : 129;
-			}
-			uint8_t above_left_u = 127;
-			uint8_t above_left_v = 127;
-			if (have_above_c && have_left_c) {
-				above_left_u = recon.u[(size_t)(uy0 - 1) * recon.uv_stride + (size_t)(ux0 - 1)];
-				above_left_v = recon.v[(size_t)(uy0 - 1) * recon.uv_stride + (size_t)(ux0 - 1)];
-			} else {
-				uint8_t al = have_above_c ? 129 : 127;
-				above_left_u = al;
-				above_left_v = al;
-			}
+	// Luma: per subblock choose B mode by SAD; forward transform/quant; reconstruct in scan order.
+	for (uint32_t sb_r = 0; sb_r < 4; sb_r++) {
+		for (uint32_t sb_c = 0; sb_c < 4; sb_c++) {
+			const uint32_t sx = x0 + sb_c * 4u;
+			const uint32_t sy = y0 + sb_r * 4u;
 
-			uint32_t best_uv_sse = 0xFFFFFFFFu;
-			Vp8I16Mode best_uv_mode = VP8_I16_DC_PRED;
-			for (Vp8I16Mode mode = VP8_I16_DC_PRED; mode <= VP8_I16_TM_PRED; mode++) {
-				pred8x8_build(pred_u_tmp, mode, A8u, L8u, have_above_c, have_left_c, 127, 129, above_left_u);
-				pred8x8_build(pred_v_tmp, mode, A8v, L8v, have_above_c, have_left_c, 127, 129, above_left_v);
-				uint32_t sse_u = sse8x8_plane_src_vs_pred(yuv->u, yuv->uv_stride, uv_w, uv_h, ux0, uy0, pred_u_tmp);
-				uint32_t sse_v = sse8x8_plane_src_vs_pred(yuv->v, yuv->uv_stride, uv_w, uv_h, ux0, uy0, pred_v_tmp);
-				uint32_t sse = sse_u + sse_v;
-				if (sse < best_uv_sse) {
-					best_uv_sse = sse;
-					best_uv_mode = mode;
+			uint8_t A8[9];
+			uint8_t L4[4];
+			// Top-left (P)
+			if (sy == 0) A8[0] = 127;
+			else if (sx == 0) A8[0] = 129;
+			else A8[0] = recon.y[(size_t)(sy - 1) * recon.y_stride + (size_t)(sx - 1)];
+
+			// Above row A[0..7] in A8[1..8].
+			for (uint32_t i = 0; i < 8; i++) {
+				if (sy == 0) {
+					A8[1 + i] = 127;
+					continue;
 				}
-			}
-			pred8x8_build(pred_u8, best_uv_mode, A8u, L8u, have_above_c, have_left_c, 127, 129, above_left_u);
-			pred8x8_build(pred_v8, best_uv_mode, A8v, L8v, have_above_c, have_left_c, 127, 129, above_left_v);
-			uv_modes[mb_index] = (uint8_t)best_uv_mode;
-
-			// Y forward transform (mode-aware predictor), extract DCs into Y2.
-			for (uint32_t n = 0; n < 16; ++n) {
-				const uint32_t bx = (n & 3u) * 4u;
-				const uint32_t by = (n >> 2) * 4u;
-				fill4x4_clamped(src4, yuv->y, yuv->y_stride, w, h, x0 + bx, y0 + by);
-				pred16_fill4x4(ref4, pred_y16, bx, by);
-				enc_vp8_ftransform4x4(src4, 4, ref4, 4, tmp[n]);
-			}
-			enc_vp8_ftransform_wht(&tmp[0][0], y2);
-			for (int n = 0; n < 16; ++n) tmp[n][0] = 0;
-
-			// Quantize Y2 and Y blocks.
-			{
-				int16_t y2q[16];
-				for (int i = 0; i < 16; ++i) y2q[i] = y2[i];
-				enc_vp8_quantize4x4_inplace(y2q, qf.y2_dc, qf.y2_ac);
-				for (int i = 0; i < 16; ++i) y2[i] = y2q[i];
-			}
-			for (int n = 0; n < 16; ++n) {
-				enc_vp8_quantize4x4_inplace(tmp[n], qf.y1_dc, qf.y1_ac);
+				uint32_t row = sy - 1;
+				uint32_t col;
+				if (sb_c == 3 && i >= 4) {
+					// RFC 6386 11.4: right-edge special case.
+					if (y0 == 0) {
+						A8[1 + i] = 127;
+						continue;
+					}
+					row = y0 - 1;
+					col = x0 + 16u + (i - 4u);
+				} else {
+					col = sx + i;
+				}
+				// recon is padded to macroblock size; still clamp for safety.
+				uint32_t max_row = recon.mb_rows * 16u;
+				uint32_t max_col = recon.mb_cols * 16u;
+				if (max_row) {
+					if (row >= max_row) row = max_row - 1u;
+				}
+				if (max_col) {
+					if (col >= max_col) col = max_col - 1u;
+				}
+				A8[1 + i] = recon.y[(size_t)row * recon.y_stride + (size_t)col];
 			}
 
-			// U/V forward transforms + quant (mode-aware predictors).
-			int16_t ublk[4][16];
-			int16_t vblk[4][16];
-			for (uint32_t n = 0; n < 4; ++n) {
-				const uint32_t bx = (n & 1u) * 4u;
-				const uint32_t by = (n >> 1) * 4u;
-				fill4x4_clamped(src4, yuv->u, yuv->uv_stride, uv_w, uv_h, ux0 + bx, uy0 + by);
-				pred8_fill4x4(ref4, pred_u8, bx, by);
-				enc_vp8_ftransform4x4(src4, 4, ref4, 4, ublk[n]);
-				enc_vp8_quantize4x4_inplace(ublk[n], qf.uv_dc, qf.uv_ac);
-			}
-			for (uint32_t n = 0; n < 4; ++n) {
-				const uint32_t bx = (n & 1u) * 4u;
-				const uint32_t by = (n >> 1) * 4u;
-				fill4x4_clamped(src4, yuv->v, yuv->uv_stride, uv_w, uv_h, ux0 + bx, uy0 + by);
-				pred8_fill4x4(ref4, pred_v8, bx, by);
-				enc_vp8_ftransform4x4(src4, 4, ref4, 4, vblk[n]);
-				enc_vp8_quantize4x4_inplace(vblk[n], qf.uv_dc, qf.uv_ac);
+			// Left column.
+			if (sx == 0) {
+				for (uint32_t i = 0; i < 4; i++) L4[i] = 129;
+			} else {
+				for (uint32_t i = 0; i < 4; i++) {
+					uint32_t row = sy + i;
+					uint32_t max_row = recon.mb_rows * 16u;
+					if (max_row && row >= max_row) row = max_row - 1u;
+					L4[i] = recon.y[(size_t)row * recon.y_stride + (size_t)(sx - 1)];
+				}
 			}
 
-			// Store coeffs for this macroblock.
-			int16_t* dst = out + mb_index * coeffs_per_mb;
-			for (int i = 0; i < 16; ++i) dst[i] = y2[i];
-			dst += 16;
-			for (int n = 0; n < 16; ++n) {
-				for (int i = 0; i < 16; ++i) dst[i] = tmp[n][i];
-				dst += 16;
-			}
-			for (int n = 0; n < 4; ++n) {
-				for (int i = 0; i < 16; ++i) dst[i] = ublk[n][i];
-				dst += 16;
-			}
-			for (int n = 0; n < 4; ++n) {
-				for (int i = 0; i < 16; ++i) dst[i] = vblk[n][i];
-				dst += 16;
-			}
+			fill4x4_clamped(src4, yuv->y, yuv->y_stride, w, h, sx, sy);
 
-			// Reconstruct Y (mode-aware predictor).
-			for (int i = 0; i < 16; ++i) y2_deq[i] = y2[i];
-			dequant4x4_inplace(y2_deq, qf.y2_dc, qf.y2_ac);
-			inv_wht4x4(y2_deq, y_dc16);
-			for (int n = 0; n < 16; ++n) {
-				int16_t block_coeffs[16];
-				for (int i = 0; i < 16; ++i) block_coeffs[i] = tmp[n][i];
-				block_coeffs[0] = y_dc16[n];
-				dequant4x4_inplace(block_coeffs, qf.y1_dc, qf.y1_ac);
-				int16_t res[16];
-				inv_dct4x4(block_coeffs, res);
-				const uint32_t bx = (uint32_t)(n & 3) * 4u;
-				const uint32_t by = (uint32_t)(n >> 2) * 4u;
-				for (uint32_t dy = 0; dy < 4; ++dy) {
-					uint8_t* row = recon.y + (size_t)(y0 + by + dy) * recon.y_stride + (size_t)(x0 + bx);
-					for (uint32_t dx = 0; dx < 4; ++dx) {
-						uint8_t p = pred_y16[(by + dy) * 16u + (bx + dx)];
-						int32_t v = (int32_t)p + (int32_t)res[dy * 4 + dx];
-						row[dx] = clamp255_i32(v);
-					}
+			uint32_t best_sad = 0xFFFFFFFFu;
+			Vp8BMode best_mode = B_DC_PRED;
+			fill4x4_clamped(src4, yuv->y, yuv->y_stride, w, h, sx, sy);
+			for (Vp8BMode mode = B_DC_PRED; mode <= B_HU_PRED; mode++) {
+				bpred4x4(pred4, &A8[1], L4, mode);
+				uint32_t sad = sad4x4_u8(src4, pred4);
+				if (sad < best_sad) {
+					best_sad = sad;
+					best_mode = mode;
 				}
 			}
+			b_modes[mb_index * 16u + (size_t)(sb_r * 4u + sb_c)] = (uint8_t)best_mode;
+			bpred4x4(pred4, &A8[1], L4, best_mode);
+			int16_t coeff[16];
+			dsp->ftransform4x4(src4, 4, pred4, 4, coeff);
+			dsp->quantize4x4(coeff, &a->quant.y1);
 
-			// Reconstruct U.
-			for (int n = 0; n < 4; ++n) {
-				int16_t block_coeffs[16];
-				for (int i = 0; i < 16; ++i) block_coeffs[i] = ublk[n][i];
-				dequant4x4_inplace(block_coeffs, qf.uv_dc, qf.uv_ac);
-				int16_t res[16];
-				inv_dct4x4(block_coeffs, res);
-				const uint32_t bx = (uint32_t)(n & 1) * 4u;
-				const uint32_t by = (uint32_t)(n >> 1) * 4u;
-				for (uint32_t dy = 0; dy < 4; ++dy) {
-					uint8_t* row = recon.u + (size_t)(uy0 + by + dy) * recon.uv_stride + (size_t)(ux0 + bx);
-					for (uint32_t dx = 0; dx < 4; ++dx) {
-						uint8_t p = pred_u8[(by + dy) * 8u + (bx + dx)];
-						int32_t v = (int32_t)p + (int32_t)res[dy * 4 + dx];
-						row[dx] = clamp255_i32(v);
-					}
+			// Store coeffs: Y2 is not coded; keep it 0. Y blocks start at +16.
+			int16_t* mbdst = out + mb_index * coeffs_per_mb;
+			int16_t* ydst = mbdst + 16;
+			const size_t blk = (size_t)(sb_r * 4u + sb_c);
+			for (int i = 0; i < 16; i++) ydst[blk * 16u + (size_t)i] = coeff[i];
+
+			// Reconstruct into recon.y
+			int16_t deq[16];
+			for (int i = 0; i < 16; i++) deq[i] = coeff[i];
+			dequant4x4_inplace(deq, qf.y1_dc, qf.y1_ac);
+			int16_t res[16];
+			inv_dct4x4(deq, res);
+			for (uint32_t dy = 0; dy < 4; dy++) {
+				uint8_t* row = recon.y + (size_t)(sy + dy) * recon.y_stride + (size_t)sx;
+				for (uint32_t dx = 0; dx < 4; dx++) {
+					int32_t v = (int32_t)pred4[dy * 4u + dx] + (int32_t)res[(int)(dy * 4u + dx)];
+					row[dx] = clamp255_i32(v);
 				}
 			}
+		}
+	}
 
-			// Reconstruct V.
-			for (int n = 0; n < 4; ++n) {
-				int16_t block_coeffs[16];
-				for (int i = 0; i < 16; ++i) block_coeffs[i] = vblk[n][i];
-				dequant4x4_inplace(block_coeffs, qf.uv_dc, qf.uv_ac);
-				int16_t res[16];
-				inv_dct4x4(block_coeffs, res);
-				const uint32_t bx = (uint32_t)(n & 1) * 4u;
-				const uint32_t by = (uint32_t)(n >> 1) * 4u;
-				for (uint32_t dy = 0; dy < 4; ++dy) {
-					uint8_t* row = recon.v + (size_t)(uy0 + by + dy) * recon.uv_stride + (size_t)(ux0 + bx);
-					for (uint32_t dx = 0; dx < 4; ++dx) {
-						uint8_t p = pred_v8[(by + dy) * 8u + (bx + dx)];
-						int32_t v = (int32_t)p + (int32_t)res[dy * 4 + dx];
-						row[dx] = clamp255_i32(v);
-					}
-				}
+	// U/V forward transforms + quant (mode-aware predictors).
+	int16_t ublk[4][16];
+	int16_t vblk[4][16];
+	for (uint32_t n = 0; n < 4; ++n) {
+		const uint32_t bx = (n & 1u) * 4u;
+		const uint32_t by = (n >> 1) * 4u;
+		fill4x4_clamped(src4, yuv->u, yuv->uv_stride, uv_w, uv_h, ux0 + bx, uy0 + by);
+		pred8_fill4x4(pred4, pred_u8, bx, by);
+		dsp->ftransform4x4(src4, 4, pred4, 4, ublk[n]);
+		dsp->quantize4x4(ublk[n], &a->quant.uv);
+	}
+	for (uint32_t n = 0; n < 4; ++n) {
+		const uint32_t bx = (n & 1u) * 4u;
+		const uint32_t by = (n >> 1) * 4u;
+		fill4x4_clamped(src4, yuv->v, yuv->uv_stride, uv_w, uv_h, ux0 + bx, uy0 + by);
+		pred8_fill4x4(pred4, pred_v8, bx, by);
+		dsp->ftransform4x4(src4, 4, pred4, 4, vblk[n]);
+		dsp->quantize4x4(vblk[n], &a->quant.uv);
+	}
+
+	// Store U/V coeffs after Y.
+	int16_t* dst = out + mb_index * coeffs_per_mb + 16 + (16 * 16);
+	for (int n = 0; n < 4; ++n) {
+		for (int i = 0; i < 16; ++i) dst[i] = ublk[n][i];
+		dst += 16;
+	}
+	for (int n = 0; n < 4; ++n) {
+		for (int i = 0; i < 16; ++i) dst[i] = vblk[n][i];
+		dst += 16;
+	}
+
+	// Reconstruct U/V.
+	for (int n = 0; n < 4; ++n) {
+		int16_t block_coeffs[16];
+		for (int i = 0; i < 16; ++i) block_coeffs[i] = ublk[n][i];
+		dequant4x4_inplace(block_coeffs, qf.uv_dc, qf.uv_ac);
+		int16_t res[16];
+		inv_dct4x4(block_coeffs, res);
+		const uint32_t bx = (uint32_t)(n & 1) * 4u;
+		const uint32_t by = (uint32_t)(n >> 1) * 4u;
+		for (uint32_t dy = 0; dy < 4; ++dy) {
+			uint8_t* row = recon.u + (size_t)(uy0 + by + dy) * recon.uv_stride + (size_t)(ux0 + bx);
+			for (uint32_t dx = 0; dx < 4; ++dx) {
+				uint8_t p = pred_u8[(by + dy) * 8u + (bx + dx)];
+				int32_t v = (int32_t)p + (int32_t)res[(int)(dy * 4u + dx)];
+				row[dx] = clamp255_i32(v);
+			}
+		}
+	}
+	for (int n = 0; n < 4; ++n) {
+		int16_t block_coeffs[16];
+		for (int i = 0; i < 16; ++i) block_coeffs[i] = vblk[n][i];
+		dequant4x4_inplace(block_coeffs, qf.uv_dc, qf.uv_ac);
+		int16_t res[16];
+		inv_dct4x4(block_coeffs, res);
+		const uint32_t bx = (uint32_t)(n & 1) * 4u;
+		const uint32_t by = (uint32_t)(n >> 1) * 4u;
+		for (uint32_t dy = 0; dy < 4; ++dy) {
+			uint8_t* row = recon.v + (size_t)(uy0 + by + dy) * recon.uv_stride + (size_t)(ux0 + bx);
+			for (uint32_t dx = 0; dx < 4; ++dx) {
+				uint8_t p = pred_v8[(by + dy) * 8u + (bx + dx)];
+				int32_t v = (int32_t)p + (int32_t)res[(int)(dy * 4u + dx)];
+				row[dx] = clamp255_i32(v);
 			}
 		}
 	}
-
-	enc_vp8_recon_free(&recon);
-	*y_modes_out = y_modes;
-	*y_modes_count_out = (size_t)mb_total;
-	*uv_modes_out = uv_modes;
-	*uv_modes_count_out = (size_t)mb_total;
-	*coeffs_out = out;
-	*coeffs_count_out = coeffs_total;
-	return 0;
-}
-
-int enc_vp8_encode_i16x16_sad_inloop(const EncYuv420Image* yuv,
-	                                int quality,
-	                                uint8_t** y_modes_out,
-	                                size_t* y_modes_count_out,
-	                                int16_t** coeffs_out,
-	                                size_t* coeffs_count_out,
-	                                uint8_t* qindex_out) {
-	uint8_t* uv_modes = NULL;
-	size_t uv_modes_count = 0;
-	int rc = enc_vp8_encode_i16x16_uv_sad_inloop(yuv,
-	                                           quality,
-	                                           y_modes_out,
-	                                           y_modes_count_out,
-	                                           &uv_modes,
-	                                           &uv_modes_count,
-	                                           coeffs_out,
-	                                           coeffs_count_out,
-	                                           qindex_out);
-	free(uv_modes);
-	return rc;
 }
 
 int enc_vp8_encode_bpred_uv_sad_inloop(const EncYuv420Image* yuv,
 								 int quality,
+								 uint32_t threads,
 								 uint8_t** y_modes_out,
 								 size_t* y_modes_count_out,
 								 uint8_t** b_modes_out,
@@ -1581,19 +2066,70 @@ int enc_vp8_encode_bpred_uv_sad_inloop(const EncYuv420Image* yuv,
 	enc_vp8_quant_factors_from_qindex(qindex, 0, 0, 0, 0, 0, &qf);
 	*qindex_out = (uint8_t)qf.qindex;
 
+	EncMbAnalysis a = {.yuv = yuv,
+	                   .recon = recon,
+	                   .qf = qf,
+	                   .mb_cols = mb_cols,
+	                   .mb_rows = mb_rows,
+	                   .threads = threads,
+	                   .out = out,
+	                   .y_modes = y_modes,
+	                   .uv_modes = uv_modes,
+	                   .b_modes = b_modes};
+	mb_quant_init(&a.quant, &qf, 0);
+	const int rc = enc_mb_wavefront(&a, bpred_uv_sad_mb);
+	enc_vp8_recon_free(&recon);
+	if (rc != 0) {
+		free(out);
+		free(y_modes);
+		free(uv_modes);
+		free(b_modes);
+		return -1;
+	}
+	*y_modes_out = y_modes;
+	*y_modes_count_out = (size_t)mb_total;
+	*b_modes_out = b_modes;
+	*b_modes_count_out = (size_t)mb_total * 16u;
+	*uv_modes_out = uv_modes;
+	*uv_modes_count_out = (size_t)mb_total;
+	*coeffs_out = out;
+	*coeffs_count_out = coeffs_total;
+	return 0;
+}
+
+
+// One macroblock of enc_vp8_encode_bpred_uv_rdo_inloop_pass().
+static void bpred_uv_rdo_mb(const EncMbAnalysis* a, uint32_t mbx, uint32_t mby) {
+	const EncDsp* dsp = enc_dsp();
+	const EncYuv420Image* yuv = a->yuv;
+	const EncVp8ReconPlanes recon = a->recon;
+	const EncVp8QuantFactors qf = a->qf;
+	const uint32_t w = yuv->width;
+	const uint32_t h = yuv->height;
 	const uint32_t uv_w = (w + 1u) >> 1;
 	const uint32_t uv_h = (h + 1u) >> 1;
-
-	uint32_t ymode_min_bits_q8 = 0xFFFFFFFFu;
-	for (int m = 0; m <= 4; m++) {
-		const uint32_t bits_q8 = enc_vp8_estimate_keyframe_ymode_bits_q8(m);
-		if (bits_q8 < ymode_min_bits_q8) ymode_min_bits_q8 = bits_q8;
-	}
-	uint32_t uv_mode_min_bits_q8 = 0xFFFFFFFFu;
-	for (int m = 0; m <= 3; m++) {
-		const uint32_t bits_q8 = enc_vp8_estimate_keyframe_uv_mode_bits_q8(m);
-		if (bits_q8 < uv_mode_min_bits_q8) uv_mode_min_bits_q8 = bits_q8;
-	}
+	const uint32_t mb_cols = a->mb_cols;
+	const size_t coeffs_per_mb = 16 + (16 * 16) + (4 * 16) + (4 * 16);
+	int16_t* out = a->out;
+	uint8_t* y_modes = a->y_modes;
+	uint8_t* uv_modes = a->uv_modes;
+	uint8_t* b_modes = a->b_modes;
+	const uint8_t(*coeff_probs_override)[8][3][11] = a->coeff_probs_override;
+	const EncVp8TokenCosts* token_costs = a->token_costs;
+	if (a->refine_rows) {
+		const uint32_t slot = (mby / a->refine_rows) & 1u;
+		coeff_probs_override = a->band_probs[slot];
+		token_costs = a->band_costs[slot];
+	}
+	const uint32_t lambda_mul = a->rdo.lambda_mul;
+	const uint32_t lambda_div = a->rdo.lambda_div;
+	const int use_entropy_rate = a->rdo.use_entropy_rate;
+	const int use_mb_rate = a->rdo.use_mb_rate;
+	const int use_entropy_signal = a->rdo.use_entropy_signal;
+	const uint32_t satd_prune_k = a->rdo.satd_prune_k;
+	const uint32_t satd_prune_min_qindex = 12;
+	const uint32_t ymode_min_bits_q8 = a->rdo.ymode_min_bits_q8;
+	const uint32_t uv_mode_min_bits_q8 = a->rdo.uv_mode_min_bits_q8;
 
 	uint8_t src4[16];
 	uint8_t pred4[16];
@@ -1602,237 +2138,726 @@ int enc_vp8_encode_bpred_uv_sad_inloop(const EncYuv420Image* yuv,
 	uint8_t pred_u_tmp[8 * 8];
 	uint8_t pred_v_tmp[8 * 8];
 
-	for (uint32_t mby = 0; mby < mb_rows; ++mby) {
-		for (uint32_t mbx = 0; mbx < mb_cols; ++mbx) {
-			const uint32_t x0 = mbx * 16u;
-			const uint32_t y0 = mby * 16u;
-			const uint32_t ux0 = mbx * 8u;
-			const uint32_t uy0 = mby * 8u;
-			const size_t mb_index = (size_t)mby * (size_t)mb_cols + (size_t)mbx;
-			y_modes[mb_index] = 4; // default to B_PRED; may be overridden by I16 below
-
-			// Choose UV (8x8) mode by SAD against U+V (uses reconstructed chroma neighbors).
-			int have_above_c = (mby > 0);
-			int have_left_c = (mbx > 0);
-			uint8_t A8u[8];
-			uint8_t L8u[8];
-			uint8_t A8v[8];
-			uint8_t L8v[8];
-			for (uint32_t i = 0; i < 8; i++) {
-				A8u[i] = have_above_c ? recon.u[(size_t)(uy0 - 1) * recon.uv_stride + (size_t)(ux0 + i)] : 127;
-				A8v[i] = have_above_c ? recon.v[(size_t)(uy0 - 1) * recon.uv_stride + (size_t)(ux0 + i)] : 127;
-				L8u[i] = have_left_c ? recon.u[(size_t)(uy0 + i) * recon.uv_stride + (size_t)(ux0 - 1)] : 129;
-				L8v[i] = have_left_c ? recon.v[(size_t)(uy0 + i) * recon.uv_stride + (size_t)(ux0 - 1)] : 129;
+	const uint32_t x0 = mbx * 16u;
+	const uint32_t y0 = mby * 16u;
+	const uint32_t ux0 = mbx * 8u;
+	const uint32_t uy0 = mby * 8u;
+	const size_t mb_index = (size_t)mby * (size_t)mb_cols + (size_t)mbx;
+	y_modes[mb_index] = 4; // B_PRED
+
+	// --- UV (8x8) mode selection (quantization-aware SSE) ---
+	int have_above_c = (mby > 0);
+	int have_left_c = (mbx > 0);
+	uint8_t A8u[8];
+	uint8_t L8u[8];
+	uint8_t A8v[8];
+	uint8_t L8v[8];
+	for (uint32_t i = 0; i < 8; i++) {
+		A8u[i] = have_above_c ? recon.u[(size_t)(uy0 - 1) * recon.uv_stride + (size_t)(ux0 + i)] : 127;
+		A8v[i] = have_above_c ? recon.v[(size_t)(uy0 - 1) * recon.uv_stride + (size_t)(ux0 + i)] : 127;
+		L8u[i] = have_left_c ? recon.u[(size_t)(uy0 + i) * recon.uv_stride + (size_t)(ux0 - 1)] : 129;
+		L8v[i] = have_left_c ? recon.v[(size_t)(uy0 + i) * recon.uv_stride + (size_t)(ux0 - 1)] : 129;
+	}
+	uint8_t above_left_u = 127;
+	uint8_t above_left_v = 127;
+	if (have_above_c && have_left_c) {
+		above_left_u = recon.u[(size_t)(uy0 - 1) * recon.uv_stride + (size_t)(ux0 - 1)];
+		above_left_v = recon.v[(size_t)(uy0 - 1) * recon.uv_stride + (size_t)(ux0 - 1)];
+	} else {
+		uint8_t al = have_above_c ? 129 : 127;
+		above_left_u = al;
+		above_left_v = al;
+	}
+
+	uint32_t best_uv_sse = 0xFFFFFFFFu;
+	Vp8I16Mode best_uv_mode = VP8_I16_DC_PRED;
+	// Zeroed for -Wmaybe-uninitialized only: DC_PRED is always evaluated.
+	int16_t best_ublk[4][16] = {{0}};
+	int16_t best_vblk[4][16] = {{0}};
+	uint8_t best_pred_u8[8 * 8] = {0};
+	uint8_t best_pred_v8[8 * 8] = {0};
+	const uint32_t lambda_uv = rdo_lambda_from_qindex(qf.qindex, lambda_mul, lambda_div);
+
+	for (Vp8I16Mode mode = VP8_I16_DC_PRED; mode <= VP8_I16_TM_PRED; mode++) {
+		pred8x8_build(pred_u_tmp, mode, A8u, L8u, have_above_c, have_left_c, 127, 129, above_left_u);
+		pred8x8_build(pred_v_tmp, mode, A8v, L8v, have_above_c, have_left_c, 127, 129, above_left_v);
+
+		uint32_t sse = 0;
+		uint32_t rate = 0;
+		if (use_entropy_signal) {
+			const uint32_t bits_q8 = enc_vp8_estimate_keyframe_uv_mode_bits_q8((int)mode);
+			rate += rdo_rate_from_mode_bits_q8(bits_q8 - uv_mode_min_bits_q8);
+		} else {
+			rate += rdo_uv_mode_signal_cost(mode);
+		}
+		uint8_t u_has[2][2] = {{0, 0}, {0, 0}};
+		uint8_t v_has[2][2] = {{0, 0}, {0, 0}};
+		int16_t ublk_tmp[4][16];
+		int16_t vblk_tmp[4][16];
+		ftransform_blocks(dsp, yuv->u, yuv->uv_stride, uv_w, uv_h, ux0, uy0, pred_u_tmp, 8, ublk_tmp);
+		ftransform_blocks(dsp, yuv->v, yuv->uv_stride, uv_w, uv_h, ux0, uy0, pred_v_tmp, 8, vblk_tmp);
+
+		for (uint32_t n = 0; n < 4; ++n) {
+			const uint32_t bx = (n & 1u) * 4u;
+			const uint32_t by = (n >> 1) * 4u;
+
+			fill4x4_clamped(src4, yuv->u, yuv->uv_stride, uv_w, uv_h, ux0 + bx, uy0 + by);
+			pred8_fill4x4(pred4, pred_u_tmp, bx, by);
+			dsp->quantize4x4(ublk_tmp[n], &a->quant.uv);
+			refine_dc_quant4x4(ublk_tmp[n], qf.uv_dc, qf.uv_ac, src4, pred4);
+			if (use_entropy_rate && !use_mb_rate) {
+				uint8_t has = 0;
+				uint8_t left_has = (bx == 0) ? 0 : u_has[by >> 2][(bx >> 2) - 1];
+				uint8_t above_has = (by == 0) ? 0 : u_has[(by >> 2) - 1][bx >> 2];
+				rate += rdo_rate_from_token_bits_q8(
+					enc_vp8_estimate_keyframe_block_token_bits_q8_probs(
+						2,
+						0,
+						left_has,
+						above_has,
+						ublk_tmp[n],
+						&has,
+						coeff_probs_override));
+				u_has[by >> 2][bx >> 2] = has;
+			} else if (!use_entropy_rate) {
+				rate += rdo_rate_proxy4x4(ublk_tmp[n]);
 			}
-			uint8_t above_left_u = 127;
-			uint8_t above_left_v = 127;
-			if (have_above_c && have_left_c) {
-				above_left_u = recon.u[(size_t)(uy0 - 1) * recon.uv_stride + (size_t)(ux0 - 1)];
-				above_left_v = recon.v[(size_t)(uy0 - 1) * recon.uv_stride + (size_t)(ux0 - 1)];
-			} else {
-				uint8_t al = have_above_c ? 129 : 127;
-				above_left_u = al;
-				above_left_v = al;
+			int16_t deq[16];
+			for (int i = 0; i < 16; i++) deq[i] = ublk_tmp[n][i];
+			dequant4x4_inplace(deq, qf.uv_dc, qf.uv_ac);
+			int16_t res[16];
+			inv_dct4x4(deq, res);
+			for (int i = 0; i < 16; i++) {
+				int32_t v = (int32_t)pred4[i] + (int32_t)res[i];
+				uint8_t r = clamp255_i32(v);
+				int d = (int)src4[i] - (int)r;
+				sse += (uint32_t)(d * d);
 			}
-			uint32_t best_uv_sad = 0xFFFFFFFFu;
-			Vp8I16Mode best_uv_mode = VP8_I16_DC_PRED;
-			for (Vp8I16Mode mode = VP8_I16_DC_PRED; mode <= VP8_I16_TM_PRED; mode++) {
-				pred8x8_build(pred_u_tmp, mode, A8u, L8u, have_above_c, have_left_c, 127, 129, above_left_u);
-				pred8x8_build(pred_v_tmp, mode, A8v, L8v, have_above_c, have_left_c, 127, 129, above_left_v);
-				uint32_t sad_u = sad8x8_plane_src_vs_pred(yuv->u, yuv->uv_stride, uv_w, uv_h, ux0, uy0, pred_u_tmp);
-				uint32_t sad_v = sad8x8_plane_src_vs_pred(yuv->v, yuv->uv_stride, uv_w, uv_h, ux0, uy0, pred_v_tmp);
-				uint32_t sad = sad_u + sad_v;
-				if (sad < best_uv_sad) {
-					best_uv_sad = sad;
-					best_uv_mode = mode;
-				}
+		}
+		for (uint32_t n = 0; n < 4; ++n) {
+			const uint32_t bx = (n & 1u) * 4u;
+			const uint32_t by = (n >> 1) * 4u;
+
+			fill4x4_clamped(src4, yuv->v, yuv->uv_stride, uv_w, uv_h, ux0 + bx, uy0 + by);
+			pred8_fill4x4(pred4, pred_v_tmp, bx, by);
+			dsp->quantize4x4(vblk_tmp[n], &a->quant.uv);
+			refine_dc_quant4x4(vblk_tmp[n], qf.uv_dc, qf.uv_ac, src4, pred4);
+			if (use_entropy_rate && !use_mb_rate) {
+				uint8_t has = 0;
+				uint8_t left_has = (bx == 0) ? 0 : v_has[by >> 2][(bx >> 2) - 1];
+				uint8_t above_has = (by == 0) ? 0 : v_has[(by >> 2) - 1][bx >> 2];
+				rate += rdo_rate_from_token_bits_q8(
+					enc_vp8_estimate_keyframe_block_token_bits_q8_probs(
+						2,
+						0,
+						left_has,
+						above_has,
+						vblk_tmp[n],
+						&has,
+						coeff_probs_override));
+				v_has[by >> 2][bx >> 2] = has;
+			} else if (!use_entropy_rate) {
+				rate += rdo_rate_proxy4x4(vblk_tmp[n]);
 			}
-			pred8x8_build(pred_u8, best_uv_mode, A8u, L8u, have_above_c, have_left_c, 127, 129, above_left_u);
-			pred8x8_build(pred_v8, best_uv_mode, A8v, L8v, have_above_c, have_left_c, 127, 129, above_left_v);
-			uv_modes[mb_index] = (uint8_t)best_uv_mode;
-
-			// Luma: per subblock choose B mode by SAD; forward transform/quant; reconstruct in scan order.
-			for (uint32_t sb_r = 0; sb_r < 4; sb_r++) {
-				for (uint32_t sb_c = 0; sb_c < 4; sb_c++) {
-					const uint32_t sx = x0 + sb_c * 4u;
-					const uint32_t sy = y0 + sb_r * 4u;
-
-					uint8_t A8[9];
-					uint8_t L4[4];
-					// Top-left (P)
-					if (sy == 0) A8[0] = 127;
-					else if (sx == 0) A8[0] = 129;
-					else A8[0] = recon.y[(size_t)(sy - 1) * recon.y_stride + (size_t)(sx - 1)];
-
-					// Above row A[0..7] in A8[1..8].
-					for (uint32_t i = 0; i < 8; i++) {
-						if (sy == 0) {
-							A8[1 + i] = 127;
-							continue;
-						}
-						uint32_t row = sy - 1;
-						uint32_t col;
-						if (sb_c == 3 && i >= 4) {
-							// RFC 6386 11.4: right-edge special case.
-							if (y0 == 0) {
-								A8[1 + i] = 127;
-								continue;
-							}
-							row = y0 - 1;
-							col = x0 + 16u + (i - 4u);
-						} else {
-							col = sx + i;
-						}
-						// recon is padded to macroblock size; still clamp for safety.
-						uint32_t max_row = recon.mb_rows * 16u;
-						uint32_t max_col = recon.mb_cols * 16u;
-						if (max_row) {
-							if (row >= max_row) row = max_row - 1u;
-						}
-						if (max_col) {
-							if (col >= max_col) col = max_col - 1u;
-						}
-						A8[1 + i] = recon.y[(size_t)row * recon.y_stride + (size_t)col];
-					}
+			int16_t deq[16];
+			for (int i = 0; i < 16; i++) deq[i] = vblk_tmp[n][i];
+			dequant4x4_inplace(deq, qf.uv_dc, qf.uv_ac);
+			int16_t res[16];
+			inv_dct4x4(deq, res);
+			for (int i = 0; i < 16; i++) {
+				int32_t v = (int32_t)pred4[i] + (int32_t)res[i];
+				uint8_t r = clamp255_i32(v);
+				int d = (int)src4[i] - (int)r;
+				sse += (uint32_t)(d * d);
+			}
+		}
 
-					// Left column.
-					if (sx == 0) {
-						for (uint32_t i = 0; i < 4; i++) L4[i] = 129;
-					} else {
-						for (uint32_t i = 0; i < 4; i++) {
-							uint32_t row = sy + i;
-							uint32_t max_row = recon.mb_rows * 16u;
-							if (max_row && row >= max_row) row = max_row - 1u;
-							L4[i] = recon.y[(size_t)row * recon.y_stride + (size_t)(sx - 1)];
-						}
-					}
+		// Whole-macroblock rate: add the token bitcount for just the UV tokens.
+		if (use_mb_rate) {
+			int16_t mb_coeffs_uv[16 + (16 * 16) + (4 * 16) + (4 * 16)];
+			memset(mb_coeffs_uv, 0, sizeof(mb_coeffs_uv));
+			int16_t* dst_uv = mb_coeffs_uv + 16 + (16 * 16);
+			for (int n = 0; n < 4; n++) {
+				for (int i = 0; i < 16; i++) dst_uv[i] = ublk_tmp[n][i];
+				dst_uv += 16;
+			}
+			for (int n = 0; n < 4; n++) {
+				for (int i = 0; i < 16; i++) dst_uv[i] = vblk_tmp[n][i];
+				dst_uv += 16;
+			}
+			const uint32_t bits_q8 = rdo_mb_token_bits_q8(token_costs, /*ymode=*/4, mb_coeffs_uv, coeff_probs_override);
+			rate += rdo_rate_from_token_bits_q8(bits_q8);
+		}
 
-					fill4x4_clamped(src4, yuv->y, yuv->y_stride, w, h, sx, sy);
-
-					uint32_t best_sad = 0xFFFFFFFFu;
-					Vp8BMode best_mode = B_DC_PRED;
-					fill4x4_clamped(src4, yuv->y, yuv->y_stride, w, h, sx, sy);
-					for (Vp8BMode mode = B_DC_PRED; mode <= B_HU_PRED; mode++) {
-						bpred4x4(pred4, &A8[1], L4, mode);
-						uint32_t sad = sad4x4_u8(src4, pred4);
-						if (sad < best_sad) {
-							best_sad = sad;
-							best_mode = mode;
-						}
-					}
-					b_modes[mb_index * 16u + (size_t)(sb_r * 4u + sb_c)] = (uint8_t)best_mode;
-					bpred4x4(pred4, &A8[1], L4, best_mode);
-					int16_t coeff[16];
-					enc_vp8_ftransform4x4(src4, 4, pred4, 4, coeff);
-					enc_vp8_quantize4x4_inplace(coeff, qf.y1_dc, qf.y1_ac);
-
-					// Store coeffs: Y2 is not coded; keep it 0. Y blocks start at +16.
-					int16_t* mbdst = out + mb_index * coeffs_per_mb;
-					int16_t* ydst = mbdst + 16;
-					const size_t blk = (size_t)(sb_r * 4u + sb_c);
-					for (int i = 0; i < 16; i++) ydst[blk * 16u + (size_t)i] = coeff[i];
-
-					// Reconstruct into recon.y
-					int16_t deq[16];
-					for (int i = 0; i < 16; i++) deq[i] = coeff[i];
-					dequant4x4_inplace(deq, qf.y1_dc, qf.y1_ac);
-					int16_t res[16];
-					inv_dct4x4(deq, res);
-					for (uint32_t dy = 0; dy < 4; dy++) {
-						uint8_t* row = recon.y + (size_t)(sy + dy) * recon.y_stride + (size_t)sx;
-						for (uint32_t dx = 0; dx < 4; dx++) {
-							int32_t v = (int32_t)pred4[dy * 4u + dx] + (int32_t)res[(int)(dy * 4u + dx)];
-							row[dx] = clamp255_i32(v);
-						}
+		uint32_t cost = sse + (uint32_t)((uint64_t)lambda_uv * (uint64_t)rate);
+		if (cost < best_uv_sse) {
+			best_uv_sse = cost;
+			best_uv_mode = mode;
+			memcpy(best_pred_u8, pred_u_tmp, sizeof(best_pred_u8));
+			memcpy(best_pred_v8, pred_v_tmp, sizeof(best_pred_v8));
+			for (int n = 0; n < 4; n++) {
+				for (int i = 0; i < 16; i++) best_ublk[n][i] = ublk_tmp[n][i];
+				for (int i = 0; i < 16; i++) best_vblk[n][i] = vblk_tmp[n][i];
+			}
+		}
+	}
+
+	memcpy(pred_u8, best_pred_u8, sizeof(pred_u8));
+	memcpy(pred_v8, best_pred_v8, sizeof(pred_v8));
+	uv_modes[mb_index] = (uint8_t)best_uv_mode;
+
+	const uint32_t lambda_y = rdo_lambda_from_qindex(qf.qindex, lambda_mul, lambda_div);
+
+	// Snapshot the current 16x16 recon luma so we can evaluate candidates without
+	// permanently affecting future macroblocks.
+	uint8_t saved_y[16 * 16];
+	for (uint32_t dy = 0; dy < 16; ++dy) {
+		memcpy(saved_y + dy * 16u,
+		       recon.y + (size_t)(y0 + dy) * recon.y_stride + (size_t)x0,
+		       16);
+	}
+
+	// --- Candidate A: B_PRED (4x4) with quant-aware RDO ---
+	uint32_t cost_bpred = 0;
+	uint8_t y_has_sel[4][4];
+	for (int rr = 0; rr < 4; rr++) for (int cc = 0; cc < 4; cc++) y_has_sel[rr][cc] = 0;
+	uint8_t cand_b_modes[16];
+	int16_t cand_y_coeffs[16][16];
+	uint8_t cand_recon_y[16 * 16];
+	for (uint32_t sb_r = 0; sb_r < 4; sb_r++) {
+		for (uint32_t sb_c = 0; sb_c < 4; sb_c++) {
+			const uint32_t sx = x0 + sb_c * 4u;
+			const uint32_t sy = y0 + sb_r * 4u;
+
+			uint8_t A8[9];
+			uint8_t L4[4];
+			if (sy == 0) A8[0] = 127;
+			else if (sx == 0) A8[0] = 129;
+			else A8[0] = recon.y[(size_t)(sy - 1) * recon.y_stride + (size_t)(sx - 1)];
+
+			for (uint32_t i = 0; i < 8; i++) {
+				if (sy == 0) {
+					A8[1 + i] = 127;
+					continue;
+				}
+				uint32_t row = sy - 1;
+				uint32_t col;
+				if (sb_c == 3 && i >= 4) {
+					if (y0 == 0) {
+						A8[1 + i] = 127;
+						continue;
 					}
+					row = y0 - 1;
+					col = x0 + 16u + (i - 4u);
+				} else {
+					col = sx + i;
 				}
+				uint32_t max_row = recon.mb_rows * 16u;
+				uint32_t max_col = recon.mb_cols * 16u;
+				if (max_row && row >= max_row) row = max_row - 1u;
+				if (max_col && col >= max_col) col = max_col - 1u;
+				A8[1 + i] = recon.y[(size_t)row * recon.y_stride + (size_t)col];
 			}
 
-			// U/V forward transforms + quant (mode-aware predictors).
-			int16_t ublk[4][16];
-			int16_t vblk[4][16];
-			for (uint32_t n = 0; n < 4; ++n) {
-				const uint32_t bx = (n & 1u) * 4u;
-				const uint32_t by = (n >> 1) * 4u;
-				fill4x4_clamped(src4, yuv->u, yuv->uv_stride, uv_w, uv_h, ux0 + bx, uy0 + by);
-				pred8_fill4x4(pred4, pred_u8, bx, by);
-				enc_vp8_ftransform4x4(src4, 4, pred4, 4, ublk[n]);
-				enc_vp8_quantize4x4_inplace(ublk[n], qf.uv_dc, qf.uv_ac);
+			if (sx == 0) {
+				for (uint32_t i = 0; i < 4; i++) L4[i] = 129;
+			} else {
+				for (uint32_t i = 0; i < 4; i++) {
+					uint32_t row = sy + i;
+					uint32_t max_row = recon.mb_rows * 16u;
+					if (max_row && row >= max_row) row = max_row - 1u;
+					L4[i] = recon.y[(size_t)row * recon.y_stride + (size_t)(sx - 1)];
+				}
 			}
-			for (uint32_t n = 0; n < 4; ++n) {
-				const uint32_t bx = (n & 1u) * 4u;
-				const uint32_t by = (n >> 1) * 4u;
-				fill4x4_clamped(src4, yuv->v, yuv->uv_stride, uv_w, uv_h, ux0 + bx, uy0 + by);
-				pred8_fill4x4(pred4, pred_v8, bx, by);
-				enc_vp8_ftransform4x4(src4, 4, pred4, 4, vblk[n]);
-				enc_vp8_quantize4x4_inplace(vblk[n], qf.uv_dc, qf.uv_ac);
+
+			fill4x4_clamped(src4, yuv->y, yuv->y_stride, w, h, sx, sy);
+			const uint32_t blk = sb_r * 4u + sb_c;
+
+			uint32_t best_cost = 0xFFFFFFFFu;
+			Vp8BMode best_mode = B_DC_PRED;
+			// Zeroed for -Wmaybe-uninitialized only: the first candidate always sets them.
+			int16_t best_coeff[16] = {0};
+			uint8_t best_pred4[16] = {0};
+			uint8_t best_has = 0;
+			const uint8_t left_has_ctx = (sb_c == 0) ? 0 : y_has_sel[sb_r][sb_c - 1];
+			const uint8_t above_has_ctx = (sb_r == 0) ? 0 : y_has_sel[sb_r - 1][sb_c];
+
+			int cand_modes_sorted[10];
+			int cand_modes_count = 0;
+			if (satd_prune_k > 0 && satd_prune_k < 10 && (uint32_t)qf.qindex >= satd_prune_min_qindex) {
+				uint32_t satd_by_mode[10];
+				for (Vp8BMode m = B_DC_PRED; m <= B_HU_PRED; m++) {
+					bpred4x4(pred4, &A8[1], L4, m);
+					satd_by_mode[(int)m] = satd4x4_src_vs_pred(src4, pred4);
+				}
+				for (Vp8BMode m = B_DC_PRED; m <= B_HU_PRED; m++) {
+					int pos = cand_modes_count;
+					while (pos > 0) {
+						const int prev = cand_modes_sorted[pos - 1];
+						const uint32_t s_new = satd_by_mode[(int)m];
+						const uint32_t s_prev = satd_by_mode[prev];
+						if (s_new > s_prev) break;
+						if (s_new == s_prev && (int)m > prev) break;
+						cand_modes_sorted[pos] = cand_modes_sorted[pos - 1];
+						pos--;
+					}
+					cand_modes_sorted[pos] = (int)m;
+					cand_modes_count++;
+				}
+				cand_modes_count = (int)satd_prune_k;
+			} else {
+				for (Vp8BMode m = B_DC_PRED; m <= B_HU_PRED; m++) cand_modes_sorted[cand_modes_count++] = (int)m;
 			}
 
-			// Store U/V coeffs after Y.
-			int16_t* dst = out + mb_index * coeffs_per_mb + 16 + (16 * 16);
-			for (int n = 0; n < 4; ++n) {
-				for (int i = 0; i < 16; ++i) dst[i] = ublk[n][i];
-				dst += 16;
+			for (int mi = 0; mi < cand_modes_count; mi++) {
+				const Vp8BMode mode = (Vp8BMode)cand_modes_sorted[mi];
+				bpred4x4(pred4, &A8[1], L4, mode);
+				int16_t coeff[16];
+				dsp->ftransform4x4(src4, 4, pred4, 4, coeff);
+				dsp->quantize4x4(coeff, &a->quant.y1);
+				refine_dc_quant4x4(coeff, qf.y1_dc, qf.y1_ac, src4, pred4);
+				uint32_t rate = 0;
+				uint8_t has = 0;
+				rate += rdo_bmode_signal_cost(mode);
+				if (use_entropy_rate) {
+					rate += rdo_rate_from_token_bits_q8(
+						enc_vp8_estimate_keyframe_block_token_bits_q8_probs(
+							3,
+							0,
+							left_has_ctx,
+							above_has_ctx,
+							coeff,
+							&has,
+							coeff_probs_override));
+				} else {
+					rate += rdo_rate_proxy4x4(coeff);
+					for (int i = 0; i < 16; i++) has |= (uint8_t)(coeff[i] != 0);
+				}
+
+				int16_t deq[16];
+				for (int i = 0; i < 16; i++) deq[i] = coeff[i];
+				dequant4x4_inplace(deq, qf.y1_dc, qf.y1_ac);
+				int16_t res[16];
+				inv_dct4x4(deq, res);
+				uint32_t sse = sse4x4_src_vs_recon(src4, pred4, res);
+				uint32_t cost = sse + (uint32_t)((uint64_t)lambda_y * (uint64_t)rate);
+				if (cost < best_cost) {
+					best_cost = cost;
+					best_mode = mode;
+					for (int i = 0; i < 16; i++) best_coeff[i] = coeff[i];
+					for (int i = 0; i < 16; i++) best_pred4[i] = pred4[i];
+					best_has = has;
+				}
 			}
-			for (int n = 0; n < 4; ++n) {
-				for (int i = 0; i < 16; ++i) dst[i] = vblk[n][i];
-				dst += 16;
+
+			cand_b_modes[blk] = (uint8_t)best_mode;
+			for (int i = 0; i < 16; i++) cand_y_coeffs[blk][i] = best_coeff[i];
+			y_has_sel[sb_r][sb_c] = best_has;
+			cost_bpred += best_cost;
+
+			// Reconstruct into recon.y for correct intra context within this macroblock.
+			int16_t deq[16];
+			for (int i = 0; i < 16; i++) deq[i] = best_coeff[i];
+			dequant4x4_inplace(deq, qf.y1_dc, qf.y1_ac);
+			int16_t res[16];
+			inv_dct4x4(deq, res);
+			for (uint32_t dy = 0; dy < 4; dy++) {
+				uint8_t* row = recon.y + (size_t)(sy + dy) * recon.y_stride + (size_t)sx;
+				for (uint32_t dx = 0; dx < 4; dx++) {
+					int32_t v = (int32_t)best_pred4[dy * 4u + dx] + (int32_t)res[(int)(dy * 4u + dx)];
+					row[dx] = clamp255_i32(v);
+				}
 			}
+		}
+	}
+	if (use_entropy_signal) {
+		const uint32_t bits_q8 = enc_vp8_estimate_keyframe_ymode_bits_q8(4);
+		cost_bpred += (uint32_t)((uint64_t)lambda_y * (uint64_t)rdo_rate_from_mode_bits_q8(bits_q8 - ymode_min_bits_q8));
+	} else {
+		cost_bpred += (uint32_t)((uint64_t)lambda_y * (uint64_t)rdo_ymode_signal_cost(4));
+	}
+	for (uint32_t dy = 0; dy < 16; ++dy) {
+		memcpy(cand_recon_y + dy * 16u,
+		       recon.y + (size_t)(y0 + dy) * recon.y_stride + (size_t)x0,
+		       16);
+		memcpy(recon.y + (size_t)(y0 + dy) * recon.y_stride + (size_t)x0,
+		       saved_y + dy * 16u,
+		       16);
+	}
+
+	// --- Candidate B: I16 (16x16) with quant-aware RDO ---
+	uint32_t best_cost_i16 = 0xFFFFFFFFu;
+	Vp8I16Mode best_i16_mode = VP8_I16_DC_PRED;
+	// Zeroed for -Wmaybe-uninitialized only: DC_PRED is always evaluated.
+	int16_t best_i16_y2[16] = {0};
+	int16_t best_i16_yblk[16][16] = {{0}};
+	uint8_t best_i16_recon_y[16 * 16] = {0};
+
+	// Build neighbor vectors from reconstructed luma.
+	uint8_t A16[16];
+	uint8_t L16[16];
+	int have_above = (mby > 0);
+	int have_left = (mbx > 0);
+	for (uint32_t i = 0; i < 16; i++) {
+		A16[i] = have_above ? recon.y[(size_t)(y0 - 1) * recon.y_stride + (size_t)(x0 + i)] : 127;
+		L16[i] = have_left ? recon.y[(size_t)(y0 + i) * recon.y_stride + (size_t)(x0 - 1)] : 129;
+	}
+	uint8_t above_left = 127;
+	if (have_above && have_left) {
+		above_left = recon.y[(size_t)(y0 - 1) * recon.y_stride + (size_t)(x0 - 1)];
+	} else {
+		above_left = have_above ? 129 : 127;
+	}
 
-			// Reconstruct U/V.
-			for (int n = 0; n < 4; ++n) {
-				int16_t block_coeffs[16];
-				for (int i = 0; i < 16; ++i) block_coeffs[i] = ublk[n][i];
-				dequant4x4_inplace(block_coeffs, qf.uv_dc, qf.uv_ac);
-				int16_t res[16];
-				inv_dct4x4(block_coeffs, res);
-				const uint32_t bx = (uint32_t)(n & 1) * 4u;
-				const uint32_t by = (uint32_t)(n >> 1) * 4u;
-				for (uint32_t dy = 0; dy < 4; ++dy) {
-					uint8_t* row = recon.u + (size_t)(uy0 + by + dy) * recon.uv_stride + (size_t)(ux0 + bx);
-					for (uint32_t dx = 0; dx < 4; ++dx) {
-						uint8_t p = pred_u8[(by + dy) * 8u + (bx + dx)];
-						int32_t v = (int32_t)p + (int32_t)res[(int)(dy * 4u + dx)];
-						row[dx] = clamp255_i32(v);
+	uint8_t pred_tmp[16 * 16];
+	uint8_t ref4[16];
+	int16_t tmp[16][16];
+	int16_t y2[16];
+	int16_t y2_deq[16];
+	int16_t y_dc16[16];
+	uint8_t recon_y_tmp[16 * 16];
+
+	for (Vp8I16Mode mode = VP8_I16_DC_PRED; mode <= VP8_I16_TM_PRED; mode++) {
+		pred16x16_build(pred_tmp, mode, A16, L16, have_above, have_left, 127, 129, above_left);
+
+		// Forward transforms, collecting DCs into Y2.
+		ftransform_blocks(dsp, yuv->y, yuv->y_stride, w, h, x0, y0, pred_tmp, 16, tmp);
+		dsp->ftransform_wht(&tmp[0][0], y2);
+		for (int n = 0; n < 16; ++n) tmp[n][0] = 0;
+
+		// Quantize Y2 and Y blocks.
+		int16_t y2q[16];
+		for (int i = 0; i < 16; ++i) y2q[i] = y2[i];
+		dsp->quantize4x4(y2q, &a->quant.y2);
+		for (int i = 0; i < 16; ++i) y2[i] = y2q[i];
+		for (int n = 0; n < 16; ++n) {
+			dsp->quantize4x4(tmp[n], &a->quant.y1);
+		}
+
+		// Rate term.
+		uint32_t rate = 0;
+		if (use_entropy_signal) {
+			const uint32_t bits_q8 = enc_vp8_estimate_keyframe_ymode_bits_q8((int)mode);
+			rate += rdo_rate_from_mode_bits_q8(bits_q8 - ymode_min_bits_q8);
+		} else {
+			rate += rdo_ymode_signal_cost((uint8_t)mode);
+		}
+		if (use_entropy_rate) {
+			if (!use_mb_rate) {
+				uint32_t bits_q8 = 0;
+				uint8_t y2_has = 0;
+				bits_q8 += enc_vp8_estimate_keyframe_block_token_bits_q8(1, 0, 0, 0, y2, &y2_has);
+				uint8_t above_y[4] = {0, 0, 0, 0};
+				uint8_t left_y[4] = {0, 0, 0, 0};
+				uint8_t y_has[4][4];
+				for (int rr = 0; rr < 4; rr++) for (int cc = 0; cc < 4; cc++) y_has[rr][cc] = 0;
+				for (int rr = 0; rr < 4; rr++) {
+					for (int cc = 0; cc < 4; cc++) {
+						uint8_t left_has = (cc == 0) ? left_y[rr] : y_has[rr][cc - 1];
+						uint8_t above_has = (rr == 0) ? above_y[cc] : y_has[rr - 1][cc];
+						uint8_t has = 0;
+						bits_q8 += enc_vp8_estimate_keyframe_block_token_bits_q8(0, 1, left_has, above_has, tmp[rr * 4 + cc], &has);
+						y_has[rr][cc] = has;
 					}
 				}
+				rate += rdo_rate_from_token_bits_q8(bits_q8);
+			} else {
+				int16_t mb_coeffs_i16[16 + (16 * 16) + (4 * 16) + (4 * 16)];
+				int16_t* dst = mb_coeffs_i16;
+				for (int i = 0; i < 16; i++) dst[i] = y2[i];
+				dst += 16;
+				for (int n = 0; n < 16; n++) {
+					for (int i = 0; i < 16; i++) dst[i] = tmp[n][i];
+					dst += 16;
+				}
+				for (int n = 0; n < 4; n++) {
+					for (int i = 0; i < 16; i++) dst[i] = best_ublk[n][i];
+					dst += 16;
+				}
+				for (int n = 0; n < 4; n++) {
+					for (int i = 0; i < 16; i++) dst[i] = best_vblk[n][i];
+					dst += 16;
+				}
+				const uint32_t bits_q8 = rdo_mb_token_bits_q8(token_costs, (int)mode, mb_coeffs_i16, coeff_probs_override);
+				rate += rdo_rate_from_token_bits_q8(bits_q8);
 			}
-			for (int n = 0; n < 4; ++n) {
-				int16_t block_coeffs[16];
-				for (int i = 0; i < 16; ++i) block_coeffs[i] = vblk[n][i];
-				dequant4x4_inplace(block_coeffs, qf.uv_dc, qf.uv_ac);
-				int16_t res[16];
-				inv_dct4x4(block_coeffs, res);
-				const uint32_t bx = (uint32_t)(n & 1) * 4u;
-				const uint32_t by = (uint32_t)(n >> 1) * 4u;
-				for (uint32_t dy = 0; dy < 4; ++dy) {
-					uint8_t* row = recon.v + (size_t)(uy0 + by + dy) * recon.uv_stride + (size_t)(ux0 + bx);
-					for (uint32_t dx = 0; dx < 4; ++dx) {
-						uint8_t p = pred_v8[(by + dy) * 8u + (bx + dx)];
-						int32_t v = (int32_t)p + (int32_t)res[(int)(dy * 4u + dx)];
-						row[dx] = clamp255_i32(v);
-					}
+		} else {
+			rate += rdo_rate_weight_y2(rdo_rate_proxy4x4(y2));
+			for (int n = 0; n < 16; ++n) rate += rdo_rate_proxy4x4(tmp[n]);
+		}
+
+		// Distortion: reconstruct and SSE vs source.
+		for (int i = 0; i < 16; ++i) y2_deq[i] = y2[i];
+		dequant4x4_inplace(y2_deq, qf.y2_dc, qf.y2_ac);
+		inv_wht4x4(y2_deq, y_dc16);
+
+		uint32_t sse_mb = 0;
+		for (uint32_t n = 0; n < 16; ++n) {
+			int16_t block_coeffs[16];
+			for (int i = 0; i < 16; ++i) block_coeffs[i] = tmp[n][i];
+			dequant4x4_inplace(block_coeffs, qf.y1_dc, qf.y1_ac);
+			// The DC comes from the (already dequantized) inverse WHT.
+			block_coeffs[0] = y_dc16[n];
+			int16_t res[16];
+			inv_dct4x4(block_coeffs, res);
+			const uint32_t bx = (uint32_t)(n & 3) * 4u;
+			const uint32_t by = (uint32_t)(n >> 2) * 4u;
+			fill4x4_clamped(src4, yuv->y, yuv->y_stride, w, h, x0 + bx, y0 + by);
+			pred16_fill4x4(ref4, pred_tmp, bx, by);
+			for (uint32_t dy = 0; dy < 4; ++dy) {
+				for (uint32_t dx = 0; dx < 4; ++dx) {
+					const int idx = (int)(dy * 4u + dx);
+					int32_t v = (int32_t)ref4[idx] + (int32_t)res[idx];
+					uint8_t r = clamp255_i32(v);
+					recon_y_tmp[(by + dy) * 16u + (bx + dx)] = r;
+					int d = (int)src4[idx] - (int)r;
+					sse_mb += (uint32_t)(d * d);
 				}
 			}
 		}
+
+		uint32_t cost = sse_mb + (uint32_t)((uint64_t)lambda_y * (uint64_t)rate);
+		if (cost < best_cost_i16) {
+			best_cost_i16 = cost;
+			best_i16_mode = mode;
+			for (int i = 0; i < 16; ++i) best_i16_y2[i] = y2[i];
+			for (int n = 0; n < 16; ++n) {
+				for (int i = 0; i < 16; ++i) best_i16_yblk[n][i] = tmp[n][i];
+			}
+			memcpy(best_i16_recon_y, recon_y_tmp, sizeof(best_i16_recon_y));
+		}
 	}
 
-	enc_vp8_recon_free(&recon);
-	*y_modes_out = y_modes;
-	*y_modes_count_out = (size_t)mb_total;
-	*b_modes_out = b_modes;
-	*b_modes_count_out = (size_t)mb_total * 16u;
-	*uv_modes_out = uv_modes;
-	*uv_modes_count_out = (size_t)mb_total;
-	*coeffs_out = out;
-	*coeffs_count_out = coeffs_total;
-	return 0;
+	// Decide macroblock luma mode and commit coeffs + recon.
+	uint32_t cost_bpred_cmp = cost_bpred;
+	if (use_mb_rate) {
+		// Recompute B_PRED macroblock cost using a whole-macroblock token bitcount (mode selection
+		// inside the macroblock was still driven by the per-block estimator; this improves the
+		// I16 vs B_PRED decision).
+		uint32_t sse_y = 0;
+		for (uint32_t dy = 0; dy < 16u; ++dy) {
+			uint32_t sy = y0 + dy;
+			if (sy >= h) sy = h ? (h - 1u) : 0u;
+			const uint8_t* src_row = yuv->y + (size_t)sy * yuv->y_stride;
+			for (uint32_t dx = 0; dx < 16u; ++dx) {
+				uint32_t sx = x0 + dx;
+				if (sx >= w) sx = w ? (w - 1u) : 0u;
+				int d = (int)src_row[sx] - (int)cand_recon_y[dy * 16u + dx];
+				sse_y += (uint32_t)(d * d);
+			}
+		}
+		uint32_t rate = 0;
+		if (use_entropy_signal) {
+			const uint32_t bits_q8 = enc_vp8_estimate_keyframe_ymode_bits_q8(4);
+			rate += rdo_rate_from_mode_bits_q8(bits_q8 - ymode_min_bits_q8);
+		} else {
+			rate += rdo_ymode_signal_cost(4);
+		}
+		for (uint32_t rr = 0; rr < 4; rr++) {
+			for (uint32_t cc = 0; cc < 4; cc++) {
+				const uint32_t blk = rr * 4u + cc;
+				const int mode = (int)cand_b_modes[blk];
+				rate += rdo_bmode_signal_cost(mode);
+			}
+		}
+		int16_t mb_coeffs_bp[16 + (16 * 16) + (4 * 16) + (4 * 16)];
+		memset(mb_coeffs_bp, 0, 16 * sizeof(int16_t));
+		int16_t* dst = mb_coeffs_bp + 16;
+		for (int n = 0; n < 16; n++) {
+			for (int i = 0; i < 16; i++) dst[i] = cand_y_coeffs[n][i];
+			dst += 16;
+		}
+		for (int n = 0; n < 4; n++) {
+			for (int i = 0; i < 16; i++) dst[i] = best_ublk[n][i];
+			dst += 16;
+		}
+		for (int n = 0; n < 4; n++) {
+			for (int i = 0; i < 16; i++) dst[i] = best_vblk[n][i];
+			dst += 16;
+		}
+		const uint32_t bits_q8 = rdo_mb_token_bits_q8(token_costs, /*ymode=*/4, mb_coeffs_bp, coeff_probs_override);
+		rate += rdo_rate_from_token_bits_q8(bits_q8);
+		cost_bpred_cmp = sse_y + (uint32_t)((uint64_t)lambda_y * (uint64_t)rate);
+	}
+
+	int choose_i16 = (best_cost_i16 < cost_bpred_cmp);
+	int16_t* mbdst = out + mb_index * coeffs_per_mb;
+	int16_t* ydst = mbdst + 16;
+	if (choose_i16) {
+		y_modes[mb_index] = (uint8_t)best_i16_mode;
+		for (int i = 0; i < 16; ++i) mbdst[i] = best_i16_y2[i];
+		for (int n = 0; n < 16; ++n) {
+			for (int i = 0; i < 16; ++i) ydst[(size_t)n * 16u + (size_t)i] = best_i16_yblk[n][i];
+			b_modes[mb_index * 16u + (size_t)n] = 0;
+		}
+		for (uint32_t dy = 0; dy < 16; ++dy) {
+			memcpy(recon.y + (size_t)(y0 + dy) * recon.y_stride + (size_t)x0,
+			       best_i16_recon_y + dy * 16u,
+			       16);
+		}
+	} else {
+		y_modes[mb_index] = 4; // B_PRED
+		// B_PRED has no Y2. Clear it: the stats pre-pass may have left an I16
+		// Y2 for this macroblock, and the mb_skip_coeff scan reads all 16.
+		for (int i = 0; i < 16; ++i) mbdst[i] = 0;
+		for (int n = 0; n < 16; ++n) {
+			for (int i = 0; i < 16; ++i) ydst[(size_t)n * 16u + (size_t)i] = cand_y_coeffs[n][i];
+			b_modes[mb_index * 16u + (size_t)n] = cand_b_modes[n];
+		}
+		for (uint32_t dy = 0; dy < 16; ++dy) {
+			memcpy(recon.y + (size_t)(y0 + dy) * recon.y_stride + (size_t)x0,
+			       cand_recon_y + dy * 16u,
+			       16);
+		}
+	}
+
+	// Store U/V coeffs after Y.
+	int16_t* dst = out + mb_index * coeffs_per_mb + 16 + (16 * 16);
+	for (int n = 0; n < 4; ++n) {
+		for (int i = 0; i < 16; ++i) dst[i] = best_ublk[n][i];
+		dst += 16;
+	}
+	for (int n = 0; n < 4; ++n) {
+		for (int i = 0; i < 16; ++i) dst[i] = best_vblk[n][i];
+		dst += 16;
+	}
+
+	// Reconstruct U/V.
+	for (int n = 0; n < 4; ++n) {
+		int16_t block_coeffs[16];
+		for (int i = 0; i < 16; ++i) block_coeffs[i] = best_ublk[n][i];
+		dequant4x4_inplace(block_coeffs, qf.uv_dc, qf.uv_ac);
+		int16_t res[16];
+		inv_dct4x4(block_coeffs, res);
+		const uint32_t bx = (uint32_t)(n & 1) * 4u;
+		const uint32_t by = (uint32_t)(n >> 1) * 4u;
+		for (uint32_t dy = 0; dy < 4; ++dy) {
+			uint8_t* row = recon.u + (size_t)(uy0 + by + dy) * recon.uv_stride + (size_t)(ux0 + bx);
+			for (uint32_t dx = 0; dx < 4; ++dx) {
+				uint8_t p = pred_u8[(by + dy) * 8u + (bx + dx)];
+				int32_t v = (int32_t)p + (int32_t)res[(int)(dy * 4u + dx)];
+				row[dx] = clamp255_i32(v);
+			}
+		}
+	}
+	for (int n = 0; n < 4; ++n) {
+		int16_t block_coeffs[16];
+		for (int i = 0; i < 16; ++i) block_coeffs[i] = best_vblk[n][i];
+		dequant4x4_inplace(block_coeffs, qf.uv_dc, qf.uv_ac);
+		int16_t res[16];
+		inv_dct4x4(block_coeffs, res);
+		const uint32_t bx = (uint32_t)(n & 1) * 4u;
+		const uint32_t by = (uint32_t)(n >> 1) * 4u;
+		for (uint32_t dy = 0; dy < 4; ++dy) {
+			uint8_t* row = recon.v + (size_t)(uy0 + by + dy) * recon.uv_stride + (size_t)(ux0 + bx);
+			for (uint32_t dx = 0; dx < 4; ++dx) {
+				uint8_t p = pred_v8[(by + dy) * 8u + (bx + dx)];
+				int32_t v = (int32_t)p + (int32_t)res[(int)(dy * 4u + dx)];
+				row[dx] = clamp255_i32(v);
+			}
+		}
+	}
 }
 
+// Copies the source line above macroblock row mby (mby > 0, so it lies inside
+// the image) into recon, edge-extended to the stride, so the row can be
+// analysed on its own.
+static void seed_recon_above_row(const EncMbAnalysis* a, uint32_t mby) {
+	const EncYuv420Image* yuv = a->yuv;
+	const EncVp8ReconPlanes* recon = &a->recon;
+	const uint32_t uv_w = (yuv->width + 1u) >> 1;
+	const uint32_t sy = mby * 16u - 1u;
+	const uint32_t suv = mby * 8u - 1u;
+	uint8_t* dy = recon->y + (size_t)sy * recon->y_stride;
+	uint8_t* du = recon->u + (size_t)suv * recon->uv_stride;
+	uint8_t* dv = recon->v + (size_t)suv * recon->uv_stride;
+	for (uint32_t x = 0; x < recon->y_stride; x++) {
+		const uint32_t sx = (x < yuv->width) ? x : yuv->width - 1u;
+		dy[x] = yuv->y[(size_t)sy * yuv->y_stride + sx];
+	}
+	for (uint32_t x = 0; x < recon->uv_stride; x++) {
+		const uint32_t sx = (x < uv_w) ? x : uv_w - 1u;
+		du[x] = yuv->u[(size_t)suv * yuv->uv_stride + sx];
+		dv[x] = yuv->v[(size_t)suv * yuv->uv_stride + sx];
+	}
+}
+
+// State of a refining bpred-rdo pass: the branch counts so far and the two
+// probability/cost slots that alternate between bands.
+typedef struct {
+	EncMbAnalysis* a;
+	EncVp8CoeffCounts counts;
+	EncVp8TokenProbsMode mode;
+	int seeded; // counts start from the stats pre-pass
+	uint8_t probs[2][4][8][3][11];
+	EncVp8TokenCosts* costs; // [2], NULL unless the pass rates from tables
+} EncRdoRefine;
+
+// EncBandFn for bpred_uv_rdo_refining(): band b (b >= 2) rates with the
+// counts of every row before band b - 1, which are finished by now.
+static void rdo_refine_prepare_band(void* ctx, uint32_t band) {
+	EncRdoRefine* r = (EncRdoRefine*)ctx;
+	EncMbAnalysis* a = r->a;
+	const uint32_t slot = band & 1u;
+	const uint8_t(*probs)[8][3][11] = a->coeff_probs_override;
+	if (band >= 2u) {
+		const uint32_t begin = (band - 2u) * a->refine_rows;
+		enc_vp8_coeff_counts_add_rows(&r->counts, begin, begin + a->refine_rows, a->y_modes, a->out);
+	}
+	if (band >= 2u || r->seeded) {
+		enc_vp8_coeff_probs_from_counts(r->probs[slot], &r->counts, r->mode);
+		probs = (const uint8_t(*)[8][3][11])r->probs[slot];
+	}
+	a->band_probs[slot] = probs;
+	if (r->costs) {
+		enc_vp8_token_costs_init(&r->costs[slot], probs);
+		a->band_costs[slot] = &r->costs[slot];
+	}
+}
+
+// bpred-rdo in one pass with adaptive rate probabilities (see refine_rows and
+// stats_sample_rows in EncBpredRdoTuning). The rows run as one wavefront in
+// bands of refine_rows: band b rates with probabilities (and token costs)
+// derived from the rows before band b - 1, so the refinement lags one band
+// behind and the bands overlap instead of joining at every boundary. The
+// output does not depend on the thread count. The optional pre-pass writes
+// the same outputs and recon, which the main pass then overwrites row by row.
+static int bpred_uv_rdo_refining(EncMbAnalysis* a, EncVp8TokenProbsMode mode, uint32_t refine_rows, uint32_t sample_rows) {
+	const uint32_t mb_rows = a->mb_rows;
+	EncRdoRefine r = {.a = a, .mode = mode, .seeded = (sample_rows != 0), .costs = NULL};
+	if (enc_vp8_coeff_counts_init(&r.counts, a->mb_cols) != 0) return -1;
+	if (a->token_costs) {
+		r.costs = (EncVp8TokenCosts*)malloc(2u * sizeof(*r.costs));
+		if (!r.costs) {
+			enc_vp8_coeff_counts_free(&r.counts);
+			errno = ENOMEM;
+			return -1;
+		}
+	}
+	int rc = 0;
+
+	if (sample_rows) {
+		for (uint32_t mby = 0; mby < mb_rows && rc == 0; mby += sample_rows) {
+			if (mby > 0) seed_recon_above_row(a, mby);
+			rc = enc_mb_wavefront_rows(a, bpred_uv_rdo_mb, mby, mby + 1u);
+			enc_vp8_coeff_counts_add_rows(&r.counts, mby, mby + 1u, a->y_modes, a->out);
+		}
+	}
+
+	if (rc == 0) {
+		a->refine_rows = refine_rows ? refine_rows : mb_rows;
+		rc = enc_mb_wavefront_banded(a, bpred_uv_rdo_mb, a->refine_rows, rdo_refine_prepare_band, &r);
+		a->refine_rows = 0;
+	}
+	free(r.costs);
+	enc_vp8_coeff_counts_free(&r.counts);
+	return rc;
+}
 
 static int enc_vp8_encode_bpred_uv_rdo_inloop_pass(const EncYuv420Image* yuv,
 								  int quality,
 								  const uint8_t coeff_probs_override[4][8][3][11],
+								  EncVp8TokenProbsMode refine_mode,
 							 uint8_t** y_modes_out,
 							 size_t* y_modes_count_out,
 							 uint8_t** b_modes_out,
@@ -1913,34 +2938,29 @@ static int enc_vp8_encode_bpred_uv_rdo_inloop_pass(const EncYuv420Image* yuv,
 	enc_vp8_quant_factors_from_qindex(qindex, 0, 0, 0, 0, 0, &qf);
 	*qindex_out = (uint8_t)qf.qindex;
 
-	uint32_t lambda_mul = 1;
-	uint32_t lambda_div = 1;
+	EncBpredRdoParams rdo = {.lambda_mul = 1, .lambda_div = 1};
 	int rate_mode = 0;
-	int use_entropy_rate = 0;
-	int use_dry_run_rate = 0;
-	int use_entropy_signal = 0;
-	int quant_mode = 0;
-	uint32_t ac_deadzone_pct = 0;
 	uint32_t qscale_y_dc_pct = 100;
 	uint32_t qscale_y_ac_pct = 100;
 	uint32_t qscale_uv_dc_pct = 100;
 	uint32_t qscale_uv_ac_pct = 100;
-	uint32_t satd_prune_k = 0;
-	const uint32_t satd_prune_min_qindex = 12;
+	uint32_t ac_zero_pct = 0;
 	if (tuning) {
-		lambda_mul = tuning->lambda_mul ? tuning->lambda_mul : 1;
-		lambda_div = tuning->lambda_div ? tuning->lambda_div : 1;
+		rdo.lambda_mul = tuning->lambda_mul ? tuning->lambda_mul : 1;
+		rdo.lambda_div = tuning->lambda_div ? tuning->lambda_div : 1;
 		rate_mode = (int)tuning->rate_mode;
-		use_entropy_rate = (rate_mode != 0);
-		use_dry_run_rate = (rate_mode == 2);
-		use_entropy_signal = (tuning->signal_mode == 1);
-		quant_mode = (tuning->quant_mode == 1) ? 1 : 0;
-		ac_deadzone_pct = tuning->ac_deadzone_pct;
+		rdo.use_entropy_rate = (rate_mode != 0);
+		rdo.use_mb_rate = (rate_mode == 2 || rate_mode == 3);
+		rdo.use_entropy_signal = (tuning->signal_mode == 1);
+		if (tuning->quant_mode == 1) {
+			ac_zero_pct = tuning->ac_deadzone_pct ? tuning->ac_deadzone_pct : 60;
+			if (ac_zero_pct > 99) ac_zero_pct = 99;
+		}
 		qscale_y_dc_pct = tuning->qscale_y_dc_pct ? tuning->qscale_y_dc_pct : 100;
 		qscale_y_ac_pct = tuning->qscale_y_ac_pct ? tuning->qscale_y_ac_pct : 100;
 		qscale_uv_dc_pct = tuning->qscale_uv_dc_pct ? tuning->qscale_uv_dc_pct : 100;
 		qscale_uv_ac_pct = tuning->qscale_uv_ac_pct ? tuning->qscale_uv_ac_pct : 100;
-		satd_prune_k = tuning->satd_prune_k;
+		rdo.satd_prune_k = tuning->satd_prune_k;
 		// Apply optional quant step scaling (Experiment 2).
 		qf.y1_dc = rdo_scale_step_pct(qf.y1_dc, qscale_y_dc_pct);
 		qf.y2_dc = rdo_scale_step_pct(qf.y2_dc, qscale_y_dc_pct);
@@ -1950,651 +2970,62 @@ static int enc_vp8_encode_bpred_uv_rdo_inloop_pass(const EncYuv420Image* yuv,
 		qf.uv_ac = rdo_scale_step_pct(qf.uv_ac, qscale_uv_ac_pct);
 	}
 
-	const uint32_t uv_w = (w + 1u) >> 1;
-	const uint32_t uv_h = (h + 1u) >> 1;
+	// rate_mode 3: token costs come from tables built once for this pass's probabilities.
+	EncVp8TokenCosts* token_costs = NULL;
+	if (rate_mode == 3) {
+		token_costs = (EncVp8TokenCosts*)malloc(sizeof(*token_costs));
+		if (!token_costs) {
+			enc_vp8_recon_free(&recon);
+			free(out);
+			free(y_modes);
+			free(uv_modes);
+			free(b_modes);
+			errno = ENOMEM;
+			return -1;
+		}
+		enc_vp8_token_costs_init(token_costs, coeff_probs_override);
+	}
 
-	uint32_t ymode_min_bits_q8 = 0xFFFFFFFFu;
+	rdo.ymode_min_bits_q8 = 0xFFFFFFFFu;
 	for (int m = 0; m <= 4; m++) {
 		const uint32_t bits_q8 = enc_vp8_estimate_keyframe_ymode_bits_q8(m);
-		if (bits_q8 < ymode_min_bits_q8) ymode_min_bits_q8 = bits_q8;
+		if (bits_q8 < rdo.ymode_min_bits_q8) rdo.ymode_min_bits_q8 = bits_q8;
 	}
-	uint32_t uv_mode_min_bits_q8 = 0xFFFFFFFFu;
+	rdo.uv_mode_min_bits_q8 = 0xFFFFFFFFu;
 	for (int m = 0; m <= 3; m++) {
 		const uint32_t bits_q8 = enc_vp8_estimate_keyframe_uv_mode_bits_q8(m);
-		if (bits_q8 < uv_mode_min_bits_q8) uv_mode_min_bits_q8 = bits_q8;
-	}
-
-	uint8_t src4[16];
-	uint8_t pred4[16];
-	uint8_t pred_u8[8 * 8];
-	uint8_t pred_v8[8 * 8];
-	uint8_t pred_u_tmp[8 * 8];
-	uint8_t pred_v_tmp[8 * 8];
-
-	for (uint32_t mby = 0; mby < mb_rows; ++mby) {
-		for (uint32_t mbx = 0; mbx < mb_cols; ++mbx) {
-			const uint32_t x0 = mbx * 16u;
-			const uint32_t y0 = mby * 16u;
-			const uint32_t ux0 = mbx * 8u;
-			const uint32_t uy0 = mby * 8u;
-			const size_t mb_index = (size_t)mby * (size_t)mb_cols + (size_t)mbx;
-			y_modes[mb_index] = 4; // B_PRED
-
-			// --- UV (8x8) mode selection (quantization-aware SSE) ---
-			int have_above_c = (mby > 0);
-			int have_left_c = (mbx > 0);
-			uint8_t A8u[8];
-			uint8_t L8u[8];
-			uint8_t A8v[8];
-			uint8_t L8v[8];
-			for (uint32_t i = 0; i < 8; i++) {
-				A8u[i] = have_above_c ? recon.u[(size_t)(uy0 - 1) * recon.uv_stride + (size_t)(ux0 + i)] : 127;
-				A8v[i] = have_above_c ? recon.v[(size_t)(uy0 - 1) * recon.uv_stride + (size_t)(ux0 + i)] : 127;
-				L8u[i] = have_left_c ? recon.u[(size_t)(uy0 + i) * recon.uv_stride + (size_t)(ux0 - 1)] : 129;
-				L8v[i] = have_left_c ? recon.v[(size_t)(uy0 + i) * recon.uv_stride + (size_t)(ux0 - 1)] : 129;
-			}
-			uint8_t above_left_u = 127;
-			uint8_t above_left_v = 127;
-			if (have_above_c && have_left_c) {
-				above_left_u = recon.u[(size_t)(uy0 - 1) * recon.uv_stride + (size_t)(ux0 - 1)];
-				above_left_v = recon.v[(size_t)(uy0 - 1) * recon.uv_stride + (size_t)(ux0 - 1)];
-			} else {
-				uint8_t al = have_above_c ? 129 : 127;
-				above_left_u = al;
-				above_left_v = al;
-			}
-
-			uint32_t best_uv_sse = 0xFFFFFFFFu;
-			Vp8I16Mode best_uv_mode = VP8_I16_DC_PRED;
-			int16_t best_ublk[4][16];
-			int16_t best_vblk[4][16];
-			uint8_t best_pred_u8[8 * 8];
-			uint8_t best_pred_v8[8 * 8];
-			const uint32_t lambda_uv = rdo_lambda_from_qindex(qf.qindex, lambda_mul, lambda_div);
-
-			for (Vp8I16Mode mode = VP8_I16_DC_PRED; mode <= VP8_I16_TM_PRED; mode++) {
-				pred8x8_build(pred_u_tmp, mode, A8u, L8u, have_above_c, have_left_c, 127, 129, above_left_u);
-				pred8x8_build(pred_v_tmp, mode, A8v, L8v, have_above_c, have_left_c, 127, 129, above_left_v);
-
-				uint32_t sse = 0;
-				uint32_t rate = 0;
-				if (use_entropy_signal) {
-					const uint32_t bits_q8 = enc_vp8_estimate_keyframe_uv_mode_bits_q8((int)mode);
-					rate += rdo_rate_from_mode_bits_q8(bits_q8 - uv_mode_min_bits_q8);
-				} else {
-					rate += rdo_uv_mode_signal_cost(mode);
-				}
-				uint8_t u_has[2][2] = {{0, 0}, {0, 0}};
-				uint8_t v_has[2][2] = {{0, 0}, {0, 0}};
-				int16_t ublk_tmp[4][16];
-				int16_t vblk_tmp[4][16];
-
-				for (uint32_t n = 0; n < 4; ++n) {
-					const uint32_t bx = (n & 1u) * 4u;
-					const uint32_t by = (n >> 1) * 4u;
-
-					fill4x4_clamped(src4, yuv->u, yuv->uv_stride, uv_w, uv_h, ux0 + bx, uy0 + by);
-					pred8_fill4x4(pred4, pred_u_tmp, bx, by);
-					enc_vp8_ftransform4x4(src4, 4, pred4, 4, ublk_tmp[n]);
-					rdo_quantize4x4_inplace(ublk_tmp[n], qf.uv_dc, qf.uv_ac, quant_mode, ac_deadzone_pct);
-					refine_dc_quant4x4(ublk_tmp[n], qf.uv_dc, qf.uv_ac, src4, pred4);
-					if (use_entropy_rate && !use_dry_run_rate) {
-						uint8_t has = 0;
-						uint8_t left_has = (bx == 0) ? 0 : u_has[by >> 2][(bx >> 2) - 1];
-						uint8_t above_has = (by == 0) ? 0 : u_has[(by >> 2) - 1][bx >> 2];
-						rate += rdo_rate_from_token_bits_q8(
-							enc_vp8_estimate_keyframe_block_token_bits_q8_probs(
-								2,
-								0,
-								left_has,
-								above_has,
-								ublk_tmp[n],
-								&has,
-								coeff_probs_override));
-						u_has[by >> 2][bx >> 2] = has;
-					} else if (!use_entropy_rate) {
-						rate += rdo_rate_proxy4x4(ublk_tmp[n]);
-					}
-					int16_t deq[16];
-					for (int i = 0; i < 16; i++) deq[i] = ublk_tmp[n][i];
-					dequant4x4_inplace(deq, qf.uv_dc, qf.uv_ac);
-					int16_t res[16];
-					inv_dct4x4(deq, res);
-					for (int i = 0; i < 16; i++) {
-						int32_t v = (int32_t)pred4[i] + (int32_t)res[i];
-						uint8_t r = clamp255_i32(v);
-						int d = (int)src4[i] - (int)r;
-						sse += (uint32_t)(d * d);
-					}
-				}
-				for (uint32_t n = 0; n < 4; ++n) {
-					const uint32_t bx = (n & 1u) * 4u;
-					const uint32_t by = (n >> 1) * 4u;
-
-					fill4x4_clamped(src4, yuv->v, yuv->uv_stride, uv_w, uv_h, ux0 + bx, uy0 + by);
-					pred8_fill4x4(pred4, pred_v_tmp, bx, by);
-					enc_vp8_ftransform4x4(src4, 4, pred4, 4, vblk_tmp[n]);
-					rdo_quantize4x4_inplace(vblk_tmp[n], qf.uv_dc, qf.uv_ac, quant_mode, ac_deadzone_pct);
-					refine_dc_quant4x4(vblk_tmp[n], qf.uv_dc, qf.uv_ac, src4, pred4);
-					if (use_entropy_rate && !use_dry_run_rate) {
-						uint8_t has = 0;
-						uint8_t left_has = (bx == 0) ? 0 : v_has[by >> 2][(bx >> 2) - 1];
-						uint8_t above_has = (by == 0) ? 0 : v_has[(by >> 2) - 1][bx >> 2];
-						rate += rdo_rate_from_token_bits_q8(
-							enc_vp8_estimate_keyframe_block_token_bits_q8_probs(
-								2,
-								0,
-								left_has,
-								above_has,
-								vblk_tmp[n],
-								&has,
-								coeff_probs_override));
-						v_has[by >> 2][bx >> 2] = has;
-					} else if (!use_entropy_rate) {
-						rate += rdo_rate_proxy4x4(vblk_tmp[n]);
-					}
-					int16_t deq[16];
-					for (int i = 0; i < 16; i++) deq[i] = vblk_tmp[n][i];
-					dequant4x4_inplace(deq, qf.uv_dc, qf.uv_ac);
-					int16_t res[16];
-					inv_dct4x4(deq, res);
-					for (int i = 0; i < 16; i++) {
-						int32_t v = (int32_t)pred4[i] + (int32_t)res[i];
-						uint8_t r = clamp255_i32(v);
-						int d = (int)src4[i] - (int)r;
-						sse += (uint32_t)(d * d);
-					}
-				}
-
-				// If using dry-run rate, add an actual bool-encoder bitcount for just the UV tokens.
-				if (use_dry_run_rate) {
-					int16_t mb_coeffs_uv[16 + (16 * 16) + (4 * 16) + (4 * 16)];
-					memset(mb_coeffs_uv, 0, sizeof(mb_coeffs_uv));
-					int16_t* dst_uv = mb_coeffs_uv + 16 + (16 * 16);
-					for (int n = 0; n < 4; n++) {
-						for (int i = 0; i < 16; i++) dst_uv[i] = ublk_tmp[n][i];
-						dst_uv += 16;
-					}
-					for (int n = 0; n < 4; n++) {
-						for (int i = 0; i < 16; i++) dst_uv[i] = vblk_tmp[n][i];
-						dst_uv += 16;
-					}
-					const uint32_t bits_q8 = enc_vp8_dry_run_keyframe_mb_token_bits_q8_probs(/*ymode=*/4, mb_coeffs_uv, coeff_probs_override);
-					rate += rdo_rate_from_token_bits_q8(bits_q8);
-				}
-
-				uint32_t cost = sse + (uint32_t)((uint64_t)lambda_uv * (uint64_t)rate);
-				if (cost < best_uv_sse) {
-					best_uv_sse = cost;
-					best_uv_mode = mode;
-					memcpy(best_pred_u8, pred_u_tmp, sizeof(best_pred_u8));
-					memcpy(best_pred_v8, pred_v_tmp, sizeof(best_pred_v8));
-					for (int n = 0; n < 4; n++) {
-						for (int i = 0; i < 16; i++) best_ublk[n][i] = ublk_tmp[n][i];
-						for (int i = 0; i < 16; i++) best_vblk[n][i] = vblk_tmp[n][i];
-					}
-				}
-			}
-
-			memcpy(pred_u8, best_pred_u8, sizeof(pred_u8));
-			memcpy(pred_v8, best_pred_v8, sizeof(pred_v8));
-			uv_modes[mb_index] = (uint8_t)best_uv_mode;
-
-			const uint32_t lambda_y = rdo_lambda_from_qindex(qf.qindex, lambda_mul, lambda_div);
-
-			// Snapshot the current 16x16 recon luma so we can evaluate candidates without
-			// permanently affecting future macroblocks.
-			uint8_t saved_y[16 * 16];
-			for (uint32_t dy = 0; dy < 16; ++dy) {
-				memcpy(saved_y + dy * 16u,
-				       recon.y + (size_t)(y0 + dy) * recon.y_stride + (size_t)x0,
-				       16);
-			}
-
-			// --- Candidate A: B_PRED (4x4) with quant-aware RDO ---
-			uint32_t cost_bpred = 0;
-			uint8_t y_has_sel[4][4];
-			for (int rr = 0; rr < 4; rr++) for (int cc = 0; cc < 4; cc++) y_has_sel[rr][cc] = 0;
-			uint8_t cand_b_modes[16];
-			int16_t cand_y_coeffs[16][16];
-			uint8_t cand_recon_y[16 * 16];
-			for (uint32_t sb_r = 0; sb_r < 4; sb_r++) {
-				for (uint32_t sb_c = 0; sb_c < 4; sb_c++) {
-					const uint32_t sx = x0 + sb_c * 4u;
-					const uint32_t sy = y0 + sb_r * 4u;
-
-					uint8_t A8[9];
-					uint8_t L4[4];
-					if (sy == 0) A8[0] = 127;
-					else if (sx == 0) A8[0] = 129;
-					else A8[0] = recon.y[(size_t)(sy - 1) * recon.y_stride + (size_t)(sx - 1)];
-
-					for (uint32_t i = 0; i < 8; i++) {
-						if (sy == 0) {
-							A8[1 + i] = 127;
-							continue;
-						}
-						uint32_t row = sy - 1;
-						uint32_t col;
-						if (sb_c == 3 && i >= 4) {
-							if (y0 == 0) {
-								A8[1 + i] = 127;
-								continue;
-							}
-							row = y0 - 1;
-							col = x0 + 16u + (i - 4u);
-						} else {
-							col = sx + i;
-						}
-						uint32_t max_row = recon.mb_rows * 16u;
-						uint32_t max_col = recon.mb_cols * 16u;
-						if (max_row && row >= max_row) row = max_row - 1u;
-						if (max_col && col >= max_col) col = max_col - 1u;
-						A8[1 + i] = recon.y[(size_t)row * recon.y_stride + (size_t)col];
-					}
-
-					if (sx == 0) {
-						for (uint32_t i = 0; i < 4; i++) L4[i] = 129;
-					} else {
-						for (uint32_t i = 0; i < 4; i++) {
-							uint32_t row = sy + i;
-							uint32_t max_row = recon.mb_rows * 16u;
-							if (max_row && row >= max_row) row = max_row - 1u;
-							L4[i] = recon.y[(size_t)row * recon.y_stride + (size_t)(sx - 1)];
-						}
-					}
-
-					fill4x4_clamped(src4, yuv->y, yuv->y_stride, w, h, sx, sy);
-					const uint32_t blk = sb_r * 4u + sb_c;
-
-					uint32_t best_cost = 0xFFFFFFFFu;
-					Vp8BMode best_mode = B_DC_PRED;
-					int16_t best_coeff[16];
-					uint8_t best_pred4[16];
-					uint8_t best_has = 0;
-					const uint8_t left_has_ctx = (sb_c == 0) ? 0 : y_has_sel[sb_r][sb_c - 1];
-					const uint8_t above_has_ctx = (sb_r == 0) ? 0 : y_has_sel[sb_r - 1][sb_c];
-
-					int cand_modes_sorted[10];
-					int cand_modes_count = 0;
-					if (satd_prune_k > 0 && satd_prune_k < 10 && (uint32_t)qf.qindex >= satd_prune_min_qindex) {
-						uint32_t satd_by_mode[10];
-						for (Vp8BMode m = B_DC_PRED; m <= B_HU_PRED; m++) {
-							bpred4x4(pred4, &A8[1], L4, m);
-							satd_by_mode[(int)m] = satd4x4_src_vs_pred(src4, pred4);
-						}
-						for (Vp8BMode m = B_DC_PRED; m <= B_HU_PRED; m++) {
-							int pos = cand_modes_count;
-							while (pos > 0) {
-								const int prev = cand_modes_sorted[pos - 1];
-								const uint32_t s_new = satd_by_mode[(int)m];
-								const uint32_t s_prev = satd_by_mode[prev];
-								if (s_new > s_prev) break;
-								if (s_new == s_prev && (int)m > prev) break;
-								cand_modes_sorted[pos] = cand_modes_sorted[pos - 1];
-								pos--;
-							}
-							cand_modes_sorted[pos] = (int)m;
-							cand_modes_count++;
-						}
-						cand_modes_count = (int)satd_prune_k;
-					} else {
-						for (Vp8BMode m = B_DC_PRED; m <= B_HU_PRED; m++) cand_modes_sorted[cand_modes_count++] = (int)m;
-					}
-
-					for (int mi = 0; mi < cand_modes_count; mi++) {
-						const Vp8BMode mode = (Vp8BMode)cand_modes_sorted[mi];
-						bpred4x4(pred4, &A8[1], L4, mode);
-						int16_t coeff[16];
-						enc_vp8_ftransform4x4(src4, 4, pred4, 4, coeff);
-						rdo_quantize4x4_inplace(coeff, qf.y1_dc, qf.y1_ac, quant_mode, ac_deadzone_pct);
-						refine_dc_quant4x4(coeff, qf.y1_dc, qf.y1_ac, src4, pred4);
-						uint32_t rate = 0;
-						uint8_t has = 0;
-						rate += rdo_bmode_signal_cost(mode);
-						if (use_entropy_rate) {
-							rate += rdo_rate_from_token_bits_q8(
-								enc_vp8_estimate_keyframe_block_token_bits_q8_probs(
-									3,
-									0,
-									left_has_ctx,
-									above_has_ctx,
-									coeff,
-									&has,
-									coeff_probs_override));
-						} else {
-							rate += rdo_rate_proxy4x4(coeff);
-							for (int i = 0; i < 16; i++) has |= (uint8_t)(coeff[i] != 0);
-						}
-
-						int16_t deq[16];
-						for (int i = 0; i < 16; i++) deq[i] = coeff[i];
-						dequant4x4_inplace(deq, qf.y1_dc, qf.y1_ac);
-						int16_t res[16];
-						inv_dct4x4(deq, res);
-						uint32_t sse = sse4x4_src_vs_recon(src4, pred4, res);
-						uint32_t cost = sse + (uint32_t)((uint64_t)lambda_y * (uint64_t)rate);
-						if (cost < best_cost) {
-							best_cost = cost;
-							best_mode = mode;
-							for (int i = 0; i < 16; i++) best_coeff[i] = coeff[i];
-							for (int i = 0; i < 16; i++) best_pred4[i] = pred4[i];
-							best_has = has;
-						}
-					}
-
-					cand_b_modes[blk] = (uint8_t)best_mode;
-					for (int i = 0; i < 16; i++) cand_y_coeffs[blk][i] = best_coeff[i];
-					y_has_sel[sb_r][sb_c] = best_has;
-					cost_bpred += best_cost;
-
-					// Reconstruct into recon.y for correct intra context within this macroblock.
-					int16_t deq[16];
-					for (int i = 0; i < 16; i++) deq[i] = best_coeff[i];
-					dequant4x4_inplace(deq, qf.y1_dc, qf.y1_ac);
-					int16_t res[16];
-					inv_dct4x4(deq, res);
-					for (uint32_t dy = 0; dy < 4; dy++) {
-						uint8_t* row = recon.y + (size_t)(sy + dy) * recon.y_stride + (size_t)sx;
-						for (uint32_t dx = 0; dx < 4; dx++) {
-							int32_t v = (int32_t)best_pred4[dy * 4u + dx] + (int32_t)res[(int)(dy * 4u + dx)];
-							row[dx] = clamp255_i32(v);
-						}
-					}
-				}
-			}
-			if (use_entropy_signal) {
-				const uint32_t bits_q8 = enc_vp8_estimate_keyframe_ymode_bits_q8(4);
-				cost_bpred += (uint32_t)((uint64_t)lambda_y * (uint64_t)rdo_rate_from_mode_bits_q8(bits_q8 - ymode_min_bits_q8));
-			} else {
-				cost_bpred += (uint32_t)((uint64_t)lambda_y * (uint64_t)rdo_ymode_signal_cost(4));
-			}
-			for (uint32_t dy = 0; dy < 16; ++dy) {
-				memcpy(cand_recon_y + dy * 16u,
-				       recon.y + (size_t)(y0 + dy) * recon.y_stride + (size_t)x0,
-				       16);
-				memcpy(recon.y + (size_t)(y0 + dy) * recon.y_stride + (size_t)x0,
-				       saved_y + dy * 16u,
-				       16);
-			}
-
-			// --- Candidate B: I16 (16x16) with quant-aware RDO ---
-			uint32_t best_cost_i16 = 0xFFFFFFFFu;
-			Vp8I16Mode best_i16_mode = VP8_I16_DC_PRED;
-			int16_t best_i16_y2[16];
-			int16_t best_i16_yblk[16][16];
-			uint8_t best_i16_recon_y[16 * 16];
-
-			// Build neighbor vectors from reconstructed luma.
-			uint8_t A16[16];
-			uint8_t L16[16];
-			int have_above = (mby > 0);
-			int have_left = (mbx > 0);
-			for (uint32_t i = 0; i < 16; i++) {
-				A16[i] = have_above ? recon.y[(size_t)(y0 - 1) * recon.y_stride + (size_t)(x0 + i)] : 127;
-				L16[i] = have_left ? recon.y[(size_t)(y0 + i) * recon.y_stride + (size_t)(x0 - 1)] : 129;
-			}
-			uint8_t above_left = 127;
-			if (have_above && have_left) {
-				above_left = recon.y[(size_t)(y0 - 1) * recon.y_stride + (size_t)(x0 - 1)];
-			} else {
-				above_left = have_above ? 129 : 127;
-			}
-
-			uint8_t pred_tmp[16 * 16];
-			uint8_t ref4[16];
-			int16_t tmp[16][16];
-			int16_t y2[16];
-			int16_t y2_deq[16];
-			int16_t y_dc16[16];
-			uint8_t recon_y_tmp[16 * 16];
-
-			for (Vp8I16Mode mode = VP8_I16_DC_PRED; mode <= VP8_I16_TM_PRED; mode++) {
-				pred16x16_build(pred_tmp, mode, A16, L16, have_above, have_left, 127, 129, above_left);
-
-				// Forward transforms, collecting DCs into Y2.
-				for (uint32_t n = 0; n < 16; ++n) {
-					const uint32_t bx = (n & 3u) * 4u;
-					const uint32_t by = (n >> 2) * 4u;
-					fill4x4_clamped(src4, yuv->y, yuv->y_stride, w, h, x0 + bx, y0 + by);
-					pred16_fill4x4(ref4, pred_tmp, bx, by);
-					enc_vp8_ftransform4x4(src4, 4, ref4, 4, tmp[n]);
-				}
-				enc_vp8_ftransform_wht(&tmp[0][0], y2);
-				for (int n = 0; n < 16; ++n) tmp[n][0] = 0;
-
-				// Quantize Y2 and Y blocks.
-				int16_t y2q[16];
-				for (int i = 0; i < 16; ++i) y2q[i] = y2[i];
-				rdo_quantize4x4_inplace(y2q, qf.y2_dc, qf.y2_ac, 0, 0);
-				for (int i = 0; i < 16; ++i) y2[i] = y2q[i];
-				for (int n = 0; n < 16; ++n) {
-					rdo_quantize4x4_inplace(tmp[n], qf.y1_dc, qf.y1_ac, quant_mode, ac_deadzone_pct);
-				}
-
-				// Rate term.
-				uint32_t rate = 0;
-				if (use_entropy_signal) {
-					const uint32_t bits_q8 = enc_vp8_estimate_keyframe_ymode_bits_q8((int)mode);
-					rate += rdo_rate_from_mode_bits_q8(bits_q8 - ymode_min_bits_q8);
-				} else {
-					rate += rdo_ymode_signal_cost((uint8_t)mode);
-				}
-				if (use_entropy_rate) {
-					if (!use_dry_run_rate) {
-						uint32_t bits_q8 = 0;
-						uint8_t y2_has = 0;
-						bits_q8 += enc_vp8_estimate_keyframe_block_token_bits_q8(1, 0, 0, 0, y2, &y2_has);
-						uint8_t above_y[4] = {0, 0, 0, 0};
-						uint8_t left_y[4] = {0, 0, 0, 0};
-						uint8_t y_has[4][4];
-						for (int rr = 0; rr < 4; rr++) for (int cc = 0; cc < 4; cc++) y_has[rr][cc] = 0;
-						for (int rr = 0; rr < 4; rr++) {
-							for (int cc = 0; cc < 4; cc++) {
-								uint8_t left_has = (cc == 0) ? left_y[rr] : y_has[rr][cc - 1];
-								uint8_t above_has = (rr == 0) ? above_y[cc] : y_has[rr - 1][cc];
-								uint8_t has = 0;
-								bits_q8 += enc_vp8_estimate_keyframe_block_token_bits_q8(0, 1, left_has, above_has, tmp[rr * 4 + cc], &has);
-								y_has[rr][cc] = has;
-							}
-						}
-						rate += rdo_rate_from_token_bits_q8(bits_q8);
-					} else {
-						int16_t mb_coeffs_i16[16 + (16 * 16) + (4 * 16) + (4 * 16)];
-						int16_t* dst = mb_coeffs_i16;
-						for (int i = 0; i < 16; i++) dst[i] = y2[i];
-						dst += 16;
-						for (int n = 0; n < 16; n++) {
-							for (int i = 0; i < 16; i++) dst[i] = tmp[n][i];
-							dst += 16;
-						}
-						for (int n = 0; n < 4; n++) {
-							for (int i = 0; i < 16; i++) dst[i] = best_ublk[n][i];
-							dst += 16;
-						}
-						for (int n = 0; n < 4; n++) {
-							for (int i = 0; i < 16; i++) dst[i] = best_vblk[n][i];
-							dst += 16;
-						}
-						const uint32_t bits_q8 = enc_vp8_dry_run_keyframe_mb_token_bits_q8_probs((int)mode, mb_coeffs_i16, coeff_probs_override);
-						rate += rdo_rate_from_token_bits_q8(bits_q8);
-					}
-				} else {
-					rate += rdo_rate_weight_y2(rdo_rate_proxy4x4(y2));
-					for (int n = 0; n < 16; ++n) rate += rdo_rate_proxy4x4(tmp[n]);
-				}
-
-				// Distortion: reconstruct and SSE vs source.
-				for (int i = 0; i < 16; ++i) y2_deq[i] = y2[i];
-				dequant4x4_inplace(y2_deq, qf.y2_dc, qf.y2_ac);
-				inv_wht4x4(y2_deq, y_dc16);
-
-				uint32_t sse_mb = 0;
-				for (uint32_t n = 0; n < 16; ++n) {
-					int16_t block_coeffs[16];
-					for (int i = 0; i < 16; ++i) block_coeffs[i] = tmp[n][i];
-					block_coeffs[0] = y_dc16[n];
-					dequant4x4_inplace(block_coeffs, qf.y1_dc, qf.y1_ac);
-					int16_t res[16];
-					inv_dct4x4(block_coeffs, res);
-					const uint32_t bx = (uint32_t)(n & 3) * 4u;
-					const uint32_t by = (uint32_t)(n >> 2) * 4u;
-					fill4x4_clamped(src4, yuv->y, yuv->y_stride, w, h, x0 + bx, y0 + by);
-					pred16_fill4x4(ref4, pred_tmp, bx, by);
-					for (uint32_t dy = 0; dy < 4; ++dy) {
-						for (uint32_t dx = 0; dx < 4; ++dx) {
-							const int idx = (int)(dy * 4u + dx);
-							int32_t v = (int32_t)ref4[idx] + (int32_t)res[idx];
-							uint8_t r = clamp255_i32(v);
-							recon_y_tmp[(by + dy) * 16u + (bx + dx)] = r;
-							int d = (int)src4[idx] - (int)r;
-							sse_mb += (uint32_t)(d * d);
-						}
-					}
-				}
-
-				uint32_t cost = sse_mb + (uint32_t)((uint64_t)lambda_y * (uint64_t)rate);
-				if (cost < best_cost_i16) {
-					best_cost_i16 = cost;
-					best_i16_mode = mode;
-					for (int i = 0; i < 16; ++i) best_i16_y2[i] = y2[i];
-					for (int n = 0; n < 16; ++n) {
-						for (int i = 0; i < 16; ++i) best_i16_yblk[n][i] = tmp[n][i];
-					}
-					memcpy(best_i16_recon_y, recon_y_tmp, sizeof(best_i16_recon_y));
-				}
-			}
-
-			// Decide macroblock luma mode and commit coeffs + recon.
-			uint32_t cost_bpred_cmp = cost_bpred;
-			if (use_dry_run_rate) {
-				// Recompute B_PRED macroblock cost using a dry-run token bitcount (mode selection inside
-				// the macroblock was still driven by the usual estimator; this improves the I16 vs B_PRED decision).
-				uint32_t sse_y = 0;
-				for (uint32_t dy = 0; dy < 16u; ++dy) {
-					uint32_t sy = y0 + dy;
-					if (sy >= h) sy = h ? (h - 1u) : 0u;
-					const uint8_t* src_row = yuv->y + (size_t)sy * yuv->y_stride;
-					for (uint32_t dx = 0; dx < 16u; ++dx) {
-						uint32_t sx = x0 + dx;
-						if (sx >= w) sx = w ? (w - 1u) : 0u;
-						int d = (int)src_row[sx] - (int)cand_recon_y[dy * 16u + dx];
-						sse_y += (uint32_t)(d * d);
-					}
-				}
-				uint32_t rate = 0;
-				if (use_entropy_signal) {
-					const uint32_t bits_q8 = enc_vp8_estimate_keyframe_ymode_bits_q8(4);
-					rate += rdo_rate_from_mode_bits_q8(bits_q8 - ymode_min_bits_q8);
-				} else {
-					rate += rdo_ymode_signal_cost(4);
-				}
-				for (uint32_t rr = 0; rr < 4; rr++) {
-					for (uint32_t cc = 0; cc < 4; cc++) {
-						const uint32_t blk = rr * 4u + cc;
-						const int mode = (int)cand_b_modes[blk];
-						rate += rdo_bmode_signal_cost(mode);
-					}
-				}
-				int16_t mb_coeffs_bp[16 + (16 * 16) + (4 * 16) + (4 * 16)];
-				memset(mb_coeffs_bp, 0, 16 * sizeof(int16_t));
-				int16_t* dst = mb_coeffs_bp + 16;
-				for (int n = 0; n < 16; n++) {
-					for (int i = 0; i < 16; i++) dst[i] = cand_y_coeffs[n][i];
-					dst += 16;
-				}
-				for (int n = 0; n < 4; n++) {
-					for (int i = 0; i < 16; i++) dst[i] = best_ublk[n][i];
-					dst += 16;
-				}
-				for (int n = 0; n < 4; n++) {
-					for (int i = 0; i < 16; i++) dst[i] = best_vblk[n][i];
-					dst += 16;
-				}
-				const uint32_t bits_q8 = enc_vp8_dry_run_keyframe_mb_token_bits_q8_probs(/*ymode=*/4, mb_coeffs_bp, coeff_probs_override);
-				rate += rdo_rate_from_token_bits_q8(bits_q8);
-				cost_bpred_cmp = sse_y + (uint32_t)((uint64_t)lambda_y * (uint64_t)rate);
-			}
-
-			int choose_i16 = (best_cost_i16 < cost_bpred_cmp);
-			int16_t* mbdst = out + mb_index * coeffs_per_mb;
-			int16_t* ydst = mbdst + 16;
-			if (choose_i16) {
-				y_modes[mb_index] = (uint8_t)best_i16_mode;
-				for (int i = 0; i < 16; ++i) mbdst[i] = best_i16_y2[i];
-				for (int n = 0; n < 16; ++n) {
-					for (int i = 0; i < 16; ++i) ydst[(size_t)n * 16u + (size_t)i] = best_i16_yblk[n][i];
-					b_modes[mb_index * 16u + (size_t)n] = 0;
-				}
-				for (uint32_t dy = 0; dy < 16; ++dy) {
-					memcpy(recon.y + (size_t)(y0 + dy) * recon.y_stride + (size_t)x0,
-					       best_i16_recon_y + dy * 16u,
-					       16);
-				}
-			} else {
-				y_modes[mb_index] = 4; // B_PRED
-				// Y2 remains 0 for B_PRED; out is zero-initialized.
-				for (int n = 0; n < 16; ++n) {
-					for (int i = 0; i < 16; ++i) ydst[(size_t)n * 16u + (size_t)i] = cand_y_coeffs[n][i];
-					b_modes[mb_index * 16u + (size_t)n] = cand_b_modes[n];
-				}
-				for (uint32_t dy = 0; dy < 16; ++dy) {
-					memcpy(recon.y + (size_t)(y0 + dy) * recon.y_stride + (size_t)x0,
-					       cand_recon_y + dy * 16u,
-					       16);
-				}
-			}
-
-			// Store U/V coeffs after Y.
-			int16_t* dst = out + mb_index * coeffs_per_mb + 16 + (16 * 16);
-			for (int n = 0; n < 4; ++n) {
-				for (int i = 0; i < 16; ++i) dst[i] = best_ublk[n][i];
-				dst += 16;
-			}
-			for (int n = 0; n < 4; ++n) {
-				for (int i = 0; i < 16; ++i) dst[i] = best_vblk[n][i];
-				dst += 16;
-			}
-
-			// Reconstruct U/V.
-			for (int n = 0; n < 4; ++n) {
-				int16_t block_coeffs[16];
-				for (int i = 0; i < 16; ++i) block_coeffs[i] = best_ublk[n][i];
-				dequant4x4_inplace(block_coeffs, qf.uv_dc, qf.uv_ac);
-				int16_t res[16];
-				inv_dct4x4(block_coeffs, res);
-				const uint32_t bx = (uint32_t)(n & 1) * 4u;
-				const uint32_t by = (uint32_t)(n >> 1) * 4u;
-				for (uint32_t dy = 0; dy < 4; ++dy) {
-					uint8_t* row = recon.u + (size_t)(uy0 + by + dy) * recon.uv_stride + (size_t)(ux0 + bx);
-					for (uint32_t dx = 0; dx < 4; ++dx) {
-						uint8_t p = pred_u8[(by + dy) * 8u + (bx + dx)];
-						int32_t v = (int32_t)p + (int32_t)res[(int)(dy * 4u + dx)];
-						row[dx] = clamp255_i32(v);
-					}
-				}
-			}
-			for (int n = 0; n < 4; ++n) {
-				int16_t block_coeffs[16];
-				for (int i = 0; i < 16; ++i) block_coeffs[i] = best_vblk[n][i];
-				dequant4x4_inplace(block_coeffs, qf.uv_dc, qf.uv_ac);
-				int16_t res[16];
-				inv_dct4x4(block_coeffs, res);
-				const uint32_t bx = (uint32_t)(n & 1) * 4u;
-				const uint32_t by = (uint32_t)(n >> 1) * 4u;
-				for (uint32_t dy = 0; dy < 4; ++dy) {
-					uint8_t* row = recon.v + (size_t)(uy0 + by + dy) * recon.uv_stride + (size_t)(ux0 + bx);
-					for (uint32_t dx = 0; dx < 4; ++dx) {
-						uint8_t p = pred_v8[(by + dy) * 8u + (bx + dx)];
-						int32_t v = (int32_t)p + (int32_t)res[(int)(dy * 4u + dx)];
-						row[dx] = clamp255_i32(v);
-					}
-				}
-			}
-		}
+		if (bits_q8 < rdo.uv_mode_min_bits_q8) rdo.uv_mode_min_bits_q8 = bits_q8;
+	}
+
+	EncMbAnalysis a = {.yuv = yuv,
+	                   .recon = recon,
+	                   .qf = qf,
+	                   .mb_cols = mb_cols,
+	                   .mb_rows = mb_rows,
+	                   .threads = tuning ? tuning->threads : 0,
+	                   .out = out,
+	                   .y_modes = y_modes,
+	                   .uv_modes = uv_modes,
+	                   .b_modes = b_modes,
+	                   .coeff_probs_override = coeff_probs_override,
+	                   .token_costs = token_costs,
+	                   .rdo = rdo};
+	mb_quant_init(&a.quant, &qf, ac_zero_pct);
+	int rc;
+	if (refine_mode == ENC_VP8_TOKEN_PROBS_DEFAULT) {
+		rc = enc_mb_wavefront(&a, bpred_uv_rdo_mb);
+	} else {
+		rc = bpred_uv_rdo_refining(&a, refine_mode, tuning->refine_rows, tuning->stats_sample_rows);
 	}
-
+	free(token_costs);
 	enc_vp8_recon_free(&recon);
+	if (rc != 0) {
+		free(out);
+		free(y_modes);
+		free(uv_modes);
+		free(b_modes);
+		return -1;
+	}
 	*y_modes_out = y_modes;
 	*y_modes_count_out = (size_t)mb_total;
 	*b_modes_out = b_modes;
@@ -30,6 +30,8 @@ typedef struct {
 	// 0: use the existing cheap magnitude proxy (default)
 	// 1: use an entropy-style token cost estimator (experimental)
 	// 2: use a dry-run bool-encoder token bitcount (experimental)
+	// 3: like 2, but the macroblock bitcount comes from precomputed token cost
+	//    tables (enc_vp8_token_costs_*) instead of bool-encoding it
 	uint32_t rate_mode;
 	// Mode signaling rate term:
 	// 0: use the existing tiny fixed proxy costs (default)
@@ -52,8 +54,52 @@ typedef struct {
 	// 0: disabled (default; evaluates all 10 modes)
 	// N>0: evaluate only the best N modes by SATD (tie-break by mode id)
 	uint32_t satd_prune_k;
+	// 0: when rate_mode != 0 and token probs are adaptive, run a second pass that
+	//    rates against the probabilities learned from the first (default)
+	// 1: single pass; rates use the default probability tables unless one of
+	//    the two options below is set
+	uint32_t single_pass;
+	// Adaptive rate probabilities within the single pass (single_pass=1):
+	// refine_rows K>0: macroblock rows [r, r + K) rate with probabilities
+	//   re-derived from the branch counts of the rows before r - K (one band
+	//   of lag, so consecutive bands run concurrently)
+	// stats_sample_rows N>0: first analyse every Nth macroblock row on its own
+	//   (predicted from the source pixels above it) and start from its counts
+	uint32_t refine_rows;
+	uint32_t stats_sample_rows;
+	// Macroblock analysis threads, as the threads argument of the other
+	// encoders below (0: one per CPU).
+	uint32_t threads;
 } EncBpredRdoTuning;
 
+// Intra strategies the --speed presets pick from.
+typedef enum {
+	ENC_SPEED_INTRA_BPRED_RDO = 0,
+	ENC_SPEED_INTRA_BPRED = 1,
+	ENC_SPEED_INTRA_I16 = 2,
+} EncSpeedIntra;
+
+enum {
+	ENC_SPEED_MIN = 0,
+	ENC_SPEED_MAX = 6,
+	// The encoder's defaults without --speed.
+	ENC_SPEED_DEFAULT = 1,
+};
+
+// One --speed preset: 0 is the slowest (full RDO search), 6 the fastest.
+// The bpred-rdo fields only apply to ENC_SPEED_INTRA_BPRED_RDO; presets leave
+// the remaining EncBpredRdoTuning fields (lambda, quant) at their defaults.
+typedef struct {
+	EncSpeedIntra intra;
+	uint32_t rate_mode;
+	uint32_t satd_prune_k;
+	uint32_t single_pass;
+	uint32_t refine_rows;
+} EncSpeedPreset;
+
+// Returns the preset for speed in [ENC_SPEED_MIN, ENC_SPEED_MAX], or NULL (errno=EINVAL).
+const EncSpeedPreset* enc_speed_preset(int speed);
+
 int enc_vp8_recon_alloc(uint32_t width, uint32_t height, EncVp8ReconPlanes* out);
 void enc_vp8_recon_free(EncVp8ReconPlanes* p);
 
@@ -62,12 +108,15 @@ void enc_vp8_recon_free(EncVp8ReconPlanes* p);
 // subsequent predictions use reconstructed neighbors.
 //
 // - quality: [0..100] mapped to qindex via libwebp mapping.
+// - threads: macroblock analysis threads, 0 = one per CPU, 1 = the calling
+//   thread only. Rows run as a wavefront, so the output does not depend on it.
 // - coeffs_out: int16 coefficients in natural order, per macroblock layout:
 //   Y2(16) + Y(16*16) + U(4*16) + V(4*16).
 //
 // Returns 0 on success, allocates *coeffs_out (caller frees).
 int enc_vp8_encode_dc_pred_inloop(const EncYuv420Image* yuv,
                                  int quality,
+                                 uint32_t threads,
                                  int16_t** coeffs_out,
                                  size_t* coeffs_count_out,
                                  uint8_t* qindex_out);
@@ -82,6 +131,7 @@ int enc_vp8_encode_dc_pred_inloop(const EncYuv420Image* yuv,
 // - coeffs_out: same layout as enc_vp8_encode_dc_pred_inloop().
 int enc_vp8_encode_i16x16_sad_inloop(const EncYuv420Image* yuv,
 									int quality,
+									uint32_t threads,
 									uint8_t** y_modes_out,
 									size_t* y_modes_count_out,
 									int16_t** coeffs_out,
@@ -96,6 +146,7 @@ int enc_vp8_encode_i16x16_sad_inloop(const EncYuv420Image* yuv,
 // - uv_modes_out: length mb_total, values 0..3
 int enc_vp8_encode_i16x16_uv_sad_inloop(const EncYuv420Image* yuv,
 									   int quality,
+									   uint32_t threads,
 									   uint8_t** y_modes_out,
 									   size_t* y_modes_count_out,
 									   uint8_t** uv_modes_out,
@@ -119,6 +170,7 @@ int enc_vp8_encode_i16x16_uv_sad_inloop(const EncYuv420Image* yuv,
 // For B_PRED, Y2 is not coded; this function writes Y2 coeffs as 0.
 int enc_vp8_encode_bpred_uv_sad_inloop(const EncYuv420Image* yuv,
 								 int quality,
+								 uint32_t threads,
 								 uint8_t** y_modes_out,
 								 size_t* y_modes_count_out,
 								 uint8_t** b_modes_out,
@@ -3,7 +3,6 @@
 #include <stdlib.h>
 #include <string.h>
 
-#include "enc-m00_png/enc_png.h"
 #include "enc-m01_riff/enc_riff.h"
 #include "enc-m04_yuv/enc_rgb_to_yuv.h"
 #include "enc-m07_tokens/enc_vp8_tokens.h"
@@ -19,19 +18,30 @@ typedef enum {
 
 static void usage(const char* argv0) {
 	fprintf(stderr,
-	        "Usage: %s [--q <0..100>] [--mode <bpred|bpred-rdo|i16|dc>] [--loopfilter] [--token-probs <default|adaptive|adaptive2>] [--mb-skip] [--bpred-rdo-lambda-mul N] [--bpred-rdo-lambda-div N] [--bpred-rdo-rate <proxy|entropy|dry-run>] [--bpred-rdo-signal <proxy|entropy>] [--bpred-rdo-quant <default|ac-deadzone>] [--bpred-rdo-ac-deadzone N] [--bpred-rdo-qscale-y-ac N] [--bpred-rdo-qscale-uv-ac N] [--bpred-rdo-satd-prune-k N] <in.png> <out.webp>\n"
+	        "Usage: %s [--q <0..100>] [--speed <0..6>] [--threads N] [--partitions <1|2|4|8>] [--mode <bpred|bpred-rdo|i16|dc>] [--loopfilter] [--token-probs <default|adaptive|adaptive2>] [--mb-skip] [--bpred-rdo-lambda-mul N] [--bpred-rdo-lambda-div N] [--bpred-rdo-rate <proxy|entropy|dry-run|table>] [--bpred-rdo-signal <proxy|entropy>] [--bpred-rdo-quant <default|ac-deadzone>] [--bpred-rdo-ac-deadzone N] [--bpred-rdo-qscale-y-ac N] [--bpred-rdo-qscale-uv-ac N] [--bpred-rdo-satd-prune-k N] [--bpred-rdo-passes <1|2>] [--bpred-rdo-refine-rows K] [--bpred-rdo-stats-sample N] <in.png> <out.webp>\n"
 	        "\n"
 	        "Standalone VP8 keyframe (lossy) encoder producing a simple WebP container.\n"
+	        "Use - for <in.png> to read stdin and for <out.webp> to write stdout.\n"
 	        "\n"
 	        "Options:\n"
 	        "  --q <0..100>           Quality (mapped to VP8 qindex). Default: 75\n"
+	        "  --speed <0..6>         Preset: 0 slowest/best .. 6 fastest (default 1); explicit flags below override it\n"
+	        "                         0: bpred-rdo, dry-run rate, 2 passes\n"
+	        "                         1: bpred-rdo, table rate, 1 pass, refine-rows 4\n"
+	        "                         2: bpred-rdo, table rate, 1 pass, refine-rows 4, satd-prune-k 6\n"
+	        "                         3: bpred-rdo, table rate, 1 pass, satd-prune-k 4\n"
+	        "                         4: bpred-rdo, proxy rate, 1 pass, satd-prune-k 3\n"
+	        "                         5: bpred (SAD)\n"
+	        "                         6: i16 (SAD)\n"
+	        "  --threads N            Macroblock analysis threads: 0 = one per CPU (default), 1 = none; output is identical\n"
+	        "  --partitions <1|2|4|8>  DCT token partitions, written concurrently (default 1)\n"
 	        "  --mode <bpred|bpred-rdo|i16|dc>  Intra mode strategy. Default: bpred-rdo\n"
 	        "  --loopfilter | --lf    Write deterministic loopfilter header params derived from qindex\n"
 	        "  --token-probs <default|adaptive|adaptive2>  Emit coefficient token prob updates. Default: adaptive\n"
 	        "  --mb-skip              Experimental: signal mb_skip_coeff and omit tokens for all-zero MBs\n"
 	        "  --bpred-rdo-lambda-mul N  Tune bpred-rdo: multiply lambda(qindex) by N (default 10)\n"
 	        "  --bpred-rdo-lambda-div N  Tune bpred-rdo: divide lambda(qindex) by N (default 1)\n"
-	        "  --bpred-rdo-rate <proxy|entropy|dry-run>  Tune bpred-rdo: rate estimator (default dry-run)\n"
+	        "  --bpred-rdo-rate <proxy|entropy|dry-run|table>  Tune bpred-rdo: rate estimator (default table)\n"
 	        "  --bpred-rdo-signal <proxy|entropy>  Tune bpred-rdo: mode signaling cost model (default proxy)\n"
 	        "  --bpred-rdo-quant <default|ac-deadzone>  Tune bpred-rdo: quantization tweak (default ac-deadzone)\n"
 	        "  --bpred-rdo-ac-deadzone N  Tune bpred-rdo: AC deadzone threshold percent (default 70)\n"
@@ -39,7 +49,10 @@ static void usage(const char* argv0) {
 	        "  --bpred-rdo-qscale-y-ac N  Tune bpred-rdo: scale Y AC quant step percent (default 100)\n"
 	        "  --bpred-rdo-qscale-uv-dc N  Tune bpred-rdo: scale UV DC quant step percent (default 100)\n"
 	        "  --bpred-rdo-qscale-uv-ac N  Tune bpred-rdo: scale UV AC quant step percent (default 130)\n"
-	        "  --bpred-rdo-satd-prune-k N  Tune bpred-rdo: keep best N 4x4 modes by SATD before full eval (default 0=off)\n",
+	        "  --bpred-rdo-satd-prune-k N  Tune bpred-rdo: keep best N 4x4 modes by SATD before full eval (default 0=off)\n"
+	        "  --bpred-rdo-passes <1|2>  Tune bpred-rdo: 2 re-rates against the adaptive probs of pass 1 (default 1)\n"
+	        "  --bpred-rdo-refine-rows K  Tune bpred-rdo: with 1 pass, re-derive the adaptive probs every K MB rows, one band behind (default 4, 0=off)\n"
+	        "  --bpred-rdo-stats-sample N  Tune bpred-rdo: with 1 pass, start from the probs of a pre-pass over every Nth MB row (default 0=off)\n",
 	        argv0);
 }
 
@@ -72,6 +85,15 @@ static int parse_mode(const char* s, EncMode* out) {
 	return -1;
 }
 
+// Settings a --speed preset covers; `given` in main() marks the ones set by a flag.
+enum {
+	GIVEN_MODE = 1u << 0,
+	GIVEN_RDO_RATE = 1u << 1,
+	GIVEN_RDO_PRUNE = 1u << 2,
+	GIVEN_RDO_PASSES = 1u << 3,
+	GIVEN_RDO_REFINE = 1u << 4,
+};
+
 int main(int argc, char** argv) {
 	int quality = 75;
 	int enable_loopfilter = 0;
@@ -80,7 +102,7 @@ int main(int argc, char** argv) {
 	EncVp8TokenProbsMode token_probs_mode = ENC_VP8_TOKEN_PROBS_ADAPTIVE;
 	int bpred_rdo_lambda_mul = 10;
 	int bpred_rdo_lambda_div = 1;
-	int bpred_rdo_rate_mode = 2;
+	int bpred_rdo_rate_mode = 3;
 	int bpred_rdo_signal_mode = 0;
 	int bpred_rdo_quant_mode = 1;
 	int bpred_rdo_ac_deadzone_pct = 70;
@@ -89,6 +111,17 @@ int main(int argc, char** argv) {
 	int bpred_rdo_qscale_uv_dc_pct = 100;
 	int bpred_rdo_qscale_uv_ac_pct = 130;
 	int bpred_rdo_satd_prune_k = 0;
+	int bpred_rdo_single_pass = 1;
+	int bpred_rdo_refine_rows = 4;
+	int bpred_rdo_stats_sample = 0;
+	int threads = 0;
+	int token_partitions = 1;
+
+	// --speed sets the baseline; the individual flags override it wherever they
+	// appear, so the preset is applied after the loop to the settings no flag
+	// gave.
+	const EncSpeedPreset* preset = NULL;
+	unsigned given = 0;
 
 	int argi = 1;
 	while (argi < argc) {
@@ -100,11 +133,39 @@ int main(int argc, char** argv) {
 			argi += 2;
 			continue;
 		}
+		if (argi + 1 < argc && strcmp(argv[argi], "--threads") == 0) {
+			if (parse_int(argv[argi + 1], &threads) != 0 || threads < 0) {
+				usage(argv[0]);
+				return 2;
+			}
+			argi += 2;
+			continue;
+		}
+		if (argi + 1 < argc && strcmp(argv[argi], "--partitions") == 0) {
+			if (parse_int(argv[argi + 1], &token_partitions) != 0 ||
+			    (token_partitions != 1 && token_partitions != 2 && token_partitions != 4 && token_partitions != 8)) {
+				usage(argv[0]);
+				return 2;
+			}
+			argi += 2;
+			continue;
+		}
+		if (argi + 1 < argc && strcmp(argv[argi], "--speed") == 0) {
+			int speed = 0;
+			preset = (parse_int(argv[argi + 1], &speed) == 0) ? enc_speed_preset(speed) : NULL;
+			if (!preset) {
+				usage(argv[0]);
+				return 2;
+			}
+			argi += 2;
+			continue;
+		}
 		if (argi + 1 < argc && strcmp(argv[argi], "--mode") == 0) {
 			if (parse_mode(argv[argi + 1], &mode) != 0) {
 				usage(argv[0]);
 				return 2;
 			}
+			given |= GIVEN_MODE;
 			argi += 2;
 			continue;
 		}
@@ -157,10 +218,13 @@ int main(int argc, char** argv) {
 				bpred_rdo_rate_mode = 1;
 			} else if (strcmp(s, "dry-run") == 0 || strcmp(s, "dryrun") == 0) {
 				bpred_rdo_rate_mode = 2;
+			} else if (strcmp(s, "table") == 0) {
+				bpred_rdo_rate_mode = 3;
 			} else {
 				usage(argv[0]);
 				return 2;
 			}
+			given |= GIVEN_RDO_RATE;
 			argi += 2;
 			continue;
 		}
@@ -243,11 +307,51 @@ int main(int argc, char** argv) {
 				usage(argv[0]);
 				return 2;
 			}
+			given |= GIVEN_RDO_PRUNE;
+			argi += 2;
+			continue;
+		}
+		if (argi + 1 < argc && strcmp(argv[argi], "--bpred-rdo-passes") == 0) {
+			int passes = 0;
+			if (parse_int(argv[argi + 1], &passes) != 0 || passes < 1 || passes > 2) {
+				usage(argv[0]);
+				return 2;
+			}
+			bpred_rdo_single_pass = (passes == 1);
+			given |= GIVEN_RDO_PASSES;
+			argi += 2;
+			continue;
+		}
+		if (argi + 1 < argc && strcmp(argv[argi], "--bpred-rdo-refine-rows") == 0) {
+			if (parse_int(argv[argi + 1], &bpred_rdo_refine_rows) != 0 || bpred_rdo_refine_rows < 0) {
+				usage(argv[0]);
+				return 2;
+			}
+			given |= GIVEN_RDO_REFINE;
+			argi += 2;
+			continue;
+		}
+		if (argi + 1 < argc && strcmp(argv[argi], "--bpred-rdo-stats-sample") == 0) {
+			if (parse_int(argv[argi + 1], &bpred_rdo_stats_sample) != 0 || bpred_rdo_stats_sample < 0) {
+				usage(argv[0]);
+				return 2;
+			}
 			argi += 2;
 			continue;
 		}
 		break;
 	}
+	if (preset) {
+		if (!(given & GIVEN_MODE)) {
+			mode = (preset->intra == ENC_SPEED_INTRA_I16)     ? ENC_MODE_I16
+			       : (preset->intra == ENC_SPEED_INTRA_BPRED) ? ENC_MODE_BPRED
+			                                                  : ENC_MODE_BPRED_RDO;
+		}
+		if (!(given & GIVEN_RDO_RATE)) bpred_rdo_rate_mode = (int)preset->rate_mode;
+		if (!(given & GIVEN_RDO_PRUNE)) bpred_rdo_satd_prune_k = (int)preset->satd_prune_k;
+		if (!(given & GIVEN_RDO_PASSES)) bpred_rdo_single_pass = (int)preset->single_pass;
+		if (!(given & GIVEN_RDO_REFINE)) bpred_rdo_refine_rows = (int)preset->refine_rows;
+	}
 
 	if (argc - argi != 2) {
 		usage(argv[0]);
@@ -256,28 +360,15 @@ int main(int argc, char** argv) {
 	const char* in_path = argv[argi++];
 	const char* out_path = argv[argi++];
 
-	EncPngImage img;
-	if (enc_png_read_file(in_path, &img) != 0) {
+	EncYuv420Image yuv;
+	if (enc_yuv420_from_png_file(in_path, &yuv) != 0) {
 		fprintf(stderr,
-		        "enc_png_read_file failed for %s (errno=%d: %s)\n",
+		        "PNG read failed for %s (errno=%d: %s)\n",
 		        in_path,
 		        errno,
 		        (errno != 0) ? strerror(errno) : "unknown");
 		return 1;
 	}
-	if (!(img.channels == 3 || img.channels == 4)) {
-		fprintf(stderr, "%s: unsupported channels=%u\n", in_path, img.channels);
-		enc_png_free(&img);
-		return 1;
-	}
-
-	EncYuv420Image yuv;
-	const uint32_t stride = img.width * (uint32_t)img.channels;
-	if (enc_yuv420_from_rgb_libwebp(img.data, img.width, img.height, stride, img.channels, &yuv) != 0) {
-		fprintf(stderr, "%s: RGB->YUV failed (errno=%d)\n", in_path, errno);
-		enc_png_free(&img);
-		return 1;
-	}
 
 	uint8_t* y_modes = NULL;
 	size_t y_modes_count = 0;
@@ -291,10 +382,11 @@ int main(int argc, char** argv) {
 
 	int rc = 0;
 	if (mode == ENC_MODE_DC) {
-		rc = enc_vp8_encode_dc_pred_inloop(&yuv, quality, &coeffs, &coeffs_count, &qindex);
+		rc = enc_vp8_encode_dc_pred_inloop(&yuv, quality, (uint32_t)threads, &coeffs, &coeffs_count, &qindex);
 	} else if (mode == ENC_MODE_I16) {
 		rc = enc_vp8_encode_i16x16_uv_sad_inloop(&yuv,
 		                                         quality,
+		                                         (uint32_t)threads,
 		                                         &y_modes,
 		                                         &y_modes_count,
 		                                         &uv_modes,
@@ -315,6 +407,10 @@ int main(int argc, char** argv) {
 		tuning.qscale_uv_dc_pct = (uint32_t)bpred_rdo_qscale_uv_dc_pct;
 		tuning.qscale_uv_ac_pct = (uint32_t)bpred_rdo_qscale_uv_ac_pct;
 		tuning.satd_prune_k = (uint32_t)bpred_rdo_satd_prune_k;
+		tuning.single_pass = (uint32_t)bpred_rdo_single_pass;
+		tuning.refine_rows = (uint32_t)bpred_rdo_refine_rows;
+		tuning.stats_sample_rows = (uint32_t)bpred_rdo_stats_sample;
+		tuning.threads = (uint32_t)threads;
 		rc = enc_vp8_encode_bpred_uv_rdo_inloop(&yuv,
 		                                       quality,
 						       token_probs_mode,
@@ -331,6 +427,7 @@ int main(int argc, char** argv) {
 	} else {
 		rc = enc_vp8_encode_bpred_uv_sad_inloop(&yuv,
 		                                       quality,
+		                                       (uint32_t)threads,
 		                                       &y_modes,
 		                                       &y_modes_count,
 		                                       &b_modes,
@@ -348,154 +445,67 @@ int main(int argc, char** argv) {
 		free(b_modes);
 		free(y_modes);
 		enc_yuv420_free(&yuv);
-		enc_png_free(&img);
 		return 1;
 	}
 
 	uint8_t* vp8 = NULL;
 	size_t vp8_size = 0;
-	if (enable_loopfilter) {
-		EncVp8LoopFilterParams lf;
-		enc_vp8_loopfilter_from_qindex(qindex, &lf);
-		if (mode == ENC_MODE_DC) {
-			rc = enc_vp8_build_keyframe_dc_coeffs_ex(img.width,
-			                                     img.height,
-			                                     qindex,
-			                                     0,
-			                                     0,
-			                                     0,
-			                                     0,
-			                                     0,
-			                                     &lf,
-			                                     coeffs,
-			                                     coeffs_count,
-			                                     &vp8,
-			                                     &vp8_size);
-		} else if (mode == ENC_MODE_I16) {
-			rc = enc_vp8_build_keyframe_i16_coeffs_ex(img.width,
-			                                      img.height,
-			                                      qindex,
-			                                      0,
-			                                      0,
-			                                      0,
-			                                      0,
-			                                      0,
-			                                      y_modes,
-			                                      uv_modes,
-			                                      &lf,
-			                                      coeffs,
-			                                      coeffs_count,
-			                                      &vp8,
-			                                      &vp8_size);
-		} else {
-			if (token_probs_mode == ENC_VP8_TOKEN_PROBS_DEFAULT) {
-				rc = enc_vp8_build_keyframe_intra_coeffs_ex(img.width,
-											img.height,
-											qindex,
-											0,
-											0,
-											0,
-											0,
-											0,
-										enable_mb_skip,
-											y_modes,
-											uv_modes,
-											b_modes,
-											&lf,
-											coeffs,
-											coeffs_count,
-											&vp8,
-											&vp8_size);
-			} else {
-				rc = enc_vp8_build_keyframe_intra_coeffs_ex_probs(img.width,
-												img.height,
-												qindex,
-												0,
-												0,
-												0,
-												0,
-												0,
-											enable_mb_skip,
-												y_modes,
-												uv_modes,
-												b_modes,
-												&lf,
-												token_probs_mode,
-												coeffs,
-												coeffs_count,
-												&vp8,
-												&vp8_size);
-			}
-		}
+	EncVp8LoopFilterParams lf;
+	enc_vp8_loopfilter_from_qindex(qindex, &lf);
+	const EncVp8LoopFilterParams* lfp = enable_loopfilter ? &lf : NULL;
+	if (mode == ENC_MODE_DC) {
+		rc = enc_vp8_build_keyframe_dc_coeffs_ex(yuv.width,
+		                                     yuv.height,
+		                                     qindex,
+		                                     0,
+		                                     0,
+		                                     0,
+		                                     0,
+		                                     0,
+		                                     lfp,
+		                                     (uint32_t)token_partitions,
+		                                     coeffs,
+		                                     coeffs_count,
+		                                     &vp8,
+		                                     &vp8_size);
+	} else if (mode == ENC_MODE_I16) {
+		rc = enc_vp8_build_keyframe_i16_coeffs_ex(yuv.width,
+		                                      yuv.height,
+		                                      qindex,
+		                                      0,
+		                                      0,
+		                                      0,
+		                                      0,
+		                                      0,
+		                                      y_modes,
+		                                      uv_modes,
+		                                      lfp,
+		                                      (uint32_t)token_partitions,
+		                                      coeffs,
+		                                      coeffs_count,
+		                                      &vp8,
+		                                      &vp8_size);
 	} else {
-		if (mode == ENC_MODE_DC) {
-			rc = enc_vp8_build_keyframe_dc_coeffs(img.width,
-			                                  img.height,
-			                                  qindex,
-			                                  0,
-			                                  0,
-			                                  0,
-			                                  0,
-			                                  0,
-			                                  coeffs,
-			                                  coeffs_count,
-			                                  &vp8,
-			                                  &vp8_size);
-		} else if (mode == ENC_MODE_I16) {
-			rc = enc_vp8_build_keyframe_i16_coeffs(img.width,
-			                                   img.height,
-			                                   qindex,
-			                                   0,
-			                                   0,
-			                                   0,
-			                                   0,
-			                                   0,
-			                                   y_modes,
-			                                   uv_modes,
-			                                   coeffs,
-			                                   coeffs_count,
-			                                   &vp8,
-			                                   &vp8_size);
-		} else {
-			if (token_probs_mode == ENC_VP8_TOKEN_PROBS_DEFAULT) {
-				rc = enc_vp8_build_keyframe_intra_coeffs_ex(img.width,
-										img.height,
-										qindex,
-										0,
-										0,
-										0,
-										0,
-										0,
-										enable_mb_skip,
-										y_modes,
-										uv_modes,
-										b_modes,
-										/*lf=*/NULL,
-										coeffs,
-										coeffs_count,
-										&vp8,
-										&vp8_size);
-			} else {
-				rc = enc_vp8_build_keyframe_intra_coeffs_ex_probs(img.width,
-												img.height,
-												qindex,
-												0,
-												0,
-												0,
-												0,
-												0,
-											enable_mb_skip,
-												y_modes,
-												uv_modes,
-												b_modes,
-												/*lf=*/NULL,
-												token_probs_mode,
-												coeffs,
-												coeffs_count,
-												&vp8,
-												&vp8_size);
-			}
-		}
+		// With ENC_VP8_TOKEN_PROBS_DEFAULT this is enc_vp8_build_keyframe_intra_coeffs_ex().
+		rc = enc_vp8_build_keyframe_intra_coeffs_ex_probs(yuv.width,
+		                                              yuv.height,
+		                                              qindex,
+		                                              0,
+		                                              0,
+		                                              0,
+		                                              0,
+		                                              0,
+		                                              enable_mb_skip,
+		                                              y_modes,
+		                                              uv_modes,
+		                                              b_modes,
+		                                              lfp,
+		                                              (uint32_t)token_partitions,
+		                                              token_probs_mode,
+		                                              coeffs,
+		                                              coeffs_count,
+		                                              &vp8,
+		                                              &vp8_size);
 	}
 
 	if (rc != 0 || !vp8 || vp8_size == 0) {
@@ -506,7 +516,6 @@ int main(int argc, char** argv) {
 		free(b_modes);
 		free(y_modes);
 		enc_yuv420_free(&yuv);
-		enc_png_free(&img);
 		return 1;
 	}
 
@@ -518,7 +527,6 @@ int main(int argc, char** argv) {
 		free(b_modes);
 		free(y_modes);
 		enc_yuv420_free(&yuv);
-		enc_png_free(&img);
 		return 1;
 	}
 
@@ -528,6 +536,5 @@ int main(int argc, char** argv) {
 	free(b_modes);
 	free(y_modes);
 	enc_yuv420_free(&yuv);
-	enc_png_free(&img);
 	return 0;
 }
@@ -1,4 +1,3 @@
-#include "enc-m00_png/enc_png.h"
 #include "enc-m01_riff/enc_riff.h"
 #include "enc-m04_yuv/enc_rgb_to_yuv.h"
 #include "enc-m08_recon/enc_recon.h"
@@ -9,27 +8,15 @@
 #include <stdlib.h>
 
 // Ultra/nolibc entrypoint: keep CLI minimal (like decoder_nolibc_ultra).
-// Usage: encoder_nolibc_ultra <in.png> <out.webp>
+// Usage: encoder_nolibc_ultra <in.png> <out.webp>   (- for stdin/stdout)
 
 int main(int argc, char** argv) {
 	if (argc != 3) return 2;
 	const char* in_path = argv[1];
 	const char* out_path = argv[2];
 
-	EncPngImage img;
-	if (enc_png_read_file(in_path, &img) != 0) return 1;
-	if (!(img.channels == 3 || img.channels == 4)) {
-		enc_png_free(&img);
-		errno = EINVAL;
-		return 1;
-	}
-
 	EncYuv420Image yuv;
-	const uint32_t stride = img.width * (uint32_t)img.channels;
-	if (enc_yuv420_from_rgb_libwebp(img.data, img.width, img.height, stride, img.channels, &yuv) != 0) {
-		enc_png_free(&img);
-		return 1;
-	}
+	if (enc_yuv420_from_png_file(in_path, &yuv) != 0) return 1;
 
 	// Fixed defaults for ultra build.
 	const int quality = 75;
@@ -46,6 +33,7 @@ int main(int argc, char** argv) {
 
 	int rc = enc_vp8_encode_bpred_uv_sad_inloop(&yuv,
 	                                           quality,
+	                                           /*threads=*/0,
 	                                           &y_modes,
 	                                           &y_modes_count,
 	                                           &b_modes,
@@ -61,14 +49,13 @@ int main(int argc, char** argv) {
 		free(b_modes);
 		free(y_modes);
 		enc_yuv420_free(&yuv);
-		enc_png_free(&img);
 		return 1;
 	}
 
 	uint8_t* vp8 = NULL;
 	size_t vp8_size = 0;
-	rc = enc_vp8_build_keyframe_intra_coeffs(img.width,
-	                                        img.height,
+	rc = enc_vp8_build_keyframe_intra_coeffs(yuv.width,
+	                                        yuv.height,
 	                                        qindex,
 	                                        0,
 	                                        0,
@@ -89,7 +76,6 @@ int main(int argc, char** argv) {
 		free(b_modes);
 		free(y_modes);
 		enc_yuv420_free(&yuv);
-		enc_png_free(&img);
 		return 1;
 	}
 
@@ -100,7 +86,6 @@ int main(int argc, char** argv) {
 		free(b_modes);
 		free(y_modes);
 		enc_yuv420_free(&yuv);
-		enc_png_free(&img);
 		return 1;
 	}
 
@@ -110,6 +95,5 @@ int main(int argc, char** argv) {
 	free(b_modes);
 	free(y_modes);
 	enc_yuv420_free(&yuv);
-	enc_png_free(&img);
 	return 0;
 }
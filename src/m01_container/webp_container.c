@@ -1,6 +1,8 @@
 #include "webp_container.h"
 
 #include <errno.h>
+#include <stdlib.h>
+#include <string.h>
 
 static int need(size_t off, size_t n, size_t size) {
 	return (off <= size) && (n <= size - off);
@@ -11,17 +13,28 @@ static uint32_t load_u32_le(const uint8_t* p) {
 	       ((uint32_t)p[3] << 24);
 }
 
+static uint32_t load_u24_le(const uint8_t* p) {
+	return ((uint32_t)p[0]) | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16);
+}
+
 static int fourcc_eq(uint32_t le, const char a[4]) {
 	return (uint8_t)le == (uint8_t)a[0] && (uint8_t)(le >> 8) == (uint8_t)a[1] &&
 	       (uint8_t)(le >> 16) == (uint8_t)a[2] && (uint8_t)(le >> 24) == (uint8_t)a[3];
 }
 
+#ifndef DECODER_ULTRA
+static int parse_extended_still(ByteSpan file, size_t off, WebPContainer* out);
+#endif
+
 int webp_parse_simple_lossy(ByteSpan file, WebPContainer* out) {
 	if (!out) return -1;
 	out->riff_size = 0;
 	out->actual_size = file.size;
 	out->vp8_chunk_offset = 0;
 	out->vp8_chunk_size = 0;
+	out->vp8x_flags = 0;
+	out->alph_chunk_offset = 0;
+	out->alph_chunk_size = 0;
 
 	// Need RIFF header: 'RIFF' + size + 'WEBP'
 	if (!file.data || file.size < 12) {
@@ -62,6 +75,9 @@ int webp_parse_simple_lossy(ByteSpan file, WebPContainer* out) {
 		return -1;
 	}
 	uint32_t chunk_tag = load_u32_le(file.data + off);
+#ifndef DECODER_ULTRA
+	if (fourcc_eq(chunk_tag, "VP8X")) return parse_extended_still(file, off, out);
+#endif
 	off += 4;
 	uint32_t chunk_size = load_u32_le(file.data + off);
 	off += 4;
@@ -87,3 +103,193 @@ int webp_parse_simple_lossy(ByteSpan file, WebPContainer* out) {
 
 	return 0;
 }
+
+// --- Extended layout (VP8X) ---
+
+// Checks 'RIFF' + size + 'WEBP' with the same strict size rule as above.
+static int check_riff_header(ByteSpan file) {
+	if (!file.data || file.size < 12 || !fourcc_eq(load_u32_le(file.data), "RIFF") ||
+	    !fourcc_eq(load_u32_le(file.data + 8), "WEBP") || (size_t)load_u32_le(file.data + 4) + 8 != file.size) {
+		errno = EINVAL;
+		return -1;
+	}
+	return 0;
+}
+
+// Steps over the chunk at *off within [*off, end): returns its payload span and
+// advances *off past the payload and its pad byte.
+static int next_chunk(const uint8_t* base, size_t* off, size_t end, uint32_t* tag, ByteSpan* payload) {
+	if (!need(*off, 8, end)) return -1;
+	*tag = load_u32_le(base + *off);
+	const uint32_t size = load_u32_le(base + *off + 4);
+	if (!need(*off + 8, size, end)) return -1;
+	payload->data = base + *off + 8;
+	payload->size = size;
+	*off += 8u + (size_t)size;
+	if ((size & 1u) && *off < end) (*off)++;
+	return 0;
+}
+
+#ifndef DECODER_ULTRA
+// VP8X [ICCP] [ALPH] VP8 [EXIF] [XMP], starting at the VP8X chunk header.
+static int parse_extended_still(ByteSpan file, size_t off, WebPContainer* out) {
+	uint32_t tag;
+	ByteSpan payload;
+	if (next_chunk(file.data, &off, file.size, &tag, &payload) != 0 || payload.size < 10 ||
+	    (payload.data[0] & WEBP_VP8X_ANIMATION)) {
+		errno = EINVAL;
+		return -1;
+	}
+	out->vp8x_flags = payload.data[0];
+
+	while (off < file.size) {
+		if (next_chunk(file.data, &off, file.size, &tag, &payload) != 0) {
+			errno = EINVAL;
+			return -1;
+		}
+		const size_t payload_off = (size_t)(payload.data - file.data);
+		if (fourcc_eq(tag, "ALPH")) {
+			// ALPH precedes the VP8 chunk; only the first one counts.
+			if (out->vp8_chunk_size == 0 && out->alph_chunk_size == 0) {
+				out->alph_chunk_offset = payload_off;
+				out->alph_chunk_size = (uint32_t)payload.size;
+			}
+		} else if (fourcc_eq(tag, "VP8 ")) {
+			if (out->vp8_chunk_size != 0) {
+				errno = EINVAL;
+				return -1;
+			}
+			out->vp8_chunk_offset = payload_off;
+			out->vp8_chunk_size = (uint32_t)payload.size;
+		} else if (fourcc_eq(tag, "VP8L") || fourcc_eq(tag, "ANMF")) {
+			errno = EINVAL;
+			return -1;
+		}
+	}
+	if (out->vp8_chunk_size == 0) {
+		errno = EINVAL;
+		return -1;
+	}
+	return 0;
+}
+#endif
+
+// --- Animated WebP ---
+
+int webp_is_animation(ByteSpan file) {
+	if (check_riff_header(file) != 0 || file.size < 30) return 0;
+	return fourcc_eq(load_u32_le(file.data + 12), "VP8X") && (file.data[20] & WEBP_VP8X_ANIMATION) != 0;
+}
+
+// Parses the sub-chunks of one ANMF payload (after its 16-byte header).
+static int parse_anmf(ByteSpan file, ByteSpan anmf, uint32_t canvas_w, uint32_t canvas_h, WebPAnimFrame* f) {
+	if (anmf.size < 16) return -1;
+	const uint8_t* h = anmf.data;
+	memset(f, 0, sizeof(*f));
+	f->x = 2u * load_u24_le(h + 0);
+	f->y = 2u * load_u24_le(h + 3);
+	f->width = 1u + load_u24_le(h + 6);
+	f->height = 1u + load_u24_le(h + 9);
+	f->duration_ms = load_u24_le(h + 12);
+	f->dispose = (uint8_t)(h[15] & 1u);
+	f->blend = (uint8_t)((h[15] & 2u) == 0);
+	if (f->x + f->width > canvas_w || f->y + f->height > canvas_h) return -1;
+
+	const size_t base = (size_t)(anmf.data - file.data);
+	size_t off = 16;
+	while (off < anmf.size) {
+		uint32_t tag;
+		ByteSpan payload;
+		if (next_chunk(anmf.data, &off, anmf.size, &tag, &payload) != 0) return -1;
+		const size_t payload_off = base + (size_t)(payload.data - anmf.data);
+		if (fourcc_eq(tag, "ALPH")) {
+			if (f->vp8_size || f->alph_size) return -1;
+			f->alph_offset = payload_off;
+			f->alph_size = (uint32_t)payload.size;
+		} else if (fourcc_eq(tag, "VP8 ") || fourcc_eq(tag, "VP8L")) {
+			if (f->vp8_size) return -1;
+			f->vp8_offset = payload_off;
+			f->vp8_size = (uint32_t)payload.size;
+			f->lossless = (uint8_t)fourcc_eq(tag, "VP8L");
+		}
+		// Unknown chunks are ignored (RFC 9649 "unknown chunks").
+	}
+	return f->vp8_size ? 0 : -1;
+}
+
+int webp_parse_animation(ByteSpan file, WebPAnimation* out) {
+	if (!out) return -1;
+	memset(out, 0, sizeof(*out));
+	if (check_riff_header(file) != 0) return -1;
+
+	size_t off = 12;
+	uint32_t tag;
+	ByteSpan vp8x;
+	if (next_chunk(file.data, &off, file.size, &tag, &vp8x) != 0 || !fourcc_eq(tag, "VP8X") || vp8x.size < 10 ||
+	    !(vp8x.data[0] & WEBP_VP8X_ANIMATION)) {
+		errno = EINVAL;
+		return -1;
+	}
+	out->flags = vp8x.data[0];
+	out->canvas_width = 1u + load_u24_le(vp8x.data + 4);
+	out->canvas_height = 1u + load_u24_le(vp8x.data + 7);
+
+	// Pass 1: validate the chunk list and count frames.
+	const size_t first = off;
+	int have_anim = 0;
+	uint32_t count = 0;
+	while (off < file.size) {
+		ByteSpan payload;
+		if (next_chunk(file.data, &off, file.size, &tag, &payload) != 0) {
+			errno = EINVAL;
+			return -1;
+		}
+		if (fourcc_eq(tag, "ANIM")) {
+			if (payload.size < 6 || have_anim) {
+				errno = EINVAL;
+				return -1;
+			}
+			out->bgcolor = load_u32_le(payload.data);
+			out->loop_count = (uint32_t)payload.data[4] | ((uint32_t)payload.data[5] << 8);
+			have_anim = 1;
+		} else if (fourcc_eq(tag, "ANMF")) {
+			if (!have_anim) {
+				errno = EINVAL;
+				return -1;
+			}
+			count++;
+		}
+	}
+	if (!have_anim || count == 0) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	// Pass 2: index the frames.
+	out->frames = (WebPAnimFrame*)calloc(count, sizeof(WebPAnimFrame));
+	if (!out->frames) {
+		errno = ENOMEM;
+		return -1;
+	}
+	off = first;
+	while (off < file.size) {
+		ByteSpan payload;
+		(void)next_chunk(file.data, &off, file.size, &tag, &payload);
+		if (!fourcc_eq(tag, "ANMF")) continue;
+		WebPAnimFrame* f = &out->frames[out->frame_count];
+		if (parse_anmf(file, payload, out->canvas_width, out->canvas_height, f) != 0) {
+			webp_animation_free(out);
+			errno = EINVAL;
+			return -1;
+		}
+		out->frame_count++;
+	}
+	return 0;
+}
+
+void webp_animation_free(WebPAnimation* anim) {
+	if (!anim) return;
+	free(anim->frames);
+	anim->frames = NULL;
+	anim->frame_count = 0;
+}
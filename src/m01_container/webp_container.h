@@ -9,11 +9,68 @@ typedef struct {
 	uint32_t riff_size;   // As stored in RIFF header (bytes from offset 8)
 	size_t actual_size;   // Actual mapped file size
 
-	// For milestone 1 we only support simple lossy: exactly one VP8 chunk.
+	// Lossy only: exactly one VP8 chunk.
 	size_t vp8_chunk_offset; // Offset of VP8 payload (not header)
 	uint32_t vp8_chunk_size; // Size of VP8 payload
+
+	// Extended layout (VP8X) only; all zero for the simple layout.
+	uint32_t vp8x_flags;      // VP8X flags byte (WEBP_VP8X_*)
+	size_t alph_chunk_offset; // Offset of ALPH payload (not header)
+	uint32_t alph_chunk_size; // Size of ALPH payload; 0 without an ALPH chunk
 } WebPContainer;
 
-// Parses a WebP container (RFC 9649) with simple lossy layout (VP8 chunk).
+// Parses a still lossy WebP container (RFC 9649): the simple layout (a single
+// VP8 chunk) or the extended layout (VP8X, optional ALPH, VP8; ICCP/EXIF/XMP and
+// unknown chunks are skipped). Animations and VP8L are rejected. The ultra build
+// accepts the simple layout only.
 // Returns 0 on success.
 int webp_parse_simple_lossy(ByteSpan file, WebPContainer* out);
+
+// --- Animated WebP (RFC 9649 5.x: VP8X + ANIM + ANMF) ---
+
+typedef struct {
+	// Frame rectangle on the canvas (x/y are even).
+	uint32_t x;
+	uint32_t y;
+	uint32_t width;
+	uint32_t height;
+	uint32_t duration_ms;
+	uint8_t blend;   // 1: alpha-blend onto the canvas, 0: overwrite the rectangle
+	uint8_t dispose; // 1: clear the rectangle to transparent after display
+
+	// Frame bitstream (offsets into the file). alph_size is 0 without an ALPH chunk;
+	// `lossless` marks a VP8L frame (not decodable here).
+	size_t vp8_offset;
+	uint32_t vp8_size;
+	size_t alph_offset;
+	uint32_t alph_size;
+	uint8_t lossless;
+} WebPAnimFrame;
+
+typedef struct {
+	uint32_t canvas_width;
+	uint32_t canvas_height;
+	uint32_t flags;      // VP8X flags byte
+	uint32_t bgcolor;    // ANIM background color, as stored (B, G, R, A from the low byte)
+	uint32_t loop_count; // 0 = infinite
+	uint32_t frame_count;
+	WebPAnimFrame* frames; // frame_count entries (malloc'd; see webp_animation_free())
+} WebPAnimation;
+
+// VP8X flag bits.
+enum {
+	WEBP_VP8X_ANIMATION = 0x02u,
+	WEBP_VP8X_XMP = 0x04u,
+	WEBP_VP8X_EXIF = 0x08u,
+	WEBP_VP8X_ALPHA = 0x10u,
+	WEBP_VP8X_ICC = 0x20u,
+};
+
+// Returns 1 if `file` is a RIFF/WEBP with a VP8X chunk that has the animation flag set.
+int webp_is_animation(ByteSpan file);
+
+// Builds the frame index of an animated WebP. Frames must lie inside the canvas.
+// Unknown chunks are skipped. Returns 0 on success (free with webp_animation_free()).
+int webp_parse_animation(ByteSpan file, WebPAnimation* out);
+
+void webp_animation_free(WebPAnimation* anim);
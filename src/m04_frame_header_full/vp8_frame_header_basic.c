@@ -103,8 +103,8 @@ int vp8_parse_frame_header_basic(ByteSpan vp8_payload, Vp8FrameHeaderBasic* out)
 	// Layout:
 	//   [uncompressed header 10 bytes]
 	//   [partition 0 data: first_partition_len bytes]
-	//   [if n>1: (n-1)*3 bytes sizes for partitions 1..n-2]
-	//   [token partitions 1..n-1 consecutive]
+	//   [if n>1: (n-1)*3 bytes sizes for token partitions 1..n-1]
+	//   [token partitions 1..n consecutive; the last one takes the rest]
 	const uint8_t n = out->total_partitions;
 	if (n > 1) {
 		size_t table_off = uncompressed + (size_t)kf.first_partition_len;
@@ -129,7 +129,7 @@ int vp8_parse_frame_header_basic(ByteSpan vp8_payload, Vp8FrameHeaderBasic* out)
 			errno = EINVAL;
 			return -1;
 		}
-		out->part_sizes[n - 1u] = (uint32_t)(token_data_len - (size_t)sum);
+		out->part_sizes[n] = (uint32_t)(token_data_len - (size_t)sum);
 	}
 
 	return 0;
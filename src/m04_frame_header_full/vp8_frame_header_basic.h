@@ -20,8 +20,8 @@ typedef struct {
 
 	// Partition sizes in bytes. part_sizes[0] is the first partition length
 	// from the frame tag ("Part. 0 length" in webpinfo).
-	// For total_partitions > 1, part_sizes[1..n-1] are DCT token partitions.
-	uint32_t part_sizes[8];
+	// For total_partitions > 1, part_sizes[1..n] are the DCT token partitions.
+	uint32_t part_sizes[9];
 
 	uint8_t base_q;           // 0..127
 	int8_t dq_y1_dc;
@@ -6,6 +6,8 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include "../common/arena.h"
+#include "../common/timing.h"
 #include "../m02_vp8_header/vp8_header.h"
 #include "../m03_bool_decoder/bool_decoder.h"
 #include "vp8_tree.h"
@@ -70,6 +72,18 @@ static const uint8_t Pcat4[] = {176, 155, 140, 135, 0};
 static const uint8_t Pcat5[] = {180, 157, 141, 134, 130, 0};
 static const uint8_t Pcat6[] = {254, 254, 243, 230, 196, 177, 153, 140, 133, 130, 129, 0};
 
+// Bools one token costs when read from the root of coeff_tree: the tree path,
+// the extra bits of its category (Pcat* lengths) and the sign of a non-zero
+// value. A token read right after DCT_0 skips the EOB branch, one bool less.
+// decode_block() derives the -timings bool count from this table instead of
+// counting inside bool_decode_bool().
+static const uint8_t token_bools[num_dct_tokens] = {
+	2, 4, 6, 7, 7,     // DCT_0..DCT_4
+	8, 9, 11, 12, 13, // dct_cat1..dct_cat5
+	19,               // dct_cat6
+	1,                // dct_eob
+};
+
 static uint32_t vp8_read_extra(BoolDecoder* d, const uint8_t* p) {
 	uint32_t v = 0;
 	while (*p) {
@@ -218,39 +232,72 @@ static intra_bmode mbmode_to_bmode(intra_mbmode m) {
 	}
 }
 
-// --- Coefficient decode ---
+// --- Dequantization ---
 
-typedef struct {
-	uint8_t has_y2;
-	uint8_t skip_coeff;
-	uint8_t segment_id;
-	uint8_t ymode;
-	uint8_t uv_mode;
-} MbInfo;
-
-static int checked_mul_size(size_t a, size_t b, size_t* out) {
-	if (!out) return -1;
-	if (a == 0 || b == 0) {
-		*out = 0;
-		return 0;
-	}
-	if (a > SIZE_MAX / b) return -1;
-	*out = a * b;
-	return 0;
+static inline int clamp_q(int q) {
+	if (q < 0) return 0;
+	if (q > 127) return 127;
+	return q;
 }
 
-static void* xcalloc_array(size_t nmemb, size_t size) {
-	size_t total = 0;
-	if (checked_mul_size(nmemb, size, &total) != 0) return NULL;
-	return calloc(1, total);
-}
+// Dequant lookup tables from RFC 6386 (dequant_data.h).
+#define QINDEX_RANGE 128
+static const int dc_qlookup[QINDEX_RANGE] = {
+	4, 5, 6, 7, 8, 9, 10, 10, 11, 12, 13, 14, 15, 16, 17, 17, 18, 19, 20, 20, 21, 21, 22, 22, 23, 23,
+	24, 25, 25, 26, 27, 28, 29, 30, 31, 32, 33, 34, 35, 36, 37, 37, 38, 39, 40, 41, 42, 43, 44, 45,
+	46, 46, 47, 48, 49, 50, 51, 52, 53, 54, 55, 56, 57, 58, 59, 60, 61, 62, 63, 64, 65, 66, 67, 68,
+	69, 70, 71, 72, 73, 74, 75, 76, 76, 77, 78, 79, 80, 81, 82, 83, 84, 85, 86, 87, 88, 89, 91, 93,
+	95, 96, 98, 100, 101, 102, 104, 106, 108, 110, 112, 114, 116, 118, 122, 124, 126, 128, 130, 132, 134,
+	136, 138, 140, 143, 145, 148, 151, 154, 157,
+};
 
-static void* xmalloc_array(size_t nmemb, size_t size) {
-	size_t total = 0;
-	if (checked_mul_size(nmemb, size, &total) != 0) return NULL;
-	return malloc(total);
+static const int ac_qlookup[QINDEX_RANGE] = {
+	4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 16, 17, 18, 19, 20, 21, 22, 23, 24, 25, 26, 27, 28, 29,
+	30, 31, 32, 33, 34, 35, 36, 37, 38, 39, 40, 41, 42, 43, 44, 45, 46, 47, 48, 49, 50, 51, 52, 53,
+	54, 55, 56, 57, 58, 60, 62, 64, 66, 68, 70, 72, 74, 76, 78, 80, 82, 84, 86, 88, 90, 92, 94, 96,
+	98, 100, 102, 104, 106, 108, 110, 112, 114, 116, 119, 122, 125, 128, 131, 134, 137, 140, 143, 146, 149,
+	152, 155, 158, 161, 164, 167, 170, 173, 177, 181, 185, 189, 193, 197, 201, 205, 209, 213, 217, 221, 225,
+	229, 234, 239, 245, 249, 254, 259, 264, 269, 274, 279, 284,
+};
+
+static inline int dc_q(int q) { return dc_qlookup[clamp_q(q)]; }
+static inline int ac_q(int q) { return ac_qlookup[clamp_q(q)]; }
+
+typedef enum {
+	TOKEN_BLOCK_Y1 = 0,
+	TOKEN_BLOCK_UV = 1,
+	TOKEN_BLOCK_Y2 = 2,
+} TokenBlock;
+
+typedef struct {
+	int quant_idx;
+	int factor[3][2];
+} DequantFactors;
+
+// Per-segment factors; decode_block() multiplies each coefficient it decodes.
+static void dequant_init(DequantFactors* dqf, const Vp8DecodedFrame* decoded) {
+	// Mirrors RFC 6386 reference dequant_init().
+	int seg_count = decoded->segmentation_enabled ? 4 : 1;
+	for (int i = 0; i < seg_count; i++) {
+		int q = (int)decoded->q_index;
+		if (decoded->segmentation_enabled) {
+			q = decoded->segmentation_abs ? decoded->seg_quant_idx[i] : (q + decoded->seg_quant_idx[i]);
+		}
+		dqf[i].quant_idx = q;
+
+		dqf[i].factor[TOKEN_BLOCK_Y1][0] = dc_q(q + decoded->y1_dc_delta_q);
+		dqf[i].factor[TOKEN_BLOCK_Y1][1] = ac_q(q);
+		dqf[i].factor[TOKEN_BLOCK_UV][0] = dc_q(q + decoded->uv_dc_delta_q);
+		dqf[i].factor[TOKEN_BLOCK_UV][1] = ac_q(q + decoded->uv_ac_delta_q);
+		dqf[i].factor[TOKEN_BLOCK_Y2][0] = dc_q(q + decoded->y2_dc_delta_q) * 2;
+		dqf[i].factor[TOKEN_BLOCK_Y2][1] = ac_q(q + decoded->y2_ac_delta_q) * 155 / 100;
+		if (dqf[i].factor[TOKEN_BLOCK_Y2][1] < 8) dqf[i].factor[TOKEN_BLOCK_Y2][1] = 8;
+		if (dqf[i].factor[TOKEN_BLOCK_UV][0] > 132) dqf[i].factor[TOKEN_BLOCK_UV][0] = 132;
+	}
 }
 
+// --- Coefficient decode ---
+
 static int read_coeff_token(BoolDecoder* d, const uint8_t probs[num_dct_tokens - 1], int prev_token_was_zero) {
 	int start_node = prev_token_was_zero ? 2 : 0; // skip eob branch when prev token was DCT_0
 	return vp8_treed_read(d, coeff_tree, probs, start_node);
@@ -281,21 +328,29 @@ static int decode_block(BoolDecoder* d,
 					uint32_t* io_eob_tokens,
 					uint32_t* io_abs_max,
 					int16_t out_block[16],
+					int16_t* dst,
+					uint32_t dst_n,
+					const int dq[2],
 					Vp8CoeffStats* out_stats,
 					uint32_t mb_index,
 					uint32_t plane,
 					uint32_t block_index) {
 	for (int i = 0; i < 16; i++) out_block[i] = 0;
 
+	// dst receives the dequantized values (dq[0] for the DC, dq[1] for AC) of the
+	// first dst_n coefficients in natural order; the rest of it stays untouched.
 	int ctx3 = (int)left_has + (int)above_has;
 	int prev_token_was_zero = 0;
 	int current_has_coeffs = 0;
+	uint32_t bools = 0;
 
 	for (int i = first_coeff; i < 16; i++) {
 		int band = (int)coeff_bands[i];
 		const uint8_t* probs = coeff_probs_plane[band][ctx3];
 
 		int token = read_coeff_token(d, probs, prev_token_was_zero);
+		bools += (uint32_t)(token_bools[token] - prev_token_was_zero);
+		if (out_stats) out_stats->coeff_tokens++;
 		if (bool_decoder_overread(d)) {
 			record_token_overread_loc(out_stats, mb_index, plane, block_index, (uint32_t)i, /*stage=*/0);
 		}
@@ -335,6 +390,7 @@ static int decode_block(BoolDecoder* d,
 			}
 			int v = sign ? -abs_value : abs_value;
 			out_block[zigzag[i]] = (int16_t)v;
+			if (zigzag[i] < dst_n) dst[zigzag[i]] = (int16_t)(v * dq[i > 0]);
 			current_has_coeffs = 1;
 			if (io_nonzero_coeffs) (*io_nonzero_coeffs)++;
 			uint32_t absu = (uint32_t)abs_value;
@@ -348,62 +404,176 @@ static int decode_block(BoolDecoder* d,
 		prev_token_was_zero = (token == DCT_0);
 	}
 
+	if (out_stats) out_stats->bool_decodes += bools;
 	return current_has_coeffs;
 }
 
-static int decode_all_coeffs_keyframe(ByteSpan vp8_payload, const Vp8KeyFrameHeader* kf, uint8_t total_partitions,
-					  const MbInfo* mbs, uint32_t mb_cols, uint32_t mb_rows, Vp8CoeffStats* out,
-					  Vp8DecodedFrame* frame, uint64_t* io_hash) {
-	if (total_partitions != 1) {
-		errno = ENOTSUP;
-		return -1;
+// Hashes the quantized values of a decoded block (the -info coefficient hash).
+static void hash_block(const int16_t block[16], uint64_t* io_hash) {
+	for (int i = 0; i < 16; i++) *io_hash = fnv1a64_i32(*io_hash, block[i]);
+}
+
+// A skipped block hashes as 16 zeros; its coefficients stay zeroed.
+static void hash_zero_block(uint64_t* io_hash) {
+	for (int i = 0; i < 16; i++) *io_hash = fnv1a64_i32(*io_hash, 0);
+}
+
+// Partition 0 after the frame header: the per-macroblock mode records, read
+// one macroblock at a time as the token sweep reaches it.
+typedef struct {
+	BoolDecoder* d;
+	uint8_t read_segment_id; // segmentation enabled and update_mb_segmentation_map
+	uint8_t segment_probs[3];
+	uint8_t read_skip;       // mb_no_skip_coeff
+	uint8_t prob_skip_false;
+	intra_bmode* above_bmodes; // [mb_cols*4] subblock mode contexts (B_PRED parsing)
+	intra_bmode left_bmodes[4];
+} ModeParser;
+
+static void parse_mb_modes(ModeParser* p, uint32_t mb_c, Vp8DecodedFrame* out, Vp8MbRecord* rec) {
+	BoolDecoder* d = p->d;
+	intra_bmode* above_bmodes = p->above_bmodes;
+	intra_bmode* left_bmodes = p->left_bmodes;
+	if (mb_c == 0) {
+		for (int rr = 0; rr < 4; rr++) left_bmodes[rr] = B_DC_PRED;
+	}
+
+	if (p->read_segment_id) {
+		static const int8_t mb_segment_tree[2 * (4 - 1)] = {2, 4, 0, -1, -2, -3};
+		rec->segment_id = (uint8_t)vp8_treed_read(d, mb_segment_tree, p->segment_probs, 0);
+	}
+
+	if (p->read_skip && bool_decode_bool(d, p->prob_skip_false)) {
+		rec->flags |= VP8_MB_SKIP;
+		out->stats.mb_skip_coeff++;
+	}
+
+	intra_mbmode ymode = (intra_mbmode)vp8_treed_read(d, kf_ymode_tree, kf_ymode_prob, 0);
+	rec->ymode = (uint8_t)ymode;
+	if ((unsigned)ymode < 5u) out->stats.ymode_counts[(unsigned)ymode]++;
+	if (ymode == B_PRED) {
+		out->stats.mb_b_pred++;
+		intra_bmode local[4][4];
+		for (int rr = 0; rr < 4; rr++)
+			for (int cc = 0; cc < 4; cc++) local[rr][cc] = B_DC_PRED;
+		for (int rr = 0; rr < 4; rr++) {
+			for (int cc = 0; cc < 4; cc++) {
+				intra_bmode A = (rr == 0) ? above_bmodes[mb_c * 4 + cc] : local[rr - 1][cc];
+				intra_bmode L = (cc == 0) ? left_bmodes[rr] : local[rr][cc - 1];
+				const uint8_t* probs = kf_bmode_prob[A][L];
+				local[rr][cc] = (intra_bmode)vp8_treed_read(d, bmode_tree, probs, 0);
+				if ((unsigned)local[rr][cc] < 10u) out->stats.bmode_counts[(unsigned)local[rr][cc]]++;
+			}
+		}
+		for (int i = 0; i < 8; i++) {
+			const intra_bmode lo = local[i >> 1][(i & 1) * 2];
+			const intra_bmode hi = local[i >> 1][(i & 1) * 2 + 1];
+			rec->bmodes[i] = (uint8_t)((unsigned)lo | ((unsigned)hi << 4));
+		}
+		for (int cc = 0; cc < 4; cc++) above_bmodes[mb_c * 4 + cc] = local[3][cc];
+		for (int rr = 0; rr < 4; rr++) left_bmodes[rr] = local[rr][3];
+	} else {
+		intra_bmode derived = mbmode_to_bmode(ymode);
+		for (int cc = 0; cc < 4; cc++) above_bmodes[mb_c * 4 + cc] = derived;
+		for (int rr = 0; rr < 4; rr++) left_bmodes[rr] = derived;
+		memset(rec->bmodes, (int)((unsigned)derived | ((unsigned)derived << 4)), sizeof(rec->bmodes));
 	}
 
+	unsigned uv_mode = (unsigned)vp8_treed_read(d, uv_mode_tree, kf_uv_mode_prob, 0);
+	rec->uv_mode = (uint8_t)uv_mode;
+	if (uv_mode < 4u) out->stats.uv_mode_counts[uv_mode]++;
+}
+
+// Depth of `symbol` below `node`, i.e. the bools vp8_treed_read() spends on it
+// (0 if the symbol is not in the tree).
+static uint32_t tree_depth(const int8_t* tree, int node, int symbol) {
+	for (int b = 0; b < 2; b++) {
+		const int next = tree[node + b];
+		if (next <= 0) {
+			if (-next == symbol) return 1;
+		} else {
+			const uint32_t depth = tree_depth(tree, next, symbol);
+			if (depth) return depth + 1;
+		}
+	}
+	return 0;
+}
+
+// Bools of the macroblock records, derived from the mode tallies once the
+// sweep is done so that parse_mb_modes() does not count them one by one.
+static uint64_t mode_bools(const Vp8CoeffStats* s, const ModeParser* p) {
+	uint64_t mbs = 0;
+	uint64_t bools = 0;
+	for (int m = 0; m < num_ymodes; m++) {
+		mbs += s->ymode_counts[m];
+		bools += (uint64_t)s->ymode_counts[m] * tree_depth(kf_ymode_tree, 0, m);
+	}
+	for (int m = 0; m < num_intra_bmodes; m++) bools += (uint64_t)s->bmode_counts[m] * tree_depth(bmode_tree, 0, m);
+	for (int m = 0; m < num_uv_modes; m++) bools += (uint64_t)s->uv_mode_counts[m] * tree_depth(uv_mode_tree, 0, m);
+	// The segment tree is two levels deep for every id; the skip flag is one bool.
+	bools += mbs * (2u * p->read_segment_id + p->read_skip);
+	return bools;
+}
+
+// Single sweep over the macroblocks: each one's modes are read from partition 0
+// right before its tokens are read from the token partition (as libvpx and
+// libwebp do), so no frame-sized mode array sits between the two passes.
+// With several token partitions, macroblock row r reads from partition
+// r % total_partitions (RFC 6386 9.5); the non-zero contexts carry across them.
+static int decode_macroblocks(ByteSpan vp8_payload, const Vp8KeyFrameHeader* kf, uint8_t total_partitions,
+			      ModeParser* modes, uint32_t mb_cols, uint32_t mb_rows,
+			      uint8_t coeff_probs[4][8][3][num_dct_tokens - 1], const DequantFactors dqf[4], Vp8CoeffStats* out,
+			      Vp8DecodedFrame* frame, uint64_t* io_hash) {
 	const size_t uncompressed = 10;
-	size_t token_off = uncompressed + (size_t)kf->first_partition_len;
-	// No size table when total_partitions==1.
-	if (vp8_payload.size < token_off) {
+	// The partition size table: 3-byte little-endian sizes of all but the
+	// last token partition, which takes the rest of the payload.
+	const size_t table_off = uncompressed + (size_t)kf->first_partition_len;
+	const size_t table_len = (size_t)(total_partitions - 1u) * 3u;
+	if (vp8_payload.size < table_off + table_len) {
 		errno = EINVAL;
 		return -1;
 	}
-	ByteSpan token_part = {
-		.data = vp8_payload.data + token_off,
-		.size = vp8_payload.size - token_off,
-	};
-	out->token_part_size_bytes = (uint32_t)token_part.size;
-	BoolDecoder d;
-	if (bool_decoder_init(&d, token_part) != 0) return -1;
-
-	// Initialize coefficient probabilities (defaults, then apply updates during header parse).
-	// For now (single-frame stills), we decode using probabilities that were already updated
-	// during header parsing and stored in a static buffer.
-	//
-	// We pass them via a global static to keep the interface small.
-	extern uint8_t g_coeff_probs[4][8][3][num_dct_tokens - 1];
-
-	uint8_t* above_y = NULL;
-	uint8_t* above_u = NULL;
-	uint8_t* above_v = NULL;
-	uint8_t* above_y2 = NULL;
+	size_t token_off = table_off + table_len;
+	BoolDecoder parts[8];
+	uint32_t part_sizes[8];
+	for (uint32_t p = 0; p < total_partitions; p++) {
+		size_t size = vp8_payload.size - token_off;
+		if (p + 1u < total_partitions) {
+			const uint8_t* t = vp8_payload.data + table_off + (size_t)p * 3u;
+			const size_t sz = (size_t)t[0] | ((size_t)t[1] << 8) | ((size_t)t[2] << 16);
+			if (sz > size) {
+				errno = EINVAL;
+				return -1;
+			}
+			size = sz;
+		}
+		ByteSpan token_part = {
+			.data = vp8_payload.data + token_off,
+			.size = size,
+		};
+		if (bool_decoder_init(&parts[p], token_part) != 0) return -1;
+		part_sizes[p] = (uint32_t)size;
+		token_off += size;
+	}
+	out->token_part_size_bytes = (uint32_t)(vp8_payload.size - (table_off + table_len));
+
+	// coeff_probs holds the defaults plus the updates read during header parsing.
+	// It is per-call state (not a global) so frames can be decoded concurrently.
+
+	// Non-zero contexts of the row above (part of the frame arena, see frame_arena_size()).
+	uint8_t* above_y = (uint8_t*)arena_alloc(&frame->arena, (size_t)mb_cols * 4u, sizeof(uint8_t));
+	uint8_t* above_u = (uint8_t*)arena_alloc(&frame->arena, (size_t)mb_cols * 2u, sizeof(uint8_t));
+	uint8_t* above_v = (uint8_t*)arena_alloc(&frame->arena, (size_t)mb_cols * 2u, sizeof(uint8_t));
+	uint8_t* above_y2 = (uint8_t*)arena_alloc(&frame->arena, (size_t)mb_cols, sizeof(uint8_t));
+	if (!above_y || !above_u || !above_v || !above_y2) return -1;
 	uint8_t left_y[4] = {0, 0, 0, 0};
 	uint8_t left_u[2] = {0, 0};
 	uint8_t left_v[2] = {0, 0};
 	uint8_t left_y2_flag = 0;
 
-	above_y = (uint8_t*)xcalloc_array((size_t)mb_cols * 4u, sizeof(uint8_t));
-	above_u = (uint8_t*)xcalloc_array((size_t)mb_cols * 2u, sizeof(uint8_t));
-	above_v = (uint8_t*)xcalloc_array((size_t)mb_cols * 2u, sizeof(uint8_t));
-	above_y2 = (uint8_t*)xcalloc_array((size_t)mb_cols, sizeof(uint8_t));
-	if (!above_y || !above_u || !above_v || !above_y2) {
-		free(above_y);
-		free(above_u);
-		free(above_v);
-		free(above_y2);
-		errno = ENOMEM;
-		return -1;
-	}
-
+	const uint32_t bc = frame->block_coeffs;
 	for (uint32_t mb_r = 0; mb_r < mb_rows; mb_r++) {
+		BoolDecoder* d = &parts[mb_r & (total_partitions - 1u)];
 		left_y[0] = left_y[1] = left_y[2] = left_y[3] = 0;
 		left_u[0] = left_u[1] = 0;
 		left_v[0] = left_v[1] = 0;
@@ -411,233 +581,161 @@ static int decode_all_coeffs_keyframe(ByteSpan vp8_payload, const Vp8KeyFrameHea
 
 		for (uint32_t mb_c = 0; mb_c < mb_cols; mb_c++) {
 			uint32_t mb_index = mb_r * mb_cols + mb_c;
-			MbInfo info = mbs[mb_index];
-			int mb_has_coeff = 0;
+			Vp8MbRecord* rec = &frame->mbs[mb_index];
+			(void)dec_timing_switch(DEC_STAGE_MODES);
+			parse_mb_modes(modes, mb_c, frame, rec);
+			(void)dec_timing_switch(DEC_STAGE_TOKENS);
+			const int has_y2 = rec->ymode != B_PRED;
+			const int skip = (rec->flags & VP8_MB_SKIP) != 0;
+			int16_t* coeffs = vp8_mb_coeffs(frame, mb_index);
+			const DequantFactors* q = &dqf[frame->segmentation_enabled ? (rec->segment_id & 3u) : 0u];
 
 			int16_t block[16];
-			int16_t* dst = NULL;
 
 			// Y2
-			if (info.has_y2) {
+			if (has_y2) {
 				out->blocks_total_y2++;
-				uint8_t left_has = left_y2_flag;
-				uint8_t above_has = above_y2[mb_c];
 				int has = 0;
-				if (!info.skip_coeff) {
-					has = decode_block(&d,
-					                 g_coeff_probs[1],
-					                 0,
-					                 left_has,
-					                 above_has,
-					                 &out->coeff_nonzero_total,
-					                 &out->coeff_eob_tokens,
-					                 &out->coeff_abs_max,
-					                 block,
-					                 out,
-					                 mb_index,
-					                 /*plane=*/1,
-					                 /*block_index=*/0);
-					dst = frame ? (frame->coeff_y2 + (size_t)mb_index * 16u) : NULL;
-					for (int i = 0; i < 16; i++) {
-						*io_hash = fnv1a64_i32(*io_hash, block[i]);
-						if (dst) dst[i] = block[i];
-					}
+				if (!skip) {
+					has = decode_block(d, coeff_probs[1], 0, left_y2_flag, above_y2[mb_c], &out->coeff_nonzero_total,
+					                   &out->coeff_eob_tokens, &out->coeff_abs_max, block, coeffs, 16u,
+					                   q->factor[TOKEN_BLOCK_Y2], out, mb_index, /*plane=*/1, /*block_index=*/0);
+					hash_block(block, io_hash);
 				} else {
-					dst = frame ? (frame->coeff_y2 + (size_t)mb_index * 16u) : NULL;
-					for (int i = 0; i < 16; i++) {
-						*io_hash = fnv1a64_i32(*io_hash, 0);
-						if (dst) dst[i] = 0;
-					}
+					hash_zero_block(io_hash);
+				}
+				if (has) {
+					out->blocks_nonzero_y2++;
+					rec->flags |= VP8_MB_NZ_Y2;
 				}
-				if (has) out->blocks_nonzero_y2++;
-				if (has) mb_has_coeff = 1;
 				above_y2[mb_c] = (uint8_t)has;
 				left_y2_flag = (uint8_t)has;
-			} else {
-				dst = frame ? (frame->coeff_y2 + (size_t)mb_index * 16u) : NULL;
-				if (dst) {
-					for (int i = 0; i < 16; i++) dst[i] = 0;
-				}
 			}
 
 			// Y blocks
 			uint8_t y_has[4][4];
 			for (int rr = 0; rr < 4; rr++) for (int cc = 0; cc < 4; cc++) y_has[rr][cc] = 0;
 
-			int y_plane = info.has_y2 ? 0 : 3;
-			int first_coeff = info.has_y2 ? 1 : 0;
+			int y_plane = has_y2 ? 0 : 3;
+			int first_coeff = has_y2 ? 1 : 0;
+			int16_t* cy = coeffs + VP8_MB_COEFFS_Y2;
 
 			for (int rr = 0; rr < 4; rr++) {
 				for (int cc = 0; cc < 4; cc++) {
 					out->blocks_total_y++;
 					uint8_t left_has = (cc == 0) ? left_y[rr] : y_has[rr][cc - 1];
 					uint8_t above_has = (rr == 0) ? above_y[mb_c * 4 + cc] : y_has[rr - 1][cc];
+					const uint32_t b = (uint32_t)(rr * 4 + cc);
 					int has = 0;
-					if (!info.skip_coeff) {
-						has = decode_block(&d,
-					                 g_coeff_probs[y_plane],
-					                 first_coeff,
-					                 left_has,
-					                 above_has,
-					                 &out->coeff_nonzero_total,
-					                 &out->coeff_eob_tokens,
-					                 &out->coeff_abs_max,
-					                 block,
-					                 out,
-					                 mb_index,
-					                 /*plane=*/0,
-					                 /*block_index=*/(uint32_t)(rr * 4 + cc));
-						size_t blk = (size_t)mb_index * 16u + (size_t)(rr * 4 + cc);
-						dst = frame ? (frame->coeff_y + blk * 16u) : NULL;
-						for (int i = 0; i < 16; i++) {
-							*io_hash = fnv1a64_i32(*io_hash, block[i]);
-							if (dst) dst[i] = block[i];
-						}
+					if (!skip) {
+						has = decode_block(d, coeff_probs[y_plane], first_coeff, left_has, above_has,
+						                   &out->coeff_nonzero_total, &out->coeff_eob_tokens, &out->coeff_abs_max,
+						                   block, cy + b * bc, bc, q->factor[TOKEN_BLOCK_Y1], out, mb_index,
+						                   /*plane=*/0, /*block_index=*/b);
+						hash_block(block, io_hash);
 					} else {
-						size_t blk = (size_t)mb_index * 16u + (size_t)(rr * 4 + cc);
-						dst = frame ? (frame->coeff_y + blk * 16u) : NULL;
-						for (int i = 0; i < 16; i++) {
-							*io_hash = fnv1a64_i32(*io_hash, 0);
-							if (dst) dst[i] = 0;
-						}
+						hash_zero_block(io_hash);
 					}
-					if (has) out->blocks_nonzero_y++;
-					if (has) mb_has_coeff = 1;
-					y_has[rr][cc] = (uint8_t)has;
-				}
-			}
-			for (int cc = 0; cc < 4; cc++) {
-				above_y[mb_c * 4 + cc] = y_has[3][cc];
-			}
-			for (int rr = 0; rr < 4; rr++) {
-				left_y[rr] = y_has[rr][3];
-			}
-
-			// U blocks (2x2)
-			uint8_t u_has[2][2] = {{0, 0}, {0, 0}};
-			for (int rr = 0; rr < 2; rr++) {
-				for (int cc = 0; cc < 2; cc++) {
-					out->blocks_total_u++;
-					uint8_t left_has = (cc == 0) ? left_u[rr] : u_has[rr][cc - 1];
-					uint8_t above_has = (rr == 0) ? above_u[mb_c * 2 + cc] : u_has[rr - 1][cc];
-					int has = 0;
-					if (!info.skip_coeff) {
-						has = decode_block(&d,
-					                 g_coeff_probs[2],
-					                 0,
-					                 left_has,
-					                 above_has,
-					                 &out->coeff_nonzero_total,
-					                 &out->coeff_eob_tokens,
-					                 &out->coeff_abs_max,
-					                 block,
-					                 out,
-					                 mb_index,
-					                 /*plane=*/2,
-					                 /*block_index=*/(uint32_t)(rr * 2 + cc));
-						size_t blk = (size_t)mb_index * 4u + (size_t)(rr * 2 + cc);
-						dst = frame ? (frame->coeff_u + blk * 16u) : NULL;
-						for (int i = 0; i < 16; i++) {
-							*io_hash = fnv1a64_i32(*io_hash, block[i]);
-							if (dst) dst[i] = block[i];
-						}
-					} else {
-						size_t blk = (size_t)mb_index * 4u + (size_t)(rr * 2 + cc);
-						dst = frame ? (frame->coeff_u + blk * 16u) : NULL;
-						for (int i = 0; i < 16; i++) {
-							*io_hash = fnv1a64_i32(*io_hash, 0);
-							if (dst) dst[i] = 0;
-						}
+					if (has) {
+						out->blocks_nonzero_y++;
+						rec->nz_y = (uint16_t)(rec->nz_y | (1u << b));
 					}
-					if (has) out->blocks_nonzero_u++;
-					if (has) mb_has_coeff = 1;
-					u_has[rr][cc] = (uint8_t)has;
+					y_has[rr][cc] = (uint8_t)has;
 				}
 			}
-			for (int cc = 0; cc < 2; cc++) above_u[mb_c * 2 + cc] = u_has[1][cc];
-			for (int rr = 0; rr < 2; rr++) left_u[rr] = u_has[rr][1];
-
-			// V blocks (2x2)
-			uint8_t v_has[2][2] = {{0, 0}, {0, 0}};
-			for (int rr = 0; rr < 2; rr++) {
-				for (int cc = 0; cc < 2; cc++) {
-					out->blocks_total_v++;
-					uint8_t left_has = (cc == 0) ? left_v[rr] : v_has[rr][cc - 1];
-					uint8_t above_has = (rr == 0) ? above_v[mb_c * 2 + cc] : v_has[rr - 1][cc];
-					int has = 0;
-					if (!info.skip_coeff) {
-						has = decode_block(&d,
-					                 g_coeff_probs[2],
-					                 0,
-					                 left_has,
-					                 above_has,
-					                 &out->coeff_nonzero_total,
-					                 &out->coeff_eob_tokens,
-					                 &out->coeff_abs_max,
-					                 block,
-					                 out,
-					                 mb_index,
-					                 /*plane=*/3,
-					                 /*block_index=*/(uint32_t)(rr * 2 + cc));
-						size_t blk = (size_t)mb_index * 4u + (size_t)(rr * 2 + cc);
-						dst = frame ? (frame->coeff_v + blk * 16u) : NULL;
-						for (int i = 0; i < 16; i++) {
-							*io_hash = fnv1a64_i32(*io_hash, block[i]);
-							if (dst) dst[i] = block[i];
+			for (int cc = 0; cc < 4; cc++) above_y[mb_c * 4 + cc] = y_has[3][cc];
+			for (int rr = 0; rr < 4; rr++) left_y[rr] = y_has[rr][3];
+
+			// U then V blocks (4 each)
+			for (int plane = 2; plane <= 3; plane++) {
+				uint8_t* above = (plane == 2) ? above_u : above_v;
+				uint8_t* left = (plane == 2) ? left_u : left_v;
+				int16_t* cuv = cy + (16u + (uint32_t)(plane - 2) * 4u) * bc;
+				uint8_t uv_has[2][2] = {{0, 0}, {0, 0}};
+				for (int rr = 0; rr < 2; rr++) {
+					for (int cc = 0; cc < 2; cc++) {
+						const uint32_t b = (uint32_t)(rr * 2 + cc);
+						uint8_t left_has = (cc == 0) ? left[rr] : uv_has[rr][cc - 1];
+						uint8_t above_has = (rr == 0) ? above[mb_c * 2 + cc] : uv_has[rr - 1][cc];
+						int has = 0;
+						if (plane == 2) out->blocks_total_u++;
+						else out->blocks_total_v++;
+						if (!skip) {
+							has = decode_block(d, coeff_probs[2], 0, left_has, above_has, &out->coeff_nonzero_total,
+							                   &out->coeff_eob_tokens, &out->coeff_abs_max, block, cuv + b * bc, bc,
+							                   q->factor[TOKEN_BLOCK_UV], out, mb_index, (uint32_t)plane, b);
+							hash_block(block, io_hash);
+						} else {
+							hash_zero_block(io_hash);
 						}
-					} else {
-						size_t blk = (size_t)mb_index * 4u + (size_t)(rr * 2 + cc);
-						dst = frame ? (frame->coeff_v + blk * 16u) : NULL;
-						for (int i = 0; i < 16; i++) {
-							*io_hash = fnv1a64_i32(*io_hash, 0);
-							if (dst) dst[i] = 0;
+						if (has) {
+							if (plane == 2) out->blocks_nonzero_u++;
+							else out->blocks_nonzero_v++;
+							rec->nz_uv = (uint8_t)(rec->nz_uv | (1u << ((uint32_t)(plane - 2) * 4u + b)));
 						}
+						uv_has[rr][cc] = (uint8_t)has;
 					}
-					if (has) out->blocks_nonzero_v++;
-					if (has) mb_has_coeff = 1;
-					v_has[rr][cc] = (uint8_t)has;
 				}
+				for (int cc = 0; cc < 2; cc++) above[mb_c * 2 + cc] = uv_has[1][cc];
+				for (int rr = 0; rr < 2; rr++) left[rr] = uv_has[rr][1];
 			}
-			for (int cc = 0; cc < 2; cc++) above_v[mb_c * 2 + cc] = v_has[1][cc];
-			for (int rr = 0; rr < 2; rr++) left_v[rr] = v_has[rr][1];
 
-			if (frame && frame->has_coeff) frame->has_coeff[mb_index] = (uint8_t)(mb_has_coeff != 0);
+			if (rec->nz_y || rec->nz_uv || (rec->flags & VP8_MB_NZ_Y2)) rec->flags |= VP8_MB_HAS_COEFF;
 		}
 	}
 
-	out->token_part_bytes_used = (uint32_t)bool_decoder_bytes_used(&d);
-	if (out->token_part_bytes_used > out->token_part_size_bytes) {
-		errno = EINVAL;
-		return -1;
+	out->token_part_bytes_used = 0;
+	for (uint32_t p = 0; p < total_partitions; p++) {
+		const size_t used = bool_decoder_bytes_used(&parts[p]);
+		if (used > part_sizes[p]) {
+			errno = EINVAL;
+			return -1;
+		}
+		out->token_part_bytes_used += (uint32_t)used;
+		if (bool_decoder_overread(&parts[p])) out->token_overread = 1;
+		out->token_overread_bytes += bool_decoder_overread_bytes(&parts[p]);
 	}
-	out->token_overread = (uint8_t)(bool_decoder_overread(&d) != 0);
-	out->token_overread_bytes = bool_decoder_overread_bytes(&d);
-
-	free(above_y);
-	free(above_u);
-	free(above_v);
-	free(above_y2);
-
 	return 0;
 }
 
-// Global coeff prob table for the current key frame.
-uint8_t g_coeff_probs[4][8][3][num_dct_tokens - 1];
-
-static void init_coeff_probs_defaults(void) {
+static void init_coeff_probs_defaults(uint8_t probs[4][8][3][num_dct_tokens - 1]) {
 	for (int i = 0; i < 4; i++)
 		for (int j = 0; j < 8; j++)
 			for (int k = 0; k < 3; k++)
-				for (int t = 0; t < (num_dct_tokens - 1); t++) g_coeff_probs[i][j][k][t] = default_coeff_probs[i][j][k][t];
+				for (int t = 0; t < (num_dct_tokens - 1); t++) probs[i][j][k][t] = default_coeff_probs[i][j][k][t];
+}
+
+// Partition 0 up to the macroblock records. It is read once per frame, so it
+// keeps its own bool count for -timings rather than the decoder doing so.
+typedef struct {
+	BoolDecoder* d;
+	uint32_t bools;
+} HeaderReader;
+
+static int hdr_bool(HeaderReader* r, uint8_t prob) {
+	r->bools++;
+	return bool_decode_bool(r->d, prob);
 }
 
-static void update_coeff_probs(BoolDecoder* d) {
+static uint32_t hdr_literal(HeaderReader* r, int bits) {
+	r->bools += (uint32_t)bits;
+	return bool_decode_literal(r->d, bits);
+}
+
+// Magnitude bits, then a sign only for a non-zero magnitude.
+static int32_t hdr_sint(HeaderReader* r, int bits) {
+	int32_t v = bool_decode_sint(r->d, bits);
+	r->bools += (uint32_t)bits + (v != 0);
+	return v;
+}
+
+static void update_coeff_probs(HeaderReader* r, uint8_t probs[4][8][3][num_dct_tokens - 1]) {
 	for (int i = 0; i < 4; i++) {
 		for (int j = 0; j < 8; j++) {
 			for (int k = 0; k < 3; k++) {
 				for (int t = 0; t < (num_dct_tokens - 1); t++) {
-					if (bool_decode_bool(d, coeff_update_probs[i][j][k][t])) {
-						g_coeff_probs[i][j][k][t] = (uint8_t)bool_decode_literal(d, 8);
+					if (hdr_bool(r, coeff_update_probs[i][j][k][t])) {
+						probs[i][j][k][t] = (uint8_t)hdr_literal(r, 8);
 					}
 				}
 			}
@@ -647,9 +745,9 @@ static void update_coeff_probs(BoolDecoder* d) {
 
 // --- Frame header parse through macroblock data ---
 
-static int8_t decode_q_delta(BoolDecoder* d) {
-	if (bool_decode_bool(d, 128) == 0) return 0;
-	int32_t v = bool_decode_sint(d, 4);
+static int8_t decode_q_delta(HeaderReader* r) {
+	if (hdr_bool(r, 128) == 0) return 0;
+	int32_t v = hdr_sint(r, 4);
 	if (v < -128) v = -128;
 	if (v > 127) v = 127;
 	return (int8_t)v;
@@ -657,20 +755,38 @@ static int8_t decode_q_delta(BoolDecoder* d) {
 
 void vp8_decoded_frame_free(Vp8DecodedFrame* f) {
 	if (!f) return;
-	free(f->segment_id);
-	free(f->skip_coeff);
-	free(f->has_coeff);
-	free(f->ymode);
-	free(f->uv_mode);
-	free(f->bmode);
-	free(f->coeff_y2);
-	free(f->coeff_y);
-	free(f->coeff_u);
-	free(f->coeff_v);
+	arena_free(&f->arena);
 	*f = (Vp8DecodedFrame){0};
 }
 
+// Everything decode_frame() allocates: the per-macroblock records and
+// coefficients, plus the above-row mode and non-zero contexts of the sweep.
+static int frame_arena_size(uint32_t mb_cols, uint32_t mb_total, uint32_t mb_coeffs, size_t* out) {
+	*out = 0;
+	if (arena_reserve(out, mb_total, sizeof(Vp8MbRecord)) != 0) return -1;
+	if (arena_reserve(out, (size_t)mb_total * mb_coeffs, sizeof(int16_t)) != 0) return -1;
+	if (arena_reserve(out, (size_t)mb_cols * 4u, sizeof(intra_bmode)) != 0) return -1;
+	if (arena_reserve(out, (size_t)mb_cols * 4u, 1) != 0) return -1;
+	if (arena_reserve(out, (size_t)mb_cols * 2u, 1) != 0) return -1;
+	if (arena_reserve(out, (size_t)mb_cols * 2u, 1) != 0) return -1;
+	return arena_reserve(out, mb_cols, 1);
+}
+
+static int decode_frame(ByteSpan vp8_payload, uint32_t max_mb_rows, int dc_only, Vp8DecodedFrame* out);
+
 int vp8_decode_decoded_frame(ByteSpan vp8_payload, Vp8DecodedFrame* out) {
+	return decode_frame(vp8_payload, UINT32_MAX, 0, out);
+}
+
+int vp8_decode_decoded_frame_rows(ByteSpan vp8_payload, uint32_t max_mb_rows, Vp8DecodedFrame* out) {
+	return decode_frame(vp8_payload, max_mb_rows, 0, out);
+}
+
+int vp8_decode_decoded_frame_dc(ByteSpan vp8_payload, Vp8DecodedFrame* out) {
+	return decode_frame(vp8_payload, UINT32_MAX, 1, out);
+}
+
+static int decode_frame(ByteSpan vp8_payload, uint32_t max_mb_rows, int dc_only, Vp8DecodedFrame* out) {
 	if (!out) return -1;
 	*out = (Vp8DecodedFrame){0};
 
@@ -712,40 +828,45 @@ int vp8_decode_decoded_frame(ByteSpan vp8_payload, Vp8DecodedFrame* out) {
 		errno = EINVAL;
 		return -1;
 	}
-
-	out->segment_id = (uint8_t*)xcalloc_array(mb_total, sizeof(uint8_t));
-	out->skip_coeff = (uint8_t*)xcalloc_array(mb_total, sizeof(uint8_t));
-	out->has_coeff = (uint8_t*)xcalloc_array(mb_total, sizeof(uint8_t));
-	out->ymode = (uint8_t*)xcalloc_array(mb_total, sizeof(uint8_t));
-	out->uv_mode = (uint8_t*)xcalloc_array(mb_total, sizeof(uint8_t));
-	out->bmode = (uint8_t*)xcalloc_array((size_t)mb_total * 16u, sizeof(uint8_t));
-	out->coeff_y2 = (int16_t*)xcalloc_array((size_t)mb_total * 16u, sizeof(int16_t));
-	out->coeff_y = (int16_t*)xcalloc_array((size_t)mb_total * 16u * 16u, sizeof(int16_t));
-	out->coeff_u = (int16_t*)xcalloc_array((size_t)mb_total * 4u * 16u, sizeof(int16_t));
-	out->coeff_v = (int16_t*)xcalloc_array((size_t)mb_total * 4u * 16u, sizeof(int16_t));
-	if (!out->segment_id || !out->skip_coeff || !out->has_coeff || !out->ymode || !out->uv_mode || !out->bmode || !out->coeff_y2 ||
-	    !out->coeff_y || !out->coeff_u || !out->coeff_v) {
+	// Macroblocks actually parsed (a region-of-interest decode stops early).
+	const uint32_t rows_done = (max_mb_rows < mb_rows) ? max_mb_rows : mb_rows;
+	const uint32_t mb_done = rows_done * mb_cols;
+
+	// A DC-only decode keeps one value per Y/U/V block instead of all 16.
+	out->dc_only = (uint8_t)(dc_only != 0);
+	out->block_coeffs = dc_only ? 1u : 16u;
+	out->mb_coeffs = VP8_MB_COEFFS_Y2 + 24u * out->block_coeffs;
+	size_t arena_size = 0;
+	if (frame_arena_size(mb_cols, mb_total, out->mb_coeffs, &arena_size) != 0 ||
+	    arena_init(&out->arena, arena_size) != 0) {
 		vp8_decoded_frame_free(out);
-		errno = ENOMEM;
 		return -1;
 	}
+	out->mbs = (Vp8MbRecord*)arena_alloc(&out->arena, mb_total, sizeof(Vp8MbRecord));
+	out->coeffs = (int16_t*)arena_alloc(&out->arena, (size_t)mb_total * out->mb_coeffs, sizeof(int16_t));
 
 	const size_t uncompressed = 10;
 	if (vp8_payload.size < uncompressed + (size_t)kf.first_partition_len) {
+		vp8_decoded_frame_free(out);
 		errno = EINVAL;
 		return -1;
 	}
 	ByteSpan part0 = {vp8_payload.data + uncompressed, kf.first_partition_len};
 	out->stats.part0_size_bytes = (uint32_t)part0.size;
 	BoolDecoder d;
-	if (bool_decoder_init(&d, part0) != 0) return -1;
+	if (bool_decoder_init(&d, part0) != 0) {
+		vp8_decoded_frame_free(out);
+		return -1;
+	}
+
+	HeaderReader hr = {.d = &d, .bools = 0};
 
 	// Key-frame-only: color_space and clamping_type.
-	(void)bool_decode_bool(&d, 128);
-	(void)bool_decode_bool(&d, 128);
+	(void)hdr_bool(&hr, 128);
+	(void)hdr_bool(&hr, 128);
 
 	// Segmentation
-	int segmentation_enabled = bool_decode_bool(&d, 128);
+	int segmentation_enabled = hdr_bool(&hr, 128);
 	out->segmentation_enabled = (uint8_t)(segmentation_enabled != 0);
 	out->segmentation_abs = 0;
 	for (int i = 0; i < 4; i++) out->seg_quant_idx[i] = 0;
@@ -753,23 +874,23 @@ int vp8_decode_decoded_frame(ByteSpan vp8_payload, Vp8DecodedFrame* out) {
 	int update_mb_segmentation_map = 0;
 	uint8_t mb_segment_tree_probs[3] = {255, 255, 255};
 	if (segmentation_enabled) {
-		update_mb_segmentation_map = bool_decode_bool(&d, 128);
-		int update_segment_feature_data = bool_decode_bool(&d, 128);
+		update_mb_segmentation_map = hdr_bool(&hr, 128);
+		int update_segment_feature_data = hdr_bool(&hr, 128);
 		if (update_segment_feature_data) {
-			int segment_feature_mode = bool_decode_bool(&d, 128);
+			int segment_feature_mode = hdr_bool(&hr, 128);
 			// RFC 6386 (update_segmentation table): segment_feature_mode == 0 => delta mode, 1 => absolute-value mode.
 			out->segmentation_abs = (uint8_t)(segment_feature_mode != 0);
 			for (int i = 0; i < 4; i++) {
-				if (bool_decode_bool(&d, 128)) {
-					int32_t v = bool_decode_sint(&d, 7);
+				if (hdr_bool(&hr, 128)) {
+					int32_t v = hdr_sint(&hr, 7);
 					if (v < -128) v = -128;
 					if (v > 127) v = 127;
 					out->seg_quant_idx[i] = (int8_t)v;
 				}
 			}
 			for (int i = 0; i < 4; i++) {
-				if (bool_decode_bool(&d, 128)) {
-					int32_t v = bool_decode_sint(&d, 6);
+				if (hdr_bool(&hr, 128)) {
+					int32_t v = hdr_sint(&hr, 6);
 					if (v < -128) v = -128;
 					if (v > 127) v = 127;
 					out->seg_lf_level[i] = (int8_t)v;
@@ -778,32 +899,32 @@ int vp8_decode_decoded_frame(ByteSpan vp8_payload, Vp8DecodedFrame* out) {
 		}
 		if (update_mb_segmentation_map) {
 			for (int i = 0; i < 3; i++) {
-				if (bool_decode_bool(&d, 128)) mb_segment_tree_probs[i] = (uint8_t)bool_decode_literal(&d, 8);
+				if (hdr_bool(&hr, 128)) mb_segment_tree_probs[i] = (uint8_t)hdr_literal(&hr, 8);
 			}
 		}
 	}
 
 	// Loop filter
-	out->lf_use_simple = (uint8_t)(bool_decode_bool(&d, 128) != 0);
-	out->lf_level = (uint8_t)bool_decode_literal(&d, 6);
-	out->lf_sharpness = (uint8_t)bool_decode_literal(&d, 3);
+	out->lf_use_simple = (uint8_t)(hdr_bool(&hr, 128) != 0);
+	out->lf_level = (uint8_t)hdr_literal(&hr, 6);
+	out->lf_sharpness = (uint8_t)hdr_literal(&hr, 3);
 	for (int i = 0; i < 4; i++) out->lf_ref_delta[i] = 0;
 	for (int i = 0; i < 4; i++) out->lf_mode_delta[i] = 0;
-	out->lf_delta_enabled = (uint8_t)(bool_decode_bool(&d, 128) != 0);
+	out->lf_delta_enabled = (uint8_t)(hdr_bool(&hr, 128) != 0);
 	if (out->lf_delta_enabled) {
-		int update = bool_decode_bool(&d, 128);
+		int update = hdr_bool(&hr, 128);
 		if (update) {
 			for (int i = 0; i < 4; i++) {
-				if (bool_decode_bool(&d, 128)) {
-					int32_t v = bool_decode_sint(&d, 6);
+				if (hdr_bool(&hr, 128)) {
+					int32_t v = hdr_sint(&hr, 6);
 					if (v < -128) v = -128;
 					if (v > 127) v = 127;
 					out->lf_ref_delta[i] = (int8_t)v;
 				}
 			}
 			for (int i = 0; i < 4; i++) {
-				if (bool_decode_bool(&d, 128)) {
-					int32_t v = bool_decode_sint(&d, 6);
+				if (hdr_bool(&hr, 128)) {
+					int32_t v = hdr_sint(&hr, 6);
 					if (v < -128) v = -128;
 					if (v > 127) v = 127;
 					out->lf_mode_delta[i] = (int8_t)v;
@@ -813,146 +934,90 @@ int vp8_decode_decoded_frame(ByteSpan vp8_payload, Vp8DecodedFrame* out) {
 	}
 
 	// Token partitions
-	uint8_t log2_partitions = (uint8_t)bool_decode_literal(&d, 2);
+	uint8_t log2_partitions = (uint8_t)hdr_literal(&hr, 2);
 	uint8_t total_partitions = (uint8_t)(1u << log2_partitions);
 	if (total_partitions > 8) {
+		vp8_decoded_frame_free(out);
 		errno = EINVAL;
 		return -1;
 	}
 
 	// Quantization
-	out->q_index = (uint8_t)bool_decode_literal(&d, 7);
-	out->y1_dc_delta_q = decode_q_delta(&d);
-	out->y2_dc_delta_q = decode_q_delta(&d);
-	out->y2_ac_delta_q = decode_q_delta(&d);
-	out->uv_dc_delta_q = decode_q_delta(&d);
-	out->uv_ac_delta_q = decode_q_delta(&d);
+	out->q_index = (uint8_t)hdr_literal(&hr, 7);
+	out->y1_dc_delta_q = decode_q_delta(&hr);
+	out->y2_dc_delta_q = decode_q_delta(&hr);
+	out->y2_ac_delta_q = decode_q_delta(&hr);
+	out->uv_dc_delta_q = decode_q_delta(&hr);
+	out->uv_ac_delta_q = decode_q_delta(&hr);
 
 	// Key-frame: refresh_entropy_probs
-	(void)bool_decode_bool(&d, 128);
+	(void)hdr_bool(&hr, 128);
 
 	// Token probability updates (Section 9.9 / 13.4)
 	#if defined(DECODER_ULTRA) && !defined(__INTELLISENSE__)
 	init_coeff_update_probs();
 	#endif
-	init_coeff_probs_defaults();
-	update_coeff_probs(&d);
+	uint8_t coeff_probs[4][8][3][num_dct_tokens - 1];
+	init_coeff_probs_defaults(coeff_probs);
+	update_coeff_probs(&hr, coeff_probs);
 
 	// mb_no_skip_coeff + prob_skip_false
-	int mb_no_skip_coeff = bool_decode_bool(&d, 128);
+	int mb_no_skip_coeff = hdr_bool(&hr, 128);
 	uint8_t prob_skip_false = 0;
 	if (mb_no_skip_coeff) {
-		prob_skip_false = (uint8_t)bool_decode_literal(&d, 8);
+		prob_skip_false = (uint8_t)hdr_literal(&hr, 8);
 	}
 
-	// Token partition size table is ignored for now; our test corpus has Total partitions: 1.
-
-	// Macroblock prediction records (partition 0 remainder)
-	MbInfo* mbs = (MbInfo*)xcalloc_array(mb_total, sizeof(MbInfo));
-	if (!mbs) {
-		vp8_decoded_frame_free(out);
-		errno = ENOMEM;
-		return -1;
-	}
-
-	// Subblock mode context predictors (only needed for B_PRED parsing).
-	intra_bmode* above_bmodes = (intra_bmode*)xmalloc_array((size_t)mb_cols * 4u, sizeof(intra_bmode));
+	// Macroblock prediction records (partition 0 remainder), interleaved with the tokens.
+	ModeParser modes = {
+	    .d = &d,
+	    .read_segment_id = (uint8_t)(segmentation_enabled && update_mb_segmentation_map),
+	    .segment_probs = {mb_segment_tree_probs[0], mb_segment_tree_probs[1], mb_segment_tree_probs[2]},
+	    .read_skip = (uint8_t)(mb_no_skip_coeff != 0),
+	    .prob_skip_false = prob_skip_false,
+	};
+	intra_bmode* above_bmodes = (intra_bmode*)arena_alloc(&out->arena, (size_t)mb_cols * 4u, sizeof(intra_bmode));
 	if (!above_bmodes) {
-		free(mbs);
 		vp8_decoded_frame_free(out);
-		errno = ENOMEM;
 		return -1;
 	}
 	for (uint32_t i = 0; i < mb_cols * 4; i++) above_bmodes[i] = B_DC_PRED;
+	modes.above_bmodes = above_bmodes;
 
-	for (uint32_t mb_r = 0; mb_r < mb_rows; mb_r++) {
-		intra_bmode left_bmodes[4] = {B_DC_PRED, B_DC_PRED, B_DC_PRED, B_DC_PRED};
-		for (uint32_t mb_c = 0; mb_c < mb_cols; mb_c++) {
-			uint32_t mb_index = mb_r * mb_cols + mb_c;
-			uint8_t seg_id = 0;
-
-			if (segmentation_enabled && update_mb_segmentation_map) {
-				static const int8_t mb_segment_tree[2 * (4 - 1)] = {2, 4, 0, -1, -2, -3};
-				seg_id = (uint8_t)vp8_treed_read(&d, mb_segment_tree, mb_segment_tree_probs, 0);
-			}
-			mbs[mb_index].segment_id = seg_id;
-			out->segment_id[mb_index] = seg_id;
-
-			uint8_t skip_coeff = 0;
-			if (mb_no_skip_coeff) {
-				skip_coeff = (uint8_t)bool_decode_bool(&d, prob_skip_false);
-			}
-			mbs[mb_index].skip_coeff = skip_coeff;
-			out->skip_coeff[mb_index] = skip_coeff;
-			if (skip_coeff) out->stats.mb_skip_coeff++;
-
-			intra_mbmode ymode = (intra_mbmode)vp8_treed_read(&d, kf_ymode_tree, kf_ymode_prob, 0);
-			mbs[mb_index].ymode = (uint8_t)ymode;
-			out->ymode[mb_index] = (uint8_t)ymode;
-			if ((unsigned)ymode < 5u) out->stats.ymode_counts[(unsigned)ymode]++;
-			if (ymode == B_PRED) {
-				out->stats.mb_b_pred++;
-				mbs[mb_index].has_y2 = 0;
-				intra_bmode local[4][4];
-				for (int rr = 0; rr < 4; rr++)
-					for (int cc = 0; cc < 4; cc++) local[rr][cc] = B_DC_PRED;
-				for (int rr = 0; rr < 4; rr++) {
-					for (int cc = 0; cc < 4; cc++) {
-						intra_bmode A = (rr == 0) ? above_bmodes[mb_c * 4 + cc] : local[rr - 1][cc];
-						intra_bmode L = (cc == 0) ? left_bmodes[rr] : local[rr][cc - 1];
-						const uint8_t* probs = kf_bmode_prob[A][L];
-						local[rr][cc] = (intra_bmode)vp8_treed_read(&d, bmode_tree, probs, 0);
-						out->bmode[(size_t)mb_index * 16u + (size_t)(rr * 4 + cc)] = (uint8_t)local[rr][cc];
-						if ((unsigned)local[rr][cc] < 10u) out->stats.bmode_counts[(unsigned)local[rr][cc]]++;
-					}
-				}
-				for (int cc = 0; cc < 4; cc++) above_bmodes[mb_c * 4 + cc] = local[3][cc];
-				for (int rr = 0; rr < 4; rr++) left_bmodes[rr] = local[rr][3];
-			} else {
-				mbs[mb_index].has_y2 = 1;
-				intra_bmode derived = mbmode_to_bmode(ymode);
-				for (int cc = 0; cc < 4; cc++) above_bmodes[mb_c * 4 + cc] = derived;
-				for (int rr = 0; rr < 4; rr++) left_bmodes[rr] = derived;
-				for (int rr = 0; rr < 4; rr++)
-					for (int cc = 0; cc < 4; cc++)
-						out->bmode[(size_t)mb_index * 16u + (size_t)(rr * 4 + cc)] = (uint8_t)derived;
-			}
+	DequantFactors dqf[4];
+	memset(dqf, 0, sizeof(dqf));
+	dequant_init(dqf, out);
 
-			unsigned uv_mode = (unsigned)vp8_treed_read(&d, uv_mode_tree, kf_uv_mode_prob, 0);
-			mbs[mb_index].uv_mode = (uint8_t)uv_mode;
-			out->uv_mode[mb_index] = (uint8_t)uv_mode;
-			if (uv_mode < 4u) out->stats.uv_mode_counts[uv_mode]++;
-		}
+	uint64_t h = fnv1a64_init();
+	if (decode_macroblocks(vp8_payload, &kf, total_partitions, &modes, mb_cols, rows_done, coeff_probs, dqf, &out->stats,
+	                       out, &h) != 0) {
+		vp8_decoded_frame_free(out);
+		return -1;
 	}
 
 	out->stats.part0_bytes_used = (uint32_t)bool_decoder_bytes_used(&d);
 	if (out->stats.part0_bytes_used > out->stats.part0_size_bytes) {
-		errno = EINVAL;
-		free(above_bmodes);
-		free(mbs);
 		vp8_decoded_frame_free(out);
+		errno = EINVAL;
 		return -1;
 	}
 	out->stats.part0_overread = (uint8_t)(bool_decoder_overread(&d) != 0);
 	out->stats.part0_overread_bytes = bool_decoder_overread_bytes(&d);
+	out->stats.bool_decodes += hr.bools + mode_bools(&out->stats, &modes);
 
 	// RFC-aligned internal consistency checks.
 	{
 		uint32_t ysum = 0;
 		for (int i = 0; i < 5; i++) ysum += out->stats.ymode_counts[i];
-		if (ysum != mb_total) {
+		if (ysum != mb_done) {
 			errno = EINVAL;
-			free(above_bmodes);
-			free(mbs);
 			vp8_decoded_frame_free(out);
 			return -1;
 		}
 		uint32_t uvsum = 0;
 		for (int i = 0; i < 4; i++) uvsum += out->stats.uv_mode_counts[i];
-		if (uvsum != mb_total) {
+		if (uvsum != mb_done) {
 			errno = EINVAL;
-			free(above_bmodes);
-			free(mbs);
 			vp8_decoded_frame_free(out);
 			return -1;
 		}
@@ -960,43 +1025,28 @@ int vp8_decode_decoded_frame(ByteSpan vp8_payload, Vp8DecodedFrame* out) {
 		for (int i = 0; i < 10; i++) bsum += out->stats.bmode_counts[i];
 		if (bsum != out->stats.mb_b_pred * 16u) {
 			errno = EINVAL;
-			free(above_bmodes);
-			free(mbs);
 			vp8_decoded_frame_free(out);
 			return -1;
 		}
 	}
 
-	uint64_t h = fnv1a64_init();
-	if (decode_all_coeffs_keyframe(vp8_payload, &kf, total_partitions, mbs, mb_cols, mb_rows, &out->stats, out, &h) != 0) {
-		free(above_bmodes);
-		free(mbs);
-		vp8_decoded_frame_free(out);
-		return -1;
-	}
-	free(above_bmodes);
-
 	// More internal sanity checks: block totals implied by macroblock structure.
-	if (out->stats.blocks_total_y != mb_total * 16u) {
-		errno = EINVAL;
-		free(mbs);
+	if (out->stats.blocks_total_y != mb_done * 16u) {
 		vp8_decoded_frame_free(out);
+		errno = EINVAL;
 		return -1;
 	}
-	if (out->stats.blocks_total_u != mb_total * 4u || out->stats.blocks_total_v != mb_total * 4u) {
-		errno = EINVAL;
-		free(mbs);
+	if (out->stats.blocks_total_u != mb_done * 4u || out->stats.blocks_total_v != mb_done * 4u) {
 		vp8_decoded_frame_free(out);
+		errno = EINVAL;
 		return -1;
 	}
-	if (out->stats.blocks_total_y2 != (mb_total - out->stats.mb_b_pred)) {
-		errno = EINVAL;
-		free(mbs);
+	if (out->stats.blocks_total_y2 != (mb_done - out->stats.mb_b_pred)) {
 		vp8_decoded_frame_free(out);
+		errno = EINVAL;
 		return -1;
 	}
 	out->stats.coeff_hash_fnv1a64 = h;
-	free(mbs);
 	return 0;
 }
 
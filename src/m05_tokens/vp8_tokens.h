@@ -2,6 +2,7 @@
 
 #include <stdint.h>
 
+#include "../common/arena.h"
 #include "../common/os.h"
 
 typedef struct {
@@ -46,9 +47,37 @@ typedef struct {
 	uint32_t coeff_nonzero_total;
 	uint32_t coeff_eob_tokens;
 	uint32_t coeff_abs_max;
+	uint32_t coeff_tokens; // tokens read, including EOB
 	uint64_t coeff_hash_fnv1a64;
+
+	// Bools decoded from partition 0 + the token partitions, derived from the
+	// header reads, mode tallies and token values rather than counted per bool.
+	uint64_t bool_decodes;
 } Vp8CoeffStats;
 
+// Per-macroblock syntax packed into 16 bytes, so reconstruction and the loop
+// filter read one record per macroblock instead of several parallel arrays.
+typedef struct {
+	uint8_t ymode;      // 0..4 (DC,V,H,TM,B_PRED)
+	uint8_t uv_mode;    // 0..3 (DC,V,H,TM)
+	uint8_t segment_id; // 0..3
+	uint8_t flags;      // VP8_MB_*
+	uint16_t nz_y;      // bit b: Y block b (raster order) has non-zero coefficients
+	uint8_t nz_uv;      // bits 0..3: U blocks, bits 4..7: V blocks
+	uint8_t reserved;
+	uint8_t bmodes[8];  // subblock modes in raster order, two per byte (low nibble first);
+	                    // derived from ymode unless B_PRED
+} Vp8MbRecord;
+
+enum {
+	VP8_MB_SKIP = 1u << 0,      // mb_skip_coeff
+	VP8_MB_HAS_COEFF = 1u << 1, // any non-zero coefficient (loop filter skip logic)
+	VP8_MB_NZ_Y2 = 1u << 2,     // the Y2 block has non-zero coefficients
+};
+
+// Offset of the first Y block in a macroblock's coefficient run (after Y2).
+enum { VP8_MB_COEFFS_Y2 = 16 };
+
 typedef struct {
 	uint32_t mb_cols;
 	uint32_t mb_rows;
@@ -76,24 +105,23 @@ typedef struct {
 	int8_t lf_ref_delta[4];
 	int8_t lf_mode_delta[4];
 
-	// Per-macroblock syntax.
-	uint8_t* segment_id; // [mb_total] values 0..3
-	uint8_t* skip_coeff; // [mb_total] 0/1
-	uint8_t* has_coeff;  // [mb_total] 0/1 (computed from decoded coeffs; used by loopfilter skip logic)
-	uint8_t* ymode;      // [mb_total] 0..4 (DC,V,H,TM,B_PRED)
-	uint8_t* uv_mode;    // [mb_total] 0..3 (DC,V,H,TM)
-	uint8_t* bmode;      // [mb_total*16] (only meaningful for ymode==B_PRED)
-
-	// Residual coefficient blocks, zigzag-reordered into natural coefficient order.
-	// Layout per macroblock:
-	// - Y2: 1 block  (16 coeffs)
-	// - Y:  16 blocks (16 coeffs each)
-	// - U:  4 blocks  (16 coeffs each)
-	// - V:  4 blocks  (16 coeffs each)
-	int16_t* coeff_y2; // [mb_total*16]
-	int16_t* coeff_y;  // [mb_total*16*16]
-	int16_t* coeff_u;  // [mb_total*4*16]
-	int16_t* coeff_v;  // [mb_total*4*16]
+	// Per-macroblock syntax, one record per macroblock in raster order.
+	Vp8MbRecord* mbs; // [mb_total]
+
+	// Residual coefficients, dequantized with the macroblock's segment factors
+	// while the tokens are read, in natural coefficient order and stored as one
+	// run of `mb_coeffs` values per macroblock:
+	// - Y2: 1 block of 16
+	// - Y:  16 blocks, then U: 4 blocks, then V: 4 blocks, `block_coeffs` each
+	// block_coeffs is 16, or 1 in a DC-only frame (vp8_decode_decoded_frame_dc()),
+	// which keeps just the DC of each Y/U/V block. With Y2, the Y blocks' DC slot
+	// stays 0 (their DC comes from the inverse WHT of Y2).
+	int16_t* coeffs; // [mb_total * mb_coeffs]
+	uint32_t block_coeffs;
+	uint32_t mb_coeffs;
+	uint8_t dc_only;
+
+	Arena arena; // owns mbs, coeffs and the decoder's scratch rows
 
 	Vp8CoeffStats stats;
 } Vp8DecodedFrame;
@@ -108,4 +136,22 @@ int vp8_decode_coeff_stats(ByteSpan vp8_payload, Vp8CoeffStats* out);
 // in heap-allocated arrays in `out`. Call vp8_decoded_frame_free() when done.
 int vp8_decode_decoded_frame(ByteSpan vp8_payload, Vp8DecodedFrame* out);
 
+// Same as vp8_decode_decoded_frame(), but stops after the first `max_mb_rows`
+// macroblock rows (modes and tokens are coded in raster order, so nothing below
+// is needed for them). The remaining rows stay zeroed; stats cover the decoded rows.
+int vp8_decode_decoded_frame_rows(ByteSpan vp8_payload, uint32_t max_mb_rows, Vp8DecodedFrame* out);
+
+// Same as vp8_decode_decoded_frame(), but only stores the DC of each block (all
+// tokens are still parsed): input for vp8_reconstruct_keyframe_preview().
+int vp8_decode_decoded_frame_dc(ByteSpan vp8_payload, Vp8DecodedFrame* out);
+
 void vp8_decoded_frame_free(Vp8DecodedFrame* f);
+
+static inline uint8_t vp8_mb_bmode(const Vp8MbRecord* r, uint32_t b) {
+	return (uint8_t)((r->bmodes[b >> 1] >> ((b & 1u) * 4u)) & 15u);
+}
+
+// Start of macroblock `mb`'s coefficient run (Y2 first).
+static inline int16_t* vp8_mb_coeffs(const Vp8DecodedFrame* f, uint32_t mb) {
+	return f->coeffs + (size_t)mb * f->mb_coeffs;
+}
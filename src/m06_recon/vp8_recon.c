@@ -4,6 +4,8 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include "../common/dsp.h"
+#include "../common/timing.h"
 #include "../m07_loopfilter/vp8_loopfilter.h"
 
 // --- Helpers ---
@@ -14,349 +16,6 @@ static inline uint8_t clamp255_i32(int32_t v) {
 	return (uint8_t)v;
 }
 
-static inline int clamp_q(int q) {
-	if (q < 0) return 0;
-	if (q > 127) return 127;
-	return q;
-}
-
-// Dequant lookup tables from RFC 6386 (dequant_data.h).
-#define QINDEX_RANGE 128
-static const int dc_qlookup[QINDEX_RANGE] = {
-	4, 5, 6, 7, 8, 9, 10, 10, 11, 12, 13, 14, 15, 16, 17, 17, 18, 19, 20, 20, 21, 21, 22, 22, 23, 23,
-	24, 25, 25, 26, 27, 28, 29, 30, 31, 32, 33, 34, 35, 36, 37, 37, 38, 39, 40, 41, 42, 43, 44, 45,
-	46, 46, 47, 48, 49, 50, 51, 52, 53, 54, 55, 56, 57, 58, 59, 60, 61, 62, 63, 64, 65, 66, 67, 68,
-	69, 70, 71, 72, 73, 74, 75, 76, 76, 77, 78, 79, 80, 81, 82, 83, 84, 85, 86, 87, 88, 89, 91, 93,
-	95, 96, 98, 100, 101, 102, 104, 106, 108, 110, 112, 114, 116, 118, 122, 124, 126, 128, 130, 132, 134,
-	136, 138, 140, 143, 145, 148, 151, 154, 157,
-};
-
-static const int ac_qlookup[QINDEX_RANGE] = {
-	4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 16, 17, 18, 19, 20, 21, 22, 23, 24, 25, 26, 27, 28, 29,
-	30, 31, 32, 33, 34, 35, 36, 37, 38, 39, 40, 41, 42, 43, 44, 45, 46, 47, 48, 49, 50, 51, 52, 53,
-	54, 55, 56, 57, 58, 60, 62, 64, 66, 68, 70, 72, 74, 76, 78, 80, 82, 84, 86, 88, 90, 92, 94, 96,
-	98, 100, 102, 104, 106, 108, 110, 112, 114, 116, 119, 122, 125, 128, 131, 134, 137, 140, 143, 146, 149,
-	152, 155, 158, 161, 164, 167, 170, 173, 177, 181, 185, 189, 193, 197, 201, 205, 209, 213, 217, 221, 225,
-	229, 234, 239, 245, 249, 254, 259, 264, 269, 274, 279, 284,
-};
-
-static inline int dc_q(int q) { return dc_qlookup[clamp_q(q)]; }
-static inline int ac_q(int q) { return ac_qlookup[clamp_q(q)]; }
-
-typedef enum {
-	TOKEN_BLOCK_Y1 = 0,
-	TOKEN_BLOCK_UV = 1,
-	TOKEN_BLOCK_Y2 = 2,
-} TokenBlock;
-
-typedef struct {
-	int quant_idx;
-	int factor[3][2];
-} DequantFactors;
-
-static void dequant_init(DequantFactors* dqf, const Vp8DecodedFrame* decoded) {
-	// Mirrors RFC 6386 reference dequant_init().
-	int seg_count = decoded->segmentation_enabled ? 4 : 1;
-	for (int i = 0; i < seg_count; i++) {
-		int q = (int)decoded->q_index;
-		if (decoded->segmentation_enabled) {
-			q = decoded->segmentation_abs ? decoded->seg_quant_idx[i] : (q + decoded->seg_quant_idx[i]);
-		}
-		dqf[i].quant_idx = q;
-
-		dqf[i].factor[TOKEN_BLOCK_Y1][0] = dc_q(q + decoded->y1_dc_delta_q);
-		dqf[i].factor[TOKEN_BLOCK_Y1][1] = ac_q(q);
-		dqf[i].factor[TOKEN_BLOCK_UV][0] = dc_q(q + decoded->uv_dc_delta_q);
-		dqf[i].factor[TOKEN_BLOCK_UV][1] = ac_q(q + decoded->uv_ac_delta_q);
-		dqf[i].factor[TOKEN_BLOCK_Y2][0] = dc_q(q + decoded->y2_dc_delta_q) * 2;
-		dqf[i].factor[TOKEN_BLOCK_Y2][1] = ac_q(q + decoded->y2_ac_delta_q) * 155 / 100;
-		if (dqf[i].factor[TOKEN_BLOCK_Y2][1] < 8) dqf[i].factor[TOKEN_BLOCK_Y2][1] = 8;
-		if (dqf[i].factor[TOKEN_BLOCK_UV][0] > 132) dqf[i].factor[TOKEN_BLOCK_UV][0] = 132;
-	}
-}
-
-// --- Inverse transforms from RFC 6386 ---
-
-static void inv_wht4x4(const int16_t* in, int16_t* out) {
-	// vp8_short_inv_walsh4x4_c (RFC 6386 14.3)
-	int16_t tmp[16];
-	for (int i = 0; i < 4; i++) {
-		int a1 = in[0 + i] + in[12 + i];
-		int b1 = in[4 + i] + in[8 + i];
-		int c1 = in[4 + i] - in[8 + i];
-		int d1 = in[0 + i] - in[12 + i];
-
-		tmp[0 + i] = (int16_t)(a1 + b1);
-		tmp[4 + i] = (int16_t)(c1 + d1);
-		tmp[8 + i] = (int16_t)(a1 - b1);
-		tmp[12 + i] = (int16_t)(d1 - c1);
-	}
-	for (int i = 0; i < 4; i++) {
-		int a1 = tmp[4 * i + 0] + tmp[4 * i + 3];
-		int b1 = tmp[4 * i + 1] + tmp[4 * i + 2];
-		int c1 = tmp[4 * i + 1] - tmp[4 * i + 2];
-		int d1 = tmp[4 * i + 0] - tmp[4 * i + 3];
-
-		out[4 * i + 0] = (int16_t)((a1 + b1 + 3) >> 3);
-		out[4 * i + 1] = (int16_t)((c1 + d1 + 3) >> 3);
-		out[4 * i + 2] = (int16_t)((a1 - b1 + 3) >> 3);
-		out[4 * i + 3] = (int16_t)((d1 - c1 + 3) >> 3);
-	}
-}
-
-static void inv_dct4x4(const int16_t* input, int16_t* output) {
-	// short_idct4x4llm_c (RFC 6386 14.4), but for flat 4x4 arrays.
-	static const int cospi8sqrt2minus1 = 20091;
-	static const int sinpi8sqrt2 = 35468;
-
-	int16_t tmp[16];
-	for (int i = 0; i < 4; i++) {
-		int32_t a1 = (int32_t)input[i + 0] + (int32_t)input[i + 8];
-		int32_t b1 = (int32_t)input[i + 0] - (int32_t)input[i + 8];
-
-		int32_t temp1 = ((int32_t)input[i + 4] * sinpi8sqrt2) >> 16;
-		int32_t temp2 = (int32_t)input[i + 12] + (((int32_t)input[i + 12] * cospi8sqrt2minus1) >> 16);
-		int32_t c1 = temp1 - temp2;
-
-		temp1 = (int32_t)input[i + 4] + (((int32_t)input[i + 4] * cospi8sqrt2minus1) >> 16);
-		temp2 = ((int32_t)input[i + 12] * sinpi8sqrt2) >> 16;
-		int32_t d1 = temp1 + temp2;
-
-		tmp[0 * 4 + i] = (int16_t)(a1 + d1);
-		tmp[3 * 4 + i] = (int16_t)(a1 - d1);
-		tmp[1 * 4 + i] = (int16_t)(b1 + c1);
-		tmp[2 * 4 + i] = (int16_t)(b1 - c1);
-	}
-
-	for (int i = 0; i < 4; i++) {
-		int32_t a1 = (int32_t)tmp[i * 4 + 0] + (int32_t)tmp[i * 4 + 2];
-		int32_t b1 = (int32_t)tmp[i * 4 + 0] - (int32_t)tmp[i * 4 + 2];
-
-		int32_t temp1 = ((int32_t)tmp[i * 4 + 1] * sinpi8sqrt2) >> 16;
-		int32_t temp2 = (int32_t)tmp[i * 4 + 3] + (((int32_t)tmp[i * 4 + 3] * cospi8sqrt2minus1) >> 16);
-		int32_t c1 = temp1 - temp2;
-
-		temp1 = (int32_t)tmp[i * 4 + 1] + (((int32_t)tmp[i * 4 + 1] * cospi8sqrt2minus1) >> 16);
-		temp2 = ((int32_t)tmp[i * 4 + 3] * sinpi8sqrt2) >> 16;
-		int32_t d1 = temp1 + temp2;
-
-		output[i * 4 + 0] = (int16_t)((a1 + d1 + 4) >> 3);
-		output[i * 4 + 3] = (int16_t)((a1 - d1 + 4) >> 3);
-		output[i * 4 + 1] = (int16_t)((b1 + c1 + 4) >> 3);
-		output[i * 4 + 2] = (int16_t)((b1 - c1 + 4) >> 3);
-	}
-}
-
-// --- Prediction ---
-
-static void pred_dc(uint8_t* dst, uint32_t stride, const uint8_t* A, const uint8_t* L, uint32_t n, int have_above,
-                    int have_left, uint8_t above_oob, uint8_t left_oob) {
-	if (!have_above && !have_left) {
-		for (uint32_t r = 0; r < n; r++)
-			for (uint32_t c = 0; c < n; c++) dst[r * stride + c] = 128;
-		return;
-	}
-	int sum = 0;
-	int shf = 0;
-	if (have_above && have_left) {
-		for (uint32_t i = 0; i < n; i++) sum += (int)A[i] + (int)L[i];
-		shf = (n == 16) ? 5 : (n == 8) ? 4 : 3;
-	} else if (have_left) {
-		for (uint32_t i = 0; i < n; i++) sum += (int)L[i];
-		shf = (n == 16) ? 4 : (n == 8) ? 3 : 2;
-	} else {
-		for (uint32_t i = 0; i < n; i++) sum += (int)A[i];
-		shf = (n == 16) ? 4 : (n == 8) ? 3 : 2;
-	}
-	uint8_t v = (uint8_t)((sum + (1 << (shf - 1))) >> shf);
-	(void)above_oob;
-	(void)left_oob;
-	for (uint32_t r = 0; r < n; r++)
-		for (uint32_t c = 0; c < n; c++) dst[r * stride + c] = v;
-}
-
-static void pred_v(uint8_t* dst, uint32_t stride, const uint8_t* A, uint32_t n, int have_above, uint8_t above_oob) {
-	for (uint32_t r = 0; r < n; r++) {
-		for (uint32_t c = 0; c < n; c++) dst[r * stride + c] = have_above ? A[c] : above_oob;
-	}
-}
-
-static void pred_h(uint8_t* dst, uint32_t stride, const uint8_t* L, uint32_t n, int have_left, uint8_t left_oob) {
-	for (uint32_t r = 0; r < n; r++) {
-		uint8_t v = have_left ? L[r] : left_oob;
-		for (uint32_t c = 0; c < n; c++) dst[r * stride + c] = v;
-	}
-}
-
-static void pred_tm(uint8_t* dst, uint32_t stride, const uint8_t* A, const uint8_t* L, uint32_t n, int have_above,
-                    int have_left, uint8_t above_oob, uint8_t left_oob) {
-	uint8_t P = 128;
-	if (have_above && have_left) {
-		P = A[-1];
-	} else if (!have_above && have_left) {
-		P = above_oob; // A[-1]
-	} else if (have_above && !have_left) {
-		P = left_oob; // L[-1]
-	} else {
-		// For TM_PRED, use the out-of-bounds value for the pixel above-left.
-		// RFC 6386 Section 12: pixels above the top row (including above-left) are 127.
-		P = above_oob;
-	}
-	for (uint32_t r = 0; r < n; r++) {
-		uint8_t Lv = have_left ? L[r] : left_oob;
-		for (uint32_t c = 0; c < n; c++) {
-			uint8_t Av = have_above ? A[c] : above_oob;
-			dst[r * stride + c] = clamp255_i32((int32_t)Lv + (int32_t)Av - (int32_t)P);
-		}
-	}
-}
-
-// Subblock intra prediction modes for B_PRED, matching RFC code.
-static inline uint8_t avg3(uint8_t x, uint8_t y, uint8_t z) { return (uint8_t)((x + y + y + z + 2) >> 2); }
-static inline uint8_t avg2(uint8_t x, uint8_t y) { return (uint8_t)((x + y + 1) >> 1); }
-
-static void subblock_predict(uint8_t B[4][4], const uint8_t* A, const uint8_t* L, uint8_t mode) {
-	uint8_t E[9];
-	E[0] = L[3];
-	E[1] = L[2];
-	E[2] = L[1];
-	E[3] = L[0];
-	E[4] = A[-1];
-	E[5] = A[0];
-	E[6] = A[1];
-	E[7] = A[2];
-	E[8] = A[3];
-
-	switch (mode) {
-		case 0: { // B_DC_PRED
-			int v = 4;
-			for (int i = 0; i < 4; i++) v += (int)A[i] + (int)L[i];
-			v >>= 3;
-			for (int r = 0; r < 4; r++)
-				for (int c = 0; c < 4; c++) B[r][c] = (uint8_t)v;
-			break;
-		}
-		case 1: { // B_TM_PRED
-			for (int r = 0; r < 4; r++)
-				for (int c = 0; c < 4; c++) B[r][c] = clamp255_i32((int32_t)L[r] + (int32_t)A[c] - (int32_t)A[-1]);
-			break;
-		}
-		case 2: { // B_VE_PRED
-			for (int c = 0; c < 4; c++) {
-				uint8_t v = avg3(A[c - 1], A[c], A[c + 1]);
-				B[0][c] = B[1][c] = B[2][c] = B[3][c] = v;
-			}
-			break;
-		}
-		case 3: { // B_HE_PRED
-			// Bottom row is exceptional because L[4] does not exist.
-			uint8_t v = avg3(L[2], L[3], L[3]);
-			B[3][0] = B[3][1] = B[3][2] = B[3][3] = v;
-
-			// Upper 3 rows use avg3p(L + r), where L[-1] == P (== A[-1]).
-			v = avg3(L[1], L[2], L[3]);
-			B[2][0] = B[2][1] = B[2][2] = B[2][3] = v;
-			v = avg3(L[0], L[1], L[2]);
-			B[1][0] = B[1][1] = B[1][2] = B[1][3] = v;
-			v = avg3(A[-1], L[0], L[1]);
-			B[0][0] = B[0][1] = B[0][2] = B[0][3] = v;
-			break;
-		}
-		case 4: { // B_LD_PRED
-			B[0][0] = avg3(A[0], A[1], A[2]);
-			B[0][1] = B[1][0] = avg3(A[1], A[2], A[3]);
-			B[0][2] = B[1][1] = B[2][0] = avg3(A[2], A[3], A[4]);
-			B[0][3] = B[1][2] = B[2][1] = B[3][0] = avg3(A[3], A[4], A[5]);
-			B[1][3] = B[2][2] = B[3][1] = avg3(A[4], A[5], A[6]);
-			B[2][3] = B[3][2] = avg3(A[5], A[6], A[7]);
-			B[3][3] = avg3(A[6], A[7], A[7]);
-			break;
-		}
-		case 5: { // B_RD_PRED
-			B[3][0] = avg3(E[0], E[1], E[2]);
-			B[3][1] = B[2][0] = avg3(E[1], E[2], E[3]);
-			B[3][2] = B[2][1] = B[1][0] = avg3(E[2], E[3], E[4]);
-			B[3][3] = B[2][2] = B[1][1] = B[0][0] = avg3(E[3], E[4], E[5]);
-			B[2][3] = B[1][2] = B[0][1] = avg3(E[4], E[5], E[6]);
-			B[1][3] = B[0][2] = avg3(E[5], E[6], E[7]);
-			B[0][3] = avg3(E[6], E[7], E[8]);
-			break;
-		}
-		case 6: { // B_VR_PRED
-			// RFC 6386 reference code.
-			uint8_t avg3p_2 = avg3(E[1], E[2], E[3]);
-			uint8_t avg3p_3 = avg3(E[2], E[3], E[4]);
-			uint8_t avg3p_4 = avg3(E[3], E[4], E[5]);
-			uint8_t avg3p_5 = avg3(E[4], E[5], E[6]);
-			uint8_t avg3p_6 = avg3(E[5], E[6], E[7]);
-			uint8_t avg3p_7 = avg3(E[6], E[7], E[8]);
-			uint8_t avg2p_4 = avg2(E[4], E[5]);
-			uint8_t avg2p_5 = avg2(E[5], E[6]);
-			uint8_t avg2p_6 = avg2(E[6], E[7]);
-			uint8_t avg2p_7 = avg2(E[7], E[8]);
-
-			B[3][0] = avg3p_2;
-			B[2][0] = avg3p_3;
-			B[3][1] = B[1][0] = avg3p_4;
-			B[2][1] = B[0][0] = avg2p_4;
-			B[3][2] = B[1][1] = avg3p_5;
-			B[2][2] = B[0][1] = avg2p_5;
-			B[3][3] = B[1][2] = avg3p_6;
-			B[2][3] = B[0][2] = avg2p_6;
-			B[1][3] = avg3p_7;
-			B[0][3] = avg2p_7;
-			break;
-		}
-		case 7: { // B_VL_PRED
-			// RFC 6386 reference code.
-			B[0][0] = avg2(A[0], A[1]);
-			B[1][0] = avg3(A[0], A[1], A[2]);
-			B[2][0] = B[0][1] = avg2(A[1], A[2]);
-			B[1][1] = B[3][0] = avg3(A[1], A[2], A[3]);
-			B[2][1] = B[0][2] = avg2(A[2], A[3]);
-			B[3][1] = B[1][2] = avg3(A[2], A[3], A[4]);
-			B[2][2] = B[0][3] = avg2(A[3], A[4]);
-			B[3][2] = B[1][3] = avg3(A[3], A[4], A[5]);
-			B[2][3] = avg3(A[4], A[5], A[6]);
-			B[3][3] = avg3(A[5], A[6], A[7]);
-			break;
-		}
-		case 8: { // B_HD_PRED
-			// RFC 6386 reference code.
-			B[3][0] = avg2(E[0], E[1]);
-			B[3][1] = avg3(E[0], E[1], E[2]);
-			B[2][0] = B[3][2] = avg2(E[1], E[2]);
-			B[2][1] = B[3][3] = avg3(E[1], E[2], E[3]);
-			B[2][2] = B[1][0] = avg2(E[2], E[3]);
-			B[2][3] = B[1][1] = avg3(E[2], E[3], E[4]);
-			B[1][2] = B[0][0] = avg2(E[3], E[4]);
-			B[1][3] = B[0][1] = avg3(E[3], E[4], E[5]);
-			B[0][2] = avg3(E[4], E[5], E[6]);
-			B[0][3] = avg3(E[5], E[6], E[7]);
-			break;
-		}
-		case 9: { // B_HU_PRED
-			B[0][0] = avg2(L[0], L[1]);
-			B[0][1] = avg3(L[0], L[1], L[2]);
-			B[0][2] = B[1][0] = avg2(L[1], L[2]);
-			B[0][3] = B[1][1] = avg3(L[1], L[2], L[3]);
-			B[1][2] = B[2][0] = avg2(L[2], L[3]);
-			B[1][3] = B[2][1] = avg3(L[2], L[3], L[3]);
-			for (int r = 2; r < 4; r++) {
-				for (int c = 2; c < 4; c++) B[r][c] = L[3];
-			}
-			B[3][0] = L[3];
-			B[3][1] = L[3];
-			break;
-		}
-		default: {
-			for (int r = 0; r < 4; r++)
-				for (int c = 0; c < 4; c++) B[r][c] = 128;
-			break;
-		}
-	}
-}
-
 int yuv420_alloc(Yuv420Image* img, uint32_t width, uint32_t height) {
 	if (!img || width == 0 || height == 0) {
 		errno = EINVAL;
@@ -370,15 +29,16 @@ int yuv420_alloc(Yuv420Image* img, uint32_t width, uint32_t height) {
 	size_t ysz = (size_t)img->stride_y * (size_t)height;
 	size_t uvh = (size_t)((height + 1u) / 2u);
 	size_t uvsz = (size_t)img->stride_uv * uvh;
-	img->y = (uint8_t*)malloc(ysz);
-	img->u = (uint8_t*)malloc(uvsz);
-	img->v = (uint8_t*)malloc(uvsz);
-	if (!img->y || !img->u || !img->v) {
-		yuv420_free(img);
-		errno = ENOMEM;
+	size_t total = 0;
+	if (arena_reserve(&total, ysz, 1) != 0 || arena_reserve(&total, uvsz, 1) != 0 ||
+	    arena_reserve(&total, uvsz, 1) != 0 || arena_init(&img->mem, total) != 0) {
+		*img = (Yuv420Image){0};
 		return -1;
 	}
-	memset(img->y, 0, ysz);
+	// The arena is zeroed, which is already the Y fill.
+	img->y = (uint8_t*)arena_alloc(&img->mem, ysz, 1);
+	img->u = (uint8_t*)arena_alloc(&img->mem, uvsz, 1);
+	img->v = (uint8_t*)arena_alloc(&img->mem, uvsz, 1);
 	memset(img->u, 128, uvsz);
 	memset(img->v, 128, uvsz);
 	return 0;
@@ -386,9 +46,7 @@ int yuv420_alloc(Yuv420Image* img, uint32_t width, uint32_t height) {
 
 void yuv420_free(Yuv420Image* img) {
 	if (!img) return;
-	free(img->y);
-	free(img->u);
-	free(img->v);
+	arena_free(&img->mem);
 	*img = (Yuv420Image){0};
 }
 
@@ -420,53 +78,115 @@ static void get_left_col(const uint8_t* plane, uint32_t stride, uint32_t height,
 	}
 }
 
-static int vp8_reconstruct_keyframe_yuv_internal(const Vp8KeyFrameHeader* kf, const Vp8DecodedFrame* decoded, Yuv420Image* out,
-								  int apply_loopfilter) {
-	if (!kf || !decoded || !out) {
+// Above-left pixel for TM_PRED: 127 on the top row (the row above is all 127),
+// otherwise 129 on the left edge (the left column is all 129).
+static uint8_t above_left(const uint8_t* plane, uint32_t stride, uint32_t x, uint32_t y) {
+	if (y == 0) return 127;
+	if (x == 0) return 129;
+	return plane[(y - 1) * stride + (x - 1)];
+}
+
+// Vp8Dsp.pred16/pred8 index for a DC/V/H/TM mode; DC_PRED (and any other
+// value) averages only the edges inside the frame.
+static uint32_t pred_mode(uint8_t mode, int have_above, int have_left) {
+	if (mode >= VP8_PRED_V && mode <= VP8_PRED_TM) return mode;
+	if (have_above && have_left) return VP8_PRED_DC;
+	if (have_left) return VP8_PRED_DC_NO_TOP;
+	return have_above ? VP8_PRED_DC_NO_LEFT : VP8_PRED_DC_NO_TOP_LEFT;
+}
+
+
+// Inverse-transforms one chroma block; a block without non-zero coefficients
+// has a zero residual.
+static void inv_dct_uv(const Vp8Dsp* dsp, const int16_t* c, uint32_t nonzero, int16_t res[16]) {
+	if (!nonzero) {
+		memset(res, 0, 16 * sizeof(res[0]));
+		return;
+	}
+	dsp->inv_dct4x4(c, res);
+}
+
+static int rect_inside(const Vp8Rect* r, uint32_t width, uint32_t height) {
+	return r->width != 0 && r->height != 0 && r->x < width && r->y < height && r->width <= width - r->x &&
+	       r->height <= height - r->y;
+}
+
+void vp8_rect_mb_extent(const Vp8KeyFrameHeader* kf, const Vp8Rect* rect, int apply_loopfilter, Vp8MbExtent* out) {
+	const uint32_t mb_cols = (kf->width + 15u) / 16u;
+	const uint32_t mb_rows = (kf->height + 15u) / 16u;
+	const uint32_t margin = apply_loopfilter ? 1u : 0u;
+	uint32_t rows = (rect->y + rect->height - 1u) / 16u + 1u + margin;
+	uint32_t cols = (rect->x + rect->width - 1u) / 16u + 1u + margin;
+	out->mb_cols = mb_cols;
+	out->mb_rows = (rows < mb_rows) ? rows : mb_rows;
+	out->col_end = (cols < mb_cols) ? cols : mb_cols;
+}
+
+// Reconstructs `rect` of the frame (NULL: all of it) into `out`.
+static int vp8_reconstruct_keyframe_yuv_internal(const Vp8KeyFrameHeader* kf, const Vp8DecodedFrame* decoded, const Yuv420Image* out,
+								  int apply_loopfilter, const Vp8Rect* rect) {
+	if (!kf || !decoded || !out || !out->y || !out->u || !out->v) {
+		errno = EINVAL;
+		return -1;
+	}
+	// A DC-only frame only has a preview (vp8_reconstruct_keyframe_preview()).
+	if (decoded->dc_only) {
 		errno = EINVAL;
 		return -1;
 	}
+	const Vp8Rect frame = {0, 0, kf->width, kf->height};
+	if (rect && (!rect_inside(rect, kf->width, kf->height) || ((rect->x | rect->y) & 1u))) {
+		errno = EINVAL;
+		return -1;
+	}
+	if (!rect) rect = &frame;
+	if (out->width != rect->width || out->height != rect->height || out->stride_y < out->width ||
+	    out->stride_uv < (out->width + 1u) / 2u) {
+		errno = EINVAL;
+		return -1;
+	}
+	Vp8MbExtent extent = {decoded->mb_cols, decoded->mb_rows, decoded->mb_cols};
+	if (rect != &frame) vp8_rect_mb_extent(kf, rect, apply_loopfilter, &extent);
 
 	// Reconstruct into a macroblock-aligned padded buffer first.
 	// This matches reference decoders that reconstruct full macroblocks even when the
 	// visible frame dimensions are not multiples of 16 (or chroma not multiples of 8).
+	// A region-of-interest decode stops at the last macroblock row it needs.
 	uint32_t padded_w = decoded->mb_cols * 16u;
-	uint32_t padded_h = decoded->mb_rows * 16u;
+	uint32_t padded_h = extent.mb_rows * 16u;
 	Yuv420Image pad;
 	if (yuv420_alloc(&pad, padded_w, padded_h) != 0) return -1;
 
-	DequantFactors dqf[4];
-	memset(dqf, 0, sizeof(dqf));
-	dequant_init(dqf, decoded);
+	const Vp8Dsp* dsp = vp8_dsp();
 
 	uint32_t mb_cols = decoded->mb_cols;
-	uint32_t mb_rows = decoded->mb_rows;
+	uint32_t mb_rows = extent.mb_rows;
 	for (uint32_t mb_r = 0; mb_r < mb_rows; mb_r++) {
-		for (uint32_t mb_c = 0; mb_c < mb_cols; mb_c++) {
+		const uint32_t cols = vp8_mb_extent_cols(&extent, mb_r);
+		for (uint32_t mb_c = 0; mb_c < cols; mb_c++) {
 			uint32_t mb = mb_r * mb_cols + mb_c;
-			uint32_t seg = decoded->segmentation_enabled ? (uint32_t)(decoded->segment_id[mb] & 3u) : 0u;
-			const DequantFactors* q = &dqf[seg];
+			const Vp8MbRecord* rec = &decoded->mbs[mb];
+			const int16_t* coeffs = vp8_mb_coeffs(decoded, mb);
+			const int16_t* coeffs_y = coeffs + VP8_MB_COEFFS_Y2;
 
 			uint32_t x = mb_c * 16u;
 			uint32_t y = mb_r * 16u;
 
-			uint8_t ymode = decoded->ymode[mb];
+			uint8_t ymode = rec->ymode;
 			if (ymode == 4) {
 				// B_PRED (4x4 intra): each subblock predictor depends on already-constructed pixels,
 				// including those inside the current macroblock. Reconstruct in scan order.
 				for (uint32_t sb_r = 0; sb_r < 4; sb_r++) {
 					for (uint32_t sb_c = 0; sb_c < 4; sb_c++) {
 						uint32_t sb = sb_r * 4u + sb_c;
-						uint8_t mode = decoded->bmode[mb * 16u + sb];
+						uint8_t mode = vp8_mb_bmode(rec, sb);
 						uint32_t sx = x + sb_c * 4u;
 						uint32_t sy = y + sb_r * 4u;
 
 						uint8_t A8[9];
 						uint8_t L4[4];
 						// Top-left (P) value.
-						if (sy == 0) A8[0] = 127;
-						else if (sx == 0) A8[0] = 129;
-						else A8[0] = pad.y[(sy - 1) * pad.stride_y + (sx - 1)];
+						A8[0] = above_left(pad.y, pad.stride_y, sx, sy);
 
 						// Above row (A[0..7] lives in A8[1..8]).
 						for (uint32_t i = 0; i < 8; i++) {
@@ -504,17 +224,14 @@ static int vp8_reconstruct_keyframe_yuv_internal(const Vp8KeyFrameHeader* kf, co
 						}
 
 						uint8_t B[4][4];
-						subblock_predict(B, &A8[1], L4, mode);
-
-						uint32_t blk = mb * 16u + (sb_r * 4u + sb_c);
-						const int16_t* cq = decoded->coeff_y + (size_t)blk * 16u;
-						int16_t cdeq[16];
-						for (int i = 0; i < 16; i++) {
-							int fct = (i == 0) ? q->factor[TOKEN_BLOCK_Y1][0] : q->factor[TOKEN_BLOCK_Y1][1];
-							cdeq[i] = (int16_t)(cq[i] * fct);
-						}
+						dsp->subblock_predict(B, &A8[1], L4, mode);
+
 						int16_t res[16];
-						inv_dct4x4(cdeq, res);
+						if (rec->nz_y & (1u << sb)) {
+							dsp->inv_dct4x4(coeffs_y + sb * 16u, res);
+						} else {
+							memset(res, 0, sizeof(res));
+						}
 
 						for (uint32_t rr = 0; rr < 4; rr++) {
 							uint32_t yy = sy + rr;
@@ -532,60 +249,33 @@ static int vp8_reconstruct_keyframe_yuv_internal(const Vp8KeyFrameHeader* kf, co
 
 				// Build luma predictor into a temporary 16x16 block.
 				uint8_t pred_y[16 * 16];
-				uint8_t A16[20];
+				uint8_t A16[17];
 				uint8_t L16[16];
-				get_above_row(pad.y, pad.stride_y, pad.width, x, y, 16, 127, A16);
+				get_above_row(pad.y, pad.stride_y, pad.width, x, y, 16, 127, &A16[1]);
 				get_left_col(pad.y, pad.stride_y, pad.height, x, y, 16, 129, L16);
-				A16[16] = A16[15];
-				A16[17] = A16[15];
-				A16[18] = A16[15];
-				A16[19] = A16[15];
-				int have_above = (y != 0);
-				int have_left = (x != 0);
-
-				// 16x16 predictors.
-				switch (ymode) {
-					case 0: pred_dc(pred_y, 16, A16, L16, 16, have_above, have_left, 127, 129); break;
-					case 1: pred_v(pred_y, 16, A16, 16, have_above, 127); break;
-					case 2: pred_h(pred_y, 16, L16, 16, have_left, 129); break;
-					case 3: {
-						// Need A[-1] for TM; model it as 127/129 for OOB.
-						uint8_t Ap[17];
-						Ap[0] = have_above && have_left ? pad.y[(y - 1) * pad.stride_y + (x - 1)] : (have_above ? 129 : 127);
-						memcpy(&Ap[1], A16, 16);
-						pred_tm(pred_y, 16, &Ap[1], L16, 16, have_above, have_left, 127, 129);
-						break;
-					}
-					default: pred_dc(pred_y, 16, A16, L16, 16, have_above, have_left, 127, 129); break;
-				}
+				A16[0] = above_left(pad.y, pad.stride_y, x, y);
+				dsp->pred16[pred_mode(ymode, y != 0, x != 0)](pred_y, 16, &A16[1], L16);
 
 				// Inverse transforms and add residue for luma.
 				int16_t y2_dc[16];
 				memset(y2_dc, 0, sizeof(y2_dc));
-				int16_t y2_deq[16];
-				const int16_t* y2q = decoded->coeff_y2 + (size_t)mb * 16u;
-				for (int i = 0; i < 16; i++) {
-					int fct = (i == 0) ? q->factor[TOKEN_BLOCK_Y2][0] : q->factor[TOKEN_BLOCK_Y2][1];
-					y2_deq[i] = (int16_t)(y2q[i] * fct);
-				}
-				inv_wht4x4(y2_deq, y2_dc);
+				dsp->inv_wht4x4(coeffs, y2_dc);
 
 				for (uint32_t sb_r = 0; sb_r < 4; sb_r++) {
 					for (uint32_t sb_c = 0; sb_c < 4; sb_c++) {
-						uint32_t blk = mb * 16u + (sb_r * 4u + sb_c);
-						const int16_t* cq = decoded->coeff_y + (size_t)blk * 16u;
-						int16_t cdeq[16];
-						for (int i = 0; i < 16; i++) {
-							if (i == 0) {
-								// With Y2 present, the per-block DC comes from inverse WHT of already-dequantized Y2.
-								cdeq[i] = y2_dc[(int)sb_r * 4 + (int)sb_c];
-							} else {
-								int fct = q->factor[TOKEN_BLOCK_Y1][1];
-								cdeq[i] = (int16_t)(cq[i] * fct);
-							}
-						}
+						const uint32_t sb = sb_r * 4u + sb_c;
 						int16_t res[16];
-						inv_dct4x4(cdeq, res);
+						if (rec->nz_y & (1u << sb)) {
+							// With Y2 present, the per-block DC comes from the inverse WHT.
+							int16_t c[16];
+							memcpy(c, coeffs_y + sb * 16u, sizeof(c));
+							c[0] = y2_dc[sb];
+							dsp->inv_dct4x4(c, res);
+						} else {
+							// No AC: the inverse DCT of a lone DC is flat.
+							const int16_t dc = (int16_t)((y2_dc[sb] + 4) >> 3);
+							for (int i = 0; i < 16; i++) res[i] = dc;
+						}
 
 						for (uint32_t rr = 0; rr < 4; rr++) {
 							uint32_t yy = y + sb_r * 4u + rr;
@@ -610,62 +300,27 @@ static int vp8_reconstruct_keyframe_yuv_internal(const Vp8KeyFrameHeader* kf, co
 
 			uint8_t pred_u[8 * 8];
 			uint8_t pred_vp[8 * 8];
-			uint8_t A8u[8];
+			uint8_t A8u[9];
 			uint8_t L8u[8];
-			uint8_t A8v[8];
+			uint8_t A8v[9];
 			uint8_t L8v[8];
-			get_above_row(pad.u, pad.stride_uv, cw, cx, cy, 8, 127, A8u);
+			get_above_row(pad.u, pad.stride_uv, cw, cx, cy, 8, 127, &A8u[1]);
 			get_left_col(pad.u, pad.stride_uv, ch, cx, cy, 8, 129, L8u);
-			get_above_row(pad.v, pad.stride_uv, cw, cx, cy, 8, 127, A8v);
+			get_above_row(pad.v, pad.stride_uv, cw, cx, cy, 8, 127, &A8v[1]);
 			get_left_col(pad.v, pad.stride_uv, ch, cx, cy, 8, 129, L8v);
-			int have_above_c = (cy != 0);
-			int have_left_c = (cx != 0);
-			switch (decoded->uv_mode[mb]) {
-				case 0:
-					pred_dc(pred_u, 8, A8u, L8u, 8, have_above_c, have_left_c, 127, 129);
-					pred_dc(pred_vp, 8, A8v, L8v, 8, have_above_c, have_left_c, 127, 129);
-					break;
-				case 1:
-					pred_v(pred_u, 8, A8u, 8, have_above_c, 127);
-					pred_v(pred_vp, 8, A8v, 8, have_above_c, 127);
-					break;
-				case 2:
-					pred_h(pred_u, 8, L8u, 8, have_left_c, 129);
-					pred_h(pred_vp, 8, L8v, 8, have_left_c, 129);
-					break;
-				case 3: {
-					uint8_t Apu[9];
-					uint8_t Apv[9];
-					Apu[0] = have_above_c && have_left_c ? pad.u[(cy - 1) * pad.stride_uv + (cx - 1)] : (have_above_c ? 129 : 127);
-					Apv[0] = have_above_c && have_left_c ? pad.v[(cy - 1) * pad.stride_uv + (cx - 1)] : (have_above_c ? 129 : 127);
-					memcpy(&Apu[1], A8u, 8);
-					memcpy(&Apv[1], A8v, 8);
-					pred_tm(pred_u, 8, &Apu[1], L8u, 8, have_above_c, have_left_c, 127, 129);
-					pred_tm(pred_vp, 8, &Apv[1], L8v, 8, have_above_c, have_left_c, 127, 129);
-					break;
-				}
-				default:
-					pred_dc(pred_u, 8, A8u, L8u, 8, have_above_c, have_left_c, 127, 129);
-					pred_dc(pred_vp, 8, A8v, L8v, 8, have_above_c, have_left_c, 127, 129);
-					break;
-			}
+			A8u[0] = above_left(pad.u, pad.stride_uv, cx, cy);
+			A8v[0] = above_left(pad.v, pad.stride_uv, cx, cy);
+			const Vp8PredFn pred_c = dsp->pred8[pred_mode(rec->uv_mode, cy != 0, cx != 0)];
+			pred_c(pred_u, 8, &A8u[1], L8u);
+			pred_c(pred_vp, 8, &A8v[1], L8v);
 
 			for (uint32_t b = 0; b < 4; b++) {
 				uint32_t br = b / 2u;
 				uint32_t bc = b % 2u;
-				const int16_t* cuq = decoded->coeff_u + ((size_t)mb * 4u + b) * 16u;
-				const int16_t* cvq = decoded->coeff_v + ((size_t)mb * 4u + b) * 16u;
-				int16_t cudeq[16];
-				int16_t cvdeq[16];
-				for (int i = 0; i < 16; i++) {
-					int fct = (i == 0) ? q->factor[TOKEN_BLOCK_UV][0] : q->factor[TOKEN_BLOCK_UV][1];
-					cudeq[i] = (int16_t)(cuq[i] * fct);
-					cvdeq[i] = (int16_t)(cvq[i] * fct);
-				}
 				int16_t ures[16];
 				int16_t vres[16];
-				inv_dct4x4(cudeq, ures);
-				inv_dct4x4(cvdeq, vres);
+				inv_dct_uv(dsp, coeffs_y + (16u + b) * 16u, (rec->nz_uv >> b) & 1u, ures);
+				inv_dct_uv(dsp, coeffs_y + (20u + b) * 16u, (rec->nz_uv >> (4u + b)) & 1u, vres);
 
 				for (uint32_t rr = 0; rr < 4; rr++) {
 					uint32_t yy = cy + br * 4u + rr;
@@ -684,37 +339,217 @@ static int vp8_reconstruct_keyframe_yuv_internal(const Vp8KeyFrameHeader* kf, co
 	}
 
 	if (apply_loopfilter) {
-		if (vp8_loopfilter_apply_keyframe(&pad, decoded) != 0) {
+		(void)dec_timing_switch(DEC_STAGE_LOOPFILTER);
+		if (vp8_loopfilter_apply_keyframe(&pad, decoded, &extent) != 0) {
 			yuv420_free(&pad);
 			return -1;
 		}
+		(void)dec_timing_switch(DEC_STAGE_RECON);
 	}
 
-	// Crop padded reconstruction down to the visible frame size.
-	Yuv420Image cropped;
-	if (yuv420_alloc(&cropped, kf->width, kf->height) != 0) {
-		yuv420_free(&pad);
-		return -1;
-	}
-	for (uint32_t yy = 0; yy < cropped.height; yy++) {
-		memcpy(&cropped.y[yy * cropped.stride_y], &pad.y[yy * pad.stride_y], cropped.width);
+	// Crop padded reconstruction down to the visible frame size (or rectangle).
+	const size_t y_off = (size_t)rect->y * pad.stride_y + rect->x;
+	const size_t uv_off = (size_t)(rect->y / 2u) * pad.stride_uv + rect->x / 2u;
+	for (uint32_t yy = 0; yy < out->height; yy++) {
+		memcpy(&out->y[(size_t)yy * out->stride_y], &pad.y[y_off + (size_t)yy * pad.stride_y], out->width);
 	}
-	uint32_t cw_out = (cropped.width + 1u) / 2u;
-	uint32_t ch_out = (cropped.height + 1u) / 2u;
+	uint32_t cw_out = (out->width + 1u) / 2u;
+	uint32_t ch_out = (out->height + 1u) / 2u;
 	for (uint32_t yy = 0; yy < ch_out; yy++) {
-		memcpy(&cropped.u[yy * cropped.stride_uv], &pad.u[yy * pad.stride_uv], cw_out);
-		memcpy(&cropped.v[yy * cropped.stride_uv], &pad.v[yy * pad.stride_uv], cw_out);
+		memcpy(&out->u[(size_t)yy * out->stride_uv], &pad.u[uv_off + (size_t)yy * pad.stride_uv], cw_out);
+		memcpy(&out->v[(size_t)yy * out->stride_uv], &pad.v[uv_off + (size_t)yy * pad.stride_uv], cw_out);
 	}
 
 	yuv420_free(&pad);
+	return 0;
+}
+
+static int reconstruct_alloc(const Vp8KeyFrameHeader* kf, const Vp8DecodedFrame* decoded, Yuv420Image* out,
+                             int apply_loopfilter) {
+	if (!kf || !decoded || !out) {
+		errno = EINVAL;
+		return -1;
+	}
+	Yuv420Image cropped;
+	if (yuv420_alloc(&cropped, kf->width, kf->height) != 0) return -1;
+	if (vp8_reconstruct_keyframe_yuv_internal(kf, decoded, &cropped, apply_loopfilter, NULL) != 0) {
+		yuv420_free(&cropped);
+		return -1;
+	}
 	*out = cropped;
 	return 0;
 }
 
 int vp8_reconstruct_keyframe_yuv(const Vp8KeyFrameHeader* kf, const Vp8DecodedFrame* decoded, Yuv420Image* out) {
-	return vp8_reconstruct_keyframe_yuv_internal(kf, decoded, out, 0);
+	return reconstruct_alloc(kf, decoded, out, 0);
 }
 
 int vp8_reconstruct_keyframe_yuv_filtered(const Vp8KeyFrameHeader* kf, const Vp8DecodedFrame* decoded, Yuv420Image* out) {
-	return vp8_reconstruct_keyframe_yuv_internal(kf, decoded, out, 1);
+	return reconstruct_alloc(kf, decoded, out, 1);
+}
+
+int vp8_reconstruct_keyframe_into(const Vp8KeyFrameHeader* kf, const Vp8DecodedFrame* decoded, int apply_loopfilter,
+                                  const Yuv420Image* dst) {
+	return vp8_reconstruct_keyframe_yuv_internal(kf, decoded, dst, apply_loopfilter, NULL);
+}
+
+// --- Preview (DC-only frames) ---
+
+// Preview value of a 4x4 block: the mean of its prediction plus the DC term
+// the inverse DCT would have added to each of its pixels.
+static uint8_t block_dc(const uint8_t* pred, uint32_t pred_stride, int16_t dc) {
+	int32_t sum = 0;
+	for (uint32_t r = 0; r < 4; r++)
+		for (uint32_t c = 0; c < 4; c++) sum += pred[r * pred_stride + c];
+	return clamp255_i32(((sum + 8) >> 4) + (((int32_t)dc + 4) >> 3));
+}
+
+// A preview plane holds one pixel per 4x4 block and stands for a full-size
+// frame that is flat within each block, so pixel i of a predictor edge is
+// block i / 4 of the plane. (bx, by) is the block the edge belongs to.
+static void preview_above(const uint8_t* plane, uint32_t stride, uint32_t width, uint32_t bx, uint32_t by, uint32_t n,
+                          uint8_t* out) {
+	if (by == 0) {
+		memset(out, 127, n);
+		return;
+	}
+	for (uint32_t i = 0; i < n; i++) {
+		uint32_t b = bx + i / 4u;
+		if (b >= width) b = width - 1;
+		out[i] = plane[(by - 1u) * stride + b];
+	}
+}
+
+static void preview_left(const uint8_t* plane, uint32_t stride, uint32_t bx, uint32_t by, uint32_t n, uint8_t* out) {
+	if (bx == 0) {
+		memset(out, 129, n);
+		return;
+	}
+	for (uint32_t i = 0; i < n; i++) out[i] = plane[(by + i / 4u) * stride + bx - 1u];
+}
+
+// Reconstructs a DC-only frame directly at 1/4 scale into `out`. The
+// predictors still run on full-size edges expanded from the neighbouring
+// blocks, so each block gets the value a full-size reconstruction with flat
+// blocks would give it; only the 1/16-size planes are ever allocated.
+static int reconstruct_preview(const Vp8DecodedFrame* decoded, const Yuv420Image* out) {
+	// Macroblock-aligned, like the full-size path: 4x4 luma and 2x2 chroma
+	// blocks per macroblock.
+	Yuv420Image pad;
+	if (yuv420_alloc(&pad, decoded->mb_cols * 4u, decoded->mb_rows * 4u) != 0) return -1;
+	const uint32_t cw = pad.width / 2u;
+
+	const Vp8Dsp* dsp = vp8_dsp();
+
+	for (uint32_t mb_r = 0; mb_r < decoded->mb_rows; mb_r++) {
+		for (uint32_t mb_c = 0; mb_c < decoded->mb_cols; mb_c++) {
+			const uint32_t mb = mb_r * decoded->mb_cols + mb_c;
+			const Vp8MbRecord* rec = &decoded->mbs[mb];
+			const int16_t* coeffs = vp8_mb_coeffs(decoded, mb);
+			const int16_t* dc = coeffs + VP8_MB_COEFFS_Y2; // one value per Y, U and V block
+			const uint32_t bx = mb_c * 4u;
+			const uint32_t by = mb_r * 4u;
+
+			if (rec->ymode == 4) {
+				// B_PRED: subblocks predict from each other, in scan order.
+				for (uint32_t sb = 0; sb < 16; sb++) {
+					const uint32_t sx = bx + (sb & 3u);
+					const uint32_t sy = by + (sb >> 2);
+					uint8_t A8[9];
+					uint8_t L4[4];
+					A8[0] = above_left(pad.y, pad.stride_y, sx, sy);
+					preview_above(pad.y, pad.stride_y, pad.width, sx, sy, 4, &A8[1]);
+					// Above-right; the right column uses the row above the macroblock (RFC 6386 11.4).
+					if ((sb & 3u) == 3u) {
+						preview_above(pad.y, pad.stride_y, pad.width, bx + 4u, by, 4, &A8[5]);
+					} else {
+						preview_above(pad.y, pad.stride_y, pad.width, sx + 1u, sy, 4, &A8[5]);
+					}
+					preview_left(pad.y, pad.stride_y, sx, sy, 4, L4);
+
+					uint8_t B[4][4];
+					dsp->subblock_predict(B, &A8[1], L4, vp8_mb_bmode(rec, sb));
+					pad.y[sy * pad.stride_y + sx] = block_dc(&B[0][0], 4u, dc[sb]);
+				}
+			} else {
+				uint8_t pred_y[16 * 16];
+				uint8_t A16[17];
+				uint8_t L16[16];
+				A16[0] = above_left(pad.y, pad.stride_y, bx, by);
+				preview_above(pad.y, pad.stride_y, pad.width, bx, by, 16, &A16[1]);
+				preview_left(pad.y, pad.stride_y, bx, by, 16, L16);
+				dsp->pred16[pred_mode(rec->ymode, by != 0, bx != 0)](pred_y, 16, &A16[1], L16);
+
+				// The per-block DC comes from the inverse WHT.
+				int16_t y2_dc[16];
+				memset(y2_dc, 0, sizeof(y2_dc));
+				dsp->inv_wht4x4(coeffs, y2_dc);
+				for (uint32_t sb = 0; sb < 16; sb++) {
+					pad.y[(by + (sb >> 2)) * pad.stride_y + bx + (sb & 3u)] =
+					    block_dc(&pred_y[(sb >> 2) * 64u + (sb & 3u) * 4u], 16u, y2_dc[sb]);
+				}
+			}
+
+			const uint32_t cx = mb_c * 2u;
+			const uint32_t cy = mb_r * 2u;
+			uint8_t pred_u[8 * 8];
+			uint8_t pred_vp[8 * 8];
+			uint8_t A8u[9];
+			uint8_t L8u[8];
+			uint8_t A8v[9];
+			uint8_t L8v[8];
+			A8u[0] = above_left(pad.u, pad.stride_uv, cx, cy);
+			A8v[0] = above_left(pad.v, pad.stride_uv, cx, cy);
+			preview_above(pad.u, pad.stride_uv, cw, cx, cy, 8, &A8u[1]);
+			preview_above(pad.v, pad.stride_uv, cw, cx, cy, 8, &A8v[1]);
+			preview_left(pad.u, pad.stride_uv, cx, cy, 8, L8u);
+			preview_left(pad.v, pad.stride_uv, cx, cy, 8, L8v);
+			const Vp8PredFn pred_c = dsp->pred8[pred_mode(rec->uv_mode, cy != 0, cx != 0)];
+			pred_c(pred_u, 8, &A8u[1], L8u);
+			pred_c(pred_vp, 8, &A8v[1], L8v);
+			for (uint32_t b = 0; b < 4; b++) {
+				const size_t off = (size_t)(cy + b / 2u) * pad.stride_uv + cx + b % 2u;
+				const uint32_t poff = (b / 2u) * 32u + (b % 2u) * 4u;
+				pad.u[off] = block_dc(&pred_u[poff], 8u, dc[16u + b]);
+				pad.v[off] = block_dc(&pred_vp[poff], 8u, dc[20u + b]);
+			}
+		}
+	}
+
+	for (uint32_t yy = 0; yy < out->height; yy++) {
+		memcpy(&out->y[(size_t)yy * out->stride_y], &pad.y[(size_t)yy * pad.stride_y], out->width);
+	}
+	const uint32_t cw_out = (out->width + 1u) / 2u;
+	const uint32_t ch_out = (out->height + 1u) / 2u;
+	for (uint32_t yy = 0; yy < ch_out; yy++) {
+		memcpy(&out->u[(size_t)yy * out->stride_uv], &pad.u[(size_t)yy * pad.stride_uv], cw_out);
+		memcpy(&out->v[(size_t)yy * out->stride_uv], &pad.v[(size_t)yy * pad.stride_uv], cw_out);
+	}
+
+	yuv420_free(&pad);
+	return 0;
+}
+
+int vp8_reconstruct_keyframe_preview(const Vp8KeyFrameHeader* kf, const Vp8DecodedFrame* decoded, Yuv420Image* out) {
+	if (!kf || !decoded || !out || !decoded->dc_only) {
+		errno = EINVAL;
+		return -1;
+	}
+	Yuv420Image img;
+	if (yuv420_alloc(&img, (kf->width + 3u) / 4u, (kf->height + 3u) / 4u) != 0) return -1;
+	if (reconstruct_preview(decoded, &img) != 0) {
+		yuv420_free(&img);
+		return -1;
+	}
+	*out = img;
+	return 0;
+}
+
+int vp8_reconstruct_keyframe_rect(const Vp8KeyFrameHeader* kf, const Vp8DecodedFrame* decoded, int apply_loopfilter,
+                                  const Vp8Rect* rect, const Yuv420Image* dst) {
+	if (!rect) {
+		errno = EINVAL;
+		return -1;
+	}
+	return vp8_reconstruct_keyframe_yuv_internal(kf, decoded, dst, apply_loopfilter, rect);
 }
@@ -15,14 +15,68 @@ typedef struct {
 	uint8_t* y;
 	uint8_t* u;
 	uint8_t* v;
+	Arena mem; // planes of yuv420_alloc(); empty for caller-owned planes
 } Yuv420Image;
 
+// Allocates all three planes in one arena: Y zeroed, U/V set to 128.
 int yuv420_alloc(Yuv420Image* img, uint32_t width, uint32_t height);
 void yuv420_free(Yuv420Image* img);
 
+// Pixel rectangle [x, x+width) x [y, y+height) of a region-of-interest decode.
+typedef struct {
+	uint32_t x;
+	uint32_t y;
+	uint32_t width;
+	uint32_t height;
+} Vp8Rect;
+
+// Macroblocks a region-of-interest decode has to process: rows [0, mb_rows),
+// and in row r the columns [0, vp8_mb_extent_cols(e, r)). Each row above the
+// last one reaches one macroblock further right, because B_PRED reads the
+// above-right macroblock and the loop filter of a macroblock edge modifies
+// pixels its neighbours read later.
+typedef struct {
+	uint32_t mb_cols; // frame width in macroblocks
+	uint32_t mb_rows;
+	uint32_t col_end; // columns needed in row mb_rows - 1
+} Vp8MbExtent;
+
+static inline uint32_t vp8_mb_extent_cols(const Vp8MbExtent* e, uint32_t mb_r) {
+	const uint32_t cols = e->col_end + (e->mb_rows - 1u - mb_r);
+	return (cols < e->mb_cols) ? cols : e->mb_cols;
+}
+
+// Extent needed to reconstruct `rect` (which must lie inside the frame). With
+// apply_loopfilter it includes the macroblocks below and to the right, whose
+// edge filters still modify pixels of the rectangle.
+void vp8_rect_mb_extent(const Vp8KeyFrameHeader* kf, const Vp8Rect* rect, int apply_loopfilter, Vp8MbExtent* out);
+
 // Reconstructs an intra (key) frame into planar 4:2:0 (I420) buffers.
 // Loop filter is NOT applied (matches Milestone-6 output).
 int vp8_reconstruct_keyframe_yuv(const Vp8KeyFrameHeader* kf, const Vp8DecodedFrame* decoded, Yuv420Image* out);
 
 // Reconstructs an intra (key) frame and applies the in-loop deblocking filter.
 int vp8_reconstruct_keyframe_yuv_filtered(const Vp8KeyFrameHeader* kf, const Vp8DecodedFrame* decoded, Yuv420Image* out);
+
+// Reconstructs into caller-owned planes (no allocation of the output image).
+// dst->width/height must equal the frame size; strides may be larger than the
+// visible width. apply_loopfilter selects the _filtered variant.
+int vp8_reconstruct_keyframe_into(const Vp8KeyFrameHeader* kf, const Vp8DecodedFrame* decoded, int apply_loopfilter,
+                                  const Yuv420Image* dst);
+
+// Reconstructs only the macroblocks `rect` depends on (vp8_rect_mb_extent(), so
+// `decoded` only needs that many macroblock rows) and copies the rectangle into
+// dst, whose width/height must equal the rectangle's. rect->x and rect->y must be
+// even so the chroma planes crop on sample boundaries. Pixels equal the same
+// rectangle of the full-frame output.
+int vp8_reconstruct_keyframe_rect(const Vp8KeyFrameHeader* kf, const Vp8DecodedFrame* decoded, int apply_loopfilter,
+                                  const Vp8Rect* rect, const Yuv420Image* dst);
+
+// Gallery preview of a frame decoded with vp8_decode_decoded_frame_dc(): one
+// pixel per 4x4 block ((width+3)/4 x (height+3)/4), the mean of the block's
+// prediction plus its dequantized DC (from the Y2 WHT for non-B_PRED
+// macroblocks). Reconstructed directly at 1/4 scale: predictor edges are
+// expanded from the neighbouring blocks, so no full-resolution plane exists.
+// There is no IDCT and no loop filter. Allocates `out` (free with
+// yuv420_free()).
+int vp8_reconstruct_keyframe_preview(const Vp8KeyFrameHeader* kf, const Vp8DecodedFrame* decoded, Yuv420Image* out);
@@ -10,5 +10,8 @@
 // The filter operates in-place on the *macroblock-aligned* reconstruction buffer.
 // The caller should apply the filter before cropping to visible width/height.
 //
+// With `extent` (NULL: the whole frame), only its macroblocks are filtered and
+// padded_img only needs extent->mb_rows macroblock rows.
+//
 // Returns 0 on success.
-int vp8_loopfilter_apply_keyframe(Yuv420Image* padded_img, const Vp8DecodedFrame* decoded);
+int vp8_loopfilter_apply_keyframe(Yuv420Image* padded_img, const Vp8DecodedFrame* decoded, const Vp8MbExtent* extent);
@@ -7,200 +7,242 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include "../common/dsp.h"
 #include "../common/fmt.h"
 #include "../common/os.h"
+#include "../common/timing.h"
+#include "../m11_alpha/webp_alpha.h"
 
-// Bit-exact VP8/WebP YUV->RGB conversion (matches libwebp's VP8YuvToRgb).
-enum {
-	YUV_FIX2 = 6,
-	YUV_MASK2 = (256 << YUV_FIX2) - 1
-};
-
-static inline int mult_hi(int v, int coeff) {
-	// _mm_mulhi_epu16 emulation used by libwebp.
-	return (v * coeff) >> 8;
+static void fill_alpha(uint8_t* row, uint32_t width) {
+	for (uint32_t x = 0; x < width; x++) row[(size_t)x * 4u + 3u] = 0xFFu;
 }
 
-static inline uint8_t vp8_clip8(int v) {
-	// The (v & ~YUV_MASK2) fast-path is safe: it checks whether v is in [0, 255<<6].
-	if ((v & ~YUV_MASK2) == 0) return (uint8_t)(v >> YUV_FIX2);
-	return (v < 0) ? 0u : 255u;
+// Sets the alpha bytes of a freshly converted RGBA row: the next ALPH row if
+// there is one (unfiltered while the RGBA row is still in cache), else opaque.
+static void finish_rgba_row(uint8_t* row, uint32_t width, WebPAlphaRows* alpha, int premultiply) {
+	const uint8_t* a = alpha ? webp_alpha_next_row(alpha) : NULL;
+	if (a) {
+		webp_alpha_apply_row(row, a, width, premultiply);
+	} else {
+		fill_alpha(row, width);
+	}
 }
 
-static inline void vp8_yuv_to_rgb(uint8_t y, uint8_t u, uint8_t v, uint8_t* dst3) {
-	// These coefficients bake in the (Y-16), (U-128), (V-128) offsets.
-	const int Y = (int)y;
-	const int U = (int)u;
-	const int V = (int)v;
-	const int r = mult_hi(Y, 19077) + mult_hi(V, 26149) - 14234;
-	const int g = mult_hi(Y, 19077) - mult_hi(U, 6419) - mult_hi(V, 13320) + 8708;
-	const int b = mult_hi(Y, 19077) + mult_hi(U, 33050) - 17685;
-	dst3[0] = vp8_clip8(r);
-	dst3[1] = vp8_clip8(g);
-	dst3[2] = vp8_clip8(b);
+// Upsamples row `y` of the image into top_dst like libwebp's fancy upsampler:
+// row 0 alone, then the pairs (1,2), (3,4), ... with row y+1 going to
+// bottom_dst. Returns the row after the last one converted.
+static uint32_t upsample_rows(const Vp8Dsp* dsp, const Yuv420Image* img, uint32_t y, uint8_t* top_dst,
+                              uint8_t* bottom_dst, uint32_t bpp) {
+	if (y == 0) {
+		// Row 0 is special-cased: mirror the chroma samples at boundary.
+		dsp->upsample_rgb_line_pair(img->y, NULL, img->u, img->v, img->u, img->v, top_dst, NULL, img->width, bpp);
+		return 1u;
+	}
+	const uint32_t ch = (img->height + 1u) >> 1;
+	const uint8_t* top_y = img->y + (size_t)y * img->stride_y;
+	const uint8_t* bottom_y = (y + 1u < img->height) ? (img->y + (size_t)(y + 1u) * img->stride_y) : NULL;
+
+	const uint32_t top_cy = y >> 1;
+	const uint32_t cur_cy = (top_cy + 1u < ch) ? (top_cy + 1u) : (ch - 1u);
+	const uint8_t* top_u = img->u + (size_t)top_cy * img->stride_uv;
+	const uint8_t* top_v = img->v + (size_t)top_cy * img->stride_uv;
+	const uint8_t* cur_u = img->u + (size_t)cur_cy * img->stride_uv;
+	const uint8_t* cur_v = img->v + (size_t)cur_cy * img->stride_uv;
+
+	dsp->upsample_rgb_line_pair(top_y, bottom_y, top_u, top_v, cur_u, cur_v, top_dst, bottom_y ? bottom_dst : NULL,
+	                            img->width, bpp);
+	return bottom_y ? y + 2u : y + 1u;
 }
 
-// Fancy 4:2:0 upsampler (matches libwebp's DSP path):
-// Given chroma samples laid out as:
-//   [a b]
-//   [c d]
-// it interpolates the 2x2 luma chroma values as:
-//   top:    ([9a+3b+3c+1d, 3a+9b+3c+1d] + 8) / 16
-//   bottom: ([3a+1b+9c+3d, 1a+3b+3c+9d] + 8) / 16
-static void upsample_rgb_line_pair(const uint8_t* top_y, const uint8_t* bottom_y, const uint8_t* top_u,
-							   const uint8_t* top_v, const uint8_t* cur_u, const uint8_t* cur_v,
-							   uint8_t* top_dst, uint8_t* bottom_dst, uint32_t len) {
-	if (len == 0) return;
-
-	const uint32_t last_pixel_pair = (len - 1u) >> 1;
-	uint32_t tl_u = top_u[0];
-	uint32_t tl_v = top_v[0];
-	uint32_t l_u = cur_u[0];
-	uint32_t l_v = cur_v[0];
-
-	{
-		const uint8_t u0 = (uint8_t)((3u * tl_u + l_u + 2u) >> 2);
-		const uint8_t v0 = (uint8_t)((3u * tl_v + l_v + 2u) >> 2);
-		vp8_yuv_to_rgb(top_y[0], u0, v0, top_dst + 0);
-	}
-	if (bottom_y != NULL) {
-		const uint8_t u0 = (uint8_t)((3u * l_u + tl_u + 2u) >> 2);
-		const uint8_t v0 = (uint8_t)((3u * l_v + tl_v + 2u) >> 2);
-		vp8_yuv_to_rgb(bottom_y[0], u0, v0, bottom_dst + 0);
-	}
-
-	for (uint32_t x = 1; x <= last_pixel_pair; ++x) {
-		const uint32_t t_u = top_u[x];
-		const uint32_t t_v = top_v[x];
-		const uint32_t u = cur_u[x];
-		const uint32_t v = cur_v[x];
-
-		const uint32_t avg_u = tl_u + t_u + l_u + u + 8u;
-		const uint32_t avg_v = tl_v + t_v + l_v + v + 8u;
-		const uint32_t diag_12_u = (avg_u + 2u * (t_u + l_u)) >> 3;
-		const uint32_t diag_12_v = (avg_v + 2u * (t_v + l_v)) >> 3;
-		const uint32_t diag_03_u = (avg_u + 2u * (tl_u + u)) >> 3;
-		const uint32_t diag_03_v = (avg_v + 2u * (tl_v + v)) >> 3;
-
-		{
-			const uint8_t u0 = (uint8_t)((diag_12_u + tl_u) >> 1);
-			const uint8_t v0 = (uint8_t)((diag_12_v + tl_v) >> 1);
-			const uint8_t u1 = (uint8_t)((diag_03_u + t_u) >> 1);
-			const uint8_t v1 = (uint8_t)((diag_03_v + t_v) >> 1);
-			vp8_yuv_to_rgb(top_y[2u * x - 1u], u0, v0, top_dst + (2u * x - 1u) * 3u);
-			vp8_yuv_to_rgb(top_y[2u * x + 0u], u1, v1, top_dst + (2u * x + 0u) * 3u);
-		}
-		if (bottom_y != NULL) {
-			const uint8_t u0 = (uint8_t)((diag_03_u + l_u) >> 1);
-			const uint8_t v0 = (uint8_t)((diag_03_v + l_v) >> 1);
-			const uint8_t u1 = (uint8_t)((diag_12_u + u) >> 1);
-			const uint8_t v1 = (uint8_t)((diag_12_v + v) >> 1);
-			vp8_yuv_to_rgb(bottom_y[2u * x - 1u], u0, v0, bottom_dst + (2u * x - 1u) * 3u);
-			vp8_yuv_to_rgb(bottom_y[2u * x + 0u], u1, v1, bottom_dst + (2u * x + 0u) * 3u);
-		}
-
-		tl_u = t_u;
-		tl_v = t_v;
-		l_u = u;
-		l_v = v;
+// Resolves the output rectangle (NULL: the whole image). Returns -1 if it does not fit.
+static int output_rect(const Yuv420Image* img, const Vp8Rect* rect, Vp8Rect* out) {
+	if (!img || !img->y || !img->u || !img->v || img->width == 0 || img->height == 0) {
+		errno = EINVAL;
+		return -1;
 	}
-
-	if ((len & 1u) == 0u) {
-		const uint32_t idx = len - 1u;
-		{
-			const uint8_t u0 = (uint8_t)((3u * tl_u + l_u + 2u) >> 2);
-			const uint8_t v0 = (uint8_t)((3u * tl_v + l_v + 2u) >> 2);
-			vp8_yuv_to_rgb(top_y[idx], u0, v0, top_dst + idx * 3u);
-		}
-		if (bottom_y != NULL) {
-			const uint8_t u0 = (uint8_t)((3u * l_u + tl_u + 2u) >> 2);
-			const uint8_t v0 = (uint8_t)((3u * l_v + tl_v + 2u) >> 2);
-			vp8_yuv_to_rgb(bottom_y[idx], u0, v0, bottom_dst + idx * 3u);
-		}
+	if (!rect) {
+		*out = (Vp8Rect){0, 0, img->width, img->height};
+		return 0;
 	}
-}
-
-int yuv420_write_ppm_fd(int fd, const Yuv420Image* img) {
-	if (fd < 0 || !img || !img->y || !img->u || !img->v) {
+	if (rect->width == 0 || rect->height == 0 || rect->x >= img->width || rect->y >= img->height ||
+	    rect->width > img->width - rect->x || rect->height > img->height - rect->y) {
 		errno = EINVAL;
 		return -1;
 	}
-	if (img->width == 0 || img->height == 0) {
+	*out = *rect;
+	return 0;
+}
+
+void yuv420_rgb_window(const Vp8Rect* crop, uint32_t width, uint32_t height, Vp8Rect* window) {
+	// The upsampler gets the first/last pixel of a row (and row 0) wrong without
+	// the neighbours beyond them, so keep one more pixel on each side; the
+	// window origin stays even to keep the chroma planes aligned.
+	const uint32_t x0 = crop->x ? ((crop->x - 1u) & ~1u) : 0u;
+	const uint32_t y0 = crop->y ? ((crop->y - 1u) & ~1u) : 0u;
+	const uint32_t x1 = (crop->x + crop->width < width) ? crop->x + crop->width + 1u : width;
+	const uint32_t y1 = (crop->y + crop->height < height) ? crop->y + crop->height + 1u : height;
+	*window = (Vp8Rect){x0, y0, x1 - x0, y1 - y0};
+}
+
+// P6 (RGB) or, with `pam`, P7 RGB_ALPHA rows taking alpha from `alpha` (NULL: opaque).
+static int write_pnm(OsWriter* w, const Yuv420Image* img, const Vp8Rect* rect, WebPAlphaRows* alpha, int pam) {
+	Vp8Rect r;
+	if (!w || output_rect(img, rect, &r) != 0) {
 		errno = EINVAL;
 		return -1;
 	}
 
+	char header[96];
+	size_t header_len;
 #ifdef NO_LIBC
 	// Avoid stdio/snprintf in the no-libc build.
-	if (os_write_all(fd, "P6\n", 3) != 0) return -1;
-	fmt_write_u32(fd, img->width);
-	if (os_write_all(fd, " ", 1) != 0) return -1;
-	fmt_write_u32(fd, img->height);
-	if (os_write_all(fd, "\n255\n", 5) != 0) return -1;
+	if (pam) {
+		memcpy(header, "P7\nWIDTH ", 9);
+		header_len = 9;
+	} else {
+		memcpy(header, "P6\n", 3);
+		header_len = 3;
+	}
+	header_len += fmt_format_u64(header + header_len, r.width);
+	if (pam) {
+		memcpy(header + header_len, "\nHEIGHT ", 8);
+		header_len += 8;
+	} else {
+		header[header_len++] = ' ';
+	}
+	header_len += fmt_format_u64(header + header_len, r.height);
+	if (pam) {
+		static const char tail[] = "\nDEPTH 4\nMAXVAL 255\nTUPLTYPE RGB_ALPHA\nENDHDR\n";
+		memcpy(header + header_len, tail, sizeof(tail) - 1u);
+		header_len += sizeof(tail) - 1u;
+	} else {
+		memcpy(header + header_len, "\n255\n", 5);
+		header_len += 5;
+	}
 #else
-	char header[64];
-	int n = snprintf(header, sizeof(header), "P6\n%u %u\n255\n", img->width, img->height);
+	int n = pam ? snprintf(header, sizeof(header),
+	                       "P7\nWIDTH %u\nHEIGHT %u\nDEPTH 4\nMAXVAL 255\nTUPLTYPE RGB_ALPHA\nENDHDR\n", r.width,
+	                       r.height)
+	            : snprintf(header, sizeof(header), "P6\n%u %u\n255\n", r.width, r.height);
 	if (n <= 0 || (size_t)n >= sizeof(header)) {
 		errno = EINVAL;
 		return -1;
 	}
-	if (os_write_all(fd, header, (size_t)n) != 0) return -1;
+	header_len = (size_t)n;
 #endif
 
-	uint8_t* top_row = (uint8_t*)malloc((size_t)img->width * 3u);
-	uint8_t* bottom_row = (uint8_t*)malloc((size_t)img->width * 3u);
-	if (!top_row || !bottom_row) {
-		free(top_row);
-		free(bottom_row);
+	(void)dec_timing_switch(DEC_STAGE_COLOR);
+
+	const uint32_t bpp = pam ? 4u : 3u;
+	const size_t row_bytes = (size_t)r.width * bpp;
+	if (os_writer_reserve(w, (uint64_t)header_len + (uint64_t)row_bytes * r.height) != 0) return -1;
+	if (os_writer_write(w, header, header_len) != 0) return -1;
+
+	uint8_t* rows[2] = {(uint8_t*)malloc((size_t)img->width * bpp), (uint8_t*)malloc((size_t)img->width * bpp)};
+	if (!rows[0] || !rows[1]) {
+		free(rows[0]);
+		free(rows[1]);
 		errno = ENOMEM;
 		return -1;
 	}
 
-	const uint32_t cw = (img->width + 1u) >> 1;
-	const uint32_t ch = (img->height + 1u) >> 1;
-	(void)cw;
-
-	// Row 0 is special-cased: mirror the chroma samples at boundary.
-	{
-		const uint8_t* y0 = img->y;
-		const uint8_t* u0 = img->u;
-		const uint8_t* v0 = img->v;
-		upsample_rgb_line_pair(y0, NULL, u0, v0, u0, v0, top_row, NULL, img->width);
-		if (os_write_all(fd, top_row, (size_t)img->width * 3u) != 0) {
-			free(top_row);
-			free(bottom_row);
-			return -1;
+	// Rows below the rectangle are never converted.
+	const Vp8Dsp* dsp = vp8_dsp();
+	const uint32_t y_end = r.y + r.height;
+	int rc = 0;
+	for (uint32_t y = 0; y < y_end && rc == 0;) {
+		const uint32_t next = upsample_rows(dsp, img, y, rows[0], rows[1], bpp);
+		for (uint32_t i = y; i < next && i < y_end && rc == 0; i++) {
+			if (i < r.y) continue;
+			uint8_t* p = rows[i - y] + (size_t)r.x * bpp;
+			if (pam) finish_rgba_row(p, r.width, alpha, 0);
+			rc = os_writer_write(w, p, row_bytes);
 		}
+		y = next;
 	}
 
-	// Process pairs of rows (1,2), (3,4), ... like libwebp's fancy upsampler.
-	for (uint32_t y = 1; y < img->height; y += 2u) {
-		const uint8_t* top_y = img->y + (size_t)y * img->stride_y;
-		const uint8_t* bottom_y = (y + 1u < img->height) ? (img->y + (size_t)(y + 1u) * img->stride_y) : NULL;
+	free(rows[0]);
+	free(rows[1]);
+	return rc;
+}
+
+int yuv420_write_ppm(OsWriter* w, const Yuv420Image* img) { return write_pnm(w, img, NULL, NULL, 0); }
+
+int yuv420_write_ppm_rect(OsWriter* w, const Yuv420Image* img, const Vp8Rect* rect) {
+	return write_pnm(w, img, rect, NULL, 0);
+}
 
-		const uint32_t top_cy = y >> 1;
-		const uint32_t cur_cy = (top_cy + 1u < ch) ? (top_cy + 1u) : (ch - 1u);
-		const uint8_t* top_u = img->u + (size_t)top_cy * img->stride_uv;
-		const uint8_t* top_v = img->v + (size_t)top_cy * img->stride_uv;
-		const uint8_t* cur_u = img->u + (size_t)cur_cy * img->stride_uv;
-		const uint8_t* cur_v = img->v + (size_t)cur_cy * img->stride_uv;
+int yuv420_write_pam(OsWriter* w, const Yuv420Image* img, const Vp8Rect* rect, WebPAlphaRows* alpha) {
+	return write_pnm(w, img, rect, alpha, 1);
+}
+
+int yuv420_write_ppm_fd(int fd, const Yuv420Image* img) {
+	if (fd < 0) {
+		errno = EINVAL;
+		return -1;
+	}
+	OsWriter w;
+	os_writer_init(&w, fd, 0, 0);
+	int rc = yuv420_write_ppm(&w, img);
+	if (os_writer_close(&w) != 0) rc = -1;
+	return rc;
+}
+
+static int convert_rows(const Yuv420Image* img, const Vp8Rect* rect, uint8_t* out, size_t stride,
+                        uint32_t bytes_per_pixel, WebPAlphaRows* alpha, int premultiply) {
+	Vp8Rect r;
+	if (!out || output_rect(img, rect, &r) != 0) {
+		errno = EINVAL;
+		return -1;
+	}
+	if ((bytes_per_pixel != 3u && bytes_per_pixel != 4u) || stride < (size_t)r.width * bytes_per_pixel) {
+		errno = EINVAL;
+		return -1;
+	}
 
-		upsample_rgb_line_pair(top_y, bottom_y, top_u, top_v, cur_u, cur_v, top_row, bottom_row, img->width);
-		if (os_write_all(fd, top_row, (size_t)img->width * 3u) != 0) {
-			free(top_row);
-			free(bottom_row);
+	// Whole images are converted straight into the caller's rows; a rectangle
+	// goes through two scratch rows because the upsampler emits full rows.
+	const int direct = r.x == 0 && r.y == 0 && r.width == img->width && r.height == img->height;
+	uint8_t* scratch[2] = {NULL, NULL};
+	if (!direct) {
+		scratch[0] = (uint8_t*)malloc((size_t)img->width * bytes_per_pixel);
+		scratch[1] = (uint8_t*)malloc((size_t)img->width * bytes_per_pixel);
+		if (!scratch[0] || !scratch[1]) {
+			free(scratch[0]);
+			free(scratch[1]);
+			errno = ENOMEM;
 			return -1;
 		}
-		if (bottom_y != NULL) {
-			if (os_write_all(fd, bottom_row, (size_t)img->width * 3u) != 0) {
-				free(top_row);
-				free(bottom_row);
-				return -1;
-			}
-		}
 	}
 
-	free(top_row);
-	free(bottom_row);
+	// Rows below the rectangle are never converted.
+	const Vp8Dsp* dsp = vp8_dsp();
+	const uint32_t y_end = r.y + r.height;
+	for (uint32_t y = 0; y < y_end;) {
+		uint8_t* dst[2] = {scratch[0], scratch[1]};
+		if (direct) {
+			dst[0] = out + (size_t)y * stride;
+			dst[1] = dst[0] + stride;
+		}
+		const uint32_t next = upsample_rows(dsp, img, y, dst[0], dst[1], bytes_per_pixel);
+		for (uint32_t i = y; i < next && i < y_end; i++) {
+			if (i < r.y) continue;
+			uint8_t* row = out + (size_t)(i - r.y) * stride;
+			if (!direct) memcpy(row, dst[i - y] + (size_t)r.x * bytes_per_pixel, (size_t)r.width * bytes_per_pixel);
+			if (bytes_per_pixel == 4u) finish_rgba_row(row, r.width, alpha, premultiply);
+		}
+		y = next;
+	}
+	free(scratch[0]);
+	free(scratch[1]);
 	return 0;
 }
+
+int yuv420_to_rgb(const Yuv420Image* img, const Vp8Rect* rect, uint8_t* out, size_t stride, uint32_t bytes_per_pixel) {
+	return convert_rows(img, rect, out, stride, bytes_per_pixel, NULL, 0);
+}
+
+int yuv420_to_rgba(const Yuv420Image* img, const Vp8Rect* rect, WebPAlphaRows* alpha, int premultiply, uint8_t* out,
+                   size_t stride) {
+	return convert_rows(img, rect, out, stride, 4u, alpha, premultiply);
+}
@@ -1,10 +1,46 @@
 #pragma once
 
+#include <stddef.h>
 #include <stdint.h>
 
+#include "../common/os.h"
 #include "../m06_recon/vp8_recon.h"
+#include "../m11_alpha/webp_alpha.h"
 
 // Writes a binary PPM (P6) to fd from a YUV420 (I420) image.
 // Conversion uses full-range Rec.601 coefficients.
 // Returns 0 on success.
 int yuv420_write_ppm_fd(int fd, const Yuv420Image* img);
+
+// Same as yuv420_write_ppm_fd(), but appends to an existing writer (the caller
+// flushes/closes it). Calls os_writer_reserve() with the exact file size.
+int yuv420_write_ppm(OsWriter* w, const Yuv420Image* img);
+
+// Writes only the pixels inside `rect` (NULL: the whole image). Rows below it
+// are not converted.
+int yuv420_write_ppm_rect(OsWriter* w, const Yuv420Image* img, const Vp8Rect* rect);
+
+// Writes a PAM (P7, TUPLTYPE RGB_ALPHA) of `rect` (NULL: the whole image) with
+// straight alpha taken row by row from `alpha` (NULL: opaque). For a rectangle,
+// `alpha` must already be positioned with webp_alpha_rows_crop().
+int yuv420_write_pam(OsWriter* w, const Yuv420Image* img, const Vp8Rect* rect, WebPAlphaRows* alpha);
+
+// Converts `rect` of the image (NULL: all of it) to interleaved RGB
+// (bytes_per_pixel=3) or RGBA with alpha=255 (bytes_per_pixel=4) in
+// caller-owned memory; rows are `stride` bytes apart. Uses the same fancy
+// upsampler as the PPM writer, so pixels are identical.
+// Returns 0 on success.
+int yuv420_to_rgb(const Yuv420Image* img, const Vp8Rect* rect, uint8_t* out, size_t stride, uint32_t bytes_per_pixel);
+
+// RGBA variant of yuv420_to_rgb() with alpha from `alpha` (NULL: 255), unfiltered
+// into each row right after it is converted. With `premultiply`, RGB is scaled
+// by alpha (libwebp "rgbA").
+int yuv420_to_rgba(const Yuv420Image* img, const Vp8Rect* rect, WebPAlphaRows* alpha, int premultiply, uint8_t* out,
+                   size_t stride);
+
+// The part of a width x height picture that must be reconstructed so that
+// converting it gives the same RGB for `crop` as converting the whole picture:
+// the upsampler reads one pixel (and chroma sample) beyond each side. The
+// window origin is even, so it can be reconstructed with
+// vp8_reconstruct_keyframe_rect().
+void yuv420_rgb_window(const Vp8Rect* crop, uint32_t width, uint32_t height, Vp8Rect* window);
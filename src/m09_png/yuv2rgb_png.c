@@ -7,12 +7,12 @@
 
 #include <errno.h>
 
+#include "../common/dsp.h"
 #include "../common/os.h"
-
-enum {
-	YUV_FIX2 = 6,
-	YUV_MASK2 = (256 << YUV_FIX2) - 1
-};
+#include "../common/timing.h"
+#ifndef DECODER_ULTRA
+#include "../m11_alpha/webp_alpha.h"
+#endif
 
 #ifdef DECODER_ULTRA
 #define PNG_SET_ERRNO(e) ((void)0)
@@ -20,345 +20,339 @@ enum {
 #define PNG_SET_ERRNO(e) (errno = (e))
 #endif
 
-static inline int mult_hi(int v, int coeff) {
-	return (v * coeff) >> 8;
-}
-
-static inline uint8_t vp8_clip8(int v) {
-	if ((v & ~YUV_MASK2) == 0) return (uint8_t)(v >> YUV_FIX2);
-	return (v < 0) ? 0u : 255u;
-}
-
-static inline void vp8_yuv_to_rgb(uint8_t y, uint8_t u, uint8_t v, uint8_t* dst3) {
-	const int Y = (int)y;
-	const int U = (int)u;
-	const int V = (int)v;
-	const int r = mult_hi(Y, 19077) + mult_hi(V, 26149) - 14234;
-	const int g = mult_hi(Y, 19077) - mult_hi(U, 6419) - mult_hi(V, 13320) + 8708;
-	const int b = mult_hi(Y, 19077) + mult_hi(U, 33050) - 17685;
-	dst3[0] = vp8_clip8(r);
-	dst3[1] = vp8_clip8(g);
-	dst3[2] = vp8_clip8(b);
-}
-
-// Matches libwebp's DSP fancy upsampler (see libwebp src/dsp/upsampling.c).
-static void upsample_rgb_line_pair(const uint8_t* top_y, const uint8_t* bottom_y, const uint8_t* top_u,
-                                   const uint8_t* top_v, const uint8_t* cur_u, const uint8_t* cur_v,
-                                   uint8_t* top_dst, uint8_t* bottom_dst, uint32_t len) {
-	if (len == 0) return;
-
-	const uint32_t last_pixel_pair = (len - 1u) >> 1;
-	uint32_t tl_u = top_u[0];
-	uint32_t tl_v = top_v[0];
-	uint32_t l_u = cur_u[0];
-	uint32_t l_v = cur_v[0];
-
-	{
-		const uint8_t u0 = (uint8_t)((3u * tl_u + l_u + 2u) >> 2);
-		const uint8_t v0 = (uint8_t)((3u * tl_v + l_v + 2u) >> 2);
-		vp8_yuv_to_rgb(top_y[0], u0, v0, top_dst + 0);
-	}
-	if (bottom_y != NULL) {
-		const uint8_t u0 = (uint8_t)((3u * l_u + tl_u + 2u) >> 2);
-		const uint8_t v0 = (uint8_t)((3u * l_v + tl_v + 2u) >> 2);
-		vp8_yuv_to_rgb(bottom_y[0], u0, v0, bottom_dst + 0);
-	}
-
-	for (uint32_t x = 1; x <= last_pixel_pair; ++x) {
-		const uint32_t t_u = top_u[x];
-		const uint32_t t_v = top_v[x];
-		const uint32_t u = cur_u[x];
-		const uint32_t v = cur_v[x];
-
-		const uint32_t avg_u = tl_u + t_u + l_u + u + 8u;
-		const uint32_t avg_v = tl_v + t_v + l_v + v + 8u;
-		const uint32_t diag_12_u = (avg_u + 2u * (t_u + l_u)) >> 3;
-		const uint32_t diag_12_v = (avg_v + 2u * (t_v + l_v)) >> 3;
-		const uint32_t diag_03_u = (avg_u + 2u * (tl_u + u)) >> 3;
-		const uint32_t diag_03_v = (avg_v + 2u * (tl_v + v)) >> 3;
-
-		{
-			const uint8_t u0 = (uint8_t)((diag_12_u + tl_u) >> 1);
-			const uint8_t v0 = (uint8_t)((diag_12_v + tl_v) >> 1);
-			const uint8_t u1 = (uint8_t)((diag_03_u + t_u) >> 1);
-			const uint8_t v1 = (uint8_t)((diag_03_v + t_v) >> 1);
-			vp8_yuv_to_rgb(top_y[2u * x - 1u], u0, v0, top_dst + (2u * x - 1u) * 3u);
-			vp8_yuv_to_rgb(top_y[2u * x + 0u], u1, v1, top_dst + (2u * x + 0u) * 3u);
-		}
-		if (bottom_y != NULL) {
-			const uint8_t u0 = (uint8_t)((diag_03_u + l_u) >> 1);
-			const uint8_t v0 = (uint8_t)((diag_03_v + l_v) >> 1);
-			const uint8_t u1 = (uint8_t)((diag_12_u + u) >> 1);
-			const uint8_t v1 = (uint8_t)((diag_12_v + v) >> 1);
-			vp8_yuv_to_rgb(bottom_y[2u * x - 1u], u0, v0, bottom_dst + (2u * x - 1u) * 3u);
-			vp8_yuv_to_rgb(bottom_y[2u * x + 0u], u1, v1, bottom_dst + (2u * x + 0u) * 3u);
-		}
-
-		tl_u = t_u;
-		tl_v = t_v;
-		l_u = u;
-		l_v = v;
-	}
-
-	if ((len & 1u) == 0u) {
-		const uint32_t idx = len - 1u;
-		{
-			const uint8_t u0 = (uint8_t)((3u * tl_u + l_u + 2u) >> 2);
-			const uint8_t v0 = (uint8_t)((3u * tl_v + l_v + 2u) >> 2);
-			vp8_yuv_to_rgb(top_y[idx], u0, v0, top_dst + idx * 3u);
-		}
-		if (bottom_y != NULL) {
-			const uint8_t u0 = (uint8_t)((3u * l_u + tl_u + 2u) >> 2);
-			const uint8_t v0 = (uint8_t)((3u * l_v + tl_v + 2u) >> 2);
-			vp8_yuv_to_rgb(bottom_y[idx], u0, v0, bottom_dst + idx * 3u);
-		}
-	}
-}
-
 static inline uint32_t be32(uint32_t x) {
 	return ((x & 0x000000FFu) << 24) | ((x & 0x0000FF00u) << 8) | ((x & 0x00FF0000u) >> 8) | ((x & 0xFF000000u) >> 24);
 }
 
-static uint32_t crc32_update(uint32_t crc, const uint8_t* buf, size_t len) {
-	crc ^= 0xFFFFFFFFu;
-	for (size_t i = 0; i < len; i++) {
-		crc ^= buf[i];
-		for (int k = 0; k < 8; k++) {
-			crc = (crc & 1u) ? (0xEDB88320u ^ (crc >> 1)) : (crc >> 1);
-		}
-	}
-	return crc ^ 0xFFFFFFFFu;
-}
-
-static int write_chunk(int fd, const char type[4], const uint8_t* data, uint32_t len) {
+static int write_chunk(OsWriter* w, const char type[4], const uint8_t* data, uint32_t len) {
 	uint8_t hdr[8];
 	uint32_t len_be = be32(len);
 	memcpy(hdr + 0, &len_be, 4);
 	memcpy(hdr + 4, type, 4);
-	if (os_write_all(fd, hdr, sizeof(hdr)) != 0) return -1;
-	if (len != 0 && os_write_all(fd, data, len) != 0) return -1;
+	if (os_writer_write(w, hdr, sizeof(hdr)) != 0) return -1;
+	if (len != 0 && os_writer_write(w, data, len) != 0) return -1;
 	uint32_t crc = 0;
-	crc = crc32_update(crc, (const uint8_t*)type, 4);
-	if (len != 0) crc = crc32_update(crc, data, len);
+	crc = vp8_dsp()->crc32_update(crc, (const uint8_t*)type, 4);
+	if (len != 0) crc = vp8_dsp()->crc32_update(crc, data, len);
 	uint32_t crc_be = be32(crc);
-	if (os_write_all(fd, &crc_be, 4) != 0) return -1;
+	if (os_writer_write(w, &crc_be, 4) != 0) return -1;
 	return 0;
 }
 
-static inline void adler32_update(uint32_t* a, uint32_t* b, const uint8_t* buf, size_t len) {
-	// Adler-32 modulo.
-	const uint32_t MOD = 65521u;
-	uint32_t aa = *a;
-	uint32_t bb = *b;
-	for (size_t i = 0; i < len; i++) {
-		aa += buf[i];
-		if (aa >= MOD) aa -= MOD;
-		bb += aa;
-		bb %= MOD;
-	}
-	*a = aa;
-	*b = bb;
-}
+// Produces the PNG rows top to bottom: each fill() writes the next row
+// (width * channels bytes) to dst.
+typedef struct PngRows PngRows;
+struct PngRows {
+	int (*fill)(PngRows* rows, uint8_t* dst);
+};
 
 typedef struct {
+	PngRows base;
 	const Yuv420Image* img;
 	uint8_t* top_row;
 	uint8_t* bottom_row;
-	uint8_t* scanline;
-	uint32_t row_bytes;
-	uint32_t scanline_bytes;
-	uint32_t y;
+	uint32_t row_bytes; // bytes emitted per row
+	uint32_t channels;  // 3, or 4 with alpha
+	uint32_t y;         // rows converted so far
 	int have_cached_bottom;
+#ifndef DECODER_ULTRA
+	WebPAlphaRows* alpha; // RGBA rows take their A bytes from here
+	uint32_t first_row;   // rows above this one are converted but not emitted
+	uint32_t x_offset;    // bytes skipped at the start of each row
+#endif
 } PngRgbGen;
 
-static int png_fill_scanline(PngRgbGen* g) {
-	g->scanline[0] = 0; // filter type 0
-	if (g->y == 0) {
+// Returns 0 after copying a finished row (and merging the next alpha row into it).
+static int png_emit_row(PngRgbGen* g, uint8_t* dst, const uint8_t* row) {
+#ifndef DECODER_ULTRA
+	row += g->x_offset;
+#endif
+	memcpy(dst, row, g->row_bytes);
+#ifndef DECODER_ULTRA
+	if (g->alpha) {
+		const uint8_t* a = webp_alpha_next_row(g->alpha);
+		if (!a) return -1;
+		webp_alpha_apply_row(dst, a, g->row_bytes / 4u, 0);
+	}
+#endif
+	return 0;
+}
+
+// Converts the next image row and returns it (full image width).
+static const uint8_t* png_next_yuv_row(PngRgbGen* g) {
+	const uint32_t y = g->y++;
+	if (y == 0) {
 		const uint8_t* y0 = g->img->y;
 		const uint8_t* u0 = g->img->u;
 		const uint8_t* v0 = g->img->v;
-		upsample_rgb_line_pair(y0, NULL, u0, v0, u0, v0, g->top_row, NULL, g->img->width);
-		memcpy(g->scanline + 1, g->top_row, g->row_bytes);
-		return 0;
+		vp8_dsp()->upsample_rgb_line_pair(y0, NULL, u0, v0, u0, v0, g->top_row, NULL, g->img->width, g->channels);
+		return g->top_row;
 	}
 	if (g->have_cached_bottom) {
-		memcpy(g->scanline + 1, g->bottom_row, g->row_bytes);
 		g->have_cached_bottom = 0;
-		return 0;
+		return g->bottom_row;
 	}
 
-	const uint8_t* top_y_ptr = g->img->y + (size_t)g->y * g->img->stride_y;
-	const uint8_t* bottom_y_ptr = (g->y + 1u < g->img->height)
-	                               ? (g->img->y + (size_t)(g->y + 1u) * g->img->stride_y)
+	const uint8_t* top_y_ptr = g->img->y + (size_t)y * g->img->stride_y;
+	const uint8_t* bottom_y_ptr = (y + 1u < g->img->height)
+	                               ? (g->img->y + (size_t)(y + 1u) * g->img->stride_y)
 	                               : NULL;
 	const uint32_t ch = (g->img->height + 1u) >> 1;
-	const uint32_t top_cy = g->y >> 1;
+	const uint32_t top_cy = y >> 1;
 	const uint32_t cur_cy = (top_cy + 1u < ch) ? (top_cy + 1u) : (ch - 1u);
 	const uint8_t* top_u = g->img->u + (size_t)top_cy * g->img->stride_uv;
 	const uint8_t* top_v = g->img->v + (size_t)top_cy * g->img->stride_uv;
 	const uint8_t* cur_u = g->img->u + (size_t)cur_cy * g->img->stride_uv;
 	const uint8_t* cur_v = g->img->v + (size_t)cur_cy * g->img->stride_uv;
 
-	upsample_rgb_line_pair(top_y_ptr, bottom_y_ptr, top_u, top_v, cur_u, cur_v, g->top_row, g->bottom_row, g->img->width);
-	memcpy(g->scanline + 1, g->top_row, g->row_bytes);
+	vp8_dsp()->upsample_rgb_line_pair(top_y_ptr, bottom_y_ptr, top_u, top_v, cur_u, cur_v, g->top_row, g->bottom_row,
+	                                  g->img->width, g->channels);
 	if (bottom_y_ptr != NULL) g->have_cached_bottom = 1;
+	return g->top_row;
+}
+
+static int png_fill_yuv_row(PngRows* rows, uint8_t* dst) {
+	PngRgbGen* g = (PngRgbGen*)rows;
+	const uint8_t* row = png_next_yuv_row(g);
+#ifndef DECODER_ULTRA
+	while (g->y <= g->first_row) row = png_next_yuv_row(g);
+#endif
+	return png_emit_row(g, dst, row);
+}
+
+typedef struct {
+	PngRows base;
+	const uint8_t* next;
+	size_t stride;
+	uint32_t row_bytes;
+} PngPixelRows;
+
+static int png_fill_pixel_row(PngRows* rows, uint8_t* dst) {
+	PngPixelRows* p = (PngPixelRows*)rows;
+	memcpy(dst, p->next, p->row_bytes);
+	p->next += p->stride;
 	return 0;
 }
 
-int yuv420_write_png_fd(int fd, const Yuv420Image* img) {
-	if (fd < 0 || !img || !img->y || !img->u || !img->v) {
-		PNG_SET_ERRNO(EINVAL);
-		return -1;
-	}
-	if (img->width == 0 || img->height == 0) {
-		PNG_SET_ERRNO(EINVAL);
+// Appends IDAT payload bytes, keeping the chunk CRC running.
+static int idat_emit(OsWriter* w, uint32_t* crc, const uint8_t* data, uint32_t len) {
+	*crc = vp8_dsp()->crc32_update(*crc, data, len);
+	return os_writer_write(w, data, len);
+}
+
+// Writes a whole PNG: color type 2 (channels=3) or 6 (channels=4), 8 bits.
+static int png_write_rows(OsWriter* w, uint32_t width, uint32_t height, uint32_t channels, PngRows* rows) {
+	// The zlib stream uses stored blocks only, so its size is known up front and
+	// the IDAT chunk can be streamed scanline by scanline.
+	const uint64_t row_bytes64 = (uint64_t)width * channels;
+	const uint64_t raw_size64 = (uint64_t)height * (1u + row_bytes64);
+	if (raw_size64 > 0x7FFFFFFFu) {
+		PNG_SET_ERRNO(EFBIG);
 		return -1;
 	}
+	const uint32_t row_bytes = (uint32_t)row_bytes64;
+	const uint32_t scanline_bytes = 1u + row_bytes; // filter byte + pixels
+	const uint32_t raw_size = (uint32_t)raw_size64;
+	const uint32_t blocks = (raw_size + 65535u - 1u) / 65535u;
+	const uint32_t zsize = 2u + raw_size + blocks * 5u + 4u;
+
+	// Everything below is zlib/PNG framing and checksums, except producing the
+	// rows themselves (charged to the color stage).
+	(void)dec_timing_switch(DEC_STAGE_COMPRESS);
+
+	// signature + IHDR + IDAT + IEND
+	if (os_writer_reserve(w, 8u + (12u + 13u) + (12u + (uint64_t)zsize) + 12u) != 0) return -1;
 
 	// PNG signature.
 	static const uint8_t sig[8] = {0x89u, 'P', 'N', 'G', 0x0Du, 0x0Au, 0x1Au, 0x0Au};
-	if (os_write_all(fd, sig, sizeof(sig)) != 0) return -1;
+	if (os_writer_write(w, sig, sizeof(sig)) != 0) return -1;
 
 	// IHDR.
 	uint8_t ihdr[13];
-	uint32_t w_be = be32(img->width);
-	uint32_t h_be = be32(img->height);
+	uint32_t w_be = be32(width);
+	uint32_t h_be = be32(height);
 	memcpy(ihdr + 0, &w_be, 4);
 	memcpy(ihdr + 4, &h_be, 4);
-	ihdr[8] = 8;  // bit depth
-	ihdr[9] = 2;  // color type: truecolor (RGB)
-	ihdr[10] = 0; // compression
-	ihdr[11] = 0; // filter
-	ihdr[12] = 0; // interlace
-	if (write_chunk(fd, "IHDR", ihdr, sizeof(ihdr)) != 0) return -1;
-
-	// Build the zlib stream into memory (raw scanlines are generated on the fly).
-	const uint32_t row_bytes = img->width * 3u;
-	const uint32_t scanline_bytes = 1u + row_bytes; // filter byte + RGB
-	const uint64_t raw_size64 = (uint64_t)img->height * (uint64_t)(1u + row_bytes);
-	if (raw_size64 > 0x7FFFFFFFu) {
-		PNG_SET_ERRNO(EFBIG);
-		return -1;
-	}
-	const uint32_t raw_size = (uint32_t)raw_size64;
-	const uint32_t blocks = (raw_size + 65535u - 1u) / 65535u;
-	const uint64_t zsize64 = 2u + (uint64_t)raw_size + (uint64_t)blocks * 5u + 4u;
-	if (zsize64 > SIZE_MAX) {
-		PNG_SET_ERRNO(ENOMEM);
-		return -1;
-	}
-	uint8_t* z = (uint8_t*)malloc((size_t)zsize64);
-	if (!z) {
-		PNG_SET_ERRNO(ENOMEM);
-		return -1;
-	}
+	ihdr[8] = 8;                                // bit depth
+	ihdr[9] = (channels == 4u) ? 6u : 2u;       // color type: RGBA or RGB
+	ihdr[10] = 0;                               // compression
+	ihdr[11] = 0;                               // filter
+	ihdr[12] = 0;                               // interlace
+	if (write_chunk(w, "IHDR", ihdr, sizeof(ihdr)) != 0) return -1;
+
+	// IDAT (single chunk for simplicity): length + type, then the zlib stream.
+	uint8_t hdr[8];
+	const uint32_t zsize_be = be32(zsize);
+	memcpy(hdr + 0, &zsize_be, 4);
+	memcpy(hdr + 4, "IDAT", 4);
+	if (os_writer_write(w, hdr, sizeof(hdr)) != 0) return -1;
+	uint32_t crc = vp8_dsp()->crc32_update(0, hdr + 4, 4);
 
 	// zlib header: 0x78 0x01 (no compression / fastest).
-	size_t zp = 0;
-	z[zp++] = 0x78u;
-	z[zp++] = 0x01u;
+	static const uint8_t zhdr[2] = {0x78u, 0x01u};
+	if (idat_emit(w, &crc, zhdr, sizeof(zhdr)) != 0) return -1;
 
 	uint32_t ad_a = 1u;
 	uint32_t ad_b = 0u;
 
-	uint8_t* top_row = (uint8_t*)malloc((size_t)row_bytes);
-	uint8_t* bottom_row = (uint8_t*)malloc((size_t)row_bytes);
 	uint8_t* scanline = (uint8_t*)malloc((size_t)scanline_bytes);
-	if (!top_row || !bottom_row || !scanline) {
-		free(top_row);
-		free(bottom_row);
-		free(scanline);
-		free(z);
+	if (!scanline) {
 		PNG_SET_ERRNO(ENOMEM);
 		return -1;
 	}
+	scanline[0] = 0; // filter type 0
 
 	// Generate raw scanline stream and pack into stored DEFLATE blocks.
 	uint32_t remaining = raw_size;
-	PngRgbGen gen = {
-		.img = img,
-		.top_row = top_row,
-		.bottom_row = bottom_row,
-		.scanline = scanline,
-		.row_bytes = row_bytes,
-		.scanline_bytes = scanline_bytes,
-		.y = 0,
-		.have_cached_bottom = 0,
-	};
+	uint32_t rows_done = 0;
 	uint32_t scanline_pos = 0;
+	int rc = 0;
 
-	while (remaining > 0) {
+	while (remaining > 0 && rc == 0) {
 		const uint32_t len = (remaining > 65535u) ? 65535u : remaining;
-		const uint8_t bfinal = (remaining <= 65535u) ? 1u : 0u;
-		z[zp++] = bfinal; // BFINAL + BTYPE=00
-		z[zp++] = (uint8_t)(len & 0xFFu);
-		z[zp++] = (uint8_t)((len >> 8) & 0xFFu);
 		const uint16_t nlen = (uint16_t)~(uint16_t)len;
-		z[zp++] = (uint8_t)(nlen & 0xFFu);
-		z[zp++] = (uint8_t)((nlen >> 8) & 0xFFu);
+		uint8_t bhdr[5];
+		bhdr[0] = (remaining <= 65535u) ? 1u : 0u; // BFINAL + BTYPE=00
+		bhdr[1] = (uint8_t)(len & 0xFFu);
+		bhdr[2] = (uint8_t)((len >> 8) & 0xFFu);
+		bhdr[3] = (uint8_t)(nlen & 0xFFu);
+		bhdr[4] = (uint8_t)((nlen >> 8) & 0xFFu);
+		if (idat_emit(w, &crc, bhdr, sizeof(bhdr)) != 0) {
+			rc = -1;
+			break;
+		}
 
 		uint32_t produced = 0;
 		while (produced < len) {
-			if (gen.y >= img->height) {
+			if (rows_done >= height) {
 				// Should not happen if raw_size is correct.
-				free(top_row);
-				free(bottom_row);
-				free(scanline);
-				free(z);
 				PNG_SET_ERRNO(EINVAL);
-				return -1;
+				rc = -1;
+				break;
 			}
 
 			if (scanline_pos == 0) {
-				if (png_fill_scanline(&gen) != 0) {
-					free(top_row);
-					free(bottom_row);
-					free(scanline);
-					free(z);
+				const DecStage prev = dec_timing_switch(DEC_STAGE_COLOR);
+				const int fill_rc = rows->fill(rows, scanline + 1);
+				(void)dec_timing_switch(prev);
+				if (fill_rc != 0) {
 					PNG_SET_ERRNO(EINVAL);
-					return -1;
+					rc = -1;
+					break;
 				}
 			}
 			const uint32_t avail = scanline_bytes - scanline_pos;
 			const uint32_t need = len - produced;
 			const uint32_t take = (avail < need) ? avail : need;
-			memcpy(z + zp, scanline + scanline_pos, take);
-			adler32_update(&ad_a, &ad_b, scanline + scanline_pos, take);
-			zp += take;
+			if (idat_emit(w, &crc, scanline + scanline_pos, take) != 0) {
+				rc = -1;
+				break;
+			}
+			vp8_dsp()->adler32_update(&ad_a, &ad_b, scanline + scanline_pos, take);
 			produced += take;
 			scanline_pos += take;
 			if (scanline_pos == scanline_bytes) {
 				scanline_pos = 0;
-				gen.y += 1;
+				rows_done += 1;
 			}
 		}
 
 		remaining -= len;
 	}
 
-	free(top_row);
-	free(bottom_row);
 	free(scanline);
+	if (rc != 0) return -1;
 
-	// Adler-32 (big-endian)
-	const uint32_t adler = (ad_b << 16) | ad_a;
-	const uint32_t adler_be = be32(adler);
-	memcpy(z + zp, &adler_be, 4);
-	zp += 4;
+	// Adler-32 (big-endian), then the IDAT CRC.
+	const uint32_t adler_be = be32((ad_b << 16) | ad_a);
+	if (idat_emit(w, &crc, (const uint8_t*)&adler_be, 4) != 0) return -1;
+	const uint32_t crc_be = be32(crc);
+	if (os_writer_write(w, &crc_be, 4) != 0) return -1;
 
-	// IDAT (single chunk for simplicity).
-	if (zp > 0xFFFFFFFFu) {
-		free(z);
-		PNG_SET_ERRNO(EFBIG);
+	// IEND
+	if (write_chunk(w, "IEND", NULL, 0) != 0) return -1;
+	return 0;
+}
+
+#ifdef DECODER_ULTRA
+int yuv420_write_png(OsWriter* w, const Yuv420Image* img) {
+#else
+int yuv420_write_png(OsWriter* w, const Yuv420Image* img) { return yuv420_write_png_alpha(w, img, NULL, NULL); }
+
+int yuv420_write_png_alpha(OsWriter* w, const Yuv420Image* img, const Vp8Rect* rect, WebPAlphaRows* alpha) {
+#endif
+	if (!w || !img || !img->y || !img->u || !img->v) {
+		PNG_SET_ERRNO(EINVAL);
 		return -1;
 	}
-	if (write_chunk(fd, "IDAT", z, (uint32_t)zp) != 0) {
-		free(z);
+	if (img->width == 0 || img->height == 0) {
+		PNG_SET_ERRNO(EINVAL);
 		return -1;
 	}
-	free(z);
 
-	// IEND
-	if (write_chunk(fd, "IEND", NULL, 0) != 0) return -1;
-	return 0;
+#ifdef DECODER_ULTRA
+	const uint32_t channels = 3u;
+	const Vp8Rect r = {0, 0, img->width, img->height};
+#else
+	const uint32_t channels = alpha ? 4u : 3u;
+	const Vp8Rect r = rect ? *rect : (Vp8Rect){0, 0, img->width, img->height};
+	if (r.width == 0 || r.height == 0 || r.x >= img->width || r.y >= img->height || r.width > img->width - r.x ||
+	    r.height > img->height - r.y) {
+		PNG_SET_ERRNO(EINVAL);
+		return -1;
+	}
+#endif
+	const uint32_t row_bytes = img->width * channels;
+	PngRgbGen gen = {
+		.base = {png_fill_yuv_row},
+		.img = img,
+		.top_row = (uint8_t*)malloc((size_t)row_bytes),
+		.bottom_row = (uint8_t*)malloc((size_t)row_bytes),
+		.row_bytes = r.width * channels,
+		.channels = channels,
+		.y = 0,
+		.have_cached_bottom = 0,
+#ifndef DECODER_ULTRA
+		.alpha = alpha,
+		.first_row = r.y,
+		.x_offset = r.x * channels,
+#endif
+	};
+	int rc = -1;
+	if (gen.top_row && gen.bottom_row) {
+		rc = png_write_rows(w, r.width, r.height, channels, &gen.base);
+	} else {
+		PNG_SET_ERRNO(ENOMEM);
+	}
+	free(gen.top_row);
+	free(gen.bottom_row);
+	return rc;
+}
+
+int png_write_pixels(OsWriter* w, const uint8_t* pixels, uint32_t width, uint32_t height, size_t stride,
+                     uint32_t channels) {
+	if (!w || !pixels || width == 0 || height == 0 || (channels != 3u && channels != 4u) ||
+	    stride < (size_t)width * channels) {
+		PNG_SET_ERRNO(EINVAL);
+		return -1;
+	}
+	PngPixelRows rows = {
+		.base = {png_fill_pixel_row},
+		.next = pixels,
+		.stride = stride,
+		.row_bytes = width * channels,
+	};
+	return png_write_rows(w, width, height, channels, &rows.base);
+}
+
+int yuv420_write_png_fd(int fd, const Yuv420Image* img) {
+	if (fd < 0) {
+		PNG_SET_ERRNO(EINVAL);
+		return -1;
+	}
+	OsWriter w;
+	os_writer_init(&w, fd, 0, 0);
+	int rc = yuv420_write_png(&w, img);
+	if (os_writer_close(&w) != 0) rc = -1;
+	return rc;
 }
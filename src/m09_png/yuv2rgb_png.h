@@ -2,9 +2,31 @@
 
 #include <stdint.h>
 
+#include "../common/os.h"
 #include "../m06_recon/vp8_recon.h"
+#ifndef DECODER_ULTRA
+#include "../m11_alpha/webp_alpha.h"
+#endif
 
 // Writes an RGB PNG (IHDR color_type=2, bit_depth=8) to fd from a YUV420 (I420) image.
 // Encoding uses filter type 0 for every scanline and zlib/DEFLATE with stored (uncompressed) blocks.
 // Returns 0 on success.
 int yuv420_write_png_fd(int fd, const Yuv420Image* img);
+
+// Same as yuv420_write_png_fd(), but appends to an existing writer (the caller
+// flushes/closes it). The IDAT chunk is streamed; no full-image buffer is built.
+int yuv420_write_png(OsWriter* w, const Yuv420Image* img);
+
+#ifndef DECODER_ULTRA
+// Same as yuv420_write_png(), but writes only `rect` (NULL: the whole image)
+// and, with `alpha` (non-NULL), an RGBA PNG (color_type=6) whose A bytes are
+// unfiltered into each row as it is produced. Rows below `rect` are not
+// converted; `alpha` must already be positioned with webp_alpha_rows_crop().
+int yuv420_write_png_alpha(OsWriter* w, const Yuv420Image* img, const Vp8Rect* rect, WebPAlphaRows* alpha);
+#endif
+
+// Writes an 8-bit RGB (channels=3, color_type=2) or RGBA (channels=4,
+// color_type=6) PNG from interleaved pixels; rows are `stride` bytes apart.
+// Same stored-block encoding as yuv420_write_png().
+int png_write_pixels(OsWriter* w, const uint8_t* pixels, uint32_t width, uint32_t height, size_t stride,
+                     uint32_t channels);
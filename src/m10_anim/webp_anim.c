@@ -0,0 +1,282 @@
+#include "webp_anim.h"
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../common/threads.h"
+#include "../m02_vp8_header/vp8_header.h"
+#include "../m05_tokens/vp8_tokens.h"
+#include "../m08_yuv2rgb_ppm/yuv2rgb_ppm.h"
+#include "../m11_alpha/webp_alpha.h"
+
+enum { MAX_THREADS = 64 };
+
+// A decoded frame waiting for the compositor.
+typedef struct {
+	Yuv420Image yuv;
+	uint8_t* rgba; // frame->width * 4 per row; NULL when not compositing
+	int err;       // errno of a failed decode
+	uint8_t state; // SLOT_*
+} AnimSlot;
+
+enum { SLOT_EMPTY = 0, SLOT_READY = 1, SLOT_FAILED = 2 };
+
+typedef struct {
+	ByteSpan file;
+	const WebPAnimation* anim;
+	int composite;
+	uint32_t window;
+	AnimSlot* slots; // window entries; frame i uses slots[i % window]
+
+	OsMutex lock;
+	OsCond ready; // a slot became READY/FAILED
+	OsCond freed; // the compositor released a slot (or aborted)
+	uint32_t next;     // next frame index to claim
+	uint32_t consumed; // frames the compositor has finished with
+	int abort;
+} AnimCtx;
+
+static void slot_release(AnimSlot* s) {
+	yuv420_free(&s->yuv);
+	free(s->rgba);
+	s->rgba = NULL;
+	s->state = SLOT_EMPTY;
+}
+
+// Decodes one frame (and converts it to RGBA when compositing). Returns 0 or an errno value.
+static int decode_frame(const AnimCtx* ctx, const WebPAnimFrame* f, AnimSlot* out) {
+	memset(&out->yuv, 0, sizeof(out->yuv));
+	out->rgba = NULL;
+	if (f->lossless) return ENOTSUP;
+
+	const ByteSpan payload = {ctx->file.data + f->vp8_offset, f->vp8_size};
+	Vp8KeyFrameHeader kf;
+	if (vp8_parse_keyframe_header(payload, &kf) != 0 || !kf.is_key_frame) return EINVAL;
+	if (kf.width != f->width || kf.height != f->height) return EINVAL;
+
+	Vp8DecodedFrame decoded;
+	if (vp8_decode_decoded_frame(payload, &decoded) != 0) return errno ? errno : EINVAL;
+	const int rc = vp8_reconstruct_keyframe_yuv_filtered(&kf, &decoded, &out->yuv);
+	vp8_decoded_frame_free(&decoded);
+	if (rc != 0) return errno ? errno : EINVAL;
+
+	if (ctx->composite) {
+		const size_t stride = (size_t)f->width * 4u;
+		out->rgba = (uint8_t*)malloc(stride * f->height);
+		if (!out->rgba) {
+			yuv420_free(&out->yuv);
+			return ENOMEM;
+		}
+		WebPAlphaRows alpha;
+		WebPAlphaRows* ap = NULL;
+		if (f->alph_size) {
+			const ByteSpan alph = {ctx->file.data + f->alph_offset, f->alph_size};
+			if (webp_alpha_rows_init(&alpha, alph, f->width, f->height) != 0) {
+				const int err = errno;
+				slot_release(out);
+				return err;
+			}
+			ap = &alpha;
+		}
+		const int crc = yuv420_to_rgba(&out->yuv, NULL, ap, 0, out->rgba, stride);
+		if (ap) webp_alpha_rows_free(ap);
+		if (crc != 0) {
+			slot_release(out);
+			return EINVAL;
+		}
+	}
+	return 0;
+}
+
+// --- compositor ---
+
+// libwebp's non-premultiplied "src over dst" (anim_decode.c BlendPixelNonPremult).
+static void blend_pixel(uint8_t* dst, const uint8_t* src) {
+	const uint32_t src_a = src[3];
+	if (src_a == 255u) {
+		memcpy(dst, src, 4);
+		return;
+	}
+	if (src_a == 0u) return;
+	const uint32_t dst_factor_a = ((uint32_t)dst[3] * (256u - src_a)) >> 8;
+	const uint32_t blend_a = src_a + dst_factor_a;
+	const uint32_t scale = (1u << 24) / blend_a;
+	for (int c = 0; c < 3; c++) {
+		const uint32_t v = (uint32_t)src[c] * src_a + (uint32_t)dst[c] * dst_factor_a;
+		dst[c] = (uint8_t)((v * scale) >> 24);
+	}
+	dst[3] = (uint8_t)blend_a;
+}
+
+static void clear_rect(uint8_t* canvas, uint32_t canvas_w, const WebPAnimFrame* f) {
+	for (uint32_t y = 0; y < f->height; y++) {
+		memset(canvas + ((size_t)(f->y + y) * canvas_w + f->x) * 4u, 0, (size_t)f->width * 4u);
+	}
+}
+
+static void draw_frame(uint8_t* canvas, uint32_t canvas_w, const WebPAnimFrame* f, const uint8_t* rgba) {
+	const size_t row_bytes = (size_t)f->width * 4u;
+	for (uint32_t y = 0; y < f->height; y++) {
+		uint8_t* dst = canvas + ((size_t)(f->y + y) * canvas_w + f->x) * 4u;
+		const uint8_t* src = rgba + (size_t)y * row_bytes;
+		if (!f->blend) {
+			memcpy(dst, src, row_bytes);
+			continue;
+		}
+		for (uint32_t x = 0; x < f->width; x++) blend_pixel(dst + x * 4u, src + x * 4u);
+	}
+}
+
+// Composites frame `i` (already decoded into `s`) and hands it to the callback.
+static int present_frame(const AnimCtx* ctx, uint8_t* canvas, uint32_t i, const AnimSlot* s, WebPAnimFrameFn fn,
+                         void* user) {
+	const WebPAnimation* anim = ctx->anim;
+	const WebPAnimFrame* f = &anim->frames[i];
+	if (canvas) {
+		if (i > 0 && anim->frames[i - 1u].dispose) clear_rect(canvas, anim->canvas_width, &anim->frames[i - 1u]);
+		draw_frame(canvas, anim->canvas_width, f, s->rgba);
+	}
+	if (fn && fn(user, i, f, &s->yuv, canvas) != 0) {
+		errno = ECANCELED;
+		return -1;
+	}
+	return 0;
+}
+
+// --- frame-parallel decode ---
+
+static void* worker_main(void* arg) {
+	AnimCtx* ctx = (AnimCtx*)arg;
+	os_mutex_lock(&ctx->lock);
+	while (!ctx->abort && ctx->next < ctx->anim->frame_count) {
+		const uint32_t i = ctx->next++;
+		// The slot is free once the compositor is done with frame i - window.
+		while (!ctx->abort && i >= ctx->consumed + ctx->window) os_cond_wait(&ctx->freed, &ctx->lock);
+		if (ctx->abort) break;
+		os_mutex_unlock(&ctx->lock);
+
+		AnimSlot* s = &ctx->slots[i % ctx->window];
+		const int err = decode_frame(ctx, &ctx->anim->frames[i], s);
+
+		os_mutex_lock(&ctx->lock);
+		s->err = err;
+		s->state = err ? SLOT_FAILED : SLOT_READY;
+		os_cond_broadcast(&ctx->ready);
+	}
+	os_mutex_unlock(&ctx->lock);
+	return NULL;
+}
+
+static int decode_parallel(AnimCtx* ctx, uint32_t threads, uint8_t* canvas, WebPAnimFrameFn fn, void* user) {
+	OsThread workers[MAX_THREADS];
+	uint32_t started = 0;
+	while (started < threads && os_thread_start(&workers[started], worker_main, ctx) == 0) started++;
+	if (started == 0) return 1; // no threads here: caller decodes inline
+
+	int rc = 0;
+	int err = 0;
+	const uint32_t count = ctx->anim->frame_count;
+	for (uint32_t i = 0; i < count && rc == 0; i++) {
+		AnimSlot* s = &ctx->slots[i % ctx->window];
+		os_mutex_lock(&ctx->lock);
+		while (s->state == SLOT_EMPTY) os_cond_wait(&ctx->ready, &ctx->lock);
+		os_mutex_unlock(&ctx->lock);
+
+		if (s->state == SLOT_FAILED) {
+			err = s->err;
+			rc = -1;
+			break;
+		}
+		if (present_frame(ctx, canvas, i, s, fn, user) != 0) {
+			err = errno;
+			rc = -1;
+		}
+		slot_release(s);
+
+		os_mutex_lock(&ctx->lock);
+		ctx->consumed++;
+		os_cond_broadcast(&ctx->freed);
+		os_mutex_unlock(&ctx->lock);
+	}
+
+	os_mutex_lock(&ctx->lock);
+	if (rc != 0) ctx->abort = 1;
+	os_cond_broadcast(&ctx->freed);
+	os_mutex_unlock(&ctx->lock);
+	for (uint32_t t = 0; t < started; t++) (void)os_thread_join(&workers[t]);
+
+	// Frames decoded ahead of an error are dropped.
+	for (uint32_t w = 0; w < ctx->window; w++) slot_release(&ctx->slots[w]);
+	if (rc != 0) errno = err;
+	return rc;
+}
+
+static int decode_sequential(AnimCtx* ctx, uint8_t* canvas, WebPAnimFrameFn fn, void* user) {
+	AnimSlot* s = &ctx->slots[0];
+	for (uint32_t i = 0; i < ctx->anim->frame_count; i++) {
+		const int err = decode_frame(ctx, &ctx->anim->frames[i], s);
+		if (err) {
+			errno = err;
+			return -1;
+		}
+		const int rc = present_frame(ctx, canvas, i, s, fn, user);
+		slot_release(s);
+		if (rc != 0) return -1;
+	}
+	return 0;
+}
+
+int webp_anim_decode(ByteSpan file, const WebPAnimation* anim, const WebPAnimOptions* opts, WebPAnimFrameFn fn,
+                     void* user) {
+	if (!file.data || !anim || !anim->frames || anim->frame_count == 0) {
+		errno = EINVAL;
+		return -1;
+	}
+	const WebPAnimOptions defaults = {0, 0, 1};
+	if (!opts) opts = &defaults;
+
+	uint32_t threads = opts->threads ? opts->threads : os_cpu_count();
+	if (threads > MAX_THREADS) threads = MAX_THREADS;
+	if (threads > anim->frame_count) threads = anim->frame_count;
+	uint32_t window = opts->window ? opts->window : 2u * threads;
+	if (window < threads) window = threads;
+
+	const uint64_t canvas_bytes = (uint64_t)anim->canvas_width * anim->canvas_height * 4u;
+	if (opts->composite && canvas_bytes > (uint64_t)SIZE_MAX) {
+		errno = EFBIG;
+		return -1;
+	}
+
+	AnimCtx ctx;
+	memset(&ctx, 0, sizeof(ctx));
+	ctx.file = file;
+	ctx.anim = anim;
+	ctx.composite = opts->composite != 0;
+	ctx.window = window;
+	ctx.slots = (AnimSlot*)calloc(window, sizeof(AnimSlot));
+	uint8_t* canvas = ctx.composite ? (uint8_t*)calloc(1, (size_t)canvas_bytes) : NULL;
+	if (!ctx.slots || (ctx.composite && !canvas)) {
+		free(ctx.slots);
+		free(canvas);
+		errno = ENOMEM;
+		return -1;
+	}
+
+	int rc = 1;
+	if (threads > 1 && os_mutex_init(&ctx.lock) == 0) {
+		if (os_cond_init(&ctx.ready) == 0) {
+			if (os_cond_init(&ctx.freed) == 0) {
+				rc = decode_parallel(&ctx, threads, canvas, fn, user);
+				os_cond_destroy(&ctx.freed);
+			}
+			os_cond_destroy(&ctx.ready);
+		}
+		os_mutex_destroy(&ctx.lock);
+	}
+	if (rc > 0) rc = decode_sequential(&ctx, canvas, fn, user);
+
+	free(ctx.slots);
+	free(canvas);
+	return rc;
+}
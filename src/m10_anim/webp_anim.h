@@ -0,0 +1,36 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "../common/os.h"
+#include "../m01_container/webp_container.h"
+#include "../m06_recon/vp8_recon.h"
+
+// Animated WebP decoding (ANMF frames, RFC 9649 5.x).
+//
+// Every ANMF frame carries an independent VP8 key frame, so frames are decoded
+// (and converted to RGBA) in parallel by a small pool of worker threads; only
+// compositing onto the canvas runs in order, on the calling thread. At most
+// `window` frames are in flight, which bounds memory on long animations.
+//
+// Compositing follows libwebp's WebPAnimDecoder: the canvas starts fully
+// transparent, ANIM's background color is only a hint and is not used, and
+// dispose-to-background clears the frame rectangle to transparent.
+
+typedef struct {
+	uint32_t threads;   // decode threads; 0 = one per CPU, 1 = decode on the calling thread
+	uint32_t window;    // frames decoded ahead of the compositor; 0 = 2 * threads
+	uint8_t composite;  // 0: skip the canvas (canvas_rgba is NULL in the callback)
+} WebPAnimOptions;
+
+// Called once per frame in display order. frame_yuv is the decoded frame
+// (frame->width x frame->height); canvas_rgba is the composited canvas
+// (canvas_width * 4 bytes per row), valid until the callback returns.
+// A non-zero return stops decoding.
+typedef int (*WebPAnimFrameFn)(void* user, uint32_t index, const WebPAnimFrame* frame, const Yuv420Image* frame_yuv,
+                               const uint8_t* canvas_rgba);
+
+// Decodes every frame of `anim` (from webp_parse_animation() on the same file).
+// Returns 0 on success, -1 with errno set (ENOTSUP for VP8L frames).
+int webp_anim_decode(ByteSpan file, const WebPAnimation* anim, const WebPAnimOptions* opts, WebPAnimFrameFn fn,
+                     void* user);
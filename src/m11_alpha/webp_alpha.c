@@ -0,0 +1,163 @@
+#include "webp_alpha.h"
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+int webp_alpha_rows_init(WebPAlphaRows* a, ByteSpan alph, uint32_t width, uint32_t height) {
+	if (!a) {
+		errno = EINVAL;
+		return -1;
+	}
+	memset(a, 0, sizeof(*a));
+	if (!alph.data || alph.size < 1 || width == 0 || height == 0) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	// Header byte: reserved (2 bits) | pre-processing (2) | filtering (2) | compression (2).
+	const uint8_t hdr = alph.data[0];
+	const uint8_t compression = (uint8_t)(hdr & 3u);
+	const uint8_t filter = (uint8_t)((hdr >> 2) & 3u);
+	const uint8_t preprocessing = (uint8_t)((hdr >> 4) & 3u);
+	if ((hdr >> 6) != 0 || preprocessing > 1u || compression > WEBP_ALPHA_COMPRESSION_LOSSLESS) {
+		errno = EINVAL;
+		return -1;
+	}
+	if (compression == WEBP_ALPHA_COMPRESSION_LOSSLESS) {
+		errno = ENOTSUP;
+		return -1;
+	}
+	// Level-reduction pre-processing is informative only; the plane decodes as is.
+	if ((uint64_t)alph.size - 1u < (uint64_t)width * height) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	a->rows = (uint8_t*)malloc((size_t)width * 2u);
+	if (!a->rows) {
+		errno = ENOMEM;
+		return -1;
+	}
+	a->src = alph.data + 1;
+	a->width = width;
+	a->height = height;
+	a->filter = filter;
+	a->compression = compression;
+	return 0;
+}
+
+void webp_alpha_rows_free(WebPAlphaRows* a) {
+	if (!a) return;
+	free(a->rows);
+	free(a->sampled);
+	a->rows = NULL;
+	a->sampled = NULL;
+}
+
+// Inverse filters, as in libwebp (filters.c). The first row of every filter
+// predicts from the left (its first pixel from 0).
+static void unfilter_horizontal(const uint8_t* prev, const uint8_t* in, uint8_t* out, uint32_t width) {
+	uint8_t pred = prev ? prev[0] : 0;
+	for (uint32_t x = 0; x < width; x++) {
+		out[x] = (uint8_t)(pred + in[x]);
+		pred = out[x];
+	}
+}
+
+static void unfilter_vertical(const uint8_t* prev, const uint8_t* in, uint8_t* out, uint32_t width) {
+	if (!prev) {
+		unfilter_horizontal(NULL, in, out, width);
+		return;
+	}
+	for (uint32_t x = 0; x < width; x++) out[x] = (uint8_t)(prev[x] + in[x]);
+}
+
+static void unfilter_gradient(const uint8_t* prev, const uint8_t* in, uint8_t* out, uint32_t width) {
+	if (!prev) {
+		unfilter_horizontal(NULL, in, out, width);
+		return;
+	}
+	int top_left = prev[0];
+	int left = prev[0];
+	for (uint32_t x = 0; x < width; x++) {
+		const int top = prev[x];
+		int pred = left + top - top_left;
+		pred = (pred < 0) ? 0 : (pred > 255) ? 255 : pred;
+		left = (uint8_t)(pred + in[x]);
+		top_left = top;
+		out[x] = (uint8_t)left;
+	}
+}
+
+// Returns the next full-width row.
+static const uint8_t* unfilter_next_row(WebPAlphaRows* a) {
+	const uint32_t y = a->y++;
+	const uint8_t* in = a->src + (size_t)y * a->width;
+	if (a->filter == WEBP_ALPHA_FILTER_NONE) return in;
+
+	uint8_t* out = a->rows + (size_t)(y & 1u) * a->width;
+	const uint8_t* prev = y ? a->rows + (size_t)((y - 1u) & 1u) * a->width : NULL;
+	switch (a->filter) {
+	case WEBP_ALPHA_FILTER_HORIZONTAL:
+		unfilter_horizontal(prev, in, out, a->width);
+		break;
+	case WEBP_ALPHA_FILTER_VERTICAL:
+		unfilter_vertical(prev, in, out, a->width);
+		break;
+	default:
+		unfilter_gradient(prev, in, out, a->width);
+		break;
+	}
+	return out;
+}
+
+const uint8_t* webp_alpha_next_row(WebPAlphaRows* a) {
+	if (!a || !a->rows || a->y >= a->height) return NULL;
+	const uint8_t* row = unfilter_next_row(a);
+	if (!a->sampled) return row + a->x0;
+
+	for (uint32_t x = 0; x * a->step < a->width; x++) a->sampled[x] = row[x * a->step];
+	// The skipped rows still feed the vertical/gradient predictors.
+	for (uint32_t i = 1; i < a->step && a->y < a->height; i++) (void)unfilter_next_row(a);
+	return a->sampled;
+}
+
+int webp_alpha_rows_subsample(WebPAlphaRows* a, uint32_t step) {
+	if (!a || !a->rows || step == 0) {
+		errno = EINVAL;
+		return -1;
+	}
+	a->sampled = (uint8_t*)malloc((a->width + step - 1u) / step);
+	if (!a->sampled) {
+		errno = ENOMEM;
+		return -1;
+	}
+	a->step = step;
+	return 0;
+}
+
+void webp_alpha_rows_crop(WebPAlphaRows* a, uint32_t x, uint32_t y) {
+	if (!a) return;
+	a->x0 = 0;
+	for (uint32_t i = 0; i < y; i++) (void)webp_alpha_next_row(a);
+	a->x0 = (x < a->width) ? x : 0;
+}
+
+void webp_alpha_apply_row(uint8_t* rgba, const uint8_t* alpha, uint32_t width, int premultiply) {
+	if (!premultiply) {
+		for (uint32_t x = 0; x < width; x++) rgba[(size_t)x * 4u + 3u] = alpha[x];
+		return;
+	}
+	for (uint32_t x = 0; x < width; x++) {
+		uint8_t* p = rgba + (size_t)x * 4u;
+		const uint32_t a = alpha[x];
+		p[3] = (uint8_t)a;
+		if (a == 0xFFu) continue;
+		// libwebp ApplyAlphaMultiply: x * a / 255 as (x * a * 32897) >> 23.
+		const uint32_t mult = a * 32897u;
+		p[0] = (uint8_t)((p[0] * mult) >> 23);
+		p[1] = (uint8_t)((p[1] * mult) >> 23);
+		p[2] = (uint8_t)((p[2] * mult) >> 23);
+	}
+}
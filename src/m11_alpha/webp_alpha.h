@@ -0,0 +1,61 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "../common/os.h"
+
+// ALPH chunk decoding (RFC 9649 "Alpha"): the uncompressed alpha plane with no,
+// horizontal, vertical or gradient filtering. VP8L-compressed alpha is rejected
+// with ENOTSUP.
+//
+// Rows are unfiltered one at a time, in order, so the RGBA writers can merge
+// alpha into a row they have just converted from YUV instead of making a
+// separate pass over a full alpha plane.
+
+enum {
+	WEBP_ALPHA_FILTER_NONE = 0,
+	WEBP_ALPHA_FILTER_HORIZONTAL = 1,
+	WEBP_ALPHA_FILTER_VERTICAL = 2,
+	WEBP_ALPHA_FILTER_GRADIENT = 3,
+};
+
+enum {
+	WEBP_ALPHA_COMPRESSION_NONE = 0,
+	WEBP_ALPHA_COMPRESSION_LOSSLESS = 1,
+};
+
+typedef struct {
+	const uint8_t* src; // filtered plane, width * height bytes
+	uint32_t width;
+	uint32_t height;
+	uint8_t filter;      // WEBP_ALPHA_FILTER_*
+	uint8_t compression; // WEBP_ALPHA_COMPRESSION_*
+	uint32_t y;          // next row to unfilter
+	uint32_t x0;         // first column handed out (webp_alpha_rows_crop())
+	uint8_t* rows;       // two unfiltered rows (current + previous), 2 * width bytes
+	uint32_t step;       // webp_alpha_rows_subsample()
+	uint8_t* sampled;    // subsampled row, or NULL
+} WebPAlphaRows;
+
+// Parses the ALPH header byte and prepares row-by-row unfiltering of a
+// width x height plane. `alph` is the ALPH chunk payload (header byte included).
+// Returns 0 on success; -1 with errno EINVAL (corrupt/short) or ENOTSUP (VP8L).
+int webp_alpha_rows_init(WebPAlphaRows* a, ByteSpan alph, uint32_t width, uint32_t height);
+
+// Unfilters the next row. The returned row stays valid until the call after next
+// (it is the "previous row" of the next one). Returns NULL past the last row.
+const uint8_t* webp_alpha_next_row(WebPAlphaRows* a);
+
+// For cropped output: unfilters and drops the first `y` rows, and makes
+// webp_alpha_next_row() return rows starting at column `x`.
+void webp_alpha_rows_crop(WebPAlphaRows* a, uint32_t x, uint32_t y);
+
+// For -preview: webp_alpha_next_row() returns the top-left pixel of every
+// step x step block, one row of blocks per call. Returns 0, or -1 with errno.
+int webp_alpha_rows_subsample(WebPAlphaRows* a, uint32_t step);
+
+void webp_alpha_rows_free(WebPAlphaRows* a);
+
+// Stores `alpha` into the A bytes of an RGBA row. With `premultiply`, R/G/B are
+// scaled by alpha using libwebp's rounding (its premultiplied "rgbA" output).
+void webp_alpha_apply_row(uint8_t* rgba, const uint8_t* alpha, uint32_t width, int premultiply);
@@ -1,5 +1,6 @@
 #include "common/fmt.h"
 #include "common/os.h"
+#include "common/timing.h"
 #include "m01_container/webp_container.h"
 #include "m02_vp8_header/vp8_header.h"
 #include "m04_frame_header_full/vp8_frame_header_basic.h"
@@ -9,6 +10,7 @@
 #ifndef DECODER_TINY
 #include "m08_yuv2rgb_ppm/yuv2rgb_ppm.h"
 #include "m09_png/yuv2rgb_png.h"
+#include "m10_anim/webp_anim.h"
 #endif
 
 #include <errno.h>
@@ -17,6 +19,122 @@
 #include <string.h>
 #include <unistd.h>
 
+// Output writer flags selected by leading global options (see main()).
+static uint32_t g_out_flags;
+
+// `-timings`: per-stage timings of the decode commands, reported as JSON on stderr.
+static int g_timings_enabled;
+static DecTimings g_timings;
+
+// `-threads N`: frame decode threads for the -anim_* commands (0 = one per CPU).
+static uint32_t g_threads;
+
+// `-crop x,y,w,h`: region of interest for the still decode commands.
+static int g_crop_set;
+static Vp8Rect g_crop;
+
+// `-preview`: DC-only decode at 1/4 scale (vp8_reconstruct_keyframe_preview()).
+static int g_preview;
+
+static int arg_eq(const char* a, const char* b) {
+	while (*a && *a == *b) {
+		a++;
+		b++;
+	}
+	return *a == *b;
+}
+
+// Parses "x,y,w,h" (decimal) for -crop. Returns 0 on success.
+static int parse_crop(const char* s, Vp8Rect* out) {
+	uint32_t v[4];
+	for (int i = 0; i < 4; i++) {
+		if (*s < '0' || *s > '9') return -1;
+		char* end;
+		const unsigned long n = strtoul(s, &end, 10);
+		if (n > 0xFFFFFFFFul || *end != (i < 3 ? ',' : '\0')) return -1;
+		v[i] = (uint32_t)n;
+		s = end + 1;
+	}
+	if (v[2] == 0 || v[3] == 0) return -1;
+	*out = (Vp8Rect){v[0], v[1], v[2], v[3]};
+	return 0;
+}
+
+// Checks -crop against the frame size; prints an error and returns -1 if it does not fit.
+static int crop_check(const Vp8KeyFrameHeader* kf) {
+	if (!g_crop_set) return 0;
+	if (g_crop.x >= kf->width || g_crop.y >= kf->height || g_crop.width > kf->width - g_crop.x ||
+	    g_crop.height > kf->height - g_crop.y) {
+		fmt_write_str(2, "error: -crop rectangle is outside the image\n");
+		return -1;
+	}
+	return 0;
+}
+
+// "-" is stdout; close_output() leaves it open.
+static int open_output(const char* path) {
+	if (os_path_is_stdio(path)) return 1;
+	// A shared writable mapping needs read access to the file too.
+	const int acc = (g_out_flags & OS_WRITER_MMAP) ? O_RDWR : O_WRONLY;
+	return open(path, acc | O_CREAT | O_TRUNC, 0644);
+}
+
+static void close_output(int fd) {
+	if (fd != 1) (void)close(fd);
+}
+
+// Writes the I420 planes (including stride padding) with a single writev().
+static int write_i420(int fd, const Yuv420Image* img) {
+	size_t ysz = (size_t)img->stride_y * (size_t)img->height;
+	size_t uvh = (size_t)((img->height + 1u) / 2u);
+	size_t uvsz = (size_t)img->stride_uv * uvh;
+	const ByteSpan planes[3] = {{img->y, ysz}, {img->u, uvsz}, {img->v, uvsz}};
+	OsWriter w;
+	os_writer_init(&w, fd, 0, g_out_flags);
+	int rc = os_writer_reserve(&w, (uint64_t)ysz + 2u * (uint64_t)uvsz);
+	if (rc == 0) rc = os_writer_write_segments(&w, planes, 3);
+	if (os_writer_close(&w) != 0) rc = -1;
+	g_timings.bytes_written = w.pos;
+	return rc;
+}
+
+#ifndef DECODER_TINY
+// Writes `rect` of the image (NULL: all of it) in one RGB(A) output format;
+// alpha is NULL unless the file has an ALPH chunk.
+typedef int (*RgbWriteFn)(OsWriter* w, const Yuv420Image* img, const Vp8Rect* rect, WebPAlphaRows* alpha);
+
+static int write_image(int fd, const Yuv420Image* img, const Vp8Rect* rect, WebPAlphaRows* alpha,
+                       RgbWriteFn write_fn) {
+	OsWriter w;
+	os_writer_init(&w, fd, 0, g_out_flags);
+	int rc = write_fn(&w, img, rect, alpha);
+	if (os_writer_close(&w) != 0) rc = -1;
+	g_timings.bytes_written = w.pos;
+	return rc;
+}
+#endif
+
+static void timings_begin(void) {
+	if (!g_timings_enabled) return;
+	dec_timing_begin(&g_timings);
+	(void)dec_timing_switch(DEC_STAGE_FILE_MAP);
+}
+
+// Stops the clock and writes the JSON line for a successful decode command.
+static void timings_report(const char* cmd, const char* path, const Vp8DecodedFrame* decoded, const Yuv420Image* img) {
+	if (!g_timings_enabled) return;
+	dec_timing_end(&g_timings);
+	const Vp8CoeffStats* cs = &decoded->stats;
+	g_timings.width = img->width;
+	g_timings.height = img->height;
+	g_timings.bool_decodes = cs->bool_decodes;
+	g_timings.tokens = cs->coeff_tokens;
+	g_timings.nonzero_blocks = (uint64_t)cs->blocks_nonzero_y2 + cs->blocks_nonzero_y + cs->blocks_nonzero_u +
+	                           cs->blocks_nonzero_v;
+	(void)fmt_flush(); // keep the line after any buffered stdout output
+	(void)dec_timings_write_json(2, &g_timings, cmd, path);
+}
+
 static void usage(void) {
 	fmt_write_str(2, "Usage:\n");
 	fmt_write_str(2, "  decoder -info <file.webp>\n");
@@ -27,8 +145,22 @@ static void usage(void) {
 	fmt_write_str(2, "  decoder -probe <file.webp>\n");
 	fmt_write_str(2, "  decoder -dump_mb <file.webp> [mb_index]\n");
 	fmt_write_str(2, "  decoder -ppm <file.webp> <out.ppm>\n");
-	fmt_write_str(2, "  decoder -png <file.webp> <out.png>\n");
+	fmt_write_str(2, "  decoder -png <file.webp> <out.png>     (RGBA when the file has alpha)\n");
+	fmt_write_str(2, "  decoder -pam <file.webp> <out.pam>     (RGBA)\n");
 	fmt_write_str(2, "  decoder -diff_mb <file.webp> <oracle.i420>\n");
+	fmt_write_str(2, "  decoder -anim_info <file.webp>\n");
+	fmt_write_str(2, "  decoder -anim_png <file.webp> <out_prefix>    composited RGBA canvas per frame\n");
+	fmt_write_str(2, "  decoder -anim_yuv <file.webp> <out_prefix>    decoded I420 frame rectangles\n");
+	fmt_write_str(2, "  decoder -anim_rgba <file.webp> <out.rgba>     raw RGBA canvas stream\n");
+#endif
+	fmt_write_str(2, "A file name of - is stdin (input) or stdout (output; not an -anim_png/-anim_yuv prefix).\n");
+	fmt_write_str(2, "Options (before the command):\n");
+	fmt_write_str(2, "  -mmap_out   write output files via ftruncate+mmap instead of write()\n");
+	fmt_write_str(2, "  -timings    print per-stage decode timings and counts as one JSON line on stderr\n");
+	fmt_write_str(2, "  -crop x,y,w,h  decode only this rectangle (-yuv/-yuvf: x and y even)\n");
+	fmt_write_str(2, "  -preview    DC-only 1/4-scale preview, no IDCT or loop filter (-yuv/-ppm/-png/-pam)\n");
+#ifndef DECODER_TINY
+	fmt_write_str(2, "  -threads N  animation frame decode threads (default: one per CPU; 1 = no threads)\n");
 #endif
 }
 
@@ -248,51 +380,52 @@ static int cmd_dump_mb(const char* path, uint32_t mb_index) {
 		}
 	}
 
+	const Vp8MbRecord* rec = &f.mbs[mb_index];
 	fmt_write_str(1, "  segment_id: ");
-	fmt_write_u32(1, f.segment_id[mb_index]);
+	fmt_write_u32(1, rec->segment_id);
 	fmt_write_nl(1);
 	fmt_write_str(1, "  skip_coeff: ");
-	fmt_write_u32(1, f.skip_coeff[mb_index]);
+	fmt_write_u32(1, (rec->flags & VP8_MB_SKIP) ? 1u : 0u);
 	fmt_write_nl(1);
 	fmt_write_str(1, "  ymode:      ");
-	print_mb_mode_u8(f.ymode[mb_index], ymode_names, 5);
+	print_mb_mode_u8(rec->ymode, ymode_names, 5);
 	fmt_write_nl(1);
 	fmt_write_str(1, "  uv_mode:    ");
-	print_mb_mode_u8(f.uv_mode[mb_index], uv_names, 4);
+	print_mb_mode_u8(rec->uv_mode, uv_names, 4);
 	fmt_write_nl(1);
 
-	if (f.ymode[mb_index] == 4) {
+	if (rec->ymode == 4) {
 		fmt_write_str(1, "  bmode 4x4:\n");
 		for (uint32_t rr = 0; rr < 4; rr++) {
 			fmt_write_str(1, "    ");
 			for (uint32_t cc = 0; cc < 4; cc++) {
-				uint8_t m = f.bmode[(size_t)mb_index * 16u + (size_t)(rr * 4u + cc)];
+				uint8_t m = vp8_mb_bmode(rec, rr * 4u + cc);
 				print_mb_mode_u8(m, bmode_names, 10);
 				fmt_write_str(1, (cc == 3) ? "\n" : " ");
 			}
 		}
 	}
 
-	// Print coefficient samples (enough to spot obvious corruption).
-	const int16_t* y2 = f.coeff_y2 + (size_t)mb_index * 16u;
+	// Print (dequantized) coefficient samples, enough to spot obvious corruption.
+	const int16_t* y2 = vp8_mb_coeffs(&f, mb_index);
 	fmt_write_str(1, "  Y2 coeff[0..15]: ");
 	for (int i = 0; i < 16; i++) {
 		fmt_write_i32(1, y2[i]);
 		fmt_write_str(1, (i == 15) ? "\n" : " ");
 	}
-	const int16_t* y0 = f.coeff_y + ((size_t)mb_index * 16u + 0u) * 16u;
+	const int16_t* y0 = y2 + VP8_MB_COEFFS_Y2;
 	fmt_write_str(1, "  Y block0 coeff[0..15]: ");
 	for (int i = 0; i < 16; i++) {
 		fmt_write_i32(1, y0[i]);
 		fmt_write_str(1, (i == 15) ? "\n" : " ");
 	}
-	const int16_t* u0 = f.coeff_u + ((size_t)mb_index * 4u + 0u) * 16u;
+	const int16_t* u0 = y0 + 16u * 16u;
 	fmt_write_str(1, "  U block0 coeff[0..15]: ");
 	for (int i = 0; i < 16; i++) {
 		fmt_write_i32(1, u0[i]);
 		fmt_write_str(1, (i == 15) ? "\n" : " ");
 	}
-	const int16_t* v0 = f.coeff_v + ((size_t)mb_index * 4u + 0u) * 16u;
+	const int16_t* v0 = u0 + 4u * 16u;
 	fmt_write_str(1, "  V block0 coeff[0..15]: ");
 	for (int i = 0; i < 16; i++) {
 		fmt_write_i32(1, v0[i]);
@@ -302,13 +435,13 @@ static int cmd_dump_mb(const char* path, uint32_t mb_index) {
 	// Quick view of chroma DCs across all 4 sub-blocks.
 	fmt_write_str(1, "  U DCs: ");
 	for (int b = 0; b < 4; b++) {
-		const int16_t* ub = f.coeff_u + ((size_t)mb_index * 4u + (size_t)b) * 16u;
+		const int16_t* ub = u0 + (size_t)b * 16u;
 		fmt_write_i32(1, ub[0]);
 		fmt_write_str(1, (b == 3) ? "\n" : " ");
 	}
 	fmt_write_str(1, "  V DCs: ");
 	for (int b = 0; b < 4; b++) {
-		const int16_t* vb = f.coeff_v + ((size_t)mb_index * 4u + (size_t)b) * 16u;
+		const int16_t* vb = v0 + (size_t)b * 16u;
 		fmt_write_i32(1, vb[0]);
 		fmt_write_str(1, (b == 3) ? "\n" : " ");
 	}
@@ -336,7 +469,8 @@ static int cmd_info(const char* path) {
 	WebPContainer c;
 	int rc = webp_parse_simple_lossy(file, &c);
 	if (rc != 0) {
-		fmt_write_str(2, "error: not a supported simple lossy WebP (RIFF/WEBP + single VP8 chunk)\n");
+		fmt_write_str(2, webp_is_animation(file) ? "error: animated WebP; use -anim_info\n"
+		                                         : "error: not a supported simple lossy WebP (RIFF/WEBP + single VP8 chunk)\n");
 		os_unmap_file(file);
 		return 1;
 	}
@@ -368,6 +502,21 @@ static int cmd_info(const char* path) {
 	fmt_write_u32(1, c.vp8_chunk_size);
 	fmt_write_str(1, ")\n");
 
+	if (c.alph_chunk_size != 0) {
+		static const char* const filters[4] = {"none", "horizontal", "vertical", "gradient"};
+		const uint8_t ah = file.data[c.alph_chunk_offset];
+		fmt_write_str(1, "Chunk ALPH at offset ");
+		fmt_write_size(1, c.alph_chunk_offset - 8u);
+		fmt_write_str(1, ", length ");
+		fmt_write_u32(1, c.alph_chunk_size + 8u);
+		fmt_write_nl(1);
+		fmt_write_str(1, "  (compression ");
+		fmt_write_str(1, (ah & 3u) == 0 ? "none" : (ah & 3u) == 1 ? "lossless" : "invalid");
+		fmt_write_str(1, ", filter ");
+		fmt_write_str(1, filters[(ah >> 2) & 3u]);
+		fmt_write_str(1, ")\n");
+	}
+
 	ByteSpan vp8_payload = {
 		.data = file.data + c.vp8_chunk_offset,
 		.size = c.vp8_chunk_size,
@@ -436,7 +585,7 @@ static int cmd_info(const char* path) {
 			fmt_write_nl(1);
 			// If multiple token partitions exist, print their lengths.
 			if (fh.total_partitions > 1) {
-				for (uint32_t i = 1; i < fh.total_partitions; i++) {
+				for (uint32_t i = 1; i <= fh.total_partitions; i++) {
 					fmt_write_str(1, "  Part. ");
 					fmt_write_u32(1, i);
 					fmt_write_str(1, " length:   ");
@@ -553,87 +702,53 @@ static int cmd_info(const char* path) {
 	return 0;
 }
 
-static int cmd_yuv(const char* in_path, const char* out_path) {
-	ByteSpan file;
-	if (os_map_file_readonly(in_path, &file) != 0) {
-		fmt_write_str(2, "error: cannot open/map file\n");
-		return 1;
-	}
-
-	WebPContainer c;
-	int rc = webp_parse_simple_lossy(file, &c);
-	if (rc != 0) {
-		fmt_write_str(2, "error: not a supported simple lossy WebP (RIFF/WEBP + single VP8 chunk)\n");
-		os_unmap_file(file);
-		return 1;
-	}
-
-	ByteSpan vp8_payload = {
-		.data = file.data + c.vp8_chunk_offset,
-		.size = c.vp8_chunk_size,
-	};
-
-	Vp8KeyFrameHeader kf;
-	if (vp8_parse_keyframe_header(vp8_payload, &kf) != 0 || !kf.is_key_frame) {
-		fmt_write_str(2, "error: VP8 key-frame header parse failed\n");
-		os_unmap_file(file);
-		return 1;
-	}
-
-	Vp8DecodedFrame decoded;
-	if (vp8_decode_decoded_frame(vp8_payload, &decoded) != 0) {
+// Token-decodes the macroblock rows `region` (NULL: the whole frame) depends
+// on, and reconstructs it into `img` (allocated here); with -preview, the
+// DC-only preview instead. Returns 0, or -1 after printing an error.
+static int decode_region(ByteSpan vp8_payload, const Vp8KeyFrameHeader* kf, const Vp8Rect* region, int filtered,
+                         Vp8DecodedFrame* decoded, Yuv420Image* img) {
+	Vp8MbExtent extent = {0, UINT32_MAX, 0};
+	if (region) vp8_rect_mb_extent(kf, region, filtered, &extent);
+	const int drc = g_preview ? vp8_decode_decoded_frame_dc(vp8_payload, decoded)
+	                          : vp8_decode_decoded_frame_rows(vp8_payload, extent.mb_rows, decoded);
+	if (drc != 0) {
 		fmt_write_str(2, "error: VP8 macroblock/token decode failed\n");
-		os_unmap_file(file);
-		return 1;
-	}
-
-	Yuv420Image img;
-	if (vp8_reconstruct_keyframe_yuv(&kf, &decoded, &img) != 0) {
-		fmt_write_str(2, "error: VP8 reconstruction failed\n");
-		vp8_decoded_frame_free(&decoded);
-		os_unmap_file(file);
-		return 1;
+		return -1;
 	}
 
-	int fd = open(out_path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
-	if (fd < 0) {
-		fmt_write_str(2, "error: cannot open output file\n");
-		yuv420_free(&img);
-		vp8_decoded_frame_free(&decoded);
-		os_unmap_file(file);
-		return 1;
+	(void)dec_timing_switch(DEC_STAGE_RECON);
+	int rc;
+	if (g_preview) {
+		rc = vp8_reconstruct_keyframe_preview(kf, decoded, img);
+	} else if (!region) {
+		rc = filtered ? vp8_reconstruct_keyframe_yuv_filtered(kf, decoded, img)
+		              : vp8_reconstruct_keyframe_yuv(kf, decoded, img);
+	} else {
+		rc = yuv420_alloc(img, region->width, region->height);
+		if (rc == 0 && vp8_reconstruct_keyframe_rect(kf, decoded, filtered, region, img) != 0) {
+			yuv420_free(img);
+			rc = -1;
+		}
 	}
-
-	size_t ysz = (size_t)img.stride_y * (size_t)img.height;
-	size_t uvh = (size_t)((img.height + 1u) / 2u);
-	size_t uvsz = (size_t)img.stride_uv * uvh;
-	int wrc = 0;
-	wrc |= os_write_all(fd, img.y, ysz);
-	wrc |= os_write_all(fd, img.u, uvsz);
-	wrc |= os_write_all(fd, img.v, uvsz);
-	(void)close(fd);
-
-	if (wrc != 0) {
-		fmt_write_str(2, "error: write failed\n");
-		yuv420_free(&img);
-		vp8_decoded_frame_free(&decoded);
-		os_unmap_file(file);
-		return 1;
+	if (rc != 0) {
+		fmt_write_str(2, filtered ? "error: VP8 reconstruction/loopfilter failed\n"
+		                          : "error: VP8 reconstruction failed\n");
+		vp8_decoded_frame_free(decoded);
+		return -1;
 	}
-
-	yuv420_free(&img);
-	vp8_decoded_frame_free(&decoded);
-	os_unmap_file(file);
 	return 0;
 }
 
-static int cmd_yuvf(const char* in_path, const char* out_path) {
+// -yuv (unfiltered) and -yuvf (loop-filtered) I420 output.
+static int cmd_i420(const char* cmd, const char* in_path, const char* out_path, int filtered) {
+	timings_begin();
 	ByteSpan file;
 	if (os_map_file_readonly(in_path, &file) != 0) {
 		fmt_write_str(2, "error: cannot open/map file\n");
 		return 1;
 	}
 
+	(void)dec_timing_switch(DEC_STAGE_CONTAINER);
 	WebPContainer c;
 	int rc = webp_parse_simple_lossy(file, &c);
 	if (rc != 0) {
@@ -647,29 +762,33 @@ static int cmd_yuvf(const char* in_path, const char* out_path) {
 		.size = c.vp8_chunk_size,
 	};
 
+	(void)dec_timing_switch(DEC_STAGE_HEADER);
 	Vp8KeyFrameHeader kf;
 	if (vp8_parse_keyframe_header(vp8_payload, &kf) != 0 || !kf.is_key_frame) {
 		fmt_write_str(2, "error: VP8 key-frame header parse failed\n");
 		os_unmap_file(file);
 		return 1;
 	}
-
-	Vp8DecodedFrame decoded;
-	if (vp8_decode_decoded_frame(vp8_payload, &decoded) != 0) {
-		fmt_write_str(2, "error: VP8 macroblock/token decode failed\n");
+	if (crop_check(&kf) != 0) {
+		os_unmap_file(file);
+		return 1;
+	}
+	if (g_crop_set && ((g_crop.x | g_crop.y) & 1u)) {
+		// The chroma planes can only be cut on whole samples.
+		fmt_write_str(2, "error: -crop x and y must be even for I420 output\n");
 		os_unmap_file(file);
 		return 1;
 	}
 
+	Vp8DecodedFrame decoded;
 	Yuv420Image img;
-	if (vp8_reconstruct_keyframe_yuv_filtered(&kf, &decoded, &img) != 0) {
-		fmt_write_str(2, "error: VP8 reconstruction/loopfilter failed\n");
-		vp8_decoded_frame_free(&decoded);
+	if (decode_region(vp8_payload, &kf, g_crop_set ? &g_crop : NULL, filtered, &decoded, &img) != 0) {
 		os_unmap_file(file);
 		return 1;
 	}
 
-	int fd = open(out_path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	(void)dec_timing_switch(DEC_STAGE_WRITE);
+	int fd = open_output(out_path);
 	if (fd < 0) {
 		fmt_write_str(2, "error: cannot open output file\n");
 		yuv420_free(&img);
@@ -678,14 +797,8 @@ static int cmd_yuvf(const char* in_path, const char* out_path) {
 		return 1;
 	}
 
-	size_t ysz = (size_t)img.stride_y * (size_t)img.height;
-	size_t uvh = (size_t)((img.height + 1u) / 2u);
-	size_t uvsz = (size_t)img.stride_uv * uvh;
-	int wrc = 0;
-	wrc |= os_write_all(fd, img.y, ysz);
-	wrc |= os_write_all(fd, img.u, uvsz);
-	wrc |= os_write_all(fd, img.v, uvsz);
-	(void)close(fd);
+	int wrc = write_i420(fd, &img);
+	close_output(fd);
 
 	if (wrc != 0) {
 		fmt_write_str(2, "error: write failed\n");
@@ -695,6 +808,7 @@ static int cmd_yuvf(const char* in_path, const char* out_path) {
 		return 1;
 	}
 
+	timings_report(cmd, in_path, &decoded, &img);
 	yuv420_free(&img);
 	vp8_decoded_frame_free(&decoded);
 	os_unmap_file(file);
@@ -703,13 +817,34 @@ static int cmd_yuvf(const char* in_path, const char* out_path) {
 
 #ifndef DECODER_TINY
 
-static int cmd_ppm(const char* in_path, const char* out_path) {
+static int write_ppm(OsWriter* w, const Yuv420Image* img, const Vp8Rect* rect, WebPAlphaRows* alpha) {
+	(void)alpha; // PPM has no alpha channel
+	return yuv420_write_ppm_rect(w, img, rect);
+}
+
+// Sets up the ALPH rows of an extended-layout still. Returns 1 with `a` ready,
+// 0 without an ALPH chunk, -1 (after printing an error) if it cannot be decoded.
+static int alpha_begin(ByteSpan file, const WebPContainer* c, const Vp8KeyFrameHeader* kf, WebPAlphaRows* a) {
+	if (c->alph_chunk_size == 0) return 0;
+	const ByteSpan alph = {file.data + c->alph_chunk_offset, c->alph_chunk_size};
+	if (webp_alpha_rows_init(a, alph, kf->width, kf->height) != 0) {
+		fmt_write_str(2, errno == ENOTSUP ? "error: VP8L-compressed alpha (ALPH) is not supported\n"
+		                                  : "error: invalid ALPH chunk\n");
+		return -1;
+	}
+	return 1;
+}
+
+static int cmd_rgb(const char* cmd, const char* in_path, const char* out_path, RgbWriteFn write_fn,
+                   const char* write_error) {
+	timings_begin();
 	ByteSpan file;
 	if (os_map_file_readonly(in_path, &file) != 0) {
 		fmt_write_str(2, "error: cannot open/map file\n");
 		return 1;
 	}
 
+	(void)dec_timing_switch(DEC_STAGE_CONTAINER);
 	WebPContainer c;
 	int rc = webp_parse_simple_lossy(file, &c);
 	if (rc != 0) {
@@ -723,118 +858,74 @@ static int cmd_ppm(const char* in_path, const char* out_path) {
 		.size = c.vp8_chunk_size,
 	};
 
+	(void)dec_timing_switch(DEC_STAGE_HEADER);
 	Vp8KeyFrameHeader kf;
 	if (vp8_parse_keyframe_header(vp8_payload, &kf) != 0 || !kf.is_key_frame) {
 		fmt_write_str(2, "error: VP8 key-frame header parse failed\n");
 		os_unmap_file(file);
 		return 1;
 	}
-
-	Vp8DecodedFrame decoded;
-	if (vp8_decode_decoded_frame(vp8_payload, &decoded) != 0) {
-		fmt_write_str(2, "error: VP8 macroblock/token decode failed\n");
-		os_unmap_file(file);
-		return 1;
-	}
-
-	Yuv420Image img;
-	// Match dwebp default output: filtered reconstruction.
-	if (vp8_reconstruct_keyframe_yuv_filtered(&kf, &decoded, &img) != 0) {
-		fmt_write_str(2, "error: VP8 reconstruction/loopfilter failed\n");
-		vp8_decoded_frame_free(&decoded);
-		os_unmap_file(file);
-		return 1;
-	}
-
-	int fd = open(out_path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
-	if (fd < 0) {
-		fmt_write_str(2, "error: cannot open output file\n");
-		yuv420_free(&img);
-		vp8_decoded_frame_free(&decoded);
+	if (crop_check(&kf) != 0) {
 		os_unmap_file(file);
 		return 1;
 	}
 
-	int wrc = yuv420_write_ppm_fd(fd, &img);
-	(void)close(fd);
-
-	if (wrc != 0) {
-		fmt_write_str(2, "error: PPM write failed\n");
-		yuv420_free(&img);
-		vp8_decoded_frame_free(&decoded);
+	WebPAlphaRows alpha;
+	const int has_alpha = alpha_begin(file, &c, &kf, &alpha);
+	if (has_alpha < 0) {
 		os_unmap_file(file);
 		return 1;
 	}
-
-	yuv420_free(&img);
-	vp8_decoded_frame_free(&decoded);
-	os_unmap_file(file);
-	return 0;
-}
-
-static int cmd_png(const char* in_path, const char* out_path) {
-	ByteSpan file;
-	if (os_map_file_readonly(in_path, &file) != 0) {
-		fmt_write_str(2, "error: cannot open/map file\n");
-		return 1;
-	}
-
-	WebPContainer c;
-	int rc = webp_parse_simple_lossy(file, &c);
-	if (rc != 0) {
-		fmt_write_str(2, "error: not a supported simple lossy WebP (RIFF/WEBP + single VP8 chunk)\n");
+	if (has_alpha && g_preview && webp_alpha_rows_subsample(&alpha, 4u) != 0) {
+		fmt_write_str(2, "error: out of memory\n");
+		webp_alpha_rows_free(&alpha);
 		os_unmap_file(file);
 		return 1;
 	}
 
-	ByteSpan vp8_payload = {
-		.data = file.data + c.vp8_chunk_offset,
-		.size = c.vp8_chunk_size,
-	};
-
-	Vp8KeyFrameHeader kf;
-	if (vp8_parse_keyframe_header(vp8_payload, &kf) != 0 || !kf.is_key_frame) {
-		fmt_write_str(2, "error: VP8 key-frame header parse failed\n");
-		os_unmap_file(file);
-		return 1;
+	// With -crop, only the window the upsampler needs around the rectangle is
+	// reconstructed; `rect` is the crop relative to that window.
+	Vp8Rect window;
+	Vp8Rect rect;
+	if (g_crop_set) {
+		yuv420_rgb_window(&g_crop, kf.width, kf.height, &window);
+		rect = (Vp8Rect){g_crop.x - window.x, g_crop.y - window.y, g_crop.width, g_crop.height};
+		if (has_alpha) webp_alpha_rows_crop(&alpha, g_crop.x, g_crop.y);
 	}
 
 	Vp8DecodedFrame decoded;
-	if (vp8_decode_decoded_frame(vp8_payload, &decoded) != 0) {
-		fmt_write_str(2, "error: VP8 macroblock/token decode failed\n");
-		os_unmap_file(file);
-		return 1;
-	}
-
 	Yuv420Image img;
 	// Match dwebp default output: filtered reconstruction.
-	if (vp8_reconstruct_keyframe_yuv_filtered(&kf, &decoded, &img) != 0) {
-		fmt_write_str(2, "error: VP8 reconstruction/loopfilter failed\n");
-		vp8_decoded_frame_free(&decoded);
+	if (decode_region(vp8_payload, &kf, g_crop_set ? &window : NULL, 1, &decoded, &img) != 0) {
+		if (has_alpha) webp_alpha_rows_free(&alpha);
 		os_unmap_file(file);
 		return 1;
 	}
 
-	int fd = open(out_path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	(void)dec_timing_switch(DEC_STAGE_WRITE);
+	int fd = open_output(out_path);
 	if (fd < 0) {
 		fmt_write_str(2, "error: cannot open output file\n");
 		yuv420_free(&img);
 		vp8_decoded_frame_free(&decoded);
+		if (has_alpha) webp_alpha_rows_free(&alpha);
 		os_unmap_file(file);
 		return 1;
 	}
 
-	int wrc = yuv420_write_png_fd(fd, &img);
-	(void)close(fd);
+	int wrc = write_image(fd, &img, g_crop_set ? &rect : NULL, has_alpha ? &alpha : NULL, write_fn);
+	close_output(fd);
+	if (has_alpha) webp_alpha_rows_free(&alpha);
 
 	if (wrc != 0) {
-		fmt_write_str(2, "error: PNG write failed\n");
+		fmt_write_str(2, write_error);
 		yuv420_free(&img);
 		vp8_decoded_frame_free(&decoded);
 		os_unmap_file(file);
 		return 1;
 	}
 
+	timings_report(cmd, in_path, &decoded, &img);
 	yuv420_free(&img);
 	vp8_decoded_frame_free(&decoded);
 	os_unmap_file(file);
@@ -929,7 +1020,7 @@ static int cmd_diff_mb(const char* webp_path, const char* oracle_i420_path) {
 	for (uint32_t mb_r = 0; mb_r < mb_rows; mb_r++) {
 		for (uint32_t mb_c = 0; mb_c < mb_cols; mb_c++) {
 			uint32_t mb = mb_r * mb_cols + mb_c;
-			uint32_t seg = decoded.segmentation_enabled ? (uint32_t)(decoded.segment_id[mb] & 3u) : 0u;
+			uint32_t seg = decoded.segmentation_enabled ? (uint32_t)(decoded.mbs[mb].segment_id & 3u) : 0u;
 			if (seg > 3u) seg = 0u;
 			cnt[seg]++;
 
@@ -1016,13 +1107,202 @@ static int cmd_diff_mb(const char* webp_path, const char* oracle_i420_path) {
 	return 0;
 }
 
+
+// --- animated WebP (-anim_*) ---
+
+enum { ANIM_OUT_PNG = 0, ANIM_OUT_YUV = 1, ANIM_OUT_RGBA = 2 };
+
+typedef struct {
+	int mode;           // ANIM_OUT_*
+	const char* prefix; // per-frame outputs: <prefix>_NNNN.<ext>
+	uint32_t canvas_width;
+	uint32_t canvas_height;
+	OsWriter stream; // ANIM_OUT_RGBA: one canvas per frame, back to back
+} AnimOutput;
+
+// Builds "<prefix>_NNNN<ext>" (at least four digits). Returns 0 on success.
+static int anim_frame_path(char* out, size_t cap, const char* prefix, uint32_t index, const char* ext) {
+	char digits[FMT_U64_MAX];
+	const size_t nd = fmt_format_u64(digits, index);
+	const size_t pad = (nd < 4u) ? 4u - nd : 0u;
+	const size_t np = strlen(prefix);
+	const size_t ne = strlen(ext);
+	if (np + 1u + pad + nd + ne + 1u > cap) return -1;
+	size_t n = 0;
+	memcpy(out + n, prefix, np);
+	n += np;
+	out[n++] = '_';
+	for (size_t i = 0; i < pad; i++) out[n++] = '0';
+	memcpy(out + n, digits, nd);
+	n += nd;
+	memcpy(out + n, ext, ne + 1u);
+	return 0;
+}
+
+static int anim_write_frame(void* user, uint32_t index, const WebPAnimFrame* frame, const Yuv420Image* frame_yuv,
+                            const uint8_t* canvas_rgba) {
+	(void)frame;
+	AnimOutput* o = (AnimOutput*)user;
+	const size_t canvas_stride = (size_t)o->canvas_width * 4u;
+	if (o->mode == ANIM_OUT_RGBA) return os_writer_write(&o->stream, canvas_rgba, canvas_stride * o->canvas_height);
+
+	char path[4096];
+	if (anim_frame_path(path, sizeof(path), o->prefix, index, o->mode == ANIM_OUT_YUV ? ".i420" : ".png") != 0) {
+		fmt_write_str(2, "error: output prefix too long\n");
+		return -1;
+	}
+	const int fd = open_output(path);
+	if (fd < 0) {
+		fmt_write_str(2, "error: cannot open output file\n");
+		return -1;
+	}
+	int rc;
+	if (o->mode == ANIM_OUT_YUV) {
+		rc = write_i420(fd, frame_yuv);
+	} else {
+		OsWriter w;
+		os_writer_init(&w, fd, 0, g_out_flags);
+		rc = png_write_pixels(&w, canvas_rgba, o->canvas_width, o->canvas_height, canvas_stride, 4u);
+		if (os_writer_close(&w) != 0) rc = -1;
+	}
+	close_output(fd);
+	if (rc != 0) fmt_write_str(2, "error: write failed\n");
+	return rc;
+}
+
+static void anim_print_frame(uint32_t index, const WebPAnimFrame* f) {
+	fmt_write_str(1, "  Frame ");
+	fmt_write_u32(1, index);
+	fmt_write_str(1, ": ");
+	fmt_write_u32(1, f->width);
+	fmt_write_str(1, "x");
+	fmt_write_u32(1, f->height);
+	fmt_write_str(1, " at ");
+	fmt_write_u32(1, f->x);
+	fmt_write_str(1, ",");
+	fmt_write_u32(1, f->y);
+	fmt_write_str(1, ", ");
+	fmt_write_u32(1, f->duration_ms);
+	fmt_write_str(1, " ms, ");
+	fmt_write_str(1, f->blend ? "blend" : "no-blend");
+	fmt_write_str(1, f->dispose ? ", dispose background, " : ", dispose none, ");
+	fmt_write_str(1, f->lossless ? "VP8L" : "VP8");
+	if (f->alph_size) fmt_write_str(1, "+ALPH");
+	fmt_write_nl(1);
+}
+
+static int cmd_anim_info(const char* path) {
+	ByteSpan file;
+	if (os_map_file_readonly(path, &file) != 0) {
+		fmt_write_str(2, "error: cannot open/map file\n");
+		return 1;
+	}
+	WebPAnimation anim;
+	if (webp_parse_animation(file, &anim) != 0) {
+		fmt_write_str(2, "error: not a supported animated WebP (RIFF/WEBP + VP8X + ANIM + ANMF)\n");
+		os_unmap_file(file);
+		return 1;
+	}
+
+	fmt_write_str(1, "File: ");
+	fmt_write_str(1, path);
+	fmt_write_nl(1);
+	fmt_write_str(1, "Canvas: ");
+	fmt_write_u32(1, anim.canvas_width);
+	fmt_write_str(1, "x");
+	fmt_write_u32(1, anim.canvas_height);
+	fmt_write_nl(1);
+	fmt_write_str(1, "Loop count: ");
+	fmt_write_u32(1, anim.loop_count);
+	fmt_write_str(1, anim.loop_count ? "\n" : " (infinite)\n");
+	fmt_write_str(1, "Background (BGRA): ");
+	fmt_write_u32(1, anim.bgcolor);
+	fmt_write_nl(1);
+	fmt_write_str(1, "Frames: ");
+	fmt_write_u32(1, anim.frame_count);
+	fmt_write_nl(1);
+	for (uint32_t i = 0; i < anim.frame_count; i++) anim_print_frame(i, &anim.frames[i]);
+
+	webp_animation_free(&anim);
+	os_unmap_file(file);
+	return 0;
+}
+
+static int cmd_anim(const char* in_path, const char* out, int mode) {
+	if (mode != ANIM_OUT_RGBA && os_path_is_stdio(out)) {
+		fmt_write_str(2, "error: -anim_png/-anim_yuv write one file per frame and cannot write to stdout\n");
+		return 1;
+	}
+	ByteSpan file;
+	if (os_map_file_readonly(in_path, &file) != 0) {
+		fmt_write_str(2, "error: cannot open/map file\n");
+		return 1;
+	}
+	WebPAnimation anim;
+	if (webp_parse_animation(file, &anim) != 0) {
+		fmt_write_str(2, "error: not a supported animated WebP (RIFF/WEBP + VP8X + ANIM + ANMF)\n");
+		os_unmap_file(file);
+		return 1;
+	}
+
+	AnimOutput o;
+	memset(&o, 0, sizeof(o));
+	o.mode = mode;
+	o.prefix = out;
+	o.canvas_width = anim.canvas_width;
+	o.canvas_height = anim.canvas_height;
+	int fd = -1;
+	if (mode == ANIM_OUT_RGBA) {
+		fd = open_output(out);
+		if (fd < 0) {
+			fmt_write_str(2, "error: cannot open output file\n");
+			webp_animation_free(&anim);
+			os_unmap_file(file);
+			return 1;
+		}
+		os_writer_init(&o.stream, fd, 0, g_out_flags);
+		(void)os_writer_reserve(&o.stream, (uint64_t)anim.canvas_width * anim.canvas_height * 4u * anim.frame_count);
+	}
+
+	WebPAnimOptions opts;
+	opts.threads = g_threads;
+	opts.window = 0;
+	opts.composite = (mode != ANIM_OUT_YUV);
+	int rc = webp_anim_decode(file, &anim, &opts, anim_write_frame, &o);
+	if (rc != 0 && errno != ECANCELED) {
+		fmt_write_str(2, errno == ENOTSUP ? "error: unsupported animation frame (VP8L image or alpha)\n"
+		                                  : "error: animation frame decode failed\n");
+	}
+	if (fd >= 0) {
+		if (os_writer_close(&o.stream) != 0 && rc == 0) {
+			fmt_write_str(2, "error: write failed\n");
+			rc = -1;
+		}
+		close_output(fd);
+	}
+
+	webp_animation_free(&anim);
+	os_unmap_file(file);
+	return rc == 0 ? 0 : 1;
+}
+
 #endif
 
-int main(int argc, char** argv) {
+static int run(int argc, char** argv) {
 	if (argc < 3) {
 		usage();
 		return 2;
 	}
+	if (g_crop_set && !arg_eq(argv[1], "-yuv") && !arg_eq(argv[1], "-yuvf") && !arg_eq(argv[1], "-ppm") &&
+	    !arg_eq(argv[1], "-png") && !arg_eq(argv[1], "-pam")) {
+		fmt_write_str(2, "error: -crop only applies to -yuv, -yuvf, -ppm, -png and -pam\n");
+		return 2;
+	}
+	if (g_preview && ((!arg_eq(argv[1], "-yuv") && !arg_eq(argv[1], "-ppm") && !arg_eq(argv[1], "-png") &&
+	                   !arg_eq(argv[1], "-pam")) || g_crop_set)) {
+		fmt_write_str(2, "error: -preview only applies to -yuv, -ppm, -png and -pam (without -crop)\n");
+		return 2;
+	}
 	if (argv[1][0] == '-' && argv[1][1] == 'i' && argv[1][2] == 'n' && argv[1][3] == 'f' &&
 	    argv[1][4] == 'o' && argv[1][5] == '\0') {
 		if (argc != 3) {
@@ -1059,7 +1339,7 @@ int main(int argc, char** argv) {
 			usage();
 			return 2;
 		}
-		return cmd_yuv(argv[2], argv[3]);
+		return cmd_i420("yuv", argv[2], argv[3], 0);
 	}
 	if (argv[1][0] == '-' && argv[1][1] == 'y' && argv[1][2] == 'u' && argv[1][3] == 'v' && argv[1][4] == 'f' &&
 	    argv[1][5] == '\0') {
@@ -1067,7 +1347,7 @@ int main(int argc, char** argv) {
 			usage();
 			return 2;
 		}
-		return cmd_yuvf(argv[2], argv[3]);
+		return cmd_i420("yuvf", argv[2], argv[3], 1);
 	}
 
 #ifndef DECODER_TINY
@@ -1076,14 +1356,21 @@ int main(int argc, char** argv) {
 			usage();
 			return 2;
 		}
-		return cmd_ppm(argv[2], argv[3]);
+		return cmd_rgb("ppm", argv[2], argv[3], write_ppm, "error: PPM write failed\n");
 	}
 	if (argv[1][0] == '-' && argv[1][1] == 'p' && argv[1][2] == 'n' && argv[1][3] == 'g' && argv[1][4] == '\0') {
 		if (argc != 4) {
 			usage();
 			return 2;
 		}
-		return cmd_png(argv[2], argv[3]);
+		return cmd_rgb("png", argv[2], argv[3], yuv420_write_png_alpha, "error: PNG write failed\n");
+	}
+	if (arg_eq(argv[1], "-pam")) {
+		if (argc != 4) {
+			usage();
+			return 2;
+		}
+		return cmd_rgb("pam", argv[2], argv[3], yuv420_write_pam, "error: PAM write failed\n");
 	}
 	if (argv[1][0] == '-' && argv[1][1] == 'd' && argv[1][2] == 'i' && argv[1][3] == 'f' && argv[1][4] == 'f' &&
 	    argv[1][5] == '_' && argv[1][6] == 'm' && argv[1][7] == 'b' && argv[1][8] == '\0') {
@@ -1093,8 +1380,59 @@ int main(int argc, char** argv) {
 		}
 		return cmd_diff_mb(argv[2], argv[3]);
 	}
+	if (arg_eq(argv[1], "-anim_info")) {
+		if (argc != 3) {
+			usage();
+			return 2;
+		}
+		return cmd_anim_info(argv[2]);
+	}
+	if (arg_eq(argv[1], "-anim_png") || arg_eq(argv[1], "-anim_yuv") || arg_eq(argv[1], "-anim_rgba")) {
+		if (argc != 4) {
+			usage();
+			return 2;
+		}
+		const int mode = arg_eq(argv[1], "-anim_png") ? ANIM_OUT_PNG
+		                 : arg_eq(argv[1], "-anim_yuv") ? ANIM_OUT_YUV
+		                                                : ANIM_OUT_RGBA;
+		return cmd_anim(argv[2], argv[3], mode);
+	}
 #endif
 	(void)errno;
 	usage();
 	return 2;
 }
+
+int main(int argc, char** argv) {
+	// Leading global options, e.g. `decoder -mmap_out -png in.webp out.png`.
+	while (argc > 1 && (arg_eq(argv[1], "-mmap_out") || arg_eq(argv[1], "-timings") || arg_eq(argv[1], "-threads") ||
+	                    arg_eq(argv[1], "-crop") || arg_eq(argv[1], "-preview"))) {
+		int used = 1;
+		if (arg_eq(argv[1], "-timings")) {
+			g_timings_enabled = 1;
+		} else if (arg_eq(argv[1], "-preview")) {
+			g_preview = 1;
+		} else if (arg_eq(argv[1], "-threads")) {
+			if (argc < 3) break;
+			g_threads = (uint32_t)strtoul(argv[2], NULL, 10);
+			used = 2;
+		} else if (arg_eq(argv[1], "-crop")) {
+			if (argc < 3) break;
+			if (parse_crop(argv[2], &g_crop) != 0) {
+				fmt_write_str(2, "error: -crop expects x,y,w,h with w,h > 0\n");
+				(void)fmt_flush();
+				return 2;
+			}
+			g_crop_set = 1;
+			used = 2;
+		} else {
+			g_out_flags |= OS_WRITER_MMAP;
+		}
+		argv[used] = argv[0];
+		argv += used;
+		argc -= used;
+	}
+	int rc = run(argc, argv);
+	if (fmt_flush() != 0 && rc == 0) rc = 1;
+	return rc;
+}
@@ -1,5 +1,6 @@
 
 #include "common/os.h"
+#include "common/timing.h"
 #include "m01_container/webp_container.h"
 #include "m02_vp8_header/vp8_header.h"
 #include "m06_recon/vp8_recon.h"
@@ -8,12 +9,47 @@
 #include <fcntl.h>
 #include <unistd.h>
 
+#if DECODER_TIMINGS
+// Set by a leading `-timings` (only in builds with -DDECODER_TIMINGS=1).
+static DecTimings* g_timings;
+
+static int arg_eq(const char* a, const char* b) {
+	while (*a && *a == *b) {
+		a++;
+		b++;
+	}
+	return *a == *b;
+}
+
+static void timings_report(const char* path, const Vp8DecodedFrame* decoded, const Yuv420Image* img, int fd) {
+	DecTimings* t = g_timings;
+	dec_timing_end(t);
+	const Vp8CoeffStats* cs = &decoded->stats;
+	t->width = img->width;
+	t->height = img->height;
+	t->bool_decodes = cs->bool_decodes;
+	t->tokens = cs->coeff_tokens;
+	t->nonzero_blocks =
+	    (uint64_t)cs->blocks_nonzero_y2 + cs->blocks_nonzero_y + cs->blocks_nonzero_u + cs->blocks_nonzero_v;
+	const off_t end = lseek(fd, 0, SEEK_CUR);
+	t->bytes_written = (end > 0) ? (uint64_t)end : 0;
+	(void)dec_timings_write_json(2, t, "png", path);
+}
+#endif
+
 static int cmd_png(const char* in_path, const char* out_path) {
+#if DECODER_TIMINGS
+	if (g_timings) {
+		dec_timing_begin(g_timings);
+		(void)dec_timing_switch(DEC_STAGE_FILE_MAP);
+	}
+#endif
 	ByteSpan file;
 	if (os_map_file_readonly(in_path, &file) != 0) {
 		return 1;
 	}
 
+	(void)dec_timing_switch(DEC_STAGE_CONTAINER);
 	WebPContainer c;
 	int rc = webp_parse_simple_lossy(file, &c);
 	if (rc != 0) {
@@ -26,6 +62,7 @@ static int cmd_png(const char* in_path, const char* out_path) {
 		.size = c.vp8_chunk_size,
 	};
 
+	(void)dec_timing_switch(DEC_STAGE_HEADER);
 	Vp8KeyFrameHeader kf;
 	if (vp8_parse_keyframe_header(vp8_payload, &kf) != 0 || !kf.is_key_frame) {
 		os_unmap_file(file);
@@ -38,6 +75,7 @@ static int cmd_png(const char* in_path, const char* out_path) {
 		return 1;
 	}
 
+	(void)dec_timing_switch(DEC_STAGE_RECON);
 	Yuv420Image img;
 	// Match dwebp default output: filtered reconstruction.
 	rc = vp8_reconstruct_keyframe_yuv_filtered(&kf, &decoded, &img);
@@ -47,7 +85,8 @@ static int cmd_png(const char* in_path, const char* out_path) {
 		return 1;
 	}
 
-	int fd = open(out_path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	(void)dec_timing_switch(DEC_STAGE_WRITE);
+	int fd = os_path_is_stdio(out_path) ? 1 : open(out_path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
 	if (fd < 0) {
 		yuv420_free(&img);
 		vp8_decoded_frame_free(&decoded);
@@ -56,7 +95,10 @@ static int cmd_png(const char* in_path, const char* out_path) {
 	}
 
 	int wrc = yuv420_write_png_fd(fd, &img);
-	(void)close(fd);
+#if DECODER_TIMINGS
+	if (g_timings && wrc == 0) timings_report(in_path, &decoded, &img, fd);
+#endif
+	if (fd != 1) (void)close(fd);
 
 	yuv420_free(&img);
 	vp8_decoded_frame_free(&decoded);
@@ -65,6 +107,14 @@ static int cmd_png(const char* in_path, const char* out_path) {
 }
 
 int main(int argc, char** argv) {
+#if DECODER_TIMINGS
+	static DecTimings timings;
+	if (argc == 4 && arg_eq(argv[1], "-timings")) {
+		g_timings = &timings;
+		argv++;
+		argc--;
+	}
+#endif
 	if (argc != 3) return 2;
 	return cmd_png(argv[1], argv[2]);
 }
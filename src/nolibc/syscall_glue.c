@@ -9,6 +9,8 @@
 #include <sys/mman.h>
 #include <sys/stat.h>
 #include <sys/types.h>
+#include <sys/uio.h>
+#include <time.h>
 
 // --- errno support (glibc headers typically implement `errno` via __errno_location) ---
 int* __errno_location(void) {
@@ -35,17 +37,25 @@ static inline long sys_call1(long n, long a1) { return sys_call6(n, a1, 0, 0, 0,
 enum {
 	__NR_read = 0,
 	__NR_write = 1,
+	__NR_pread64 = 17,
 	__NR_open = 2,
 	__NR_close = 3,
 	__NR_lseek = 8,
 	__NR_mmap = 9,
 	__NR_munmap = 11,
+	__NR_madvise = 28,
+	__NR_writev = 20,
+	__NR_ftruncate = 77,
+	__NR_clock_gettime = 228,
 	__NR_fstat = 5,
 	__NR_exit = 60,
 	__NR_openat = 257,
 };
 
 static inline long sys_read(long fd, void* buf, unsigned long len) { return sys_call3(__NR_read, fd, (long)buf, (long)len); }
+static inline long sys_pread(long fd, void* buf, unsigned long len, long off) {
+	return sys_call6(__NR_pread64, fd, (long)buf, (long)len, off, 0, 0);
+}
 static inline long sys_write(long fd, const void* buf, unsigned long len) {
 	return sys_call3(__NR_write, fd, (long)buf, (long)len);
 }
@@ -59,6 +69,16 @@ static inline long sys_mmap(void* addr, size_t len, long prot, long flags, long
 	return sys_call6(__NR_mmap, (long)addr, (long)len, prot, flags, fd, off);
 }
 static inline long sys_munmap(void* addr, size_t len) { return sys_call3(__NR_munmap, (long)addr, (long)len, 0); }
+static inline long sys_madvise(void* addr, size_t len, long advice) {
+	return sys_call3(__NR_madvise, (long)addr, (long)len, advice);
+}
+static inline long sys_writev(long fd, const struct iovec* iov, long iovcnt) {
+	return sys_call3(__NR_writev, fd, (long)iov, iovcnt);
+}
+static inline long sys_ftruncate(long fd, long len) { return sys_call3(__NR_ftruncate, fd, len, 0); }
+static inline long sys_clock_gettime(long clk, struct timespec* ts) {
+	return sys_call3(__NR_clock_gettime, clk, (long)ts, 0);
+}
 
 __attribute__((noreturn)) void _exit(int code) {
 	(void)sys_call1(__NR_exit, code);
@@ -76,6 +96,15 @@ ssize_t read(int fd, void* buf, size_t count) {
 	return (ssize_t)r;
 }
 
+ssize_t pread(int fd, void* buf, size_t count, off_t offset) {
+	long r = sys_pread(fd, buf, (unsigned long)count, (long)offset);
+	if (r < 0) {
+		*__errno_location() = (int)-r;
+		return -1;
+	}
+	return (ssize_t)r;
+}
+
 ssize_t write(int fd, const void* buf, size_t count) {
 	long r = sys_write(fd, buf, (unsigned long)count);
 	if (r < 0) {
@@ -85,6 +114,15 @@ ssize_t write(int fd, const void* buf, size_t count) {
 	return (ssize_t)r;
 }
 
+ssize_t writev(int fd, const struct iovec* iov, int iovcnt) {
+	long r = sys_writev(fd, iov, iovcnt);
+	if (r < 0) {
+		*__errno_location() = (int)-r;
+		return -1;
+	}
+	return (ssize_t)r;
+}
+
 int close(int fd) {
 	long r = sys_close(fd);
 	if (r < 0) {
@@ -103,6 +141,15 @@ int fstat(int fd, struct stat* st) {
 	return 0;
 }
 
+int ftruncate(int fd, off_t length) {
+	long r = sys_ftruncate(fd, (long)length);
+	if (r < 0) {
+		*__errno_location() = (int)-r;
+		return -1;
+	}
+	return 0;
+}
+
 off_t lseek(int fd, off_t offset, int whence) {
 	long r = sys_lseek(fd, (long)offset, whence);
 	if (r < 0) {
@@ -148,6 +195,25 @@ int munmap(void* addr, size_t length) {
 	return 0;
 }
 
+int madvise(void* addr, size_t length, int advice) {
+	long r = sys_madvise(addr, length, advice);
+	if (r < 0) {
+		*__errno_location() = (int)-r;
+		return -1;
+	}
+	return 0;
+}
+
+// Plain syscall (no vDSO); only `-timings` reads the clock.
+int clock_gettime(clockid_t clk, struct timespec* ts) {
+	long r = sys_clock_gettime((long)clk, ts);
+	if (r < 0) {
+		*__errno_location() = (int)-r;
+		return -1;
+	}
+	return 0;
+}
+
 // --- tiny libc shims (no external libc) ---
 
 void* memmove(void* dst, const void* src, size_t n) {
@@ -222,6 +288,18 @@ unsigned long strtoul(const char* nptr, char** endptr, int base) {
 	return v;
 }
 
+// --- environment (envp is stored by start.S) ---
+char** __nolibc_environ;
+
+char* getenv(const char* name) {
+	if (!name || !__nolibc_environ) return NULL;
+	const size_t n = strlen(name);
+	for (char** e = __nolibc_environ; *e; e++) {
+		if (memcmp(*e, name, n) == 0 && (*e)[n] == '=') return *e + n + 1;
+	}
+	return NULL;
+}
+
 static size_t align16(size_t n) { return (n + 15u) & ~(size_t)15u; }
 
 void* malloc(size_t size) {
@@ -0,0 +1,201 @@
+#include "webpdec.h"
+
+#include <errno.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "common/os.h"
+#include "m01_container/webp_container.h"
+#include "m02_vp8_header/vp8_header.h"
+#include "m05_tokens/vp8_tokens.h"
+#include "m06_recon/vp8_recon.h"
+#include "m08_yuv2rgb_ppm/yuv2rgb_ppm.h"
+#include "m11_alpha/webp_alpha.h"
+
+typedef struct {
+	Vp8KeyFrameHeader kf;
+	ByteSpan vp8_payload;
+	ByteSpan alph_payload; // size 0 without an ALPH chunk
+} WebpDecInput;
+
+static int parse_input(const uint8_t* data, size_t size, WebpDecInput* in) {
+	if (!data || size == 0) {
+		errno = EINVAL;
+		return -1;
+	}
+	ByteSpan file = {.data = data, .size = size};
+	WebPContainer c;
+	if (webp_parse_simple_lossy(file, &c) != 0) return -1;
+
+	in->vp8_payload.data = data + c.vp8_chunk_offset;
+	in->vp8_payload.size = c.vp8_chunk_size;
+	in->alph_payload.data = data + c.alph_chunk_offset;
+	in->alph_payload.size = c.alph_chunk_size;
+	if (vp8_parse_keyframe_header(in->vp8_payload, &in->kf) != 0) return -1;
+	if (!in->kf.is_key_frame) {
+		errno = ENOTSUP;
+		return -1;
+	}
+	return 0;
+}
+
+int webp_get_info(const uint8_t* data, size_t size, uint32_t* width, uint32_t* height) {
+	WebpDecInput in;
+	if (parse_input(data, size, &in) != 0) return -1;
+	if (width) *width = in.kf.width;
+	if (height) *height = in.kf.height;
+	return 0;
+}
+
+// Resolves the requested rectangle (NULL: the whole frame) against the frame size.
+static int input_rect(const WebpDecInput* in, const WebpDecRect* crop, Vp8Rect* out) {
+	if (!crop) {
+		*out = (Vp8Rect){0, 0, in->kf.width, in->kf.height};
+		return 0;
+	}
+	if (crop->width == 0 || crop->height == 0 || crop->x >= in->kf.width || crop->y >= in->kf.height ||
+	    crop->width > in->kf.width - crop->x || crop->height > in->kf.height - crop->y) {
+		errno = EINVAL;
+		return -1;
+	}
+	*out = (Vp8Rect){crop->x, crop->y, crop->width, crop->height};
+	return 0;
+}
+
+// bytes_per_pixel 4 takes alpha from the ALPH chunk (premultiplied on request).
+static int decode_rgb(const uint8_t* data, size_t size, const WebpDecRect* crop, uint8_t* out, size_t stride,
+                      size_t out_size, uint32_t bytes_per_pixel, int premultiply) {
+	WebpDecInput in;
+	Vp8Rect r;
+	if (!out) {
+		errno = EINVAL;
+		return -1;
+	}
+	if (parse_input(data, size, &in) != 0 || input_rect(&in, crop, &r) != 0) return -1;
+	const size_t row_bytes = (size_t)r.width * bytes_per_pixel;
+	if (r.width == 0 || r.height == 0 || stride < row_bytes || out_size < row_bytes ||
+	    (size_t)(r.height - 1u) > (out_size - row_bytes) / stride) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	// The upsampler needs the pixels around the crop, so a crop reconstructs a
+	// slightly larger window and converts `rect` (the crop inside it).
+	Vp8Rect window = {0, 0, in.kf.width, in.kf.height};
+	if (crop) yuv420_rgb_window(&r, in.kf.width, in.kf.height, &window);
+	const Vp8Rect rect = {r.x - window.x, r.y - window.y, r.width, r.height};
+
+	WebPAlphaRows alpha;
+	const int has_alpha = bytes_per_pixel == 4u && in.alph_payload.size != 0;
+	if (has_alpha && webp_alpha_rows_init(&alpha, in.alph_payload, in.kf.width, in.kf.height) != 0) return -1;
+	if (has_alpha && crop) webp_alpha_rows_crop(&alpha, r.x, r.y);
+
+	Vp8MbExtent extent = {0, UINT32_MAX, 0};
+	if (crop) vp8_rect_mb_extent(&in.kf, &window, 1, &extent);
+	Vp8DecodedFrame decoded;
+	if (vp8_decode_decoded_frame_rows(in.vp8_payload, extent.mb_rows, &decoded) != 0) {
+		if (has_alpha) webp_alpha_rows_free(&alpha);
+		return -1;
+	}
+
+	// The upsampler needs whole chroma rows, so go through a YUV frame first.
+	Yuv420Image img;
+	int rc;
+	if (crop) {
+		rc = yuv420_alloc(&img, window.width, window.height);
+		if (rc == 0 && vp8_reconstruct_keyframe_rect(&in.kf, &decoded, 1, &window, &img) != 0) {
+			yuv420_free(&img);
+			rc = -1;
+		}
+	} else {
+		rc = vp8_reconstruct_keyframe_yuv_filtered(&in.kf, &decoded, &img);
+	}
+	vp8_decoded_frame_free(&decoded);
+	if (rc == 0) {
+		rc = (bytes_per_pixel == 4u) ? yuv420_to_rgba(&img, &rect, has_alpha ? &alpha : NULL, premultiply, out, stride)
+		                             : yuv420_to_rgb(&img, &rect, out, stride, 3u);
+		yuv420_free(&img);
+	}
+	if (has_alpha) webp_alpha_rows_free(&alpha);
+	return rc;
+}
+
+int webp_decode_into_rgba(const uint8_t* data, size_t size, uint8_t* out, size_t stride, size_t out_size) {
+	return decode_rgb(data, size, NULL, out, stride, out_size, 4u, 0);
+}
+
+int webp_decode_into_rgba_premultiplied(const uint8_t* data, size_t size, uint8_t* out, size_t stride,
+                                        size_t out_size) {
+	return decode_rgb(data, size, NULL, out, stride, out_size, 4u, 1);
+}
+
+int webp_decode_into_rgb(const uint8_t* data, size_t size, uint8_t* out, size_t stride, size_t out_size) {
+	return decode_rgb(data, size, NULL, out, stride, out_size, 3u, 0);
+}
+
+static int decode_i420(const uint8_t* data, size_t size, const WebpDecRect* crop, uint8_t* y, size_t y_stride,
+                       uint8_t* u, uint8_t* v, size_t uv_stride) {
+	WebpDecInput in;
+	Vp8Rect r;
+	if (!y || !u || !v) {
+		errno = EINVAL;
+		return -1;
+	}
+	if (parse_input(data, size, &in) != 0 || input_rect(&in, crop, &r) != 0) return -1;
+	if (y_stride > UINT32_MAX || uv_stride > UINT32_MAX || ((r.x | r.y) & 1u)) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	// Planes are written in place; vp8_reconstruct_keyframe_into() validates strides.
+	const Yuv420Image dst = {
+		.width = r.width,
+		.height = r.height,
+		.stride_y = (uint32_t)y_stride,
+		.stride_uv = (uint32_t)uv_stride,
+		.y = y,
+		.u = u,
+		.v = v,
+	};
+
+	Vp8MbExtent extent = {0, UINT32_MAX, 0};
+	if (crop) vp8_rect_mb_extent(&in.kf, &r, 1, &extent);
+	Vp8DecodedFrame decoded;
+	if (vp8_decode_decoded_frame_rows(in.vp8_payload, extent.mb_rows, &decoded) != 0) return -1;
+	int rc = crop ? vp8_reconstruct_keyframe_rect(&in.kf, &decoded, 1, &r, &dst)
+	              : vp8_reconstruct_keyframe_into(&in.kf, &decoded, 1, &dst);
+	vp8_decoded_frame_free(&decoded);
+	return rc;
+}
+
+int webp_decode_into_i420(const uint8_t* data, size_t size, uint8_t* y, size_t y_stride, uint8_t* u, uint8_t* v,
+                          size_t uv_stride) {
+	return decode_i420(data, size, NULL, y, y_stride, u, v, uv_stride);
+}
+
+int webp_decode_crop_into_rgba(const uint8_t* data, size_t size, const WebpDecRect* crop, uint8_t* out, size_t stride,
+                               size_t out_size) {
+	if (!crop) {
+		errno = EINVAL;
+		return -1;
+	}
+	return decode_rgb(data, size, crop, out, stride, out_size, 4u, 0);
+}
+
+int webp_decode_crop_into_rgb(const uint8_t* data, size_t size, const WebpDecRect* crop, uint8_t* out, size_t stride,
+                              size_t out_size) {
+	if (!crop) {
+		errno = EINVAL;
+		return -1;
+	}
+	return decode_rgb(data, size, crop, out, stride, out_size, 3u, 0);
+}
+
+int webp_decode_crop_into_i420(const uint8_t* data, size_t size, const WebpDecRect* crop, uint8_t* y, size_t y_stride,
+                               uint8_t* u, uint8_t* v, size_t uv_stride) {
+	if (!crop) {
+		errno = EINVAL;
+		return -1;
+	}
+	return decode_i420(data, size, crop, y, y_stride, u, v, uv_stride);
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Public decoding API (build/libwebpdec.a, optionally build/libwebpdec.so).
+//
+// Supports the same inputs as the `decoder` CLI: still lossy WebP (a single VP8
+// key frame, optionally in the VP8X layout with an uncompressed ALPH chunk).
+// Output always matches `decoder -yuvf` / `-ppm` / `-pam` (loop-filtered,
+// libwebp-compatible fancy upsampling).
+//
+// All functions return 0 on success and -1 on failure with errno set
+// (EINVAL: bad arguments, too-small output or unsupported/corrupt input;
+// ENOTSUP: unsupported VP8 feature or VP8L-compressed alpha; ENOMEM).
+
+#if defined(WEBPDEC_BUILD) && defined(__GNUC__)
+#define WEBPDEC_API __attribute__((visibility("default")))
+#else
+#define WEBPDEC_API
+#endif
+
+// Pixel rectangle [x, x+width) x [y, y+height) for the *_crop_* functions.
+typedef struct {
+	uint32_t x;
+	uint32_t y;
+	uint32_t width;
+	uint32_t height;
+} WebpDecRect;
+
+// Reads the frame dimensions without decoding.
+WEBPDEC_API int webp_get_info(const uint8_t* data, size_t size, uint32_t* width, uint32_t* height);
+
+// Decodes into caller-owned interleaved RGBA with straight alpha (255 without
+// an ALPH chunk). Row y starts at out + y*stride; stride >= width*4 and
+// out_size >= stride*(height-1) + width*4.
+WEBPDEC_API int webp_decode_into_rgba(const uint8_t* data, size_t size, uint8_t* out, size_t stride, size_t out_size);
+
+// Same as webp_decode_into_rgba(), but with R/G/B premultiplied by alpha
+// (libwebp's MODE_rgbA rounding).
+WEBPDEC_API int webp_decode_into_rgba_premultiplied(const uint8_t* data, size_t size, uint8_t* out, size_t stride,
+                                                    size_t out_size);
+
+// Same as webp_decode_into_rgba(), but 3 bytes per pixel without alpha (stride >= width*3).
+WEBPDEC_API int webp_decode_into_rgb(const uint8_t* data, size_t size, uint8_t* out, size_t stride, size_t out_size);
+
+// Decodes into caller-owned I420 planes. The Y plane needs `height` rows of
+// y_stride >= width bytes; U and V need (height+1)/2 rows of
+// uv_stride >= (width+1)/2 bytes.
+WEBPDEC_API int webp_decode_into_i420(const uint8_t* data, size_t size, uint8_t* y, size_t y_stride, uint8_t* u,
+                                      uint8_t* v, size_t uv_stride);
+
+// Region-of-interest variants: decode only `crop` (which must lie inside the
+// frame) into an output of crop->width x crop->height. Macroblock rows below
+// the rectangle are not token-decoded and macroblocks to its right are only
+// reconstructed where the ones inside depend on them. Pixels equal the same
+// rectangle of the corresponding full decode.
+WEBPDEC_API int webp_decode_crop_into_rgba(const uint8_t* data, size_t size, const WebpDecRect* crop, uint8_t* out,
+                                           size_t stride, size_t out_size);
+WEBPDEC_API int webp_decode_crop_into_rgb(const uint8_t* data, size_t size, const WebpDecRect* crop, uint8_t* out,
+                                          size_t stride, size_t out_size);
+
+// I420 crop; crop->x and crop->y must be even (chroma is cut on whole samples).
+WEBPDEC_API int webp_decode_crop_into_i420(const uint8_t* data, size_t size, const WebpDecRect* crop, uint8_t* y,
+                                           size_t y_stride, uint8_t* u, uint8_t* v, size_t uv_stride);
@@ -0,0 +1,428 @@
+// Compares every CPU level available on this machine (src/common/dsp.h and
+// src/common/enc_dsp.h) against the scalar reference kernels on deterministic
+// pseudo-random inputs.
+// Prints one line per level and exits non-zero on the first mismatch.
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../src/common/dsp.h"
+#include "../src/common/enc_dsp.h"
+
+static uint32_t xorshift32(uint32_t* s) {
+	uint32_t x = *s;
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+	*s = x;
+	return x;
+}
+
+static int fail(const char* level, const char* kernel, int iter) {
+	fprintf(stderr, "FAIL: %s %s differs from scalar (case %d)\n", level, kernel, iter);
+	return 1;
+}
+
+static int check_transforms(const Vp8Dsp* ref, const Vp8Dsp* dsp, const char* name, uint32_t* seed) {
+	for (int iter = 0; iter < 20000; iter++) {
+		int16_t in[16];
+		int16_t a[16];
+		int16_t b[16];
+		// Alternate realistic dequantized ranges with the full int16 range.
+		const uint32_t mask = (iter & 1) ? 0xFFFFu : 0x0FFFu;
+		for (int i = 0; i < 16; i++) {
+			uint32_t r = xorshift32(seed) & mask;
+			in[i] = (mask == 0xFFFFu) ? (int16_t)r : (int16_t)((int32_t)r - 2048);
+		}
+		ref->inv_dct4x4(in, a);
+		dsp->inv_dct4x4(in, b);
+		if (memcmp(a, b, sizeof(a)) != 0) return fail(name, "inv_dct4x4", iter);
+		ref->inv_wht4x4(in, a);
+		dsp->inv_wht4x4(in, b);
+		if (memcmp(a, b, sizeof(a)) != 0) return fail(name, "inv_wht4x4", iter);
+	}
+	return 0;
+}
+
+// Edges are random, flat (DC rounding, TM without clamping) or 0/255 extremes
+// (TM clamping); the predictors write into a wider plane so that a store past
+// the block shows up as a difference.
+enum { PRED_STRIDE = 40 };
+
+static void fill_pred_edge(uint8_t* p, size_t n, int kind, uint32_t* seed) {
+	const uint8_t flat = (uint8_t)xorshift32(seed);
+	for (size_t i = 0; i < n; i++) {
+		const uint32_t r = xorshift32(seed);
+		p[i] = kind == 0 ? (uint8_t)r : kind == 1 ? (uint8_t)(flat + (r & 3u)) : (uint8_t)((r & 1u) ? 255u : 0u);
+	}
+}
+
+static int check_predictors(const Vp8Dsp* ref, const Vp8Dsp* dsp, const char* name, uint32_t* seed) {
+	uint8_t edge[1 + 16 + 16]; // A[-1], A[0..15], L[0..15]
+	uint8_t a[18 * PRED_STRIDE];
+	uint8_t b[18 * PRED_STRIDE];
+	for (int iter = 0; iter < 20000; iter++) {
+		fill_pred_edge(edge, sizeof(edge), iter % 3, seed);
+		const uint8_t* A = edge + 1;
+		const uint8_t* L = edge + 17;
+		for (int mode = 0; mode < VP8_PRED_COUNT; mode++) {
+			memset(a, 0x5A, sizeof(a));
+			memset(b, 0x5A, sizeof(b));
+			ref->pred16[mode](a + PRED_STRIDE + 1, PRED_STRIDE, A, L);
+			dsp->pred16[mode](b + PRED_STRIDE + 1, PRED_STRIDE, A, L);
+			if (memcmp(a, b, sizeof(a)) != 0) return fail(name, "pred16", iter);
+			memset(a, 0x5A, sizeof(a));
+			memset(b, 0x5A, sizeof(b));
+			ref->pred8[mode](a + PRED_STRIDE + 1, PRED_STRIDE, A, L);
+			dsp->pred8[mode](b + PRED_STRIDE + 1, PRED_STRIDE, A, L);
+			if (memcmp(a, b, sizeof(a)) != 0) return fail(name, "pred8", iter);
+		}
+		// Mode 10 and up is not a B_PRED mode; both fall back to 128.
+		for (uint8_t mode = 0; mode <= 10; mode++) {
+			uint8_t ba[4][4], bb[4][4];
+			ref->subblock_predict(ba, A, L, mode);
+			dsp->subblock_predict(bb, A, L, mode);
+			if (memcmp(ba, bb, sizeof(ba)) != 0) return fail(name, "subblock_predict", iter);
+		}
+	}
+	return 0;
+}
+
+// 8 rows of context on each side of the edge; pixels are a smooth ramp plus
+// small noise so every filter branch (mask, hev, mb taps) is taken.
+enum { LF_STRIDE = 48, LF_ROWS = 24 };
+
+static void fill_edge(uint8_t* buf, uint32_t* seed) {
+	const uint32_t noise = 1u + (xorshift32(seed) % 48u);
+	const int base = (int)(xorshift32(seed) & 0xFFu);
+	const int step = (int)(xorshift32(seed) % 41u) - 20;
+	for (int y = 0; y < LF_ROWS; y++) {
+		for (int x = 0; x < LF_STRIDE; x++) {
+			int v = base + (y >= LF_ROWS / 2 ? step : 0) + (int)(xorshift32(seed) % noise) - (int)(noise / 2u);
+			buf[y * LF_STRIDE + x] = (uint8_t)(v < 0 ? 0 : (v > 255 ? 255 : v));
+		}
+	}
+}
+
+static int check_loopfilter(const Vp8Dsp* ref, const Vp8Dsp* dsp, const char* name, uint32_t* seed) {
+	uint8_t src[LF_ROWS * LF_STRIDE];
+	uint8_t a[LF_ROWS * LF_STRIDE];
+	uint8_t b[LF_ROWS * LF_STRIDE];
+	for (int iter = 0; iter < 20000; iter++) {
+		fill_edge(src, seed);
+		const int edge_limit = (int)(xorshift32(seed) % 66u);
+		const int interior_limit = (int)(xorshift32(seed) % 64u);
+		const int hev_threshold = (int)(xorshift32(seed) % 4u);
+		const int size_blocks = 1 + (int)(xorshift32(seed) & 1u);
+		// q0 in the middle row, at a column that leaves room for vertical edges too.
+		const size_t q0 = (size_t)(LF_ROWS / 2) * LF_STRIDE + 8u;
+
+		const struct {
+			const char* kernel;
+			Vp8LfNormalFn ref_fn;
+			Vp8LfNormalFn fn;
+			int stride;
+		} normal[] = {
+		    {"lf_mb_h_edge", ref->lf_mb_h_edge, dsp->lf_mb_h_edge, LF_STRIDE},
+		    {"lf_subblock_h_edge", ref->lf_subblock_h_edge, dsp->lf_subblock_h_edge, LF_STRIDE},
+		    {"lf_mb_v_edge", ref->lf_mb_v_edge, dsp->lf_mb_v_edge, LF_STRIDE},
+		    {"lf_subblock_v_edge", ref->lf_subblock_v_edge, dsp->lf_subblock_v_edge, LF_STRIDE},
+		};
+		for (size_t k = 0; k < sizeof(normal) / sizeof(normal[0]); k++) {
+			// The v-edge kernels walk rows: start them higher so 16 rows fit.
+			const size_t at = (k >= 2) ? 4u * LF_STRIDE + 8u : q0;
+			memcpy(a, src, sizeof(src));
+			memcpy(b, src, sizeof(src));
+			normal[k].ref_fn(a + at, normal[k].stride, edge_limit, interior_limit, hev_threshold, size_blocks);
+			normal[k].fn(b + at, normal[k].stride, edge_limit, interior_limit, hev_threshold, size_blocks);
+			if (memcmp(a, b, sizeof(a)) != 0) return fail(name, normal[k].kernel, iter);
+		}
+
+		const int filter_limit = (int)(xorshift32(seed) % 200u);
+		memcpy(a, src, sizeof(src));
+		memcpy(b, src, sizeof(src));
+		ref->lf_simple_h_edge(a + q0, LF_STRIDE, filter_limit);
+		dsp->lf_simple_h_edge(b + q0, LF_STRIDE, filter_limit);
+		if (memcmp(a, b, sizeof(a)) != 0) return fail(name, "lf_simple_h_edge", iter);
+		memcpy(a, src, sizeof(src));
+		memcpy(b, src, sizeof(src));
+		ref->lf_simple_v_edge(a + 4u * LF_STRIDE + 8u, LF_STRIDE, filter_limit);
+		dsp->lf_simple_v_edge(b + 4u * LF_STRIDE + 8u, LF_STRIDE, filter_limit);
+		if (memcmp(a, b, sizeof(a)) != 0) return fail(name, "lf_simple_v_edge", iter);
+	}
+	return 0;
+}
+
+enum { UP_MAX_LEN = 130 };
+
+static int check_upsampler(const Vp8Dsp* ref, const Vp8Dsp* dsp, const char* name, uint32_t* seed) {
+	uint8_t y0[UP_MAX_LEN], y1[UP_MAX_LEN];
+	uint8_t tu[UP_MAX_LEN / 2 + 1], tv[UP_MAX_LEN / 2 + 1], cu[UP_MAX_LEN / 2 + 1], cv[UP_MAX_LEN / 2 + 1];
+	uint8_t a_top[UP_MAX_LEN * 4], a_bot[UP_MAX_LEN * 4];
+	uint8_t b_top[UP_MAX_LEN * 4], b_bot[UP_MAX_LEN * 4];
+	for (int iter = 0; iter < 20000; iter++) {
+		const uint32_t len = 1u + xorshift32(seed) % UP_MAX_LEN;
+		const uint32_t step = (iter & 1) ? 4u : 3u;
+		const int with_bottom = (iter & 2) != 0;
+		for (uint32_t i = 0; i < UP_MAX_LEN; i++) {
+			y0[i] = (uint8_t)xorshift32(seed);
+			y1[i] = (uint8_t)xorshift32(seed);
+		}
+		for (uint32_t i = 0; i < UP_MAX_LEN / 2 + 1; i++) {
+			tu[i] = (uint8_t)xorshift32(seed);
+			tv[i] = (uint8_t)xorshift32(seed);
+			cu[i] = (uint8_t)xorshift32(seed);
+			cv[i] = (uint8_t)xorshift32(seed);
+		}
+		// Untouched bytes (alpha, past the row) must stay identical too.
+		memset(a_top, 0x5A, sizeof(a_top));
+		memset(a_bot, 0x5A, sizeof(a_bot));
+		memset(b_top, 0x5A, sizeof(b_top));
+		memset(b_bot, 0x5A, sizeof(b_bot));
+		ref->upsample_rgb_line_pair(y0, with_bottom ? y1 : NULL, tu, tv, cu, cv, a_top, with_bottom ? a_bot : NULL,
+		                            len, step);
+		dsp->upsample_rgb_line_pair(y0, with_bottom ? y1 : NULL, tu, tv, cu, cv, b_top, with_bottom ? b_bot : NULL,
+		                            len, step);
+		if (memcmp(a_top, b_top, sizeof(a_top)) != 0 || memcmp(a_bot, b_bot, sizeof(a_bot)) != 0) {
+			return fail(name, "upsample_rgb_line_pair", iter);
+		}
+	}
+	return 0;
+}
+
+static int check_checksums(const Vp8Dsp* ref, const Vp8Dsp* dsp, const char* name, uint32_t* seed) {
+	enum { BUF = 40000 };
+	uint8_t* buf = (uint8_t*)malloc(BUF);
+	if (!buf) {
+		fprintf(stderr, "alloc failed\n");
+		return 1;
+	}
+	for (int iter = 0; iter < 500; iter++) {
+		// Long runs of 0xFF are the worst case for the deferred Adler-32 modulo.
+		const int all_ff = (iter % 7) == 0;
+		for (size_t i = 0; i < BUF; i++) buf[i] = all_ff ? 0xFFu : (uint8_t)xorshift32(seed);
+		const size_t off = xorshift32(seed) % 16u;
+		const size_t len = xorshift32(seed) % (BUF - 16u);
+		const size_t split = len ? xorshift32(seed) % len : 0;
+
+		uint32_t ca = ref->crc32_update(0, buf + off, split);
+		ca = ref->crc32_update(ca, buf + off + split, len - split);
+		uint32_t cb = dsp->crc32_update(0, buf + off, split);
+		cb = dsp->crc32_update(cb, buf + off + split, len - split);
+		if (ca != cb) {
+			free(buf);
+			return fail(name, "crc32_update", iter);
+		}
+
+		uint32_t aa = 1, ab = 0, ba = 1, bb = 0;
+		ref->adler32_update(&aa, &ab, buf + off, split);
+		ref->adler32_update(&aa, &ab, buf + off + split, len - split);
+		dsp->adler32_update(&ba, &bb, buf + off, split);
+		dsp->adler32_update(&ba, &bb, buf + off + split, len - split);
+		if (aa != ba || ab != bb) {
+			free(buf);
+			return fail(name, "adler32_update", iter);
+		}
+	}
+	free(buf);
+	return 0;
+}
+
+enum { YUV_MAX_LEN = 150 };
+
+// Rows sit at the end of their buffers so that an over-read past the last
+// pixel shows up under ASan.
+static int check_enc_yuv(const EncDsp* ref, const EncDsp* dsp, const char* name, uint32_t* seed) {
+	uint8_t* rows = (uint8_t*)malloc(2u * YUV_MAX_LEN * 4u);
+	if (!rows) {
+		fprintf(stderr, "alloc failed\n");
+		return 1;
+	}
+	uint8_t ya[YUV_MAX_LEN], yb[YUV_MAX_LEN];
+	uint8_t ua[YUV_MAX_LEN / 2 + 1], va[YUV_MAX_LEN / 2 + 1], ub[YUV_MAX_LEN / 2 + 1], vb[YUV_MAX_LEN / 2 + 1];
+	for (int iter = 0; iter < 20000; iter++) {
+		const uint32_t width = 1u + xorshift32(seed) % YUV_MAX_LEN;
+		const uint32_t step = (iter & 1) ? 4u : 3u;
+		const size_t row_bytes = (size_t)width * step;
+		uint8_t* row1 = rows + 2u * YUV_MAX_LEN * 4u - row_bytes;
+		uint8_t* row0 = row1 - row_bytes;
+		// Some cases stick to 0/255 to exercise the U/V clipping.
+		const int extremes = (iter % 5) == 0;
+		for (size_t i = 0; i < 2u * row_bytes; i++) {
+			const uint32_t r = xorshift32(seed);
+			row0[i] = extremes ? (uint8_t)((r & 1u) ? 255u : 0u) : (uint8_t)r;
+		}
+		const uint8_t* bottom = (iter & 2) ? row1 : row0;
+
+		memset(ya, 0x5A, sizeof(ya));
+		memset(yb, 0x5A, sizeof(yb));
+		ref->rgb_to_y_row(row0, ya, width, step);
+		dsp->rgb_to_y_row(row0, yb, width, step);
+		if (memcmp(ya, yb, sizeof(ya)) != 0) {
+			free(rows);
+			return fail(name, "rgb_to_y_row", iter);
+		}
+
+		memset(ua, 0x5A, sizeof(ua));
+		memset(va, 0x5A, sizeof(va));
+		memset(ub, 0x5A, sizeof(ub));
+		memset(vb, 0x5A, sizeof(vb));
+		ref->rgb_to_uv_row(row0, bottom, ua, va, width, step);
+		dsp->rgb_to_uv_row(row0, bottom, ub, vb, width, step);
+		if (memcmp(ua, ub, sizeof(ua)) != 0 || memcmp(va, vb, sizeof(va)) != 0) {
+			free(rows);
+			return fail(name, "rgb_to_uv_row", iter);
+		}
+	}
+	free(rows);
+	return 0;
+}
+
+// Pixels are random, near-equal (small residuals) or 0/255 extremes; the
+// plane kernels read from a block at a random offset inside a wider plane.
+enum { DIST_STRIDE = 48 };
+
+static void fill_dist(uint8_t* dst, size_t n, const uint8_t* like, int kind, uint32_t* seed) {
+	for (size_t i = 0; i < n; i++) {
+		const uint32_t r = xorshift32(seed);
+		if (kind == 0) {
+			dst[i] = (uint8_t)r;
+		} else if (kind == 1 && like) {
+			const int v = (int)like[i] + (int)(r % 9u) - 4;
+			dst[i] = (uint8_t)(v < 0 ? 0 : (v > 255 ? 255 : v));
+		} else {
+			dst[i] = (r & 1u) ? 255u : 0u;
+		}
+	}
+}
+
+static int check_enc_distortion(const EncDsp* ref, const EncDsp* dsp, const char* name, uint32_t* seed) {
+	uint8_t plane[DIST_STRIDE * 24];
+	uint8_t pred[16 * 16];
+	uint8_t a4[16], b4[16];
+	int16_t res[16];
+	for (int iter = 0; iter < 200000; iter++) {
+		const int kind = iter % 3;
+		fill_dist(a4, 16, NULL, kind == 1 ? 0 : kind, seed);
+		fill_dist(b4, 16, a4, kind, seed);
+		// Realistic residuals, then the full int16 range for the pred + res clamp.
+		const uint32_t mask = (iter & 4) ? 0xFFFFu : 0x01FFu;
+		for (int i = 0; i < 16; i++) {
+			const uint32_t r = xorshift32(seed) & mask;
+			res[i] = (mask == 0xFFFFu) ? (int16_t)r : (int16_t)((int32_t)r - 256);
+		}
+		if (ref->sad4x4(a4, b4) != dsp->sad4x4(a4, b4)) return fail(name, "sad4x4", iter);
+		if (ref->satd4x4(a4, b4) != dsp->satd4x4(a4, b4)) return fail(name, "satd4x4", iter);
+		if (ref->sse4x4_recon(a4, b4, res) != dsp->sse4x4_recon(a4, b4, res)) return fail(name, "sse4x4_recon", iter);
+
+		if ((iter & 7) != 0) continue;
+		fill_dist(plane, sizeof(plane), NULL, kind == 1 ? 0 : kind, seed);
+		const size_t at = (size_t)(xorshift32(seed) % 8u) * DIST_STRIDE + xorshift32(seed) % 32u;
+		for (int y = 0; y < 16; y++) fill_dist(pred + y * 16, 16, plane + at + (size_t)y * DIST_STRIDE, kind, seed);
+		if (ref->sse16x16(plane + at, DIST_STRIDE, pred) != dsp->sse16x16(plane + at, DIST_STRIDE, pred)) {
+			return fail(name, "sse16x16", iter);
+		}
+		for (int y = 0; y < 8; y++) fill_dist(pred + y * 8, 8, plane + at + (size_t)y * DIST_STRIDE, kind, seed);
+		if (ref->sse8x8(plane + at, DIST_STRIDE, pred) != dsp->sse8x8(plane + at, DIST_STRIDE, pred)) {
+			return fail(name, "sse8x8", iter);
+		}
+		if (ref->sad8x8(plane + at, DIST_STRIDE, pred) != dsp->sad8x8(plane + at, DIST_STRIDE, pred)) {
+			return fail(name, "sad8x8", iter);
+		}
+	}
+	return 0;
+}
+
+// Division-based quantization as in enc_vp8_quantize4x4_inplace() and
+// bpred-rdo's AC deadzone; the reciprocal quantizers must match it exactly.
+static int16_t quant_div(int16_t c, int step, uint32_t zero_pct) {
+	if (step <= 0) return 0;
+	const int v = c < 0 ? -(int)c : (int)c;
+	if ((int64_t)v * 100 < (int64_t)step * (int64_t)zero_pct) return 0;
+	const int q = (v + (step >> 1)) / step;
+	return (int16_t)(c < 0 ? -q : q);
+}
+
+static int check_enc_transform_quant(const EncDsp* ref, const EncDsp* dsp, const char* name, uint32_t* seed) {
+	uint8_t plane[DIST_STRIDE * 24];
+	int16_t dc_in[16][16];
+	int16_t a[2][16], b[2][16];
+	for (int iter = 0; iter < 100000; iter++) {
+		const int kind = iter % 3;
+		if ((iter & 15) == 0) fill_dist(plane, sizeof(plane), NULL, kind == 1 ? 0 : kind, seed);
+		const uint8_t* src[2];
+		const uint8_t* pred[2];
+		for (int k = 0; k < 2; k++) {
+			src[k] = plane + (size_t)(xorshift32(seed) % 20u) * DIST_STRIDE + xorshift32(seed) % 44u;
+			pred[k] = plane + (size_t)(xorshift32(seed) % 20u) * DIST_STRIDE + xorshift32(seed) % 44u;
+		}
+		ref->ftransform4x4x2(src, DIST_STRIDE, pred, DIST_STRIDE, a);
+		dsp->ftransform4x4x2(src, DIST_STRIDE, pred, DIST_STRIDE, b);
+		if (memcmp(a, b, sizeof(a)) != 0) return fail(name, "ftransform4x4x2", iter);
+		dsp->ftransform4x4(src[1], DIST_STRIDE, pred[1], DIST_STRIDE, b[0]);
+		if (memcmp(a[1], b[0], sizeof(a[1])) != 0) return fail(name, "ftransform4x4", iter);
+
+		// Realistic DCT outputs, then the full int16 range.
+		const uint32_t mask = (iter & 1) ? 0xFFFFu : 0x0FFFu;
+		for (int n = 0; n < 16; n++) {
+			const uint32_t r = xorshift32(seed) & mask;
+			dc_in[n][0] = (mask == 0xFFFFu) ? (int16_t)r : (int16_t)((int32_t)r - 2048);
+		}
+		ref->ftransform_wht(&dc_in[0][0], a[0]);
+		dsp->ftransform_wht(&dc_in[0][0], b[0]);
+		if (memcmp(a[0], b[0], sizeof(a[0])) != 0) return fail(name, "ftransform_wht", iter);
+
+		// VP8 steps are at most 2047 (bpred-rdo's scaled ones); every few
+		// rounds cover the rest of the documented range, and step 0.
+		const uint32_t step_mod = (iter & 7) == 7 ? 32768u : 2048u;
+		const int dc_step = (int)(xorshift32(seed) % step_mod);
+		const int ac_step = (int)(xorshift32(seed) % step_mod);
+		const uint32_t zero_pct = (iter & 2) ? 1u + xorshift32(seed) % 99u : 0u;
+		EncDspQuant q;
+		enc_dsp_quant_init(&q, dc_step, ac_step, zero_pct);
+		for (int i = 0; i < 16; i++) {
+			const uint32_t r = xorshift32(seed) & mask;
+			a[1][i] = (mask == 0xFFFFu) ? (int16_t)r : (int16_t)((int32_t)r - 2048);
+			b[1][i] = quant_div(a[1][i], i == 0 ? dc_step : ac_step, i == 0 ? 0 : zero_pct);
+		}
+		memcpy(b[0], a[1], sizeof(a[1]));
+		ref->quantize4x4(a[1], &q);
+		if (memcmp(a[1], b[1], sizeof(a[1])) != 0) {
+			fprintf(stderr, "FAIL: scalar quantize4x4 differs from division (case %d)\n", iter);
+			return 1;
+		}
+		dsp->quantize4x4(b[0], &q);
+		if (memcmp(a[1], b[0], sizeof(a[1])) != 0) return fail(name, "quantize4x4", iter);
+	}
+	return 0;
+}
+
+int main(void) {
+	Vp8Dsp ref;
+	vp8_dsp_init_level(&ref, CPU_LEVEL_SCALAR);
+
+	const CpuLevel max = cpu_detect_level();
+	printf("dsp_selftest: detected %s, runtime level %s\n", cpu_level_name(max), cpu_level_name(vp8_dsp()->level));
+
+	for (int level = (int)CPU_LEVEL_SSE2; level <= (int)max; level++) {
+		Vp8Dsp dsp;
+		vp8_dsp_init_level(&dsp, (CpuLevel)level);
+		const char* name = cpu_level_name((CpuLevel)level);
+		uint32_t seed = 0x9E3779B9u;
+		if (check_transforms(&ref, &dsp, name, &seed)) return 1;
+		if (check_predictors(&ref, &dsp, name, &seed)) return 1;
+		if (check_loopfilter(&ref, &dsp, name, &seed)) return 1;
+		if (check_upsampler(&ref, &dsp, name, &seed)) return 1;
+		if (check_checksums(&ref, &dsp, name, &seed)) return 1;
+		EncDsp enc_ref, enc;
+		enc_dsp_init_level(&enc_ref, CPU_LEVEL_SCALAR);
+		enc_dsp_init_level(&enc, (CpuLevel)level);
+		if (check_enc_yuv(&enc_ref, &enc, name, &seed)) return 1;
+		if (check_enc_distortion(&enc_ref, &enc, name, &seed)) return 1;
+		if (check_enc_transform_quant(&enc_ref, &enc, name, &seed)) return 1;
+		printf("OK: %s matches scalar\n", name);
+	}
+	return 0;
+}
@@ -114,6 +114,7 @@ int main(int argc, char** argv) {
 	uint8_t qindex = 0;
 	if (enc_vp8_encode_bpred_uv_sad_inloop(&yuv,
 	                                     quality,
+	                                     /*threads=*/0,
 	                                     &y_modes,
 	                                     &y_modes_count,
 	                                     &b_modes,
@@ -177,6 +178,7 @@ int main(int argc, char** argv) {
 		                                          uv_modes,
 		                                          b_modes,
 		                                          &lf,
+		                                          /*token_partitions=*/1,
 		                                          coeffs,
 		                                          coeffs_count,
 		                                          &vp8,
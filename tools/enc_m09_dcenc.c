@@ -78,7 +78,7 @@ int main(int argc, char** argv) {
 	int16_t* coeffs = NULL;
 	size_t coeffs_count = 0;
 	uint8_t qindex = 0;
-	if (enc_vp8_encode_dc_pred_inloop(&yuv, quality, &coeffs, &coeffs_count, &qindex) != 0) {
+	if (enc_vp8_encode_dc_pred_inloop(&yuv, quality, /*threads=*/0, &coeffs, &coeffs_count, &qindex) != 0) {
 		fprintf(stderr, "%s: enc_vp8_encode_dc_pred_inloop failed (errno=%d)\n", in_path, errno);
 		enc_yuv420_free(&yuv);
 		enc_png_free(&img);
@@ -99,6 +99,7 @@ int main(int argc, char** argv) {
 		                                      0,
 		                                      0,
 		                                      &lf,
+		                                      /*token_partitions=*/1,
 		                                      coeffs,
 		                                      coeffs_count,
 		                                      &vp8,
@@ -108,7 +108,7 @@ int main(int argc, char** argv) {
 	size_t coeffs_count = 0;
 	uint8_t qindex = 0;
 	if (enc_vp8_encode_i16x16_uv_sad_inloop(
-	        &yuv, quality, &y_modes, &y_modes_count, &uv_modes, &uv_modes_count, &coeffs, &coeffs_count, &qindex) != 0) {
+	        &yuv, quality, /*threads=*/0, &y_modes, &y_modes_count, &uv_modes, &uv_modes_count, &coeffs, &coeffs_count, &qindex) != 0) {
 		fprintf(stderr, "%s: enc_vp8_encode_i16x16_uv_sad_inloop failed (errno=%d)\n", in_path, errno);
 		enc_yuv420_free(&yuv);
 		enc_png_free(&img);
@@ -159,6 +159,7 @@ int main(int argc, char** argv) {
 		                                        y_modes,
 		                                        uv_modes,
 		                                        &lf,
+		                                        /*token_partitions=*/1,
 		                                        coeffs,
 		                                        coeffs_count,
 		                                        &vp8,
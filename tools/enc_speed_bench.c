@@ -0,0 +1,362 @@
+// In-process speed vs quality table for the encoder --speed presets.
+//
+// Every input is converted to YUV once; then, per preset, each file is encoded
+// (analysis + bitstream, best of --runs), wrapped in RIFF, decoded with
+// libwebpdec (webp_decode_into_i420) and compared with the source planes.
+// Prints one Markdown row per preset: encode time, total bytes and PSNR. PSNR is
+// taken from the SSE summed over all files, so large images weigh by their
+// pixel count and a few tiny, losslessly coded ones cannot dominate it.
+//
+// The pipeline mirrors src/encoder_main.c (adaptive token probs, bpred-rdo
+// tuning defaults); keep the two in sync.
+
+// clock_gettime() is POSIX, not C11.
+#define _POSIX_C_SOURCE 200809L
+
+#include <errno.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "../src/enc-m01_riff/enc_riff.h"
+#include "../src/enc-m04_yuv/enc_rgb_to_yuv.h"
+#include "../src/enc-m07_tokens/enc_vp8_tokens.h"
+#include "../src/enc-m08_filter/enc_loopfilter.h"
+#include "../src/enc-m08_recon/enc_recon.h"
+#include "../src/webpdec.h"
+
+static void usage(const char* argv0) {
+	fprintf(stderr,
+	        "Usage: %s [--q <0..100>] [--runs N] [--loopfilter] <in.png>...\n"
+	        "\n"
+	        "Encodes every input with each --speed preset (0..6) in-process, decodes it\n"
+	        "with libwebpdec and prints a Markdown table of encode time, bytes and PSNR.\n",
+	        argv0);
+}
+
+static double now_sec(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+static int parse_int(const char* s, int* out) {
+	char* end = NULL;
+	long v = strtol(s, &end, 10);
+	if (!s[0] || (end && *end)) return -1;
+	if (v < -2147483647L || v > 2147483647L) return -1;
+	*out = (int)v;
+	return 0;
+}
+
+static const char* intra_name(EncSpeedIntra intra) {
+	switch (intra) {
+	case ENC_SPEED_INTRA_BPRED:
+		return "bpred";
+	case ENC_SPEED_INTRA_I16:
+		return "i16";
+	default:
+		return "bpred-rdo";
+	}
+}
+
+static const char* rate_name(uint32_t rate_mode) {
+	static const char* const names[] = {"proxy", "entropy", "dry-run", "table"};
+	return rate_mode < 4u ? names[rate_mode] : "?";
+}
+
+// One encode as `encoder --speed <speed> [--loopfilter] --q <quality>` would do it.
+static int encode_vp8(const EncYuv420Image* yuv,
+                      int quality,
+                      const EncSpeedPreset* preset,
+                      int enable_loopfilter,
+                      uint8_t** vp8,
+                      size_t* vp8_size) {
+	uint8_t* y_modes = NULL;
+	uint8_t* b_modes = NULL;
+	uint8_t* uv_modes = NULL;
+	int16_t* coeffs = NULL;
+	size_t y_count = 0, b_count = 0, uv_count = 0, coeffs_count = 0;
+	uint8_t qindex = 0;
+	int rc;
+	if (preset->intra == ENC_SPEED_INTRA_I16) {
+		rc = enc_vp8_encode_i16x16_uv_sad_inloop(
+		    yuv, quality, /*threads=*/0, &y_modes, &y_count, &uv_modes, &uv_count, &coeffs, &coeffs_count, &qindex);
+	} else if (preset->intra == ENC_SPEED_INTRA_BPRED) {
+		rc = enc_vp8_encode_bpred_uv_sad_inloop(yuv,
+		                                        quality,
+		                                        /*threads=*/0,
+		                                        &y_modes,
+		                                        &y_count,
+		                                        &b_modes,
+		                                        &b_count,
+		                                        &uv_modes,
+		                                        &uv_count,
+		                                        &coeffs,
+		                                        &coeffs_count,
+		                                        &qindex);
+	} else {
+		// encoder_main.c defaults, with the preset's search knobs.
+		EncBpredRdoTuning tuning;
+		memset(&tuning, 0, sizeof(tuning));
+		tuning.lambda_mul = 10;
+		tuning.lambda_div = 1;
+		tuning.quant_mode = 1;
+		tuning.ac_deadzone_pct = 70;
+		tuning.qscale_y_dc_pct = 100;
+		tuning.qscale_y_ac_pct = 100;
+		tuning.qscale_uv_dc_pct = 100;
+		tuning.qscale_uv_ac_pct = 130;
+		tuning.rate_mode = preset->rate_mode;
+		tuning.satd_prune_k = preset->satd_prune_k;
+		tuning.single_pass = preset->single_pass;
+		tuning.refine_rows = preset->refine_rows;
+		rc = enc_vp8_encode_bpred_uv_rdo_inloop(yuv,
+		                                       quality,
+		                                       ENC_VP8_TOKEN_PROBS_ADAPTIVE,
+		                                       &y_modes,
+		                                       &y_count,
+		                                       &b_modes,
+		                                       &b_count,
+		                                       &uv_modes,
+		                                       &uv_count,
+		                                       &coeffs,
+		                                       &coeffs_count,
+		                                       &qindex,
+		                                       &tuning);
+	}
+	if (rc == 0) {
+		EncVp8LoopFilterParams lf;
+		enc_vp8_loopfilter_from_qindex(qindex, &lf);
+		const EncVp8LoopFilterParams* lfp = enable_loopfilter ? &lf : NULL;
+		if (preset->intra == ENC_SPEED_INTRA_I16) {
+			rc = enc_vp8_build_keyframe_i16_coeffs_ex(
+			    yuv->width, yuv->height, qindex, 0, 0, 0, 0, 0, y_modes, uv_modes, lfp, /*token_partitions=*/1, coeffs, coeffs_count, vp8, vp8_size);
+		} else {
+			rc = enc_vp8_build_keyframe_intra_coeffs_ex_probs(yuv->width,
+			                                                  yuv->height,
+			                                                  qindex,
+			                                                  0,
+			                                                  0,
+			                                                  0,
+			                                                  0,
+			                                                  0,
+			                                                  /*enable_mb_skip=*/0,
+			                                                  y_modes,
+			                                                  uv_modes,
+			                                                  b_modes,
+			                                                  lfp,
+			                                                  /*token_partitions=*/1,
+			                                                  ENC_VP8_TOKEN_PROBS_ADAPTIVE,
+			                                                  coeffs,
+			                                                  coeffs_count,
+			                                                  vp8,
+			                                                  vp8_size);
+		}
+	}
+	free(y_modes);
+	free(b_modes);
+	free(uv_modes);
+	free(coeffs);
+	(void)y_count;
+	(void)b_count;
+	(void)uv_count;
+	return rc;
+}
+
+static uint64_t plane_sse(const uint8_t* a, size_t a_stride, const uint8_t* b, size_t b_stride, uint32_t w, uint32_t h) {
+	uint64_t sse = 0;
+	for (uint32_t y = 0; y < h; y++) {
+		for (uint32_t x = 0; x < w; x++) {
+			const int d = (int)a[(size_t)y * a_stride + x] - (int)b[(size_t)y * b_stride + x];
+			sse += (uint64_t)(d * d);
+		}
+	}
+	return sse;
+}
+
+// PSNR from an SSE over n samples; an all-identical corpus counts as 99 dB.
+static double psnr_from_sse(uint64_t sse, uint64_t n) {
+	if (sse == 0) return 99.0;
+	return 10.0 * log10(255.0 * 255.0 * (double)n / (double)sse);
+}
+
+typedef struct {
+	double encode_sec;
+	uint64_t bytes;
+	uint64_t sse_y;
+	uint64_t sse_yuv;
+	uint64_t samples_y;
+	uint64_t samples_yuv;
+} PresetTotals;
+
+// Encodes, decodes and scores one file; adds to *t.
+static int bench_file(const char* path,
+                      const EncYuv420Image* yuv,
+                      int quality,
+                      const EncSpeedPreset* preset,
+                      int enable_loopfilter,
+                      int runs,
+                      PresetTotals* t) {
+	uint8_t* vp8 = NULL;
+	size_t vp8_size = 0;
+	double best = 0.0;
+	for (int r = 0; r < runs; r++) {
+		free(vp8);
+		vp8 = NULL;
+		const double t0 = now_sec();
+		if (encode_vp8(yuv, quality, preset, enable_loopfilter, &vp8, &vp8_size) != 0 || !vp8) {
+			fprintf(stderr, "%s: encode failed (errno=%d)\n", path, errno);
+			free(vp8);
+			return 1;
+		}
+		const double dt = now_sec() - t0;
+		if (r == 0 || dt < best) best = dt;
+	}
+
+	uint8_t* webp = NULL;
+	size_t webp_size = 0;
+	const int wrc = enc_webp_wrap_vp8(vp8, vp8_size, &webp, &webp_size);
+	free(vp8);
+	if (wrc != 0) {
+		fprintf(stderr, "%s: RIFF wrap failed (errno=%d)\n", path, errno);
+		return 1;
+	}
+
+	const uint32_t w = yuv->width;
+	const uint32_t h = yuv->height;
+	const uint32_t uv_w = (w + 1u) >> 1;
+	const uint32_t uv_h = (h + 1u) >> 1;
+	const size_t y_bytes = (size_t)w * h;
+	const size_t uv_bytes = (size_t)uv_w * uv_h;
+	uint8_t* dec = (uint8_t*)malloc(y_bytes + 2u * uv_bytes);
+	if (!dec) {
+		free(webp);
+		fprintf(stderr, "%s: out of memory\n", path);
+		return 1;
+	}
+	uint8_t* dy = dec;
+	uint8_t* du = dec + y_bytes;
+	uint8_t* dv = du + uv_bytes;
+	if (webp_decode_into_i420(webp, webp_size, dy, w, du, dv, uv_w) != 0) {
+		fprintf(stderr, "%s: decode failed (errno=%d)\n", path, errno);
+		free(dec);
+		free(webp);
+		return 1;
+	}
+
+	const uint64_t sse_y = plane_sse(yuv->y, yuv->y_stride, dy, w, w, h);
+	const uint64_t sse_uv =
+	    plane_sse(yuv->u, yuv->uv_stride, du, uv_w, uv_w, uv_h) + plane_sse(yuv->v, yuv->uv_stride, dv, uv_w, uv_w, uv_h);
+	t->encode_sec += best;
+	t->bytes += webp_size;
+	t->sse_y += sse_y;
+	t->sse_yuv += sse_y + sse_uv;
+	t->samples_y += y_bytes;
+	t->samples_yuv += y_bytes + 2u * uv_bytes;
+	free(dec);
+	free(webp);
+	return 0;
+}
+
+int main(int argc, char** argv) {
+	int quality = 75;
+	int runs = 3;
+	int enable_loopfilter = 0;
+	int argi = 1;
+	while (argi < argc) {
+		if (argi + 1 < argc && strcmp(argv[argi], "--q") == 0) {
+			if (parse_int(argv[argi + 1], &quality) != 0 || quality < 0 || quality > 100) {
+				usage(argv[0]);
+				return 2;
+			}
+			argi += 2;
+			continue;
+		}
+		if (argi + 1 < argc && strcmp(argv[argi], "--runs") == 0) {
+			if (parse_int(argv[argi + 1], &runs) != 0 || runs < 1) {
+				usage(argv[0]);
+				return 2;
+			}
+			argi += 2;
+			continue;
+		}
+		if (strcmp(argv[argi], "--loopfilter") == 0 || strcmp(argv[argi], "--lf") == 0) {
+			enable_loopfilter = 1;
+			argi += 1;
+			continue;
+		}
+		break;
+	}
+	const int nfiles = argc - argi;
+	if (nfiles < 1) {
+		usage(argv[0]);
+		return 2;
+	}
+
+	EncYuv420Image* images = (EncYuv420Image*)calloc((size_t)nfiles, sizeof(EncYuv420Image));
+	if (!images) {
+		fprintf(stderr, "out of memory\n");
+		return 1;
+	}
+	int loaded = 0;
+	int rc = 0;
+	for (; loaded < nfiles; loaded++) {
+		const char* path = argv[argi + loaded];
+		if (enc_yuv420_from_png_file(path, &images[loaded]) != 0) {
+			fprintf(stderr, "PNG read failed for %s: %s\n", path, strerror(errno));
+			rc = 1;
+			break;
+		}
+	}
+
+	if (rc == 0) {
+		printf("%d file(s), q=%d, best of %d run(s)%s\n\n", nfiles, quality, runs, enable_loopfilter ? ", loopfilter" : "");
+		printf("| speed | strategy | encode ms | vs speed 0 | bytes | PSNR Y | PSNR YUV |\n");
+		printf("|---|---|---:|---:|---:|---:|---:|\n");
+	}
+	double base_sec = 0.0;
+	for (int speed = ENC_SPEED_MIN; rc == 0 && speed <= ENC_SPEED_MAX; speed++) {
+		const EncSpeedPreset* preset = enc_speed_preset(speed);
+		PresetTotals t = {0.0, 0, 0, 0, 0, 0};
+		for (int i = 0; rc == 0 && i < nfiles; i++) {
+			rc = bench_file(argv[argi + i], &images[i], quality, preset, enable_loopfilter, runs, &t);
+		}
+		if (rc != 0) break;
+		if (speed == ENC_SPEED_MIN) base_sec = t.encode_sec;
+
+		char strategy[64];
+		if (preset->intra == ENC_SPEED_INTRA_BPRED_RDO) {
+			snprintf(strategy,
+			         sizeof(strategy),
+			         "bpred-rdo, %s, %u pass%s",
+			         rate_name(preset->rate_mode),
+			         preset->single_pass ? 1u : 2u,
+			         preset->single_pass ? "" : "es");
+			if (preset->refine_rows) {
+				const size_t len = strlen(strategy);
+				snprintf(strategy + len, sizeof(strategy) - len, ", refine %u", preset->refine_rows);
+			}
+			if (preset->satd_prune_k) {
+				const size_t len = strlen(strategy);
+				snprintf(strategy + len, sizeof(strategy) - len, ", satd-k %u", preset->satd_prune_k);
+			}
+		} else {
+			snprintf(strategy, sizeof(strategy), "%s (SAD)", intra_name(preset->intra));
+		}
+		printf("| %d | %s | %.1f | %.2fx | %llu | %.3f | %.3f |\n",
+		       speed,
+		       strategy,
+		       t.encode_sec * 1e3,
+		       t.encode_sec > 0.0 ? base_sec / t.encode_sec : 0.0,
+		       (unsigned long long)t.bytes,
+		       psnr_from_sse(t.sse_y, t.samples_y),
+		       psnr_from_sse(t.sse_yuv, t.samples_yuv));
+	}
+
+	for (int i = 0; i < loaded; i++) enc_yuv420_free(&images[i]);
+	free(images);
+	return rc;
+}
@@ -0,0 +1,209 @@
+// Validates the token cost tables (enc_vp8_token_costs_*) against the dry-run
+// bool-encoder bitcount they replace in bpred-rdo, on the macroblocks of real
+// encodes, and times both.
+//
+// The dry run writes each macroblock into its own bool encoder, so it pays the
+// 4-byte flush and byte rounding (up to ~32 bits over the table on tiny
+// macroblocks), and the coder's 8-bit split rounding drifts from the exact
+// entropy by up to ~5% on large ones (repeated identical blocks, as in flat
+// i16 macroblocks, accumulate the same rounding). Per macroblock, dry-run
+// minus table must lie in [-(8 + table / 16), 40] bits. Prints one summary
+// line per input and exits non-zero on the first macroblock outside that
+// window.
+
+// clock_gettime() is POSIX, not C11.
+#define _POSIX_C_SOURCE 200809L
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "../src/enc-m04_yuv/enc_rgb_to_yuv.h"
+#include "../src/enc-m07_tokens/enc_vp8_tokens.h"
+#include "../src/enc-m08_recon/enc_recon.h"
+
+enum {
+	COEFFS_PER_MB = 16 + 16 * 16 + 4 * 16 + 4 * 16,
+	// Allowed dry-run minus table difference, in bits (see above).
+	MIN_DIFF_BITS = -8,
+	MAX_DIFF_BITS = 40,
+};
+
+static void usage(const char* argv0) {
+	fprintf(stderr,
+	        "Usage: %s [--q <0..100>] <in.png>...\n"
+	        "\n"
+	        "Compares table-based macroblock token costs with the dry-run bitcount\n"
+	        "(default and adaptive probabilities) and reports the time per macroblock.\n",
+	        argv0);
+}
+
+static double now_sec(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+typedef struct {
+	uint64_t mbs;
+	int64_t table_q8;
+	int64_t dry_q8;
+	int64_t abs_diff_q8;
+} CostStats;
+
+static int compare_mbs(const char* path,
+                       const char* label,
+                       const uint8_t probs[4][8][3][11],
+                       size_t mb_total,
+                       const uint8_t* y_modes,
+                       const int16_t* coeffs,
+                       CostStats* st) {
+	EncVp8TokenCosts costs;
+	enc_vp8_token_costs_init(&costs, probs);
+	for (size_t i = 0; i < mb_total; i++) {
+		const int16_t* mb = coeffs + i * COEFFS_PER_MB;
+		const int64_t t = (int64_t)enc_vp8_token_costs_mb_q8(&costs, (int)y_modes[i], mb);
+		const int64_t d = (int64_t)enc_vp8_dry_run_keyframe_mb_token_bits_q8_probs((int)y_modes[i], mb, probs);
+		const int64_t diff = d - t;
+		const int64_t min_diff = (int64_t)MIN_DIFF_BITS * 256 - t / 16;
+		if (diff < min_diff || diff > (int64_t)MAX_DIFF_BITS * 256) {
+			fprintf(stderr,
+			        "FAIL: %s (%s probs) mb %zu: table %.2f bits, dry-run %.2f bits\n",
+			        path,
+			        label,
+			        i,
+			        (double)t / 256.0,
+			        (double)d / 256.0);
+			return 1;
+		}
+		st->mbs++;
+		st->table_q8 += t;
+		st->dry_q8 += d;
+		st->abs_diff_q8 += diff < 0 ? -diff : diff;
+	}
+	return 0;
+}
+
+// Best-of-3 time per macroblock in ns; the sum keeps the calls from being
+// elided. The table setup is timed separately (*init_us), as the encoder does
+// it once per probability table, not per macroblock.
+static double time_per_mb(int use_table,
+                          const uint8_t probs[4][8][3][11],
+                          size_t mb_total,
+                          const uint8_t* y_modes,
+                          const int16_t* coeffs,
+                          uint64_t* sink,
+                          double* init_us) {
+	EncVp8TokenCosts costs;
+	if (use_table) {
+		const double t0 = now_sec();
+		enc_vp8_token_costs_init(&costs, probs);
+		*init_us = (now_sec() - t0) * 1e6;
+	}
+	double best = 0.0;
+	for (int rep = 0; rep < 3; rep++) {
+		const double t0 = now_sec();
+		for (size_t i = 0; i < mb_total; i++) {
+			const int16_t* mb = coeffs + i * COEFFS_PER_MB;
+			*sink += use_table ? enc_vp8_token_costs_mb_q8(&costs, (int)y_modes[i], mb)
+			                   : enc_vp8_dry_run_keyframe_mb_token_bits_q8_probs((int)y_modes[i], mb, probs);
+		}
+		const double dt = (now_sec() - t0) * 1e9 / (double)mb_total;
+		if (rep == 0 || dt < best) best = dt;
+	}
+	return best;
+}
+
+static int check_file(const char* path, int quality, uint64_t* sink) {
+	EncYuv420Image yuv;
+	if (enc_yuv420_from_png_file(path, &yuv) != 0) {
+		fprintf(stderr, "PNG read failed for %s: %s\n", path, strerror(errno));
+		return 2;
+	}
+
+	uint8_t* y_modes = NULL;
+	uint8_t* b_modes = NULL;
+	uint8_t* uv_modes = NULL;
+	int16_t* coeffs = NULL;
+	size_t y_count = 0, b_count = 0, uv_count = 0, coeffs_count = 0;
+	uint8_t qindex = 0;
+	int rc = enc_vp8_encode_bpred_uv_rdo_inloop(&yuv,
+	                                           quality,
+	                                           ENC_VP8_TOKEN_PROBS_DEFAULT,
+	                                           &y_modes,
+	                                           &y_count,
+	                                           &b_modes,
+	                                           &b_count,
+	                                           &uv_modes,
+	                                           &uv_count,
+	                                           &coeffs,
+	                                           &coeffs_count,
+	                                           &qindex,
+	                                           /*tuning=*/NULL);
+	const uint32_t mb_cols = (yuv.width + 15u) >> 4;
+	const uint32_t mb_rows = (yuv.height + 15u) >> 4;
+	enc_yuv420_free(&yuv);
+	if (rc != 0) {
+		fprintf(stderr, "encode failed for %s: %s\n", path, strerror(errno));
+		return 2;
+	}
+
+	uint8_t adaptive_buf[4][8][3][11];
+	enc_vp8_compute_adaptive_coeff_probs(adaptive_buf, mb_cols, mb_rows, y_modes, coeffs);
+	const uint8_t(*adaptive)[8][3][11] = (const uint8_t(*)[8][3][11])adaptive_buf;
+
+	CostStats st = {0, 0, 0, 0};
+	rc = compare_mbs(path, "default", NULL, y_count, y_modes, coeffs, &st);
+	if (rc == 0) rc = compare_mbs(path, "adaptive", adaptive, y_count, y_modes, coeffs, &st);
+	if (rc == 0) {
+		double init_us = 0.0;
+		const double dry_ns = time_per_mb(0, adaptive, y_count, y_modes, coeffs, sink, &init_us);
+		const double table_ns = time_per_mb(1, adaptive, y_count, y_modes, coeffs, sink, &init_us);
+		printf("%s: %llu mbs, table %.1f bits/mb, dry-run %.1f bits/mb, mean |diff| %.1f bits; "
+		       "%.0f ns/mb dry-run, %.0f ns/mb table (%.1fx), table init %.0f us\n",
+		       path,
+		       (unsigned long long)st.mbs,
+		       (double)st.table_q8 / 256.0 / (double)st.mbs,
+		       (double)st.dry_q8 / 256.0 / (double)st.mbs,
+		       (double)st.abs_diff_q8 / 256.0 / (double)st.mbs,
+		       dry_ns,
+		       table_ns,
+		       table_ns > 0.0 ? dry_ns / table_ns : 0.0,
+		       init_us);
+	}
+
+	free(y_modes);
+	free(b_modes);
+	free(uv_modes);
+	free(coeffs);
+	(void)b_count;
+	(void)uv_count;
+	(void)coeffs_count;
+	return rc;
+}
+
+int main(int argc, char** argv) {
+	int quality = 75;
+	int argi = 1;
+	if (argi + 1 < argc && strcmp(argv[argi], "--q") == 0) {
+		quality = atoi(argv[argi + 1]);
+		if (quality < 0 || quality > 100) {
+			usage(argv[0]);
+			return 2;
+		}
+		argi += 2;
+	}
+	if (argi >= argc) {
+		usage(argv[0]);
+		return 2;
+	}
+
+	uint64_t sink = 0;
+	for (; argi < argc; argi++) {
+		const int rc = check_file(argv[argi], quality, &sink);
+		if (rc != 0) return rc;
+	}
+	return sink == 1 ? 3 : 0;
+}
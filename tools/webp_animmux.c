@@ -0,0 +1,215 @@
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Builds an animated WebP (VP8X + ANIM + ANMF) from still lossy WebP files.
+// Test helper for the -anim_* decoder commands; not a general-purpose muxer.
+
+static void usage(const char* argv0) {
+	fprintf(stderr,
+	        "Usage:\n"
+	        "  %s <out.webp> <canvas_w> <canvas_h> <loop_count> <bgcolor> FRAME...\n"
+	        "  FRAME = <in.webp> <x> <y> <duration_ms> <blend:0|1> <dispose:0|1>\n"
+	        "\n"
+	        "Copies the VP8 chunk (and ALPH chunk, if any) of each still <in.webp>\n"
+	        "into an ANMF frame at offset x,y (both even). bgcolor is the ANIM\n"
+	        "background color as a BGRA integer.\n",
+	        argv0);
+}
+
+static uint32_t le32_load(const uint8_t p[4]) {
+	return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static void le16_store(uint8_t* p, uint32_t v) {
+	p[0] = (uint8_t)v;
+	p[1] = (uint8_t)(v >> 8);
+}
+
+static void le24_store(uint8_t* p, uint32_t v) {
+	p[0] = (uint8_t)v;
+	p[1] = (uint8_t)(v >> 8);
+	p[2] = (uint8_t)(v >> 16);
+}
+
+static void le32_store(uint8_t* p, uint32_t v) {
+	le24_store(p, v);
+	p[3] = (uint8_t)(v >> 24);
+}
+
+static int read_entire_file(const char* path, uint8_t** out_buf, size_t* out_size) {
+	*out_buf = NULL;
+	*out_size = 0;
+
+	FILE* f = fopen(path, "rb");
+	if (!f) return -1;
+	if (fseek(f, 0, SEEK_END) != 0) {
+		fclose(f);
+		return -1;
+	}
+	long sz = ftell(f);
+	if (sz < 0 || fseek(f, 0, SEEK_SET) != 0) {
+		fclose(f);
+		return -1;
+	}
+
+	uint8_t* buf = (uint8_t*)malloc((size_t)sz + 1u);
+	if (!buf) {
+		fclose(f);
+		errno = ENOMEM;
+		return -1;
+	}
+
+	size_t n = fread(buf, 1, (size_t)sz, f);
+	fclose(f);
+	if (n != (size_t)sz) {
+		free(buf);
+		return -1;
+	}
+
+	*out_buf = buf;
+	*out_size = n;
+	return 0;
+}
+
+// Finds a top-level chunk of a RIFF/WEBP file. Returns the chunk header or NULL;
+// *out_total is the header plus payload, without the pad byte.
+static const uint8_t* find_chunk(const uint8_t* file, size_t file_size, const char fourcc[4], size_t* out_total) {
+	if (file_size < 12 || memcmp(file, "RIFF", 4) != 0 || memcmp(file + 8, "WEBP", 4) != 0) return NULL;
+	size_t off = 12;
+	while (off + 8 <= file_size) {
+		const uint8_t* ch = file + off;
+		const size_t clen = le32_load(ch + 4);
+		if (clen > file_size - off - 8) return NULL;
+		if (memcmp(ch, fourcc, 4) == 0) {
+			*out_total = 8u + clen;
+			return ch;
+		}
+		off += 8u + clen + (clen & 1u);
+	}
+	return NULL;
+}
+
+typedef struct {
+	uint8_t* file;
+	size_t file_size;
+	const uint8_t* vp8; // VP8 chunk header
+	size_t vp8_total;
+	const uint8_t* alph; // ALPH chunk header or NULL
+	size_t alph_total;
+	uint32_t x, y, width, height, duration, blend, dispose;
+} Frame;
+
+static size_t padded(size_t n) { return n + (n & 1u); }
+
+// Writes a chunk (header + payload) followed by its pad byte.
+static int write_chunk(FILE* out, const uint8_t* chunk, size_t total) {
+	static const uint8_t zero = 0;
+	if (fwrite(chunk, 1, total, out) != total) return -1;
+	if ((total & 1u) && fwrite(&zero, 1, 1, out) != 1) return -1;
+	return 0;
+}
+
+static int load_frame(Frame* f, char** args) {
+	memset(f, 0, sizeof(*f));
+	if (read_entire_file(args[0], &f->file, &f->file_size) != 0) {
+		fprintf(stderr, "error: cannot read %s\n", args[0]);
+		return -1;
+	}
+	f->vp8 = find_chunk(f->file, f->file_size, "VP8 ", &f->vp8_total);
+	if (!f->vp8 || le32_load(f->vp8 + 4) < 10) {
+		fprintf(stderr, "error: no VP8 chunk in %s\n", args[0]);
+		return -1;
+	}
+	f->alph = find_chunk(f->file, f->file_size, "ALPH", &f->alph_total);
+	const uint8_t* p = f->vp8 + 8;
+	f->width = ((uint32_t)p[6] | ((uint32_t)p[7] << 8)) & 0x3FFFu;
+	f->height = ((uint32_t)p[8] | ((uint32_t)p[9] << 8)) & 0x3FFFu;
+	f->x = (uint32_t)strtoul(args[1], NULL, 10);
+	f->y = (uint32_t)strtoul(args[2], NULL, 10);
+	f->duration = (uint32_t)strtoul(args[3], NULL, 10);
+	f->blend = (uint32_t)strtoul(args[4], NULL, 10) != 0;
+	f->dispose = (uint32_t)strtoul(args[5], NULL, 10) != 0;
+	if ((f->x | f->y) & 1u) {
+		fprintf(stderr, "error: frame offsets must be even: %s\n", args[0]);
+		return -1;
+	}
+	return 0;
+}
+
+int main(int argc, char** argv) {
+	if (argc < 12 || (argc - 6) % 6 != 0) {
+		usage(argv[0]);
+		return 2;
+	}
+	const uint32_t canvas_w = (uint32_t)strtoul(argv[2], NULL, 10);
+	const uint32_t canvas_h = (uint32_t)strtoul(argv[3], NULL, 10);
+	const uint32_t loop = (uint32_t)strtoul(argv[4], NULL, 10);
+	const uint32_t bgcolor = (uint32_t)strtoul(argv[5], NULL, 0);
+	const int nframes = (argc - 6) / 6;
+	if (canvas_w == 0 || canvas_h == 0 || canvas_w > (1u << 24) || canvas_h > (1u << 24)) {
+		fprintf(stderr, "error: bad canvas size\n");
+		return 2;
+	}
+
+	Frame* frames = (Frame*)calloc((size_t)nframes, sizeof(Frame));
+	if (!frames) return 1;
+	size_t riff_payload = 4u + 18u + 14u; // "WEBP" + VP8X + ANIM
+	int rc = 0;
+	for (int i = 0; i < nframes && rc == 0; i++) {
+		rc = load_frame(&frames[i], argv + 6 + 6 * i);
+		riff_payload += 8u + 16u + padded(frames[i].alph_total) + padded(frames[i].vp8_total);
+	}
+
+	FILE* out = NULL;
+	if (rc == 0) {
+		out = fopen(argv[1], "wb");
+		if (!out) {
+			fprintf(stderr, "error: cannot open %s\n", argv[1]);
+			rc = -1;
+		}
+	}
+	if (rc == 0) {
+		uint8_t hdr[12 + 18 + 14];
+		memcpy(hdr, "RIFF", 4);
+		le32_store(hdr + 4, (uint32_t)riff_payload);
+		memcpy(hdr + 8, "WEBP", 4);
+		memcpy(hdr + 12, "VP8X", 4);
+		le32_store(hdr + 16, 10);
+		memset(hdr + 20, 0, 4);
+		hdr[20] = 0x02; // animation
+		for (int i = 0; i < nframes; i++) {
+			if (frames[i].alph) hdr[20] |= 0x10; // alpha
+		}
+		le24_store(hdr + 24, canvas_w - 1u);
+		le24_store(hdr + 27, canvas_h - 1u);
+		memcpy(hdr + 30, "ANIM", 4);
+		le32_store(hdr + 34, 6);
+		le32_store(hdr + 38, bgcolor);
+		le16_store(hdr + 42, loop);
+		if (fwrite(hdr, 1, sizeof(hdr), out) != sizeof(hdr)) rc = -1;
+	}
+	for (int i = 0; i < nframes && rc == 0; i++) {
+		const Frame* f = &frames[i];
+		uint8_t anmf[8 + 16];
+		memcpy(anmf, "ANMF", 4);
+		le32_store(anmf + 4, (uint32_t)(16u + padded(f->alph_total) + padded(f->vp8_total)));
+		le24_store(anmf + 8, f->x / 2u);
+		le24_store(anmf + 11, f->y / 2u);
+		le24_store(anmf + 14, f->width - 1u);
+		le24_store(anmf + 17, f->height - 1u);
+		le24_store(anmf + 20, f->duration);
+		anmf[23] = (uint8_t)((f->blend ? 0u : 0x02u) | (f->dispose ? 0x01u : 0u));
+		if (fwrite(anmf, 1, sizeof(anmf), out) != sizeof(anmf)) rc = -1;
+		if (rc == 0 && f->alph) rc = write_chunk(out, f->alph, f->alph_total);
+		if (rc == 0) rc = write_chunk(out, f->vp8, f->vp8_total);
+	}
+	if (out && fclose(out) != 0) rc = -1;
+	if (rc != 0 && out) fprintf(stderr, "error: write failed\n");
+
+	for (int i = 0; i < nframes; i++) free(frames[i].file);
+	free(frames);
+	return rc == 0 ? 0 : 1;
+}
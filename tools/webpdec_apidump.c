@@ -0,0 +1,176 @@
+// Exercises the public webpdec.h API: decodes into buffers with padded strides
+// and writes the visible pixels as PPM (rgb), PAM (rgba/rgbA) or tightly packed
+// I420, so the output can be compared byte-for-byte against `decoder -ppm` /
+// `decoder -pam` / `decoder -yuvf`. An optional x,y,w,h argument uses the
+// webp_decode_crop_* functions instead.
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../src/webpdec.h"
+
+// Extra bytes per row so the stride handling is actually exercised.
+enum { STRIDE_PAD = 13 };
+
+static void usage(const char* argv0) {
+	fprintf(stderr, "Usage: %s <in.webp> <rgb|rgba|rgbA|i420> <out> [x,y,w,h]\n", argv0);
+}
+
+static uint8_t* read_file(const char* path, size_t* out_size) {
+	FILE* f = fopen(path, "rb");
+	if (!f) return NULL;
+	uint8_t* data = NULL;
+	size_t size = 0;
+	size_t cap = 0;
+	for (;;) {
+		if (size == cap) {
+			cap = cap ? cap * 2 : 65536;
+			uint8_t* p = (uint8_t*)realloc(data, cap);
+			if (!p) {
+				free(data);
+				fclose(f);
+				return NULL;
+			}
+			data = p;
+		}
+		size_t n = fread(data + size, 1, cap - size, f);
+		size += n;
+		if (n == 0) break;
+	}
+	fclose(f);
+	*out_size = size;
+	return data;
+}
+
+static int write_rows(FILE* out, const uint8_t* base, size_t stride, size_t row_bytes, uint32_t rows) {
+	for (uint32_t y = 0; y < rows; y++) {
+		if (fwrite(base + (size_t)y * stride, 1, row_bytes, out) != row_bytes) return -1;
+	}
+	return 0;
+}
+
+// rgb is written as PPM; rgba (straight) and rgbA (premultiplied) as PAM.
+static int dump_rgb(FILE* out, const uint8_t* data, size_t size, const WebpDecRect* crop, uint32_t w, uint32_t h,
+                    const char* fmt) {
+	const uint32_t bpp = (strcmp(fmt, "rgb") == 0) ? 3u : 4u;
+	const size_t stride = (size_t)w * bpp + STRIDE_PAD;
+	const size_t out_size = stride * h;
+	uint8_t* buf = (uint8_t*)malloc(out_size);
+	if (!buf) return -1;
+	memset(buf, 0xA5, out_size);
+	int rc;
+	if (crop) {
+		rc = (bpp == 3u) ? webp_decode_crop_into_rgb(data, size, crop, buf, stride, out_size)
+		                 : webp_decode_crop_into_rgba(data, size, crop, buf, stride, out_size);
+	} else if (bpp == 3u) {
+		rc = webp_decode_into_rgb(data, size, buf, stride, out_size);
+	} else if (strcmp(fmt, "rgbA") == 0) {
+		rc = webp_decode_into_rgba_premultiplied(data, size, buf, stride, out_size);
+	} else {
+		rc = webp_decode_into_rgba(data, size, buf, stride, out_size);
+	}
+	if (rc != 0) {
+		fprintf(stderr, "decode failed (errno=%d)\n", errno);
+	}
+	if (rc == 0) {
+		const int n = (bpp == 3u) ? fprintf(out, "P6\n%u %u\n255\n", w, h)
+		                          : fprintf(out,
+		                                    "P7\nWIDTH %u\nHEIGHT %u\nDEPTH 4\nMAXVAL 255\nTUPLTYPE RGB_ALPHA\nENDHDR\n",
+		                                    w, h);
+		if (n < 0) rc = -1;
+	}
+	for (uint32_t y = 0; rc == 0 && y < h; y++) {
+		const uint8_t* row = buf + (size_t)y * stride;
+		// Padding bytes must be left untouched.
+		for (size_t i = (size_t)w * bpp; rc == 0 && i < stride; i++) {
+			if (row[i] != 0xA5u) {
+				fprintf(stderr, "stride padding overwritten in row %u\n", y);
+				rc = -1;
+			}
+		}
+		if (rc == 0 && write_rows(out, row, 0, (size_t)w * bpp, 1) != 0) rc = -1;
+	}
+	free(buf);
+	return rc;
+}
+
+static int dump_i420(FILE* out, const uint8_t* data, size_t size, const WebpDecRect* crop, uint32_t w, uint32_t h) {
+	const uint32_t cw = (w + 1u) / 2u;
+	const uint32_t ch = (h + 1u) / 2u;
+	const size_t y_stride = (size_t)w + STRIDE_PAD;
+	const size_t uv_stride = (size_t)cw + STRIDE_PAD;
+	uint8_t* y = (uint8_t*)malloc(y_stride * h);
+	uint8_t* u = (uint8_t*)malloc(uv_stride * ch);
+	uint8_t* v = (uint8_t*)malloc(uv_stride * ch);
+	int rc = -1;
+	if (y && u && v) {
+		rc = crop ? webp_decode_crop_into_i420(data, size, crop, y, y_stride, u, v, uv_stride)
+		          : webp_decode_into_i420(data, size, y, y_stride, u, v, uv_stride);
+		if (rc != 0) fprintf(stderr, "decode failed (errno=%d)\n", errno);
+	}
+	if (rc == 0) rc = write_rows(out, y, y_stride, w, h);
+	if (rc == 0) rc = write_rows(out, u, uv_stride, cw, ch);
+	if (rc == 0) rc = write_rows(out, v, uv_stride, cw, ch);
+	free(y);
+	free(u);
+	free(v);
+	return rc;
+}
+
+int main(int argc, char** argv) {
+	if (argc != 4 && argc != 5) {
+		usage(argv[0]);
+		return 2;
+	}
+	const char* fmt = argv[2];
+	if (strcmp(fmt, "rgb") != 0 && strcmp(fmt, "rgba") != 0 && strcmp(fmt, "rgbA") != 0 &&
+	    strcmp(fmt, "i420") != 0) {
+		usage(argv[0]);
+		return 2;
+	}
+	WebpDecRect crop;
+	// There is no premultiplied crop entry point.
+	if (argc == 5 && (strcmp(fmt, "rgbA") == 0 ||
+	                  sscanf(argv[4], "%u,%u,%u,%u", &crop.x, &crop.y, &crop.width, &crop.height) != 4)) {
+		usage(argv[0]);
+		return 2;
+	}
+
+	size_t size = 0;
+	uint8_t* data = read_file(argv[1], &size);
+	if (!data) {
+		fprintf(stderr, "cannot read %s (errno=%d)\n", argv[1], errno);
+		return 1;
+	}
+
+	uint32_t w = 0, h = 0;
+	if (webp_get_info(data, size, &w, &h) != 0) {
+		fprintf(stderr, "webp_get_info failed (errno=%d)\n", errno);
+		free(data);
+		return 1;
+	}
+	if (argc == 5) {
+		w = crop.width;
+		h = crop.height;
+	}
+
+	FILE* out = fopen(argv[3], "wb");
+	if (!out) {
+		fprintf(stderr, "fopen(%s) failed (errno=%d)\n", argv[3], errno);
+		free(data);
+		return 1;
+	}
+
+	int rc;
+	if (strcmp(fmt, "i420") == 0) {
+		rc = dump_i420(out, data, size, argc == 5 ? &crop : NULL, w, h);
+	} else {
+		rc = dump_rgb(out, data, size, argc == 5 ? &crop : NULL, w, h, fmt);
+	}
+	if (fclose(out) != 0) rc = -1;
+	free(data);
+	return (rc == 0) ? 0 : 1;
+}
@@ -0,0 +1,588 @@
+// In-process decoder benchmark (`make bench`).
+//
+// Decode: for each file, one untimed warm-up, then N timed iterations of the
+// `decoder -png|-ppm|-yuvf` pipeline (output to /dev/null). Per-stage times come
+// from src/common/timing.h; min/median/p95 are reported per stage plus MP/s.
+//
+// With -perf (Linux), hardware cache misses and L1D read misses are counted
+// around each timed decode and reported as "perf" rows: min/median/p95 are
+// event counts and rate is the median per macroblock.
+//
+// Kernels: batches of calls to the hot kernels on synthetic data; the
+// dispatched ones (src/common/dsp.h) run at every CPU level available.
+//
+// Usage:
+//   webpdec_bench [-n iters] [-k samples] [-fmt png|ppm|yuv] [-kernels|-files] [-perf]
+//                 [-csv out.csv] [-json out.json] [file.webp...]
+
+// clock_gettime()/open() are POSIX, not C11; syscall() is not POSIX either.
+#define _POSIX_C_SOURCE 200809L
+#ifndef _DEFAULT_SOURCE
+#define _DEFAULT_SOURCE
+#endif
+
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#endif
+
+#include "../src/common/dsp.h"
+#include "../src/common/os.h"
+#include "../src/common/timing.h"
+#include "../src/m01_container/webp_container.h"
+#include "../src/m02_vp8_header/vp8_header.h"
+#include "../src/m03_bool_decoder/bool_decoder.h"
+#include "../src/m05_tokens/vp8_tokens.h"
+#include "../src/m06_recon/vp8_recon.h"
+#include "../src/m08_yuv2rgb_ppm/yuv2rgb_ppm.h"
+#include "../src/m09_png/yuv2rgb_png.h"
+
+typedef enum { FMT_PNG, FMT_PPM, FMT_YUV } BenchFmt;
+
+static const char* const k_fmt_names[] = {"png", "ppm", "yuvf"};
+
+static const char* const k_stage_names[DEC_STAGE_COUNT + 1] = {
+	"file_map", "container", "header", "modes", "tokens", "recon", "loopfilter", "color", "compress", "write", "total",
+};
+
+typedef struct {
+	uint64_t min;
+	uint64_t median;
+	uint64_t p95;
+} Summary;
+
+// Result sinks; both may be NULL.
+static FILE* g_csv;
+static FILE* g_json;
+static int g_json_first = 1;
+
+// Keeps kernel results observable so the calls are not optimized away.
+static volatile uint32_t g_sink;
+
+static int cmp_u64(const void* a, const void* b) {
+	const uint64_t x = *(const uint64_t*)a;
+	const uint64_t y = *(const uint64_t*)b;
+	return (x > y) - (x < y);
+}
+
+// Sorts `v` in place.
+static Summary summarize(uint64_t* v, uint32_t n) {
+	qsort(v, n, sizeof(v[0]), cmp_u64);
+	Summary s;
+	s.min = v[0];
+	s.median = v[(n - 1u) / 2u];
+	s.p95 = v[(n * 95u + 99u) / 100u - 1u];
+	return s;
+}
+
+static void json_string(FILE* f, const char* str) {
+	fputc('"', f);
+	for (; *str; str++) {
+		const unsigned char ch = (unsigned char)*str;
+		if (ch == '"' || ch == '\\') {
+			fputc('\\', f);
+			fputc(ch, f);
+		} else if (ch < 0x20u) {
+			fprintf(f, "\\u%04x", ch);
+		} else {
+			fputc(ch, f);
+		}
+	}
+	fputc('"', f);
+}
+
+// One result row. Times are ns (per call for kernels); rate is millions of `unit` per second.
+static void emit(const char* kind, const char* subject, const char* metric, const char* cpu, uint32_t width,
+                 uint32_t height, uint32_t iters, double min_ns, double median_ns, double p95_ns, double rate,
+                 const char* unit) {
+	if (g_csv) {
+		fprintf(g_csv, "%s,%s,%s,%s,%u,%u,%u,%.1f,%.1f,%.1f,%.3f,%s\n", kind, subject, metric, cpu, width, height, iters,
+		        min_ns, median_ns, p95_ns, rate, unit);
+	}
+	if (g_json) {
+		fprintf(g_json, "%s\n  {\"kind\":\"%s\",\"subject\":", g_json_first ? "" : ",", kind);
+		json_string(g_json, subject);
+		fprintf(g_json,
+		        ",\"metric\":\"%s\",\"cpu\":\"%s\",\"width\":%u,\"height\":%u,\"iters\":%u,\"min_ns\":%.1f,"
+		        "\"median_ns\":%.1f,\"p95_ns\":%.1f,\"rate\":%.3f,\"unit\":\"%s\"}",
+		        metric, cpu, width, height, iters, min_ns, median_ns, p95_ns, rate, unit);
+		g_json_first = 0;
+	}
+}
+
+// --- hardware counters (-perf) ---
+
+enum { PERF_CACHE_MISSES, PERF_L1D_READ_MISSES, PERF_COUNTERS };
+
+static const char* const k_perf_names[PERF_COUNTERS] = {"cache_misses", "l1d_read_misses"};
+
+// Counter fds; -1 when a counter is unavailable.
+static int g_perf_fd[PERF_COUNTERS] = {-1, -1};
+
+// Opens the counters for this thread (user space only). Returns how many opened.
+static int perf_open(void) {
+	int opened = 0;
+#ifdef __linux__
+	static const uint64_t configs[PERF_COUNTERS] = {
+		PERF_COUNT_HW_CACHE_MISSES,
+		PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16),
+	};
+	static const uint32_t types[PERF_COUNTERS] = {PERF_TYPE_HARDWARE, PERF_TYPE_HW_CACHE};
+	for (int c = 0; c < PERF_COUNTERS; c++) {
+		struct perf_event_attr attr;
+		memset(&attr, 0, sizeof(attr));
+		attr.size = sizeof(attr);
+		attr.type = types[c];
+		attr.config = configs[c];
+		attr.disabled = 1;
+		attr.exclude_kernel = 1;
+		attr.exclude_hv = 1;
+		g_perf_fd[c] = (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+		if (g_perf_fd[c] >= 0) opened++;
+	}
+#endif
+	return opened;
+}
+
+static void perf_start(void) {
+#ifdef __linux__
+	for (int c = 0; c < PERF_COUNTERS; c++) {
+		if (g_perf_fd[c] < 0) continue;
+		(void)ioctl(g_perf_fd[c], PERF_EVENT_IOC_RESET, 0);
+		(void)ioctl(g_perf_fd[c], PERF_EVENT_IOC_ENABLE, 0);
+	}
+#endif
+}
+
+static void perf_stop(uint64_t counts[PERF_COUNTERS]) {
+	for (int c = 0; c < PERF_COUNTERS; c++) {
+		counts[c] = 0;
+#ifdef __linux__
+		if (g_perf_fd[c] < 0) continue;
+		(void)ioctl(g_perf_fd[c], PERF_EVENT_IOC_DISABLE, 0);
+		if (read(g_perf_fd[c], &counts[c], sizeof(counts[c])) != (ssize_t)sizeof(counts[c])) counts[c] = 0;
+#endif
+	}
+}
+
+// --- decode pipeline ---
+
+// One decode of `path` into `out_fd`, timed into `t`. Returns 0 on success.
+static int decode_once(const char* path, BenchFmt fmt, int out_fd, DecTimings* t, uint32_t* w, uint32_t* h) {
+	dec_timing_begin(t);
+	(void)dec_timing_switch(DEC_STAGE_FILE_MAP);
+	ByteSpan file;
+	if (os_map_file_readonly(path, &file) != 0) {
+		dec_timing_end(t);
+		return -1;
+	}
+
+	(void)dec_timing_switch(DEC_STAGE_CONTAINER);
+	WebPContainer c;
+	if (webp_parse_simple_lossy(file, &c) != 0) {
+		dec_timing_end(t);
+		os_unmap_file(file);
+		return -1;
+	}
+	const ByteSpan vp8_payload = {file.data + c.vp8_chunk_offset, c.vp8_chunk_size};
+
+	(void)dec_timing_switch(DEC_STAGE_HEADER);
+	Vp8KeyFrameHeader kf;
+	Vp8DecodedFrame decoded;
+	if (vp8_parse_keyframe_header(vp8_payload, &kf) != 0 || !kf.is_key_frame ||
+	    vp8_decode_decoded_frame(vp8_payload, &decoded) != 0) {
+		dec_timing_end(t);
+		os_unmap_file(file);
+		return -1;
+	}
+
+	(void)dec_timing_switch(DEC_STAGE_RECON);
+	Yuv420Image img;
+	if (vp8_reconstruct_keyframe_yuv_filtered(&kf, &decoded, &img) != 0) {
+		dec_timing_end(t);
+		vp8_decoded_frame_free(&decoded);
+		os_unmap_file(file);
+		return -1;
+	}
+
+	(void)dec_timing_switch(DEC_STAGE_WRITE);
+	OsWriter wr;
+	os_writer_init(&wr, out_fd, 0, 0);
+	int rc;
+	if (fmt == FMT_PNG) {
+		rc = yuv420_write_png(&wr, &img);
+	} else if (fmt == FMT_PPM) {
+		rc = yuv420_write_ppm(&wr, &img);
+	} else {
+		const size_t ysz = (size_t)img.stride_y * img.height;
+		const size_t uvsz = (size_t)img.stride_uv * ((img.height + 1u) / 2u);
+		const ByteSpan planes[3] = {{img.y, ysz}, {img.u, uvsz}, {img.v, uvsz}};
+		rc = os_writer_write_segments(&wr, planes, 3);
+	}
+	if (os_writer_close(&wr) != 0) rc = -1;
+	dec_timing_end(t);
+
+	*w = img.width;
+	*h = img.height;
+	yuv420_free(&img);
+	vp8_decoded_frame_free(&decoded);
+	os_unmap_file(file);
+	return rc;
+}
+
+// `samples` holds (DEC_STAGE_COUNT + 1) * iters times, then PERF_COUNTERS * iters counts.
+static int bench_file(const char* path, BenchFmt fmt, uint32_t iters, int out_fd, uint64_t* samples) {
+	DecTimings t;
+	uint32_t w = 0, h = 0;
+	if (decode_once(path, fmt, out_fd, &t, &w, &h) != 0) {
+		fprintf(stderr, "skip: %s (not a supported simple lossy WebP)\n", path);
+		return 1;
+	}
+	uint64_t* perf = samples + (size_t)(DEC_STAGE_COUNT + 1) * iters;
+	for (uint32_t i = 0; i < iters; i++) {
+		uint64_t counts[PERF_COUNTERS];
+		perf_start();
+		const int rc = decode_once(path, fmt, out_fd, &t, &w, &h);
+		perf_stop(counts);
+		if (rc != 0) {
+			fprintf(stderr, "error: %s failed on iteration %u\n", path, i);
+			return -1;
+		}
+		for (int s = 0; s < DEC_STAGE_COUNT; s++) samples[(size_t)s * iters + i] = t.ns[s];
+		samples[(size_t)DEC_STAGE_COUNT * iters + i] = t.total_ns;
+		for (int c = 0; c < PERF_COUNTERS; c++) perf[(size_t)c * iters + i] = counts[c];
+	}
+
+	const double mpix = (double)w * (double)h / 1e6;
+	const char* cpu = cpu_level_name(vp8_dsp()->level);
+	Summary total = {0, 0, 0};
+	for (int s = 0; s <= DEC_STAGE_COUNT; s++) {
+		const Summary sum = summarize(samples + (size_t)s * iters, iters);
+		const double rate = sum.median ? mpix * 1e9 / (double)sum.median : 0.0;
+		emit(k_fmt_names[fmt], path, k_stage_names[s], cpu, w, h, iters, (double)sum.min, (double)sum.median,
+		     (double)sum.p95, rate, "MP/s");
+		if (s == DEC_STAGE_COUNT) total = sum;
+	}
+	const double mbs = (double)((w + 15u) / 16u) * (double)((h + 15u) / 16u);
+	for (int c = 0; c < PERF_COUNTERS; c++) {
+		if (g_perf_fd[c] < 0) continue;
+		const Summary sum = summarize(perf + (size_t)c * iters, iters);
+		emit("perf", path, k_perf_names[c], cpu, w, h, iters, (double)sum.min, (double)sum.median, (double)sum.p95,
+		     (double)sum.median / mbs, "per_mb");
+		printf("%-56s %-16s median %12llu  (%.1f per macroblock)\n", path, k_perf_names[c],
+		       (unsigned long long)sum.median, (double)sum.median / mbs);
+	}
+	printf("%-56s %5ux%-5u median %8.3f ms  p95 %8.3f ms  %7.2f MP/s\n", path, w, h, (double)total.median / 1e6,
+	       (double)total.p95 / 1e6, total.median ? mpix * 1e9 / (double)total.median : 0.0);
+	return 0;
+}
+
+// --- kernels ---
+
+static uint32_t xorshift32(uint32_t* s) {
+	uint32_t x = *s;
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+	*s = x;
+	return x;
+}
+
+enum {
+	KERNEL_BATCH = 4096,   // calls per timed sample
+	UPSAMPLE_LEN = 1024,   // pixels per upsampled row pair
+	CHECKSUM_BYTES = 65536 // bytes per checksum call
+};
+
+typedef struct {
+	const Vp8Dsp* dsp;
+	int16_t coeffs[64][16];
+	uint8_t edge[48 * 24];
+	uint8_t y0[UPSAMPLE_LEN], y1[UPSAMPLE_LEN];
+	uint8_t u0[UPSAMPLE_LEN / 2], v0[UPSAMPLE_LEN / 2], u1[UPSAMPLE_LEN / 2], v1[UPSAMPLE_LEN / 2];
+	uint8_t rgb0[UPSAMPLE_LEN * 3], rgb1[UPSAMPLE_LEN * 3];
+	uint8_t bytes[CHECKSUM_BYTES];
+} KernelData;
+
+static void kernel_data_init(KernelData* k) {
+	uint32_t seed = 0x9E3779B9u;
+	for (size_t i = 0; i < sizeof(k->coeffs) / sizeof(k->coeffs[0]); i++) {
+		for (int j = 0; j < 16; j++) k->coeffs[i][j] = (int16_t)((int32_t)(xorshift32(&seed) & 0x3FFu) - 512);
+	}
+	// A smooth ramp with noise so the loop filter takes its filtering branches.
+	for (int y = 0; y < 24; y++) {
+		for (int x = 0; x < 48; x++) k->edge[y * 48 + x] = (uint8_t)(96 + (x >= 8 ? 6 : 0) + (xorshift32(&seed) & 3u));
+	}
+	for (size_t i = 0; i < UPSAMPLE_LEN; i++) {
+		k->y0[i] = (uint8_t)xorshift32(&seed);
+		k->y1[i] = (uint8_t)xorshift32(&seed);
+	}
+	for (size_t i = 0; i < UPSAMPLE_LEN / 2; i++) {
+		k->u0[i] = (uint8_t)xorshift32(&seed);
+		k->v0[i] = (uint8_t)xorshift32(&seed);
+		k->u1[i] = (uint8_t)xorshift32(&seed);
+		k->v1[i] = (uint8_t)xorshift32(&seed);
+	}
+	for (size_t i = 0; i < CHECKSUM_BYTES; i++) k->bytes[i] = (uint8_t)xorshift32(&seed);
+}
+
+// Runs `calls` calls of one kernel; returns the elapsed ns.
+typedef uint64_t (*KernelFn)(KernelData* k, uint32_t calls);
+
+static uint64_t k_inv_dct4x4(KernelData* k, uint32_t calls) {
+	const size_t n = sizeof(k->coeffs) / sizeof(k->coeffs[0]);
+	int16_t out[16];
+	uint32_t acc = 0;
+	const uint64_t t0 = dec_timing_now_ns();
+	for (uint32_t i = 0; i < calls; i++) {
+		k->dsp->inv_dct4x4(k->coeffs[i % n], out);
+		acc += (uint16_t)out[i & 15u];
+	}
+	const uint64_t t1 = dec_timing_now_ns();
+	g_sink += acc;
+	return t1 - t0;
+}
+
+static uint64_t k_subblock_predict(KernelData* k, uint32_t calls) {
+	uint8_t B[4][4];
+	uint32_t acc = 0;
+	const uint64_t t0 = dec_timing_now_ns();
+	for (uint32_t i = 0; i < calls; i++) {
+		const uint8_t* above = k->y0 + 1u + (i & 255u);
+		k->dsp->subblock_predict(B, above, k->y1 + (i & 255u), (uint8_t)(i % 10u));
+		acc += B[i & 3u][(i >> 2) & 3u];
+	}
+	const uint64_t t1 = dec_timing_now_ns();
+	g_sink += acc;
+	return t1 - t0;
+}
+
+// One call is one 16x16 luma predictor; modes cycle through Vp8Dsp.pred16.
+static uint64_t k_pred16(KernelData* k, uint32_t calls) {
+	uint8_t dst[16 * 16];
+	uint32_t acc = 0;
+	const uint64_t t0 = dec_timing_now_ns();
+	for (uint32_t i = 0; i < calls; i++) {
+		const uint8_t* above = k->y0 + 1u + (i & 255u);
+		k->dsp->pred16[i % VP8_PRED_COUNT](dst, 16, above, k->y1 + (i & 255u));
+		acc += dst[i & 255u];
+	}
+	const uint64_t t1 = dec_timing_now_ns();
+	g_sink += acc;
+	return t1 - t0;
+}
+
+static uint64_t k_lf_mb_v_edge(KernelData* k, uint32_t calls) {
+	uint8_t buf[sizeof(k->edge)];
+	memcpy(buf, k->edge, sizeof(buf));
+	const uint64_t t0 = dec_timing_now_ns();
+	for (uint32_t i = 0; i < calls; i++) {
+		k->dsp->lf_mb_v_edge(buf + 4 * 48 + 8, 48, 40, 20, 2, 2);
+	}
+	const uint64_t t1 = dec_timing_now_ns();
+	g_sink += buf[4 * 48 + 8];
+	return t1 - t0;
+}
+
+static uint64_t k_upsample(KernelData* k, uint32_t calls) {
+	const uint64_t t0 = dec_timing_now_ns();
+	for (uint32_t i = 0; i < calls; i++) {
+		k->dsp->upsample_rgb_line_pair(k->y0, k->y1, k->u0, k->v0, k->u1, k->v1, k->rgb0, k->rgb1, UPSAMPLE_LEN, 3u);
+	}
+	const uint64_t t1 = dec_timing_now_ns();
+	g_sink += k->rgb0[0] + k->rgb1[UPSAMPLE_LEN];
+	return t1 - t0;
+}
+
+static uint64_t k_crc32(KernelData* k, uint32_t calls) {
+	uint32_t crc = 0;
+	const uint64_t t0 = dec_timing_now_ns();
+	for (uint32_t i = 0; i < calls; i++) crc = k->dsp->crc32_update(crc, k->bytes, CHECKSUM_BYTES);
+	const uint64_t t1 = dec_timing_now_ns();
+	g_sink += crc;
+	return t1 - t0;
+}
+
+static uint64_t k_adler32(KernelData* k, uint32_t calls) {
+	uint32_t a = 1, b = 0;
+	const uint64_t t0 = dec_timing_now_ns();
+	for (uint32_t i = 0; i < calls; i++) k->dsp->adler32_update(&a, &b, k->bytes, CHECKSUM_BYTES);
+	const uint64_t t1 = dec_timing_now_ns();
+	g_sink += a ^ b;
+	return t1 - t0;
+}
+
+// One "call" is a single bool; probabilities cycle through typical token values.
+static uint64_t k_bool_decode(KernelData* k, uint32_t calls) {
+	static const uint8_t probs[8] = {128, 253, 180, 60, 200, 15, 240, 100};
+	BoolDecoder d;
+	const ByteSpan data = {k->bytes, CHECKSUM_BYTES};
+	(void)bool_decoder_init(&d, data);
+	uint32_t acc = 0;
+	const uint64_t t0 = dec_timing_now_ns();
+	for (uint32_t i = 0; i < calls; i++) acc += (uint32_t)bool_decode_bool(&d, probs[i & 7u]);
+	const uint64_t t1 = dec_timing_now_ns();
+	g_sink += acc;
+	return t1 - t0;
+}
+
+typedef struct {
+	const char* name;
+	KernelFn fn;
+	uint32_t calls;     // calls per sample
+	int dispatched;     // runs once per CPU level
+	double units_per_call;
+	const char* unit;   // rate unit (units per second, millions)
+} KernelSpec;
+
+static const KernelSpec k_kernels[] = {
+	{"inv_dct4x4", k_inv_dct4x4, KERNEL_BATCH, 1, 1.0, "Mcall/s"},
+	{"subblock_predict", k_subblock_predict, KERNEL_BATCH, 1, 1.0, "Mcall/s"},
+	{"pred16", k_pred16, KERNEL_BATCH, 1, 1.0, "Mcall/s"},
+	{"lf_mb_v_edge", k_lf_mb_v_edge, KERNEL_BATCH, 1, 1.0, "Mcall/s"},
+	{"upsample_rgb_line_pair", k_upsample, 64, 1, 2.0 * UPSAMPLE_LEN, "MP/s"},
+	{"crc32_update", k_crc32, 8, 1, CHECKSUM_BYTES, "MB/s"},
+	{"adler32_update", k_adler32, 8, 1, CHECKSUM_BYTES, "MB/s"},
+	{"bool_decode", k_bool_decode, 65536, 0, 1.0, "Mbool/s"},
+};
+
+static int bench_kernels(uint32_t samples_per_kernel) {
+	KernelData* k = (KernelData*)malloc(sizeof(KernelData));
+	uint64_t* samples = (uint64_t*)malloc(sizeof(uint64_t) * samples_per_kernel);
+	if (!k || !samples) {
+		free(k);
+		free(samples);
+		fprintf(stderr, "error: out of memory\n");
+		return -1;
+	}
+	kernel_data_init(k);
+
+	const CpuLevel max = cpu_detect_level();
+	for (size_t i = 0; i < sizeof(k_kernels) / sizeof(k_kernels[0]); i++) {
+		const KernelSpec* ks = &k_kernels[i];
+		const int last = ks->dispatched ? (int)max : (int)CPU_LEVEL_SCALAR;
+		for (int level = (int)CPU_LEVEL_SCALAR; level <= last; level++) {
+			Vp8Dsp dsp;
+			vp8_dsp_init_level(&dsp, (CpuLevel)level);
+			k->dsp = &dsp;
+			(void)ks->fn(k, ks->calls); // warm-up
+			for (uint32_t s = 0; s < samples_per_kernel; s++) samples[s] = ks->fn(k, ks->calls);
+			const Summary sum = summarize(samples, samples_per_kernel);
+			const double calls = (double)ks->calls;
+			const double per_call = (double)sum.median / calls;
+			const double rate = per_call > 0.0 ? ks->units_per_call * 1e3 / per_call : 0.0;
+			const char* cpu = ks->dispatched ? cpu_level_name((CpuLevel)level) : "-";
+			emit("kernel", ks->name, "call", cpu, 0, 0, samples_per_kernel, (double)sum.min / calls, per_call,
+			     (double)sum.p95 / calls, rate, ks->unit);
+			printf("%-24s %-7s %10.1f ns/call  %10.1f %s\n", ks->name, cpu, per_call, rate, ks->unit);
+		}
+	}
+	free(samples);
+	free(k);
+	return 0;
+}
+
+static void usage(void) {
+	fprintf(stderr,
+	        "Usage: webpdec_bench [-n iters] [-k samples] [-fmt png|ppm|yuv] [-kernels|-files] [-perf]\n"
+	        "                     [-csv out.csv] [-json out.json] [file.webp...]\n");
+}
+
+int main(int argc, char** argv) {
+	uint32_t iters = 10;
+	uint32_t kernel_samples = 25;
+	BenchFmt fmt = FMT_PNG;
+	int run_files = 1;
+	int run_kernels = 1;
+	int use_perf = 0;
+	const char* csv_path = NULL;
+	const char* json_path = NULL;
+
+	int i = 1;
+	for (; i < argc && argv[i][0] == '-'; i++) {
+		const char* a = argv[i];
+		const int has_val = i + 1 < argc;
+		if (strcmp(a, "-n") == 0 && has_val) {
+			iters = (uint32_t)strtoul(argv[++i], NULL, 10);
+		} else if (strcmp(a, "-k") == 0 && has_val) {
+			kernel_samples = (uint32_t)strtoul(argv[++i], NULL, 10);
+		} else if (strcmp(a, "-fmt") == 0 && has_val) {
+			const char* f = argv[++i];
+			if (strcmp(f, "png") == 0) {
+				fmt = FMT_PNG;
+			} else if (strcmp(f, "ppm") == 0) {
+				fmt = FMT_PPM;
+			} else if (strcmp(f, "yuv") == 0) {
+				fmt = FMT_YUV;
+			} else {
+				usage();
+				return 2;
+			}
+		} else if (strcmp(a, "-kernels") == 0) {
+			run_files = 0;
+		} else if (strcmp(a, "-files") == 0) {
+			run_kernels = 0;
+		} else if (strcmp(a, "-perf") == 0) {
+			use_perf = 1;
+		} else if (strcmp(a, "-csv") == 0 && has_val) {
+			csv_path = argv[++i];
+		} else if (strcmp(a, "-json") == 0 && has_val) {
+			json_path = argv[++i];
+		} else {
+			usage();
+			return 2;
+		}
+	}
+	if (iters == 0 || kernel_samples == 0 || (run_files && i == argc && !run_kernels)) {
+		usage();
+		return 2;
+	}
+
+	if (csv_path) {
+		g_csv = fopen(csv_path, "w");
+		if (!g_csv) {
+			perror(csv_path);
+			return 1;
+		}
+		fprintf(g_csv, "kind,subject,metric,cpu,width,height,iters,min_ns,median_ns,p95_ns,rate,unit\n");
+	}
+	if (json_path) {
+		g_json = fopen(json_path, "w");
+		if (!g_json) {
+			perror(json_path);
+			return 1;
+		}
+		fprintf(g_json, "{\"cpu\":\"%s\",\"results\":[", cpu_level_name(vp8_dsp()->level));
+	}
+
+	int rc = 0;
+	if (run_files && i < argc) {
+		const int out_fd = open("/dev/null", O_WRONLY);
+		if (use_perf && perf_open() == 0) fprintf(stderr, "warning: -perf: no hardware cache counters available\n");
+		uint64_t* samples = (uint64_t*)malloc(sizeof(uint64_t) * (DEC_STAGE_COUNT + 1u + PERF_COUNTERS) * iters);
+		if (out_fd < 0 || !samples) {
+			fprintf(stderr, "error: cannot open /dev/null or allocate samples\n");
+			rc = 1;
+		}
+		for (int f = i; rc == 0 && f < argc; f++) {
+			if (bench_file(argv[f], fmt, iters, out_fd, samples) < 0) rc = 1;
+		}
+		free(samples);
+		if (out_fd >= 0) (void)close(out_fd);
+	}
+	if (rc == 0 && run_kernels && bench_kernels(kernel_samples) != 0) rc = 1;
+
+	if (g_json) {
+		fprintf(g_json, "\n]}\n");
+		if (fclose(g_json) != 0) rc = 1;
+	}
+	if (g_csv && fclose(g_csv) != 0) rc = 1;
+	return rc;
+}